@@ -56,6 +56,8 @@ void PrintUsageAndExit(int ret)
 	"even if SyncAllowScript says no\n"
 	"  reload -- reload daemon configuration\n"
 	"  terminate -- terminate daemon now\n"
+	"  report -- print where the time went in the last sync, "
+	"as JSON\n"
 	"  wait-for-sync -- wait until the next sync starts, then exit\n"
 	"  wait-for-end  -- wait until the next sync finishes, then exit\n"
 	"  sync-and-wait -- start sync, wait until it finishes, then exit\n"
@@ -362,7 +364,12 @@ int main(int argc, const char *argv[])
 			default:
 			{
 				// Is this an OK or error line?
-				if(line == "ok")
+				if(commandName == "report" &&
+					line.substr(0, 1) == "{")
+				{
+					std::cout << line << std::endl;
+				}
+				else if(line == "ok")
 				{
 					BOX_TRACE("Control command "
 						"sent: " <<
@@ -367,6 +367,8 @@ int main(int argc, const char *argv[])
 	int ssl_security_level(conf.GetKeyValueInt("SSLSecurityLevel"));
 	tlsContext.Initialise(false /* as client */, certFile.c_str(), keyFile.c_str(),
 		caFile.c_str(), ssl_security_level);
+	tlsContext.SetSessionFile(conf.GetKeyValue("DataDirectory") +
+		DIRECTORY_SEPARATOR + "tls_session");
 	
 	// Initialise keys
 	BackupClientCryptoKeys_Setup(conf.GetKeyValue("KeysFile").c_str());
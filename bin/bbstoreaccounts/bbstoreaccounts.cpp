@@ -59,11 +59,14 @@ void PrintUsageAndExit()
 "  delete <account> [yes]\n"
 "        Deletes the specified account. Prompts for confirmation unless\n"
 "        the optional 'yes' parameter is provided.\n"
-"  check <account> [fix] [quiet]\n"
+"  check <account> [fix] [quiet] [quick|deep] [workers=<n>]\n"
 "        Checks the specified account for errors. If the 'fix' option is\n"
 "        provided, any errors discovered that can be fixed automatically\n"
 "        will be fixed. If the 'quiet' option is provided, less output is\n"
-"        produced.\n"
+"        produced. A 'quick' check only reads the headers of files, and\n"
+"        a 'deep' check reads all their data. The 'workers' option sets\n"
+"        the number of processes which read and verify objects at the\n"
+"        same time (default 1).\n"
 "  name <account> <new name>\n"
 "        Changes the \"name\" of the account to the specified string.\n"
 "        The name is purely cosmetic and intended to make it easier to\n"
@@ -266,6 +269,9 @@ int main(int argc, const char *argv[])
 	{
 		bool fixErrors = false;
 		bool quiet = false;
+		int numWorkers = 1;
+		BackupStoreFile::VerifyLevel level =
+			BackupStoreFile::VerifyLevel_BlockIndex;
 		
 		// Look at other options
 		for(int o = 2; o < argc; ++o)
@@ -278,6 +284,26 @@ int main(int argc, const char *argv[])
 			{
 				quiet = true;
 			}
+			else if(::strcmp(argv[o], "quick") == 0)
+			{
+				level = BackupStoreFile::VerifyLevel_Headers;
+			}
+			else if(::strcmp(argv[o], "deep") == 0)
+			{
+				level = BackupStoreFile::VerifyLevel_AllData;
+			}
+			else if(::strncmp(argv[o], "workers=", 8) == 0)
+			{
+				numWorkers = ::atoi(argv[o] + 8);
+				if(numWorkers < 1 ||
+					numWorkers > BACKUPSTORECHECK_MAX_WORKERS)
+				{
+					BOX_ERROR("Number of workers must be "
+						"between 1 and " <<
+						BACKUPSTORECHECK_MAX_WORKERS << ".");
+					return 2;
+				}
+			}
 			else
 			{
 				BOX_ERROR("Unknown option " << argv[o] << ".");
@@ -286,7 +312,9 @@ int main(int argc, const char *argv[])
 		}
 	
 		// Check the account
-		return control.CheckAccount(id, fixErrors, quiet);
+		return control.CheckAccount(id, fixErrors, quiet,
+			false, // ReturnNumErrorsFound
+			numWorkers, level);
 	}
 	else if(command == "housekeep")
 	{
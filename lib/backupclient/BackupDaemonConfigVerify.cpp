@@ -120,6 +120,10 @@ static const ConfigurationVerifyKey verifyrootkeys[] =
 	// set the level of verbosity of file logging
 	ConfigurationVerifyKey("LogFileOverwrite", ConfigTest_IsBool, false),
 	// overwrite the log file on each backup
+	ConfigurationVerifyKey("LogFileBufferSize", ConfigTest_IsInt, 0),
+	// collect this many bytes of log messages before writing them
+	ConfigurationVerifyKey("LogFileDropWhenFull", ConfigTest_IsBool, false),
+	// drop less important messages instead of waiting for the buffer
 	ConfigurationVerifyKey("CommandSocket", 0),
 	// not compulsory to have this
 	ConfigurationVerifyKey("KeepAliveTime", ConfigTest_IsInt),
@@ -138,6 +142,19 @@ static const ConfigurationVerifyKey verifyrootkeys[] =
 	ConfigurationVerifyKey("TcpNice", ConfigTest_IsBool, false),
 	// optional enable of tcp nice/background mode
 
+	ConfigurationVerifyKey("ExtraStoreConnections", ConfigTest_IsInt, 0),
+	// optional number of extra connections to upload large files on,
+	// alongside the main connection (not supported on Windows)
+	ConfigurationVerifyKey("ExtraConnectionUploadSizeThreshold",
+		ConfigTest_IsInt, 64*1024*1024),
+	// files at least this big (in bytes) use the extra connections
+
+	ConfigurationVerifyKey("ResumableUploadSizeThreshold",
+		ConfigTest_IsInt, 0),
+	// optional minimum size (in bytes) of files uploaded whole, rather
+	// than as a patch, to send in a way that can be resumed if the
+	// connection is lost (0 to disable)
+
 	ConfigurationVerifyKey("KeysFile", ConfigTest_Exists),
 	ConfigurationVerifyKey("DataDirectory", ConfigTest_Exists),
 
@@ -12,6 +12,7 @@
 
 #include <string>
 
+#include "BackupFileSystem.h"
 #include "BackupStoreAccountDatabase.h"
 #include "HTTPResponse.h"
 #include "S3Client.h"
@@ -38,22 +39,6 @@ public:
 	int PrintAccountInfo(const BackupStoreInfo& info, int BlockSize);
 };
 
-class S3BackupFileSystem
-{
-private:
-	std::string mBasePath;
-	S3Client& mrClient;
-public:
-	S3BackupFileSystem(const Configuration& config, const std::string& BasePath,
-		S3Client& rClient)
-	: mBasePath(BasePath),
-	  mrClient(rClient)
-	{ }
-	std::string GetDirectoryURI(int64_t ObjectID);
-	std::auto_ptr<HTTPResponse> GetDirectory(BackupStoreDirectory& rDir);
-	int PutDirectory(BackupStoreDirectory& rDir);
-};
-
 class S3BackupAccountControl : public BackupAccountControl
 {
 private:
@@ -85,7 +70,6 @@ public:
 // max size of soft limit as percent of hard limit
 #define MAX_SOFT_LIMIT_SIZE		97
 #define S3_INFO_FILE_NAME		"boxbackup.info"
-#define S3_NOTIONAL_BLOCK_SIZE		1048576
 
 #endif // BACKUPACCOUNTCONTROL__H
 
@@ -1235,3 +1235,36 @@ uint64_t BackupClientFileAttributes::GenerateAttributeHash(EMU_STRUCT_STAT &st,
 	memcpy(&result, digest.DigestAsData(), sizeof(result));
 	return result;
 }
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupClientFileAttributes::GenerateResumeKey(
+//			 int64_t, const std::string &)
+//		Purpose: Generate a 64 bit key from the directory ID and
+//			 leafname of a file, so that an interrupted upload of
+//			 it can be found again on the server. Includes the
+//			 secret, so that it doesn't reveal the filename.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+uint64_t BackupClientFileAttributes::GenerateResumeKey(int64_t DirectoryID,
+	const std::string &leafname)
+{
+	if(sAttributeHashSecretLength == 0)
+	{
+		THROW_EXCEPTION(BackupStoreException, AttributeHashSecretNotSet)
+	}
+
+	int64_t directoryID = box_hton64(DirectoryID);
+
+	MD5Digest digest;
+	digest.Add(&directoryID, sizeof(directoryID));
+	digest.Add(leafname.c_str(), leafname.size());
+	digest.Add(sAttributeHashSecret, sAttributeHashSecretLength);
+	digest.Finish();
+
+	uint64_t result;
+	memcpy(&result, digest.DigestAsData(), sizeof(result));
+	return result;
+}
@@ -58,6 +58,8 @@ public:
 	
 	static uint64_t GenerateAttributeHash(EMU_STRUCT_STAT &st,
 		const std::string& Filename, const std::string &leafname);
+	static uint64_t GenerateResumeKey(int64_t DirectoryID,
+		const std::string &leafname);
 	static void FillExtendedAttr(StreamableMemBlock &outputBlock,
 		const std::string& Filename);
 
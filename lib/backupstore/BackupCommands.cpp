@@ -25,15 +25,24 @@
 #include "CollectInBufferStream.h"
 #include "FileStream.h"
 #include "InvisibleTempFileStream.h"
+#include "Metrics.h"
 #include "RaidFileController.h"
 #include "StreamableMemBlock.h"
 
 #include "MemLeakFindOn.h"
 
 #define PROTOCOL_ERROR(code) \
-	std::auto_ptr<BackupProtocolMessage>(new BackupProtocolError( \
-		BackupProtocolError::ErrorType, \
-		BackupProtocolError::code));
+	MakeProtocolError(BackupProtocolError::code, #code);
+
+// Records how long each command takes in a histogram labelled with its name.
+// The histogram is looked up (or created) the first time that each process
+// handles each type of command.
+#define RECORD_COMMAND_METRICS(command) \
+	static MetricsHistogram _commandDuration( \
+		"bbstored_command_duration_seconds", \
+		"Time taken to handle each backup protocol command", \
+		"command=\"" #command "\""); \
+	MetricsHistogram::Timer _commandTimer(_commandDuration);
 
 #define CHECK_PHASE(phase) \
 	if(rContext.GetPhase() != BackupStoreContext::phase) \
@@ -53,6 +62,27 @@
 	}
 
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    MakeProtocolError(int, const char *)
+//		Purpose: Counts an error returned to the client, by name, and
+//			 returns the error message to send.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+static std::auto_ptr<BackupProtocolMessage> MakeProtocolError(int SubType,
+	const char *Name)
+{
+	MetricsCounter errors("bbstored_command_errors_total",
+		"Errors returned to clients by backup protocol commands",
+		std::string("error=\"") + Name + "\"");
+	errors.Increment();
+
+	return std::auto_ptr<BackupProtocolMessage>(new BackupProtocolError(
+		BackupProtocolError::ErrorType, SubType));
+}
+
 // --------------------------------------------------------------------------
 //
 // Function
@@ -75,7 +105,8 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolReplyable::HandleException(Bo
 		{
 			return PROTOCOL_ERROR(Err_FileDoesNotVerify);
 		}
-		else if(e.GetSubType() == BackupStoreException::AddedFileExceedsStorageLimit)
+		else if(e.GetSubType() == BackupStoreException::AddedFileExceedsStorageLimit ||
+			e.GetSubType() == BackupStoreException::TooManyStagedFiles)
 		{
 			return PROTOCOL_ERROR(Err_StorageLimitExceeded);
 		}
@@ -99,6 +130,14 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolReplyable::HandleException(Bo
 		{
 			return PROTOCOL_ERROR(Err_PatchConsistencyError);
 		}
+		else if(e.GetSubType() == BackupStoreException::StagedFileDoesNotExist)
+		{
+			return PROTOCOL_ERROR(Err_DoesNotExist);
+		}
+		else if(e.GetSubType() == BackupStoreException::StagedFileOffsetInvalid)
+		{
+			return PROTOCOL_ERROR(Err_BadStagedFileOffset);
+		}
 	}
 
 	throw;
@@ -117,6 +156,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolReplyable::HandleException(Bo
 // --------------------------------------------------------------------------
 std::auto_ptr<BackupProtocolMessage> BackupProtocolVersion::DoCommand(BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(Version)
 	CHECK_PHASE(Phase_Version)
 
 	// Correct version?
@@ -142,6 +182,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolVersion::DoCommand(BackupProt
 // --------------------------------------------------------------------------
 std::auto_ptr<BackupProtocolMessage> BackupProtocolLogin::DoCommand(BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(Login)
 	CHECK_PHASE(Phase_Login)
 
 	// Check given client ID against the ID in the certificate certificate
@@ -187,6 +228,22 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolLogin::DoCommand(BackupProtoc
 		return PROTOCOL_ERROR(Err_DisabledAccount);
 	}
 
+	// Staged files which haven't been touched for a long time will
+	// never be resumed or added now, so don't leave them taking up space.
+	if(!rContext.SessionIsReadOnly())
+	{
+		try
+		{
+			rContext.DeleteOldStagedFiles();
+		}
+		catch(BoxException &e)
+		{
+			BOX_WARNING("Failed to delete abandoned staged files for "
+				"client ID " << BOX_FORMAT_ACCOUNT(mClientID) <<
+				": " << e.what());
+		}
+	}
+
 	// Get the last client store marker
 	int64_t clientStoreMarker = rContext.GetClientStoreMarker();
 
@@ -219,6 +276,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolLogin::DoCommand(BackupProtoc
 // --------------------------------------------------------------------------
 std::auto_ptr<BackupProtocolMessage> BackupProtocolFinished::DoCommand(BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(Finished)
 	// can be called in any phase
 
 	BOX_NOTICE("Session finished for Client ID " <<
@@ -242,6 +300,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolFinished::DoCommand(BackupPro
 // --------------------------------------------------------------------------
 std::auto_ptr<BackupProtocolMessage> BackupProtocolListDirectory::DoCommand(BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(ListDirectory)
 	CHECK_PHASE(Phase_Commands)
 
 	// Store the listing to a stream
@@ -275,6 +334,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolStoreFile::DoCommand(
 	BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext,
 	IOStream& rDataStream) const
 {
+	RECORD_COMMAND_METRICS(StoreFile)
 	CHECK_PHASE(Phase_Commands)
 	CHECK_WRITEABLE_SESSION
 
@@ -306,6 +366,126 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolStoreFile::DoCommand(
 }
 
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupProtocolStageFile::DoCommand(Protocol &, BackupStoreContext &)
+//		Purpose: Command to receive a file on an auxiliary connection,
+//			 to be added to the store later by StoreStagedFile
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::auto_ptr<BackupProtocolMessage> BackupProtocolStageFile::DoCommand(
+	BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext,
+	IOStream& rDataStream) const
+{
+	RECORD_COMMAND_METRICS(StageFile)
+	CHECK_PHASE(Phase_Commands)
+	// Read-only sessions are allowed: that's the point.
+
+	int64_t stagingID = rContext.StageFile(rDataStream);
+
+	return std::auto_ptr<BackupProtocolMessage>(new BackupProtocolSuccess(stagingID));
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupProtocolCreateStagedFile::DoCommand(Protocol &, BackupStoreContext &)
+//		Purpose: Command to create an empty staged file, for a
+//			 resumable upload
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::auto_ptr<BackupProtocolMessage> BackupProtocolCreateStagedFile::DoCommand(
+	BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
+{
+	RECORD_COMMAND_METRICS(CreateStagedFile)
+	CHECK_PHASE(Phase_Commands)
+
+	int64_t stagingID = rContext.CreateStagedFile(mResumeKey,
+		mResumeCheck);
+
+	return std::auto_ptr<BackupProtocolMessage>(new BackupProtocolSuccess(stagingID));
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupProtocolGetStagedFileSize::DoCommand(Protocol &, BackupStoreContext &)
+//		Purpose: Command to find out how much of a staged file has
+//			 been received
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::auto_ptr<BackupProtocolMessage> BackupProtocolGetStagedFileSize::DoCommand(
+	BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
+{
+	RECORD_COMMAND_METRICS(GetStagedFileSize)
+	CHECK_PHASE(Phase_Commands)
+
+	int64_t size = rContext.GetStagedFileSize(mStagingID);
+
+	return std::auto_ptr<BackupProtocolMessage>(new BackupProtocolStagedFileSize(size));
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupProtocolResumeStagedFile::DoCommand(Protocol &, BackupStoreContext &)
+//		Purpose: Command to receive the rest of a staged file
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::auto_ptr<BackupProtocolMessage> BackupProtocolResumeStagedFile::DoCommand(
+	BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext,
+	IOStream& rDataStream) const
+{
+	RECORD_COMMAND_METRICS(ResumeStagedFile)
+	CHECK_PHASE(Phase_Commands)
+
+	rContext.WriteStagedFile(mStagingID, mOffset, rDataStream);
+
+	return std::auto_ptr<BackupProtocolMessage>(new BackupProtocolSuccess(mStagingID));
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupProtocolStoreStagedFile::DoCommand(Protocol &, BackupStoreContext &)
+//		Purpose: Command to add a staged file to the store
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::auto_ptr<BackupProtocolMessage> BackupProtocolStoreStagedFile::DoCommand(
+	BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
+{
+	RECORD_COMMAND_METRICS(StoreStagedFile)
+	CHECK_PHASE(Phase_Commands)
+	CHECK_WRITEABLE_SESSION
+
+	// Check that the diff from file actually exists, if it's specified
+	if(mDiffFromFileID != 0)
+	{
+		if(!rContext.ObjectExists(mDiffFromFileID,
+			BackupStoreContext::ObjectExists_File))
+		{
+			return PROTOCOL_ERROR(Err_DiffFromFileDoesNotExist);
+		}
+	}
+
+	int64_t id = rContext.AddStagedFile(mStagingID, mDirectoryObjectID,
+		mModificationTime, mAttributesHash, mDiffFromFileID,
+		mFilename);
+
+	return std::auto_ptr<BackupProtocolMessage>(new BackupProtocolSuccess(id));
+}
+
+
 
 
 // --------------------------------------------------------------------------
@@ -318,6 +498,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolStoreFile::DoCommand(
 // --------------------------------------------------------------------------
 std::auto_ptr<BackupProtocolMessage> BackupProtocolGetObject::DoCommand(BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(GetObject)
 	CHECK_PHASE(Phase_Commands)
 
 	// Check the object exists
@@ -347,6 +528,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolGetObject::DoCommand(BackupPr
 // --------------------------------------------------------------------------
 std::auto_ptr<BackupProtocolMessage> BackupProtocolGetFile::DoCommand(BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(GetFile)
 	CHECK_PHASE(Phase_Commands)
 
 	// Check the objects exist
@@ -496,6 +678,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolCreateDirectory::DoCommand(
 	BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext,
 	IOStream& rDataStream) const
 {
+	RECORD_COMMAND_METRICS(CreateDirectory)
 	return BackupProtocolCreateDirectory2(mContainingDirectoryID,
 		mAttributesModTime, 0 /* ModificationTime */,
 		mDirectoryName).DoCommand(rProtocol, rContext, rDataStream);
@@ -516,6 +699,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolCreateDirectory2::DoCommand(
 	BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext,
 	IOStream& rDataStream) const
 {
+	RECORD_COMMAND_METRICS(CreateDirectory2)
 	CHECK_PHASE(Phase_Commands)
 	CHECK_WRITEABLE_SESSION
 
@@ -559,6 +743,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolChangeDirAttributes::DoComman
 	BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext,
 	IOStream& rDataStream) const
 {
+	RECORD_COMMAND_METRICS(ChangeDirAttributes)
 	CHECK_PHASE(Phase_Commands)
 	CHECK_WRITEABLE_SESSION
 
@@ -588,6 +773,7 @@ BackupProtocolSetReplacementFileAttributes::DoCommand(
 	BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext,
 	IOStream& rDataStream) const
 {
+	RECORD_COMMAND_METRICS(SetReplacementFileAttributes)
 	CHECK_PHASE(Phase_Commands)
 	CHECK_WRITEABLE_SESSION
 
@@ -619,6 +805,7 @@ BackupProtocolSetReplacementFileAttributes::DoCommand(
 // --------------------------------------------------------------------------
 std::auto_ptr<BackupProtocolMessage> BackupProtocolDeleteFile::DoCommand(BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(DeleteFile)
 	CHECK_PHASE(Phase_Commands)
 	CHECK_WRITEABLE_SESSION
 
@@ -643,6 +830,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolDeleteFile::DoCommand(BackupP
 std::auto_ptr<BackupProtocolMessage> BackupProtocolUndeleteFile::DoCommand(
 	BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(UndeleteFile)
 	CHECK_PHASE(Phase_Commands)
 	CHECK_WRITEABLE_SESSION
 
@@ -665,6 +853,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolUndeleteFile::DoCommand(
 // --------------------------------------------------------------------------
 std::auto_ptr<BackupProtocolMessage> BackupProtocolDeleteDirectory::DoCommand(BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(DeleteDirectory)
 	CHECK_PHASE(Phase_Commands)
 	CHECK_WRITEABLE_SESSION
 
@@ -692,6 +881,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolDeleteDirectory::DoCommand(Ba
 // --------------------------------------------------------------------------
 std::auto_ptr<BackupProtocolMessage> BackupProtocolUndeleteDirectory::DoCommand(BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(UndeleteDirectory)
 	CHECK_PHASE(Phase_Commands)
 	CHECK_WRITEABLE_SESSION
 
@@ -718,6 +908,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolUndeleteDirectory::DoCommand(
 // --------------------------------------------------------------------------
 std::auto_ptr<BackupProtocolMessage> BackupProtocolSetClientStoreMarker::DoCommand(BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(SetClientStoreMarker)
 	CHECK_PHASE(Phase_Commands)
 	CHECK_WRITEABLE_SESSION
 
@@ -739,6 +930,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolSetClientStoreMarker::DoComma
 // --------------------------------------------------------------------------
 std::auto_ptr<BackupProtocolMessage> BackupProtocolMoveObject::DoCommand(BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(MoveObject)
 	CHECK_PHASE(Phase_Commands)
 	CHECK_WRITEABLE_SESSION
 
@@ -762,6 +954,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolMoveObject::DoCommand(BackupP
 // --------------------------------------------------------------------------
 std::auto_ptr<BackupProtocolMessage> BackupProtocolGetObjectName::DoCommand(BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(GetObjectName)
 	CHECK_PHASE(Phase_Commands)
 
 	// Create a stream for the list of filenames
@@ -874,6 +1067,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolGetObjectName::DoCommand(Back
 // --------------------------------------------------------------------------
 std::auto_ptr<BackupProtocolMessage> BackupProtocolGetBlockIndexByID::DoCommand(BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(GetBlockIndexByID)
 	CHECK_PHASE(Phase_Commands)
 
 	// Open the file
@@ -900,6 +1094,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolGetBlockIndexByID::DoCommand(
 // --------------------------------------------------------------------------
 std::auto_ptr<BackupProtocolMessage> BackupProtocolGetBlockIndexByName::DoCommand(BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(GetBlockIndexByName)
 	CHECK_PHASE(Phase_Commands)
 
 	// Get the directory
@@ -952,6 +1147,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolGetBlockIndexByName::DoComman
 // --------------------------------------------------------------------------
 std::auto_ptr<BackupProtocolMessage> BackupProtocolGetAccountUsage::DoCommand(BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(GetAccountUsage)
 	CHECK_PHASE(Phase_Commands)
 
 	// Get store info from context
@@ -983,6 +1179,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolGetAccountUsage::DoCommand(Ba
 // --------------------------------------------------------------------------
 std::auto_ptr<BackupProtocolMessage> BackupProtocolGetIsAlive::DoCommand(BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(GetIsAlive)
 	CHECK_PHASE(Phase_Commands)
 
 	//
@@ -1002,6 +1199,7 @@ std::auto_ptr<BackupProtocolMessage> BackupProtocolGetIsAlive::DoCommand(BackupP
 std::auto_ptr<BackupProtocolMessage> BackupProtocolGetAccountUsage2::DoCommand(
 	BackupProtocolReplyable &rProtocol, BackupStoreContext &rContext) const
 {
+	RECORD_COMMAND_METRICS(GetAccountUsage2)
 	CHECK_PHASE(Phase_Commands)
 
 	// Get store info from context
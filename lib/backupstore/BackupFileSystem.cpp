@@ -0,0 +1,1144 @@
+// --------------------------------------------------------------------------
+//
+// File
+//		Name:    BackupFileSystem.cpp
+//		Purpose: Storage backends for the objects in a backup store
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+#include "Box.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/stat.h>
+
+#include <sstream>
+
+#include "autogen_BackupStoreException.h"
+#include "autogen_CommonException.h"
+#include "autogen_HTTPException.h"
+#include "BackupConstants.h"
+#include "BackupFileSystem.h"
+#include "BackupStoreDirectory.h"
+#include "CollectInBufferStream.h"
+#include "Configuration.h"
+#include "FileStream.h"
+#include "HTTPResponse.h"
+#include "MemBlockStream.h"
+#include "RaidFileController.h"
+#include "RaidFileRead.h"
+#include "RaidFileSyncGroup.h"
+#include "RaidFileUtil.h"
+#include "RaidFileWrite.h"
+#include "S3Client.h"
+#include "Utils.h"
+
+#include "MemLeakFindOn.h"
+
+int BackupFileSystemWrite::Read(void *pBuffer, int NBytes, int Timeout)
+{
+	THROW_EXCEPTION(CommonException, NotSupported)
+}
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    RaidBackupFileSystemWrite
+//		Purpose: An object being written to a RaidBackupFileSystem,
+//			 streamed straight to RAID stripes where possible
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class RaidBackupFileSystemWrite : public BackupFileSystemWrite
+{
+public:
+	RaidBackupFileSystemWrite(int DiscSet, const std::string &rFilename,
+		bool AllowOverwrite, RaidFileSyncGroup *pSyncGroup)
+	: mFile(DiscSet, rFilename),
+	  mpSyncGroup(pSyncGroup)
+	{
+		mFile.Open(AllowOverwrite,
+			BACKUP_STORE_CONVERT_TO_RAID_IMMEDIATELY);
+	}
+	// Not opened yet, see OpenFromFile()
+	RaidBackupFileSystemWrite(int DiscSet, const std::string &rFilename,
+		RaidFileSyncGroup *pSyncGroup)
+	: mFile(DiscSet, rFilename),
+	  mpSyncGroup(pSyncGroup)
+	{ }
+
+	bool OpenFromFile(const std::string &rLocalFilename)
+	{
+		return mFile.OpenFromFile(rLocalFilename,
+			false /* no overwriting */);
+	}
+
+	virtual void Write(const void *pBuffer, int NBytes,
+		int Timeout = IOStream::TimeOutInfinite)
+	{
+		mFile.Write(pBuffer, NBytes, Timeout);
+	}
+	virtual pos_type GetPosition() const { return mFile.GetPosition(); }
+	virtual void Seek(pos_type Offset, int SeekType)
+	{
+		mFile.Seek(Offset, SeekType);
+	}
+	virtual void Commit()
+	{
+		mFile.Commit(BACKUP_STORE_CONVERT_TO_RAID_IMMEDIATELY,
+			mpSyncGroup);
+	}
+	virtual void Discard() { mFile.Discard(); }
+	virtual int64_t GetDiscUsageInBlocks()
+	{
+		return mFile.GetDiscUsageInBlocks();
+	}
+
+private:
+	RaidFileWrite mFile;
+	RaidFileSyncGroup *mpSyncGroup;
+};
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidBackupFileSystem::OpenRead(const std::string &,
+//			 int64_t *)
+//		Purpose: Opens an object for reading, returning its
+//			 revision ID if requested
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::auto_ptr<BackupFileSystemRead> RaidBackupFileSystem::OpenRead(
+	const std::string &rFilename, int64_t *pRevisionID)
+{
+	SyncIfPending(rFilename);
+	std::auto_ptr<RaidFileRead> apFile(RaidFileRead::Open(mDiscSet,
+		rFilename, pRevisionID));
+	int64_t size = apFile->GetFileSize();
+	int64_t blocks = apFile->GetDiscUsageInBlocks();
+	return std::auto_ptr<BackupFileSystemRead>(new BackupFileSystemRead(
+		std::auto_ptr<IOStream>(apFile.release()), size, blocks));
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidBackupFileSystem::OpenWrite(const std::string &,
+//			 bool)
+//		Purpose: Starts writing an object, which must be committed
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::auto_ptr<BackupFileSystemWrite> RaidBackupFileSystem::OpenWrite(
+	const std::string &rFilename, bool AllowOverwrite)
+{
+	// Committing it again just replaces a pending commit, but otherwise
+	// it must be in place to be found
+	if(!AllowOverwrite)
+	{
+		SyncIfPending(rFilename);
+	}
+	return std::auto_ptr<BackupFileSystemWrite>(
+		new RaidBackupFileSystemWrite(mDiscSet, rFilename,
+			AllowOverwrite, mpSyncGroup));
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidBackupFileSystem::OpenWriteFromFile(
+//			 const std::string &, const std::string &)
+//		Purpose: Starts writing a new object, moving a local file
+//			 into place as its contents, which is then converted
+//			 to RAID when it's committed. Returns NULL if the
+//			 local file is on another filesystem.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::auto_ptr<BackupFileSystemWrite> RaidBackupFileSystem::OpenWriteFromFile(
+	const std::string &rFilename, const std::string &rLocalFilename)
+{
+	SyncIfPending(rFilename);
+	std::auto_ptr<RaidBackupFileSystemWrite> apFile(
+		new RaidBackupFileSystemWrite(mDiscSet, rFilename,
+			mpSyncGroup));
+	if(!apFile->OpenFromFile(rLocalFilename))
+	{
+		return std::auto_ptr<BackupFileSystemWrite>();
+	}
+	return std::auto_ptr<BackupFileSystemWrite>(apFile.release());
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidBackupFileSystem::ObjectExists(const std::string &,
+//			 int64_t *)
+//		Purpose: Does the object exist? If so, returns its revision
+//			 ID if requested.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool RaidBackupFileSystem::ObjectExists(const std::string &rFilename,
+	int64_t *pRevisionID)
+{
+	// A pending commit has the same revision ID as it will once it's in
+	// place, so there's no need to sync it yet
+	if(mpSyncGroup && mpSyncGroup->IsPending(mDiscSet, rFilename,
+		pRevisionID))
+	{
+		return true;
+	}
+	return RaidFileRead::FileExists(mDiscSet, rFilename, pRevisionID);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidBackupFileSystem::DeleteObject(const std::string &)
+//		Purpose: Deletes an object
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidBackupFileSystem::DeleteObject(const std::string &rFilename)
+{
+	SyncIfPending(rFilename);
+	RaidFileWrite del(mDiscSet, rFilename);
+	del.Delete();
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidBackupFileSystem::ListObjects(const std::string &,
+//			 std::vector<std::string> &)
+//		Purpose: Returns the names of the objects in a directory
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidBackupFileSystem::ListObjects(const std::string &rDirName,
+	std::vector<std::string> &rOutput)
+{
+	// Pending commits aren't in the directory yet
+	if(mpSyncGroup)
+	{
+		mpSyncGroup->Sync();
+	}
+	RaidFileRead::ReadDirectoryContents(mDiscSet, rDirName,
+		RaidFileRead::DirReadType_FilesOnly, rOutput);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidBackupFileSystem::EnsureDirectoryExists(
+//			 const std::string &)
+//		Purpose: Creates a directory and its parents, if necessary
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidBackupFileSystem::EnsureDirectoryExists(const std::string &rDirName)
+{
+	if(!RaidFileRead::DirectoryExists(mDiscSet, rDirName))
+	{
+		RaidFileWrite::CreateDirectory(mDiscSet, rDirName,
+			true /* recursive */);
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidBackupFileSystem::SyncIfPending(const std::string &)
+//		Purpose: Syncs the group, if the object has a commit in it
+//			 which isn't in place yet
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidBackupFileSystem::SyncIfPending(const std::string &rFilename)
+{
+	if(mpSyncGroup && mpSyncGroup->IsPending(mDiscSet, rFilename))
+	{
+		mpSyncGroup->Sync();
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidBackupFileSystem::GetSizeInBlocks(int64_t)
+//		Purpose: Returns the number of blocks which an object of
+//			 the given size uses on disc
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int64_t RaidBackupFileSystem::GetSizeInBlocks(int64_t Bytes)
+{
+	RaidFileController &rcontroller(RaidFileController::GetController());
+	return RaidFileUtil::DiscUsageInBlocks(Bytes,
+		rcontroller.GetDiscSet(mDiscSet));
+}
+
+// Returns a revision ID for an object with this ETag, which for objects
+// uploaded in one piece is the MD5 digest of their contents.
+static int64_t RevisionFromETag(const std::string &rETag)
+{
+	std::string etag(rETag);
+	if(etag.size() >= 2 && etag[0] == '"' && etag[etag.size() - 1] == '"')
+	{
+		etag = etag.substr(1, etag.size() - 2);
+	}
+
+	uint64_t revision = 0;
+	for(int i = 0; i < 16 && i < (int)etag.size(); i++)
+	{
+		char c = etag[i];
+		int digit = (c >= '0' && c <= '9') ? (c - '0') :
+			(c >= 'a' && c <= 'f') ? (c - 'a' + 10) :
+			(c >= 'A' && c <= 'F') ? (c - 'A' + 10) : 0;
+		revision = (revision << 4) | digit;
+	}
+
+	// Zero means no revision
+	return (revision == 0) ? 1 : (int64_t)revision;
+}
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    S3BackupFileSystemWrite
+//		Purpose: An object being written to an S3BackupFileSystem.
+//			 Once enough has been written to keep all of the
+//			 S3Client's connections busy, a multipart upload is
+//			 started and the whole parts sent, so that large
+//			 objects are never held in memory. Smaller objects
+//			 are uploaded in one piece when committed.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class S3BackupFileSystemWrite : public BackupFileSystemWrite
+{
+public:
+	S3BackupFileSystemWrite(S3BackupFileSystem &rFileSystem,
+		const std::string &rFilename)
+	: mrFileSystem(rFileSystem),
+	  mFilename(rFilename),
+	  mURI(rFileSystem.GetObjectURI(rFilename)),
+	  mapBuffer(new CollectInBufferStream()),
+	  mSize(0)
+	{ }
+	virtual ~S3BackupFileSystemWrite() { Discard(); }
+
+	virtual void Write(const void *pBuffer, int NBytes,
+		int Timeout = IOStream::TimeOutInfinite)
+	{
+		if(!mapBuffer.get())
+		{
+			THROW_EXCEPTION(BackupStoreException, Internal)
+		}
+		mapBuffer->Write(pBuffer, NBytes, Timeout);
+		mSize += NBytes;
+
+		if(mapBuffer->GetSize() >= mrFileSystem.GetPartSize() *
+			mrFileSystem.GetClient().GetMaxConnections())
+		{
+			UploadWholeParts();
+		}
+	}
+	virtual pos_type GetPosition() const { return mSize; }
+	virtual void Commit();
+	virtual void Discard();
+	virtual int64_t GetDiscUsageInBlocks()
+	{
+		return mrFileSystem.GetSizeInBlocks(mSize);
+	}
+
+private:
+	void UploadWholeParts();
+
+	S3BackupFileSystem &mrFileSystem;
+	std::string mFilename;
+	std::string mURI;
+	// The data written since the last part was sent
+	std::auto_ptr<CollectInBufferStream> mapBuffer;
+	int64_t mSize;
+	// Set once a multipart upload has been started
+	std::string mUploadID;
+	std::vector<std::string> mPartETags;
+};
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3BackupFileSystemWrite::UploadWholeParts()
+//		Purpose: Starts a multipart upload, if it hasn't been
+//			 started already, and sends as many whole parts as
+//			 have been written, keeping the rest for later
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void S3BackupFileSystemWrite::UploadWholeParts()
+{
+	S3Client &rClient(mrFileSystem.GetClient());
+	int partSize = mrFileSystem.GetPartSize();
+	int wholeParts = (mapBuffer->GetSize() / partSize) * partSize;
+
+	if(mUploadID.empty())
+	{
+		mUploadID = rClient.InitiateMultipartUpload(mURI);
+	}
+
+	MemBlockStream parts(mapBuffer->GetBuffer(), wholeParts);
+	rClient.UploadParts(mURI, mUploadID, parts, partSize, mPartETags);
+
+	std::auto_ptr<CollectInBufferStream> apRest(new CollectInBufferStream());
+	apRest->Write((const char *)mapBuffer->GetBuffer() + wholeParts,
+		mapBuffer->GetSize() - wholeParts);
+	mapBuffer = apRest;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3BackupFileSystemWrite::Commit()
+//		Purpose: Uploads the rest of the object, replacing any
+//			 existing one, and caches it with its new ETag if
+//			 it's small enough. The old cached copy is removed
+//			 first, so that the cache can't be left out of date
+//			 if the upload fails.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void S3BackupFileSystemWrite::Commit()
+{
+	if(!mapBuffer.get())
+	{
+		THROW_EXCEPTION(BackupStoreException, Internal)
+	}
+
+	S3Client &rClient(mrFileSystem.GetClient());
+	int partSize = mrFileSystem.GetPartSize();
+	mapBuffer->SetForReading();
+	mrFileSystem.RemoveFromCache(mFilename);
+
+	// Only objects uploaded in one piece have their MD5 digest as their
+	// ETag, which is what a GET returns for them.
+	std::string etag;
+	if(!mUploadID.empty())
+	{
+		if(mapBuffer->GetSize() > 0)
+		{
+			rClient.UploadParts(mURI, mUploadID, *mapBuffer,
+				partSize, mPartETags);
+		}
+		rClient.CompleteMultipartUpload(mURI, mUploadID, mPartETags);
+		mUploadID.clear();
+	}
+	else if(mSize > partSize)
+	{
+		HTTPResponse response = rClient.PutObjectMultipart(mURI,
+			*mapBuffer, partSize);
+		rClient.CheckResponse(response, "Failed to upload object: " +
+			mURI);
+	}
+	else
+	{
+		HTTPResponse response = rClient.PutObject(mURI, *mapBuffer);
+		rClient.CheckResponse(response, "Failed to upload object: " +
+			mURI);
+		response.GetHeader("ETag", &etag);
+	}
+
+	if(mSize <= S3_CACHE_MAX_OBJECT_SIZE && !etag.empty())
+	{
+		mapBuffer->Seek(0, IOStream::SeekType_Absolute);
+		mrFileSystem.AddToCache(mFilename, etag, *mapBuffer);
+	}
+
+	mapBuffer.reset();
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3BackupFileSystemWrite::Discard()
+//		Purpose: Abandons the object, aborting any multipart upload
+//			 so that S3 doesn't keep its parts. Doesn't throw
+//			 exceptions, as it's called by the destructor.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void S3BackupFileSystemWrite::Discard()
+{
+	mapBuffer.reset();
+	if(mUploadID.empty())
+	{
+		return;
+	}
+
+	std::string uploadID = mUploadID;
+	mUploadID.clear();
+	try
+	{
+		HTTPResponse response = mrFileSystem.GetClient().
+			AbortMultipartUpload(mURI, uploadID);
+		if(response.GetResponseCode() != HTTPResponse::Code_NoContent)
+		{
+			BOX_WARNING("Failed to abort upload of " << mURI <<
+				" to S3, its parts may remain: HTTP status " <<
+				response.GetResponseCode());
+		}
+	}
+	catch(BoxException &e)
+	{
+		BOX_WARNING("Failed to abort upload of " << mURI << " to S3, "
+			"its parts may remain: " << e.what());
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    S3RangeReadStream
+//		Purpose: Reads an object from S3 which is too large to
+//			 download in one piece, a range of bytes at a time,
+//			 as it's needed. Throws an exception if the object
+//			 is replaced while it's being read.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class S3RangeReadStream : public IOStream
+{
+public:
+	S3RangeReadStream(S3Client &rClient, const std::string &rURI,
+		const std::string &rETag, int64_t Size, int RangeSize,
+		const HTTPResponse &rFirstRange)
+	: mrClient(rClient),
+	  mURI(rURI),
+	  mETag(rETag),
+	  mSize(Size),
+	  mRangeSize(RangeSize),
+	  mPosition(0),
+	  mRangeStart(0),
+	  mRange((const char *)rFirstRange.GetBuffer(),
+		rFirstRange.GetSize())
+	{ }
+
+	virtual int Read(void *pBuffer, int NBytes,
+		int Timeout = IOStream::TimeOutInfinite);
+	virtual pos_type BytesLeftToRead() { return mSize - mPosition; }
+	virtual void Write(const void *pBuffer, int NBytes,
+		int Timeout = IOStream::TimeOutInfinite)
+	{
+		THROW_EXCEPTION(CommonException, NotSupported)
+	}
+	virtual pos_type GetPosition() const { return mPosition; }
+	virtual void Seek(pos_type Offset, int SeekType);
+	virtual bool StreamDataLeft() { return mPosition < mSize; }
+	virtual bool StreamClosed() { return true; }
+
+private:
+	void ReadRange();
+
+	S3Client &mrClient;
+	std::string mURI;
+	std::string mETag;
+	int64_t mSize;
+	int mRangeSize;
+	int64_t mPosition;
+	// The range most recently downloaded, and where it starts
+	int64_t mRangeStart;
+	std::string mRange;
+};
+
+int S3RangeReadStream::Read(void *pBuffer, int NBytes, int Timeout)
+{
+	if(mPosition >= mSize)
+	{
+		return 0;
+	}
+
+	if(mPosition < mRangeStart ||
+		mPosition >= mRangeStart + (int64_t)mRange.size())
+	{
+		ReadRange();
+	}
+
+	int64_t offset = mPosition - mRangeStart;
+	int bytes = NBytes;
+	if(bytes > (int64_t)mRange.size() - offset)
+	{
+		bytes = mRange.size() - offset;
+	}
+	::memcpy(pBuffer, mRange.c_str() + offset, bytes);
+	mPosition += bytes;
+	return bytes;
+}
+
+void S3RangeReadStream::Seek(pos_type Offset, int SeekType)
+{
+	pos_type newPos = 0;
+	switch(SeekType)
+	{
+	case IOStream::SeekType_Absolute:
+		newPos = Offset;
+		break;
+	case IOStream::SeekType_Relative:
+		newPos = mPosition + Offset;
+		break;
+	case IOStream::SeekType_End:
+		newPos = mSize + Offset;
+		break;
+	default:
+		THROW_EXCEPTION(CommonException, IOStreamBadSeekType)
+	}
+
+	// As MemBlockStream does, stay within the object
+	mPosition = (newPos < 0) ? 0 : (newPos > mSize) ? mSize : newPos;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3RangeReadStream::ReadRange()
+//		Purpose: Downloads the range of the object which starts at
+//			 the current position
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void S3RangeReadStream::ReadRange()
+{
+	int64_t length = mSize - mPosition;
+	if(length > mRangeSize)
+	{
+		length = mRangeSize;
+	}
+
+	HTTPResponse response = mrClient.GetObjectRange(mURI, mPosition,
+		length);
+	if(response.GetResponseCode() != HTTPResponse::Code_PartialContent)
+	{
+		mrClient.CheckResponse(response, "Failed to download part of "
+			"object: " + mURI);
+		THROW_EXCEPTION_MESSAGE(HTTPException, BadResponse,
+			"S3 did not return the part of " << mURI << " which "
+			"was requested");
+	}
+
+	std::string etag;
+	response.GetHeader("ETag", &etag);
+	if(etag != mETag || response.GetSize() != length)
+	{
+		THROW_EXCEPTION_MESSAGE(BackupStoreException,
+			ObjectChangedWhileReading, "Object in S3 was replaced "
+			"while it was being read: " << mURI);
+	}
+
+	mRangeStart = mPosition;
+	mRange.assign((const char *)response.GetBuffer(), response.GetSize());
+}
+
+// Returns the size of the whole object from the Content-Range header of a
+// 206 Partial Content response, or -1 if it's not there.
+static int64_t GetSizeFromContentRange(const HTTPResponse &rResponse)
+{
+	std::string contentRange;
+	if(!rResponse.GetHeader("Content-Range", &contentRange))
+	{
+		return -1;
+	}
+
+	std::string::size_type slash = contentRange.find('/');
+	if(slash == std::string::npos || slash + 1 >= contentRange.size())
+	{
+		return -1;
+	}
+
+	const char *pSize = contentRange.c_str() + slash + 1;
+	char *pEnd = NULL;
+	int64_t size = ::strtoll(pSize, &pEnd, 10);
+	return (pEnd == pSize || *pEnd != '\0') ? -1 : size;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3BackupFileSystem::S3BackupFileSystem(
+//			 const Configuration &, const std::string &,
+//			 S3Client &)
+//		Purpose: Constructor for a store in S3 under the given
+//			 base path, using an existing connection
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+S3BackupFileSystem::S3BackupFileSystem(const Configuration& config,
+	const std::string& BasePath, S3Client& rClient)
+: mBasePath(BasePath),
+  mrClient(rClient),
+  mCacheKeyPrefix(rClient.GetHostName()),
+  mBlockSize(S3_NOTIONAL_BLOCK_SIZE),
+  mPartSize(S3CLIENT_DEFAULT_PART_SIZE),
+  mHaveWriteLock(false)
+{ }
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3BackupFileSystem::S3BackupFileSystem(
+//			 const Configuration &, int)
+//		Purpose: Constructor for a store in S3, with its own
+//			 connection, configured by an S3Store section, and
+//			 accounting for space in blocks of the given size.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+S3BackupFileSystem::S3BackupFileSystem(const Configuration& rS3Config,
+	int BlockSize)
+: mapOwnClient(new S3Client(rS3Config.GetKeyValue("HostName"),
+	rS3Config.GetKeyValueInt("Port"),
+	rS3Config.GetKeyValue("AccessKey"),
+	rS3Config.GetKeyValue("SecretKey"))),
+  mBasePath(rS3Config.GetKeyValue("BasePath")),
+  mrClient(*mapOwnClient),
+  mCacheKeyPrefix(rS3Config.GetKeyValue("HostName")),
+  mBlockSize(BlockSize),
+  mPartSize(S3CLIENT_DEFAULT_PART_SIZE),
+  mHaveWriteLock(false)
+{
+	if(mBasePath.size() == 0)
+	{
+		mBasePath = "/";
+	}
+	else if(mBasePath[0] != '/' || mBasePath[mBasePath.size() - 1] != '/')
+	{
+		THROW_EXCEPTION_MESSAGE(CommonException, InvalidConfiguration,
+			"If S3Store.BasePath is not empty then it must start "
+			"and end with a slash, e.g. '/subdir/', but it "
+			"currently does not.");
+	}
+
+	if(rS3Config.KeyExists("CacheDirectory"))
+	{
+		mCacheDirectory = rS3Config.GetKeyValue("CacheDirectory");
+		if(::ObjectExists(mCacheDirectory) == ObjectExists_NoObject &&
+			::mkdir(mCacheDirectory.c_str(), 0700) != 0)
+		{
+			THROW_SYS_FILE_ERROR("Failed to create S3 cache "
+				"directory", mCacheDirectory, CommonException,
+				OSFileError);
+		}
+	}
+}
+
+S3BackupFileSystem::~S3BackupFileSystem()
+{
+}
+
+std::string S3BackupFileSystem::GetDirectoryURI(int64_t ObjectID)
+{
+	std::ostringstream out;
+	out << mBasePath << "dirs/" << BOX_FORMAT_OBJECTID(ObjectID) << ".dir";
+	return out.str();
+}
+
+std::auto_ptr<HTTPResponse> S3BackupFileSystem::GetDirectory(BackupStoreDirectory& rDir)
+{
+	std::string uri = GetDirectoryURI(rDir.GetObjectID());
+	HTTPResponse response = mrClient.GetObject(uri);
+	mrClient.CheckResponse(response,
+		std::string("Failed to download directory: ") + uri);
+	return std::auto_ptr<HTTPResponse>(new HTTPResponse(response));
+}
+
+int S3BackupFileSystem::PutDirectory(BackupStoreDirectory& rDir)
+{
+	CollectInBufferStream out;
+	rDir.WriteToStream(out);
+	out.SetForReading();
+
+	std::string uri = GetDirectoryURI(rDir.GetObjectID());
+	HTTPResponse response = mrClient.PutObject(uri, out);
+	mrClient.CheckResponse(response,
+		std::string("Failed to upload directory: ") + uri);
+
+	int blocks = (out.GetSize() + S3_NOTIONAL_BLOCK_SIZE - 1) / S3_NOTIONAL_BLOCK_SIZE;
+	return blocks;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3BackupFileSystem::GetObjectURI(const std::string &)
+//		Purpose: Returns the URI of the object with the given name
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::string S3BackupFileSystem::GetObjectURI(const std::string &rFilename) const
+{
+	std::string uri = mBasePath + rFilename;
+#ifdef WIN32
+	for(std::string::iterator i = uri.begin(); i != uri.end(); i++)
+	{
+		if(*i == DIRECTORY_SEPARATOR_ASCHAR)
+		{
+			*i = '/';
+		}
+	}
+#endif
+	return uri;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3BackupFileSystem::GetCacheFilename(
+//			 const std::string &)
+//		Purpose: Returns the name of the file in the cache directory
+//			 which would hold a copy of the object, made from the
+//			 host name (which includes the bucket) and the full
+//			 URI of the object, so that stores which share a
+//			 cache directory can't see each other's objects, and
+//			 flattened so that no subdirectories are needed
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::string S3BackupFileSystem::GetCacheFilename(const std::string &rFilename) const
+{
+	std::string key = mCacheKeyPrefix + GetObjectURI(rFilename);
+	std::string filename = mCacheDirectory + DIRECTORY_SEPARATOR;
+	for(std::string::const_iterator i = key.begin(); i != key.end(); i++)
+	{
+		switch(*i)
+		{
+		case '%':  filename += "%25"; break;
+		case '/':  filename += "%2F"; break;
+		case ':':  filename += "%3A"; break;
+		case '\\': filename += "%5C"; break;
+		default:   filename += *i;
+		}
+	}
+	return filename;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3BackupFileSystem::AddToCache(const std::string &,
+//			 const std::string &, IOStream &)
+//		Purpose: Stores a copy of an object, with the ETag of that
+//			 version of it, in the cache directory, if there is
+//			 one and this process has the write lock
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void S3BackupFileSystem::AddToCache(const std::string &rFilename,
+	const std::string &rETag, IOStream &rData)
+{
+	if(mCacheDirectory.empty() || !mHaveWriteLock)
+	{
+		return;
+	}
+
+	std::string cacheFile = GetCacheFilename(rFilename);
+	std::string tempFile = cacheFile + ".part";
+	{
+		FileStream out(tempFile, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY);
+		std::string header = rETag + "\n";
+		out.Write(header.c_str(), header.size());
+		rData.CopyStreamTo(out);
+	}
+
+#ifdef WIN32
+	EMU_UNLINK(cacheFile.c_str());
+#endif
+	if(::rename(tempFile.c_str(), cacheFile.c_str()) != 0)
+	{
+		THROW_SYS_FILE_ERROR("Failed to add object to S3 cache",
+			cacheFile, CommonException, OSFileError);
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3BackupFileSystem::RemoveFromCache(const std::string &)
+//		Purpose: Removes any cached copy of an object, if this
+//			 process has the write lock
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void S3BackupFileSystem::RemoveFromCache(const std::string &rFilename)
+{
+	if(mCacheDirectory.empty() || !mHaveWriteLock)
+	{
+		return;
+	}
+
+	std::string cacheFile = GetCacheFilename(rFilename);
+	if(EMU_UNLINK(cacheFile.c_str()) != 0 && errno != ENOENT)
+	{
+		THROW_SYS_FILE_ERROR("Failed to remove object from S3 cache",
+			cacheFile, CommonException, OSFileError);
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3BackupFileSystem::ReadFromCache(const std::string &,
+//			 std::string &)
+//		Purpose: Returns the cached copy of an object, if there is
+//			 one, and the ETag that it had, or NULL if not
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::auto_ptr<IOStream> S3BackupFileSystem::ReadFromCache(
+	const std::string &rFilename, std::string &rETagOut)
+{
+	std::auto_ptr<IOStream> apNone;
+	std::string cacheFile = GetCacheFilename(rFilename);
+	if(mCacheDirectory.empty() || !FileExists(cacheFile))
+	{
+		return apNone;
+	}
+
+	std::string contents;
+	{
+		FileStream file(cacheFile);
+		char buffer[4096];
+		while(file.StreamDataLeft())
+		{
+			int bytes = file.Read(buffer, sizeof(buffer));
+			contents.append(buffer, bytes);
+		}
+	}
+
+	std::string::size_type eol = contents.find('\n');
+	if(eol == std::string::npos || eol == 0)
+	{
+		BOX_WARNING("Ignoring invalid S3 cache file: " << cacheFile);
+		return apNone;
+	}
+
+	rETagOut = contents.substr(0, eol);
+	std::auto_ptr<CollectInBufferStream> apData(new CollectInBufferStream());
+	apData->Write(contents.c_str() + eol + 1, contents.size() - eol - 1);
+	apData->SetForReading();
+	return std::auto_ptr<IOStream>(apData.release());
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3BackupFileSystem::OpenRead(const std::string &,
+//			 int64_t *)
+//		Purpose: Opens an object for reading, returning its
+//			 revision ID if requested. If it's cached, only
+//			 downloads it again if it has changed since. Only the
+//			 first part of a large object is downloaded now, and
+//			 the rest as it's read.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::auto_ptr<BackupFileSystemRead> S3BackupFileSystem::OpenRead(
+	const std::string &rFilename, int64_t *pRevisionID)
+{
+	std::string uri = GetObjectURI(rFilename);
+	std::string etag;
+	std::auto_ptr<IOStream> apCached = ReadFromCache(rFilename, etag);
+
+	HTTPResponse response = mrClient.GetObjectRange(uri, 0, mPartSize,
+		etag);
+	if(response.GetResponseCode() ==
+		HTTPResponse::Code_RangeNotSatisfiable)
+	{
+		// The object is empty, so there's no range to return
+		response = mrClient.GetObject(uri);
+	}
+	if(response.GetResponseCode() == HTTPResponse::Code_NotFound)
+	{
+		RemoveFromCache(rFilename);
+		THROW_EXCEPTION_MESSAGE(BackupStoreException,
+			ObjectDoesNotExist, "Object not found in S3: " << uri);
+	}
+
+	std::auto_ptr<IOStream> apData;
+	int64_t size;
+	if(apCached.get() &&
+		response.GetResponseCode() == HTTPResponse::Code_NotModified)
+	{
+		apData = apCached;
+		size = apData->BytesLeftToRead();
+	}
+	else
+	{
+		// S3 may send the whole object instead of the range
+		size = response.GetSize();
+		if(response.GetResponseCode() ==
+			HTTPResponse::Code_PartialContent)
+		{
+			size = GetSizeFromContentRange(response);
+			if(size < response.GetSize())
+			{
+				THROW_EXCEPTION_MESSAGE(HTTPException,
+					BadResponse, "S3 did not return the "
+					"size of object: " << uri);
+			}
+		}
+		else
+		{
+			mrClient.CheckResponse(response,
+				"Failed to download object: " + uri);
+		}
+		etag.clear();
+		response.GetHeader("ETag", &etag);
+
+		if(size > response.GetSize())
+		{
+			RemoveFromCache(rFilename);
+			apData.reset(new S3RangeReadStream(mrClient, uri, etag,
+				size, mPartSize, response));
+		}
+		else
+		{
+			std::auto_ptr<CollectInBufferStream> apBuffer(
+				new CollectInBufferStream());
+			apBuffer->Write(response.GetBuffer(),
+				response.GetSize());
+			apBuffer->SetForReading();
+
+			if(size <= S3_CACHE_MAX_OBJECT_SIZE && !etag.empty())
+			{
+				AddToCache(rFilename, etag, *apBuffer);
+				apBuffer->Seek(0, IOStream::SeekType_Absolute);
+			}
+			else
+			{
+				RemoveFromCache(rFilename);
+			}
+
+			apData.reset(apBuffer.release());
+		}
+	}
+
+	if(pRevisionID)
+	{
+		*pRevisionID = RevisionFromETag(etag);
+	}
+
+	return std::auto_ptr<BackupFileSystemRead>(new BackupFileSystemRead(
+		apData, size, GetSizeInBlocks(size)));
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3BackupFileSystem::OpenWrite(const std::string &,
+//			 bool)
+//		Purpose: Starts writing an object, which must be committed
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::auto_ptr<BackupFileSystemWrite> S3BackupFileSystem::OpenWrite(
+	const std::string &rFilename, bool AllowOverwrite)
+{
+	if(!AllowOverwrite && ObjectExists(rFilename))
+	{
+		THROW_EXCEPTION_MESSAGE(BackupStoreException,
+			ObjectAlreadyExists, "Object already exists in S3: " <<
+			GetObjectURI(rFilename));
+	}
+
+	return std::auto_ptr<BackupFileSystemWrite>(
+		new S3BackupFileSystemWrite(*this, rFilename));
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3BackupFileSystem::ObjectExists(const std::string &,
+//			 int64_t *)
+//		Purpose: Does the object exist? If so, returns its revision
+//			 ID if requested. Always asks the store, since
+//			 another process may have changed it.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool S3BackupFileSystem::ObjectExists(const std::string &rFilename,
+	int64_t *pRevisionID)
+{
+	std::string uri = GetObjectURI(rFilename);
+	HTTPResponse response = mrClient.HeadObject(uri);
+	if(response.GetResponseCode() == HTTPResponse::Code_NotFound)
+	{
+		return false;
+	}
+	mrClient.CheckResponse(response, "Failed to check for object: " + uri);
+
+	if(pRevisionID)
+	{
+		std::string etag;
+		response.GetHeader("ETag", &etag);
+		*pRevisionID = RevisionFromETag(etag);
+	}
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3BackupFileSystem::DeleteObject(const std::string &)
+//		Purpose: Deletes an object, and any cached copy of it
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void S3BackupFileSystem::DeleteObject(const std::string &rFilename)
+{
+	RemoveFromCache(rFilename);
+
+	std::string uri = GetObjectURI(rFilename);
+	HTTPResponse response = mrClient.DeleteObject(uri);
+	// Deleting an object which doesn't exist is not an error
+	if(response.GetResponseCode() != HTTPResponse::Code_NoContent &&
+		response.GetResponseCode() != HTTPResponse::Code_NotFound)
+	{
+		mrClient.CheckResponse(response, "Failed to delete object: " +
+			uri);
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3BackupFileSystem::ListObjects(const std::string &,
+//			 std::vector<std::string> &)
+//		Purpose: Returns the names of the objects in a directory,
+//			 i.e. whose keys start with the directory's name and
+//			 have no more slashes after it
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void S3BackupFileSystem::ListObjects(const std::string &rDirName,
+	std::vector<std::string> &rOutput)
+{
+	// Keys don't start with a slash
+	std::string prefix = GetObjectURI(rDirName).substr(1);
+	if(!prefix.empty() && prefix[prefix.size() - 1] != '/')
+	{
+		prefix += '/';
+	}
+
+	std::vector<std::string> keys;
+	mrClient.ListBucket(&keys, NULL, prefix, "/");
+
+	for(std::vector<std::string>::iterator i = keys.begin();
+		i != keys.end(); i++)
+	{
+		rOutput.push_back(i->substr(prefix.size()));
+	}
+}
@@ -0,0 +1,281 @@
+// --------------------------------------------------------------------------
+//
+// File
+//		Name:    BackupFileSystem.h
+//		Purpose: Storage backends for the objects in a backup store
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+#ifndef BACKUPFILESYSTEM__H
+#define BACKUPFILESYSTEM__H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "IOStream.h"
+
+class BackupStoreDirectory;
+class Configuration;
+class HTTPResponse;
+class RaidFileSyncGroup;
+class S3Client;
+
+// Size of the blocks used to account for space used by objects in S3 stores
+#define S3_NOTIONAL_BLOCK_SIZE		1048576
+
+// Objects up to this size are kept in the local cache of an S3 store, which
+// includes almost all directories
+#define S3_CACHE_MAX_OBJECT_SIZE	(256*1024)
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    BackupFileSystemRead
+//		Purpose: An object opened for reading from a BackupFileSystem
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class BackupFileSystemRead : public IOStream
+{
+public:
+	BackupFileSystemRead(std::auto_ptr<IOStream> apStream, int64_t FileSize,
+		int64_t DiscUsageInBlocks)
+	: mapStream(apStream),
+	  mFileSize(FileSize),
+	  mDiscUsageInBlocks(DiscUsageInBlocks)
+	{ }
+
+	virtual int Read(void *pBuffer, int NBytes,
+		int Timeout = IOStream::TimeOutInfinite)
+	{
+		return mapStream->Read(pBuffer, NBytes, Timeout);
+	}
+	virtual pos_type BytesLeftToRead()
+	{
+		return mFileSize - mapStream->GetPosition();
+	}
+	virtual void Write(const void *pBuffer, int NBytes,
+		int Timeout = IOStream::TimeOutInfinite)
+	{
+		mapStream->Write(pBuffer, NBytes, Timeout);
+	}
+	virtual pos_type GetPosition() const
+	{
+		return mapStream->GetPosition();
+	}
+	virtual void Seek(pos_type Offset, int SeekType)
+	{
+		mapStream->Seek(Offset, SeekType);
+	}
+	virtual void Close() { mapStream->Close(); }
+	virtual bool StreamDataLeft() { return mapStream->StreamDataLeft(); }
+	virtual bool StreamClosed() { return mapStream->StreamClosed(); }
+
+	int64_t GetFileSize() const { return mFileSize; }
+	int64_t GetDiscUsageInBlocks() const { return mDiscUsageInBlocks; }
+
+private:
+	std::auto_ptr<IOStream> mapStream;
+	int64_t mFileSize;
+	int64_t mDiscUsageInBlocks;
+};
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    BackupFileSystemWrite
+//		Purpose: An object being written to a BackupFileSystem, which
+//			 only appears in the store when committed, replacing
+//			 any existing object with the same name, and is
+//			 discarded if destroyed without being committed.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class BackupFileSystemWrite : public IOStream
+{
+public:
+	virtual ~BackupFileSystemWrite() { }
+	virtual int Read(void *pBuffer, int NBytes,
+		int Timeout = IOStream::TimeOutInfinite);
+	virtual bool StreamDataLeft() { return false; }
+	virtual bool StreamClosed() { return false; }
+	virtual void Commit() = 0;
+	virtual void Discard() = 0;
+	virtual int64_t GetDiscUsageInBlocks() = 0;
+};
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    BackupFileSystem
+//		Purpose: Interface to wherever the files and directories of
+//			 a backup store account are kept. Objects are named
+//			 as RaidFiles are, by a path relative to the store,
+//			 and directories in those paths may or may not need
+//			 to be created, so EnsureDirectoryExists() must be
+//			 called before writing. Revision IDs change whenever
+//			 an object is replaced, so they can be used to tell
+//			 whether a cached copy is out of date.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class BackupFileSystem
+{
+public:
+	BackupFileSystem() { }
+	virtual ~BackupFileSystem() { }
+private:
+	BackupFileSystem(const BackupFileSystem &rToCopy);
+
+public:
+	virtual std::auto_ptr<BackupFileSystemRead> OpenRead(
+		const std::string &rFilename, int64_t *pRevisionID = 0) = 0;
+	virtual std::auto_ptr<BackupFileSystemWrite> OpenWrite(
+		const std::string &rFilename, bool AllowOverwrite = false) = 0;
+	// Starts writing a new object with the contents of a local file,
+	// which is moved instead of copied. Returns NULL if that's not
+	// possible, so the caller should copy it with OpenWrite() instead.
+	virtual std::auto_ptr<BackupFileSystemWrite> OpenWriteFromFile(
+		const std::string &rFilename, const std::string &rLocalFilename)
+	{
+		return std::auto_ptr<BackupFileSystemWrite>();
+	}
+	virtual bool ObjectExists(const std::string &rFilename,
+		int64_t *pRevisionID = 0) = 0;
+	virtual void DeleteObject(const std::string &rFilename) = 0;
+	virtual void ListObjects(const std::string &rDirName,
+		std::vector<std::string> &rOutput) = 0;
+	virtual void EnsureDirectoryExists(const std::string &rDirName) = 0;
+	virtual int64_t GetSizeInBlocks(int64_t Bytes) = 0;
+	// Only the process holding the account's write lock may change any
+	// local copies of objects, so it's told when it has the lock.
+	virtual void SetHaveWriteLock(bool HaveWriteLock) { }
+};
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    RaidBackupFileSystem
+//		Purpose: Keeps objects as RaidFiles on a local disc set,
+//			 converted to RAID as they are written. If a sync
+//			 group is given, committed objects are added to it,
+//			 and it's synced before one of them is read or
+//			 deleted, as they aren't in place until then.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class RaidBackupFileSystem : public BackupFileSystem
+{
+public:
+	RaidBackupFileSystem(int DiscSet, RaidFileSyncGroup *pSyncGroup = NULL)
+	: mDiscSet(DiscSet),
+	  mpSyncGroup(pSyncGroup)
+	{ }
+
+	virtual std::auto_ptr<BackupFileSystemRead> OpenRead(
+		const std::string &rFilename, int64_t *pRevisionID = 0);
+	virtual std::auto_ptr<BackupFileSystemWrite> OpenWrite(
+		const std::string &rFilename, bool AllowOverwrite = false);
+	virtual std::auto_ptr<BackupFileSystemWrite> OpenWriteFromFile(
+		const std::string &rFilename, const std::string &rLocalFilename);
+	virtual bool ObjectExists(const std::string &rFilename,
+		int64_t *pRevisionID = 0);
+	virtual void DeleteObject(const std::string &rFilename);
+	virtual void ListObjects(const std::string &rDirName,
+		std::vector<std::string> &rOutput);
+	virtual void EnsureDirectoryExists(const std::string &rDirName);
+	virtual int64_t GetSizeInBlocks(int64_t Bytes);
+
+private:
+	void SyncIfPending(const std::string &rFilename);
+
+	int mDiscSet;
+	RaidFileSyncGroup *mpSyncGroup;
+};
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    S3BackupFileSystem
+//		Purpose: Keeps objects in an Amazon S3 bucket, with keys
+//			 made by appending their names to a base path. Large
+//			 objects are uploaded in parts, several at once over
+//			 the S3Client's connections, as they are written, and
+//			 downloaded a part at a time as they are read, so
+//			 that only a few parts are ever held in memory. If a
+//			 cache directory is given, small objects (mostly
+//			 directories) are cached there with their ETags,
+//			 after they are read or written, so that they are
+//			 only downloaded again if they have changed. Any
+//			 process may read the cache, but only the one with
+//			 the account's write lock adds to it, and every
+//			 cached copy is checked against the store before it
+//			 is used, since another server, or the same one
+//			 configured with another BasePath, may share it.
+//		Created: 2015/06/27
+//
+// --------------------------------------------------------------------------
+class S3BackupFileSystem : public BackupFileSystem
+{
+private:
+	std::auto_ptr<S3Client> mapOwnClient;
+	std::string mBasePath;
+	S3Client& mrClient;
+	std::string mCacheDirectory;
+	// Distinguishes the objects of different stores in the cache
+	std::string mCacheKeyPrefix;
+	int mBlockSize;
+	int mPartSize;
+	bool mHaveWriteLock;
+
+public:
+	S3BackupFileSystem(const Configuration& config, const std::string& BasePath,
+		S3Client& rClient);
+	S3BackupFileSystem(const Configuration& rS3Config, int BlockSize);
+	~S3BackupFileSystem();
+
+	std::string GetDirectoryURI(int64_t ObjectID);
+	std::auto_ptr<HTTPResponse> GetDirectory(BackupStoreDirectory& rDir);
+	int PutDirectory(BackupStoreDirectory& rDir);
+
+	virtual std::auto_ptr<BackupFileSystemRead> OpenRead(
+		const std::string &rFilename, int64_t *pRevisionID = 0);
+	virtual std::auto_ptr<BackupFileSystemWrite> OpenWrite(
+		const std::string &rFilename, bool AllowOverwrite = false);
+	virtual bool ObjectExists(const std::string &rFilename,
+		int64_t *pRevisionID = 0);
+	virtual void DeleteObject(const std::string &rFilename);
+	virtual void ListObjects(const std::string &rDirName,
+		std::vector<std::string> &rOutput);
+	virtual void EnsureDirectoryExists(const std::string &rDirName) { }
+	virtual int64_t GetSizeInBlocks(int64_t Bytes)
+	{
+		return (Bytes + mBlockSize - 1) / mBlockSize;
+	}
+	virtual void SetHaveWriteLock(bool HaveWriteLock)
+	{
+		mHaveWriteLock = HaveWriteLock;
+	}
+
+	// The size of the parts in which objects are uploaded and downloaded.
+	// S3 requires every part of an upload but the last to be at least
+	// 5MB, so smaller parts are only for testing with the simulator.
+	int GetPartSize() const { return mPartSize; }
+	void SetPartSize(int PartSize) { mPartSize = PartSize; }
+
+	// Used by S3BackupFileSystemWrite
+	std::string GetObjectURI(const std::string &rFilename) const;
+	S3Client &GetClient() { return mrClient; }
+	std::string GetCacheFilename(const std::string &rFilename) const;
+	void RemoveFromCache(const std::string &rFilename);
+	void AddToCache(const std::string &rFilename, const std::string &rETag,
+		IOStream &rData);
+
+private:
+	std::auto_ptr<IOStream> ReadFromCache(const std::string &rFilename,
+		std::string &rETagOut);
+};
+
+#endif // BACKUPFILESYSTEM__H
@@ -15,6 +15,7 @@
 #include <cstring>
 #include <iostream>
 
+#include "BackupFileSystem.h"
 #include "BackupStoreAccounts.h"
 #include "BackupStoreAccountDatabase.h"
 #include "BackupStoreCheck.h"
@@ -25,6 +26,7 @@
 #include "BackupStoreInfo.h"
 #include "BackupStoreRefCountDatabase.h"
 #include "BoxPortsAndFiles.h"
+#include "Configuration.h"
 #include "HousekeepStoreAccount.h"
 #include "NamedLock.h"
 #include "RaidFileController.h"
@@ -65,14 +67,16 @@ BackupStoreAccounts::~BackupStoreAccounts()
 // --------------------------------------------------------------------------
 //
 // Function
-//		Name:    BackupStoreAccounts::Create(int32_t, int, int64_t, int64_t, const std::string &)
+//		Name:    BackupStoreAccounts::Create(int32_t, int, int64_t, int64_t, const std::string &, const Configuration *)
 //		Purpose: Create a new account on the specified disc set.
 //			 If rAsUsername is not empty, then the account information will be written under the
-//			 username specified.
+//			 username specified. If pS3StoreConfig is not NULL, the root directory is written to
+//			 the S3 store that it describes, instead of the disc set.
 //		Created: 2003/08/21
 //
 // --------------------------------------------------------------------------
-void BackupStoreAccounts::Create(int32_t ID, int DiscSet, int64_t SizeSoftLimit, int64_t SizeHardLimit, const std::string &rAsUsername)
+void BackupStoreAccounts::Create(int32_t ID, int DiscSet, int64_t SizeSoftLimit, int64_t SizeHardLimit, const std::string &rAsUsername,
+	const Configuration *pS3StoreConfig)
 {
 	// Create the entry in the database
 	BackupStoreAccountDatabase::Entry Entry(mrDatabase.AddEntry(ID,
@@ -102,6 +106,18 @@ void BackupStoreAccounts::Create(int32_t ID, int DiscSet, int64_t SizeSoftLimit,
 		BackupStoreDirectory rootDir(BACKUPSTORE_ROOT_DIRECTORY_ID, BACKUPSTORE_ROOT_DIRECTORY_ID);
 		int64_t rootDirSize = 0;
 		// Write it, knowing the directory scheme
+		if(pS3StoreConfig)
+		{
+			RaidFileController &rcontroller(RaidFileController::GetController());
+			S3BackupFileSystem fs(*pS3StoreConfig,
+				rcontroller.GetDiscSet(DiscSet).GetBlockSize());
+			std::auto_ptr<BackupFileSystemWrite> apWrite(
+				fs.OpenWrite(dirName + "o01"));
+			rootDir.WriteToStream(*apWrite);
+			rootDirSize = apWrite->GetDiscUsageInBlocks();
+			apWrite->Commit();
+		}
+		else
 		{
 			RaidFileWrite rf(DiscSet, dirName + "o01");
 			rf.Open();
@@ -497,8 +513,19 @@ bool BackupStoreAccountsControl::OpenAccount(int32_t ID, std::string &rRootDirOu
 }
 
 int BackupStoreAccountsControl::CheckAccount(int32_t ID, bool FixErrors, bool Quiet,
-	bool ReturnNumErrorsFound)
+	bool ReturnNumErrorsFound, int NumWorkers,
+	BackupStoreFile::VerifyLevel Level)
 {
+	// BackupStoreCheck only reads objects from the disc set, where an
+	// account kept in S3 has none. Fixing it would replace its store info
+	// and reference counts with those of an empty account.
+	if(mConfig.SubConfigurationExists("S3Store"))
+	{
+		BOX_ERROR("Cannot check account " << BOX_FORMAT_ACCOUNT(ID) <<
+			": checking accounts kept in S3 is not supported.");
+		return 1;
+	}
+
 	std::string rootDir;
 	int discSetNum;
 	std::auto_ptr<UnixUser> user; // used to reset uid when we return
@@ -513,7 +540,8 @@ int BackupStoreAccountsControl::CheckAccount(int32_t ID, bool FixErrors, bool Qu
 	}
 
 	// Check it
-	BackupStoreCheck check(rootDir, discSetNum, ID, FixErrors, Quiet);
+	BackupStoreCheck check(rootDir, discSetNum, ID, FixErrors, Quiet,
+		NumWorkers, Level);
 	check.Check();
 
 	if(ReturnNumErrorsFound)
@@ -552,9 +580,16 @@ int BackupStoreAccountsControl::CreateAccount(int32_t ID, int32_t DiscNumber,
 		}
 	}
 	
-	// Create it.
+	// Create it, with its root directory in S3 if the store is kept there
+	const Configuration *pS3StoreConfig = NULL;
+	if(mConfig.SubConfigurationExists("S3Store"))
+	{
+		pS3StoreConfig = &mConfig.GetSubConfiguration("S3Store");
+	}
+
 	BackupStoreAccounts acc(*db);
-	acc.Create(ID, DiscNumber, SoftLimit, HardLimit, username);
+	acc.Create(ID, DiscNumber, SoftLimit, HardLimit, username,
+		pS3StoreConfig);
 	
 	BOX_NOTICE("Account " << BOX_FORMAT_ACCOUNT(ID) << " created.");
 
@@ -575,7 +610,18 @@ int BackupStoreAccountsControl::HousekeepAccountNow(int32_t ID)
 		return 1;
 	}
 
-	HousekeepStoreAccount housekeeping(ID, rootDir, discSetNum, NULL);
+	// The account's files and directories may be kept in S3
+	std::auto_ptr<BackupFileSystem> apFileSystem;
+	if(mConfig.SubConfigurationExists("S3Store"))
+	{
+		RaidFileController &rcontroller(RaidFileController::GetController());
+		apFileSystem.reset(new S3BackupFileSystem(
+			mConfig.GetSubConfiguration("S3Store"),
+			rcontroller.GetDiscSet(discSetNum).GetBlockSize()));
+	}
+
+	HousekeepStoreAccount housekeeping(ID, rootDir, discSetNum, NULL,
+		apFileSystem.get());
 	bool success = housekeeping.DoHousekeeping();
 
 	if(!success)
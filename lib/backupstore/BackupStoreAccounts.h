@@ -14,8 +14,11 @@
 
 #include "BackupStoreAccountDatabase.h"
 #include "BackupAccountControl.h"
+#include "BackupStoreFile.h"
 #include "NamedLock.h"
 
+class Configuration;
+
 // --------------------------------------------------------------------------
 //
 // Class
@@ -34,7 +37,8 @@ private:
 
 public:
 	void Create(int32_t ID, int DiscSet, int64_t SizeSoftLimit,
-		int64_t SizeHardLimit, const std::string &rAsUsername);
+		int64_t SizeHardLimit, const std::string &rAsUsername,
+		const Configuration *pS3StoreConfig = NULL);
 
 	bool AccountExists(int32_t ID);
 	void GetAccountRoot(int32_t ID, std::string &rRootDirOut, int &rDiscSetOut) const;
@@ -72,7 +76,9 @@ public:
 	int SetAccountEnabled(int32_t ID, bool enabled);
 	int DeleteAccount(int32_t ID, bool AskForConfirmation);
 	int CheckAccount(int32_t ID, bool FixErrors, bool Quiet,
-		bool ReturnNumErrorsFound = false);
+		bool ReturnNumErrorsFound = false, int NumWorkers = 1,
+		BackupStoreFile::VerifyLevel Level =
+			BackupStoreFile::VerifyLevel_BlockIndex);
 	int CreateAccount(int32_t ID, int32_t DiscNumber, int32_t SoftLimit,
 		int32_t HardLimit);
 	int HousekeepAccountNow(int32_t ID);
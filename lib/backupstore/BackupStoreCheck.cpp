@@ -9,6 +9,7 @@
 
 #include "Box.h"
 
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -16,6 +17,14 @@
 #	include <unistd.h>
 #endif
 
+#ifdef HAVE_SIGNAL_H
+#	include <signal.h>
+#endif
+
+#ifdef HAVE_SYS_WAIT_H
+#	include <sys/wait.h>
+#endif
+
 #include "autogen_BackupStoreException.h"
 #include "BackupStoreAccountDatabase.h"
 #include "BackupStoreCheck.h"
@@ -24,6 +33,7 @@
 #include "BackupStoreFile.h"
 #include "BackupStoreObjectMagic.h"
 #include "BackupStoreRefCountDatabase.h"
+#include "FileStream.h"
 #include "RaidFileController.h"
 #include "RaidFileException.h"
 #include "RaidFileRead.h"
@@ -38,17 +48,26 @@
 // --------------------------------------------------------------------------
 //
 // Function
-//		Name:    BackupStoreCheck::BackupStoreCheck(const std::string &, int, int32_t, bool, bool)
-//		Purpose: Constructor
+//		Name:    BackupStoreCheck::BackupStoreCheck(const std::string &, int, int32_t, bool, bool, int,
+//			 BackupStoreFile::VerifyLevel)
+//		Purpose: Constructor. If NumWorkers is more than one, objects
+//			 are read and verified by that many worker processes
+//			 in phase 1. Level sets how much of each file they
+//			 read: just the headers for a quick check, or all of
+//			 it for a deep one. Directories are always read
+//			 completely.
 //		Created: 21/4/04
 //
 // --------------------------------------------------------------------------
-BackupStoreCheck::BackupStoreCheck(const std::string &rStoreRoot, int DiscSetNumber, int32_t AccountID, bool FixErrors, bool Quiet)
+BackupStoreCheck::BackupStoreCheck(const std::string &rStoreRoot, int DiscSetNumber, int32_t AccountID, bool FixErrors, bool Quiet,
+	int NumWorkers, BackupStoreFile::VerifyLevel Level)
 	: mStoreRoot(rStoreRoot),
 	  mDiscSetNumber(DiscSetNumber),
 	  mAccountID(AccountID),
 	  mFixErrors(FixErrors),
 	  mQuiet(Quiet),
+	  mNumWorkers(NumWorkers),
+	  mVerifyLevel(Level),
 	  mNumberErrorsFound(0),
 	  mLastIDInInfo(0),
 	  mpInfoLastBlock(0),
@@ -65,6 +84,14 @@ BackupStoreCheck::BackupStoreCheck(const std::string &rStoreRoot, int DiscSetNum
 	  mNumDeletedFiles(0),
 	  mNumDirectories(0)
 {
+	if(mNumWorkers < 1)
+	{
+		mNumWorkers = 1;
+	}
+	else if(mNumWorkers > BACKUPSTORECHECK_MAX_WORKERS)
+	{
+		mNumWorkers = BACKUPSTORECHECK_MAX_WORKERS;
+	}
 }
 
 
@@ -132,6 +159,14 @@ void BackupStoreCheck::Check()
 	{
 		BOX_INFO("Checking store account ID " <<
 			BOX_FORMAT_ACCOUNT(mAccountID) << "...");
+		if(mVerifyLevel == BackupStoreFile::VerifyLevel_Headers)
+		{
+			BOX_INFO("Quick check, only reading file headers.");
+		}
+		else if(mVerifyLevel == BackupStoreFile::VerifyLevel_AllData)
+		{
+			BOX_INFO("Deep check, reading all file data.");
+		}
 		BOX_INFO("Phase 1, check objects...");
 	}
 	CheckObjects();
@@ -319,12 +354,262 @@ void BackupStoreCheck::CheckObjects()
 	}
 
 	// Then go through and scan all the objects within those directories
+#ifndef WIN32
+	if(mNumWorkers > 1)
+	{
+		CheckObjectsWithWorkers(maxDir);
+		return;
+	}
+#endif
+
 	for(int64_t d = 0; d <= maxDir; d += (1<<STORE_ID_SEGMENT_LENGTH))
 	{
 		CheckObjectsDir(d);
 	}
 }
 
+
+#ifndef WIN32
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreCheck::CheckObjectsWithWorkers(int64_t)
+//		Purpose: Fork worker processes to read and verify the
+//			 objects, which takes almost all the time in phase 1,
+//			 while this process makes every decision and change
+//			 in the same order as CheckObjects() would. Object
+//			 directories are dealt out to the workers in turn,
+//			 and each sends back its results in order over a
+//			 pipe. If a worker fails, the directories it was
+//			 given are verified here instead.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupStoreCheck::CheckObjectsWithWorkers(int64_t MaxDir)
+{
+	std::vector<pid_t> pids;
+	std::vector<FileStream *> results;
+
+	for(int w = 0; w < mNumWorkers; ++w)
+	{
+		int fds[2];
+		if(::pipe(fds) != 0)
+		{
+			BOX_LOG_SYS_ERROR("Failed to create pipe for check "
+				"worker process");
+			break;
+		}
+
+		pid_t pid = ::fork();
+		if(pid == -1)
+		{
+			BOX_LOG_SYS_ERROR("Failed to fork check worker process");
+			::close(fds[0]);
+			::close(fds[1]);
+			break;
+		}
+
+		if(pid == 0)
+		{
+			// Child: leave without running any destructors, which
+			// might discard the parent's new refcount database.
+			::close(fds[0]);
+
+			int status = 0;
+			try
+			{
+				FileStream out(fds[1]);
+				RunObjectsWorker(w, MaxDir, out);
+			}
+			catch(std::exception &e)
+			{
+				BOX_ERROR("Check worker process failed: " <<
+					e.what());
+				status = 1;
+			}
+			catch(...)
+			{
+				BOX_ERROR("Check worker process failed: "
+					"unknown error");
+				status = 1;
+			}
+			::_exit(status);
+		}
+
+		::close(fds[1]);
+		pids.push_back(pid);
+		results.push_back(new FileStream(fds[0]));
+	}
+
+	// If not all the workers started, deal the directories out among
+	// those that did. With none at all, everything is done here.
+	int numWorkers = results.size();
+
+	try
+	{
+		for(int64_t d = 0; d <= MaxDir; d += (1<<STORE_ID_SEGMENT_LENGTH))
+		{
+			FileStream *pResults = NULL;
+			if(numWorkers > 0)
+			{
+				pResults = results[(d >> STORE_ID_SEGMENT_LENGTH) %
+					numWorkers];
+			}
+
+			std::vector<VerifiedObject> verified;
+			if(pResults == NULL || pResults->StreamClosed())
+			{
+				CheckObjectsDir(d);
+			}
+			else if(ReadVerifiedObjects(*pResults, d, verified))
+			{
+				CheckObjectsDir(d, &verified);
+			}
+			else
+			{
+				BOX_WARNING("Lost contact with check worker "
+					"process, checking its objects in this "
+					"process instead");
+				pResults->Close();
+				CheckObjectsDir(d);
+			}
+		}
+	}
+	catch(...)
+	{
+		for(size_t w = 0; w < pids.size(); ++w)
+		{
+			::kill(pids[w], SIGTERM);
+		}
+		for(size_t w = 0; w < results.size(); ++w)
+		{
+			delete results[w];
+			::waitpid(pids[w], NULL, 0);
+		}
+		throw;
+	}
+
+	for(size_t w = 0; w < results.size(); ++w)
+	{
+		delete results[w];
+
+		int status;
+		while(::waitpid(pids[w], &status, 0) == -1 && errno == EINTR)
+		{ }
+	}
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreCheck::RunObjectsWorker(int, int64_t,
+//			 IOStream &)
+//		Purpose: Run in a worker process. Verify every object in
+//			 the object directories dealt out to this worker, and
+//			 write the results for each directory to the stream:
+//			 its starting ID, the number of objects found, then
+//			 a VerifiedObject for each in order. Nothing in the
+//			 store is changed.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupStoreCheck::RunObjectsWorker(int Worker, int64_t MaxDir,
+	IOStream &rResults)
+{
+	for(int64_t d = ((int64_t)Worker << STORE_ID_SEGMENT_LENGTH);
+		d <= MaxDir;
+		d += ((int64_t)mNumWorkers << STORE_ID_SEGMENT_LENGTH))
+	{
+		std::vector<VerifiedObject> verified;
+		std::string dirName(GetObjectsDirName(d));
+
+		if(RaidFileRead::DirectoryExists(mDiscSetNumber, dirName))
+		{
+			std::vector<std::string> files;
+			RaidFileRead::ReadDirectoryContents(mDiscSetNumber,
+				dirName, RaidFileRead::DirReadType_FilesOnly,
+				files);
+
+			bool idsPresent[(1<<STORE_ID_SEGMENT_LENGTH)];
+			for(int l = 0; l < (1<<STORE_ID_SEGMENT_LENGTH); ++l)
+			{
+				idsPresent[l] = false;
+			}
+
+			for(std::vector<std::string>::const_iterator
+				i(files.begin()); i != files.end(); ++i)
+			{
+				int n = 0;
+				if((*i).size() == 3 && (*i)[0] == 'o' &&
+					TwoDigitHexToInt((*i).c_str() + 1, n) &&
+					n < (1<<STORE_ID_SEGMENT_LENGTH))
+				{
+					idsPresent[n] = true;
+				}
+			}
+
+			for(int i = 0; i < (1<<STORE_ID_SEGMENT_LENGTH); ++i)
+			{
+				if(idsPresent[i])
+				{
+					char leaf[8];
+					::snprintf(leaf, sizeof(leaf),
+						DIRECTORY_SEPARATOR "o%02x", i);
+					VerifiedObject result;
+					VerifyObject(d | i, dirName + leaf,
+						result);
+					result.mIndexInDir = i;
+					verified.push_back(result);
+				}
+			}
+		}
+
+		int64_t header[2] = {d, (int64_t)verified.size()};
+		rResults.Write(header, sizeof(header));
+		if(!verified.empty())
+		{
+			rResults.Write(&verified[0],
+				verified.size() * sizeof(VerifiedObject));
+		}
+	}
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreCheck::ReadVerifiedObjects(IOStream &,
+//			 int64_t, std::vector<VerifiedObject> &)
+//		Purpose: Read the results for the object directory with
+//			 the given starting ID from a worker process. Returns
+//			 false if the worker has gone, or sent something
+//			 unexpected.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool BackupStoreCheck::ReadVerifiedObjects(IOStream &rResults,
+	int64_t StartID, std::vector<VerifiedObject> &rVerified)
+{
+	int64_t header[2];
+	if(!rResults.ReadFullBuffer(header, sizeof(header), NULL) ||
+		header[0] != StartID || header[1] < 0 ||
+		header[1] > (1<<STORE_ID_SEGMENT_LENGTH))
+	{
+		return false;
+	}
+
+	rVerified.resize(header[1]);
+	if(header[1] > 0 && !rResults.ReadFullBuffer(&rVerified[0],
+		header[1] * sizeof(VerifiedObject), NULL))
+	{
+		return false;
+	}
+
+	return true;
+}
+#endif // !WIN32
+
 // --------------------------------------------------------------------------
 //
 // Function
@@ -408,13 +693,13 @@ int64_t BackupStoreCheck::CheckObjectsScanDir(int64_t StartID, int Level, const
 // --------------------------------------------------------------------------
 //
 // Function
-//		Name:    BackupStoreCheck::CheckObjectsDir(int64_t)
-//		Purpose: Check all the files within this directory which has
-//			 the given starting ID.
-//		Created: 22/4/04
+//		Name:    BackupStoreCheck::GetObjectsDirName(int64_t)
+//		Purpose: Return the name of the directory which holds the
+//			 objects with the given starting ID.
+//		Created: 2026/10/19
 //
 // --------------------------------------------------------------------------
-void BackupStoreCheck::CheckObjectsDir(int64_t StartID)
+std::string BackupStoreCheck::GetObjectsDirName(int64_t StartID)
 {
 	// Make directory name -- first generate the filename of an entry in it
 	std::string dirName;
@@ -424,6 +709,26 @@ void BackupStoreCheck::CheckObjectsDir(int64_t StartID)
 		dirName[dirName.size() - 4] == DIRECTORY_SEPARATOR_ASCHAR);
 	// Remove the filename from it
 	dirName.resize(dirName.size() - 4); // four chars for "/o00"
+	return dirName;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreCheck::CheckObjectsDir(int64_t,
+//			 const std::vector<VerifiedObject> *)
+//		Purpose: Check all the files within this directory which has
+//			 the given starting ID. If pVerified is given, it
+//			 holds the results of verifying the objects in the
+//			 directory, in order, and they are not read again.
+//		Created: 22/4/04
+//
+// --------------------------------------------------------------------------
+void BackupStoreCheck::CheckObjectsDir(int64_t StartID,
+	const std::vector<VerifiedObject> *pVerified)
+{
+	std::string dirName(GetObjectsDirName(StartID));
 
 	// Check directory exists
 	if(!RaidFileRead::DirectoryExists(mDiscSetNumber, dirName))
@@ -490,15 +795,32 @@ void BackupStoreCheck::CheckObjectsDir(int64_t StartID)
 	}
 
 	// Check all the objects found in this directory
+	size_t nextVerified = 0;
 	for(int i = 0; i < (1<<STORE_ID_SEGMENT_LENGTH); ++i)
 	{
 		if(idsPresent[i])
 		{
+			// Find the result of verifying it already, if any
+			const VerifiedObject *pObject = NULL;
+			while(pVerified != NULL &&
+				nextVerified < pVerified->size() &&
+				(*pVerified)[nextVerified].mIndexInDir < i)
+			{
+				++nextVerified;
+			}
+			if(pVerified != NULL &&
+				nextVerified < pVerified->size() &&
+				(*pVerified)[nextVerified].mIndexInDir == i)
+			{
+				pObject = &(*pVerified)[nextVerified];
+			}
+
 			// Check the object is OK, and add entry
 			char leaf[8];
 			::snprintf(leaf, sizeof(leaf),
 				DIRECTORY_SEPARATOR "o%02x", i);
-			if(!CheckAndAddObject(StartID | i, dirName + leaf))
+			if(!CheckAndAddObject(StartID | i, dirName + leaf,
+				pObject))
 			{
 				// File was bad, delete it
 				BOX_ERROR("Corrupted file " << dirName <<
@@ -519,28 +841,29 @@ void BackupStoreCheck::CheckObjectsDir(int64_t StartID)
 // --------------------------------------------------------------------------
 //
 // Function
-//		Name:    BackupStoreCheck::CheckAndAddObject(int64_t,
-//			 const std::string &)
-//		Purpose: Check a specific object and add it to the list
-//			 if it's OK. If there are any errors with the
-//			 reading, return false and it'll be deleted.
-//		Created: 21/4/04
+//		Name:    BackupStoreCheck::VerifyObject(int64_t,
+//			 const std::string &, VerifiedObject &)
+//		Purpose: Read a specific object and verify its format,
+//			 without changing anything, so that it can be done
+//			 in a worker process. Sets mContainerID to -1 if
+//			 there are any errors reading it.
+//		Created: 2026/10/19
 //
 // --------------------------------------------------------------------------
-bool BackupStoreCheck::CheckAndAddObject(int64_t ObjectID,
-	const std::string &rFilename)
+void BackupStoreCheck::VerifyObject(int64_t ObjectID,
+	const std::string &rFilename, VerifiedObject &rResult)
 {
-	// Info on object...
-	bool isFile = true;
-	int64_t containerID = -1;
-	int64_t size = -1;
+	rResult.mIndexInDir = 0;
+	rResult.mIsFile = false;
+	rResult.mContainerID = -1;
+	rResult.mSizeInBlocks = -1;
 
 	try
 	{
 		// Open file
 		std::auto_ptr<RaidFileRead> file(
 			RaidFileRead::Open(mDiscSetNumber, rFilename));
-		size = file->GetDiscUsageInBlocks();
+		rResult.mSizeInBlocks = file->GetDiscUsageInBlocks();
 
 		// Read in first four bytes -- don't have to worry about
 		// retrying if not all bytes read as is RaidFile
@@ -548,7 +871,7 @@ bool BackupStoreCheck::CheckAndAddObject(int64_t ObjectID,
 		if(file->Read(&signature, sizeof(signature)) != sizeof(signature))
 		{
 			// Too short, can't read signature from it
-			return false;
+			return;
 		}
 		// Seek back to beginning
 		file->Seek(0, IOStream::SeekType_Absolute);
@@ -560,24 +883,66 @@ bool BackupStoreCheck::CheckAndAddObject(int64_t ObjectID,
 #ifndef BOX_DISABLE_BACKWARDS_COMPATIBILITY_BACKUPSTOREFILE
 		case OBJECTMAGIC_FILE_MAGIC_VALUE_V0:
 #endif
-			// File... check
-			containerID = CheckFile(ObjectID, *file);
+			// File... check, unless it's in the root directory's
+			// place, which CheckAndAddObject() will reject.
+			rResult.mIsFile = true;
+			if(ObjectID != BACKUPSTORE_ROOT_DIRECTORY_ID)
+			{
+				rResult.mContainerID = CheckFile(ObjectID, *file);
+			}
 			break;
 
 		case OBJECTMAGIC_DIR_MAGIC_VALUE:
-			isFile = false;
-			containerID = CheckDirInitial(ObjectID, *file);
+			rResult.mContainerID = CheckDirInitial(ObjectID, *file);
 			break;
 
 		default:
 			// Unknown signature. Bad file. Very bad file.
-			return false;
 			break;
 		}
 	}
 	catch(...)
 	{
 		// Error caught, not a good file then, let it be deleted
+		rResult.mContainerID = -1;
+	}
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreCheck::CheckAndAddObject(int64_t,
+//			 const std::string &, const VerifiedObject *)
+//		Purpose: Check a specific object and add it to the list
+//			 if it's OK. If there are any errors with the
+//			 reading, return false and it'll be deleted. If
+//			 pVerified is given, the object has already been
+//			 read and verified, with that result.
+//		Created: 21/4/04
+//
+// --------------------------------------------------------------------------
+bool BackupStoreCheck::CheckAndAddObject(int64_t ObjectID,
+	const std::string &rFilename, const VerifiedObject *pVerified)
+{
+	VerifiedObject verified;
+	if(pVerified == NULL)
+	{
+		VerifyObject(ObjectID, rFilename, verified);
+		pVerified = &verified;
+	}
+
+	// Info on object...
+	bool isFile = pVerified->mIsFile;
+	int64_t containerID = pVerified->mContainerID;
+	int64_t size = pVerified->mSizeInBlocks;
+
+	// Check that it's not the root directory ID. Having a file as
+	// the root directory would be bad.
+	if(isFile && ObjectID == BACKUPSTORE_ROOT_DIRECTORY_ID)
+	{
+		// Get that dodgy thing deleted!
+		BOX_ERROR("Have file as root directory. This is bad.");
 		return false;
 	}
 
@@ -653,20 +1018,11 @@ bool BackupStoreCheck::CheckAndAddObject(int64_t ObjectID,
 // --------------------------------------------------------------------------
 int64_t BackupStoreCheck::CheckFile(int64_t ObjectID, IOStream &rStream)
 {
-	// Check that it's not the root directory ID. Having a file as
-	// the root directory would be bad.
-	if(ObjectID == BACKUPSTORE_ROOT_DIRECTORY_ID)
-	{
-		// Get that dodgy thing deleted!
-		BOX_ERROR("Have file as root directory. This is bad.");
-		return -1;
-	}
-
 	// Check the format of the file, and obtain the container ID
 	int64_t originalContainerID = -1;
 	if(!BackupStoreFile::VerifyEncodedFileFormat(rStream,
 		0 /* don't want diffing from ID */,
-		&originalContainerID))
+		&originalContainerID, mVerifyLevel))
 	{
 		// Didn't verify
 		return -1;
@@ -729,7 +1085,7 @@ void BackupStoreCheck::CheckDirectories()
 	for(Info_t::const_iterator i(mInfo.begin()); i != mInfo.end(); ++i)
 	{
 		IDBlock *pblock = i->second;
-		int32_t bentries = (pblock == mpInfoLastBlock)?mInfoLastBlockEntries:BACKUPSTORECHECK_BLOCK_SIZE;
+		int32_t bentries = pblock->mNumEntries;
 
 		for(int e = 0; e < bentries; ++e)
 		{
@@ -738,7 +1094,7 @@ void BackupStoreCheck::CheckDirectories()
 			{
 				// Found a directory. Read it in.
 				std::string filename;
-				StoreStructure::MakeObjectFilename(pblock->mID[e], mStoreRoot, mDiscSetNumber, filename, false /* no dir creation */);
+				StoreStructure::MakeObjectFilename(GetID(pblock, e), mStoreRoot, mDiscSetNumber, filename, false /* no dir creation */);
 				BackupStoreDirectory dir;
 				{
 					std::auto_ptr<RaidFileRead> file(RaidFileRead::Open(mDiscSetNumber, filename));
@@ -753,7 +1109,7 @@ void BackupStoreCheck::CheckDirectories()
 				{
 					// Wasn't quite right, and has been modified
 					BOX_ERROR("Directory ID " <<
-						BOX_FORMAT_OBJECTID(pblock->mID[e]) <<
+						BOX_FORMAT_OBJECTID(GetID(pblock, e)) <<
 						" was still bad after all checks");
 					++mNumberErrorsFound;
 					isModified = true;
@@ -761,14 +1117,14 @@ void BackupStoreCheck::CheckDirectories()
 				else if(isModified)
 				{
 					BOX_INFO("Directory ID " <<
-						BOX_FORMAT_OBJECTID(pblock->mID[e]) <<
+						BOX_FORMAT_OBJECTID(GetID(pblock, e)) <<
 						" was OK after fixing");
 				}
 
 				if(isModified && mFixErrors)
 				{
 					BOX_WARNING("Writing modified directory to disk: " <<
-						BOX_FORMAT_OBJECTID(pblock->mID[e]));
+						BOX_FORMAT_OBJECTID(GetID(pblock, e)));
 					RaidFileWrite fixed(mDiscSetNumber, filename);
 					fixed.Open(true /* allow overwriting */);
 					dir.WriteToStream(fixed);
@@ -984,7 +1340,7 @@ bool BackupStoreCheck::CheckDirectoryEntry(BackupStoreDirectory::Entry& rEntry,
 	// the directory and removing all bad entries.
 	
 	// Check that the container ID of the object is correct
-	if(piBlock->mContainer[IndexInDirBlock] != DirectoryID)
+	if(GetContainerID(piBlock, IndexInDirBlock) != DirectoryID)
 	{
 		// Needs fixing...
 		if(iflags & Flags_IsDir)
@@ -1006,19 +1362,19 @@ bool BackupStoreCheck::CheckDirectoryEntry(BackupStoreDirectory::Entry& rEntry,
 		}
 		
 		// Fix entry for now
-		piBlock->mContainer[IndexInDirBlock] = DirectoryID;
+		SetContainerID(piBlock, IndexInDirBlock, DirectoryID);
 	}
 
 	// Check the object size
-	if(rEntry.GetSizeInBlocks() != piBlock->mObjectSizeInBlocks[IndexInDirBlock])
+	if(rEntry.GetSizeInBlocks() != GetObjectSizeInBlocks(piBlock, IndexInDirBlock))
 	{
 		// Wrong size, correct it.
 		BOX_ERROR("Directory " << BOX_FORMAT_OBJECTID(DirectoryID) <<
 			" entry for " << BOX_FORMAT_OBJECTID(rEntry.GetObjectID()) <<
 			" has wrong size " << rEntry.GetSizeInBlocks() <<
-			", should be " << piBlock->mObjectSizeInBlocks[IndexInDirBlock]);
+			", should be " << GetObjectSizeInBlocks(piBlock, IndexInDirBlock));
 
-		rEntry.SetSizeInBlocks(piBlock->mObjectSizeInBlocks[IndexInDirBlock]);
+		rEntry.SetSizeInBlocks(GetObjectSizeInBlocks(piBlock, IndexInDirBlock));
 
 		// Mark as changed
 		rIsModified = true;
@@ -17,6 +17,7 @@
 
 #include "NamedLock.h"
 #include "BackupStoreDirectory.h"
+#include "BackupStoreFile.h"
 
 class IOStream;
 class BackupStoreFilename;
@@ -53,16 +54,28 @@ The following problems can be fixed:
 
 // Size of blocks in the list of IDs
 #ifdef BOX_RELEASE_BUILD
-	#define BACKUPSTORECHECK_BLOCK_SIZE		(64*1024)
+	#define BACKUPSTORECHECK_BLOCK_SIZE		4096
 #else
 	#define BACKUPSTORECHECK_BLOCK_SIZE		8
 #endif
 
-// The object ID type -- can redefine to uint32_t to produce a lower memory version for smaller stores
+// The object ID type
 typedef int64_t BackupStoreCheck_ID_t;
-// Can redefine the size type for lower memory usage too
+// The size type
 typedef int64_t BackupStoreCheck_Size_t;
 
+// IDs in a block are stored as 16-bit offsets from the first, so a new block
+// is started early if an ID is further than this from the start of the block
+#define BACKUPSTORECHECK_MAX_ID_OFFSET		0xffff
+
+// Marks a container ID or size which didn't fit in the block, and is kept
+// in a separate map instead
+#define BACKUPSTORECHECK_LARGE_CONTAINER	(-0x7fffffff - 1)
+#define BACKUPSTORECHECK_LARGE_SIZE		0xffff
+
+// Maximum number of worker processes which can verify objects in phase 1
+#define BACKUPSTORECHECK_MAX_WORKERS	64
+
 // --------------------------------------------------------------------------
 //
 // Class
@@ -74,7 +87,9 @@ typedef int64_t BackupStoreCheck_Size_t;
 class BackupStoreCheck
 {
 public:
-	BackupStoreCheck(const std::string &rStoreRoot, int DiscSetNumber, int32_t AccountID, bool FixErrors, bool Quiet);
+	BackupStoreCheck(const std::string &rStoreRoot, int DiscSetNumber, int32_t AccountID, bool FixErrors, bool Quiet,
+		int NumWorkers = 1,
+		BackupStoreFile::VerifyLevel Level = BackupStoreFile::VerifyLevel_BlockIndex);
 	~BackupStoreCheck();
 private:
 	// no copying
@@ -105,15 +120,35 @@ private:
 		Flags__NumItemsPerEntry = 4	// ie 8 / 2
 	};
 
+	// The IDs found, in order, with the information about each object
+	// packed as tightly as it reasonably can be, as there may be hundreds
+	// of millions of them. The arrays take about 8 bytes per object.
 	typedef struct
 	{
 		// Note use arrays within the block, rather than the more obvious array of
 		// objects, to be more memory efficient -- think alignment of the byte values.
+		BackupStoreCheck_ID_t mFirstID;
+		// Blocks can be started before they're full
+		int32_t mNumEntries;
 		uint8_t mFlags[BACKUPSTORECHECK_BLOCK_SIZE * Flags__NumFlags / Flags__NumItemsPerEntry];
-		BackupStoreCheck_ID_t mID[BACKUPSTORECHECK_BLOCK_SIZE];
-		BackupStoreCheck_ID_t mContainer[BACKUPSTORECHECK_BLOCK_SIZE];
-		BackupStoreCheck_Size_t mObjectSizeInBlocks[BACKUPSTORECHECK_BLOCK_SIZE];
+		// Offset of each ID from mFirstID
+		uint16_t mIDOffset[BACKUPSTORECHECK_BLOCK_SIZE];
+		// Container ID minus object ID, as containers are usually
+		// close to their contents, or BACKUPSTORECHECK_LARGE_CONTAINER
+		int32_t mContainerOffset[BACKUPSTORECHECK_BLOCK_SIZE];
+		// Or BACKUPSTORECHECK_LARGE_SIZE
+		uint16_t mObjectSizeInBlocks[BACKUPSTORECHECK_BLOCK_SIZE];
 	} IDBlock;
+
+	// Result of reading and verifying one object in phase 1, which may be
+	// done by a worker process. mContainerID is -1 if the object is bad.
+	typedef struct
+	{
+		int32_t mIndexInDir;
+		int32_t mIsFile;
+		int64_t mContainerID;
+		BackupStoreCheck_Size_t mSizeInBlocks;
+	} VerifiedObject;
 	
 	// Phases of the check
 	void CheckObjects();
@@ -126,8 +161,17 @@ private:
 
 	// Checking functions
 	int64_t CheckObjectsScanDir(int64_t StartID, int Level, const std::string &rDirName);
-	void CheckObjectsDir(int64_t StartID);
-	bool CheckAndAddObject(int64_t ObjectID, const std::string &rFilename);
+	std::string GetObjectsDirName(int64_t StartID);
+	void CheckObjectsDir(int64_t StartID,
+		const std::vector<VerifiedObject> *pVerified = 0);
+	bool CheckAndAddObject(int64_t ObjectID, const std::string &rFilename,
+		const VerifiedObject *pVerified);
+	void VerifyObject(int64_t ObjectID, const std::string &rFilename,
+		VerifiedObject &rResult);
+	void CheckObjectsWithWorkers(int64_t MaxDir);
+	void RunObjectsWorker(int Worker, int64_t MaxDir, IOStream &rResults);
+	bool ReadVerifiedObjects(IOStream &rResults, int64_t StartID,
+		std::vector<VerifiedObject> &rVerified);
 	bool CheckDirectory(BackupStoreDirectory& dir);
 	bool CheckDirectoryEntry(BackupStoreDirectory::Entry& rEntry,
 		int64_t DirectoryID, bool& rIsModified);
@@ -161,6 +205,18 @@ private:
 
 		return (pBlock->mFlags[Index / Flags__NumItemsPerEntry] >> ((Index % Flags__NumItemsPerEntry) * Flags__NumFlags)) & Flags__MASK;
 	}
+	inline BackupStoreCheck_ID_t GetID(IDBlock *pBlock, int32_t Index)
+	{
+		ASSERT(pBlock != 0);
+		ASSERT(Index < BACKUPSTORECHECK_BLOCK_SIZE);
+
+		return pBlock->mFirstID + pBlock->mIDOffset[Index];
+	}
+	BackupStoreCheck_ID_t GetContainerID(IDBlock *pBlock, int32_t Index);
+	void SetContainerID(IDBlock *pBlock, int32_t Index,
+		BackupStoreCheck_ID_t Container);
+	BackupStoreCheck_Size_t GetObjectSizeInBlocks(IDBlock *pBlock,
+		int32_t Index);
 	
 #ifndef BOX_RELEASE_BUILD
 	void DumpObjectInfo();
@@ -176,6 +232,9 @@ private:
 	std::string mAccountName;
 	bool mFixErrors;
 	bool mQuiet;
+	int mNumWorkers;
+	// How much of each file to read in phase 1
+	BackupStoreFile::VerifyLevel mVerifyLevel;
 	
 	int64_t mNumberErrorsFound;
 	
@@ -188,6 +247,9 @@ private:
 	BackupStoreCheck_ID_t mLastIDInInfo;
 	IDBlock *mpInfoLastBlock;
 	int32_t mInfoLastBlockEntries;
+	// Container IDs and sizes which are too big for the blocks, by object ID
+	std::map<BackupStoreCheck_ID_t, BackupStoreCheck_ID_t> mLargeContainerIDs;
+	std::map<BackupStoreCheck_ID_t, BackupStoreCheck_Size_t> mLargeObjectSizes;
 	
 	// List of stuff to fix
 	std::vector<BackupStoreCheck_ID_t> mDirsWithWrongContainerID;
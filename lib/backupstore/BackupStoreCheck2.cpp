@@ -131,7 +131,7 @@ void BackupStoreCheck::CheckUnattachedObjects()
 	for(Info_t::const_iterator i(mInfo.begin()); i != mInfo.end(); ++i)
 	{
 		IDBlock *pblock = i->second;
-		int32_t bentries = (pblock == mpInfoLastBlock)?mInfoLastBlockEntries:BACKUPSTORECHECK_BLOCK_SIZE;
+		int32_t bentries = pblock->mNumEntries;
 
 		for(int e = 0; e < bentries; ++e)
 		{
@@ -139,7 +139,7 @@ void BackupStoreCheck::CheckUnattachedObjects()
 			if((flags & Flags_IsContained) == 0)
 			{
 				// Unattached object...
-				int64_t ObjectID = pblock->mID[e];
+				int64_t ObjectID = GetID(pblock, e);
 				BOX_ERROR("Object " <<
 					BOX_FORMAT_OBJECTID(ObjectID) <<
 					" is unattached.");
@@ -185,7 +185,7 @@ void BackupStoreCheck::CheckUnattachedObjects()
 								del.Delete();
 							}
 
-							mBlocksUsed -= pblock->mObjectSizeInBlocks[e];
+							mBlocksUsed -= GetObjectSizeInBlocks(pblock, e);
 
 							// Move on to next item
 							continue;
@@ -199,14 +199,14 @@ void BackupStoreCheck::CheckUnattachedObjects()
 					// pretty useless as bbackupd would just delete it. So better to put it in lost+found
 					// where the admin can do something about it.
 					int32_t dirindex;
-					IDBlock *pdirblock = LookupID(pblock->mContainer[e], dirindex);
+					IDBlock *pdirblock = LookupID(GetContainerID(pblock, e), dirindex);
 					if(pdirblock != 0)
 					{
 						// Something with that ID has been found. Is it a directory?
 						if(GetFlags(pdirblock, dirindex) & Flags_IsDir)
 						{
 							// Directory exists, add to that one
-							putIntoDirectoryID = pblock->mContainer[e];
+							putIntoDirectoryID = GetContainerID(pblock, e);
 						}
 						else
 						{
@@ -214,11 +214,11 @@ void BackupStoreCheck::CheckUnattachedObjects()
 							putIntoDirectoryID = GetLostAndFoundDirID();
 						}
 					}
-					else if(mDirsAdded.find(pblock->mContainer[e]) != mDirsAdded.end()
-						|| TryToRecreateDirectory(pblock->mContainer[e]))
+					else if(mDirsAdded.find(GetContainerID(pblock, e)) != mDirsAdded.end()
+						|| TryToRecreateDirectory(GetContainerID(pblock, e)))
 					{
 						// The directory reappeared, or was created somehow elsewhere
-						putIntoDirectoryID = pblock->mContainer[e];
+						putIntoDirectoryID = GetContainerID(pblock, e);
 					}
 					else
 					{
@@ -514,7 +514,7 @@ void BackupStoreCheck::FixDirsWithWrongContainerID()
 		}
 
 		// Adjust container ID
-		dir.SetContainerID(pblock->mContainer[index]);
+		dir.SetContainerID(GetContainerID(pblock, index));
 
 		// Write it out
 		RaidFileWrite root(mDiscSetNumber, filename);
@@ -34,8 +34,10 @@ void BackupStoreCheck::FreeInfo()
 		::free(i->second);
 	}
 	
-	// Clear the contents of the map
+	// Clear the contents of the maps
 	mInfo.clear();
+	mLargeContainerIDs.clear();
+	mLargeObjectSizes.clear();
 	
 	// Reset the last ID, just in case
 	mpInfoLastBlock = 0;
@@ -62,7 +64,8 @@ void BackupStoreCheck::AddID(BackupStoreCheck_ID_t ID,
 	}
 	
 	// Can this go in the current block?
-	if(mpInfoLastBlock == 0 || mInfoLastBlockEntries >= BACKUPSTORECHECK_BLOCK_SIZE)
+	if(mpInfoLastBlock == 0 || mInfoLastBlockEntries >= BACKUPSTORECHECK_BLOCK_SIZE ||
+		ID - mpInfoLastBlock->mFirstID > BACKUPSTORECHECK_MAX_ID_OFFSET)
 	{
 		// No. Allocate a new one
 		IDBlock *pblk = (IDBlock*)calloc(1, sizeof(IDBlock));
@@ -70,6 +73,7 @@ void BackupStoreCheck::AddID(BackupStoreCheck_ID_t ID,
 		{
 			throw std::bad_alloc();
 		}
+		pblk->mFirstID = ID;
 		// Store in map
 		mInfo[ID] = pblk;
 		// Allocated and stored OK, setup for use
@@ -79,13 +83,24 @@ void BackupStoreCheck::AddID(BackupStoreCheck_ID_t ID,
 	ASSERT(mpInfoLastBlock != 0 && mInfoLastBlockEntries < BACKUPSTORECHECK_BLOCK_SIZE);
 	
 	// Add to block
-	mpInfoLastBlock->mID[mInfoLastBlockEntries] = ID;
-	mpInfoLastBlock->mContainer[mInfoLastBlockEntries] = Container;
-	mpInfoLastBlock->mObjectSizeInBlocks[mInfoLastBlockEntries] = ObjectSize;
+	mpInfoLastBlock->mIDOffset[mInfoLastBlockEntries] =
+		ID - mpInfoLastBlock->mFirstID;
+	SetContainerID(mpInfoLastBlock, mInfoLastBlockEntries, Container);
+	if(ObjectSize >= 0 && ObjectSize < BACKUPSTORECHECK_LARGE_SIZE)
+	{
+		mpInfoLastBlock->mObjectSizeInBlocks[mInfoLastBlockEntries] = ObjectSize;
+	}
+	else
+	{
+		mpInfoLastBlock->mObjectSizeInBlocks[mInfoLastBlockEntries] =
+			BACKUPSTORECHECK_LARGE_SIZE;
+		mLargeObjectSizes[ID] = ObjectSize;
+	}
 	SetFlags(mpInfoLastBlock, mInfoLastBlockEntries, IsFile?(0):(Flags_IsDir));
 	
 	// Increment size
 	++mInfoLastBlockEntries;
+	mpInfoLastBlock->mNumEntries = mInfoLastBlockEntries;
 	
 	// Store last ID
 	mLastIDInInfo = ID;
@@ -140,15 +155,22 @@ BackupStoreCheck::IDBlock *BackupStoreCheck::LookupID(BackupStoreCheck_ID_t ID,
 	ASSERT(pblock != 0);
 	
 	// How many entries are there in the block
-	int32_t bentries = (pblock == mpInfoLastBlock)?mInfoLastBlockEntries:BACKUPSTORECHECK_BLOCK_SIZE;
+	int32_t bentries = pblock->mNumEntries;
 	
+	// IDs in the block are offsets from the first one
+	BackupStoreCheck_ID_t offset = ID - pblock->mFirstID;
+	if(offset < 0 || offset > BACKUPSTORECHECK_MAX_ID_OFFSET)
+	{
+		return 0;
+	}
+
 	// Do binary search within block
 	int high = bentries;
 	int low = -1;
 	while(high - low > 1)
 	{
 		int i = (high + low) / 2;
-		if(ID <= pblock->mID[i])
+		if(offset <= pblock->mIDOffset[i])
 		{
 			high = i;
 		}
@@ -157,7 +179,7 @@ BackupStoreCheck::IDBlock *BackupStoreCheck::LookupID(BackupStoreCheck_ID_t ID,
 			low = i;
 		}
 	}
-	if(ID == pblock->mID[high])
+	if(high < bentries && offset == pblock->mIDOffset[high])
 	{
 		// Found
 		rIndexOut = high;
@@ -169,6 +191,94 @@ BackupStoreCheck::IDBlock *BackupStoreCheck::LookupID(BackupStoreCheck_ID_t ID,
 }
 
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreCheck::GetContainerID(IDBlock *, int32_t)
+//		Purpose: Return the container ID of an object found by
+//			 LookupID()
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+BackupStoreCheck_ID_t BackupStoreCheck::GetContainerID(IDBlock *pBlock,
+	int32_t Index)
+{
+	ASSERT(pBlock != 0);
+	ASSERT(Index < BACKUPSTORECHECK_BLOCK_SIZE);
+
+	int32_t offset = pBlock->mContainerOffset[Index];
+	if(offset != BACKUPSTORECHECK_LARGE_CONTAINER)
+	{
+		return GetID(pBlock, Index) + offset;
+	}
+
+	std::map<BackupStoreCheck_ID_t, BackupStoreCheck_ID_t>::const_iterator
+		i(mLargeContainerIDs.find(GetID(pBlock, Index)));
+	ASSERT(i != mLargeContainerIDs.end());
+	return i->second;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreCheck::SetContainerID(IDBlock *, int32_t,
+//			 BackupStoreCheck_ID_t)
+//		Purpose: Set the container ID of an object found by
+//			 LookupID(). It's stored as an offset from the
+//			 object's own ID if it fits in the block.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupStoreCheck::SetContainerID(IDBlock *pBlock, int32_t Index,
+	BackupStoreCheck_ID_t Container)
+{
+	ASSERT(pBlock != 0);
+	ASSERT(Index < BACKUPSTORECHECK_BLOCK_SIZE);
+
+	BackupStoreCheck_ID_t ID = GetID(pBlock, Index);
+	BackupStoreCheck_ID_t offset = Container - ID;
+	if(offset > BACKUPSTORECHECK_LARGE_CONTAINER && offset <= 0x7fffffff)
+	{
+		pBlock->mContainerOffset[Index] = offset;
+		mLargeContainerIDs.erase(ID);
+	}
+	else
+	{
+		pBlock->mContainerOffset[Index] = BACKUPSTORECHECK_LARGE_CONTAINER;
+		mLargeContainerIDs[ID] = Container;
+	}
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreCheck::GetObjectSizeInBlocks(IDBlock *,
+//			 int32_t)
+//		Purpose: Return the size of an object found by LookupID()
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+BackupStoreCheck_Size_t BackupStoreCheck::GetObjectSizeInBlocks(
+	IDBlock *pBlock, int32_t Index)
+{
+	ASSERT(pBlock != 0);
+	ASSERT(Index < BACKUPSTORECHECK_BLOCK_SIZE);
+
+	uint16_t size = pBlock->mObjectSizeInBlocks[Index];
+	if(size != BACKUPSTORECHECK_LARGE_SIZE)
+	{
+		return size;
+	}
+
+	std::map<BackupStoreCheck_ID_t, BackupStoreCheck_Size_t>::const_iterator
+		i(mLargeObjectSizes.find(GetID(pBlock, Index)));
+	ASSERT(i != mLargeObjectSizes.end());
+	return i->second;
+}
+
+
 #ifndef BOX_RELEASE_BUILD
 // --------------------------------------------------------------------------
 //
@@ -183,7 +293,7 @@ void BackupStoreCheck::DumpObjectInfo()
 	for(Info_t::const_iterator i(mInfo.begin()); i != mInfo.end(); ++i)
 	{
 		IDBlock *pblock = i->second;
-		int32_t bentries = (pblock == mpInfoLastBlock)?mInfoLastBlockEntries:BACKUPSTORECHECK_BLOCK_SIZE;
+		int32_t bentries = pblock->mNumEntries;
 		BOX_TRACE("BLOCK @ " << BOX_FORMAT_HEX32(pblock) <<
 			", " << bentries << " entries");
 		
@@ -191,8 +301,8 @@ void BackupStoreCheck::DumpObjectInfo()
 		{
 			uint8_t flags = GetFlags(pblock, e);
 			BOX_TRACE(std::hex << 
-				"id "  << pblock->mID[e] <<
-				", c " << pblock->mContainer[e] <<
+				"id "  << GetID(pblock, e) <<
+				", c " << GetContainerID(pblock, e) <<
 				", " << ((flags & Flags_IsDir)?"dir":"file") <<
 				", " << ((flags & Flags_IsContained) ? 
 					"contained":"unattached"));
@@ -9,6 +9,8 @@
 
 #include "Box.h"
 #include "BackupStoreConfigVerify.h"
+#include "BackupStoreConstants.h"
+#include "Protocol.h"
 #include "ServerTLS.h"
 #include "BoxPortsAndFiles.h"
 
@@ -20,13 +22,33 @@ static const ConfigurationVerifyKey verifyserverkeys[] =
 	// no default listen addresses
 };
 
+static const ConfigurationVerifyKey verifys3keys[] =
+{
+	// Keep files and directories in an Amazon S3-compatible store,
+	// instead of the disc set of each account, if this section exists
+	ConfigurationVerifyKey("HostName", ConfigTest_Exists),
+	ConfigurationVerifyKey("Port", ConfigTest_Exists | ConfigTest_IsInt, 80),
+	ConfigurationVerifyKey("BasePath", ConfigTest_Exists),
+	ConfigurationVerifyKey("AccessKey", ConfigTest_Exists),
+	ConfigurationVerifyKey("SecretKey", ConfigTest_Exists),
+	// optional local cache of small objects, mostly directories
+	ConfigurationVerifyKey("CacheDirectory", ConfigTest_LastEntry)
+};
+
 static const ConfigurationVerify verifyserver[] = 
 {
 	{
 		"Server",
 		0,
 		verifyserverkeys,
-		ConfigTest_Exists | ConfigTest_LastEntry,
+		ConfigTest_Exists,
+		0
+	},
+	{
+		"S3Store",
+		0,
+		verifys3keys,
+		ConfigTest_LastEntry,
 		0
 	}
 };
@@ -38,6 +60,18 @@ static const ConfigurationVerifyKey verifyrootkeys[] =
 		ConfigTest_Exists | ConfigTest_IsInt),
 	ConfigurationVerifyKey("ExtendedLogging", ConfigTest_IsBool, false),
 	// make value "yes" to enable in config file
+	ConfigurationVerifyKey("StreamCopyBufferSize", ConfigTest_IsInt,
+		PROTOCOL_DEFAULT_STREAM_COPY_BUFFER_SIZE),
+	// in kB/s, zero to disable the RAID scrubber
+	ConfigurationVerifyKey("RaidScrubRate", ConfigTest_IsInt, 0),
+	ConfigurationVerifyKey("TimeBetweenRaidScrubs", ConfigTest_IsInt,
+		BACKUP_STORE_DEFAULT_TIME_BETWEEN_RAID_SCRUBS),
+	// sync files to disc in groups, rather than leaving it to the OS
+	ConfigurationVerifyKey("SyncWrites", ConfigTest_IsBool, false),
+	ConfigurationVerifyKey("SyncGroupSize", ConfigTest_IsInt,
+		BACKUP_STORE_DEFAULT_SYNC_GROUP_SIZE),
+	// inet:host:port or unix:path, to serve metrics over HTTP
+	ConfigurationVerifyKey("MetricsListenAddress", 0),
 	ConfigurationVerifyKey("RaidFileConf", ConfigTest_LastEntry)
 };
 
@@ -40,5 +40,23 @@
 // This is a multiple of the number of blocks in the diff from file.
 #define BACKUP_FILE_DIFF_MAX_BLOCK_FIND_MULTIPLE	4096
 
+// Staged files which haven't been written to for this many seconds are
+// assumed to be abandoned, and are deleted when the client next logs in
+// to write to the store.
+#define BACKUP_STORE_STAGED_FILE_MAX_AGE		(7 * 24 * 60 * 60)
+
+// An account may not have more than this many staged files at once, as
+// read-only sessions can create them. Their total size is limited by the
+// account's hard limit, as if they had already been added to the store.
+#define BACKUP_STORE_MAX_STAGED_FILES			64
+
+// Default time between starting passes of the RAID scrubber, if it's
+// enabled with RaidScrubRate in bbstored.conf
+#define BACKUP_STORE_DEFAULT_TIME_BETWEEN_RAID_SCRUBS	(7 * 24 * 60 * 60)
+
+// Default number of files committed between syncs to disc, if SyncWrites
+// is enabled in bbstored.conf
+#define BACKUP_STORE_DEFAULT_SYNC_GROUP_SIZE	32
+
 #endif // BACKUPSTORECONSTANTS__H
 
@@ -11,20 +11,33 @@
 
 #include <stdio.h>
 
+#ifdef HAVE_DIRENT_H
+	#include <dirent.h>
+#endif
+
 #include "BackupConstants.h"
+#include "BackupFileSystem.h"
+#include "BackupStoreConstants.h"
 #include "BackupStoreContext.h"
 #include "BackupStoreDirectory.h"
 #include "BackupStoreException.h"
 #include "BackupStoreFile.h"
 #include "BackupStoreInfo.h"
 #include "BackupStoreObjectMagic.h"
+#include "BoxTime.h"
 #include "BufferedStream.h"
 #include "BufferedWriteStream.h"
+#include "Configuration.h"
+#include "FileModificationTime.h"
 #include "FileStream.h"
+#include "Guards.h"
 #include "InvisibleTempFileStream.h"
+#include "Metrics.h"
 #include "RaidFileController.h"
 #include "RaidFileRead.h"
+#include "RaidFileUtil.h"
 #include "RaidFileWrite.h"
+#include "Random.h"
 #include "StoreStructure.h"
 
 #include "MemLeakFindOn.h"
@@ -64,6 +77,9 @@ BackupStoreContext::BackupStoreContext(int32_t ClientID,
   mStoreDiscSet(-1),
   mReadOnly(true),
   mSaveStoreInfoDelay(STORE_INFO_SAVE_DELAY),
+  mStreamCopyBufferSize(PROTOCOL_DEFAULT_STREAM_COPY_BUFFER_SIZE),
+  mSyncGroupSize(0),
+  mpS3StoreConfig(NULL),
   mpTestHook(NULL)
 // If you change the initialisers, be sure to update
 // BackupStoreContext::ReceivedFinishCommand as well!
@@ -111,8 +127,11 @@ void BackupStoreContext::CleanUp()
 	if(mapStoreInfo.get() && !(mapStoreInfo->IsReadOnly()) &&
 		mapStoreInfo->IsModified())
 	{
-		mapStoreInfo->Save();
+		mapStoreInfo->Save(true, GetSyncGroup());
 	}
+
+	// Make everything written by this connection durable
+	SyncWrites();
 }
 
 
@@ -132,6 +151,8 @@ void BackupStoreContext::ReceivedFinishCommand()
 		SaveStoreInfo(false);
 	}
 
+	SyncWrites();
+
 	// Just in case someone wants to reuse a local protocol object,
 	// put the context back to its initial state.
 	mProtocolPhase = BackupStoreContext::Phase_Version;
@@ -140,6 +161,10 @@ void BackupStoreContext::ReceivedFinishCommand()
 	// mClientHasAccount, mAccountRootDir or mStoreDiscSet
 
 	mReadOnly = true;
+	if(mapFileSystem.get())
+	{
+		mapFileSystem->SetHaveWriteLock(false);
+	}
 	mSaveStoreInfoDelay = STORE_INFO_SAVE_DELAY;
 	mpTestHook = NULL;
 	mapStoreInfo.reset();
@@ -188,6 +213,10 @@ bool BackupStoreContext::AttemptToGetWriteLock()
 	{
 		// Got the lock, mark as not read only
 		mReadOnly = false;
+		if(mapFileSystem.get())
+		{
+			mapFileSystem->SetHaveWriteLock(true);
+		}
 	}
 
 	return gotLock;
@@ -270,13 +299,76 @@ void BackupStoreContext::SaveStoreInfo(bool AllowDelay)
 	}
 
 	// Want to save now
-	mapStoreInfo->Save();
+	mapStoreInfo->Save(true, GetSyncGroup());
 
 	// Set count for next delay
 	mSaveStoreInfoDelay = STORE_INFO_SAVE_DELAY;
 }
 
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreContext::SyncWrites(bool)
+//		Purpose: Makes the files committed since the last sync
+//			 durable, if syncing is enabled. Unless forced, this
+//			 waits until enough files have been committed to
+//			 make a full group, so that they share the cost of
+//			 the sync. Files are committed in an order which
+//			 leaves the store consistent at any point, so a
+//			 crash loses at most the unsynced commits.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupStoreContext::SyncWrites(bool Force)
+{
+	if(mSyncGroupSize <= 0)
+	{
+		return;
+	}
+
+	if(Force || mSyncGroup.GetNumPending() >= mSyncGroupSize)
+	{
+		mSyncGroup.Sync();
+	}
+}
+
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreContext::SetClientHasAccount(
+//			 const std::string &, int)
+//		Purpose: Called once the client has logged in to an account
+//			 with the given root directory and disc set, to set
+//			 up the storage backend for its files and directories
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupStoreContext::SetClientHasAccount(const std::string &rStoreRoot,
+	int StoreDiscSet)
+{
+	mClientHasAccount = true;
+	mAccountRootDir = rStoreRoot;
+	mStoreDiscSet = StoreDiscSet;
+
+	if(mpS3StoreConfig)
+	{
+		RaidFileController &rcontroller(RaidFileController::GetController());
+		RaidFileDiscSet &rdiscSet(rcontroller.GetDiscSet(mStoreDiscSet));
+		mapFileSystem.reset(new S3BackupFileSystem(*mpS3StoreConfig,
+			rdiscSet.GetBlockSize()));
+	}
+	else
+	{
+		mapFileSystem.reset(new RaidBackupFileSystem(mStoreDiscSet,
+			GetSyncGroup()));
+	}
+
+	mapFileSystem->SetHaveWriteLock(!mReadOnly);
+}
+
 
 // --------------------------------------------------------------------------
 //
@@ -290,7 +382,18 @@ void BackupStoreContext::SaveStoreInfo(bool AllowDelay)
 void BackupStoreContext::MakeObjectFilename(int64_t ObjectID, std::string &rOutput, bool EnsureDirectoryExists)
 {
 	// Delegate to utility function
-	StoreStructure::MakeObjectFilename(ObjectID, mAccountRootDir, mStoreDiscSet, rOutput, EnsureDirectoryExists);
+	StoreStructure::MakeObjectFilename(ObjectID, mAccountRootDir, mStoreDiscSet, rOutput, false);
+
+	if(EnsureDirectoryExists)
+	{
+		std::string::size_type lastSep =
+			rOutput.rfind(DIRECTORY_SEPARATOR_ASCHAR);
+		if(lastSep != std::string::npos)
+		{
+			mapFileSystem->EnsureDirectoryExists(
+				rOutput.substr(0, lastSep + 1));
+		}
+	}
 }
 
 
@@ -318,6 +421,12 @@ BackupStoreDirectory &BackupStoreContext::GetDirectoryInternal(int64_t ObjectID,
 	MakeObjectFilename(ObjectID, filename);
 	int64_t oldRevID = 0, newRevID = 0;
 
+	static MetricsCounter sCacheHits("bbstored_directory_cache_hits_total",
+		"Directories found up to date in the cache");
+	static MetricsCounter sCacheMisses("bbstored_directory_cache_misses_total",
+		"Directories loaded from the store because they were not "
+		"cached, or had changed");
+
 	// Already in cache?
 	std::map<int64_t, BackupStoreDirectory*>::iterator item(mDirectoryCache.find(ObjectID));
 	if(item != mDirectoryCache.end()) {
@@ -331,7 +440,7 @@ BackupStoreDirectory &BackupStoreContext::GetDirectoryInternal(int64_t ObjectID,
 			oldRevID = item->second->GetRevisionID();
 
 			// Check the revision ID of the file -- does it need refreshing?
-			if(!RaidFileRead::FileExists(mStoreDiscSet, filename, &newRevID))
+			if(!mapFileSystem->ObjectExists(filename, &newRevID))
 			{
 				THROW_EXCEPTION(BackupStoreException, DirectoryHasBeenDeleted)
 			}
@@ -342,6 +451,7 @@ BackupStoreDirectory &BackupStoreContext::GetDirectoryInternal(int64_t ObjectID,
 				BOX_TRACE("Returning object " <<
 					BOX_FORMAT_OBJECTID(ObjectID) <<
 					" from cache, modtime = " << newRevID)
+				sCacheHits.Increment();
 				return *(item->second);
 			}
 		}
@@ -352,6 +462,7 @@ BackupStoreDirectory &BackupStoreContext::GetDirectoryInternal(int64_t ObjectID,
 	}
 
 	// Need to load it up
+	sCacheMisses.Increment();
 
 	// First check to see if the cache is too big
 	if(mDirectoryCache.size() > MAX_CACHE_SIZE && AllowFlushCache)
@@ -372,9 +483,9 @@ BackupStoreDirectory &BackupStoreContext::GetDirectoryInternal(int64_t ObjectID,
 #endif
 	}
 
-	// Get a RaidFileRead to read it
-	std::auto_ptr<RaidFileRead> objectFile(RaidFileRead::Open(mStoreDiscSet,
-		filename, &newRevID));
+	// Open it from the store
+	std::auto_ptr<BackupFileSystemRead> objectFile(
+		mapFileSystem->OpenRead(filename, &newRevID));
 
 	ASSERT(newRevID != 0);
 
@@ -447,7 +558,7 @@ int64_t BackupStoreContext::AllocateObjectID()
 		std::string filename;
 		MakeObjectFilename(id, filename);
 		// Check it doesn't exist
-		if(!RaidFileRead::FileExists(mStoreDiscSet, filename))
+		if(!mapFileSystem->ObjectExists(filename))
 		{
 			// Success!
 			return id;
@@ -471,17 +582,22 @@ int64_t BackupStoreContext::AllocateObjectID()
 //
 // Function
 //		Name:    BackupStoreContext::AddFile(IOStream &, int64_t,
-//			 int64_t, int64_t, const BackupStoreFilename &, bool)
+//			 int64_t, int64_t, const BackupStoreFilename &, bool,
+//			 const std::string *)
 //		Purpose: Add a file to the store, from a given stream, into
 //			 a specified directory. Returns object ID of the new
-//			 file.
+//			 file. If pStagedFilename is given, and rFile is a
+//			 whole file rather than a diff, the staged file which
+//			 rFile reads is moved into the store if possible,
+//			 instead of being copied.
 //		Created: 2003/09/03
 //
 // --------------------------------------------------------------------------
 int64_t BackupStoreContext::AddFile(IOStream &rFile, int64_t InDirectory,
 	int64_t ModificationTime, int64_t AttributesHash,
 	int64_t DiffFromFileID, const BackupStoreFilename &rFilename,
-	bool MarkFileWithSameNameAsOldVersions)
+	bool MarkFileWithSameNameAsOldVersions,
+	const std::string *pStagedFilename)
 {
 	if(mapStoreInfo.get() == 0)
 	{
@@ -512,25 +628,67 @@ int64_t BackupStoreContext::AddFile(IOStream &rFile, int64_t InDirectory,
 	std::string fn;
 	MakeObjectFilename(id, fn, true /* make sure the directory it's in exists */);
 	int64_t newObjectBlocksUsed = 0;
-	RaidFileWrite *ppreviousVerStoreFile = 0;
+	BackupFileSystemWrite *ppreviousVerStoreFile = 0;
 	bool reversedDiffIsCompletelyDifferent = false;
 	int64_t oldVersionNewBlocksUsed = 0;
 	BackupStoreInfo::Adjustment adjustment = {};
 
 	try
 	{
-		RaidFileWrite storeFile(mStoreDiscSet, fn);
-		storeFile.Open(false /* no overwriting */);
+		// A whole staged file can be moved into place, rather than
+		// writing it all again
+		std::auto_ptr<BackupFileSystemWrite> apStoreFile;
+		if(pStagedFilename != NULL && DiffFromFileID == 0)
+		{
+			apStoreFile = mapFileSystem->OpenWriteFromFile(fn,
+				*pStagedFilename);
+		}
+
+		// Otherwise write it straight to the store, which streams it
+		// to RAID storage if it's going to end up there anyway, to
+		// avoid writing it all twice
+		bool moved = (apStoreFile.get() != NULL);
+		if(!moved)
+		{
+			apStoreFile = mapFileSystem->OpenWrite(fn,
+				false /* no overwriting */);
+		}
+		BackupFileSystemWrite &storeFile(*apStoreFile);
 
 		int64_t spaceSavedByConversionToPatch = 0;
 
 		// Diff or full file?
-		if(DiffFromFileID == 0)
+		if(moved)
+		{
+			// Already there, and verified when it was staged
+		}
+		else if(DiffFromFileID == 0)
 		{
-			// A full file, just store to disc
-			if(!rFile.CopyStreamTo(storeFile, BACKUP_STORE_TIMEOUT))
+			// A full file, just store to disc, verifying it on the
+			// way so that it needn't be read back once committed,
+			// which would stop a sync group from deferring its sync
+			BackupStoreFile::VerifyStream verifier(&storeFile);
+			try
 			{
-				THROW_EXCEPTION(BackupStoreException, ReadFileFromStreamTimedOut)
+				if(!rFile.CopyStreamTo(verifier, BACKUP_STORE_TIMEOUT,
+					mStreamCopyBufferSize))
+				{
+					THROW_EXCEPTION(BackupStoreException, ReadFileFromStreamTimedOut)
+				}
+
+				// The block index is only checked on Close(),
+				// which mustn't close the store file too
+				verifier.Close(false);
+			}
+			catch(BackupStoreException &e)
+			{
+				if(e.GetSubType() == BackupStoreException::BadBackupStoreFile)
+				{
+					// The store file will be discarded
+					// automatically when apStoreFile is destroyed
+					THROW_EXCEPTION(BackupStoreException, AddedFileDoesNotVerify)
+				}
+				throw;
 			}
 		}
 		else
@@ -542,8 +700,15 @@ int64_t BackupStoreContext::AddFile(IOStream &rFile, int64_t InDirectory,
 			}
 
 			// Diff file, needs to be recreated.
-			// Choose a temporary filename.
-			std::string tempFn(RaidFileController::DiscSetPathToFileSystemPath(mStoreDiscSet, fn + ".difftemp",
+			// Choose a temporary filename. Objects in S3 stores
+			// have no local directory, so use the account root.
+			std::string tempBase(fn);
+			if(mpS3StoreConfig)
+			{
+				tempBase = mAccountRootDir + fn.substr(
+					fn.rfind(DIRECTORY_SEPARATOR_ASCHAR) + 1);
+			}
+			std::string tempFn(RaidFileController::DiscSetPathToFileSystemPath(mStoreDiscSet, tempBase + ".difftemp",
 				1 /* NOT the same disc as the write file, to avoid using lots of space on the same disc unnecessarily */));
 
 			try
@@ -566,7 +731,8 @@ int64_t BackupStoreContext::AddFile(IOStream &rFile, int64_t InDirectory,
 #endif
 
 				// Stream the incoming diff to this temporary file
-				if(!rFile.CopyStreamTo(diff, BACKUP_STORE_TIMEOUT))
+				if(!rFile.CopyStreamTo(diff, BACKUP_STORE_TIMEOUT,
+					mStreamCopyBufferSize))
 				{
 					THROW_EXCEPTION(BackupStoreException, ReadFileFromStreamTimedOut)
 				}
@@ -586,13 +752,13 @@ int64_t BackupStoreContext::AddFile(IOStream &rFile, int64_t InDirectory,
 				MakeObjectFilename(DiffFromFileID, oldVersionFilename, false /* no need to make sure the directory it's in exists */);
 
 				// Reassemble that diff -- open previous file, and combine the patch and file
-				std::auto_ptr<RaidFileRead> from(RaidFileRead::Open(mStoreDiscSet, oldVersionFilename));
+				std::auto_ptr<BackupFileSystemRead> from(mapFileSystem->OpenRead(oldVersionFilename));
 				BackupStoreFile::CombineFile(diff, diff2, *from, storeFile);
 
 				// Then... reverse the patch back (open the from file again, and create a write file to overwrite it)
-				std::auto_ptr<RaidFileRead> from2(RaidFileRead::Open(mStoreDiscSet, oldVersionFilename));
-				ppreviousVerStoreFile = new RaidFileWrite(mStoreDiscSet, oldVersionFilename);
-				ppreviousVerStoreFile->Open(true /* allow overwriting */);
+				std::auto_ptr<BackupFileSystemRead> from2(mapFileSystem->OpenRead(oldVersionFilename));
+				ppreviousVerStoreFile = mapFileSystem->OpenWrite(
+					oldVersionFilename, true /* allow overwriting */).release();
 				from->Seek(0, IOStream::SeekType_Absolute);
 				diff.Seek(0, IOStream::SeekType_Absolute);
 				BackupStoreFile::ReverseDiffFile(diff, *from, *from2, *ppreviousVerStoreFile,
@@ -639,11 +805,12 @@ int64_t BackupStoreContext::AddFile(IOStream &rFile, int64_t InDirectory,
 		if(newTotalBlocksUsed > mapStoreInfo->GetBlocksHardLimit())
 		{
 			THROW_EXCEPTION(BackupStoreException, AddedFileExceedsStorageLimit)
-			// The store file will be deleted automatically by the RaidFile object
+			// The store file will be discarded automatically when
+			// apStoreFile is destroyed
 		}
 
 		// Commit the file
-		storeFile.Commit(BACKUP_STORE_CONVERT_TO_RAID_IMMEDIATELY);
+		storeFile.Commit();
 	}
 	catch(...)
 	{
@@ -657,23 +824,6 @@ int64_t BackupStoreContext::AddFile(IOStream &rFile, int64_t InDirectory,
 		throw;
 	}
 
-	// Verify the file -- only necessary for non-diffed versions
-	// NOTE: No need to catch exceptions and delete ppreviousVerStoreFile, because
-	// in the non-diffed code path it's never allocated.
-	if(DiffFromFileID == 0)
-	{
-		std::auto_ptr<RaidFileRead> checkFile(RaidFileRead::Open(mStoreDiscSet, fn));
-		if(!BackupStoreFile::VerifyEncodedFileFormat(*checkFile))
-		{
-			// Error! Delete the file
-			RaidFileWrite del(mStoreDiscSet, fn);
-			del.Delete();
-
-			// Exception
-			THROW_EXCEPTION(BackupStoreException, AddedFileDoesNotVerify)
-		}
-	}
-
 	// Modify the directory -- first make all files with the same name
 	// marked as an old version
 	try
@@ -740,7 +890,10 @@ int64_t BackupStoreContext::AddFile(IOStream &rFile, int64_t InDirectory,
 		// the state of the files on disc.
 		if(ppreviousVerStoreFile != 0)
 		{
-			ppreviousVerStoreFile->Commit(BACKUP_STORE_CONVERT_TO_RAID_IMMEDIATELY);
+			// The patched version depends on the new file, which
+			// must reach the disc first.
+			SyncWrites();
+			ppreviousVerStoreFile->Commit();
 			delete ppreviousVerStoreFile;
 			ppreviousVerStoreFile = 0;
 		}
@@ -748,8 +901,7 @@ int64_t BackupStoreContext::AddFile(IOStream &rFile, int64_t InDirectory,
 	catch(...)
 	{
 		// Back out on adding that file
-		RaidFileWrite del(mStoreDiscSet, fn);
-		del.Delete();
+		mapFileSystem->DeleteObject(fn);
 
 		// Remove this entry from the cache
 		RemoveDirectoryFromCache(InDirectory);
@@ -791,6 +943,489 @@ int64_t BackupStoreContext::AddFile(IOStream &rFile, int64_t InDirectory,
 }
 
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreContext::CreateStagedFile(int64_t, int64_t)
+//		Purpose: Create an empty staging file in the account root,
+//			 without touching any directory or allocating an
+//			 object ID, so that it can be done in a read-only
+//			 session. Returns the staging ID, which the client
+//			 uses to write to it with WriteStagedFile(), and
+//			 the writer session passes to AddStagedFile().
+//			 If ResumeKey isn't zero, the staging ID is derived
+//			 from it and ResumeCheck is kept alongside the file,
+//			 so that any later session can find the file again
+//			 and resume writing it, unless the check has changed,
+//			 in which case it's emptied. Refuses to create a new
+//			 file if the account already has
+//			 BACKUP_STORE_MAX_STAGED_FILES staged files.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int64_t BackupStoreContext::CreateStagedFile(int64_t ResumeKey,
+	int64_t ResumeCheck)
+{
+	if(mapStoreInfo.get() == 0)
+	{
+		THROW_EXCEPTION(BackupStoreException, StoreInfoNotLoaded)
+	}
+
+	int64_t stagingID = ResumeKey & 0x7fffffffffffffffLL;
+	std::string fn, checkFn;
+	bool emptied = false;
+
+	if(stagingID != 0)
+	{
+		StoreStructure::MakeStagingFilename(stagingID, mAccountRootDir,
+			mStoreDiscSet, fn);
+		StoreStructure::MakeStagingCheckFilename(fn, checkFn);
+
+		if(FileExists(fn))
+		{
+			int64_t check = 0;
+			bool sameCheck = false;
+			if(FileExists(checkFn))
+			{
+				FileStream checkFile(checkFn);
+				sameCheck = checkFile.ReadFullBuffer(&check,
+					sizeof(check), NULL) &&
+					(int64_t)box_ntoh64(check) == ResumeCheck;
+			}
+
+			if(!sameCheck)
+			{
+				// Something else is being uploaded now, so
+				// the data already received is no use.
+				FileStream truncate(fn, O_WRONLY | O_BINARY);
+				truncate.Truncate(0);
+				emptied = true;
+			}
+			else
+			{
+				return stagingID;
+			}
+		}
+	}
+
+	int numStaged = 0;
+	int64_t stagedBlocks = 0;
+	GetStagedFilesUsage(0, numStaged, stagedBlocks);
+	if(!emptied && numStaged >= BACKUP_STORE_MAX_STAGED_FILES)
+	{
+		THROW_EXCEPTION_MESSAGE(BackupStoreException, TooManyStagedFiles,
+			"Account " << BOX_FORMAT_ACCOUNT(mClientID) << " already "
+			"has " << numStaged << " staged files");
+	}
+
+	if(stagingID == 0)
+	{
+		// Choose an unpredictable, positive staging ID
+		while(stagingID <= 0)
+		{
+			Random::Generate(&stagingID, sizeof(stagingID));
+			stagingID &= 0x7fffffffffffffffLL;
+		}
+
+		StoreStructure::MakeStagingFilename(stagingID, mAccountRootDir,
+			mStoreDiscSet, fn);
+		FileStream create(fn, O_WRONLY | O_CREAT | O_EXCL | O_BINARY);
+	}
+	else
+	{
+		// Create it, unless it was emptied above
+		FileStream create(fn, O_WRONLY | O_CREAT | O_BINARY);
+
+		int64_t check = box_hton64(ResumeCheck);
+		FileStream checkFile(checkFn, O_WRONLY | O_CREAT | O_TRUNC |
+			O_BINARY);
+		checkFile.Write(&check, sizeof(check));
+	}
+
+	return stagingID;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreContext::GetStagedFileSize(int64_t)
+//		Purpose: Returns the number of bytes received so far into
+//			 a staging file, so that an interrupted upload can
+//			 be resumed.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int64_t BackupStoreContext::GetStagedFileSize(int64_t StagingID)
+{
+	std::string fn;
+	StoreStructure::MakeStagingFilename(StagingID, mAccountRootDir,
+		mStoreDiscSet, fn);
+
+	int64_t size = 0;
+	if(!FileExists(fn, &size))
+	{
+		THROW_EXCEPTION(BackupStoreException, StagedFileDoesNotExist)
+	}
+
+	return size;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreContext::WriteStagedFile(int64_t, int64_t,
+//			 IOStream &)
+//		Purpose: Write the rest of an encoded file or diff into a
+//			 staging file, starting Offset bytes into it and
+//			 discarding anything after that. If the stream is
+//			 interrupted, the data received so far is kept so
+//			 that the upload can be resumed. Once the whole
+//			 stream has been received, the file is verified, and
+//			 deleted if it's bad. Staged files count against the
+//			 account's hard limit, so writing stops (and the rest
+//			 of the stream is discarded) as soon as it's exceeded.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupStoreContext::WriteStagedFile(int64_t StagingID, int64_t Offset,
+	IOStream &rFile)
+{
+	if(mapStoreInfo.get() == 0)
+	{
+		THROW_EXCEPTION(BackupStoreException, StoreInfoNotLoaded)
+	}
+
+	std::string fn;
+	StoreStructure::MakeStagingFilename(StagingID, mAccountRootDir,
+		mStoreDiscSet, fn);
+
+	int64_t size = GetStagedFileSize(StagingID);
+	if(Offset < 0 || Offset > size)
+	{
+		THROW_EXCEPTION(BackupStoreException, StagedFileOffsetInvalid)
+	}
+
+	// Don't accept more than would fit, even before it's added, taking
+	// into account the other staged files which may be added first.
+	int numStaged = 0;
+	int64_t otherStagedBlocks = 0;
+	GetStagedFilesUsage(StagingID, numStaged, otherStagedBlocks);
+	int64_t blocksAvailable = mapStoreInfo->GetBlocksHardLimit() -
+		mapStoreInfo->GetBlocksUsed() - otherStagedBlocks;
+	bool exceedsLimit = false;
+
+	{
+		FileStream stagingFile(fn, O_WRONLY | O_BINARY);
+		stagingFile.Truncate(Offset);
+
+		MemoryBlockGuard<char*> buffer(mStreamCopyBufferSize);
+		while(rFile.StreamDataLeft())
+		{
+			int bytes = rFile.Read(buffer, mStreamCopyBufferSize,
+				BACKUP_STORE_TIMEOUT);
+			if(bytes == 0 && rFile.StreamDataLeft())
+			{
+				THROW_EXCEPTION(BackupStoreException,
+					ReadFileFromStreamTimedOut)
+			}
+
+			// Keep reading to the end of the stream, so that
+			// the protocol stays in step, but stop writing.
+			if(exceedsLimit || bytes == 0)
+			{
+				continue;
+			}
+
+			stagingFile.Write(buffer, bytes);
+			exceedsLimit = (mapFileSystem->GetSizeInBlocks(
+				stagingFile.GetPosition()) > blocksAvailable);
+		}
+
+		size = stagingFile.GetPosition();
+	}
+
+	// Verify it now, so that the client finds out on the connection
+	// which sent it. Diffs have the same format as full files.
+	bool verified = false;
+	if(!exceedsLimit)
+	{
+		FileStream checkFile(fn);
+		verified = BackupStoreFile::VerifyEncodedFileFormat(checkFile);
+	}
+
+	if(verified)
+	{
+		return;
+	}
+
+	if(!DeleteStagedFile(fn))
+	{
+		THROW_EMU_FILE_ERROR("Failed to delete staged file", fn,
+			CommonException, OSFileError);
+	}
+
+	if(exceedsLimit)
+	{
+		THROW_EXCEPTION(BackupStoreException, AddedFileExceedsStorageLimit)
+	}
+	else
+	{
+		THROW_EXCEPTION(BackupStoreException, AddedFileDoesNotVerify)
+	}
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreContext::StageFile(IOStream &)
+//		Purpose: Receive a whole encoded file or diff into a new
+//			 staging file, as CreateStagedFile() followed by
+//			 WriteStagedFile(), except that nothing is kept if
+//			 the stream is interrupted. Returns the staging ID.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int64_t BackupStoreContext::StageFile(IOStream &rFile)
+{
+	int64_t stagingID = CreateStagedFile();
+
+	try
+	{
+		WriteStagedFile(stagingID, 0, rFile);
+	}
+	catch(...)
+	{
+		std::string fn;
+		StoreStructure::MakeStagingFilename(stagingID,
+			mAccountRootDir, mStoreDiscSet, fn);
+		DeleteStagedFile(fn);
+		throw;
+	}
+
+	return stagingID;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreContext::AddStagedFile(int64_t, int64_t,
+//			 int64_t, int64_t, int64_t,
+//			 const BackupStoreFilename &)
+//		Purpose: Add a file previously received by StageFile() or
+//			 WriteStagedFile() to the store, as AddFile() would.
+//			 A whole file is moved into the store where possible,
+//			 so that it's not written twice, and anything left of
+//			 the staging file is deleted. Returns object ID of
+//			 the new file.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int64_t BackupStoreContext::AddStagedFile(int64_t StagingID,
+	int64_t InDirectory, int64_t ModificationTime,
+	int64_t AttributesHash, int64_t DiffFromFileID,
+	const BackupStoreFilename &rFilename)
+{
+	if(mReadOnly)
+	{
+		THROW_EXCEPTION(BackupStoreException, ContextIsReadOnly)
+	}
+
+	std::string fn;
+	StoreStructure::MakeStagingFilename(StagingID, mAccountRootDir,
+		mStoreDiscSet, fn);
+	if(!FileExists(fn))
+	{
+		THROW_EXCEPTION(BackupStoreException, StagedFileDoesNotExist)
+	}
+
+	int64_t id;
+	{
+		FileStream staged(fn);
+		id = AddFile(staged, InDirectory, ModificationTime,
+			AttributesHash, DiffFromFileID, rFilename,
+			true /* mark files with same name as old versions */,
+			&fn);
+	}
+
+	// Anything left of it, unless it was moved into the store
+	if(!DeleteStagedFile(fn))
+	{
+		BOX_LOG_SYS_WARNING("Failed to delete staged file " << fn);
+	}
+
+	return id;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreContext::DeleteOldStagedFiles()
+//		Purpose: Delete any staged files which haven't been written
+//			 to for BACKUP_STORE_STAGED_FILE_MAX_AGE, as the client
+//			 has given up on resuming or adding them.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupStoreContext::DeleteOldStagedFiles()
+{
+	ASSERT(!mReadOnly);
+
+	std::vector<std::string> stagedFiles, checkFiles;
+	GetStagedFilenames(stagedFiles, &checkFiles);
+
+	box_time_t oldest = GetCurrentBoxTime() -
+		SecondsToBoxTime(BACKUP_STORE_STAGED_FILE_MAX_AGE);
+
+	// Resume checks left behind by a staged file which has gone
+	for(std::vector<std::string>::const_iterator i(checkFiles.begin());
+		i != checkFiles.end(); i++)
+	{
+		if(!FileExists(i->substr(0, i->size() - 6)) &&
+			EMU_UNLINK(i->c_str()) != 0)
+		{
+			BOX_LOG_SYS_WARNING("Failed to delete staged file "
+				"check " << *i);
+		}
+	}
+
+	for(std::vector<std::string>::const_iterator i(stagedFiles.begin());
+		i != stagedFiles.end(); i++)
+	{
+		EMU_STRUCT_STAT st;
+		if(EMU_STAT(i->c_str(), &st) != 0 ||
+			FileModificationTime(st) >= oldest)
+		{
+			continue;
+		}
+
+		BOX_INFO("Deleting abandoned staged file " << *i <<
+			" in account " << BOX_FORMAT_ACCOUNT(mClientID));
+		if(!DeleteStagedFile(*i))
+		{
+			BOX_LOG_SYS_WARNING("Failed to delete staged file " << *i);
+		}
+	}
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreContext::GetStagedFilenames(
+//			 std::vector<std::string> &,
+//			 std::vector<std::string> *)
+//		Purpose: Private. Lists the full paths of all the staged
+//			 files in the account root, and optionally of their
+//			 resume checks.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupStoreContext::GetStagedFilenames(
+	std::vector<std::string> &rFilenamesOut,
+	std::vector<std::string> *pCheckFilenamesOut)
+{
+	RaidFileController &rcontroller(RaidFileController::GetController());
+	RaidFileDiscSet &rdiscSet(rcontroller.GetDiscSet(mStoreDiscSet));
+	std::string rootDir(rdiscSet[0] + DIRECTORY_SEPARATOR + mAccountRootDir);
+
+	DIR *dirHandle = ::opendir(rootDir.c_str());
+	if(dirHandle == 0)
+	{
+		THROW_SYS_FILE_ERROR("Failed to open account root directory",
+			rootDir, CommonException, OSFileError);
+	}
+
+	struct dirent *en = 0;
+	while((en = ::readdir(dirHandle)) != 0)
+	{
+		if(StoreStructure::IsStagingFilename(en->d_name))
+		{
+			rFilenamesOut.push_back(rootDir + en->d_name);
+		}
+		else if(pCheckFilenamesOut &&
+			StoreStructure::IsStagingCheckFilename(en->d_name))
+		{
+			pCheckFilenamesOut->push_back(rootDir + en->d_name);
+		}
+	}
+	::closedir(dirHandle);
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreContext::DeleteStagedFile(
+//			 const std::string &)
+//		Purpose: Private. Deletes a staged file, if it still exists,
+//			 and its resume check, if it has one. Returns false,
+//			 with errno set, if the staged file couldn't be
+//			 deleted.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool BackupStoreContext::DeleteStagedFile(const std::string &rFilename)
+{
+	std::string checkFn;
+	StoreStructure::MakeStagingCheckFilename(rFilename, checkFn);
+	if(FileExists(checkFn) && EMU_UNLINK(checkFn.c_str()) != 0)
+	{
+		BOX_LOG_SYS_WARNING("Failed to delete staged file check " <<
+			checkFn);
+	}
+
+	return !FileExists(rFilename) || EMU_UNLINK(rFilename.c_str()) == 0;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreContext::GetStagedFilesUsage(int64_t,
+//			 int &, int64_t &)
+//		Purpose: Private. Counts the staged files in the account,
+//			 and the blocks they would use once added to the
+//			 store, leaving out the one with the given staging
+//			 ID (0 to count them all).
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupStoreContext::GetStagedFilesUsage(int64_t ExcludeStagingID,
+	int &rNumFilesOut, int64_t &rBlocksUsedOut)
+{
+	std::vector<std::string> stagedFiles;
+	GetStagedFilenames(stagedFiles);
+
+	std::string excluded;
+	if(ExcludeStagingID != 0)
+	{
+		StoreStructure::MakeStagingFilename(ExcludeStagingID,
+			mAccountRootDir, mStoreDiscSet, excluded);
+	}
+
+	rNumFilesOut = 0;
+	rBlocksUsedOut = 0;
+
+	for(std::vector<std::string>::const_iterator i(stagedFiles.begin());
+		i != stagedFiles.end(); i++)
+	{
+		int64_t size = 0;
+		if(*i == excluded || !FileExists(*i, &size))
+		{
+			// Excluded, or deleted since the directory was read
+			continue;
+		}
+
+		rNumFilesOut++;
+		rBlocksUsedOut += mapFileSystem->GetSizeInBlocks(size);
+	}
+}
+
 
 // --------------------------------------------------------------------------
 //
@@ -1015,18 +1650,19 @@ void BackupStoreContext::SaveDirectory(BackupStoreDirectory &rDir)
 		int64_t old_dir_size = rDir.GetUserInfo1_SizeInBlocks();
 
 		{
-			RaidFileWrite writeDir(mStoreDiscSet, dirfn);
-			writeDir.Open(true /* allow overwriting */);
+			std::auto_ptr<BackupFileSystemWrite> apWriteDir(
+				mapFileSystem->OpenWrite(dirfn,
+					true /* allow overwriting */));
 
-			BufferedWriteStream buffer(writeDir);
+			BufferedWriteStream buffer(*apWriteDir);
 			rDir.WriteToStream(buffer);
 			buffer.Flush();
 
 			// get the disc usage (must do this before commiting it)
-			int64_t dirSize = writeDir.GetDiscUsageInBlocks();
+			int64_t dirSize = apWriteDir->GetDiscUsageInBlocks();
 
 			// Commit directory
-			writeDir.Commit(BACKUP_STORE_CONVERT_TO_RAID_IMMEDIATELY);
+			apWriteDir->Commit();
 
 			// Make sure the size of the directory is available for writing the dir back
 			ASSERT(dirSize > 0);
@@ -1040,7 +1676,7 @@ void BackupStoreContext::SaveDirectory(BackupStoreDirectory &rDir)
 		// Refresh revision ID in cache
 		{
 			int64_t revid = 0;
-			if(!RaidFileRead::FileExists(mStoreDiscSet, dirfn, &revid))
+			if(!mapFileSystem->ObjectExists(dirfn, &revid))
 			{
 				THROW_EXCEPTION(BackupStoreException, Internal)
 			}
@@ -1079,6 +1715,9 @@ void BackupStoreContext::SaveDirectory(BackupStoreDirectory &rDir)
 				SaveDirectory(parent);
 			}
 		}
+
+		// Sync if enough files have been committed since the last time
+		SyncWrites(false);
 	}
 	catch(...)
 	{
@@ -1152,11 +1791,11 @@ int64_t BackupStoreContext::AddDirectory(int64_t InDirectory,
 		emptyDir.SetAttributes(Attributes, AttributesModTime);
 
 		// Write...
-		RaidFileWrite dirFile(mStoreDiscSet, fn);
-		dirFile.Open(false /* no overwriting */);
-		emptyDir.WriteToStream(dirFile);
+		std::auto_ptr<BackupFileSystemWrite> apDirFile(
+			mapFileSystem->OpenWrite(fn, false /* no overwriting */));
+		emptyDir.WriteToStream(*apDirFile);
 		// Get disc usage, before it's commited
-		dirSize = dirFile.GetDiscUsageInBlocks();
+		dirSize = apDirFile->GetDiscUsageInBlocks();
 
 		// Exceeds the hard limit?
 		int64_t newTotalBlocksUsed = mapStoreInfo->GetBlocksUsed() +
@@ -1164,11 +1803,12 @@ int64_t BackupStoreContext::AddDirectory(int64_t InDirectory,
 		if(newTotalBlocksUsed > mapStoreInfo->GetBlocksHardLimit())
 		{
 			THROW_EXCEPTION(BackupStoreException, AddedFileExceedsStorageLimit)
-			// The file will be deleted automatically by the RaidFile object
+			// The file will be discarded automatically when
+			// apDirFile is destroyed
 		}
 
 		// Commit the file
-		dirFile.Commit(BACKUP_STORE_CONVERT_TO_RAID_IMMEDIATELY);
+		apDirFile->Commit();
 
 		// Make sure the size of the directory is added to the usage counts in the info
 		ASSERT(dirSize > 0);
@@ -1191,8 +1831,7 @@ int64_t BackupStoreContext::AddDirectory(int64_t InDirectory,
 	catch(...)
 	{
 		// Back out on adding that directory
-		RaidFileWrite del(mStoreDiscSet, fn);
-		del.Delete();
+		mapFileSystem->DeleteObject(fn);
 
 		// Remove this entry from the cache
 		RemoveDirectoryFromCache(InDirectory);
@@ -1529,17 +2168,25 @@ bool BackupStoreContext::ObjectExists(int64_t ObjectID, int MustBe)
 	// Test to see if it exists on the disc
 	std::string filename;
 	MakeObjectFilename(ObjectID, filename);
-	if(!RaidFileRead::FileExists(mStoreDiscSet, filename))
+	if(!mapFileSystem->ObjectExists(filename))
 	{
-		// RaidFile reports no file there
+		// The store reports no file there
 		return false;
 	}
 
 	// Do we need to be more specific?
-	if(MustBe != ObjectExists_Anything)
+	if(MustBe != ObjectExists_Anything &&
+		mDirectoryCache.find(ObjectID) != mDirectoryCache.end())
+	{
+		// Object IDs are never reused, so it's still a directory. This
+		// avoids reading a directory whose latest version is waiting to
+		// be synced, which would force the sync group to sync early.
+		return MustBe == ObjectExists_Directory;
+	}
+	else if(MustBe != ObjectExists_Anything)
 	{
 		// Open the file
-		std::auto_ptr<RaidFileRead> objectFile(RaidFileRead::Open(mStoreDiscSet, filename));
+		std::auto_ptr<BackupFileSystemRead> objectFile(mapFileSystem->OpenRead(filename));
 
 		// Read the first integer
 		uint32_t magic;
@@ -1591,7 +2238,7 @@ std::auto_ptr<IOStream> BackupStoreContext::OpenObject(int64_t ObjectID)
 	// Attempt to open the file
 	std::string fn;
 	MakeObjectFilename(ObjectID, fn);
-	return std::auto_ptr<IOStream>(RaidFileRead::Open(mStoreDiscSet, fn).release());
+	return std::auto_ptr<IOStream>(mapFileSystem->OpenRead(fn).release());
 }
 
 
@@ -1673,8 +2320,12 @@ void BackupStoreContext::SetClientStoreMarker(int64_t ClientStoreMarker)
 		THROW_EXCEPTION(BackupStoreException, ContextIsReadOnly)
 	}
 
+	// The client relies on everything it has sent so far being stored
+	// once the marker is, so make sure it has reached the disc first.
+	SyncWrites();
 	mapStoreInfo->SetClientStoreMarker(ClientStoreMarker);
 	SaveStoreInfo(false /* don't delay saving this */);
+	SyncWrites();
 }
 
 
@@ -13,16 +13,20 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <vector>
 
 #include "autogen_BackupProtocol.h"
+#include "BackupFileSystem.h"
 #include "BackupStoreInfo.h"
 #include "BackupStoreRefCountDatabase.h"
 #include "NamedLock.h"
+#include "RaidFileSyncGroup.h"
 #include "Message.h"
 #include "Utils.h"
 
 class BackupStoreDirectory;
 class BackupStoreFilename;
+class Configuration;
 class IOStream;
 class BackupProtocolMessage;
 class StreamableMemBlock;
@@ -95,10 +99,18 @@ public:
 		}
 	}
 
-	void SetClientHasAccount(const std::string &rStoreRoot, int StoreDiscSet) {mClientHasAccount = true; mAccountRootDir = rStoreRoot; mStoreDiscSet = StoreDiscSet;}
+	void SetClientHasAccount(const std::string &rStoreRoot, int StoreDiscSet);
 	bool GetClientHasAccount() const {return mClientHasAccount;}
 	const std::string &GetAccountRoot() const {return mAccountRootDir;}
 	int GetStoreDiscSet() const {return mStoreDiscSet;}
+	void SetStreamCopyBufferSize(int Size) {mStreamCopyBufferSize = Size;}
+	// Must be called before SetClientHasAccount() to take effect
+	void SetSyncGroupSize(int Size) {mSyncGroupSize = Size;}
+	// Keep files and directories in S3 instead of the account's disc set.
+	// Must be called before SetClientHasAccount(), and rS3Config must
+	// outlive this context.
+	void SetS3Store(const Configuration &rS3Config) {mpS3StoreConfig = &rS3Config;}
+	int64_t GetNumSyncs() const {return mSyncGroup.GetNumSyncs();}
 
 	// Store info
 	void LoadStoreInfo();
@@ -146,7 +158,21 @@ public:
 		int64_t AttributesHash,
 		int64_t DiffFromFileID,
 		const BackupStoreFilename &rFilename,
-		bool MarkFileWithSameNameAsOldVersions);
+		bool MarkFileWithSameNameAsOldVersions,
+		const std::string *pStagedFilename = NULL);
+	int64_t CreateStagedFile(int64_t ResumeKey = 0,
+		int64_t ResumeCheck = 0);
+	int64_t GetStagedFileSize(int64_t StagingID);
+	void WriteStagedFile(int64_t StagingID, int64_t Offset,
+		IOStream &rFile);
+	int64_t StageFile(IOStream &rFile);
+	int64_t AddStagedFile(int64_t StagingID,
+		int64_t InDirectory,
+		int64_t ModificationTime,
+		int64_t AttributesHash,
+		int64_t DiffFromFileID,
+		const BackupStoreFilename &rFilename);
+	void DeleteOldStagedFiles();
 	int64_t AddDirectory(int64_t InDirectory,
 		const BackupStoreFilename &rFilename,
 		const StreamableMemBlock &Attributes,
@@ -183,6 +209,16 @@ private:
 	void ClearDirectoryCache();
 	void DeleteDirectoryRecurse(int64_t ObjectID, bool Undelete);
 	int64_t AllocateObjectID();
+	RaidFileSyncGroup *GetSyncGroup()
+	{
+		return (mSyncGroupSize > 0) ? &mSyncGroup : NULL;
+	}
+	void SyncWrites(bool Force = true);
+	void GetStagedFilenames(std::vector<std::string> &rFilenamesOut,
+		std::vector<std::string> *pCheckFilenamesOut = NULL);
+	bool DeleteStagedFile(const std::string &rFilename);
+	void GetStagedFilesUsage(int64_t ExcludeStagingID, int &rNumFilesOut,
+		int64_t &rBlocksUsedOut);
 
 	std::string mConnectionDetails;
 	int32_t mClientID;
@@ -195,6 +231,15 @@ private:
 	bool mReadOnly;
 	NamedLock mWriteLock;
 	int mSaveStoreInfoDelay; // how many times to delay saving the store info
+	int mStreamCopyBufferSize; // buffer for copying uploaded files to disc
+	int mSyncGroupSize; // committed files per sync to disc, 0 to never sync
+
+	// Files committed, but not yet synced to disc
+	RaidFileSyncGroup mSyncGroup;
+
+	// Where the account's files and directories are kept
+	const Configuration *mpS3StoreConfig;
+	std::auto_ptr<BackupFileSystem> mapFileSystem;
 
 	// Store info
 	std::auto_ptr<BackupStoreInfo> mapStoreInfo;
@@ -17,6 +17,7 @@
 #include <string.h>
 #include <new>
 #include <string.h>
+#include <vector>
 
 #ifndef BOX_DISABLE_BACKWARDS_COMPATIBILITY_BACKUPSTOREFILE
 	#include <stdio.h>
@@ -55,7 +56,7 @@ using namespace BackupStoreFileCryptVar;
 #define COPY_BUFFER_SIZE	(8*1024)
 
 // Statistics
-BackupStoreFileStats BackupStoreFile::msStats = {0,0,0};
+BackupStoreFileStats BackupStoreFile::msStats = {0,0,0,0};
 
 #ifndef BOX_DISABLE_BACKWARDS_COMPATIBILITY_BACKUPSTOREFILE
 	bool sWarnedAboutBackwardsCompatiblity = false;
@@ -98,12 +99,18 @@ std::auto_ptr<BackupStoreFileEncodeStream> BackupStoreFile::EncodeFile(
 // --------------------------------------------------------------------------
 //
 // Function
-//		Name:    BackupStoreFile::VerifyEncodedFileFormat(IOStream &)
+//		Name:    BackupStoreFile::VerifyEncodedFileFormat(IOStream &,
+//			 int64_t *, int64_t *, VerifyLevel)
 //		Purpose: Verify that an encoded file meets the format
 //			 requirements. Doesn't verify that the data is intact
 //			 and can be decoded. Optionally returns the ID of the
 //			 file which it is diffed from, and the (original)
-//			 container ID. This is more efficient than
+//			 container ID. Level says how much of the file to
+//			 read: with VerifyLevel_Headers, the diff-from ID is
+//			 not checked against the block index entries, and
+//			 with VerifyLevel_AllData, every block stored in the
+//			 file is read and must have a known encoding, so that
+//			 unreadable data is found too. This is more efficient than
 //			 BackupStoreFile::VerifyStream() when the file data
 //			 already exists on disk and we can Seek() around in
 //			 it, but less efficient if we are reading the stream
@@ -115,7 +122,8 @@ std::auto_ptr<BackupStoreFileEncodeStream> BackupStoreFile::EncodeFile(
 //		Created: 2003/08/28
 //
 // --------------------------------------------------------------------------
-bool BackupStoreFile::VerifyEncodedFileFormat(IOStream &rFile, int64_t *pDiffFromObjectIDOut, int64_t *pContainerIDOut)
+bool BackupStoreFile::VerifyEncodedFileFormat(IOStream &rFile, int64_t *pDiffFromObjectIDOut, int64_t *pContainerIDOut,
+	VerifyLevel Level)
 {
 	// Get the size of the file
 	int64_t fileSize = rFile.BytesLeftToRead();
@@ -207,9 +215,29 @@ bool BackupStoreFile::VerifyEncodedFileFormat(IOStream &rFile, int64_t *pDiffFro
 		return false;
 	}
 
+	int64_t otherID = box_ntoh64(blkhdr.mOtherFileID);
+
+	if(Level == VerifyLevel_Headers)
+	{
+		// The block index fits, and looks like a block index, which
+		// is as far as we go.
+		if(pDiffFromObjectIDOut)
+		{
+			*pDiffFromObjectIDOut = otherID;
+		}
+		if(pContainerIDOut)
+		{
+			*pContainerIDOut = box_ntoh64(hdr.mContainerID);
+		}
+		return true;
+	}
+
 	// Flag for recording whether a block is referenced from another file
 	bool blockFromOtherFileReferenced = false;
 
+	// Sizes of the blocks in this file, if we're going to read them
+	std::vector<int64_t> blockSizes;
+
 	// Read the index, checking that the length values all make sense
 	int64_t currentBlockStart = headerEnd;
 	for(int64_t b = 0; b < numBlocks; ++b)
@@ -240,6 +268,11 @@ bool BackupStoreFile::VerifyEncodedFileFormat(IOStream &rFile, int64_t *pDiffFro
 
 			// Move the current block start to the end of this block
 			currentBlockStart += blkSize;
+
+			if(Level == VerifyLevel_AllData)
+			{
+				blockSizes.push_back(blkSize);
+			}
 		}
 	}
 
@@ -251,7 +284,6 @@ bool BackupStoreFile::VerifyEncodedFileFormat(IOStream &rFile, int64_t *pDiffFro
 
 	// Check that if another file is referenced, then the ID is there, and if one
 	// isn't then there is no ID.
-	int64_t otherID = box_ntoh64(blkhdr.mOtherFileID);
 	if((otherID != 0 && blockFromOtherFileReferenced == false)
 		|| (otherID == 0 && blockFromOtherFileReferenced == true))
 	{
@@ -259,6 +291,43 @@ bool BackupStoreFile::VerifyEncodedFileFormat(IOStream &rFile, int64_t *pDiffFro
 		return false;
 	}
 
+	// Read all the blocks, checking that each starts with the header
+	// that DecodeChunk() expects. Without the keys, that's all that can
+	// be checked, but it does make sure the data can be read.
+	if(!blockSizes.empty())
+	{
+		rFile.Seek(headerEnd, IOStream::SeekType_Absolute);
+
+		char buffer[16*1024];
+		for(std::vector<int64_t>::const_iterator
+			i(blockSizes.begin()); i != blockSizes.end(); i++)
+		{
+			uint8_t header;
+			if(!rFile.ReadFullBuffer(&header, 1, 0))
+			{
+				return false;
+			}
+
+			uint8_t encodingType = (header >> HEADER_ENCODING_SHIFT);
+			if(encodingType != HEADER_BLOWFISH_ENCODING &&
+				encodingType != HEADER_AES_ENCODING)
+			{
+				return false;
+			}
+
+			for(int64_t left = *i - 1; left > 0; )
+			{
+				int toRead = (left > (int64_t)sizeof(buffer)) ?
+					sizeof(buffer) : left;
+				if(!rFile.ReadFullBuffer(buffer, toRead, 0))
+				{
+					return false;
+				}
+				left -= toRead;
+			}
+		}
+	}
+
 	// Does the caller want the other ID?
 	if(pDiffFromObjectIDOut)
 	{
@@ -1604,6 +1673,7 @@ void BackupStoreFile::ResetStats()
 	msStats.mBytesInEncodedFiles = 0;
 	msStats.mBytesAlreadyOnServer = 0;
 	msStats.mTotalFileStreamSize = 0;
+	msStats.mEncodingTime = 0;
 }
 
 
@@ -18,6 +18,7 @@
 #include "BackupClientFileAttributes.h"
 #include "BackupStoreFileWire.h"
 #include "BackupStoreFilename.h"
+#include "BoxTime.h"
 #include "CollectInBufferStream.h"
 #include "IOStream.h"
 #include "ReadLoggingStream.h"
@@ -27,6 +28,8 @@ typedef struct
 	int64_t mBytesInEncodedFiles;
 	int64_t mBytesAlreadyOnServer;
 	int64_t mTotalFileStreamSize;
+	// Time spent reading, compressing and encrypting blocks
+	box_time_t mEncodingTime;
 } BackupStoreFileStats;
 
 class BackgroundTask;
@@ -214,7 +217,18 @@ public:
 		ReadLoggingStream::Logger* pLogger = NULL,
 		RunStatusProvider* pRunStatusProvider = NULL);
 
-	static bool VerifyEncodedFileFormat(IOStream &rFile, int64_t *pDiffFromObjectIDOut = 0, int64_t *pContainerIDOut = 0);
+	// How much of an encoded file VerifyEncodedFileFormat() reads
+	typedef enum
+	{
+		// The header, and the header of the block index
+		VerifyLevel_Headers = 0,
+		// And every entry in the block index
+		VerifyLevel_BlockIndex,
+		// And every byte of every block stored in the file
+		VerifyLevel_AllData,
+	} VerifyLevel;
+	static bool VerifyEncodedFileFormat(IOStream &rFile, int64_t *pDiffFromObjectIDOut = 0, int64_t *pContainerIDOut = 0,
+		VerifyLevel Level = VerifyLevel_BlockIndex);
 	static void CombineFile(IOStream &rDiff, IOStream &rDiff2, IOStream &rFrom, IOStream &rOut);
 	static void CombineDiffs(IOStream &rDiff1, IOStream &rDiff2, IOStream &rDiff2b, IOStream &rOut);
 	static void ReverseDiffFile(IOStream &rDiff, IOStream &rFrom, IOStream &rFrom2, IOStream &rOut, int64_t ObjectIDOfFrom, bool *pIsCompletelyDifferent = 0);
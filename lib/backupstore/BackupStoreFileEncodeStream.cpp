@@ -415,48 +415,7 @@ int BackupStoreFileEncodeStream::Read(void *pBuffer, int NBytes, int Timeout)
 
 			if(mPositionInCurrentBlock >= mCurrentBlockEncodedSize)
 			{
-				// Next block!
-				++mCurrentBlock;
-				++mAbsoluteBlockNumber;
-				if(mCurrentBlock >= mNumBlocks)
-				{
-					// Output extra blocks for this instruction and move forward in file
-					if(mInstructionNumber >= 0)
-					{
-						SkipPreviousBlocksInInstruction();
-					}
-
-					// Is there another instruction to go?
-					++mInstructionNumber;
-
-					// Skip instructions which don't contain any data
-					while(mInstructionNumber < static_cast<int64_t>(mpRecipe->size())
-						&& (*mpRecipe)[mInstructionNumber].mSpaceBefore == 0)
-					{
-						SkipPreviousBlocksInInstruction();
-						++mInstructionNumber;
-					}
-
-					if(mInstructionNumber >= static_cast<int64_t>(mpRecipe->size()))
-					{
-						// End of blocks, go to next phase
-						++mStatus;
-
-						// Set the data to reading so the index can be written
-						mData.SetForReading();
-					}
-					else
-					{
-						// Get ready for this instruction
-						SetForInstruction();
-					}
-				}
-
-				// Can't use 'else' here as SetForInstruction() will change this
-				if(mCurrentBlock < mNumBlocks)
-				{
-					EncodeCurrentBlock();
-				}
+				MoveToNextBlock();
 			}
 
 			// Send data from the current block (if there's data to send)
@@ -491,6 +450,137 @@ int BackupStoreFileEncodeStream::Read(void *pBuffer, int NBytes, int Timeout)
 }
 
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreFileEncodeStream::MoveToNextBlock()
+//		Purpose: Private. Move on to the next block to be sent, and
+//			 encode it, moving on to the block listing if there
+//			 are no more blocks.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupStoreFileEncodeStream::MoveToNextBlock()
+{
+	++mCurrentBlock;
+	++mAbsoluteBlockNumber;
+	if(mCurrentBlock >= mNumBlocks)
+	{
+		// Output extra blocks for this instruction and move forward in file
+		if(mInstructionNumber >= 0)
+		{
+			SkipPreviousBlocksInInstruction();
+		}
+
+		// Is there another instruction to go?
+		++mInstructionNumber;
+
+		// Skip instructions which don't contain any data
+		while(mInstructionNumber < static_cast<int64_t>(mpRecipe->size())
+			&& (*mpRecipe)[mInstructionNumber].mSpaceBefore == 0)
+		{
+			SkipPreviousBlocksInInstruction();
+			++mInstructionNumber;
+		}
+
+		if(mInstructionNumber >= static_cast<int64_t>(mpRecipe->size()))
+		{
+			// End of blocks, go to next phase
+			++mStatus;
+
+			// Set the data to reading so the index can be written
+			mData.SetForReading();
+		}
+		else
+		{
+			// Get ready for this instruction
+			SetForInstruction();
+		}
+	}
+
+	// Can't use 'else' here as SetForInstruction() will change this
+	if(mCurrentBlock < mNumBlocks)
+	{
+		box_time_t start = GetCurrentBoxTime();
+		EncodeCurrentBlock();
+		BackupStoreFile::msStats.mEncodingTime +=
+			GetCurrentBoxTime() - start;
+	}
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreFileEncodeStream::SkipToBlockBoundary(int64_t)
+//		Purpose: Before anything has been read from a stream of a
+//			 whole file, skip over the header and as many whole
+//			 blocks as end at or before MaxOffset bytes into the
+//			 encoded stream, so that an upload which already got
+//			 that far can be resumed. Returns the offset at which
+//			 the remaining stream starts, which is zero if nothing
+//			 could be skipped.
+//
+//			 This relies on the encoded header and blocks being
+//			 exactly the same size as those encoded before, which
+//			 is true for the same file contents and attributes.
+//			 The skipped blocks still have entries in the index.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int64_t BackupStoreFileEncodeStream::SkipToBlockBoundary(int64_t MaxOffset)
+{
+	ASSERT(mpRecipe != 0);
+	if(mStatus != Status_Header || mTotalBytesSent != 0)
+	{
+		THROW_EXCEPTION(BackupStoreException, Internal)
+	}
+
+	// Only whole files can be resumed, as diffs depend on the file
+	// on the server, which may have changed since.
+	if(!mSendData || mpRecipe->size() != 1 || (*mpRecipe)[0].mBlocks != 0)
+	{
+		return 0;
+	}
+
+	int64_t offset = mData.BytesLeftToRead();
+	if(offset > MaxOffset)
+	{
+		return 0;
+	}
+
+	// Read past the header, so that the block index header is set up
+	uint8_t discard[256];
+	while(mStatus == Status_Header)
+	{
+		int64_t left = mData.BytesLeftToRead();
+		Read(discard, (left < (int64_t)sizeof(discard))
+			? (int)left : (int)sizeof(discard),
+			IOStream::TimeOutInfinite);
+	}
+
+	// Encode blocks until one doesn't fit. That one will be sent first.
+	while(mStatus == Status_Blocks)
+	{
+		MoveToNextBlock();
+		if(mStatus != Status_Blocks ||
+			offset + mCurrentBlockEncodedSize > MaxOffset)
+		{
+			break;
+		}
+
+		offset += mCurrentBlockEncodedSize;
+		mPositionInCurrentBlock = mCurrentBlockEncodedSize;
+	}
+
+	// Only count what is actually sent from now on
+	BackupStoreFile::msStats.mTotalFileStreamSize -= mTotalBytesSent;
+	mTotalBytesSent = 0;
+
+	return offset;
+}
+
+
 // --------------------------------------------------------------------------
 //
 // Function
@@ -89,6 +89,7 @@ public:
 	virtual bool StreamClosed();
 	int64_t GetBytesToUpload() { return mBytesToUpload; }
 	int64_t GetTotalBytesSent() { return mTotalBytesSent; }
+	int64_t SkipToBlockBoundary(int64_t MaxOffset);
 
 	static void CalculateBlockSizes(int64_t DataSize, int64_t &rNumBlocksOut,
 		int32_t &rBlockSizeOut, int32_t &rLastBlockSizeOut);
@@ -102,6 +103,7 @@ private:
 		Status_Finished = 3
 	};
 
+	void MoveToNextBlock();
 	void EncodeCurrentBlock();
 	void SkipPreviousBlocksInInstruction();
 	void SetForInstruction();
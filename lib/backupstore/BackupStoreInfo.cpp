@@ -349,12 +349,14 @@ std::auto_ptr<BackupStoreInfo> BackupStoreInfo::CreateForRegeneration(
 // --------------------------------------------------------------------------
 //
 // Function
-//		Name:    BackupStoreInfo::Save(bool allowOverwrite)
-//		Purpose: Save modified info back to disc
+//		Name:    BackupStoreInfo::Save(bool allowOverwrite,
+//			 RaidFileSyncGroup *pSyncGroup)
+//		Purpose: Save modified info back to disc, adding the file
+//			 to the sync group if one is given
 //		Created: 2003/08/28
 //
 // --------------------------------------------------------------------------
-void BackupStoreInfo::Save(bool allowOverwrite)
+void BackupStoreInfo::Save(bool allowOverwrite, RaidFileSyncGroup *pSyncGroup)
 {
 	// Make sure we're initialised (although should never come to this)
 	if(mFilename.empty() || mAccountID == -1 || mDiscSet == -1)
@@ -374,7 +376,7 @@ void BackupStoreInfo::Save(bool allowOverwrite)
 	Save(rf);
 
 	// Commit it to disc, converting it to RAID now
-	rf.Commit(true);
+	rf.Commit(true, pSyncGroup);
 }
 
 void BackupStoreInfo::Save(IOStream& rOutStream)
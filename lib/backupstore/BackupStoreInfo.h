@@ -17,6 +17,7 @@
 #include "CollectInBufferStream.h"
 
 class BackupStoreCheck;
+class RaidFileSyncGroup;
 
 // set packing to one byte
 #ifdef STRUCTURE_PACKING_FOR_WIRE_USE_HEADERS
@@ -96,7 +97,8 @@ public:
 	bool IsModified() const {return mIsModified;}
 
 	// Save modified infomation back to store
-	void Save(bool allowOverwrite = true);
+	void Save(bool allowOverwrite = true,
+		RaidFileSyncGroup *pSyncGroup = NULL);
 	void Save(IOStream& rOutStream);
 
 	// Data access functions
@@ -15,6 +15,7 @@
 
 #include "autogen_BackupStoreException.h"
 #include "BackupConstants.h"
+#include "BackupFileSystem.h"
 #include "BackupStoreAccountDatabase.h"
 #include "BackupStoreConstants.h"
 #include "BackupStoreDirectory.h"
@@ -24,8 +25,6 @@
 #include "BufferedStream.h"
 #include "HousekeepStoreAccount.h"
 #include "NamedLock.h"
-#include "RaidFileRead.h"
-#include "RaidFileWrite.h"
 #include "StoreStructure.h"
 
 #include "MemLeakFindOn.h"
@@ -36,18 +35,23 @@
 // --------------------------------------------------------------------------
 //
 // Function
-//		Name:    HousekeepStoreAccount::HousekeepStoreAccount(int, const std::string &, int, BackupStoreDaemon &)
-//		Purpose: Constructor
+//		Name:    HousekeepStoreAccount::HousekeepStoreAccount(int, const std::string &, int, HousekeepingCallback *, BackupFileSystem *)
+//		Purpose: Constructor. If pFileSystem is NULL, the
+//			 account's files and directories are in its disc set.
 //		Created: 11/12/03
 //
 // --------------------------------------------------------------------------
 HousekeepStoreAccount::HousekeepStoreAccount(int AccountID,
 	const std::string &rStoreRoot, int StoreDiscSet,
-	HousekeepingCallback* pHousekeepingCallback)
+	HousekeepingCallback* pHousekeepingCallback,
+	BackupFileSystem* pFileSystem)
 	: mAccountID(AccountID),
 	  mStoreRoot(rStoreRoot),
 	  mStoreDiscSet(StoreDiscSet),
 	  mpHousekeepingCallback(pHousekeepingCallback),
+	  mapOwnFileSystem(pFileSystem ? NULL :
+		new RaidBackupFileSystem(StoreDiscSet)),
+	  mrFileSystem(pFileSystem ? *pFileSystem : *mapOwnFileSystem),
 	  mDeletionSizeTarget(0),
   	  mPotentialDeletionsTotalSize(0),
 	  mMaxSizeInPotentialDeletions(0),
@@ -132,6 +136,7 @@ bool HousekeepStoreAccount::DoHousekeeping(bool KeepTryingForever)
 			return false;
 		}
 	}
+	mrFileSystem.SetHaveWriteLock(true);
 
 	// Load the store info to find necessary info for the housekeeping
 	std::auto_ptr<BackupStoreInfo> info(BackupStoreInfo::Load(mAccountID,
@@ -207,6 +212,7 @@ bool HousekeepStoreAccount::DoHousekeeping(bool KeepTryingForever)
 	{
 		mapNewRefs->Discard();
 		info->Save();
+		mrFileSystem.SetHaveWriteLock(false);
 		return false;
 	}
 
@@ -291,6 +297,7 @@ bool HousekeepStoreAccount::DoHousekeeping(bool KeepTryingForever)
 
 	// Explicity release the lock (would happen automatically on
 	// going out of scope, included for code clarity)
+	mrFileSystem.SetHaveWriteLock(false);
 	writeLock.ReleaseLock();
 
 	BOX_TRACE("Finished housekeeping on account " <<
@@ -349,8 +356,8 @@ bool HousekeepStoreAccount::ScanDirectory(int64_t ObjectID,
 	MakeObjectFilename(ObjectID, objectFilename);
 
 	// Open it.
-	std::auto_ptr<RaidFileRead> dirStream(RaidFileRead::Open(mStoreDiscSet,
-		objectFilename));
+	std::auto_ptr<BackupFileSystemRead> dirStream(
+		mrFileSystem.OpenRead(objectFilename));
 
 	// Add the size of the directory on disc to the size being calculated
 	int64_t originalDirSizeInBlocks = dirStream->GetDiscUsageInBlocks();
@@ -636,7 +643,7 @@ bool HousekeepStoreAccount::DeleteFiles(BackupStoreInfo& rBackupStoreInfo)
 		BackupStoreDirectory dir;
 		{
 			MakeObjectFilename(i->mInDirectory, dirFilename);
-			std::auto_ptr<RaidFileRead> dirStream(RaidFileRead::Open(mStoreDiscSet, dirFilename));
+			std::auto_ptr<BackupFileSystemRead> dirStream(mrFileSystem.OpenRead(dirFilename));
 			dir.ReadFromStream(*dirStream, IOStream::TimeOutInfinite);
 			dir.SetUserInfo1_SizeInBlocks(dirStream->GetDiscUsageInBlocks());
 		}
@@ -699,7 +706,7 @@ BackupStoreRefCountDatabase::refcount_t HousekeepStoreAccount::DeleteFile(
 	bool wasOldVersion = false;
 	int64_t deletedFileSizeInBlocks = 0;
 	// A pointer to an object which requires committing if the directory save goes OK
-	std::auto_ptr<RaidFileWrite> padjustedEntry;
+	std::auto_ptr<BackupFileSystemWrite> padjustedEntry;
 	// BLOCK
 	{
 		BackupStoreRefCountDatabase::refcount_t refs =
@@ -803,16 +810,15 @@ BackupStoreRefCountDatabase::refcount_t HousekeepStoreAccount::DeleteFile(
 			std::string objFilenameOlder;
 			MakeObjectFilename(pentry->GetDependsOlder(), objFilenameOlder);
 			// Open it twice (it's the diff)
-			std::auto_ptr<RaidFileRead> pdiff(RaidFileRead::Open(mStoreDiscSet, objFilenameOlder));
-			std::auto_ptr<RaidFileRead> pdiff2(RaidFileRead::Open(mStoreDiscSet, objFilenameOlder));
+			std::auto_ptr<BackupFileSystemRead> pdiff(mrFileSystem.OpenRead(objFilenameOlder));
+			std::auto_ptr<BackupFileSystemRead> pdiff2(mrFileSystem.OpenRead(objFilenameOlder));
 			// Open this file
 			std::string objFilename;
 			MakeObjectFilename(ObjectID, objFilename);
-			std::auto_ptr<RaidFileRead> pobjectBeingDeleted(RaidFileRead::Open(mStoreDiscSet, objFilename));
+			std::auto_ptr<BackupFileSystemRead> pobjectBeingDeleted(mrFileSystem.OpenRead(objFilename));
 			// And open a write file to overwrite the other directory entry
-			padjustedEntry.reset(new RaidFileWrite(mStoreDiscSet,
-				objFilenameOlder, mapNewRefs->GetRefCount(ObjectID)));
-			padjustedEntry->Open(true /* allow overwriting */);
+			padjustedEntry = mrFileSystem.OpenWrite(objFilenameOlder,
+				true /* allow overwriting */);
 
 			if(pentry->GetDependsNewer() == 0)
 			{
@@ -850,16 +856,16 @@ BackupStoreRefCountDatabase::refcount_t HousekeepStoreAccount::DeleteFile(
 	// Save directory back to disc
 	// BLOCK
 	{
-		RaidFileWrite writeDir(mStoreDiscSet, rDirectoryFilename,
-			mapNewRefs->GetRefCount(InDirectory));
-		writeDir.Open(true /* allow overwriting */);
-		rDirectory.WriteToStream(writeDir);
+		std::auto_ptr<BackupFileSystemWrite> writeDir(
+			mrFileSystem.OpenWrite(rDirectoryFilename,
+				true /* allow overwriting */));
+		rDirectory.WriteToStream(*writeDir);
 
 		// Get the disc usage (must do this before commiting it)
-		int64_t new_size = writeDir.GetDiscUsageInBlocks();
+		int64_t new_size = writeDir->GetDiscUsageInBlocks();
 
 		// Commit directory
-		writeDir.Commit(BACKUP_STORE_CONVERT_TO_RAID_IMMEDIATELY);
+		writeDir->Commit();
 
 		// Adjust block counts if the directory itself changed in size
 		int64_t original_size = rDirectory.GetUserInfo1_SizeInBlocks();
@@ -873,7 +879,7 @@ BackupStoreRefCountDatabase::refcount_t HousekeepStoreAccount::DeleteFile(
 	// Commit any new adjusted entry
 	if(padjustedEntry.get() != 0)
 	{
-		padjustedEntry->Commit(BACKUP_STORE_CONVERT_TO_RAID_IMMEDIATELY);
+		padjustedEntry->Commit();
 		padjustedEntry.reset(); // delete it now
 	}
 
@@ -886,8 +892,7 @@ BackupStoreRefCountDatabase::refcount_t HousekeepStoreAccount::DeleteFile(
 		BOX_FORMAT_OBJECTID(ObjectID));
 	std::string objFilename;
 	MakeObjectFilename(ObjectID, objFilename);
-	RaidFileWrite del(mStoreDiscSet, objFilename, mapNewRefs->GetRefCount(ObjectID));
-	del.Delete();
+	mrFileSystem.DeleteObject(objFilename);
 
 	// Adjust counts for the file
 	++mFilesDeleted;
@@ -936,8 +941,8 @@ void HousekeepStoreAccount::UpdateDirectorySize(
 	{
 		std::string dirFilename;
 		MakeObjectFilename(rDirectory.GetObjectID(), dirFilename);
-		std::auto_ptr<RaidFileRead> dirStream(
-			RaidFileRead::Open(mStoreDiscSet, dirFilename));
+		std::auto_ptr<BackupFileSystemRead> dirStream(
+			mrFileSystem.OpenRead(dirFilename));
 		ASSERT(new_size_in_blocks == dirStream->GetDiscUsageInBlocks());
 	}
 #endif
@@ -959,8 +964,8 @@ void HousekeepStoreAccount::UpdateDirectorySize(
 
 	std::string parentFilename;
 	MakeObjectFilename(rDirectory.GetContainerID(), parentFilename);
-	std::auto_ptr<RaidFileRead> parentStream(
-		RaidFileRead::Open(mStoreDiscSet, parentFilename));
+	std::auto_ptr<BackupFileSystemRead> parentStream(
+		mrFileSystem.OpenRead(parentFilename));
 	BackupStoreDirectory parent(*parentStream);
 	parentStream.reset();
 
@@ -981,11 +986,11 @@ void HousekeepStoreAccount::UpdateDirectorySize(
 
 	en->SetSizeInBlocks(new_size_in_blocks);
 
-	RaidFileWrite writeDir(mStoreDiscSet, parentFilename,
-		mapNewRefs->GetRefCount(rDirectory.GetContainerID()));
-	writeDir.Open(true /* allow overwriting */);
-	parent.WriteToStream(writeDir);
-	writeDir.Commit(BACKUP_STORE_CONVERT_TO_RAID_IMMEDIATELY);
+	std::auto_ptr<BackupFileSystemWrite> writeDir(
+		mrFileSystem.OpenWrite(parentFilename,
+			true /* allow overwriting */));
+	parent.WriteToStream(*writeDir);
+	writeDir->Commit();
 }
 
 // --------------------------------------------------------------------------
@@ -1051,14 +1056,14 @@ void HousekeepStoreAccount::DeleteEmptyDirectory(int64_t dirId,
 		MakeObjectFilename(dirId, dirFilename);
 		// Check it actually exists (just in case it gets
 		// added twice to the list)
-		if(!RaidFileRead::FileExists(mStoreDiscSet, dirFilename))
+		if(!mrFileSystem.ObjectExists(dirFilename))
 		{
 			// doesn't exist, next!
 			return;
 		}
 		// load
-		std::auto_ptr<RaidFileRead> dirStream(
-			RaidFileRead::Open(mStoreDiscSet, dirFilename));
+		std::auto_ptr<BackupFileSystemRead> dirStream(
+			mrFileSystem.OpenRead(dirFilename));
 		dirSizeInBlocks = dirStream->GetDiscUsageInBlocks();
 		dir.ReadFromStream(*dirStream, IOStream::TimeOutInfinite);
 	}
@@ -1076,9 +1081,8 @@ void HousekeepStoreAccount::DeleteEmptyDirectory(int64_t dirId,
 	int64_t containingDirSizeInBlocksOrig = 0;
 	{
 		MakeObjectFilename(dir.GetContainerID(), containingDirFilename);
-		std::auto_ptr<RaidFileRead> containingDirStream(
-			RaidFileRead::Open(mStoreDiscSet,
-				containingDirFilename));
+		std::auto_ptr<BackupFileSystemRead> containingDirStream(
+			mrFileSystem.OpenRead(containingDirFilename));
 		containingDirSizeInBlocksOrig =
 			containingDirStream->GetDiscUsageInBlocks();
 		containingDir.ReadFromStream(*containingDirStream,
@@ -1102,16 +1106,16 @@ void HousekeepStoreAccount::DeleteEmptyDirectory(int64_t dirId,
 		}
 
 		// Write revised parent directory
-		RaidFileWrite writeDir(mStoreDiscSet, containingDirFilename,
-			mapNewRefs->GetRefCount(containingDir.GetObjectID()));
-		writeDir.Open(true /* allow overwriting */);
-		containingDir.WriteToStream(writeDir);
+		std::auto_ptr<BackupFileSystemWrite> writeDir(
+			mrFileSystem.OpenWrite(containingDirFilename,
+				true /* allow overwriting */));
+		containingDir.WriteToStream(*writeDir);
 
 		// get the disc usage (must do this before commiting it)
-		int64_t dirSize = writeDir.GetDiscUsageInBlocks();
+		int64_t dirSize = writeDir->GetDiscUsageInBlocks();
 
 		// Commit directory
-		writeDir.Commit(BACKUP_STORE_CONVERT_TO_RAID_IMMEDIATELY);
+		writeDir->Commit();
 		UpdateDirectorySize(containingDir, dirSize);
 
 		// adjust usage counts for this directory
@@ -1135,9 +1139,7 @@ void HousekeepStoreAccount::DeleteEmptyDirectory(int64_t dirId,
 		// Delete the directory itself
 		BOX_INFO("Housekeeping removing empty deleted dir " <<
 			BOX_FORMAT_OBJECTID(dirId));
-		RaidFileWrite del(mStoreDiscSet, dirFilename,
-			mapNewRefs->GetRefCount(dir.GetObjectID()));
-		del.Delete();
+		mrFileSystem.DeleteObject(dirFilename);
 
 		// And adjust usage counts for the directory that's
 		// just been deleted
@@ -10,12 +10,14 @@
 #ifndef HOUSEKEEPSTOREACCOUNT__H
 #define HOUSEKEEPSTOREACCOUNT__H
 
+#include <memory>
 #include <string>
 #include <set>
 #include <vector>
 
 #include "BackupStoreRefCountDatabase.h"
 
+class BackupFileSystem;
 class BackupStoreDirectory;
 
 class HousekeepingCallback
@@ -29,7 +31,11 @@ class HousekeepingCallback
 //
 // Class
 //		Name:    HousekeepStoreAccount
-//		Purpose: Action class to perform housekeeping on a store account
+//		Purpose: Action class to perform housekeeping on a store account.
+//			 The account's files and directories are read and
+//			 written through a BackupFileSystem, which is the
+//			 account's disc set unless another one, such as an
+//			 S3 store, is given.
 //		Created: 11/12/03
 //
 // --------------------------------------------------------------------------
@@ -37,7 +43,8 @@ class HousekeepStoreAccount
 {
 public:
 	HousekeepStoreAccount(int AccountID, const std::string &rStoreRoot,
-		int StoreDiscSet, HousekeepingCallback* pHousekeepingCallback);
+		int StoreDiscSet, HousekeepingCallback* pHousekeepingCallback,
+		BackupFileSystem* pFileSystem = NULL);
 	~HousekeepStoreAccount();
 	
 	bool DoHousekeeping(bool KeepTryingForever = false);
@@ -79,6 +86,8 @@ private:
 	std::string mStoreRoot;
 	int mStoreDiscSet;
 	HousekeepingCallback* mpHousekeepingCallback;
+	std::auto_ptr<BackupFileSystem> mapOwnFileSystem;
+	BackupFileSystem &mrFileSystem;
 	
 	int64_t mDeletionSizeTarget;
 	
@@ -93,3 +93,76 @@ void StoreStructure::MakeWriteLockFilename(const std::string &rStoreRoot, int Di
 }
 
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    StoreStructure::MakeStagingFilename(int64_t, const std::string &, int, std::string &)
+//		Purpose: Generate the on disc filename of a file uploaded with
+//			 StageFile or ResumeStagedFile, which lives in the
+//			 account root until the writer session adds it to the
+//			 store. It is a plain file rather than a RaidFile, so
+//			 that an interrupted upload can be appended to later.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void StoreStructure::MakeStagingFilename(int64_t StagingID, const std::string &rStoreRoot, int DiscSet, std::string &rFilenameOut)
+{
+	// Find the disc set
+	RaidFileController &rcontroller(RaidFileController::GetController());
+	RaidFileDiscSet &rdiscSet(rcontroller.GetDiscSet(DiscSet));
+
+	char leaf[32];
+	::snprintf(leaf, sizeof(leaf), "stage-%016llx",
+		(unsigned long long)StagingID);
+	rFilenameOut = rdiscSet[0] + DIRECTORY_SEPARATOR + rStoreRoot + leaf;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    StoreStructure::IsStagingFilename(const std::string &)
+//		Purpose: Does this leafname, in the account root, belong to
+//			 a staged file?
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool StoreStructure::IsStagingFilename(const std::string &rLeafname)
+{
+	return rLeafname.size() == 22 &&
+		rLeafname.compare(0, 6, "stage-") == 0;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    StoreStructure::MakeStagingCheckFilename(const std::string &, std::string &)
+//		Purpose: Generate the on disc filename of the file which
+//			 holds the resume check of a staged file, created with
+//			 a resume key so that a later session can find it,
+//			 which lives alongside the staged file.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void StoreStructure::MakeStagingCheckFilename(const std::string &rStagingFilename, std::string &rFilenameOut)
+{
+	rFilenameOut = rStagingFilename + ".check";
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    StoreStructure::IsStagingCheckFilename(const std::string &)
+//		Purpose: Does this leafname, in the account root, belong to
+//			 the resume check of a staged file?
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool StoreStructure::IsStagingCheckFilename(const std::string &rLeafname)
+{
+	return rLeafname.size() == 28 &&
+		IsStagingFilename(rLeafname.substr(0, 22)) &&
+		rLeafname.compare(22, 6, ".check") == 0;
+}
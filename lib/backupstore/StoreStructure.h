@@ -26,6 +26,10 @@ namespace StoreStructure
 {
 	void MakeObjectFilename(int64_t ObjectID, const std::string &rStoreRoot, int DiscSet, std::string &rFilenameOut, bool EnsureDirectoryExists);
 	void MakeWriteLockFilename(const std::string &rStoreRoot, int DiscSet, std::string &rFilenameOut);
+	void MakeStagingFilename(int64_t StagingID, const std::string &rStoreRoot, int DiscSet, std::string &rFilenameOut);
+	bool IsStagingFilename(const std::string &rLeafname);
+	void MakeStagingCheckFilename(const std::string &rStagingFilename, std::string &rFilenameOut);
+	bool IsStagingCheckFilename(const std::string &rLeafname);
 };
 
 #endif // STORESTRUCTURE__H
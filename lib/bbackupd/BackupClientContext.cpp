@@ -9,6 +9,12 @@
 
 #include "Box.h"
 
+#include <errno.h>
+
+#ifdef HAVE_UNISTD_H
+	#include <unistd.h>
+#endif
+
 #ifdef HAVE_SIGNAL_H
 	#include <signal.h>
 #endif
@@ -17,9 +23,18 @@
 	#include <sys/time.h>
 #endif
 
+#ifdef HAVE_SYS_WAIT_H
+	#include <sys/wait.h>
+#endif
+
+#ifndef WIN32
+	#include <poll.h>
+#endif
+
 #include "BoxPortsAndFiles.h"
 #include "BoxTime.h"
 #include "BackupClientContext.h"
+#include "BackupConstants.h"
 #include "SocketStreamTLS.h"
 #include "Socket.h"
 #include "BackupStoreConstants.h"
@@ -32,6 +47,11 @@
 
 #include "MemLeakFindOn.h"
 
+// How often to send keep-alive messages while waiting for uploads on extra
+// connections, if KeepAliveTime isn't set, to stay well inside the server's
+// timeout
+#define STAGED_UPLOAD_KEEPALIVE_MS	(BACKUP_STORE_TIMEOUT / 3)
+
 // --------------------------------------------------------------------------
 //
 // Function
@@ -74,7 +94,8 @@ BackupClientContext::BackupClientContext
   mbIsManaged(false),
   mrProgressNotifier(rProgressNotifier),
   mTcpNiceMode(TcpNiceMode),
-  mpNice(NULL)
+  mpNice(NULL),
+  mLastStagedUploadKeepAlive(0)
 {
 }
 
@@ -262,6 +283,10 @@ BackupProtocolCallable* BackupClientContext::GetOpenConnection() const
 // --------------------------------------------------------------------------
 void BackupClientContext::CloseAnyOpenConnection()
 {
+	// Uploads which haven't been added to the store yet never will be,
+	// once the connection which holds the write lock has gone.
+	AbandonStagedUploads();
+
 	BackupProtocolCallable* pConnection(GetOpenConnection());
 	if(pConnection)
 	{
@@ -276,6 +301,7 @@ void BackupClientContext::CloseAnyOpenConnection()
 		}
 
 		// Delete it anyway.
+		RecordQueryStats();
 		mapConnection.reset();
 	}
 
@@ -295,6 +321,395 @@ void BackupClientContext::CloseAnyOpenConnection()
 
 
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupClientContext::RecordQueryStats()
+//		Purpose: Adds the round trips made on the main connection
+//			 so far to the sync report, and starts counting
+//			 them again.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupClientContext::RecordQueryStats()
+{
+	if(!mapConnection.get())
+	{
+		return;
+	}
+
+	const BackupProtocolCallable::QueryStatsMap &rStats(
+		mapConnection->GetQueryStats());
+	for(BackupProtocolCallable::QueryStatsMap::const_iterator
+		i = rStats.begin(); i != rStats.end(); i++)
+	{
+		mSyncReport.AddRoundTrips(i->first, i->second.mCount,
+			i->second.mTotalTime);
+	}
+	mapConnection->ResetQueryStats();
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupClientContext::OpenExtraConnection()
+//		Purpose: Open and log into an additional, read-only
+//			 connection to the store, for a child process to
+//			 stage a large file on while the main connection
+//			 carries on with the rest of the sync.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::auto_ptr<BackupProtocolCallable> BackupClientContext::OpenExtraConnection()
+{
+	std::auto_ptr<SocketStream> apSocket(new SocketStreamTLS);
+	((SocketStreamTLS *)(apSocket.get()))->Open(mrTLSContext,
+		Socket::TypeINET, mHostname, mPort);
+
+	BackupProtocolClient *pClient = new BackupProtocolClient(apSocket);
+	std::auto_ptr<BackupProtocolCallable> apConnection(pClient);
+	pClient->Handshake();
+
+	std::auto_ptr<BackupProtocolVersion> serverVersion(
+		apConnection->QueryVersion(BACKUP_STORE_SERVER_VERSION));
+	if(serverVersion->GetVersion() != BACKUP_STORE_SERVER_VERSION)
+	{
+		THROW_EXCEPTION(BackupStoreException, WrongServerVersion)
+	}
+
+	// The main connection holds the write lock, so this one can't
+	std::auto_ptr<BackupProtocolLoginConfirmed> loginConf(
+		apConnection->QueryLogin(mAccountNumber,
+			BackupProtocolLogin::Flags_ReadOnly));
+
+	if(loginConf->GetClientStoreMarker() != mClientStoreMarker)
+	{
+		THROW_EXCEPTION_MESSAGE(BackupStoreException,
+			ClientMarkerNotAsExpected,
+			"Expected " << mClientStoreMarker <<
+			" but found " << loginConf->GetClientStoreMarker() <<
+			" on extra connection: is someone else writing to "
+			"the same account?");
+	}
+
+	return apConnection;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupClientContext::DetachConnectionAfterFork()
+//		Purpose: In a child process, forget about the parent's
+//			 connection without closing it or sending anything on
+//			 it, as the parent is still using it.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupClientContext::DetachConnectionAfterFork()
+{
+	// Deliberately leaked, we're about to _exit() anyway
+	mapConnection.release();
+	mpNice = NULL;
+	mTcpNiceMode = false;
+	mpExtendedLogFileHandle = NULL;
+	mpDeleteList = 0;
+	mStagedUploads.clear();
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupClientContext::AddStagedUpload(pid_t, int,
+//			 const StagedUpload &)
+//		Purpose: Keep track of a child process uploading a file on
+//			 an extra connection, which will write its results
+//			 to ResultFd before exiting.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupClientContext::AddStagedUpload(pid_t ChildPid, int ResultFd,
+	const StagedUpload &rUpload)
+{
+	RunningStagedUpload running;
+	running.mPid = ChildPid;
+	running.mResultFd = ResultFd;
+	running.mFinished = false;
+	running.mUpload = rUpload;
+	mStagedUploads.push_back(running);
+
+	// The main connection has just been used to decide to upload it
+	mLastStagedUploadKeepAlive = GetCurrentBoxTime();
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupClientContext::GetNumStagedUploadsRunning()
+//		Purpose: How many child processes are still uploading?
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int BackupClientContext::GetNumStagedUploadsRunning() const
+{
+	int running = 0;
+	for(std::list<RunningStagedUpload>::const_iterator
+		i = mStagedUploads.begin(); i != mStagedUploads.end(); i++)
+	{
+		if(!i->mFinished)
+		{
+			running++;
+		}
+	}
+	return running;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupClientContext::FinishStagedUpload(
+//			 RunningStagedUpload &)
+//		Purpose: Read the results of a child process which has
+//			 written them, or closed its end of the pipe, and
+//			 reap it. It has finished with the server by then,
+//			 so this doesn't block for long.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupClientContext::FinishStagedUpload(RunningStagedUpload &rRunning)
+{
+#ifndef WIN32
+	StagedUploadResult result = {0, 0, 0, 0, 0, 0};
+	char *pBuffer = (char *)&result;
+	size_t bytesRead = 0;
+
+	while(bytesRead < sizeof(result))
+	{
+		ssize_t got = ::read(rRunning.mResultFd, pBuffer + bytesRead,
+			sizeof(result) - bytesRead);
+		if(got == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		else if(got <= 0)
+		{
+			break;
+		}
+		bytesRead += got;
+	}
+
+	::close(rRunning.mResultFd);
+	rRunning.mResultFd = -1;
+
+	int status = 0;
+	while(::waitpid(rRunning.mPid, &status, 0) == -1 && errno == EINTR)
+	{ }
+
+	if(bytesRead != sizeof(result))
+	{
+		// Child died without telling us anything
+		BOX_ERROR("Upload process " << rRunning.mPid << " for " <<
+			rRunning.mUpload.mNonVssFilePath << " exited "
+			"unexpectedly");
+		result.mStagingID = 0;
+		result.mStorageLimitExceeded = 0;
+	}
+
+	rRunning.mUpload.mStagingID = result.mStagingID;
+	rRunning.mUpload.mDiffFromID = result.mDiffFromID;
+	rRunning.mUpload.mUploadedSize = result.mUploadedSize;
+	rRunning.mUpload.mStorageLimitExceeded =
+		(result.mStorageLimitExceeded != 0);
+	rRunning.mUpload.mUploadTime = result.mUploadTime;
+
+	// Time spent in parallel with the main process, so the phases can
+	// add up to more than the whole sync took
+	mSyncReport.AddTime(BackupSyncReport::Phase_UploadFile,
+		result.mUploadTime);
+	mSyncReport.AddTime(BackupSyncReport::Phase_Encode,
+		result.mEncodingTime);
+#endif // !WIN32
+
+	rRunning.mFinished = true;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupClientContext::WaitForStagedUpload(int64_t)
+//		Purpose: Block until at least one of the child processes
+//			 uploading files in the given directory, or in any
+//			 directory if it's zero, has finished, and read its
+//			 results. Returns false if there are none running.
+//			 Sends keep-alive messages on the main connection
+//			 while waiting, even if KeepAliveTime isn't set, so
+//			 that the server doesn't time it out while a big
+//			 file is uploaded.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool BackupClientContext::WaitForStagedUpload(int64_t DirectoryID)
+{
+#ifdef WIN32
+	return false;
+#else
+	std::vector<struct pollfd> fds;
+	std::vector<RunningStagedUpload *> uploads;
+
+	for(std::list<RunningStagedUpload>::iterator
+		i = mStagedUploads.begin(); i != mStagedUploads.end(); i++)
+	{
+		if(!i->mFinished && (DirectoryID == 0 ||
+			i->mUpload.mDirectoryID == DirectoryID))
+		{
+			struct pollfd p;
+			p.fd = i->mResultFd;
+			p.events = POLLIN;
+			p.revents = 0;
+			fds.push_back(p);
+			uploads.push_back(&(*i));
+		}
+	}
+
+	if(fds.empty())
+	{
+		return false;
+	}
+
+	box_time_t interval = (mKeepAliveTime > 0)
+		? SecondsToBoxTime(mKeepAliveTime)
+		: MilliSecondsToBoxTime(STAGED_UPLOAD_KEEPALIVE_MS);
+
+	while(true)
+	{
+		box_time_t now = GetCurrentBoxTime();
+		box_time_t due = mLastStagedUploadKeepAlive + interval;
+		if(now >= due)
+		{
+			if(GetOpenConnection())
+			{
+				BOX_TRACE("Sending keep-alive message while "
+					"waiting for uploads");
+				GetOpenConnection()->QueryGetIsAlive();
+			}
+			mLastStagedUploadKeepAlive = now;
+			due = now + interval;
+		}
+
+		int result = ::poll(&fds[0], fds.size(),
+			(int)BoxTimeToMilliSeconds(due - now) + 1);
+		if(result == -1 && errno != EINTR)
+		{
+			THROW_SYS_ERROR("Failed to wait for upload processes",
+				CommonException, OSFileError);
+		}
+		else if(result > 0)
+		{
+			break;
+		}
+	}
+
+	for(size_t i = 0; i < fds.size(); i++)
+	{
+		if(fds[i].revents != 0)
+		{
+			FinishStagedUpload(*uploads[i]);
+		}
+	}
+
+	return true;
+#endif // WIN32
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupClientContext::WaitForStagedUploads(int)
+//		Purpose: Block until fewer than MaxRunning child processes
+//			 are still uploading. The results are kept until the
+//			 directory record which started them collects them.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupClientContext::WaitForStagedUploads(int MaxRunning)
+{
+	while(GetNumStagedUploadsRunning() >= MaxRunning &&
+		WaitForStagedUpload(0 /* any directory */))
+	{ }
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupClientContext::CollectStagedUploads(int64_t,
+//			 std::vector<StagedUpload> &)
+//		Purpose: Wait for all uploads of files in the given
+//			 directory, and return their results, forgetting
+//			 about them.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupClientContext::CollectStagedUploads(int64_t DirectoryID,
+	std::vector<StagedUpload> &rFinishedOut)
+{
+	while(WaitForStagedUpload(DirectoryID))
+	{ }
+
+	std::list<RunningStagedUpload>::iterator i = mStagedUploads.begin();
+	while(i != mStagedUploads.end())
+	{
+		if(i->mUpload.mDirectoryID != DirectoryID)
+		{
+			i++;
+			continue;
+		}
+
+		if(!i->mFinished)
+		{
+			FinishStagedUpload(*i);
+		}
+
+		rFinishedOut.push_back(i->mUpload);
+		i = mStagedUploads.erase(i);
+	}
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupClientContext::AbandonStagedUploads()
+//		Purpose: Stop any child processes still uploading, and
+//			 forget about all staged uploads. Anything already
+//			 staged will be cleaned up by the server.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupClientContext::AbandonStagedUploads()
+{
+#ifndef WIN32
+	for(std::list<RunningStagedUpload>::iterator
+		i = mStagedUploads.begin(); i != mStagedUploads.end(); i++)
+	{
+		if(!i->mFinished)
+		{
+			::kill(i->mPid, SIGKILL);
+			FinishStagedUpload(*i);
+		}
+	}
+#endif
+
+	mStagedUploads.clear();
+}
+
+
 // --------------------------------------------------------------------------
 //
 // Function
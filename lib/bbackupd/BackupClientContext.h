@@ -15,6 +15,8 @@
 #include "BackupClientDirectoryRecord.h"
 #include "BackupDaemonInterface.h"
 #include "BackupStoreFile.h"
+#include "BackupStoreFilenameClear.h"
+#include "BackupSyncReport.h"
 #include "ExcludeList.h"
 #include "TcpNice.h"
 #include "Timer.h"
@@ -24,9 +26,10 @@ class BackupProtocolClient;
 class SocketStreamTLS;
 class BackupClientInodeToIDMap;
 class BackupDaemon;
-class BackupStoreFilenameClear;
 
+#include <list>
 #include <string>
+#include <vector>
 
 
 // --------------------------------------------------------------------------
@@ -220,9 +223,90 @@ public:
 		}
 	}
 
+	BackupSyncReport& GetSyncReport() { return mSyncReport; }
+	void RecordQueryStats();
+
+	// --------------------------------------------------------------------------
+	//
+	// Class
+	//		Name:    BackupClientContext::StagedUpload
+	//		Purpose: A file uploaded by a child process on an extra
+	//			 store connection, which the main connection adds
+	//			 to the store once the server has staged it.
+	//		Created: 2026/10/19
+	//
+	// --------------------------------------------------------------------------
+	class StagedUpload
+	{
+	public:
+		StagedUpload()
+		: mDirectoryID(0),
+		  mModificationTime(0),
+		  mAttributesHash(0),
+		  mFileSize(0),
+		  mInodeNumber(0),
+		  mWasPending(false),
+		  mStagingID(0),
+		  mDiffFromID(0),
+		  mUploadedSize(0),
+		  mStorageLimitExceeded(false),
+		  mUploadTime(0)
+		{ }
+
+		int64_t mDirectoryID;
+		std::string mLeafname;
+		std::string mNonVssFilePath;
+		BackupStoreFilenameClear mStoreFilename;
+		box_time_t mModificationTime;
+		box_time_t mAttributesHash;
+		int64_t mFileSize;
+		InodeRefType mInodeNumber;
+		bool mWasPending;
+
+		// Filled in from the child process. mStagingID is zero
+		// if the upload failed.
+		int64_t mStagingID;
+		int64_t mDiffFromID;
+		int64_t mUploadedSize;
+		bool mStorageLimitExceeded;
+		box_time_t mUploadTime;
+	};
+
+	// Written by the child process to its result pipe before exiting
+	typedef struct
+	{
+		int64_t mStagingID;
+		int64_t mDiffFromID;
+		int64_t mUploadedSize;
+		int32_t mStorageLimitExceeded;
+		int64_t mUploadTime;
+		int64_t mEncodingTime;
+	} StagedUploadResult;
+
+	std::auto_ptr<BackupProtocolCallable> OpenExtraConnection();
+	void DetachConnectionAfterFork();
+	void AddStagedUpload(pid_t ChildPid, int ResultFd,
+		const StagedUpload &rUpload);
+	int GetNumStagedUploadsRunning() const;
+	void WaitForStagedUploads(int MaxRunning);
+	void CollectStagedUploads(int64_t DirectoryID,
+		std::vector<StagedUpload> &rFinishedOut);
+	void AbandonStagedUploads();
+
 	bool mExperimentalSnapshotMode;
 
 private:
+	typedef struct
+	{
+		pid_t mPid;
+		int mResultFd;
+		bool mFinished;
+		StagedUpload mUpload;
+	} RunningStagedUpload;
+
+	void FinishStagedUpload(RunningStagedUpload &rRunning);
+	bool WaitForStagedUpload(int64_t DirectoryID);
+
 	LocationResolver &mrResolver;
 	TLSContext &mrTLSContext;
 	std::string mHostname;
@@ -247,6 +331,9 @@ private:
 	ProgressNotifier &mrProgressNotifier;
 	bool mTcpNiceMode;
 	NiceSocketStream *mpNice;
+	std::list<RunningStagedUpload> mStagedUploads;
+	box_time_t mLastStagedUploadKeepAlive;
+	BackupSyncReport mSyncReport;
 };
 
 #endif // BACKUPCLIENTCONTEXT__H
@@ -14,6 +14,14 @@
 	#include <dirent.h>
 #endif
 
+#ifdef HAVE_FCNTL_H
+	#include <fcntl.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+	#include <unistd.h>
+#endif
+
 #include <errno.h>
 #include <string.h>
 
@@ -151,6 +159,9 @@ void BackupClientDirectoryRecord::SyncDirectory(
 {
 	BackupClientContext& rContext(rParams.mrContext);
 	ProgressNotifier& rNotifier(rContext.GetProgressNotifier());
+	BackupSyncReport& rReport(rContext.GetSyncReport());
+	BackupSyncReport::Timer directoryTimer(rReport,
+		BackupSyncReport::Phase_SyncDirectory);
 
 	// Signal received by daemon?
 	if(rParams.mrRunStatusProvider.StopRun())
@@ -228,8 +239,12 @@ void BackupClientDirectoryRecord::SyncDirectory(
 #endif
 
 		StreamableMemBlock xattr;
-		BackupClientFileAttributes::FillExtendedAttr(xattr,
-			rLocalPath.c_str());
+		{
+			BackupSyncReport::Timer attributesTimer(rReport,
+				BackupSyncReport::Phase_Attributes);
+			BackupClientFileAttributes::FillExtendedAttr(xattr,
+				rLocalPath.c_str());
+		}
 		currentStateChecksum.Add(xattr.GetBuffer(), xattr.GetSize());
 	}
 	
@@ -241,6 +256,9 @@ void BackupClientDirectoryRecord::SyncDirectory(
 
 	// BLOCK
 	{
+		BackupSyncReport::Timer scanTimer(rReport,
+			BackupSyncReport::Phase_Scan);
+
 		// read the contents...
 		DIR *dirHandle = 0;
 		try
@@ -270,6 +288,14 @@ void BackupClientDirectoryRecord::SyncDirectory(
 
 			struct dirent *en = 0;
 			int num_entries_found = 0;
+			int dir_fd = -1;
+
+#ifdef HAVE_FSTATAT
+			// Stat entries relative to the open directory, so that
+			// the kernel doesn't have to walk the whole path again
+			// for every entry.
+			dir_fd = dirfd(dirHandle);
+#endif
 
 			while((en = ::readdir(dirHandle)) != 0)
 			{
@@ -284,7 +310,7 @@ void BackupClientDirectoryRecord::SyncDirectory(
 
 				if (!SyncDirectoryEntry(rParams, rNotifier,
 					rBackupLocation, rLocalPath,
-					currentStateChecksum, en, dest_st, dirs,
+					currentStateChecksum, en, dir_fd, dest_st, dirs,
 					files, downloadDirectoryRecordBecauseOfFutureFiles))
 				{
 					// This entry is not to be backed up.
@@ -423,17 +449,22 @@ void BackupClientDirectoryRecord::SyncDirectory(
 	// Flag things as having happened.
 	mInitialSyncDone = true;
 	mSyncDone = true;
+
+	rReport.AddDirectory(local_path_non_vss, directoryTimer.Stop());
 }
 
 // --------------------------------------------------------------------------
 //
 // Function
-//		Name:    BackupClientDirectoryRecord::SyncDirectorEntry(
+//		Name:    BackupClientDirectoryRecord::SyncDirectoryEntry(
 //			 BackupClientDirectoryRecord::SyncParams &,
-//			 int64_t, const std::string &,
-//			 const std::string &, bool)
-//		Purpose: Recursively synchronise a local directory
-//			 with the server.
+//			 ProgressNotifier &, const Location &,
+//			 const std::string &, MD5Digest &,
+//			 struct dirent *, int, EMU_STRUCT_STAT, ...)
+//		Purpose: Examine a single entry found while scanning a
+//			 local directory. If DirFd is not -1, the entry is
+//			 stat()ed relative to that open directory instead
+//			 of by its full path.
 //		Created: 2003/10/08
 //
 // --------------------------------------------------------------------------
@@ -444,6 +475,7 @@ bool BackupClientDirectoryRecord::SyncDirectoryEntry(
 	const std::string &rDirLocalPath,
 	MD5Digest& currentStateChecksum,
 	struct dirent *en,
+	int DirFd,
 	EMU_STRUCT_STAT dir_st,
 	std::vector<std::string>& rDirs,
 	std::vector<std::string>& rFiles,
@@ -480,7 +512,31 @@ bool BackupClientDirectoryRecord::SyncDirectoryEntry(
 		type = S_IFREG;
 	}
 #else // !WIN32
-	if(EMU_LSTAT(filename.c_str(), &file_st) != 0)
+#ifdef HAVE_VALID_DIRENT_D_TYPE
+	// Sockets and FIFOs are silently skipped below anyway, so don't
+	// bother to stat them if readdir() has already told us the type.
+	// Some filesystems return DT_UNKNOWN for everything, and those
+	// entries fall through to the lstat() below.
+	if(en->d_type == DT_SOCK || en->d_type == DT_FIFO)
+	{
+		return false;
+	}
+#endif
+
+	int stat_result;
+#ifdef HAVE_FSTATAT
+	if(DirFd != -1)
+	{
+		stat_result = ::fstatat(DirFd, en->d_name, &file_st,
+			AT_SYMLINK_NOFOLLOW);
+	}
+	else
+#endif
+	{
+		stat_result = EMU_LSTAT(filename.c_str(), &file_st);
+	}
+
+	if(stat_result != 0)
 	{
 		// We don't know whether it's a file or a directory, so check
 		// both. This only affects whether a warning message is
@@ -707,8 +763,13 @@ void BackupClientDirectoryRecord::UpdateAttributes(
 	// Get attributes for the directory
 	BackupClientFileAttributes attr;
 	box_time_t attrModTime = 0;
-	attr.ReadAttributes(rLocalPath.c_str(), true /* directories have zero mod times */,
-		0 /* no modification time */, &attrModTime);
+	{
+		BackupSyncReport::Timer attributesTimer(
+			rParams.mrContext.GetSyncReport(),
+			BackupSyncReport::Phase_Attributes);
+		attr.ReadAttributes(rLocalPath.c_str(), true /* directories have zero mod times */,
+			0 /* no modification time */, &attrModTime);
+	}
 
 	// Assume attributes need updating, unless proved otherwise
 	bool updateAttr = true;
@@ -742,6 +803,73 @@ void BackupClientDirectoryRecord::UpdateAttributes(
 	}
 }
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupClientDirectoryRecord::GetAttributesHash(
+//			 EMU_STRUCT_STAT &, const std::string &,
+//			 const std::string &, FileAttributeStateMap_t &,
+//			 BackupSyncReport &)
+//		Purpose: Returns the attributes hash of a file, reusing the
+//			 one that we calculated last time if the file's inode
+//			 number, size, modification and attribute
+//			 modification times are all unchanged. Records the
+//			 file's state in rNewStates. Only the time spent
+//			 reading attributes to calculate a new hash is
+//			 added to the sync report.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+uint64_t BackupClientDirectoryRecord::GetAttributesHash(EMU_STRUCT_STAT &st,
+	const std::string &rFilename, const std::string &rLeafname,
+	FileAttributeStateMap_t &rNewStates, BackupSyncReport &rReport)
+{
+	FileAttributeState state;
+	state.mInodeNumber = st.st_ino;
+	state.mModificationTime = FileModificationTime(st);
+	state.mAttributeModificationTime = FileAttrModificationTime(st);
+	state.mSize = st.st_size;
+
+#ifndef WIN32
+	// On Windows, the attribute modification time is really the file
+	// creation time, so it doesn't change when the attributes do, and
+	// we can't use it to avoid hashing them.
+	FileAttributeStateMap_t::const_iterator i =
+		mFileAttributeStates.find(rLeafname);
+	if(i != mFileAttributeStates.end() &&
+		i->second.mInodeNumber == state.mInodeNumber &&
+		i->second.mModificationTime == state.mModificationTime &&
+		i->second.mAttributeModificationTime ==
+			state.mAttributeModificationTime &&
+		i->second.mSize == state.mSize)
+	{
+		state.mAttributesHash = i->second.mAttributesHash;
+		rNewStates[rLeafname] = state;
+		return state.mAttributesHash;
+	}
+#endif
+
+	box_time_t now = GetCurrentBoxTime();
+	{
+		BackupSyncReport::Timer attributesTimer(rReport,
+			BackupSyncReport::Phase_Attributes);
+		state.mAttributesHash =
+			BackupClientFileAttributes::GenerateAttributeHash(
+				st, rFilename, rLeafname);
+	}
+
+	// If the attributes were changed very recently, they could change
+	// again without the attribute modification time changing (depending
+	// on the timestamp granularity of the filesystem), so don't remember
+	// the hash: calculate it again next time.
+	if(state.mAttributeModificationTime < now - SecondsToBoxTime(2))
+	{
+		rNewStates[rLeafname] = state;
+	}
+
+	return state.mAttributesHash;
+}
+
 std::string BackupClientDirectoryRecord::DecryptFilename(
 	BackupStoreDirectory::Entry *en,
 	const std::string& rRemoteDirectoryPath)
@@ -791,6 +919,8 @@ bool BackupClientDirectoryRecord::UpdateItems(
 {
 	BackupClientContext& rContext(rParams.mrContext);
 	ProgressNotifier& rNotifier(rContext.GetProgressNotifier());
+	BackupSyncReport::Timer updateTimer(rContext.GetSyncReport(),
+		BackupSyncReport::Phase_UpdateItems);
 
 	bool allUpdatedSuccessfully = true;
 
@@ -824,6 +954,10 @@ bool BackupClientDirectoryRecord::UpdateItems(
 		}
 	}
 
+	// Attribute states of the files that we find this time. Files which
+	// no longer exist will be dropped when this replaces the old map.
+	FileAttributeStateMap_t newAttributeStates;
+
 	// Do files
 	for(std::vector<std::string>::const_iterator f = rFiles.begin();
 		f != rFiles.end(); ++f)
@@ -862,7 +996,8 @@ bool BackupClientDirectoryRecord::UpdateItems(
 			modTime = FileModificationTime(st);
 			fileSize = st.st_size;
 			inodeNum = st.st_ino;
-			attributesHash = BackupClientFileAttributes::GenerateAttributeHash(st, filename, *f);
+			attributesHash = GetAttributesHash(st, filename, *f,
+				newAttributeStates, rContext.GetSyncReport());
 		}
 
 		// See if it's in the listing (if we have one)
@@ -1069,25 +1204,43 @@ bool BackupClientDirectoryRecord::UpdateItems(
 				bool uploadSuccess = false;
 				try
 				{
-					latestObjectID = UploadFile(rParams,
+					if(StartStagedUpload(rParams,
 						filename,
 						nonVssFilePath,
 						rRemotePath + "/" + *f,
-						storeFilename,
+						*f, storeFilename,
 						fileSize, modTime,
-						attributesHash,
-						noPreviousVersionOnServer);
-
-					if(latestObjectID == 0)
+						attributesHash, inodeNum,
+						pendingFirstSeenTime != 0,
+						noPreviousVersionOnServer))
 					{
-						// storage limit exceeded
-						rParams.mrContext.SetStorageLimitExceeded();
-						uploadSuccess = false;
-						allUpdatedSuccessfully = false;
+						// Uploading on an extra connection,
+						// AddStagedUploads() will finish it
+						// off once all the subdirectories
+						// have been done.
 					}
 					else
 					{
-						uploadSuccess = true;
+						latestObjectID = UploadFile(rParams,
+							filename,
+							nonVssFilePath,
+							rRemotePath + "/" + *f,
+							storeFilename,
+							fileSize, modTime,
+							attributesHash,
+							noPreviousVersionOnServer);
+
+						if(latestObjectID == 0)
+						{
+							// storage limit exceeded
+							rParams.mrContext.SetStorageLimitExceeded();
+							uploadSuccess = false;
+							allUpdatedSuccessfully = false;
+						}
+						else
+						{
+							uploadSuccess = true;
+						}
 					}
 				}
 				catch(ConnectionException &e)
@@ -1160,8 +1313,13 @@ bool BackupClientDirectoryRecord::UpdateItems(
 					
 					// Update store
 					BackupClientFileAttributes attr;
-					attr.ReadAttributes(filename,
-						false /* put mod times in the attributes, please */);
+					{
+						BackupSyncReport::Timer attributesTimer(
+							rContext.GetSyncReport(),
+							BackupSyncReport::Phase_Attributes);
+						attr.ReadAttributes(filename,
+							false /* put mod times in the attributes, please */);
+					}
 					std::auto_ptr<IOStream> attrStream(
 						new MemBlockStream(attr));
 					connection.QuerySetReplacementFileAttributes(mObjectID, attributesHash, storeFilename, attrStream);
@@ -1265,6 +1423,7 @@ bool BackupClientDirectoryRecord::UpdateItems(
 
 	// Erase contents of files to save space when recursing
 	rFiles.clear();
+	mFileAttributeStates.swap(newAttributeStates);
 
 	// Delete the pending entries, if the map is empty
 	if(mpPendingEntries != 0 && mpPendingEntries->size() == 0)
@@ -1487,6 +1646,13 @@ bool BackupClientDirectoryRecord::UpdateItems(
 		}
 	}
 
+	// Add files uploaded on extra connections to the store, now that
+	// the main connection has finished everything else in here.
+	if(!AddStagedUploads(rParams))
+	{
+		allUpdatedSuccessfully = false;
+	}
+
 	// Return success flag (will be false if some files failed)
 	return allUpdatedSuccessfully;
 }
@@ -1788,9 +1954,13 @@ void BackupClientDirectoryRecord::RemoveDirectoryInPlaceOfFile(
 //			 BackupClientDirectoryRecord::SyncParams &,
 //			 const std::string &,
 //			 const BackupStoreFilename &,
-//			 int64_t, box_time_t, box_time_t, bool)
+//			 int64_t, box_time_t, box_time_t, bool,
+//			 BackupProtocolCallable *, int64_t *, int64_t *)
 //		Purpose: Private. Upload a file to the server. May send
-//			 a patch instead of the whole thing
+//			 a patch instead of the whole thing. If
+//			 pStagingConnection is given, the file is only
+//			 staged on that connection, and the staging ID is
+//			 returned instead of the object ID.
 //		Created: 20/1/04
 //
 // --------------------------------------------------------------------------
@@ -1803,17 +1973,29 @@ int64_t BackupClientDirectoryRecord::UploadFile(
 	int64_t FileSize,
 	box_time_t ModificationTime,
 	box_time_t AttributesHash,
-	bool NoPreviousVersionOnServer)
+	bool NoPreviousVersionOnServer,
+	BackupProtocolCallable *pStagingConnection,
+	int64_t *pDiffFromIDOut,
+	int64_t *pUploadedSizeOut)
 {
 	BackupClientContext& rContext(rParams.mrContext);
 	ProgressNotifier& rNotifier(rContext.GetProgressNotifier());
+	BackupSyncReport& rReport(rContext.GetSyncReport());
+	BackupSyncReport::Timer uploadTimer(rReport,
+		BackupSyncReport::Phase_UploadFile);
+	box_time_t encodingTimeAtStart = BackupStoreFile::msStats.mEncodingTime;
 
 	// Get the connection
-	BackupProtocolCallable &connection(rContext.GetConnection());
+	BackupProtocolCallable &connection(pStagingConnection ?
+		*pStagingConnection : rContext.GetConnection());
 
 	// Info
 	int64_t objID = 0;
 	int64_t uploadedSize = -1;
+	bool resumable = false;
+	int64_t stagingID = 0;
+	int64_t resumeOffset = 0;
+	std::string leafname(rStoreFilename.GetClearFilename());
 	
 	// Use a try block to catch store full errors
 	try
@@ -1845,6 +2027,8 @@ int64_t BackupClientDirectoryRecord::UploadFile(
 				rContext.ManageDiffProcess();
 
 				bool isCompletelyDifferent = false;
+				BackupSyncReport::Timer diffTimer(rReport,
+					BackupSyncReport::Phase_Diff);
 
 				apStreamToUpload = BackupStoreFile::EncodeFileDiff(
 					rLocalPath,
@@ -1856,6 +2040,7 @@ int64_t BackupClientDirectoryRecord::UploadFile(
 					&isCompletelyDifferent,
 					rParams.mpBackgroundTask);
 
+				diffTimer.Stop();
 				if(isCompletelyDifferent)
 				{
 					diffFromID = 0;
@@ -1883,6 +2068,19 @@ int64_t BackupClientDirectoryRecord::UploadFile(
 				rParams.mpBackgroundTask);
 		}
 
+		// Big whole files are sent in a way that can be resumed from
+		// where it got to if the connection is lost.
+		resumable = (diffFromID == 0 &&
+			rParams.mResumableUploadSizeThreshold > 0 &&
+			FileSize >= rParams.mResumableUploadSizeThreshold);
+		if(resumable)
+		{
+			stagingID = StartResumableUpload(rParams, connection,
+				*apStreamToUpload, rNonVssFilePath, leafname,
+				FileSize, ModificationTime, AttributesHash,
+				resumeOffset);
+		}
+
 		rContext.SetNiceMode(true);
 		std::auto_ptr<IOStream> apWrappedStream;
 
@@ -1902,16 +2100,40 @@ int64_t BackupClientDirectoryRecord::UploadFile(
 		}
 
 		// Send to store
-		std::auto_ptr<BackupProtocolSuccess> stored(
-			connection.QueryStoreFile(mObjectID, ModificationTime,
-				AttributesHash, diffFromID, rStoreFilename,
-				apWrappedStream));
+		std::auto_ptr<BackupProtocolSuccess> stored;
+		if(resumable)
+		{
+			stored = connection.QueryResumeStagedFile(stagingID,
+				resumeOffset, apWrappedStream);
+			if(!pStagingConnection)
+			{
+				stored = connection.QueryStoreStagedFile(
+					mObjectID, ModificationTime,
+					AttributesHash, 0, stagingID,
+					rStoreFilename);
+			}
+		}
+		else if(pStagingConnection)
+		{
+			stored = connection.QueryStageFile(apWrappedStream);
+		}
+		else
+		{
+			stored = connection.QueryStoreFile(mObjectID,
+				ModificationTime, AttributesHash, diffFromID,
+				rStoreFilename, apWrappedStream);
+		}
 
 		rContext.SetNiceMode(false);
 
 		// Get object ID from the result
 		objID = stored->GetObjectID();
 		uploadedSize = apStreamToUpload->GetTotalBytesSent();
+
+		if(pDiffFromIDOut)
+		{
+			*pDiffFromIDOut = diffFromID;
+		}
 	}
 	catch(BoxException &e)
 	{
@@ -1929,8 +2151,12 @@ int64_t BackupClientDirectoryRecord::UploadFile(
 				&& subtype == BackupProtocolError::Err_StorageLimitExceeded)
 				{
 					// The hard limit was exceeded on the server, notify!
-					rParams.mrSysadminNotifier.NotifySysadmin(
-						SysadminNotifier::StoreFull);
+					// (Staged uploads leave that to the main process.)
+					if(!pStagingConnection)
+					{
+						rParams.mrSysadminNotifier.NotifySysadmin(
+							SysadminNotifier::StoreFull);
+					}
 					// return an error code instead of
 					// throwing an exception that we
 					// can't debug.
@@ -1945,14 +2171,348 @@ int64_t BackupClientDirectoryRecord::UploadFile(
 		throw;
 	}
 
+	if(pUploadedSizeOut)
+	{
+		*pUploadedSizeOut = uploadedSize;
+	}
+
+	box_time_t uploadTime = uploadTimer.Stop();
+	rReport.AddTime(BackupSyncReport::Phase_Encode,
+		BackupStoreFile::msStats.mEncodingTime - encodingTimeAtStart);
+
+	if(pStagingConnection)
+	{
+		// Not uploaded until AddStagedUploads() says so
+		return objID;
+	}
+
 	rNotifier.NotifyFileUploaded(this, rNonVssFilePath, FileSize,
 		uploadedSize, objID);
+	rReport.AddFile(rNonVssFilePath, uploadTime, uploadedSize);
 
 	// Return the new object ID of this file
 	return objID;
 }
 
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupClientDirectoryRecord::StartResumableUpload(
+//			 SyncParams &, BackupProtocolCallable &,
+//			 BackupStoreFileEncodeStream &,
+//			 const std::string &, const std::string &,
+//			 int64_t, box_time_t, box_time_t, int64_t &)
+//		Purpose: Private. Ask the server for the staged file which
+//			 belongs to this file, keyed by its directory and
+//			 name, so that it's found again even by a different
+//			 process after a restart. If the server already has
+//			 some of it, and the file hasn't changed since, skip
+//			 that much of the encoded stream. Returns the
+//			 staging ID.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int64_t BackupClientDirectoryRecord::StartResumableUpload(
+	BackupClientDirectoryRecord::SyncParams &rParams,
+	BackupProtocolCallable &rConnection,
+	BackupStoreFileEncodeStream &rStream,
+	const std::string &rNonVssFilePath,
+	const std::string &rLeafname,
+	int64_t FileSize,
+	box_time_t ModificationTime,
+	box_time_t AttributesHash,
+	int64_t &rOffsetOut)
+{
+	int64_t resumeKey = BackupClientFileAttributes::GenerateResumeKey(
+		mObjectID, rLeafname);
+
+	// The encoded file is only the same as before if the file and its
+	// attributes are unchanged. If not, the server empties the staged
+	// file, so that the old data doesn't linger.
+	int64_t checkData[3] = {box_hton64(FileSize),
+		box_hton64(ModificationTime), box_hton64(AttributesHash)};
+	MD5Digest digest;
+	digest.Add(checkData, sizeof(checkData));
+	digest.Finish();
+	int64_t resumeCheck;
+	memcpy(&resumeCheck, digest.DigestAsData(), sizeof(resumeCheck));
+
+	int64_t stagingID = rConnection.QueryCreateStagedFile(resumeKey,
+		resumeCheck)->GetObjectID();
+	int64_t received = rConnection.QueryGetStagedFileSize(
+		stagingID)->GetSize();
+
+	rOffsetOut = 0;
+	if(received > 0)
+	{
+		rOffsetOut = rStream.SkipToBlockBoundary(received);
+	}
+
+	if(rOffsetOut > 0)
+	{
+		BOX_NOTICE("Resuming upload of " << rNonVssFilePath <<
+			" after " << rOffsetOut << " bytes already sent");
+	}
+
+	return stagingID;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupClientDirectoryRecord::StartStagedUpload(
+//			 SyncParams &, const std::string &,
+//			 const std::string &, const std::string &,
+//			 const std::string &,
+//			 const BackupStoreFilenameClear &, int64_t,
+//			 box_time_t, box_time_t, InodeRefType, bool, bool)
+//		Purpose: Private. If extra store connections are enabled
+//			 and the file is big enough, fork a child process
+//			 to stage it on the server over a connection of its
+//			 own, and return true. Otherwise return false, and
+//			 the caller should upload it on the main connection.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool BackupClientDirectoryRecord::StartStagedUpload(
+	BackupClientDirectoryRecord::SyncParams &rParams,
+	const std::string &rFilename,
+	const std::string &rNonVssFilePath,
+	const std::string &rRemotePath,
+	const std::string &rLeafname,
+	const BackupStoreFilenameClear &rStoreFilename,
+	int64_t FileSize,
+	box_time_t ModificationTime,
+	box_time_t AttributesHash,
+	InodeRefType InodeNumber,
+	bool WasPending,
+	bool NoPreviousVersionOnServer)
+{
+#ifdef WIN32
+	// No fork(), so everything goes on the main connection
+	return false;
+#else
+	if(rParams.mExtraStoreConnections <= 0 ||
+		FileSize < rParams.mExtraConnectionUploadSizeThreshold)
+	{
+		return false;
+	}
+
+	BackupClientContext& rContext(rParams.mrContext);
+
+	// Don't open more connections than we were told to
+	rContext.WaitForStagedUploads(rParams.mExtraStoreConnections);
+
+	int fds[2];
+	if(::pipe(fds) != 0)
+	{
+		BOX_LOG_SYS_ERROR("Failed to create pipe for upload process, "
+			"uploading " << rNonVssFilePath << " on main "
+			"connection instead");
+		return false;
+	}
+
+	pid_t pid = ::fork();
+	if(pid == -1)
+	{
+		BOX_LOG_SYS_ERROR("Failed to fork upload process, uploading " <<
+			rNonVssFilePath << " on main connection instead");
+		::close(fds[0]);
+		::close(fds[1]);
+		return false;
+	}
+
+	if(pid == 0)
+	{
+		// Child: upload on our own connection, report back and leave
+		// without running any destructors, which might touch the
+		// parent's connection or ID maps.
+		::close(fds[0]);
+
+		BackupClientContext::StagedUploadResult result =
+			{0, 0, 0, 0, 0, 0};
+		try
+		{
+			rContext.DetachConnectionAfterFork();
+			rContext.GetSyncReport().Start();
+			std::auto_ptr<BackupProtocolCallable> apConnection(
+				rContext.OpenExtraConnection());
+			result.mStagingID = UploadFile(rParams, rFilename,
+				rNonVssFilePath, rRemotePath, rStoreFilename,
+				FileSize, ModificationTime, AttributesHash,
+				NoPreviousVersionOnServer, apConnection.get(),
+				&result.mDiffFromID, &result.mUploadedSize);
+			result.mStorageLimitExceeded = (result.mStagingID == 0);
+
+			// Our copy of the report, which only counts this
+			// upload, will be thrown away, so tell the parent
+			// where the time went.
+			BackupSyncReport& rReport(rContext.GetSyncReport());
+			result.mUploadTime = rReport.GetPhaseTime(
+				BackupSyncReport::Phase_UploadFile);
+			result.mEncodingTime = rReport.GetPhaseTime(
+				BackupSyncReport::Phase_Encode);
+			apConnection->QueryFinished();
+		}
+		catch(BoxException &e)
+		{
+			BOX_ERROR("Failed to upload " << rNonVssFilePath <<
+				" on extra connection: " << e.what());
+		}
+		catch(std::exception &e)
+		{
+			BOX_ERROR("Failed to upload " << rNonVssFilePath <<
+				" on extra connection: " << e.what());
+		}
+		catch(...)
+		{
+			BOX_ERROR("Failed to upload " << rNonVssFilePath <<
+				" on extra connection: unknown error");
+		}
+
+		if(::write(fds[1], &result, sizeof(result)) != sizeof(result))
+		{
+			BOX_LOG_SYS_ERROR("Failed to report result of uploading " <<
+				rNonVssFilePath);
+		}
+		::_exit(0);
+	}
+
+	// Parent
+	::close(fds[1]);
+
+	BackupClientContext::StagedUpload upload;
+	upload.mDirectoryID = mObjectID;
+	upload.mLeafname = rLeafname;
+	upload.mNonVssFilePath = rNonVssFilePath;
+	upload.mStoreFilename = rStoreFilename;
+	upload.mModificationTime = ModificationTime;
+	upload.mAttributesHash = AttributesHash;
+	upload.mFileSize = FileSize;
+	upload.mInodeNumber = InodeNumber;
+	upload.mWasPending = WasPending;
+	rContext.AddStagedUpload(pid, fds[0], upload);
+
+	BOX_TRACE("Uploading " << rNonVssFilePath << " on extra connection "
+		"in process " << pid);
+	return true;
+#endif // WIN32
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupClientDirectoryRecord::AddStagedUploads(
+//			 SyncParams &)
+//		Purpose: Private. Wait for any files in this directory
+//			 being uploaded on extra connections, and add them
+//			 to the store on the main connection. Returns false
+//			 if any of them failed.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool BackupClientDirectoryRecord::AddStagedUploads(
+	BackupClientDirectoryRecord::SyncParams &rParams)
+{
+	BackupClientContext& rContext(rParams.mrContext);
+	std::vector<BackupClientContext::StagedUpload> uploads;
+	rContext.CollectStagedUploads(mObjectID, uploads);
+
+	ProgressNotifier& rNotifier(rContext.GetProgressNotifier());
+	bool allAdded = true;
+
+	for(std::vector<BackupClientContext::StagedUpload>::const_iterator
+		i = uploads.begin(); i != uploads.end(); i++)
+	{
+		int64_t objID = 0;
+
+		if(i->mStorageLimitExceeded)
+		{
+			rParams.mrSysadminNotifier.NotifySysadmin(
+				SysadminNotifier::StoreFull);
+			rContext.SetStorageLimitExceeded();
+			allAdded = false;
+			continue;
+		}
+		else if(i->mStagingID != 0)
+		{
+			BackupProtocolCallable &connection(rContext.GetConnection());
+			try
+			{
+				std::auto_ptr<BackupProtocolSuccess> stored(
+					connection.QueryStoreStagedFile(mObjectID,
+						i->mModificationTime,
+						i->mAttributesHash, i->mDiffFromID,
+						i->mStagingID, i->mStoreFilename));
+				objID = stored->GetObjectID();
+			}
+			catch(ConnectionException &e)
+			{
+				int type, subtype;
+				if(e.GetSubType() != ConnectionException::Protocol_UnexpectedReply ||
+					!connection.GetLastError(type, subtype))
+				{
+					// A real connection problem, let the
+					// main handler deal with it
+					throw;
+				}
+
+				if(type == BackupProtocolError::ErrorType &&
+					subtype == BackupProtocolError::Err_StorageLimitExceeded)
+				{
+					rParams.mrSysadminNotifier.NotifySysadmin(
+						SysadminNotifier::StoreFull);
+					rContext.SetStorageLimitExceeded();
+					allAdded = false;
+					continue;
+				}
+
+				rNotifier.NotifyFileUploadServerError(this,
+					i->mNonVssFilePath, type, subtype);
+			}
+		}
+
+		if(objID == 0)
+		{
+			allAdded = false;
+			SetErrorWhenReadingFilesystemObject(rParams,
+				i->mNonVssFilePath);
+			continue;
+		}
+
+		rNotifier.NotifyFileUploaded(this, i->mNonVssFilePath,
+			i->mFileSize, i->mUploadedSize, objID);
+		rContext.GetSyncReport().AddFile(i->mNonVssFilePath,
+			i->mUploadTime, i->mUploadedSize);
+
+		if(i->mWasPending && mpPendingEntries != 0)
+		{
+			mpPendingEntries->erase(i->mLeafname);
+			if(mpPendingEntries->size() == 0)
+			{
+				delete mpPendingEntries;
+				mpPendingEntries = 0;
+			}
+		}
+
+		if(i->mFileSize >= rParams.mFileTrackingSizeThreshold)
+		{
+			rContext.GetNewIDMap().AddToMap(i->mInodeNumber, objID,
+				mObjectID /* containing directory */,
+				i->mNonVssFilePath);
+		}
+
+		rNotifier.NotifyFileSynchronised(this, i->mNonVssFilePath,
+			i->mFileSize);
+	}
+
+	return allAdded;
+}
+
+
 // --------------------------------------------------------------------------
 //
 // Function
@@ -2010,6 +2570,9 @@ BackupClientDirectoryRecord::SyncParams::SyncParams(
   mrContext(rContext),
   mReadErrorsOnFilesystemObjects(false),
   mMaxUploadRate(0),
+  mExtraStoreConnections(0),
+  mExtraConnectionUploadSizeThreshold(0),
+  mResumableUploadSizeThreshold(0),
   mUploadAfterThisTimeInTheFuture(99999999999999999LL),
   mHaveLoggedWarningAboutFutureFileTimes(false)
 {
@@ -2101,6 +2664,29 @@ void BackupClientDirectoryRecord::Deserialize(Archive & rArchive)
 		}
 	}
 
+	//
+	//
+	//
+	mFileAttributeStates.clear();
+	iCount = 0;
+	rArchive.Read(iCount);
+
+	for (int v = 0; v < iCount; v++)
+	{
+		std::string strItem;
+		FileAttributeState state;
+		int64_t inodeNumber;
+
+		rArchive.Read(strItem);
+		rArchive.Read(inodeNumber);
+		rArchive.Read(state.mModificationTime);
+		rArchive.Read(state.mAttributeModificationTime);
+		rArchive.Read(state.mSize);
+		rArchive.Read(state.mAttributesHash);
+		state.mInodeNumber = inodeNumber;
+		mFileAttributeStates[strItem] = state;
+	}
+
 	//
 	//
 	//
@@ -2185,6 +2771,25 @@ void BackupClientDirectoryRecord::Serialize(Archive & rArchive) const
 			rArchive.Write(i->second);
 		}
 	}
+
+	//
+	//
+	//
+	iCount = mFileAttributeStates.size();
+	rArchive.Write(iCount);
+
+	for (FileAttributeStateMap_t::const_iterator
+		i =  mFileAttributeStates.begin();
+		i != mFileAttributeStates.end(); i++)
+	{
+		rArchive.Write(i->first);
+		rArchive.Write((int64_t)i->second.mInodeNumber);
+		rArchive.Write(i->second.mModificationTime);
+		rArchive.Write(i->second.mAttributeModificationTime);
+		rArchive.Write(i->second.mSize);
+		rArchive.Write(i->second.mAttributesHash);
+	}
+
 	//
 	//
 	//
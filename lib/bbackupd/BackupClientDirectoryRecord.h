@@ -33,6 +33,9 @@
 class Archive;
 class BackupClientContext;
 class BackupDaemon;
+class BackupProtocolCallable;
+class BackupStoreFileEncodeStream;
+class BackupSyncReport;
 class ExcludeList;
 class Location;
 
@@ -100,6 +103,9 @@ public:
 		BackupClientContext &mrContext;
 		bool mReadErrorsOnFilesystemObjects;
 		int64_t mMaxUploadRate;
+		int mExtraStoreConnections;
+		int64_t mExtraConnectionUploadSizeThreshold;
+		int64_t mResumableUploadSizeThreshold;
 		
 		// Member variables modified by syncing process
 		box_time_t mUploadAfterThisTimeInTheFuture;
@@ -147,6 +153,7 @@ public:
 		const std::string &rDirLocalPath,
 		MD5Digest& currentStateChecksum,
 		struct dirent *en,
+		int DirFd,
 		EMU_STRUCT_STAT dir_st,
 		std::vector<std::string>& rDirs,
 		std::vector<std::string>& rFiles,
@@ -190,7 +197,27 @@ private:
 		const std::string &rRemotePath,
 		const BackupStoreFilenameClear &rStoreFilename,
 		int64_t FileSize, box_time_t ModificationTime,
-		box_time_t AttributesHash, bool NoPreviousVersionOnServer);
+		box_time_t AttributesHash, bool NoPreviousVersionOnServer,
+		BackupProtocolCallable *pStagingConnection = NULL,
+		int64_t *pDiffFromIDOut = NULL,
+		int64_t *pUploadedSizeOut = NULL);
+	int64_t StartResumableUpload(SyncParams &rParams,
+		BackupProtocolCallable &rConnection,
+		BackupStoreFileEncodeStream &rStream,
+		const std::string &rNonVssFilePath,
+		const std::string &rLeafname,
+		int64_t FileSize, box_time_t ModificationTime,
+		box_time_t AttributesHash, int64_t &rOffsetOut);
+	bool StartStagedUpload(SyncParams &rParams,
+		const std::string &rFilename,
+		const std::string &rNonVssFilePath,
+		const std::string &rRemotePath,
+		const std::string &rLeafname,
+		const BackupStoreFilenameClear &rStoreFilename,
+		int64_t FileSize, box_time_t ModificationTime,
+		box_time_t AttributesHash, InodeRefType InodeNumber,
+		bool WasPending, bool NoPreviousVersionOnServer);
+	bool AddStagedUploads(SyncParams &rParams);
 	void SetErrorWhenReadingFilesystemObject(SyncParams &rParams,
 		const std::string& rFilename);
 	void RemoveDirectoryInPlaceOfFile(SyncParams &rParams,
@@ -203,6 +230,24 @@ private:
 		int64_t filenameObjectID,
 		const std::string& rRemoteDirectoryPath);
 
+	// The stat() details of a file, and the attributes hash that was
+	// generated from them. If none of these details have changed, then
+	// neither have the attributes, so we don't need to read them
+	// (including extended attributes) and hash them again.
+	typedef struct
+	{
+		InodeRefType mInodeNumber;
+		box_time_t mModificationTime;
+		box_time_t mAttributeModificationTime;
+		int64_t mSize;
+		uint64_t mAttributesHash;
+	} FileAttributeState;
+	typedef std::map<std::string, FileAttributeState> FileAttributeStateMap_t;
+
+	uint64_t GetAttributesHash(EMU_STRUCT_STAT &st,
+		const std::string &rFilename, const std::string &rLeafname,
+		FileAttributeStateMap_t &rNewStates, BackupSyncReport &rReport);
+
 	int64_t 	mObjectID;
 	std::string 	mSubDirName;
 	bool 		mInitialSyncDone;
@@ -213,6 +258,7 @@ private:
 
 	std::map<std::string, box_time_t> *mpPendingEntries;
 	std::map<std::string, BackupClientDirectoryRecord *> mSubDirectories;
+	FileAttributeStateMap_t mFileAttributeStates;
 	// mpPendingEntries is a pointer rather than simple a member
 	// variable, because most of the time it'll be empty. This would
 	// waste a lot of memory because of STL allocation policies.
@@ -534,6 +534,13 @@ void BackupDaemon::Run()
 			EMU_UNLINK(socketName);
 			mapCommandSocketInfo->mListeningSocket.Listen(
 				Socket::TypeUNIX, socketName);
+
+			// Registered once, and waited on until they're
+			// destroyed, along with any connection
+			mapCommandSocketInfo->mWait.Add(
+				&mapCommandSocketInfo->mListeningSocket);
+			mapCommandSocketInfo->mWait.Add(&GetStopRunEvent(), 0,
+				WaitForEvent::EdgeTriggered);
 		#endif
 	}
 
@@ -582,6 +589,11 @@ void BackupDaemon::InitCrypto()
 	int ssl_security_level(conf.GetKeyValueInt("SSLSecurityLevel"));
 	mTlsContext.Initialise(false /* as client */, certFile.c_str(),
 		keyFile.c_str(), caFile.c_str(), ssl_security_level);
+
+	// Keep the session in the data directory, so that bbackupquery
+	// and the next run of bbackupd can resume it
+	mTlsContext.SetSessionFile(conf.GetKeyValue("DataDirectory") +
+		DIRECTORY_SEPARATOR + "tls_session");
 	
 	// Set up the keys for various things
 	BackupClientCryptoKeys_Setup(conf.GetKeyValue("KeysFile"));
@@ -781,7 +793,11 @@ std::auto_ptr<BackupClientContext> BackupDaemon::RunSyncNowWithExceptionHandling
 	{
 		OnBackupStart();
 		// Do sync
-		RunSyncNow();
+		std::auto_ptr<BackupClientContext> apContext(RunSyncNow());
+		if(apContext.get())
+		{
+			SaveSyncReport(*apContext, true);
+		}
 	}
 	catch(BoxException &e)
 	{
@@ -803,6 +819,11 @@ std::auto_ptr<BackupClientContext> BackupDaemon::RunSyncNowWithExceptionHandling
 		errorOccurred = true;
 	}
 
+	if(errorOccurred && mapClientContext.get())
+	{
+		SaveSyncReport(*mapClientContext, false);
+	}
+
 	// do not retry immediately without a good reason
 	mDoSyncForcedByPreviousSyncError = false;
 
@@ -959,7 +980,9 @@ std::auto_ptr<BackupClientContext> BackupDaemon::RunSyncNow()
 		}
 
 		fileLogger.reset(new FileLogger(conf.GetKeyValue("LogFile"),
-			level, !overwrite));
+			level, !overwrite,
+			conf.GetKeyValueInt("LogFileBufferSize"),
+			conf.GetKeyValueBool("LogFileDropWhenFull")));
 	}
 
 	std::string extendedLogFile;
@@ -1081,6 +1104,13 @@ std::auto_ptr<BackupClientContext> BackupDaemon::RunSyncNow()
 		params.mMaxUploadRate = mMaxBandwidthFromSyncAllowScript;
 	}
 
+	params.mExtraStoreConnections =
+		conf.GetKeyValueInt("ExtraStoreConnections");
+	params.mExtraConnectionUploadSizeThreshold =
+		conf.GetKeyValueInt("ExtraConnectionUploadSizeThreshold");
+	params.mResumableUploadSizeThreshold =
+		conf.GetKeyValueInt("ResumableUploadSizeThreshold");
+
 	mDeleteRedundantLocationsAfter =
 		conf.GetKeyValueInt("DeleteRedundantLocationsAfter");
 	mStorageLimitExceeded = false;
@@ -1756,6 +1786,25 @@ void BackupDaemon::CleanupVssBackupComponents()
 }
 #endif
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupDaemon::SaveSyncReport(BackupClientContext &,
+//			 bool)
+//		Purpose: Finish the report of where the time went
+//			 in the sync run which just finished, and keep it
+//			 for the "report" command.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupDaemon::SaveSyncReport(BackupClientContext &rContext, bool Success)
+{
+	rContext.RecordQueryStats();
+	BackupSyncReport &rReport(rContext.GetSyncReport());
+	rReport.Finish(Success);
+	mLastSyncReport = rReport.GetJson();
+}
+
 void BackupDaemon::OnBackupStart()
 {
 	ResetLogFile();
@@ -2061,9 +2110,31 @@ void BackupDaemon::WaitOnCommandSocket(box_time_t RequiredDelay, bool &DoSyncFla
 			// pointer to a dead mpConnectedSocket.
 			ASSERT(!mapCommandSocketInfo->mapGetLine.get());
 
+#ifdef WIN32
 			// No connection, listen for a new one
 			mapCommandSocketInfo->mpConnectedSocket.reset(
 				mapCommandSocketInfo->mListeningSocket.Accept(timeout).release());
+#else
+			// No connection, wait for a new one, unless we're
+			// asked to stop or a timer expires first
+			if(WaitForCommandSocketEvent(timeout) ==
+				&mapCommandSocketInfo->mListeningSocket)
+			{
+				mapCommandSocketInfo->mpConnectedSocket.reset(
+					mapCommandSocketInfo->mListeningSocket.Accept(0).release());
+			}
+
+			if(mapCommandSocketInfo->mpConnectedSocket.get() != 0)
+			{
+				// Wait on the connection instead until it's
+				// closed, by CloseCommandConnection(), as
+				// only one is handled at a time.
+				mapCommandSocketInfo->mWait.Remove(
+					&mapCommandSocketInfo->mListeningSocket);
+				mapCommandSocketInfo->mWait.Add(
+					mapCommandSocketInfo->mpConnectedSocket.get());
+			}
+#endif
 			
 			if(mapCommandSocketInfo->mpConnectedSocket.get() == 0)
 			{
@@ -2101,7 +2172,7 @@ void BackupDaemon::WaitOnCommandSocket(box_time_t RequiredDelay, bool &DoSyncFla
 				{
 					// Dump the connection
 					BOX_ERROR("Incoming command connection from peer had different user ID than this process, or security check could not be completed.");
-					mapCommandSocketInfo->mpConnectedSocket.reset();
+					CloseCommandConnection();
 					return;
 				}
 				else
@@ -2142,6 +2213,16 @@ void BackupDaemon::WaitOnCommandSocket(box_time_t RequiredDelay, bool &DoSyncFla
 		// Ping the remote side, to provide errors which will mean the socket gets closed
 		mapCommandSocketInfo->mpConnectedSocket->Write("ping\n", 5,
 			timeout);
+
+#ifndef WIN32
+		// Wait for a command, unless one has arrived already
+		if(mapCommandSocketInfo->mapGetLine->GetSizeOfBufferedData() == 0 &&
+			WaitForCommandSocketEvent(timeout) !=
+			mapCommandSocketInfo->mpConnectedSocket.get())
+		{
+			return;
+		}
+#endif
 		
 		// Wait for a command or something on the socket
 		std::string command;
@@ -2188,6 +2269,16 @@ void BackupDaemon::WaitOnCommandSocket(box_time_t RequiredDelay, bool &DoSyncFla
 				SetTerminateWanted();
 				sendOK = true;
 			}
+			else if(command == "report")
+			{
+				// Where the time went in the last sync,
+				// as one line of JSON
+				std::string report = (mLastSyncReport.empty() ?
+					std::string("{}") : mLastSyncReport) + "\n";
+				mapCommandSocketInfo->mpConnectedSocket->Write(
+					report, timeout);
+				sendOK = true;
+			}
 			
 			// Send a response back?
 			if(sendResponse)
@@ -2280,6 +2371,16 @@ void BackupDaemon::CloseCommandConnection()
 	{
 		BOX_TRACE("Closing command connection");
 		mapCommandSocketInfo->mapGetLine.reset();
+#ifndef WIN32
+		if(mapCommandSocketInfo->mpConnectedSocket.get() != 0)
+		{
+			// Wait for the next connection instead
+			mapCommandSocketInfo->mWait.Remove(
+				mapCommandSocketInfo->mpConnectedSocket.get());
+			mapCommandSocketInfo->mWait.Add(
+				&mapCommandSocketInfo->mListeningSocket);
+		}
+#endif
 		mapCommandSocketInfo->mpConnectedSocket.reset();
 	}
 	catch(std::exception &e)
@@ -2294,6 +2395,38 @@ void BackupDaemon::CloseCommandConnection()
 }
 
 
+#ifndef WIN32
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupDaemon::WaitForCommandSocketEvent(int)
+//		Purpose: Waits up to the timeout, in milliseconds, for the
+//			 listening or connected command socket to become
+//			 readable, and returns it, or returns NULL on timeout,
+//			 if a timer expired, or if the daemon was asked to
+//			 stop.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void *BackupDaemon::WaitForCommandSocketEvent(int Timeout)
+{
+	WaitForEvent &rWait(mapCommandSocketInfo->mWait);
+	rWait.SetTimeout(Timeout);
+	void *pReady = rWait.Wait();
+
+	if(pReady == &GetStopRunEvent())
+	{
+		// StopRun() is true now, or else a child process was
+		// signalled, which shares the event
+		GetStopRunEvent().Clear();
+		return NULL;
+	}
+
+	return pReady;
+}
+#endif // !WIN32
+
+
 // --------------------------------------------------------------------------
 //
 // File
@@ -3281,7 +3414,7 @@ BackupDaemon::CommandSocketInfo::~CommandSocketInfo()
 
 static const int STOREOBJECTINFO_MAGIC_ID_VALUE = 0x7777525F;
 static const std::string STOREOBJECTINFO_MAGIC_ID_STRING = "BBACKUPD-STATE";
-static const int STOREOBJECTINFO_VERSION = 2;
+static const int STOREOBJECTINFO_VERSION = 3;
 
 bool BackupDaemon::SerializeStoreObjectInfo(box_time_t theLastSyncTime,
 	box_time_t theNextSyncTime) const
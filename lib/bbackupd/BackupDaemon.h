@@ -23,6 +23,7 @@
 #include "SocketListen.h"
 #include "SocketStream.h"
 #include "TLSContext.h"
+#include "WaitForEvent.h"
 
 #include "autogen_BackupProtocol.h"
 #include "autogen_BackupStoreException.h"
@@ -142,6 +143,8 @@ public:
 	void ResetCachedState();
 	void OnBackupStart();
 	void OnBackupFinish();
+	void SaveSyncReport(BackupClientContext &rContext, bool Success);
+	const std::string& GetLastSyncReport() const { return mLastSyncReport; }
 	// TouchFileInWorkingDir is only here for use by Boxi.
 	// This does NOT constitute an API!
 	void TouchFileInWorkingDir(const char *Filename);
@@ -183,6 +186,9 @@ private:
 	
 	void WaitOnCommandSocket(box_time_t RequiredDelay, bool &DoSyncFlagOut, bool &SyncIsForcedOut);
 	void CloseCommandConnection();
+#ifndef WIN32
+	void *WaitForCommandSocketEvent(int Timeout);
+#endif
 	void SendSyncStartOrFinish(bool SendStart);
 	
 	void DeleteUnusedRootDirEntries(BackupClientContext &rContext);
@@ -225,6 +231,9 @@ private:
 #else
 		SocketListen<SocketStream, 1 /* listen backlog */> mListeningSocket;
 		std::auto_ptr<SocketStream> mpConnectedSocket;
+		// Waits on the listening socket, or the connected one if
+		// there is one, the daemon's stop event, and the timers
+		WaitForEvent mWait;
 #endif
 		std::auto_ptr<IOStreamGetLine> mapGetLine;
 	};
@@ -278,6 +287,7 @@ private:
 	SysadminNotifier* mpSysadminNotifier;
 	std::auto_ptr<Timer> mapCommandSocketPollTimer;
 	std::auto_ptr<BackupClientContext> mapClientContext;
+	std::string mLastSyncReport;
 
 	/* ProgressNotifier implementation */
 public:
@@ -0,0 +1,398 @@
+// --------------------------------------------------------------------------
+//
+// File
+//		Name:    BackupSyncReport.cpp
+//		Purpose: Where the time goes during a backup run
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+#include "Box.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <sstream>
+
+#include "BackupSyncReport.h"
+
+#include "MemLeakFindOn.h"
+
+// Orders the heaps of slow items with the quickest on top
+static bool IsSlower(const BackupSyncReport::SlowItem &rA,
+	const BackupSyncReport::SlowItem &rB)
+{
+	return rA.mDuration > rB.mDuration;
+}
+
+// Writes a duration in seconds, to the microsecond
+static void WriteSeconds(std::ostream &rOut, box_time_t Duration)
+{
+	char buffer[32];
+	::snprintf(buffer, sizeof(buffer), "%lld.%06lld",
+		(long long)(Duration / MICRO_SEC_IN_SEC_LL),
+		(long long)(Duration % MICRO_SEC_IN_SEC_LL));
+	rOut << buffer;
+}
+
+// Writes a string as a JSON string literal
+static void WriteString(std::ostream &rOut, const std::string &rString)
+{
+	rOut << '"';
+	for(std::string::const_iterator i = rString.begin();
+		i != rString.end(); i++)
+	{
+		unsigned char c = *i;
+		if(c == '"' || c == '\\')
+		{
+			rOut << '\\' << c;
+		}
+		else if(c < 0x20)
+		{
+			char buffer[8];
+			::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+			rOut << buffer;
+		}
+		else
+		{
+			rOut << c;
+		}
+	}
+	rOut << '"';
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupSyncReport::BackupSyncReport(int)
+//		Purpose: Constructor
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+BackupSyncReport::BackupSyncReport(int MaxSlowest)
+: mMaxSlowest(MaxSlowest)
+{
+	Start();
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupSyncReport::GetPhaseName(Phase)
+//		Purpose: Returns the name of a phase, as used in the report
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+const char *BackupSyncReport::GetPhaseName(Phase ThePhase)
+{
+	switch(ThePhase)
+	{
+	case Phase_SyncDirectory: return "sync_directory";
+	case Phase_Scan:          return "scan";
+	case Phase_Attributes:    return "attributes";
+	case Phase_UpdateItems:   return "update_items";
+	case Phase_UploadFile:    return "upload_file";
+	case Phase_Diff:          return "diff";
+	case Phase_Encode:        return "encode";
+	default:                  return "unknown";
+	}
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupSyncReport::Start()
+//		Purpose: Forget everything, and start timing a new run
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupSyncReport::Start()
+{
+	mStartTime = GetCurrentBoxTime();
+	mFinishTime = 0;
+	mFinished = false;
+	mSuccess = false;
+
+	for(int p = 0; p < Phase_Max; p++)
+	{
+		mPhases[p].mCount = 0;
+		mPhases[p].mTotalTime = 0;
+	}
+
+	mDirectoryTime = 0;
+	mRoundTrips.clear();
+	mFilesUploaded = 0;
+	mBytesUploaded = 0;
+	mSlowestFiles.clear();
+	mSlowestDirectories.clear();
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupSyncReport::Finish(bool)
+//		Purpose: Stop the clock, and record whether the run
+//			 completed successfully
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupSyncReport::Finish(bool Success)
+{
+	mFinishTime = GetCurrentBoxTime();
+	mFinished = true;
+	mSuccess = Success;
+}
+
+
+void BackupSyncReport::AddTime(Phase ThePhase, box_time_t Duration,
+	int64_t Count)
+{
+	ASSERT(ThePhase >= 0 && ThePhase < Phase_Max);
+	mPhases[ThePhase].mCount += Count;
+	mPhases[ThePhase].mTotalTime += Duration;
+}
+
+
+void BackupSyncReport::AddRoundTrips(const std::string &rCommand,
+	int64_t Count, box_time_t TotalTime)
+{
+	RoundTripMap::iterator i = mRoundTrips.find(rCommand);
+	if(i == mRoundTrips.end())
+	{
+		RoundTrips none = {0, 0};
+		i = mRoundTrips.insert(std::make_pair(rCommand, none)).first;
+	}
+	i->second.mCount += Count;
+	i->second.mTotalTime += TotalTime;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupSyncReport::AddFile(const std::string &,
+//			 box_time_t, int64_t)
+//		Purpose: Records a file uploaded, and how long it took
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupSyncReport::AddFile(const std::string &rPath, box_time_t Duration,
+	int64_t BytesUploaded)
+{
+	mFilesUploaded++;
+	if(BytesUploaded > 0)
+	{
+		mBytesUploaded += BytesUploaded;
+	}
+	AddSlowItem(mSlowestFiles, rPath, Duration, BytesUploaded);
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupSyncReport::AddDirectory(const std::string &,
+//			 box_time_t)
+//		Purpose: Records how long a directory took, excluding its
+//			 subdirectories
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupSyncReport::AddDirectory(const std::string &rPath,
+	box_time_t Duration)
+{
+	AddSlowItem(mSlowestDirectories, rPath, Duration, 0);
+}
+
+
+void BackupSyncReport::AddSlowItem(std::vector<SlowItem> &rHeap,
+	const std::string &rPath, box_time_t Duration, int64_t Bytes)
+{
+	if(mMaxSlowest <= 0)
+	{
+		return;
+	}
+
+	if((int)rHeap.size() >= mMaxSlowest)
+	{
+		if(Duration <= rHeap.front().mDuration)
+		{
+			// Not one of the slowest
+			return;
+		}
+		std::pop_heap(rHeap.begin(), rHeap.end(), IsSlower);
+		rHeap.pop_back();
+	}
+
+	SlowItem item;
+	item.mDuration = Duration;
+	item.mPath = rPath;
+	item.mBytes = Bytes;
+	rHeap.push_back(item);
+	std::push_heap(rHeap.begin(), rHeap.end(), IsSlower);
+}
+
+
+std::vector<BackupSyncReport::SlowItem> BackupSyncReport::GetSorted(
+	const std::vector<SlowItem> &rHeap) const
+{
+	std::vector<SlowItem> sorted(rHeap);
+	std::sort_heap(sorted.begin(), sorted.end(), IsSlower);
+	return sorted;
+}
+
+std::vector<BackupSyncReport::SlowItem> BackupSyncReport::GetSlowestFiles() const
+{
+	return GetSorted(mSlowestFiles);
+}
+
+std::vector<BackupSyncReport::SlowItem>
+BackupSyncReport::GetSlowestDirectories() const
+{
+	return GetSorted(mSlowestDirectories);
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupSyncReport::GetJson()
+//		Purpose: Returns the report as a JSON object on one line
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::string BackupSyncReport::GetJson() const
+{
+	box_time_t duration = (mFinished ? mFinishTime : GetCurrentBoxTime()) -
+		mStartTime;
+
+	std::ostringstream out;
+	out << "{\"start_time\":" << BoxTimeToSeconds(mStartTime) <<
+		",\"finished\":" << (mFinished ? "true" : "false") <<
+		",\"success\":" << (mSuccess ? "true" : "false") <<
+		",\"duration_seconds\":";
+	WriteSeconds(out, duration);
+
+	out << ",\"files_uploaded\":" << mFilesUploaded <<
+		",\"bytes_uploaded\":" << mBytesUploaded <<
+		",\"upload_bytes_per_second\":" << ((duration > 0) ?
+			(mBytesUploaded * MICRO_SEC_IN_SEC_LL / duration) : 0);
+
+	out << ",\"phases\":{";
+	for(int p = 0; p < Phase_Max; p++)
+	{
+		out << (p ? "," : "") << "\"" << GetPhaseName((Phase)p) <<
+			"\":{\"count\":" << mPhases[p].mCount <<
+			",\"seconds\":";
+		WriteSeconds(out, mPhases[p].mTotalTime);
+		out << "}";
+	}
+	out << "}";
+
+	// Round trips to the store, including sending any data with the
+	// command and the time taken by the server to handle it
+	int64_t totalCount = 0;
+	box_time_t totalTime = 0;
+	out << ",\"round_trips\":{\"commands\":{";
+	for(RoundTripMap::const_iterator i = mRoundTrips.begin();
+		i != mRoundTrips.end(); i++)
+	{
+		out << (i == mRoundTrips.begin() ? "" : ",");
+		WriteString(out, i->first);
+		out << ":{\"count\":" << i->second.mCount << ",\"seconds\":";
+		WriteSeconds(out, i->second.mTotalTime);
+		out << "}";
+		totalCount += i->second.mCount;
+		totalTime += i->second.mTotalTime;
+	}
+	out << "},\"count\":" << totalCount << ",\"seconds\":";
+	WriteSeconds(out, totalTime);
+	out << "}";
+
+	std::vector<SlowItem> files(GetSlowestFiles());
+	out << ",\"slowest_files\":[";
+	for(size_t i = 0; i < files.size(); i++)
+	{
+		out << (i ? "," : "") << "{\"path\":";
+		WriteString(out, files[i].mPath);
+		out << ",\"seconds\":";
+		WriteSeconds(out, files[i].mDuration);
+		out << ",\"bytes_uploaded\":" << files[i].mBytes << "}";
+	}
+	out << "]";
+
+	std::vector<SlowItem> dirs(GetSlowestDirectories());
+	out << ",\"slowest_directories\":[";
+	for(size_t i = 0; i < dirs.size(); i++)
+	{
+		out << (i ? "," : "") << "{\"path\":";
+		WriteString(out, dirs[i].mPath);
+		out << ",\"seconds\":";
+		WriteSeconds(out, dirs[i].mDuration);
+		out << "}";
+	}
+	out << "]}";
+
+	return out.str();
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupSyncReport::Timer::Timer(BackupSyncReport &,
+//			 Phase)
+//		Purpose: Constructor, starts timing
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+BackupSyncReport::Timer::Timer(BackupSyncReport &rReport, Phase ThePhase)
+: mrReport(rReport),
+  mPhase(ThePhase),
+  mStart(GetCurrentBoxTime()),
+  mDirectoryTimeAtStart(rReport.mDirectoryTime),
+  mElapsed(0),
+  mStopped(false)
+{ }
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupSyncReport::Timer::Stop()
+//		Purpose: Adds the time since this timer was started to its
+//			 phase, less any time spent in directories which
+//			 were synchronised in the meantime, and returns it.
+//			 Only counts the first time it's called.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+box_time_t BackupSyncReport::Timer::Stop()
+{
+	if(mStopped)
+	{
+		return mElapsed;
+	}
+	mStopped = true;
+
+	box_time_t subdirectories = mrReport.mDirectoryTime -
+		mDirectoryTimeAtStart;
+	mElapsed = GetCurrentBoxTime() - mStart - subdirectories;
+	if(mElapsed < 0)
+	{
+		// The clock went backwards
+		mElapsed = 0;
+	}
+
+	mrReport.AddTime(mPhase, mElapsed);
+	if(mPhase == Phase_SyncDirectory)
+	{
+		mrReport.mDirectoryTime += mElapsed;
+	}
+
+	return mElapsed;
+}
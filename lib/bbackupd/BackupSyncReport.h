@@ -0,0 +1,154 @@
+// --------------------------------------------------------------------------
+//
+// File
+//		Name:    BackupSyncReport.h
+//		Purpose: Where the time goes during a backup run
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+#ifndef BACKUPSYNCREPORT__H
+#define BACKUPSYNCREPORT__H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "BoxTime.h"
+
+// How many of the slowest files and directories to report
+#define BACKUP_SYNC_REPORT_MAX_SLOWEST	10
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    BackupSyncReport
+//		Purpose: Collects the time spent in each phase of a backup
+//			 run, the round trips to the store, and the slowest
+//			 files and directories, and reports them as JSON.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class BackupSyncReport
+{
+public:
+	BackupSyncReport(int MaxSlowest = BACKUP_SYNC_REPORT_MAX_SLOWEST);
+
+	enum Phase
+	{
+		// Each directory, excluding its subdirectories
+		Phase_SyncDirectory = 0,
+		// Reading and stat()ing directory entries
+		Phase_Scan,
+		// Reading the attributes and xattrs of files and directories
+		Phase_Attributes,
+		// Comparing a directory with the store, excluding its
+		// subdirectories, but including uploads
+		Phase_UpdateItems,
+		// Uploading files, including diffing and encoding them
+		Phase_UploadFile,
+		// Finding the changes from an old version of a file
+		Phase_Diff,
+		// Reading, compressing and encrypting file data
+		Phase_Encode,
+		Phase_Max
+	};
+	static const char *GetPhaseName(Phase ThePhase);
+
+	// --------------------------------------------------------------------------
+	//
+	// Class
+	//		Name:    BackupSyncReport::Timer
+	//		Purpose: Adds the time until it's stopped, or goes out
+	//			 of scope, to a phase. Time spent synchronising
+	//			 subdirectories meanwhile isn't included.
+	//		Created: 2026/10/19
+	//
+	// --------------------------------------------------------------------------
+	class Timer
+	{
+	public:
+		Timer(BackupSyncReport &rReport, Phase ThePhase);
+		~Timer() { Stop(); }
+		box_time_t Stop();
+
+	private:
+		BackupSyncReport &mrReport;
+		Phase mPhase;
+		box_time_t mStart;
+		box_time_t mDirectoryTimeAtStart;
+		box_time_t mElapsed;
+		bool mStopped;
+	};
+
+	// Time taken by the round trips of one kind of command
+	typedef struct
+	{
+		int64_t mCount;
+		box_time_t mTotalTime;
+	} RoundTrips;
+	typedef std::map<std::string, RoundTrips> RoundTripMap;
+
+	void Start();
+	void Finish(bool Success);
+	void AddTime(Phase ThePhase, box_time_t Duration, int64_t Count = 1);
+	void AddRoundTrips(const std::string &rCommand, int64_t Count,
+		box_time_t TotalTime);
+	void AddFile(const std::string &rPath, box_time_t Duration,
+		int64_t BytesUploaded);
+	void AddDirectory(const std::string &rPath, box_time_t Duration);
+	std::string GetJson() const;
+
+	box_time_t GetPhaseTime(Phase ThePhase) const
+	{
+		return mPhases[ThePhase].mTotalTime;
+	}
+	int64_t GetPhaseCount(Phase ThePhase) const
+	{
+		return mPhases[ThePhase].mCount;
+	}
+	const RoundTripMap &GetRoundTrips() const { return mRoundTrips; }
+	int64_t GetFilesUploaded() const { return mFilesUploaded; }
+	int64_t GetBytesUploaded() const { return mBytesUploaded; }
+
+	typedef struct
+	{
+		box_time_t mDuration;
+		std::string mPath;
+		int64_t mBytes;
+	} SlowItem;
+	// Slowest first
+	std::vector<SlowItem> GetSlowestFiles() const;
+	std::vector<SlowItem> GetSlowestDirectories() const;
+
+private:
+	void AddSlowItem(std::vector<SlowItem> &rHeap, const std::string &rPath,
+		box_time_t Duration, int64_t Bytes);
+	std::vector<SlowItem> GetSorted(const std::vector<SlowItem> &rHeap) const;
+
+	int mMaxSlowest;
+	box_time_t mStartTime;
+	box_time_t mFinishTime;
+	bool mFinished;
+	bool mSuccess;
+
+	struct
+	{
+		int64_t mCount;
+		box_time_t mTotalTime;
+	} mPhases[Phase_Max];
+
+	// Total of the time spent in each directory so far, which is how
+	// Timer leaves out the time spent on subdirectories
+	box_time_t mDirectoryTime;
+
+	RoundTripMap mRoundTrips;
+	int64_t mFilesUploaded;
+	int64_t mBytesUploaded;
+
+	// Min-heaps, so that the quickest of the slowest items is on top
+	std::vector<SlowItem> mSlowestFiles;
+	std::vector<SlowItem> mSlowestDirectories;
+};
+
+#endif // BACKUPSYNCREPORT__H
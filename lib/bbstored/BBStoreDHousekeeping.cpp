@@ -11,12 +11,15 @@
 
 #include <stdio.h>
 
+#include "BackupFileSystem.h"
 #include "BackupStoreDaemon.h"
 #include "BackupStoreAccountDatabase.h"
 #include "BackupStoreAccounts.h"
 #include "HousekeepStoreAccount.h"
 #include "BoxTime.h"
 #include "Configuration.h"
+#include "RaidFileController.h"
+#include "StoreStructure.h"
 
 #include "MemLeakFindOn.h"
 
@@ -61,6 +64,13 @@ void BackupStoreDaemon::HousekeepingProcess()
 		if(secondsToGo < 1) secondsToGo = 1;
 		if(secondsToGo > 60) secondsToGo = 60;
 		int32_t millisecondsToGo = ((int)secondsToGo) * 1000;
+
+		// Check RAID files in the meantime, a second at a time, so
+		// that messages are still dealt with promptly
+		if(RunRaidScrubIfNeeded(SecondsToBoxTime(1)))
+		{
+			millisecondsToGo = 0;
+		}
 	
 		// Check to see if there's any message pending
 		CheckForInterProcessMsg(0 /* no account */, millisecondsToGo);
@@ -95,6 +105,7 @@ void BackupStoreDaemon::RunHousekeepingIfNeeded()
 
 	// Store the time
 	mLastHousekeepingRun = timeNow;
+
 	BOX_INFO("Starting housekeeping");
 
 	// Get the list of accounts
@@ -129,9 +140,22 @@ void BackupStoreDaemon::RunHousekeepingIfNeeded()
 				// goes out of scope.
 			}
 			
+			// The account's files and directories may be kept
+			// in S3 rather than in its disc set
+			std::auto_ptr<BackupFileSystem> apFileSystem;
+			if(rconfig.SubConfigurationExists("S3Store"))
+			{
+				RaidFileController &rcontroller(
+					RaidFileController::GetController());
+				apFileSystem.reset(new S3BackupFileSystem(
+					rconfig.GetSubConfiguration("S3Store"),
+					rcontroller.GetDiscSet(discSet).
+						GetBlockSize()));
+			}
+
 			// Do housekeeping on this account
 			HousekeepStoreAccount housekeeping(*i, rootDir,
-				discSet, this);
+				discSet, this, apFileSystem.get());
 			housekeeping.DoHousekeeping();
 		}
 		catch(BoxException &e)
@@ -181,6 +205,148 @@ void BackupStoreDaemon::RunHousekeepingIfNeeded()
 	SetProcessTitle("housekeeping, idle");
 }
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreDaemon::RunRaidScrubIfNeeded(box_time_t)
+//		Purpose: If RaidScrubRate is set, checks the RAID files in
+//				 the next disc set which is due to be checked, for
+//				 up to MaxTime. Returns true if there's more to do.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool BackupStoreDaemon::RunRaidScrubIfNeeded(box_time_t MaxTime)
+{
+	const Configuration &rconfig(GetConfiguration());
+	int64_t rate = rconfig.GetKeyValueInt("RaidScrubRate");
+	if(rate <= 0)
+	{
+		return false;
+	}
+	box_time_t scrubInterval = SecondsToBoxTime(
+		rconfig.GetKeyValueInt("TimeBetweenRaidScrubs"));
+
+	RaidFileController &rcontroller(RaidFileController::GetController());
+	int numSets = rcontroller.GetNumDiscSets();
+	int set = mNextRaidScrubSet;
+
+	try
+	{
+		// Find a disc set which is part way through, or due to be
+		// checked again, starting after the last one checked
+		for(int s = 0; s < numSets && mapRaidScrubber.get() == 0; s++)
+		{
+			set = (mNextRaidScrubSet + s) % numSets;
+			if(rcontroller.GetDiscSet(set).IsNonRaidSet())
+			{
+				continue;
+			}
+
+			std::auto_ptr<RaidFileScrubber> apScrubber(
+				new RaidFileScrubber(set, rate * 1024,
+					true /* repair */, this));
+			if(!apScrubber->GetPosition().empty() ||
+				(GetCurrentBoxTime() -
+				apScrubber->GetLastPassFinished()) >=
+				scrubInterval)
+			{
+				mapRaidScrubber = apScrubber;
+			}
+		}
+
+		if(mapRaidScrubber.get() == 0)
+		{
+			return false;
+		}
+
+		SetProcessTitle("housekeeping, scrubbing");
+		bool finished = mapRaidScrubber->Scrub(GetCurrentBoxTime() +
+			MaxTime);
+		SetProcessTitle("housekeeping, idle");
+
+		if(finished)
+		{
+			mNextRaidScrubSet = (mapRaidScrubber->GetSetNumber() + 1)
+				% numSets;
+			mapRaidScrubber.reset();
+		}
+	}
+	catch(BoxException &e)
+	{
+		if(mapRaidScrubber.get() != 0)
+		{
+			set = mapRaidScrubber->GetSetNumber();
+		}
+		BOX_ERROR("RAID scrub of disc set " << set << " failed, "
+			"will try again later: " << e.what());
+		mNextRaidScrubSet = (set + 1) % numSets;
+		mapRaidScrubber.reset();
+		return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreDaemon::LockForRepair(int,
+//			 const std::string &)
+//		Purpose: Takes the write lock of the account which owns a
+//				 RAID file, so that the scrubber can rewrite it
+//				 without getting in the way of a client. Returns
+//				 false, without waiting, if the account is in use.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool BackupStoreDaemon::LockForRepair(int SetNumber,
+	const std::string &rFilename)
+{
+	std::vector<int32_t> accounts;
+	if(mpAccountDatabase)
+	{
+		mpAccountDatabase->GetAllAccountIDs(accounts);
+	}
+
+	for(std::vector<int32_t>::const_iterator i = accounts.begin();
+		i != accounts.end(); ++i)
+	{
+		std::string rootDir;
+		int discSet = 0;
+		mpAccounts->GetAccountRoot(*i, rootDir, discSet);
+		if(discSet != SetNumber ||
+			rFilename.compare(0, rootDir.size(), rootDir) != 0)
+		{
+			continue;
+		}
+
+		std::string writeLockFilename;
+		StoreStructure::MakeWriteLockFilename(rootDir, discSet,
+			writeLockFilename);
+		return mRepairLock.TryAndGetLock(writeLockFilename,
+			0600 /* restrictive file permissions */);
+	}
+
+	// Not part of any account, so nothing else will be using it
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreDaemon::UnlockAfterRepair()
+//		Purpose: Releases the lock taken by LockForRepair, if any
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupStoreDaemon::UnlockAfterRepair()
+{
+	if(mRepairLock.GotLock())
+	{
+		mRepairLock.ReleaseLock();
+	}
+}
+
 void BackupStoreDaemon::OnIdle()
 {
 	if (!IsSingleProcess())
@@ -9,10 +9,15 @@
 
 #include "Box.h"
 
+#include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <signal.h>
 
+#ifndef WIN32
+	#include <poll.h>
+#endif
+
 #ifdef HAVE_SYSLOG_H
 	#include <syslog.h>
 #endif
@@ -20,14 +25,29 @@
 #include "BackupStoreContext.h"
 #include "BackupStoreDaemon.h"
 #include "BackupStoreConfigVerify.h"
+#include "BackupStoreConstants.h"
 #include "autogen_BackupProtocol.h"
 #include "RaidFileController.h"
 #include "BackupStoreAccountDatabase.h"
 #include "BackupStoreAccounts.h"
 #include "BannerText.h"
+#include "HTTPRequest.h"
+#include "HTTPResponse.h"
+#include "IOStreamGetLine.h"
+#include "MemBlockStream.h"
+#include "Metrics.h"
+#include "Utils.h"
 
 #include "MemLeakFindOn.h"
 
+// How long a metrics client may take to send its whole request, in
+// milliseconds. It holds up accepting backup connections meanwhile, so keep
+// it short.
+#define BACKUP_STORE_METRICS_TIMEOUT	1000
+
+// The largest metrics request that we'll wait for, in bytes
+#define BACKUP_STORE_METRICS_MAX_REQUEST	16384
+
 // --------------------------------------------------------------------------
 //
 // Function
@@ -40,10 +60,13 @@ BackupStoreDaemon::BackupStoreDaemon()
 	: mpAccountDatabase(0),
 	  mpAccounts(0),
 	  mExtendedLogging(false),
+	  mStreamCopyBufferSize(PROTOCOL_DEFAULT_STREAM_COPY_BUFFER_SIZE),
+	  mSyncGroupSize(0),
 	  mHaveForkedHousekeeping(false),
 	  mIsHousekeepingProcess(false),
 	  mHousekeepingInited(false),
 	  mInterProcessComms(mInterProcessCommsSocket),
+	  mNextRaidScrubSet(0),
 	  mpTestHook(NULL)
 {
 }
@@ -171,6 +194,20 @@ void BackupStoreDaemon::Run()
 	mExtendedLogging = false;
 	const Configuration &config(GetConfiguration());
 	mExtendedLogging = config.GetKeyValueBool("ExtendedLogging");
+	mStreamCopyBufferSize = config.GetKeyValueInt("StreamCopyBufferSize");
+	mSyncGroupSize = 0;
+	if(config.GetKeyValueBool("SyncWrites"))
+	{
+		mSyncGroupSize = config.GetKeyValueInt("SyncGroupSize");
+		if(mSyncGroupSize < 1)
+		{
+			mSyncGroupSize = 1;
+		}
+	}
+
+	// Create the metrics before forking, so that all child processes
+	// share them with this one.
+	MetricsRegistry::GetInstance();
 	
 	// Fork off housekeeping daemon -- must only do this the first
 	// time Run() is called.  Housekeeping runs synchronously on Win32
@@ -242,6 +279,49 @@ void BackupStoreDaemon::Run()
 	}
 	else
 	{
+#ifndef WIN32
+		// Serve metrics, if wanted. This is done again after the
+		// configuration is reloaded, in case the address changed.
+		mapMetricsListener.reset();
+		if(config.KeyExists("MetricsListenAddress"))
+		{
+			std::string address(config.GetKeyValue("MetricsListenAddress"));
+			std::vector<std::string> c;
+			SplitString(address, ':', c);
+
+			std::auto_ptr<SocketListen<SocketStream> > apListener(
+				new SocketListen<SocketStream>);
+			if(c.size() == 3 && c[0] == "inet")
+			{
+				int port = ::atol(c[2].c_str());
+				if(port <= 0 || port > ((64*1024)-1))
+				{
+					THROW_EXCEPTION_MESSAGE(ServerException,
+						ServerStreamBadListenAddrs,
+						"Invalid MetricsListenAddress: " <<
+						address);
+				}
+				apListener->Listen(Socket::TypeINET, c[1].c_str(),
+					port);
+			}
+			else if(c.size() == 2 && c[0] == "unix")
+			{
+				EMU_UNLINK(c[1].c_str());
+				apListener->Listen(Socket::TypeUNIX, c[1].c_str());
+			}
+			else
+			{
+				THROW_EXCEPTION_MESSAGE(ServerException,
+					ServerStreamBadListenAddrs,
+					"Invalid MetricsListenAddress: " << address);
+			}
+
+			apListener->SetNonBlocking();
+			mapMetricsListener = apListener;
+			BOX_INFO("Serving metrics on " << address);
+		}
+#endif
+
 		// In server process -- use the base class to do the magic
 		ServerTLS<BOX_PORT_BBSTORED>::Run();
 
@@ -274,6 +354,10 @@ void BackupStoreDaemon::Run()
 // --------------------------------------------------------------------------
 void BackupStoreDaemon::Connection(std::auto_ptr<SocketStreamTLS> apStream)
 {
+	static MetricsGauge sConnections("bbstored_connections",
+		"Client connections currently being handled");
+	sConnections.Add(1);
+
 	try
 	{
 		Connection2(apStream);
@@ -294,6 +378,8 @@ void BackupStoreDaemon::Connection(std::auto_ptr<SocketStreamTLS> apStream)
 		BOX_ERROR("Error in child process, terminating connection: " <<
 			"unknown exception");
 	}
+
+	sConnections.Add(-1);
 }
 	
 // --------------------------------------------------------------------------
@@ -330,6 +416,14 @@ void BackupStoreDaemon::Connection2(std::auto_ptr<SocketStreamTLS> apStream)
 
 	// Create a context, using this ID
 	BackupStoreContext context(id, this, GetConnectionDetails());
+	context.SetStreamCopyBufferSize(mStreamCopyBufferSize);
+	context.SetSyncGroupSize(mSyncGroupSize);
+
+	const Configuration &config(GetConfiguration());
+	if(config.SubConfigurationExists("S3Store"))
+	{
+		context.SetS3Store(config.GetSubConfiguration("S3Store"));
+	}
 
 	if (mpTestHook)
 	{
@@ -350,6 +444,7 @@ void BackupStoreDaemon::Connection2(std::auto_ptr<SocketStreamTLS> apStream)
 	BackupProtocolServer server(apPlainStream);
 	server.SetLogToSysLog(mExtendedLogging);
 	server.SetTimeout(BACKUP_STORE_TIMEOUT);
+	server.SetStreamCopyBufferSize(mStreamCopyBufferSize);
 	try
 	{
 		server.DoServer(context);
@@ -374,4 +469,210 @@ void BackupStoreDaemon::LogConnectionStats(uint32_t accountId,
 		" OUT=" << server.GetBytesWritten() <<
 		" NET_IN=" << (server.GetBytesRead() - server.GetBytesWritten()) <<
 		" TOTAL=" << (server.GetBytesRead() + server.GetBytesWritten()));
+
+	static MetricsCounter sSessions("bbstored_sessions_total",
+		"Client connections handled");
+	static MetricsCounter sBytesIn("bbstored_received_bytes_total",
+		"Bytes received from clients");
+	static MetricsCounter sBytesOut("bbstored_sent_bytes_total",
+		"Bytes sent to clients");
+	sSessions.Increment();
+	sBytesIn.Increment(server.GetBytesRead());
+	sBytesOut.Increment(server.GetBytesWritten());
+}
+
+#ifndef WIN32
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreDaemon::NotifyListenerIsReady()
+//		Purpose: When serving metrics, the listening sockets are
+//			 polled here instead of by the base class, and
+//			 must not block if a worker process accepts the
+//			 connection first.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupStoreDaemon::NotifyListenerIsReady()
+{
+	if(!mapMetricsListener.get())
+	{
+		return;
+	}
+
+	const std::vector<SocketListen<SocketStreamTLS> *> &rSockets(
+		GetListeningSockets());
+	for(size_t i = 0; i < rSockets.size(); i++)
+	{
+		rSockets[i]->SetNonBlocking();
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreDaemon::WaitForConnection(WaitForEvent &)
+//		Purpose: Waits for a backup connection, serving any requests
+//			 for metrics which arrive in the meantime. Returns
+//			 the listening socket with a connection waiting, or
+//			 NULL after a timeout.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void *BackupStoreDaemon::WaitForConnection(WaitForEvent &rConnectionWait)
+{
+	if(!mapMetricsListener.get())
+	{
+		return ServerTLS<BOX_PORT_BBSTORED>::WaitForConnection(
+			rConnectionWait);
+	}
+
+	const std::vector<SocketListen<SocketStreamTLS> *> &rSockets(
+		GetListeningSockets());
+	size_t numListeners = rSockets.size();
+	std::vector<struct pollfd> fds(numListeners + 1);
+
+	for(size_t i = 0; i < numListeners; i++)
+	{
+		fds[i].fd = rSockets[i]->GetSocketHandle();
+		fds[i].events = POLLIN;
+		fds[i].revents = 0;
+	}
+
+	fds[numListeners].fd = mapMetricsListener->GetSocketHandle();
+	fds[numListeners].events = POLLIN;
+	fds[numListeners].revents = 0;
+
+	// Wake up as often as the base class would, to check whether
+	// we've been asked to stop.
+	if(::poll(&fds[0], fds.size(), 1000) == -1)
+	{
+		if(errno == EINTR)
+		{
+			return NULL;
+		}
+		THROW_SYS_ERROR("Failed to poll listening sockets",
+			ServerException, SocketPollError);
+	}
+
+	if(fds[numListeners].revents)
+	{
+		ServeMetrics();
+	}
+
+	for(size_t i = 0; i < numListeners; i++)
+	{
+		if(fds[i].revents)
+		{
+			return rSockets[i];
+		}
+	}
+
+	return NULL;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreDaemon::EnterChild()
+//		Purpose: Child processes handle backup connections only,
+//			 so close the metrics socket in them.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupStoreDaemon::EnterChild()
+{
+	ServerTLS<BOX_PORT_BBSTORED>::EnterChild();
+	mapMetricsListener.reset();
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    BackupStoreDaemon::ServeMetrics()
+//		Purpose: Accepts a connection on the metrics socket, and
+//			 answers one request on it with the current values
+//			 of all metrics, in Prometheus text format. The
+//			 whole request must arrive within
+//			 BACKUP_STORE_METRICS_TIMEOUT, so that a client
+//			 which sends it slowly can't hold up accepting
+//			 backup connections for any longer than that.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void BackupStoreDaemon::ServeMetrics()
+{
+	// Don't log every scrape, they happen often
+	std::string details;
+	std::auto_ptr<SocketStream> apConn(mapMetricsListener->Accept(0,
+		&details));
+	if(!apConn.get())
+	{
+		// Another process got there first
+		return;
+	}
+
+	try
+	{
+		box_time_t deadline = GetCurrentBoxTime() +
+			MilliSecondsToBoxTime(BACKUP_STORE_METRICS_TIMEOUT);
+		std::string input;
+		bool expectsContinue = false;
+		int size = 0;
+
+		while((size = HTTPRequest::GetSizeOfCompleteRequest(
+			input.c_str(), input.size(), expectsContinue)) == 0)
+		{
+			box_time_t now = GetCurrentBoxTime();
+			if(now >= deadline ||
+				input.size() > BACKUP_STORE_METRICS_MAX_REQUEST)
+			{
+				BOX_WARNING("Failed to receive a metrics request "
+					"from " << details << " in time");
+				return;
+			}
+
+			char buffer[1024];
+			int bytes = apConn->Read(buffer, sizeof(buffer),
+				(int)BoxTimeToMilliSeconds(deadline - now) + 1);
+			if(bytes == 0 && !apConn->StreamDataLeft())
+			{
+				// Closed without sending a request
+				return;
+			}
+			input.append(buffer, bytes);
+		}
+
+		MemBlockStream requestData(input.c_str(), size);
+		IOStreamGetLine getLine(requestData);
+		HTTPRequest request;
+		if(!request.Receive(getLine, BACKUP_STORE_METRICS_TIMEOUT))
+		{
+			return;
+		}
+
+		HTTPResponse response(apConn.get());
+		response.SetKeepAlive(false);
+		response.SetContentType("text/plain; version=0.0.4");
+
+		if(request.GetRequestURI() == "/metrics")
+		{
+			response.SetResponseCode(HTTPResponse::Code_OK);
+			std::string text(
+				MetricsRegistry::GetInstance().GetPrometheusText());
+			response.Write(text.c_str(), text.size());
+		}
+		else
+		{
+			response.SetResponseCode(HTTPResponse::Code_NotFound);
+		}
+
+		response.Send(request.GetMethod() == HTTPRequest::Method_HEAD);
+	}
+	catch(BoxException &e)
+	{
+		BOX_WARNING("Failed to send metrics to " << details << ": " <<
+			e.what());
+	}
 }
+#endif // !WIN32
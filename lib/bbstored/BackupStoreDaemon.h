@@ -16,6 +16,9 @@
 #include "BackupStoreContext.h"
 #include "HousekeepStoreAccount.h"
 #include "IOStreamGetLine.h"
+#include "NamedLock.h"
+#include "RaidFileScrubber.h"
+#include "SocketListen.h"
 
 class BackupStoreAccounts;
 class BackupStoreAccountDatabase;
@@ -29,7 +32,7 @@ class BackupStoreAccountDatabase;
 //
 // --------------------------------------------------------------------------
 class BackupStoreDaemon : public ServerTLS<BOX_PORT_BBSTORED>,
-	HousekeepingInterface, HousekeepingCallback
+	HousekeepingInterface, HousekeepingCallback, RaidFileRepairLocker
 {
 public:
 	BackupStoreDaemon();
@@ -66,6 +69,14 @@ protected:
 	void LogConnectionStats(uint32_t accountId,
 		const std::string& accountName, const BackupProtocolServer &server);
 
+#ifndef WIN32
+	// Metrics endpoint
+	virtual void NotifyListenerIsReady();
+	virtual void *WaitForConnection(WaitForEvent &rConnectionWait);
+	virtual void EnterChild();
+	void ServeMetrics();
+#endif
+
 public:
 	// HousekeepingInterface implementation
 	virtual bool CheckForInterProcessMsg(int AccountNum = 0, int MaximumWaitTime = 0);
@@ -75,6 +86,8 @@ private:
 	BackupStoreAccountDatabase *mpAccountDatabase;
 	BackupStoreAccounts *mpAccounts;
 	bool mExtendedLogging;
+	int mStreamCopyBufferSize;
+	int mSyncGroupSize;
 	bool mHaveForkedHousekeeping;
 	bool mIsHousekeepingProcess;
 	bool mHousekeepingInited;
@@ -86,6 +99,19 @@ private:
 	void HousekeepingInit();
 	int64_t mLastHousekeepingRun;
 
+	bool RunRaidScrubIfNeeded(box_time_t MaxTime);
+	std::auto_ptr<RaidFileScrubber> mapRaidScrubber;
+	int mNextRaidScrubSet;
+
+	// RaidFileRepairLocker implementation
+	virtual bool LockForRepair(int SetNumber, const std::string &rFilename);
+	virtual void UnlockAfterRepair();
+	NamedLock mRepairLock;
+
+#ifndef WIN32
+	std::auto_ptr<SocketListen<SocketStream> > mapMetricsListener;
+#endif
+
 public:
 	void SetTestHook(BackupStoreContext::TestHook& rTestHook)
 	{
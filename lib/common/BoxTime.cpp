@@ -62,6 +62,32 @@ box_time_t GetCurrentBoxTime()
 	return SecondsToBoxTime(time(0));
 }
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    GetCurrentMonotonicTime()
+//		Purpose: Returns the time since some arbitrary point, which
+//			 never goes backwards when the system clock is
+//			 changed. Only useful for measuring intervals.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+box_time_t GetCurrentMonotonicTime()
+{
+#if defined HAVE_CLOCK_GETTIME && defined CLOCK_MONOTONIC
+	struct timespec ts;
+	if(::clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+	{
+		return (ts.tv_sec * MICRO_SEC_IN_SEC_LL) +
+			(ts.tv_nsec / NANO_SEC_IN_USEC);
+	}
+	BOX_LOG_SYS_ERROR("Failed to read monotonic clock, using system "
+		"clock instead");
+#endif
+
+	return GetCurrentBoxTime();
+}
+
 std::string FormatTime(box_time_t time, bool includeDate, bool showMicros)
 {
 	std::ostringstream buf;
@@ -23,6 +23,7 @@ typedef int64_t box_time_t;
 #define MILLI_SEC_IN_SEC_LL	(1000LL)
 
 box_time_t GetCurrentBoxTime();
+box_time_t GetCurrentMonotonicTime();
 
 inline box_time_t SecondsToBoxTime(time_t Seconds)
 {
@@ -0,0 +1 @@
+#define BOX_VERSION "git_7807f6d7145d9dab1e5098cc0ed9a6f6fa514a24"
@@ -243,6 +243,25 @@ IOStream::pos_type FileStream::BytesLeftToRead()
 }
 
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    FileStream::GetReadFileHandle()
+//		Purpose: Returns the file descriptor, for zero-copy sends
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int FileStream::GetReadFileHandle()
+{
+#ifdef WIN32
+	// HANDLEs can't be used with sendfile()
+	return -1;
+#else
+	return (mOSFileHandle == INVALID_FILE || mIsEOF) ? -1 : mOSFileHandle;
+#endif
+}
+
+
 // --------------------------------------------------------------------------
 //
 // Function
@@ -361,6 +380,40 @@ void FileStream::Seek(IOStream::pos_type Offset, int SeekType)
 }
 
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    FileStream::Truncate(pos_type)
+//		Purpose: Truncates the file to the given length, as
+//			 ftruncate. Leaves the file pointer at the new end.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void FileStream::Truncate(IOStream::pos_type Length)
+{
+	if(mOSFileHandle == INVALID_FILE) 
+	{
+		THROW_EXCEPTION(CommonException, FileClosed)
+	}
+
+	Seek(Length, IOStream::SeekType_Absolute);
+
+#ifdef WIN32
+	if(!SetEndOfFile(this->mOSFileHandle))
+	{
+		THROW_WIN_FILE_ERROR("Failed to truncate file", mFileName,
+			CommonException, OSFileError);
+	}
+#else // ! WIN32
+	if(::ftruncate(mOSFileHandle, Length) != 0)
+	{
+		THROW_SYS_FILE_ERROR("Failed to truncate file", mFileName,
+			CommonException, OSFileError);
+	}
+#endif // WIN32
+}
+
+
 // --------------------------------------------------------------------------
 //
 // Function
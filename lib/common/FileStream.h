@@ -40,12 +40,14 @@ public:
 	
 	virtual int Read(void *pBuffer, int NBytes, int Timeout = IOStream::TimeOutInfinite);
 	virtual pos_type BytesLeftToRead();
+	virtual int GetReadFileHandle();
 	virtual void Write(const void *pBuffer, int NBytes,
 		int Timeout = IOStream::TimeOutInfinite);
 	using IOStream::Write;
 	virtual pos_type GetPosition() const;
 	virtual void Seek(IOStream::pos_type Offset, int SeekType);
 	virtual void Close();
+	void Truncate(IOStream::pos_type Length);
 	
 	virtual bool StreamDataLeft();
 	virtual bool StreamClosed();
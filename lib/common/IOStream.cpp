@@ -184,6 +184,22 @@ IOStream::pos_type IOStream::BytesLeftToRead()
 	return IOStream::SizeOfStreamUnknown;
 }
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    IOStream::GetReadFileHandle()
+//		Purpose: Returns the OS file descriptor that Read() reads from,
+//				 positioned where the next Read() would start, so that
+//				 the data can be sent without copying it through a
+//				 buffer. Returns -1 if the stream isn't simply a file.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int IOStream::GetReadFileHandle()
+{
+	return -1;
+}
+
 // --------------------------------------------------------------------------
 //
 // Function
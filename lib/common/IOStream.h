@@ -47,6 +47,7 @@ public:
 	typedef int64_t pos_type;
 	virtual int Read(void *pBuffer, int NBytes, int Timeout = IOStream::TimeOutInfinite) = 0;
 	virtual pos_type BytesLeftToRead();	// may return IOStream::SizeOfStreamUnknown (and will for most stream types)
+	virtual int GetReadFileHandle();	// -1 unless reading straight from a file
 	virtual void Write(const void *pBuffer, int NBytes,
 		int Timeout = IOStream::TimeOutInfinite) = 0;
 	virtual void Write(const std::string& rBuffer,
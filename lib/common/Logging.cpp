@@ -46,6 +46,8 @@ Logging     Logging::sGlobalLogging; // automatic initialisation
 std::string Logging::sProgramName;
 const Log::Category Logging::UNCATEGORISED("Uncategorised");
 std::auto_ptr<HideFileGuard> Logging::sapHideFileGuard;
+Log::Level  Logging::sMaxLevel = Log::EVERYTHING;
+bool        Logging::sLevelsChanged = true;
 
 HideSpecificExceptionGuard::SuppressedExceptions_t
 	HideSpecificExceptionGuard::sSuppressedExceptions;
@@ -122,6 +124,7 @@ void Logging::Add(Logger* pNewLogger)
 	}
 	
 	sLoggers.insert(sLoggers.begin(), pNewLogger);
+	sLevelsChanged = true;
 }
 
 void Logging::Remove(Logger* pOldLogger)
@@ -132,11 +135,30 @@ void Logging::Remove(Logger* pOldLogger)
 		if (*i == pOldLogger)
 		{
 			sLoggers.erase(i);
+			sLevelsChanged = true;
 			return;
 		}
 	}
 }
 
+void Logging::UpdateMaxLevel()
+{
+	// Loggers which only hide messages from the others count too,
+	// which is harmless, as they are only used for debugging.
+	sMaxLevel = Log::NOTHING;
+
+	for (std::vector<Logger*>::iterator i = sLoggers.begin();
+		i != sLoggers.end(); i++)
+	{
+		if ((int)(*i)->GetLevel() > (int)sMaxLevel)
+		{
+			sMaxLevel = (*i)->GetLevel();
+		}
+	}
+
+	sLevelsChanged = false;
+}
+
 void Logging::Log(Log::Level level, const std::string& file, int line,
 	const std::string& function, const Log::Category& category,
 	const std::string& message)
@@ -244,6 +266,12 @@ Logger::~Logger()
 	Logging::Remove(this);
 }
 
+void Logger::Filter(Log::Level level)
+{
+	mCurrentLevel = level;
+	Logging::LevelsChanged();
+}
+
 bool Logger::IsEnabled(Log::Level level)
 {
 	return (int)mCurrentLevel >= (int)level;
@@ -458,6 +486,74 @@ int Syslog::GetNamedFacility(const std::string& rFacility)
 	return LOG_LOCAL6;
 }
 
+FileLogger::FileLogger(const std::string& rFileName, Log::Level Level,
+	bool append, size_t BufferSize, bool DropWhenFull)
+: Logger(Level),
+  mLogFile(rFileName, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC)),
+  mBufferSize(BufferSize),
+  mDropWhenFull(DropWhenFull),
+  mDroppedMessages(0),
+  mDroppedSinceFlush(0),
+  mLastFlush(GetCurrentBoxTime()),
+  mOwnerPid(getpid())
+{ }
+
+FileLogger::~FileLogger()
+{
+	try
+	{
+		Flush();
+	}
+	catch(...)
+	{
+		// Nowhere left to report it
+	}
+}
+
+void FileLogger::CheckOwner()
+{
+	if (getpid() != mOwnerPid)
+	{
+		// Anything buffered was inherited from the parent process,
+		// which will write it itself. Forked children often leave
+		// without destroying anything, so don't buffer any more.
+		mBuffer.clear();
+		mDroppedSinceFlush = 0;
+		mBufferSize = 0;
+		mOwnerPid = getpid();
+	}
+}
+
+void FileLogger::Flush()
+{
+	CheckOwner();
+
+	box_time_t now = GetCurrentBoxTime();
+
+	if (mDroppedSinceFlush)
+	{
+		std::ostringstream buf;
+		buf << FormatTime(now, true, false) << " [WARNING] " <<
+			mDroppedSinceFlush << " log messages were dropped "
+			"because the log buffer was full\n";
+		mBuffer += buf.str();
+		mDroppedSinceFlush = 0;
+	}
+
+	mLastFlush = now;
+
+	if (mBuffer.empty() || mLogFile.StreamClosed())
+	{
+		return;
+	}
+
+	// Clear the buffer first, in case writing it throws an exception,
+	// which is logged
+	std::string output;
+	output.swap(mBuffer);
+	mLogFile.Write(output.c_str(), output.length());
+}
+
 bool FileLogger::Log(Log::Level level, const std::string& file, int line,
 	const std::string& function, const Log::Category& category,
 	const std::string& message)
@@ -473,13 +569,27 @@ bool FileLogger::Log(Log::Level level, const std::string& file, int line,
 	{
 		return true;
 	}
+
+	CheckOwner();
+
+	box_time_t now = GetCurrentBoxTime();
+	bool flush = (mBufferSize == 0 || level <= Log::WARNING ||
+		now - mLastFlush >= FILELOGGER_FLUSH_INTERVAL);
+
+	if (mDropWhenFull && !flush && mBuffer.size() >= mBufferSize)
+	{
+		// Don't even format it
+		mDroppedMessages++;
+		mDroppedSinceFlush++;
+		return true;
+	}
 	
 	/* avoid infinite loop if this throws an exception */
 	Log::Level old_level = GetLevel();
-	Filter(Log::NOTHING);
+	SetLevelTemporarily(Log::NOTHING);
 
 	std::ostringstream buf;
-	buf << FormatTime(GetCurrentBoxTime(), true, false);
+	buf << FormatTime(now, true, false);
 	buf << " ";
 
 	if (level <= Log::FATAL)
@@ -514,10 +624,29 @@ bool FileLogger::Log(Log::Level level, const std::string& file, int line,
 		ConvertUtf8ToConsole(output.c_str(), output);
 	#endif
 
-	mLogFile.Write(output.c_str(), output.length());
+	if (mBufferSize && mBuffer.size() + output.length() > mBufferSize)
+	{
+		if (mDropWhenFull && !flush)
+		{
+			mDroppedMessages++;
+			mDroppedSinceFlush++;
+			SetLevelTemporarily(old_level);
+			return true;
+		}
+
+		// Wait for the buffer to be written, to make room
+		Flush();
+	}
+
+	mBuffer += output;
+
+	if (flush)
+	{
+		Flush();
+	}
 
 	// no infinite loop, reset to saved logging level
-	Filter(old_level);
+	SetLevelTemporarily(old_level);
 	return true;
 }
 
@@ -20,9 +20,13 @@
 #include <sstream>
 #include <vector>
 
+#include "BoxTime.h"
 #include "FileStream.h"
 
+// Messages are only formatted if a logger might want them, so that
+// disabled trace logging costs almost nothing.
 #define BOX_LOG(level, stuff) \
+if(Logging::IsEnabled(level)) \
 { \
 	std::ostringstream _box_log_line; \
 	_box_log_line << stuff; \
@@ -31,6 +35,7 @@
 }
 
 #define BOX_LOG_CATEGORY(level, category, stuff) \
+if(Logging::IsEnabled(level)) \
 { \
 	std::ostringstream _box_log_line; \
 	_box_log_line << stuff; \
@@ -231,11 +236,14 @@ class Logger
 		const std::string& function, const Log::Category& category,
 		const std::string& message) = 0;
 	
-	void Filter(Log::Level level)
-	{
-		mCurrentLevel = level;
-	}
+	void Filter(Log::Level level);
 
+	protected:
+	// Changes the level for a moment, without making Logging recompute
+	// its maximum level, for a logger which must not log recursively.
+	void SetLevelTemporarily(Log::Level level) { mCurrentLevel = level; }
+
+	public:
 	virtual const char* GetType() = 0;
 	Log::Level GetLevel() { return mCurrentLevel; }
 	bool IsEnabled(Log::Level level);
@@ -440,6 +448,9 @@ class Logging
 	static Logging    sGlobalLogging;
 	static std::string sProgramName;
 	static std::auto_ptr<HideFileGuard> sapHideFileGuard;
+	static Log::Level sMaxLevel;
+	static bool sLevelsChanged;
+	static void UpdateMaxLevel();
 
 	public:
 	Logging ();
@@ -465,6 +476,19 @@ class Logging
 	static Console& GetConsole() { return *spConsole; }
 	static Syslog&  GetSyslog()  { return *spSyslog; }
 
+	// Returns false if no logger would accept a message at this level,
+	// so that callers can skip formatting it. Called for every message,
+	// so the highest level is only worked out again after a change.
+	static bool IsEnabled(Log::Level level)
+	{
+		if(sLevelsChanged)
+		{
+			UpdateMaxLevel();
+		}
+		return (int)level <= (int)sMaxLevel;
+	}
+	static void LevelsChanged() { sLevelsChanged = true; }
+
 	class ShowTagOnConsole
 	{
 		private:
@@ -576,22 +600,50 @@ class Logging
 	static const Log::Category UNCATEGORISED;
 };
 
+// Buffered messages are written at least this often, if any more arrive
+#define FILELOGGER_FLUSH_INTERVAL	MICRO_SEC_IN_SEC_LL
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    FileLogger
+//		Purpose: Logs to a file. If given a buffer size, messages are
+//			 collected in memory and written together, when the
+//			 buffer is full, a warning or worse is logged, a
+//			 message arrives more than FILELOGGER_FLUSH_INTERVAL
+//			 after the last write, or the logger is destroyed.
+//			 When the buffer is full, the caller either waits
+//			 for it to be written, or if DropWhenFull is set,
+//			 less important messages are dropped and counted
+//			 instead, so that heavy trace logging can't slow
+//			 down the program much.
+//		Created: 2006/12/16
+//
+// --------------------------------------------------------------------------
 class FileLogger : public Logger
 {
 	private:
 	FileStream mLogFile;
+	std::string mBuffer;
+	size_t mBufferSize;
+	bool mDropWhenFull;
+	int64_t mDroppedMessages, mDroppedSinceFlush;
+	box_time_t mLastFlush;
+	pid_t mOwnerPid;
 	FileLogger(const FileLogger& forbidden)
 	: mLogFile("") { /* do not call */ }
+	void CheckOwner();
 	
 	public:
-	FileLogger(const std::string& rFileName, Log::Level Level, bool append)
-	: Logger(Level),
-	  mLogFile(rFileName, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC))
-	{ }
+	FileLogger(const std::string& rFileName, Log::Level Level, bool append,
+		size_t BufferSize = 0, bool DropWhenFull = false);
+	virtual ~FileLogger();
 	
 	virtual bool Log(Log::Level level, const std::string& file, int line,
 		const std::string& function, const Log::Category& category,
 		const std::string& message);
+	void Flush();
+	int64_t GetDroppedMessages() const { return mDroppedMessages; }
 	
 	virtual const char* GetType() { return "FileLogger"; }
 	virtual void SetProgramName(const std::string& rProgramName) { }
@@ -0,0 +1,408 @@
+// --------------------------------------------------------------------------
+//
+// File
+//		Name:    Metrics.cpp
+//		Purpose: Counters, gauges and latency histograms, shared
+//			 between a daemon and the processes that it forks
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+#include "Box.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#ifdef HAVE_SYS_MMAN_H
+	#include <sys/mman.h>
+#endif
+
+#include "Metrics.h"
+
+#include "MemLeakFindOn.h"
+
+// Other processes may be updating the same values at the same time
+#ifdef __GNUC__
+	#define METRICS_ADD(pValue, Amount) \
+		__sync_fetch_and_add((pValue), (Amount))
+	#define METRICS_CLAIM(pState) \
+		__sync_bool_compare_and_swap((pState), Series_Free, Series_Claimed)
+	#define METRICS_BARRIER() __sync_synchronize()
+#else
+	#define METRICS_ADD(pValue, Amount) (*(pValue) += (Amount))
+	#define METRICS_CLAIM(pState) \
+		(*(pState) == Series_Free ? (*(pState) = Series_Claimed, true) : false)
+	#define METRICS_BARRIER()
+#endif
+
+#if defined MAP_ANONYMOUS
+	#define METRICS_MAP_ANONYMOUS MAP_ANONYMOUS
+#elif defined MAP_ANON
+	#define METRICS_MAP_ANONYMOUS MAP_ANON
+#endif
+
+enum
+{
+	Series_Free = 0,
+	Series_Claimed,	// being filled in by some process
+	Series_Ready
+};
+
+struct MetricsSeries
+{
+	volatile int mState;
+	int mType;
+	char mName[METRICS_MAX_NAME];
+	char mLabels[METRICS_MAX_LABELS];
+	char mHelp[METRICS_MAX_HELP];
+	int64_t mValues[METRICS_MAX_VALUES];
+};
+
+// Upper bounds of the histogram buckets, in microseconds
+static const box_time_t sHistogramBuckets[METRICS_HISTOGRAM_BUCKETS - 1] =
+{
+	1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+	1000000, 2500000, 5000000, 10000000
+};
+
+// All the series with the same name, by their labels
+typedef std::map<std::string, std::vector<int64_t> > SeriesMap;
+struct MetricsFamily
+{
+	int mType;
+	std::string mHelp;
+	SeriesMap mSeries;
+};
+
+// Histogram values are the buckets, then the sum and the count
+#define HISTOGRAM_SUM	METRICS_HISTOGRAM_BUCKETS
+#define HISTOGRAM_COUNT	(METRICS_HISTOGRAM_BUCKETS + 1)
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    MetricsRegistry::MetricsRegistry()
+//		Purpose: Constructor. Maps memory which child processes will
+//			 share, if the platform supports it.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+MetricsRegistry::MetricsRegistry()
+: mpSeries(NULL),
+  mShared(false),
+  mWarnedFull(false)
+{
+	size_t size = sizeof(MetricsSeries) * METRICS_MAX_SERIES;
+
+#if defined HAVE_SYS_MMAN_H && defined METRICS_MAP_ANONYMOUS
+	void *pShared = ::mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | METRICS_MAP_ANONYMOUS, -1, 0);
+	if(pShared != MAP_FAILED)
+	{
+		// Anonymous mappings are zero-filled
+		mpSeries = (MetricsSeries *)pShared;
+		mShared = true;
+	}
+	else
+	{
+		BOX_LOG_SYS_WARNING("Failed to map shared memory for "
+			"metrics, child processes won't be counted");
+	}
+#endif
+
+	if(!mpSeries)
+	{
+		mpSeries = (MetricsSeries *)::calloc(1, size);
+		if(!mpSeries)
+		{
+			throw std::bad_alloc();
+		}
+	}
+
+	::memset(mDiscardedValues, 0, sizeof(mDiscardedValues));
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    MetricsRegistry::~MetricsRegistry()
+//		Purpose: Destructor
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+MetricsRegistry::~MetricsRegistry()
+{
+#if defined HAVE_SYS_MMAN_H && defined METRICS_MAP_ANONYMOUS
+	if(mShared)
+	{
+		::munmap(mpSeries, sizeof(MetricsSeries) * METRICS_MAX_SERIES);
+		return;
+	}
+#endif
+	::free(mpSeries);
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    MetricsRegistry::GetInstance()
+//		Purpose: Returns the registry for this process, which is
+//			 created the first time that it's needed. To count
+//			 the metrics of child processes, that must happen
+//			 before they are forked.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+MetricsRegistry &MetricsRegistry::GetInstance()
+{
+	static MetricsRegistry sRegistry;
+	return sRegistry;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    MetricsRegistry::GetValues(Type, const std::string &,
+//			 const std::string &, const std::string &)
+//		Purpose: Returns the values of the series with this name and
+//			 labels, adding it if it doesn't exist yet. If the
+//			 registry is full, the values are discarded instead.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int64_t *MetricsRegistry::GetValues(Type SeriesType, const std::string &rName,
+	const std::string &rLabels, const std::string &rHelp)
+{
+	ASSERT(rName.size() < METRICS_MAX_NAME);
+	ASSERT(rLabels.size() < METRICS_MAX_LABELS);
+
+	for(int i = 0; i < METRICS_MAX_SERIES; i++)
+	{
+		MetricsSeries &rSeries(mpSeries[i]);
+
+		if(rSeries.mState == Series_Ready)
+		{
+			if(rSeries.mType == SeriesType &&
+				rName == rSeries.mName &&
+				rLabels == rSeries.mLabels)
+			{
+				return rSeries.mValues;
+			}
+			continue;
+		}
+
+		// Another process might be adding the same series to this
+		// slot right now, in which case we might add it again in
+		// another one. That's harmless, because duplicates are
+		// added together when they are reported.
+		if(rSeries.mState == Series_Free &&
+			METRICS_CLAIM(&rSeries.mState))
+		{
+			rSeries.mType = SeriesType;
+			::strncpy(rSeries.mName, rName.c_str(),
+				sizeof(rSeries.mName) - 1);
+			::strncpy(rSeries.mLabels, rLabels.c_str(),
+				sizeof(rSeries.mLabels) - 1);
+			::strncpy(rSeries.mHelp, rHelp.c_str(),
+				sizeof(rSeries.mHelp) - 1);
+			METRICS_BARRIER();
+			rSeries.mState = Series_Ready;
+			return rSeries.mValues;
+		}
+	}
+
+	if(!mWarnedFull)
+	{
+		BOX_WARNING("Too many metrics, not recording " << rName);
+		mWarnedFull = true;
+	}
+
+	return mDiscardedValues;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    MetricsRegistry::GetPrometheusText()
+//		Purpose: Returns all metrics in the Prometheus text
+//			 exposition format, version 0.0.4
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::string MetricsRegistry::GetPrometheusText() const
+{
+	// Group the series into families by name, adding any duplicates
+	// together, and sort them so that the output is stable.
+	std::map<std::string, MetricsFamily> families;
+
+	for(int i = 0; i < METRICS_MAX_SERIES; i++)
+	{
+		const MetricsSeries &rSeries(mpSeries[i]);
+		if(rSeries.mState != Series_Ready)
+		{
+			continue;
+		}
+
+		MetricsFamily &rFamily(families[rSeries.mName]);
+		rFamily.mType = rSeries.mType;
+		rFamily.mHelp = rSeries.mHelp;
+
+		std::vector<int64_t> &rValues(rFamily.mSeries[rSeries.mLabels]);
+		rValues.resize(METRICS_MAX_VALUES, 0);
+		for(int v = 0; v < METRICS_MAX_VALUES; v++)
+		{
+			rValues[v] += rSeries.mValues[v];
+		}
+	}
+
+	std::ostringstream out;
+
+	for(std::map<std::string, MetricsFamily>::iterator
+		f = families.begin(); f != families.end(); f++)
+	{
+		const std::string &rName(f->first);
+		MetricsFamily &rFamily(f->second);
+
+		out << "# HELP " << rName << " " << rFamily.mHelp << "\n";
+		out << "# TYPE " << rName << " " <<
+			(rFamily.mType == Type_Counter ? "counter" :
+			 rFamily.mType == Type_Gauge ? "gauge" : "histogram") <<
+			"\n";
+
+		for(SeriesMap::iterator s = rFamily.mSeries.begin();
+			s != rFamily.mSeries.end(); s++)
+		{
+			const std::string &rLabels(s->first);
+			std::vector<int64_t> &rValues(s->second);
+
+			if(rFamily.mType != Type_Histogram)
+			{
+				out << rName;
+				if(!rLabels.empty())
+				{
+					out << "{" << rLabels << "}";
+				}
+				out << " " << rValues[0] << "\n";
+				continue;
+			}
+
+			std::string prefix = rLabels.empty() ? "" : rLabels + ",";
+			int64_t cumulative = 0;
+			for(int b = 0; b < METRICS_HISTOGRAM_BUCKETS; b++)
+			{
+				cumulative += rValues[b];
+				out << rName << "_bucket{" << prefix << "le=\"";
+				if(b < METRICS_HISTOGRAM_BUCKETS - 1)
+				{
+					out << ((double)sHistogramBuckets[b] /
+						MICRO_SEC_IN_SEC);
+				}
+				else
+				{
+					out << "+Inf";
+				}
+				out << "\"} " << cumulative << "\n";
+			}
+
+			std::string labels = rLabels.empty() ? "" :
+				"{" + rLabels + "}";
+			out << rName << "_sum" << labels << " " << std::fixed <<
+				std::setprecision(6) <<
+				((double)rValues[HISTOGRAM_SUM] / MICRO_SEC_IN_SEC) <<
+				"\n";
+			out.unsetf(std::ios::floatfield);
+			out << std::setprecision(6);
+			out << rName << "_count" << labels << " " <<
+				rValues[HISTOGRAM_COUNT] << "\n";
+		}
+	}
+
+	return out.str();
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    MetricsCounter::MetricsCounter(const std::string &,
+//			 const std::string &, const std::string &)
+//		Purpose: Constructor. Labels are written as they appear in
+//			 the output, for example: command="GetFile"
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+MetricsCounter::MetricsCounter(const std::string &rName,
+	const std::string &rHelp, const std::string &rLabels)
+: mpValues(MetricsRegistry::GetInstance().GetValues(
+	MetricsRegistry::Type_Counter, rName, rLabels, rHelp))
+{ }
+
+void MetricsCounter::Increment(int64_t Amount)
+{
+	METRICS_ADD(mpValues, Amount);
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    MetricsGauge::MetricsGauge(const std::string &,
+//			 const std::string &, const std::string &)
+//		Purpose: Constructor
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+MetricsGauge::MetricsGauge(const std::string &rName,
+	const std::string &rHelp, const std::string &rLabels)
+: mpValues(MetricsRegistry::GetInstance().GetValues(
+	MetricsRegistry::Type_Gauge, rName, rLabels, rHelp))
+{ }
+
+void MetricsGauge::Add(int64_t Amount)
+{
+	METRICS_ADD(mpValues, Amount);
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    MetricsHistogram::MetricsHistogram(const std::string &,
+//			 const std::string &, const std::string &)
+//		Purpose: Constructor
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+MetricsHistogram::MetricsHistogram(const std::string &rName,
+	const std::string &rHelp, const std::string &rLabels)
+: mpValues(MetricsRegistry::GetInstance().GetValues(
+	MetricsRegistry::Type_Histogram, rName, rLabels, rHelp))
+{ }
+
+void MetricsHistogram::Record(box_time_t Duration)
+{
+	int bucket = 0;
+	while(bucket < METRICS_HISTOGRAM_BUCKETS - 1 &&
+		Duration > sHistogramBuckets[bucket])
+	{
+		bucket++;
+	}
+
+	METRICS_ADD(&mpValues[bucket], 1);
+	METRICS_ADD(&mpValues[HISTOGRAM_SUM], Duration);
+	METRICS_ADD(&mpValues[HISTOGRAM_COUNT], 1);
+}
+
+int64_t MetricsHistogram::GetCount() const
+{
+	return mpValues[HISTOGRAM_COUNT];
+}
@@ -0,0 +1,151 @@
+// --------------------------------------------------------------------------
+//
+// File
+//		Name:    Metrics.h
+//		Purpose: Counters, gauges and latency histograms, shared
+//			 between a daemon and the processes that it forks
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+#ifndef METRICS__H
+#define METRICS__H
+
+#include <string>
+
+#include "BoxTime.h"
+
+// The most different series (metric names and label sets) that can be kept
+#define METRICS_MAX_SERIES		256
+#define METRICS_MAX_NAME		64
+#define METRICS_MAX_LABELS		64
+#define METRICS_MAX_HELP		128
+
+// Histogram buckets, up to 10 seconds, plus one for anything longer
+#define METRICS_HISTOGRAM_BUCKETS	14
+#define METRICS_MAX_VALUES		(METRICS_HISTOGRAM_BUCKETS + 2)
+
+struct MetricsSeries;
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    MetricsRegistry
+//		Purpose: Keeps the values of all metrics in memory which is
+//			 shared with any child processes forked after it's
+//			 created, so that their updates are added to the
+//			 totals which the parent process reports. Series can
+//			 be added by any process, at any time, and are
+//			 identified by their name and labels.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class MetricsRegistry
+{
+public:
+	enum Type
+	{
+		Type_Counter = 1,
+		Type_Gauge,
+		Type_Histogram
+	};
+
+	static MetricsRegistry &GetInstance();
+	int64_t *GetValues(Type SeriesType, const std::string &rName,
+		const std::string &rLabels, const std::string &rHelp);
+	std::string GetPrometheusText() const;
+	bool IsShared() const { return mShared; }
+
+private:
+	MetricsRegistry();
+	~MetricsRegistry();
+	MetricsRegistry(const MetricsRegistry &rToCopy); /* forbidden */
+
+	MetricsSeries *mpSeries;
+	bool mShared;
+	bool mWarnedFull;
+	int64_t mDiscardedValues[METRICS_MAX_VALUES];
+};
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    MetricsCounter
+//		Purpose: A value which only ever goes up, such as the number
+//			 of bytes received
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class MetricsCounter
+{
+public:
+	MetricsCounter(const std::string &rName, const std::string &rHelp,
+		const std::string &rLabels = "");
+	void Increment(int64_t Amount = 1);
+	int64_t GetValue() const { return mpValues[0]; }
+
+private:
+	int64_t *mpValues;
+};
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    MetricsGauge
+//		Purpose: A value which can go up and down, such as the number
+//			 of open connections
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class MetricsGauge
+{
+public:
+	MetricsGauge(const std::string &rName, const std::string &rHelp,
+		const std::string &rLabels = "");
+	void Add(int64_t Amount);
+	void Set(int64_t Value) { mpValues[0] = Value; }
+	int64_t GetValue() const { return mpValues[0]; }
+
+private:
+	int64_t *mpValues;
+};
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    MetricsHistogram
+//		Purpose: Counts how many times something took how long, in
+//			 fixed buckets from 1 millisecond to 10 seconds
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class MetricsHistogram
+{
+public:
+	MetricsHistogram(const std::string &rName, const std::string &rHelp,
+		const std::string &rLabels = "");
+	void Record(box_time_t Duration);
+	int64_t GetCount() const;
+
+	// Records the time until it goes out of scope
+	class Timer
+	{
+	public:
+		Timer(MetricsHistogram &rHistogram)
+		: mrHistogram(rHistogram),
+		  mStart(GetCurrentBoxTime())
+		{ }
+		~Timer()
+		{
+			mrHistogram.Record(GetCurrentBoxTime() - mStart);
+		}
+	private:
+		MetricsHistogram &mrHistogram;
+		box_time_t mStart;
+	};
+
+private:
+	int64_t *mpValues;
+};
+
+#endif // METRICS__H
@@ -31,6 +31,25 @@ PartialReadStream::PartialReadStream(IOStream &rSource,
 	ASSERT(BytesToRead > 0);
 }
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    PartialReadStream::PartialReadStream(
+//			 std::auto_ptr<IOStream>, pos_type)
+//		Purpose: Constructor, taking ownership of another stream,
+//			 which is deleted with this one.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+PartialReadStream::PartialReadStream(std::auto_ptr<IOStream> apSource,
+	pos_type BytesToRead)
+	: mapOwnedSource(apSource),
+	  mrSource(*mapOwnedSource),
+	  mBytesLeft(BytesToRead)
+{
+	ASSERT(BytesToRead > 0);
+}
+
 // --------------------------------------------------------------------------
 //
 // Function
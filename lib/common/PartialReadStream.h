@@ -10,6 +10,8 @@
 #ifndef PARTIALREADSTREAM__H
 #define PARTIALREADSTREAM__H
 
+#include <memory>
+
 #include "IOStream.h"
 
 // --------------------------------------------------------------------------
@@ -24,6 +26,8 @@ class PartialReadStream : public IOStream
 {
 public:
 	PartialReadStream(IOStream &rSource, pos_type BytesToRead);
+	PartialReadStream(std::auto_ptr<IOStream> apSource,
+		pos_type BytesToRead);
 	~PartialReadStream();
 private:
 	// no copying allowed
@@ -39,6 +43,7 @@ public:
 	virtual bool StreamClosed();
 
 private:
+	std::auto_ptr<IOStream> mapOwnedSource;
 	IOStream &mrSource;
 	pos_type mBytesLeft;
 };
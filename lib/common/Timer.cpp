@@ -18,8 +18,16 @@
 #	endif
 #endif
 
-#include <signal.h>
+#ifdef HAVE_UNISTD_H
+	#include <unistd.h>
+#endif
+
+#ifdef HAVE_SYS_TIMERFD_H
+	#include <sys/timerfd.h>
+#endif
+
 #include <cstring>
+#include <errno.h>
 
 #include "Timer.h"
 #include "Logging.h"
@@ -27,48 +35,34 @@
 #include "MemLeakFindOn.h"
 
 std::vector<Timer*>* Timers::spTimers = NULL;
-bool Timers::sRescheduleNeeded = false;
+box_time_t Timers::sArmedExpiry = 0;
+int Timers::sTimerFd = -1;
+int Timers::sTimerFdPid = 0;
+int Timers::sTimerFdGeneration = 0;
 
 #define TIMER_ID "timer " << mName << " (" << this << ") "
 #define TIMER_ID_OF(t) "timer " << (t).GetName() << " (" << &(t) << ")"
 
-typedef void (*sighandler_t)(int);
-
 // --------------------------------------------------------------------------
 //
 // Function
 //		Name:    static void Timers::Init()
-//		Purpose: Initialise timers, prepare signal handler
+//		Purpose: Initialise timers
 //		Created: 5/11/2006
 //
 // --------------------------------------------------------------------------
 void Timers::Init()
 {
 	ASSERT(!spTimers);
-	
-	#if defined WIN32 && ! defined PLATFORM_CYGWIN
-		// no init needed
-	#else
-		struct sigaction newact, oldact;
-		newact.sa_handler = Timers::SignalHandler;
-		newact.sa_flags = SA_RESTART;
-		sigemptyset(&newact.sa_mask);
-		if (::sigaction(SIGALRM, &newact, &oldact) != 0)
-		{
-			THROW_SYS_ERROR("Failed to install signal handler",
-				CommonException, Internal);
-		}
-		ASSERT(oldact.sa_handler == 0);
-	#endif // WIN32 && !PLATFORM_CYGWIN
-	
 	spTimers = new std::vector<Timer*>;
+	sArmedExpiry = 0;
 }
 
 // --------------------------------------------------------------------------
 //
 // Function
 //		Name:    static void Timers::Cleanup()
-//		Purpose: Clean up timers, stop signal handler
+//		Purpose: Clean up timers, and close the timerfd if any
 //		Created: 6/11/2006
 //
 // --------------------------------------------------------------------------
@@ -90,36 +84,101 @@ void Timers::Cleanup(bool throw_exception_if_not_initialised)
 			return;
 		}
 	}
-	
-	#if defined WIN32 && ! defined PLATFORM_CYGWIN
-		// no cleanup needed
-	#else
-		struct itimerval timeout;
-		memset(&timeout, 0, sizeof(timeout));
 
-		if(::setitimer(ITIMER_REAL, &timeout, NULL) != 0)
-		{
-			THROW_SYS_ERROR("Failed to set interval timer",
-				CommonException, Internal);
-		}
+	// Any timers still running will never fire now
+	for (std::vector<Timer*>::iterator i = spTimers->begin();
+		i != spTimers->end(); i++)
+	{
+		(*i)->mHeapIndex = -1;
+	}
 
-		struct sigaction newact, oldact;
-		newact.sa_handler = SIG_DFL;
-		newact.sa_flags = SA_RESTART;
-		sigemptyset(&(newact.sa_mask));
-		if (::sigaction(SIGALRM, &newact, &oldact) != 0)
-		{
-			THROW_SYS_ERROR("Failed to remove signal handler",
-				CommonException, Internal);
-		}
-		ASSERT(oldact.sa_handler == Timers::SignalHandler);
-	#endif // WIN32 && !PLATFORM_CYGWIN
+	if (sTimerFd != -1)
+	{
+		::close(sTimerFd);
+		sTimerFd = -1;
+	}
 
 	spTimers->clear();
 	delete spTimers;
 	spTimers = NULL;
 }
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    static void Timers::Place(Timer*, size_t)
+//		Purpose: Private. Puts a timer at a position in the heap,
+//			 and tells it where it is.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void Timers::Place(Timer* pTimer, size_t Index)
+{
+	(*spTimers)[Index] = pTimer;
+	pTimer->mHeapIndex = Index;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    static void Timers::SiftUp(size_t)
+//		Purpose: Private. Moves the timer at Index towards the top
+//			 of the heap until its parent expires before it.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void Timers::SiftUp(size_t Index)
+{
+	Timer* pTimer = (*spTimers)[Index];
+	while (Index > 0)
+	{
+		size_t parent = (Index - 1) / 2;
+		if ((*spTimers)[parent]->mExpires <= pTimer->mExpires)
+		{
+			break;
+		}
+		Place((*spTimers)[parent], Index);
+		Index = parent;
+	}
+	Place(pTimer, Index);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    static void Timers::SiftDown(size_t)
+//		Purpose: Private. Moves the timer at Index away from the
+//			 top of the heap until both its children expire
+//			 after it.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void Timers::SiftDown(size_t Index)
+{
+	Timer* pTimer = (*spTimers)[Index];
+	size_t size = spTimers->size();
+	while (true)
+	{
+		size_t child = (Index * 2) + 1;
+		if (child >= size)
+		{
+			break;
+		}
+		if (child + 1 < size && (*spTimers)[child + 1]->mExpires <
+			(*spTimers)[child]->mExpires)
+		{
+			child++;
+		}
+		if (pTimer->mExpires <= (*spTimers)[child]->mExpires)
+		{
+			break;
+		}
+		Place((*spTimers)[child], Index);
+		Index = child;
+	}
+	Place(pTimer, Index);
+}
+
 // --------------------------------------------------------------------------
 //
 // Function
@@ -131,8 +190,10 @@ void Timers::Cleanup(bool throw_exception_if_not_initialised)
 void Timers::Add(Timer& rTimer)
 {
 	ASSERT(spTimers);
-	BOX_TRACE(TIMER_ID_OF(rTimer) " added to global queue, rescheduling");
+	ASSERT(rTimer.mHeapIndex == -1);
+	BOX_TRACE(TIMER_ID_OF(rTimer) " added to global queue");
 	spTimers->push_back(&rTimer);
+	SiftUp(spTimers->size() - 1);
 	Reschedule();
 }
 
@@ -154,51 +215,42 @@ void Timers::Remove(Timer& rTimer)
 		return;
 	}
 
-	ASSERT(spTimers);
-	BOX_TRACE(TIMER_ID_OF(rTimer) " removed from global queue, rescheduling");
-
-	bool restart = true;
-	while (restart)
+	if (rTimer.mHeapIndex == -1)
 	{
-		restart = false;
-
-		for (std::vector<Timer*>::iterator i = spTimers->begin();
-			i != spTimers->end(); i++)
-		{
-			if (&rTimer == *i)
-			{
-				spTimers->erase(i);
-				restart = true;
-				break;
-			}
-		}
+		// Already fired, or never added
+		return;
 	}
 
-	Reschedule();
-}
+	BOX_TRACE(TIMER_ID_OF(rTimer) " removed from global queue");
 
-void Timers::RequestReschedule()
-{
-	sRescheduleNeeded = true;
-}
+	size_t index = rTimer.mHeapIndex;
+	ASSERT(index < spTimers->size() && (*spTimers)[index] == &rTimer);
+	rTimer.mHeapIndex = -1;
 
-void Timers::RescheduleIfNeeded()
-{
-	if (sRescheduleNeeded) 
+	// Fill the gap with the last timer, and move that wherever it
+	// needs to go
+	Timer* pLast = spTimers->back();
+	spTimers->pop_back();
+	if (pLast != &rTimer)
 	{
-		Reschedule();
+		Place(pLast, index);
+		SiftUp(index);
+		SiftDown(pLast->mHeapIndex);
 	}
+
+	Reschedule();
 }
 
 // --------------------------------------------------------------------------
 //
 // Function
-//		Name:    static void Timers::Reschedule()
-//		Purpose: Recalculate when the next wakeup is due
-//		Created: 5/11/2006
+//		Name:    static void Timers::RunExpired()
+//		Purpose: Fire all the timers which have expired, in the
+//			 order that they expired.
+//		Created: 2026/10/19
 //
 // --------------------------------------------------------------------------
-void Timers::Reschedule()
+void Timers::RunExpired()
 {
 	ASSERT(spTimers);
 	if (spTimers == NULL)
@@ -206,121 +258,187 @@ void Timers::Reschedule()
 		THROW_EXCEPTION(CommonException, TimersNotInitialised);
 	}
 
-	#ifndef WIN32
-		struct sigaction oldact;
-		if (::sigaction(SIGALRM, NULL, &oldact) != 0)
-		{
-			THROW_SYS_ERROR("Failed to check signal handler",
-				CommonException, Internal);
-		}
+	if (spTimers->empty())
+	{
+		return;
+	}
 
-		ASSERT(oldact.sa_handler == Timers::SignalHandler);
+	box_time_t timeNow = GetCurrentMonotonicTime();
+	bool fired = false;
 
-		if (oldact.sa_handler != Timers::SignalHandler)
+	while (!spTimers->empty() && spTimers->front()->mExpires <= timeNow)
+	{
+		Timer& rTimer = *(spTimers->front());
+		BOX_TRACE(TIMER_ID_OF(rTimer) " has expired, triggering " <<
+			BOX_FORMAT_MICROSECONDS(timeNow - rTimer.mExpires) <<
+			" late");
+
+		// Take it off the heap first, as OnExpire() might add it
+		// back again.
+		rTimer.mHeapIndex = -1;
+		Timer* pLast = spTimers->back();
+		spTimers->pop_back();
+		if (pLast != &rTimer)
 		{
-			THROW_EXCEPTION_MESSAGE(CommonException, Internal,
-				"Signal handler was " << (void *)oldact.sa_handler <<
-				", expected " << (void *)Timers::SignalHandler);
+			Place(pLast, 0);
+			SiftDown(0);
 		}
-	#endif
 
-	// Clear the reschedule-needed flag to false before we start.
-	// If a timer event occurs while we are scheduling, then we
-	// may or may not need to reschedule again, but this way
-	// we will do it anyway.
-	sRescheduleNeeded = false;
+		rTimer.OnExpire();
+		fired = true;
+	}
 
-#ifdef WIN32
-	// win32 timers need no management
-#else
-	box_time_t timeNow = GetCurrentBoxTime();
-	int64_t timeToNextEvent;
-	std::string nameOfNextEvent;
-
-	// scan for, trigger and remove expired timers. Removal requires
-	// us to restart the scan each time, due to std::vector semantics.
-	bool restart = true;
-	while (restart)
-	{
-		restart = false;
-		timeToNextEvent = 0;
-
-		for (std::vector<Timer*>::iterator i = spTimers->begin();
-			i != spTimers->end(); i++)
-		{
-			Timer& rTimer = **i;
-			int64_t timeToExpiry = rTimer.GetExpiryTime() - timeNow;
-		
-			if (timeToExpiry <= 0)
-			{
-				BOX_TRACE(TIMER_ID_OF(**i) " has expired, "
-					"triggering " <<
-					BOX_FORMAT_MICROSECONDS(-timeToExpiry) <<
-					" late");
-				rTimer.OnExpire();
-				spTimers->erase(i);
-				restart = true;
-				break;
-			}
-			else
-			{
-				/*
-				BOX_TRACE(TIMER_ID_OF(**i) " has not expired, "
-					"triggering in " <<
-					FORMAT_MICROSECONDS(timeToExpiry) <<
-					" seconds");
-				*/
-			}
-
-			if (timeToNextEvent == 0 || timeToNextEvent > timeToExpiry)
-			{
-				timeToNextEvent = timeToExpiry;
-				nameOfNextEvent = rTimer.GetName();
-			}
-		}
+	if (fired)
+	{
+		// Even if the next timer is unchanged, rearming clears
+		// the timerfd's readiness.
+		Reschedule(true);
 	}
+}
 
-	if (timeToNextEvent == 0)
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    static int64_t Timers::GetTimeToNextExpiry()
+//		Purpose: Returns how long until the next timer expires, zero
+//			 if one already has, or -1 if no timers are running.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int64_t Timers::GetTimeToNextExpiry()
+{
+	if (spTimers == NULL || spTimers->empty())
 	{
-		BOX_TRACE("timer: no more events, going to sleep.");
+		return -1;
 	}
-	else
+
+	int64_t timeToExpiry = spTimers->front()->mExpires -
+		GetCurrentMonotonicTime();
+	return (timeToExpiry < 0) ? 0 : timeToExpiry;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    static int Timers::GetFileDescriptor()
+//		Purpose: Returns a file descriptor which becomes readable
+//			 when the next timer expires, for WaitForEvent to
+//			 wait on, or -1 if the platform doesn't have timerfd.
+//			 Call OnFileDescriptorReady() when it's readable.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int Timers::GetFileDescriptor()
+{
+	if (spTimers == NULL)
 	{
-		BOX_TRACE("timer: next event: " << nameOfNextEvent << " at " <<
-			FormatTime(timeNow + timeToNextEvent, false, true));
+		return -1;
 	}
 
-	struct itimerval timeout;
-	memset(&timeout, 0, sizeof(timeout));
-	
-	timeout.it_value.tv_sec  = BoxTimeToSeconds(timeToNextEvent);
-	timeout.it_value.tv_usec = (int)
-		(BoxTimeToMicroSeconds(timeToNextEvent)
-		% MICRO_SEC_IN_SEC);
+	// Make sure that it exists, and belongs to this process
+	Reschedule();
+	return sTimerFd;
+}
 
-	if(::setitimer(ITIMER_REAL, &timeout, NULL) != 0)
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    static void Timers::OnFileDescriptorReady()
+//		Purpose: Called when the file descriptor returned by
+//			 GetFileDescriptor() is readable. Fires the expired
+//			 timers.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void Timers::OnFileDescriptorReady()
+{
+#ifdef HAVE_SYS_TIMERFD_H
+	if (sTimerFd != -1)
 	{
-		THROW_SYS_ERROR("Failed to initialise system timer",
-			CommonException, Internal);
+		uint64_t expirations;
+		if (::read(sTimerFd, &expirations, sizeof(expirations)) == -1 &&
+			errno != EAGAIN && errno != EINTR)
+		{
+			BOX_LOG_SYS_WARNING("Failed to read from timerfd");
+		}
 	}
 #endif
+
+	RunExpired();
 }
 
 // --------------------------------------------------------------------------
 //
 // Function
-//		Name:    static void Timers::SignalHandler(unused)
-//		Purpose: Called as signal handler. Nothing is safe in a signal
-//			 handler, not even traversing the list of timers, so
-//			 just request a reschedule in future, which will do
-//			 that for us, and trigger any expired timers at that
-//			 time.
+//		Name:    static void Timers::Reschedule(bool)
+//		Purpose: Private. Arm the timerfd, if any, for when the
+//			 next timer is due, unless it's already armed for
+//			 that time and Force is false.
 //		Created: 5/11/2006
 //
 // --------------------------------------------------------------------------
-void Timers::SignalHandler(int unused)
+void Timers::Reschedule(bool Force)
 {
-	Timers::RequestReschedule();
+	ASSERT(spTimers);
+	if (spTimers == NULL)
+	{
+		THROW_EXCEPTION(CommonException, TimersNotInitialised);
+	}
+
+#ifdef HAVE_SYS_TIMERFD_H
+	// A child process shares its parent's timerfd, so it must not
+	// touch it, but make one of its own.
+	if (sTimerFd != -1 && sTimerFdPid != (int)::getpid())
+	{
+		::close(sTimerFd);
+		sTimerFd = -1;
+	}
+
+	if (sTimerFd == -1)
+	{
+		sTimerFd = ::timerfd_create(CLOCK_MONOTONIC,
+			TFD_NONBLOCK | TFD_CLOEXEC);
+		if (sTimerFd == -1)
+		{
+			THROW_SYS_ERROR("Failed to create timerfd",
+				CommonException, Internal);
+		}
+		sTimerFdPid = ::getpid();
+		sTimerFdGeneration++;
+		sArmedExpiry = 0;
+		Force = true;
+	}
+
+	box_time_t nextExpiry = spTimers->empty() ? 0 :
+		spTimers->front()->mExpires;
+	if (!Force && nextExpiry == sArmedExpiry)
+	{
+		return;
+	}
+
+	// An all-zero it_value disarms the timer, which is what we want
+	// if there are no timers, but not otherwise.
+	struct itimerspec timeout;
+	memset(&timeout, 0, sizeof(timeout));
+	if (nextExpiry != 0)
+	{
+		timeout.it_value.tv_sec = BoxTimeToSeconds(nextExpiry);
+		timeout.it_value.tv_nsec = (nextExpiry % MICRO_SEC_IN_SEC_LL) *
+			NANO_SEC_IN_USEC;
+		if (timeout.it_value.tv_sec == 0 &&
+			timeout.it_value.tv_nsec == 0)
+		{
+			timeout.it_value.tv_nsec = 1;
+		}
+	}
+
+	if (::timerfd_settime(sTimerFd, TFD_TIMER_ABSTIME, &timeout, NULL) != 0)
+	{
+		THROW_SYS_ERROR("Failed to arm timerfd", CommonException,
+			Internal);
+	}
+	sArmedExpiry = nextExpiry;
+#endif
 }
 
 // --------------------------------------------------------------------------
@@ -338,7 +456,8 @@ void Timers::SignalHandler(int unused)
 Timer::Timer(size_t timeoutMillis, const std::string& rName)
 : mExpires(0),
   mExpired(false),
-  mName(rName)
+  mName(rName),
+  mHeapIndex(-1)
 #ifdef WIN32
 , mTimerHandle(INVALID_HANDLE_VALUE)
 #endif
@@ -359,7 +478,7 @@ Timer::Timer(size_t timeoutMillis, const std::string& rName)
 
 void Timer::Start()
 {
-	box_time_t timeNow = GetCurrentBoxTime();
+	box_time_t timeNow = GetCurrentMonotonicTime();
 	int64_t timeToExpiry = mExpires - timeNow;
 
 	if (timeToExpiry <= 0)
@@ -479,8 +598,9 @@ void Timer::LogAssignment(const Timer &From)
 	}
 	else
 	{
-		BOX_TRACE(TIMER_ID "will fire at " <<
-			FormatTime(From.mExpires, false, true));
+		BOX_TRACE(TIMER_ID "will fire in " <<
+			BOX_FORMAT_MICROSECONDS(From.mExpires -
+				GetCurrentMonotonicTime()));
 	}
 	#endif
 }
@@ -499,7 +619,8 @@ void Timer::LogAssignment(const Timer &From)
 Timer::Timer(const Timer& rToCopy)
 : mExpires(rToCopy.mExpires),
   mExpired(rToCopy.mExpired),
-  mName(rToCopy.mName)
+  mName(rToCopy.mName),
+  mHeapIndex(-1)
 #ifdef WIN32
 , mTimerHandle(INVALID_HANDLE_VALUE)
 #endif
@@ -579,7 +700,7 @@ void Timer::Set(size_t timeoutMillis, bool isInit)
 	}
 	else
 	{
-		mExpires = GetCurrentBoxTime() + 
+		mExpires = GetCurrentMonotonicTime() + 
 			MilliSecondsToBoxTime(timeoutMillis);
 	}
 
@@ -592,8 +713,7 @@ void Timer::Set(size_t timeoutMillis, bool isInit)
 	else
 	{
 		BOX_TRACE(TIMER_ID << (isInit ? "initialised" : "reset") <<
-			" for " << timeoutMillis << " ms, to fire at " <<
-			FormatTime(mExpires, false, true));
+			" for " << timeoutMillis << " ms");
 	}
 	#endif
 
@@ -607,8 +727,8 @@ void Timer::Set(size_t timeoutMillis, bool isInit)
 //
 // Function
 //		Name:    Timer::OnExpire()
-//		Purpose: Method called by Timers::Reschedule (on Unixes)
-//			 on next poll after timer expires, or from
+//		Purpose: Method called by Timers::RunExpired (on Unixes)
+//			 on next check after timer expires, or from
 //			 Timer::TimerRoutine (on Windows) from a separate
 //			 thread managed by the OS. Marks the timer as
 //			 expired for future reference.
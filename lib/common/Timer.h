@@ -27,8 +27,18 @@ class Timer;
 //
 // Class
 //		Name:    Timers
-//		Purpose: Static class to manage all timers and arrange 
-//			 efficient delivery of wakeup signals
+//		Purpose: Static class to manage all timers. Keeps them in a
+//			 min-heap ordered by expiry time on the monotonic
+//			 clock, so that adding and removing a timer is
+//			 O(log n). Expired timers are fired when something
+//			 asks whether a timer has expired, or by WaitForEvent
+//			 when it wakes up, so no signals are used. Where
+//			 timerfd is available, it's kept armed for the next
+//			 timer to expire, so that WaitForEvent can wait on it.
+//			 The heap and the timerfd aren't locked, so timers
+//			 must only be used from one thread in each process,
+//			 like everything else in Box Backup, which forks
+//			 instead.
 //		Created: 19/3/04
 //
 // --------------------------------------------------------------------------
@@ -36,18 +46,29 @@ class Timers
 {
 	private:
 	static std::vector<Timer*>* spTimers;
-	static void Reschedule();
+	static void Reschedule(bool Force = false);
+	static void SiftUp(size_t Index);
+	static void SiftDown(size_t Index);
+	static void Place(Timer* pTimer, size_t Index);
 
-	static bool sRescheduleNeeded;
-	static void SignalHandler(int iUnused);
+	static box_time_t sArmedExpiry;
+	static int sTimerFd;
+	static int sTimerFdPid;
+	static int sTimerFdGeneration;
 
 	public:
 	static void Init();
 	static void Cleanup(bool throw_exception_if_not_initialised = true);
 	static void Add   (Timer& rTimer);
 	static void Remove(Timer& rTimer);
-	static void RequestReschedule();
-	static void RescheduleIfNeeded();
+	static bool IsInitialised() { return spTimers != NULL; }
+	static void RunExpired();
+	static int64_t GetTimeToNextExpiry();
+	static int GetFileDescriptor();
+	// Changes whenever the file descriptor is replaced, even by one
+	// with the same number
+	static int GetFileDescriptorGeneration() { return sTimerFdGeneration; }
+	static void OnFileDescriptorReady();
 };
 
 class Timer
@@ -58,11 +79,15 @@ public:
 	Timer(const Timer &);
 	Timer &operator=(const Timer &);
 
+	// On the monotonic clock, see GetCurrentMonotonicTime()
 	box_time_t   GetExpiryTime() { return mExpires; }
 	virtual void OnExpire();
 	bool         HasExpired()
 	{
-		Timers::RescheduleIfNeeded();
+		if(!mExpired && Timers::IsInitialised())
+		{
+			Timers::RunExpired();
+		}
 		return mExpired; 
 	}
 
@@ -74,6 +99,10 @@ private:
 	bool        mExpired;
 	std::string mName;
 
+	// Where this timer is in the heap, or -1 if it's not in it
+	friend class Timers;
+	int64_t     mHeapIndex;
+
 	void Start();
 	void Start(int64_t timeoutMillis);
 	void Stop();
@@ -16,10 +16,17 @@
 #include <errno.h>
 #include <string.h>
 
+#include "Logging.h"
+#include "Timer.h"
 #include "WaitForEvent.h"
 
 #include "MemLeakFindOn.h"
 
+#ifdef WAITFOREVENT_USE_EPOLL
+	// How many events to fetch from the kernel at once
+	#define WAITFOREVENT_MAX_EVENTS	64
+#endif
+
 // --------------------------------------------------------------------------
 //
 // Function
@@ -41,6 +48,19 @@ WaitForEvent::WaitForEvent(int Timeout)
 	// Set the choosen timeout
 	SetTimeout(Timeout);
 }
+#elif defined WAITFOREVENT_USE_EPOLL
+WaitForEvent::WaitForEvent(int Timeout)
+	: mTimeout(Timeout),
+	  mEpoll(-1),
+	  mEpollPid(0),
+	  mTimerFd(-1),
+	  mTimerFdGeneration(0),
+	  mEvents(WAITFOREVENT_MAX_EVENTS),
+	  mNextEvent(0),
+	  mNumEvents(0)
+{
+	OpenEpoll();
+}
 #else
 WaitForEvent::WaitForEvent(int Timeout)
 	: mTimeout(Timeout),
@@ -62,6 +82,9 @@ WaitForEvent::~WaitForEvent()
 #ifdef HAVE_KQUEUE
 	::close(mKQueue);
 	mKQueue = -1;
+#elif defined WAITFOREVENT_USE_EPOLL
+	::close(mEpoll);
+	mEpoll = -1;
 #else
 	if(mpPollInfo != 0)
 	{
@@ -104,6 +127,9 @@ void WaitForEvent::SetTimeout(int Timeout)
 //		Purpose: Wait for an event to take place. Returns a pointer to the object
 //				 which has been signalled, or returns 0 for the timeout condition.
 //				 Timeout specified in milliseconds.
+//
+//				 Also wakes up when the next Timer expires, fires it,
+//				 and returns 0 as if the wait had timed out.
 //		Created: 9/3/04
 //
 // --------------------------------------------------------------------------
@@ -113,35 +139,102 @@ void *WaitForEvent::Wait()
 	// Event return structure
 	struct kevent e;
 	::memset(&e, 0, sizeof(e));
+
+	// Don't sleep past the next timer
+	struct timespec timerTimeout;
+	struct timespec *pTimeout = mpTimeout;
+	int64_t timeToTimer = Timers::GetTimeToNextExpiry();
+	if(timeToTimer >= 0 && (pTimeout == NULL ||
+		timeToTimer < (pTimeout->tv_sec * MICRO_SEC_IN_SEC_LL) +
+			(pTimeout->tv_nsec / NANO_SEC_IN_USEC)))
+	{
+		timerTimeout.tv_sec = timeToTimer / MICRO_SEC_IN_SEC_LL;
+		timerTimeout.tv_nsec = (timeToTimer % MICRO_SEC_IN_SEC_LL) *
+			NANO_SEC_IN_USEC;
+		pTimeout = &timerTimeout;
+	}
 	
-	switch(::kevent(mKQueue, NULL, 0, &e, 1, mpTimeout))
+	int result = ::kevent(mKQueue, NULL, 0, &e, 1, pTimeout);
+	if(result == -1 && errno != EINTR)
 	{
-	case 0:
-		// Timeout
-		return 0;
-		break;
+		THROW_EXCEPTION(CommonException, KEventErrorWait)
+	}
 
+	if(Timers::IsInitialised())
+	{
+		Timers::RunExpired();
+	}
+
+	switch(result)
+	{
 	case 1:
 		// Event happened!
 		return e.udata;
 		break;
 		
 	default:
-		// Interrupted system calls aren't an error, just equivalent to a timeout
-		if(errno != EINTR)
-		{
-			THROW_EXCEPTION(CommonException, KEventErrorWait)
-		}
+		// Timeout, or interrupted system call, which isn't an error
 		return 0;
 		break;
 	}
+#elif defined WAITFOREVENT_USE_EPOLL
+	// A forked child needs its own epoll instance
+	OpenEpoll();
+
+	bool waited = false;
+	while(true)
+	{
+		// Return the events left over from the last epoll_wait()
+		// first, one at a time
+		while(mNextEvent < mNumEvents)
+		{
+			void *pItem = mEvents[mNextEvent++].data.ptr;
+			if(pItem == &mTimerFd)
+			{
+				Timers::OnFileDescriptorReady();
+			}
+			else if(pItem != NULL)
+			{
+				return pItem;
+			}
+		}
+
+		if(waited)
+		{
+			// Timed out, interrupted (which isn't an error),
+			// or only a timer expired
+			return 0;
+		}
+
+		int timeout = RegisterTimers();
+		mNextEvent = 0;
+		mNumEvents = 0;
+		int result = ::epoll_wait(mEpoll, &mEvents[0], mEvents.size(),
+			timeout);
+		waited = true;
+		if(result == -1)
+		{
+			if(errno != EINTR)
+			{
+				THROW_SYS_ERROR("Failed to wait for events",
+					CommonException, KEventErrorWait);
+			}
+			result = 0;
+		}
+		mNumEvents = result;
+
+		if(mTimerFd == -1 && Timers::IsInitialised())
+		{
+			Timers::RunExpired();
+		}
+	}
 #else
 	// Use poll() instead.
 	// Need to build the structures?
 	if(mpPollInfo == 0)
 	{
-		// Yes...
-		mpPollInfo = (struct pollfd *)::malloc((sizeof(struct pollfd) * mItems.size()) + 4);
+		// Yes... with space for the timers' file descriptor at the end
+		mpPollInfo = (struct pollfd *)::malloc((sizeof(struct pollfd) * (mItems.size() + 1)) + 4);
 		if(mpPollInfo == 0)
 		{
 			throw std::bad_alloc();
@@ -161,30 +254,63 @@ void *WaitForEvent::Wait()
 	{
 		mpPollInfo[l].revents = 0;
 	}
-	
-	// Poll!
-	switch(::poll(mpPollInfo, mItems.size(), mTimeout))
+
+	// Wake up when the next timer expires, by waiting on the timers'
+	// file descriptor if they have one, or by not sleeping past it.
+	int timeout = mTimeout;
+	unsigned int numFds = mItems.size();
+	int timerFd = Timers::GetFileDescriptor();
+	if(timerFd != -1)
+	{
+		mpPollInfo[numFds].fd = timerFd;
+		mpPollInfo[numFds].events = POLLIN;
+		mpPollInfo[numFds].revents = 0;
+		numFds++;
+	}
+	else
 	{
-	case -1:
-		// Interrupted system calls aren't an error, just equivalent to a timeout
-		if(errno != EINTR)
+		int64_t timeToTimer = Timers::GetTimeToNextExpiry();
+		if(timeToTimer >= 0)
 		{
-			THROW_EXCEPTION(CommonException, KEventErrorWait)
+			// Round up, so as not to wake up just before it
+			int64_t timerMillis = (timeToTimer +
+				MICRO_SEC_IN_MILLI_SEC - 1) / MICRO_SEC_IN_MILLI_SEC;
+			if(timeout == TimeoutInfinite || timerMillis < timeout)
+			{
+				timeout = (int)timerMillis;
+			}
 		}
+	}
+	
+	// Poll!
+	int result = ::poll(mpPollInfo, numFds, timeout);
+	if(result == -1 && errno != EINTR)
+	{
+		THROW_EXCEPTION(CommonException, KEventErrorWait)
+	}
+
+	if(timerFd != -1 && (mpPollInfo[numFds - 1].revents & POLLIN))
+	{
+		Timers::OnFileDescriptorReady();
+		result--;
+	}
+	else if(Timers::IsInitialised())
+	{
+		Timers::RunExpired();
+	}
+
+	if(result <= 0)
+	{
+		// Timed out, interrupted (which isn't an error), or only
+		// a timer expired
 		return 0;
-		break;
-	case 0:	// timed out
-		return 0;
-		break;
-	default:	// got some thing...
-		// control flows on...
-		break;
 	}
 	
 	// Find the item which was ready
 	for(unsigned int s = 0; s < mItems.size(); ++s)
 	{
-		if(mpPollInfo[s].revents & POLLIN)
+		if(mpPollInfo[s].revents &
+			(mItems[s].events | POLLHUP | POLLERR))
 		{
 			return mItems[s].item;
 			break;
@@ -195,3 +321,182 @@ void *WaitForEvent::Wait()
 	return 0;
 }
 
+
+#ifdef WAITFOREVENT_USE_EPOLL
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    WaitForEvent::OpenEpoll()
+//		Purpose: Private. Creates the epoll instance, or replaces it
+//			 in a forked child, which shares its parent's and
+//			 mustn't change the registrations on it, with one
+//			 of its own which has the same items registered.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void WaitForEvent::OpenEpoll()
+{
+	if(mEpoll != -1 && mEpollPid == (int)::getpid())
+	{
+		return;
+	}
+
+	if(mEpoll != -1)
+	{
+		::close(mEpoll);
+	}
+
+	mEpoll = ::epoll_create1(EPOLL_CLOEXEC);
+	if(mEpoll == -1)
+	{
+		THROW_SYS_ERROR("Failed to create epoll instance",
+			CommonException, CouldNotCreateKQueue);
+	}
+	mEpollPid = ::getpid();
+	mTimerFd = -1;
+	mNextEvent = 0;
+	mNumEvents = 0;
+
+	for(std::map<void *, ItemInfo>::const_iterator i = mItems.begin();
+		i != mItems.end(); i++)
+	{
+		Register(i->second);
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    WaitForEvent::Register(const ItemInfo &)
+//		Purpose: Private. Adds an item's file descriptor to the
+//			 epoll instance.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void WaitForEvent::Register(const ItemInfo &rInfo)
+{
+	struct epoll_event e;
+	::memset(&e, 0, sizeof(e));
+	e.events = ((rInfo.events & POLLIN) ? EPOLLIN : 0) |
+		((rInfo.events & POLLOUT) ? EPOLLOUT : 0) |
+		(rInfo.edgeTriggered ? EPOLLET : 0);
+	e.data.ptr = rInfo.item;
+
+	if(::epoll_ctl(mEpoll, EPOLL_CTL_ADD, rInfo.fd, &e) == -1)
+	{
+		THROW_SYS_ERROR("Failed to add file descriptor " << rInfo.fd <<
+			" to epoll", CommonException, KEventErrorAdd);
+	}
+}
+
+void WaitForEvent::AddItem(const ItemInfo &rInfo)
+{
+	OpenEpoll();
+	Register(rInfo);
+	mItems[rInfo.item] = rInfo;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    WaitForEvent::RemoveItem(void *)
+//		Purpose: Private. Removes an item from the epoll instance,
+//			 and forgets any events for it which haven't been
+//			 returned yet.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void WaitForEvent::RemoveItem(void *pItem)
+{
+	std::map<void *, ItemInfo>::iterator i = mItems.find(pItem);
+	if(i == mItems.end())
+	{
+		return;
+	}
+	int fd = i->second.fd;
+	mItems.erase(i);
+
+	for(size_t e = mNextEvent; e < mNumEvents; e++)
+	{
+		if(mEvents[e].data.ptr == pItem)
+		{
+			mEvents[e].data.ptr = NULL;
+		}
+	}
+
+	if(mEpollPid != (int)::getpid())
+	{
+		// Still our parent's epoll instance. Ours will be made
+		// without this item when we next need it.
+		return;
+	}
+
+	// If the file descriptor has already been closed, the kernel
+	// has removed it for us
+	if(::epoll_ctl(mEpoll, EPOLL_CTL_DEL, fd, NULL) == -1 &&
+		errno != EBADF && errno != ENOENT)
+	{
+		THROW_SYS_ERROR("Failed to remove file descriptor " << fd <<
+			" from epoll", CommonException, KEventErrorRemove);
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    WaitForEvent::RegisterTimers()
+//		Purpose: Private. Makes sure that the timers' file
+//			 descriptor is registered, if they have one, so that
+//			 epoll_wait() returns when the next one expires.
+//			 Returns the timeout to use, which is shortened if
+//			 there's no such file descriptor to wait on instead.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int WaitForEvent::RegisterTimers()
+{
+	int timerFd = Timers::GetFileDescriptor();
+	if(timerFd == -1)
+	{
+		mTimerFd = -1;
+
+		int timeout = mTimeout;
+		int64_t timeToTimer = Timers::GetTimeToNextExpiry();
+		if(timeToTimer >= 0)
+		{
+			// Round up, so as not to wake up just before it
+			int64_t timerMillis = (timeToTimer +
+				MICRO_SEC_IN_MILLI_SEC - 1) / MICRO_SEC_IN_MILLI_SEC;
+			if(timeout == TimeoutInfinite || timerMillis < timeout)
+			{
+				timeout = (int)timerMillis;
+			}
+		}
+		return timeout;
+	}
+
+	if(timerFd == mTimerFd &&
+		Timers::GetFileDescriptorGeneration() == mTimerFdGeneration)
+	{
+		return mTimeout;
+	}
+
+	// A new file descriptor, possibly with the same number as the
+	// old one, which the kernel removed when it was closed. It's
+	// read until it would block by Timers::OnFileDescriptorReady().
+	struct epoll_event e;
+	::memset(&e, 0, sizeof(e));
+	e.events = EPOLLIN | EPOLLET;
+	e.data.ptr = &mTimerFd;
+	if(::epoll_ctl(mEpoll, EPOLL_CTL_ADD, timerFd, &e) == -1 &&
+		errno != EEXIST)
+	{
+		THROW_SYS_ERROR("Failed to add timer file descriptor to epoll",
+			CommonException, KEventErrorAdd);
+	}
+
+	mTimerFd = timerFd;
+	mTimerFdGeneration = Timers::GetFileDescriptorGeneration();
+	return mTimeout;
+}
+#endif // WAITFOREVENT_USE_EPOLL
@@ -15,6 +15,12 @@
 #ifdef HAVE_KQUEUE
 	#include <sys/event.h>
 	#include <sys/time.h>
+#elif defined HAVE_SYS_EPOLL_H && defined HAVE_EPOLL_CREATE1
+	#define WAITFOREVENT_USE_EPOLL
+	#include <map>
+	#include <vector>
+	#include <poll.h>
+	#include <sys/epoll.h>
 #else
 	#include <vector>
 	#ifndef WIN32
@@ -44,6 +50,18 @@ public:
 		TimeoutInfinite = -1
 	};
 
+	enum
+	{
+		// Wait() returns the item every time while it's ready,
+		// as poll() would.
+		LevelTriggered = 0,
+		// Wait() returns the item once each time it becomes ready,
+		// so the caller must read or write until it would block,
+		// or it won't hear about the item again. Only epoll and
+		// kqueue can do this; with poll() it's LevelTriggered.
+		EdgeTriggered = 1
+	};
+
 	void SetTimeout(int Timeout = TimeoutInfinite);
 
 	void *Wait();
@@ -54,19 +72,22 @@ public:
 		int fd;
 		short events;
 		void *item;
+		bool edgeTriggered;
 	} ItemInfo;
 #endif
 
 	// --------------------------------------------------------------------------
 	//
 	// Function
-	//		Name:    WaitForEvent::Add(const Type &, int)
+	//		Name:    WaitForEvent::Add(const Type &, int, int)
 	//		Purpose: Adds an event to the list of items to wait on. The flags are passed to the object.
+	//				 The item stays registered until it's removed, and must be
+	//				 removed before its file descriptor is closed.
 	//		Created: 9/3/04
 	//
 	// --------------------------------------------------------------------------
 	template<typename T>
-	void Add(const T *pItem, int Flags = 0)
+	void Add(const T *pItem, int Flags = 0, int Mode = LevelTriggered)
 	{
 		ASSERT(pItem != 0);
 #ifdef HAVE_KQUEUE
@@ -74,16 +95,27 @@ public:
 		pItem->FillInKEvent(e, Flags);
 		// Fill in extra flags to say what to do
 		e.flags |= EV_ADD;
+		if(Mode == EdgeTriggered)
+		{
+			e.flags |= EV_CLEAR;
+		}
 		e.udata = (void*)pItem;
 		if(::kevent(mKQueue, &e, 1, NULL, 0, NULL) == -1)
 		{
 			THROW_EXCEPTION(CommonException, KEventErrorAdd)
 		}
+#elif defined WAITFOREVENT_USE_EPOLL
+		ItemInfo i;
+		pItem->FillInPoll(i.fd, i.events, Flags);
+		i.item = (void*)pItem;
+		i.edgeTriggered = (Mode == EdgeTriggered);
+		AddItem(i);
 #else
 		// Add item
 		ItemInfo i;
 		pItem->FillInPoll(i.fd, i.events, Flags);
 		i.item = (void*)pItem;
+		i.edgeTriggered = false;
 		mItems.push_back(i);
 		// Delete any pre-prepared poll info, as it's now out of date
 		if(mpPollInfo != 0)
@@ -116,6 +148,8 @@ public:
 		{
 			THROW_EXCEPTION(CommonException, KEventErrorRemove)
 		}
+#elif defined WAITFOREVENT_USE_EPOLL
+		RemoveItem((void*)pItem);
 #else
 		if(mpPollInfo != 0)
 		{
@@ -138,6 +172,25 @@ private:
 	int mKQueue;
 	struct timespec mTimeout;
 	struct timespec *mpTimeout;
+#elif defined WAITFOREVENT_USE_EPOLL
+	void OpenEpoll();
+	void Register(const ItemInfo &rInfo);
+	void AddItem(const ItemInfo &rInfo);
+	void RemoveItem(void *pItem);
+	int RegisterTimers();
+
+	int mTimeout;
+	int mEpoll;
+	int mEpollPid;
+	int mTimerFd;
+	int mTimerFdGeneration;
+	// Everything registered, so that a forked child can register it
+	// all again with an epoll instance of its own
+	std::map<void *, ItemInfo> mItems;
+	// Events returned by epoll_wait() which Wait() hasn't returned yet
+	std::vector<struct epoll_event> mEvents;
+	size_t mNextEvent;
+	size_t mNumEvents;
 #else
 	int mTimeout;
 	std::vector<ItemInfo> mItems;
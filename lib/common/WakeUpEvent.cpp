@@ -0,0 +1,151 @@
+// --------------------------------------------------------------------------
+//
+// File
+//		Name:    WakeUpEvent.cpp
+//		Purpose: An event which can be added to a WaitForEvent, to
+//			 wake it up from elsewhere, including signal handlers
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+#include "Box.h"
+
+#ifndef WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+
+#ifdef HAVE_UNISTD_H
+	#include <unistd.h>
+#endif
+
+#if defined HAVE_SYS_EVENTFD_H && defined HAVE_EVENTFD
+	#include <sys/eventfd.h>
+	#define WAKEUPEVENT_USE_EVENTFD
+#endif
+
+#include "CommonException.h"
+#include "Logging.h"
+#include "WakeUpEvent.h"
+
+#include "MemLeakFindOn.h"
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    WakeUpEvent::WakeUpEvent()
+//		Purpose: Constructor
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+WakeUpEvent::WakeUpEvent()
+: mReadFd(-1),
+  mWriteFd(-1)
+{
+#ifdef WAKEUPEVENT_USE_EVENTFD
+	mReadFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(mReadFd == -1)
+	{
+		THROW_SYS_ERROR("Failed to create eventfd", CommonException,
+			Internal);
+	}
+	mWriteFd = mReadFd;
+#else
+	int fds[2];
+	if(::pipe(fds) != 0)
+	{
+		THROW_SYS_ERROR("Failed to create pipe", CommonException,
+			Internal);
+	}
+	mReadFd = fds[0];
+	mWriteFd = fds[1];
+
+	for(int i = 0; i < 2; i++)
+	{
+		if(::fcntl(fds[i], F_SETFL, O_NONBLOCK) == -1 ||
+			::fcntl(fds[i], F_SETFD, FD_CLOEXEC) == -1)
+		{
+			int error = errno;
+			::close(mReadFd);
+			::close(mWriteFd);
+			THROW_SYS_ERROR_NUMBER("Failed to configure pipe",
+				error, CommonException, Internal);
+		}
+	}
+#endif
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    WakeUpEvent::~WakeUpEvent()
+//		Purpose: Destructor
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+WakeUpEvent::~WakeUpEvent()
+{
+	if(mWriteFd != mReadFd)
+	{
+		::close(mWriteFd);
+	}
+	::close(mReadFd);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    WakeUpEvent::Signal()
+//		Purpose: Makes the event readable, if it isn't already.
+//			 Only makes async-signal-safe calls, and doesn't
+//			 change errno.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void WakeUpEvent::Signal()
+{
+	int savedErrno = errno;
+#ifdef WAKEUPEVENT_USE_EVENTFD
+	uint64_t one = 1;
+	if(::write(mWriteFd, &one, sizeof(one)) == -1)
+	{
+		// The counter would overflow, so it's signalled already
+	}
+#else
+	char byte = 0;
+	if(::write(mWriteFd, &byte, sizeof(byte)) == -1)
+	{
+		// The pipe is full, so it's signalled already
+	}
+#endif
+	errno = savedErrno;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    WakeUpEvent::Clear()
+//		Purpose: Makes the event unreadable again. Returns true if
+//			 it had been signalled.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool WakeUpEvent::Clear()
+{
+#ifdef WAKEUPEVENT_USE_EVENTFD
+	uint64_t count = 0;
+	// Reading resets the counter to zero
+	return ::read(mReadFd, &count, sizeof(count)) == sizeof(count) &&
+		count > 0;
+#else
+	bool signalled = false;
+	char buffer[64];
+	while(::read(mReadFd, buffer, sizeof(buffer)) > 0)
+	{
+		signalled = true;
+	}
+	return signalled;
+#endif
+}
+
+#endif // !WIN32
@@ -0,0 +1,72 @@
+// --------------------------------------------------------------------------
+//
+// File
+//		Name:    WakeUpEvent.h
+//		Purpose: An event which can be added to a WaitForEvent, to
+//			 wake it up from elsewhere, including signal handlers
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+#ifndef WAKEUPEVENT__H
+#define WAKEUPEVENT__H
+
+#ifndef WIN32
+
+#ifdef HAVE_KQUEUE
+	#include <sys/event.h>
+	#include <sys/time.h>
+#else
+	#include <poll.h>
+#endif
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    WakeUpEvent
+//		Purpose: Becomes readable when signalled, and stays so until
+//			 it's cleared. Uses an eventfd where available, or a
+//			 pipe otherwise. Signal() is safe to call from a
+//			 signal handler, which unlike the signal itself
+//			 can't be lost if it arrives just before the wait
+//			 starts.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class WakeUpEvent
+{
+public:
+	WakeUpEvent();
+	~WakeUpEvent();
+private:
+	// No copying
+	WakeUpEvent(const WakeUpEvent &);
+	WakeUpEvent &operator=(const WakeUpEvent &);
+
+public:
+	void Signal();
+	bool Clear();
+	int GetFileDescriptor() const { return mReadFd; }
+
+#ifdef HAVE_KQUEUE
+	void FillInKEvent(struct kevent &rEvent, int Flags = 0) const
+	{
+		EV_SET(&rEvent, mReadFd, EVFILT_READ, 0, 0, 0, (void*)this);
+	}
+#else
+	void FillInPoll(int &fd, short &events, int Flags = 0) const
+	{
+		fd = mReadFd;
+		events = POLLIN;
+	}
+#endif
+
+private:
+	// The same eventfd, or the two ends of a pipe
+	int mReadFd;
+	int mWriteFd;
+};
+
+#endif // !WIN32
+
+#endif // WAKEUPEVENT__H
@@ -0,0 +1,238 @@
+// --------------------------------------------------------------------------
+//
+// File
+//		Name:    HTTPChunkedStream.cpp
+//		Purpose: Streams for HTTP chunked transfer coding
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+#include "Box.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "HTTPChunkedStream.h"
+#include "IOStreamGetLine.h"
+#include "CommonException.h"
+#include "autogen_HTTPException.h"
+
+#include "MemLeakFindOn.h"
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPChunkedDecodeStream::HTTPChunkedDecodeStream(
+//			 IOStreamGetLine &)
+//		Purpose: Constructor, taking the line reader of the
+//			 connection, positioned at the start of the body.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+HTTPChunkedDecodeStream::HTTPChunkedDecodeStream(IOStreamGetLine &rGetLine)
+	: mrGetLine(rGetLine),
+	  mBytesLeftInChunk(0),
+	  mInChunk(false),
+	  mFinished(false)
+{
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPChunkedDecodeStream::ReadLine(int)
+//		Purpose: Private. Read one line of chunk framing, throwing
+//			 an exception if it doesn't arrive in time, as the
+//			 body can't be resumed part way through a line.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::string HTTPChunkedDecodeStream::ReadLine(int Timeout)
+{
+	std::string line;
+	if(mrGetLine.IsEOF())
+	{
+		THROW_EXCEPTION_MESSAGE(HTTPException, ChunkedReadFailed,
+			"Connection closed before the last chunk was received");
+	}
+	if(!mrGetLine.GetLine(line, false /* no preprocess */, Timeout))
+	{
+		THROW_EXCEPTION_MESSAGE(HTTPException, ChunkedReadFailed,
+			"Timed out waiting for the next chunk");
+	}
+	return line;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPChunkedDecodeStream::Read(void *, int, int)
+//		Purpose: As interface. Reads the data of the current chunk,
+//			 starting the next one if it's finished. Returns 0
+//			 once the last chunk has been read.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int HTTPChunkedDecodeStream::Read(void *pBuffer, int NBytes, int Timeout)
+{
+	if(mFinished)
+	{
+		return 0;
+	}
+
+	if(mBytesLeftInChunk == 0)
+	{
+		if(mInChunk)
+		{
+			// The data of each chunk is followed by a line ending
+			if(!ReadLine(Timeout).empty())
+			{
+				THROW_EXCEPTION_MESSAGE(HTTPException,
+					BadChunkedEncoding, "Chunk is longer "
+					"than its size");
+			}
+			mInChunk = false;
+		}
+
+		// The size is in hex, and may be followed by extensions,
+		// which we ignore.
+		std::string sizeLine = ReadLine(Timeout);
+		const char *start = sizeLine.c_str();
+		char *end = NULL;
+		long long size = ::strtoll(start, &end, 16);
+		if(end == start || size < 0 || (*end != '\0' && *end != ';' &&
+			*end != ' ' && *end != '\t'))
+		{
+			THROW_EXCEPTION_MESSAGE(HTTPException,
+				BadChunkedEncoding, "Invalid chunk size: " <<
+				sizeLine);
+		}
+
+		if(size == 0)
+		{
+			// The last chunk, which may be followed by trailers
+			// (which we ignore) and ends with a blank line.
+			while(!ReadLine(Timeout).empty())
+			{
+			}
+			mFinished = true;
+			return 0;
+		}
+
+		mBytesLeftInChunk = size;
+		mInChunk = true;
+	}
+
+	int bytesToRead = NBytes;
+	if(bytesToRead > mBytesLeftInChunk)
+	{
+		bytesToRead = mBytesLeftInChunk;
+	}
+
+	// Use anything that the line reader has already read first
+	int bytesRead = mrGetLine.GetSizeOfBufferedData();
+	if(bytesRead > 0)
+	{
+		if(bytesRead > bytesToRead)
+		{
+			bytesRead = bytesToRead;
+		}
+		::memcpy(pBuffer, mrGetLine.GetBufferedData(), bytesRead);
+		mrGetLine.IgnoreBufferedData(bytesRead);
+	}
+	else
+	{
+		IOStream &rStream(mrGetLine.GetUnderlyingStream());
+		bytesRead = rStream.Read(pBuffer, bytesToRead, Timeout);
+		if(bytesRead == 0 && !rStream.StreamDataLeft())
+		{
+			THROW_EXCEPTION_MESSAGE(HTTPException,
+				ChunkedReadFailed, "Connection closed in "
+				"the middle of a chunk");
+		}
+	}
+
+	mBytesLeftInChunk -= bytesRead;
+	return bytesRead;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPChunkedDecodeStream::Write(const void *, int, int)
+//		Purpose: As interface. Not supported.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void HTTPChunkedDecodeStream::Write(const void *pBuffer, int NBytes,
+	int Timeout)
+{
+	THROW_EXCEPTION(CommonException, NotSupported)
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPChunkedEncodeStream::Read(void *, int, int)
+//		Purpose: As interface. Not supported.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int HTTPChunkedEncodeStream::Read(void *pBuffer, int NBytes, int Timeout)
+{
+	THROW_EXCEPTION(CommonException, NotSupported)
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPChunkedEncodeStream::Write(const void *, int, int)
+//		Purpose: As interface. Writes the data as one chunk, with
+//			 its size and line endings, in a single write.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void HTTPChunkedEncodeStream::Write(const void *pBuffer, int NBytes,
+	int Timeout)
+{
+	if(mClosed)
+	{
+		THROW_EXCEPTION(CommonException, NotSupported)
+	}
+
+	// An empty chunk would end the body
+	if(NBytes == 0)
+	{
+		return;
+	}
+
+	char size[32];
+	int sizeLength = ::sprintf(size, "%x\r\n", NBytes);
+
+	std::string chunk;
+	chunk.reserve(sizeLength + NBytes + 2);
+	chunk.append(size, sizeLength);
+	chunk.append((const char *)pBuffer, NBytes);
+	chunk.append("\r\n");
+	mrSink.Write(chunk.c_str(), chunk.size(), Timeout);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPChunkedEncodeStream::Close()
+//		Purpose: Write the last chunk, ending the body.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void HTTPChunkedEncodeStream::Close()
+{
+	if(!mClosed)
+	{
+		mrSink.Write("0\r\n\r\n", 5);
+		mClosed = true;
+	}
+}
@@ -0,0 +1,94 @@
+// --------------------------------------------------------------------------
+//
+// File
+//		Name:    HTTPChunkedStream.h
+//		Purpose: Streams for HTTP chunked transfer coding
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+#ifndef HTTPCHUNKEDSTREAM__H
+#define HTTPCHUNKEDSTREAM__H
+
+#include "IOStream.h"
+
+class IOStreamGetLine;
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    HTTPChunkedDecodeStream
+//		Purpose: Reads the body of a request or response sent with
+//			 Transfer-Encoding: chunked, from the line reader of
+//			 the connection, and returns just the data in it.
+//			 Reading stops after the last (empty) chunk and any
+//			 trailers, leaving whatever follows on a kept-alive
+//			 connection in the line reader's buffer.
+//			 (http://tools.ietf.org/html/rfc7230#section-4.1)
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class HTTPChunkedDecodeStream : public IOStream
+{
+public:
+	HTTPChunkedDecodeStream(IOStreamGetLine &rGetLine);
+private:
+	// no copying
+	HTTPChunkedDecodeStream(const HTTPChunkedDecodeStream &);
+	HTTPChunkedDecodeStream &operator=(const HTTPChunkedDecodeStream &);
+
+public:
+	virtual int Read(void *pBuffer, int NBytes,
+		int Timeout = IOStream::TimeOutInfinite);
+	virtual void Write(const void *pBuffer, int NBytes,
+		int Timeout = IOStream::TimeOutInfinite);
+	virtual bool StreamDataLeft() { return !mFinished; }
+	virtual bool StreamClosed() { return true; }
+
+private:
+	std::string ReadLine(int Timeout);
+
+	IOStreamGetLine &mrGetLine;
+	int64_t mBytesLeftInChunk;
+	bool mInChunk;
+	bool mFinished;
+};
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    HTTPChunkedEncodeStream
+//		Purpose: Writes data to another stream as the chunks of a
+//			 body sent with Transfer-Encoding: chunked. Close()
+//			 writes the last chunk which marks the end of the
+//			 body, but doesn't close the stream written to.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class HTTPChunkedEncodeStream : public IOStream
+{
+public:
+	HTTPChunkedEncodeStream(IOStream &rSink)
+	: mrSink(rSink),
+	  mClosed(false)
+	{ }
+private:
+	// no copying
+	HTTPChunkedEncodeStream(const HTTPChunkedEncodeStream &);
+	HTTPChunkedEncodeStream &operator=(const HTTPChunkedEncodeStream &);
+
+public:
+	virtual int Read(void *pBuffer, int NBytes,
+		int Timeout = IOStream::TimeOutInfinite);
+	virtual void Write(const void *pBuffer, int NBytes,
+		int Timeout = IOStream::TimeOutInfinite);
+	virtual void Close();
+	virtual bool StreamDataLeft() { return false; }
+	virtual bool StreamClosed() { return mClosed; }
+
+private:
+	IOStream &mrSink;
+	bool mClosed;
+};
+
+#endif // HTTPCHUNKEDSTREAM__H
@@ -15,6 +15,7 @@
 
 #include <sstream>
 
+#include "HTTPChunkedStream.h"
 #include "HTTPRequest.h"
 #include "HTTPResponse.h"
 #include "HTTPQueryDecoder.h"
@@ -48,7 +49,8 @@ HTTPRequest::HTTPRequest()
 	  mpCookies(0),
 	  mClientKeepAliveRequested(false),
 	  mExpectContinue(false),
-	  mpStreamToReadFrom(NULL)
+	  mpStreamToReadFrom(NULL),
+	  mChunked(false)
 {
 }
 
@@ -71,7 +73,8 @@ HTTPRequest::HTTPRequest(enum Method method, const std::string& rURI)
 	  mpCookies(0),
 	  mClientKeepAliveRequested(false),
 	  mExpectContinue(false),
-	  mpStreamToReadFrom(NULL)
+	  mpStreamToReadFrom(NULL),
+	  mChunked(false)
 {
 }
 
@@ -115,6 +118,7 @@ std::string HTTPRequest::GetMethodName() const
 		case Method_HEAD: return "HEAD";
 		case Method_POST: return "POST";
 		case Method_PUT: return "PUT";
+		case Method_DELETE: return "DELETE";
 		default:
 			std::ostringstream oss;
 			oss << "unknown-" << mMethod;
@@ -178,6 +182,10 @@ bool HTTPRequest::Receive(IOStreamGetLine &rGetLine, int Timeout)
 		{
 			mMethod = Method_PUT;
 		}
+		else if (mHttpVerb == "DELETE")
+		{
+			mMethod = Method_DELETE;
+		}
 		else
 		{
 			mMethod = Method_UNKNOWN;
@@ -294,8 +302,9 @@ bool HTTPRequest::Receive(IOStreamGetLine &rGetLine, int Timeout)
 		mClientKeepAliveRequested = true;
 	}
 
-	// Decode query string?
-	if((mMethod == Method_GET || mMethod == Method_HEAD) && !mQueryString.empty())
+	// Decode query string? Any method may have one, e.g. S3 uses them
+	// to select the parts of a multipart upload in PUTs and POSTs.
+	if(!mQueryString.empty())
 	{
 		HTTPQueryDecoder decoder(mQuery);
 		decoder.DecodeChunk(mQueryString.c_str(), mQueryString.size());
@@ -314,8 +323,55 @@ bool HTTPRequest::Receive(IOStreamGetLine &rGetLine, int Timeout)
 		}
 	}
 
-	// Parse form data?
-	if(mMethod == Method_POST && mContentLength >= 0)
+	// Chunked content has no Content-Length, and ignores any that is
+	// sent (http://tools.ietf.org/html/rfc7230#section-3.3.3).
+	std::string transferEncoding;
+	if(GetHeader("Transfer-Encoding", &transferEncoding))
+	{
+		// Only chunked is supported, on its own: we can't undo any
+		// other codings, such as "gzip, chunked", so the client gets
+		// 501 Not Implemented instead.
+		if(ToLowerCase(transferEncoding) != "chunked")
+		{
+			THROW_EXCEPTION_MESSAGE(HTTPException, NotImplemented,
+				"Unsupported Transfer-Encoding: " <<
+				transferEncoding);
+		}
+		mChunked = true;
+		mContentLength = -1;
+	}
+
+	// Parse form data? Other content (such as XML) is handled as it is
+	// for PUTs, below.
+	bool isFormData = (mMethod == Method_POST &&
+		(mContentType.empty() || mContentType.compare(0, 33,
+			"application/x-www-form-urlencoded") == 0));
+
+	if(isFormData && mChunked)
+	{
+		HTTPChunkedDecodeStream content(rGetLine);
+		HTTPQueryDecoder decoder(mQuery);
+		int bytesDecoded = 0;
+		while(content.StreamDataLeft())
+		{
+			char buf[4096];
+			int r = content.Read(buf, sizeof(buf), Timeout);
+			if(r == 0 && content.StreamDataLeft())
+			{
+				THROW_EXCEPTION_MESSAGE(HTTPException, RequestReadFailed,
+					"Failed to read complete request with the timeout");
+			}
+			// Too long? Don't allow people to be nasty by sending lots of data
+			bytesDecoded += r;
+			if(bytesDecoded > MAX_CONTENT_SIZE)
+			{
+				THROW_EXCEPTION(HTTPException, POSTContentTooLong);
+			}
+			decoder.DecodeChunk(buf, r);
+		}
+		decoder.Finish();
+	}
+	else if(isFormData && mContentLength >= 0)
 	{
 		// Too long? Don't allow people to be nasty by sending lots of data
 		if(mContentLength > MAX_CONTENT_SIZE)
@@ -357,14 +413,24 @@ bool HTTPRequest::Receive(IOStreamGetLine &rGetLine, int Timeout)
 		// Finish off
 		decoder.Finish();
 	}
-	else if (mContentLength > 0)
+	else if (mChunked)
+	{
+		// Left on the connection for ReadContent() to decode
+		SetForReading();
+		mapChunkedContent.reset(new HTTPChunkedDecodeStream(rGetLine));
+	}
+	else if (mContentLength >= 0)
 	{
+		// Even if empty, so that ReadContent() works
 		IOStream::pos_type bytesToCopy = rGetLine.GetSizeOfBufferedData();
 		if (bytesToCopy > mContentLength)
 		{
 			bytesToCopy = mContentLength;
 		}
 		Write(rGetLine.GetBufferedData(), bytesToCopy);
+		// Leave anything after the content (the next request on a
+		// kept-alive connection) for the next call.
+		rGetLine.IgnoreBufferedData(bytesToCopy);
 		SetForReading();
 		mpStreamToReadFrom = &(rGetLine.GetUnderlyingStream());
 	}
@@ -372,11 +438,214 @@ bool HTTPRequest::Receive(IOStreamGetLine &rGetLine, int Timeout)
 	return true;
 }
 
+// Finds the end of the line starting at Start in the buffer, returning the
+// position after it, or -1 if it's incomplete, and the line without its
+// line ending in rLine.
+static int GetBufferedLine(const char *pBuffer, int BufferSize, int Start,
+	std::string &rLine)
+{
+	const char *end = (const char *)::memchr(pBuffer + Start, '\n',
+		BufferSize - Start);
+	if(end == NULL)
+	{
+		return -1;
+	}
+	rLine.assign(pBuffer + Start, end - (pBuffer + Start));
+	if(!rLine.empty() && rLine[rLine.size() - 1] == '\r')
+	{
+		rLine.resize(rLine.size() - 1);
+	}
+	return (end - pBuffer) + 1;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPRequest::GetSizeOfCompleteRequest(const void *,
+//			 int, bool &, bool *)
+//		Purpose: Checks whether the start of a buffer of data
+//			 received on a connection holds a whole request,
+//			 including its content, so that an event-driven
+//			 server can Receive() it without waiting. Returns
+//			 its size if so, otherwise 0, setting
+//			 rExpectsContinue if all the headers are there but
+//			 the client is waiting for 100 Continue before it
+//			 sends the content. Once all the headers are there,
+//			 sets *pHasContentOut if the request has content,
+//			 whether or not all of it has arrived. A request
+//			 with a Transfer-Encoding that isn't supported ends
+//			 with its headers, for Receive() to refuse.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int HTTPRequest::GetSizeOfCompleteRequest(const void *pBuffer,
+	int BufferSize, bool &rExpectsContinue, bool *pHasContentOut)
+{
+	const char *buffer = (const char *)pBuffer;
+	rExpectsContinue = false;
+	if(pHasContentOut != NULL)
+	{
+		*pHasContentOut = false;
+	}
+
+	// The request line, and then the headers up to a blank line. We
+	// only need the ones which say how long the content is.
+	std::string line;
+	int pos = GetBufferedLine(buffer, BufferSize, 0, line);
+	if(pos == -1)
+	{
+		return 0;
+	}
+
+	int64_t contentLength = -1;
+	bool chunked = false, expectContinue = false, unsupported = false;
+	while(true)
+	{
+		pos = GetBufferedLine(buffer, BufferSize, pos, line);
+		if(pos == -1)
+		{
+			return 0;
+		}
+		if(line.empty())
+		{
+			break;
+		}
+
+		std::string::size_type colon = line.find(':');
+		if(colon == std::string::npos || line[0] == ' ' ||
+			line[0] == '\t')
+		{
+			// Continuation line, or not a header at all, which
+			// Receive() will deal with.
+			continue;
+		}
+
+		std::string name, value;
+		for(std::string::size_type i = 0; i < colon; i++)
+		{
+			name += tolower(line[i]);
+		}
+		std::string::size_type v = colon + 1;
+		while(v < line.size() && (line[v] == ' ' || line[v] == '\t'))
+		{
+			v++;
+		}
+		for(; v < line.size(); v++)
+		{
+			value += tolower(line[v]);
+		}
+
+		if(name == "content-length")
+		{
+			contentLength = ::strtoll(value.c_str(), NULL, 10);
+			if(contentLength < 0) contentLength = 0;
+		}
+		else if(name == "transfer-encoding")
+		{
+			chunked = (value == "chunked");
+			if(!chunked)
+			{
+				// Receive() will refuse it, without reading
+				// any content.
+				unsupported = true;
+			}
+		}
+		else if(name == "expect")
+		{
+			expectContinue = (value == "100-continue");
+		}
+	}
+
+	if(unsupported)
+	{
+		// We can't tell where its content ends
+		return pos;
+	}
+
+	if(pHasContentOut != NULL)
+	{
+		*pHasContentOut = chunked || contentLength > 0;
+	}
+
+	if(chunked)
+	{
+		// Follow the chunks to the last one, and then any trailers
+		// up to a blank line.
+		while(true)
+		{
+			pos = GetBufferedLine(buffer, BufferSize, pos, line);
+			if(pos == -1)
+			{
+				break;
+			}
+
+			char *end = NULL;
+			long long size = ::strtoll(line.c_str(), &end, 16);
+			if(end == line.c_str() || size < 0)
+			{
+				THROW_EXCEPTION_MESSAGE(HTTPException,
+					BadChunkedEncoding, "Invalid chunk "
+					"size: " << line);
+			}
+
+			if(size == 0)
+			{
+				do
+				{
+					pos = GetBufferedLine(buffer,
+						BufferSize, pos, line);
+				}
+				while(pos != -1 && !line.empty());
+
+				if(pos == -1)
+				{
+					break;
+				}
+				return pos;
+			}
+
+			if(size > BufferSize - pos)
+			{
+				break;
+			}
+
+			// Skip the data, and the line ending after it
+			pos = GetBufferedLine(buffer, BufferSize, pos + size,
+				line);
+			if(pos == -1)
+			{
+				break;
+			}
+		}
+	}
+	else if(contentLength <= BufferSize - pos)
+	{
+		// Includes no content at all
+		return pos + (contentLength > 0 ? contentLength : 0);
+	}
+
+	// All the headers, but not all the content
+	rExpectsContinue = expectContinue;
+	return 0;
+}
+
 void HTTPRequest::ReadContent(IOStream& rStreamToWriteTo)
 {
 	Seek(0, SeekType_Absolute);
 	
 	CopyStreamTo(rStreamToWriteTo);
+
+	if (mapChunkedContent.get())
+	{
+		if (!mapChunkedContent->CopyStreamTo(rStreamToWriteTo))
+		{
+			THROW_EXCEPTION_MESSAGE(HTTPException, RequestReadFailed,
+				"Failed to read complete request");
+		}
+		mapChunkedContent.reset();
+		return;
+	}
+
 	IOStream::pos_type bytesCopied = GetSize();
 
 	while (bytesCopied < mContentLength)
@@ -388,9 +657,38 @@ void HTTPRequest::ReadContent(IOStream& rStreamToWriteTo)
 			bytesToCopy = mContentLength - bytesCopied;
 		}
 		bytesToCopy = mpStreamToReadFrom->Read(buffer, bytesToCopy);
+		if(bytesToCopy == 0 && !mpStreamToReadFrom->StreamDataLeft())
+		{
+			THROW_EXCEPTION_MESSAGE(HTTPException, RequestReadFailed,
+				"Connection closed before the whole request "
+				"was received");
+		}
 		rStreamToWriteTo.Write(buffer, bytesToCopy);
 		bytesCopied += bytesToCopy;
 	}
+
+	// The rest of the content has now been read from the connection
+	mpStreamToReadFrom = NULL;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPRequest::HasUnreadContent()
+//		Purpose: Returns true if some of the content of the request
+//			 is still waiting to be read from the connection by
+//			 ReadContent(), in which case the connection can't be
+//			 used for another request.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool HTTPRequest::HasUnreadContent() const
+{
+	if (mapChunkedContent.get())
+	{
+		return mapChunkedContent->StreamDataLeft();
+	}
+	return mpStreamToReadFrom != NULL && GetSize() < mContentLength;
 }
 
 // --------------------------------------------------------------------------
@@ -403,6 +701,10 @@ void HTTPRequest::ReadContent(IOStream& rStreamToWriteTo)
 // --------------------------------------------------------------------------
 bool HTTPRequest::Send(IOStream &rStream, int Timeout, bool ExpectContinue)
 {
+	// Build the whole header and send it in one write, to avoid
+	// waiting for ACKs of small packets on a kept-alive connection.
+	std::ostringstream oss;
+
 	switch (mMethod)
 	{
 	case Method_UNINITIALISED:
@@ -410,33 +712,43 @@ bool HTTPRequest::Send(IOStream &rStream, int Timeout, bool ExpectContinue)
 	case Method_UNKNOWN:
 		THROW_EXCEPTION(HTTPException, BadRequest); break;
 	case Method_GET:
-		rStream.Write("GET"); break;
+		oss << "GET"; break;
 	case Method_HEAD:
-		rStream.Write("HEAD"); break;
+		oss << "HEAD"; break;
 	case Method_POST:
-		rStream.Write("POST"); break;
+		oss << "POST"; break;
 	case Method_PUT:
-		rStream.Write("PUT"); break;
+		oss << "PUT"; break;
+	case Method_DELETE:
+		oss << "DELETE"; break;
 	}
 
-	rStream.Write(" ");
-	rStream.Write(mRequestURI.c_str());
-	rStream.Write(" ");
+	oss << " " << mRequestURI;
+	for(Query_t::const_iterator i(mQuery.begin()); i != mQuery.end(); i++)
+	{
+		oss << ((i == mQuery.begin()) ? "?" : "&") <<
+			EncodeQueryComponent(i->first) << "=" <<
+			EncodeQueryComponent(i->second);
+	}
+	oss << " ";
 
 	switch (mHTTPVersion)
 	{
-	case HTTPVersion_0_9: rStream.Write("HTTP/0.9"); break;
-	case HTTPVersion_1_0: rStream.Write("HTTP/1.0"); break;
-	case HTTPVersion_1_1: rStream.Write("HTTP/1.1"); break;
+	case HTTPVersion_0_9: oss << "HTTP/0.9"; break;
+	case HTTPVersion_1_0: oss << "HTTP/1.0"; break;
+	case HTTPVersion_1_1: oss << "HTTP/1.1"; break;
 	default:
 		THROW_EXCEPTION_MESSAGE(HTTPException, NotImplemented,
 			"Unsupported HTTP version: " << mHTTPVersion);
 	}
 
-	rStream.Write("\n");
-	std::ostringstream oss;
+	oss << "\n";
 
-	if (mContentLength != -1)
+	if (mChunked)
+	{
+		oss << "Transfer-Encoding: chunked\n";
+	}
+	else if (mContentLength != -1)
 	{
 		oss << "Content-Length: " << mContentLength << "\n";
 	}
@@ -485,8 +797,9 @@ bool HTTPRequest::Send(IOStream &rStream, int Timeout, bool ExpectContinue)
 		oss << "Expect: 100-continue\n";
 	}
 
-	rStream.Write(oss.str().c_str());
-	rStream.Write("\n");
+	oss << "\n";
+	std::string header = oss.str();
+	rStream.Write(header.c_str(), header.size(), Timeout);
 
 	return true;
 }
@@ -494,25 +807,63 @@ bool HTTPRequest::Send(IOStream &rStream, int Timeout, bool ExpectContinue)
 void HTTPRequest::SendWithStream(IOStream &rStreamToSendTo, int Timeout,
 	IOStream* pStreamToSend, HTTPResponse& rResponse)
 {
+	IOStreamGetLine getLine(rStreamToSendTo);
+	SendWithStream(getLine, Timeout, pStreamToSend, rResponse);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPRequest::SendWithStream(IOStreamGetLine &, int,
+//			 IOStream*, HTTPResponse &)
+//		Purpose: Send the request with the contents of a stream,
+//			 waiting for the server to agree to receive it
+//			 (100 Continue) first, and receive the response,
+//			 using a line reader which belongs to the connection
+//			 so that it can be reused afterwards. If the size of
+//			 the stream isn't known, it's sent chunked.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void HTTPRequest::SendWithStream(IOStreamGetLine &rGetLine, int Timeout,
+	IOStream* pStreamToSend, HTTPResponse& rResponse)
+{
+	IOStream& rStreamToSendTo(rGetLine.GetUnderlyingStream());
 	IOStream::pos_type size = pStreamToSend->BytesLeftToRead();
 	if (size != IOStream::SizeOfStreamUnknown)
 	{
 		mContentLength = size;
+		mChunked = false;
+	}
+	else
+	{
+		mContentLength = -1;
+		mChunked = true;
 	}
 
 	Send(rStreamToSendTo, Timeout, true);
 
-	rResponse.Receive(rStreamToSendTo, Timeout);
+	rResponse.Receive(rGetLine, Timeout);
 	if (rResponse.GetResponseCode() != 100)
 	{
 		// bad response, abort now
 		return;
 	}
 
-	pStreamToSend->CopyStreamTo(rStreamToSendTo, Timeout);
+	if (mChunked)
+	{
+		HTTPChunkedEncodeStream encoder(rStreamToSendTo);
+		pStreamToSend->CopyStreamTo(encoder, Timeout,
+			HTTPRESPONSE_STREAM_BUFFER_SIZE);
+		encoder.Close();
+	}
+	else
+	{
+		pStreamToSend->CopyStreamTo(rStreamToSendTo, Timeout);
+	}
 
 	// receive the final response
-	rResponse.Receive(rStreamToSendTo, Timeout);
+	rResponse.Receive(rGetLine, Timeout);
 }
 
 // --------------------------------------------------------------------------
@@ -811,3 +1162,39 @@ const std::string &HTTPRequest::GetCookie(const char *CookieName) const
 
 
 
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPRequest::EncodeQueryComponent(const std::string &)
+//		Purpose: Returns the name or value of a query parameter,
+//			 with everything except unreserved characters
+//			 percent-encoded, ready to send in a request line.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+std::string HTTPRequest::EncodeQueryComponent(const std::string& rComponent)
+{
+	static const char *hex = "0123456789ABCDEF";
+	std::string encoded;
+
+	for(std::string::const_iterator i(rComponent.begin());
+		i != rComponent.end(); i++)
+	{
+		unsigned char c = *i;
+		if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+			(c >= '0' && c <= '9') || c == '-' || c == '_' ||
+			c == '.' || c == '~')
+		{
+			encoded += c;
+		}
+		else
+		{
+			encoded += '%';
+			encoded += hex[c >> 4];
+			encoded += hex[c & 0xf];
+		}
+	}
+
+	return encoded;
+}
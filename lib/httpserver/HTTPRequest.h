@@ -10,11 +10,13 @@
 #ifndef HTTPREQUEST__H
 #define HTTPREQUEST__H
 
-#include <string>
 #include <map>
+#include <memory>
+#include <string>
 
 #include "CollectInBufferStream.h"
 
+class HTTPChunkedDecodeStream;
 class HTTPResponse;
 class IOStream;
 class IOStreamGetLine;
@@ -28,6 +30,8 @@ class IOStreamGetLine;
 //			 request data is held in memory, only the beginning.
 //			 Use ReadContent() to write it all (including the
 //			 buffered beginning) to another stream, e.g. a file.
+//			 Content sent with chunked encoding is all left on
+//			 the connection until ReadContent() is called.
 //		Created: 26/3/2004
 //
 // --------------------------------------------------------------------------
@@ -41,7 +45,8 @@ public:
 		Method_GET = 1,
 		Method_HEAD = 2,
 		Method_POST = 3,
-		Method_PUT = 4
+		Method_PUT = 4,
+		Method_DELETE = 5
 	};
 	
 	HTTPRequest();
@@ -65,10 +70,16 @@ public:
 	};
 
 	bool Receive(IOStreamGetLine &rGetLine, int Timeout);
+	static int GetSizeOfCompleteRequest(const void *pBuffer,
+		int BufferSize, bool &rExpectsContinue,
+		bool *pHasContentOut = NULL);
 	bool Send(IOStream &rStream, int Timeout, bool ExpectContinue = false);
 	void SendWithStream(IOStream &rStreamToSendTo, int Timeout,
 		IOStream* pStreamToSend, HTTPResponse& rResponse);
+	void SendWithStream(IOStreamGetLine &rGetLine, int Timeout,
+		IOStream* pStreamToSend, HTTPResponse& rResponse);
 	void ReadContent(IOStream& rStreamToWriteTo);
+	bool HasUnreadContent() const;
 
 	typedef std::map<std::string, std::string> CookieJar_t;
 	
@@ -97,7 +108,15 @@ public:
 	int GetHTTPVersion() const {return mHTTPVersion;}
 	const Query_t &GetQuery() const {return mQuery;}
 	int GetContentLength() const {return mContentLength;}
+	void SetContentLength(int ContentLength)
+	{
+		mContentLength = ContentLength;
+	}
 	const std::string &GetContentType() const {return mContentType;}
+	void SetContentType(const std::string &rContentType)
+	{
+		mContentType = rContentType;
+	}
 	const CookieJar_t *GetCookies() const {return mpCookies;} // WARNING: May return NULL
 	bool GetCookie(const char *CookieName, std::string &rValueOut) const;
 	const std::string &GetCookie(const char *CookieName) const;
@@ -139,7 +158,17 @@ public:
 	{
 		mExtraHeaders.push_back(Header(ToLowerCase(rName), rValue));
 	}
+	// Query parameters are sent after the request URI, but are not part
+	// of it, so GetRequestURI() returns only the path.
+	void AddParameter(const std::string& rName, const std::string& rValue)
+	{
+		mQuery.insert(QueryEn_t(rName, rValue));
+	}
 	bool IsExpectingContinue() const { return mExpectContinue; }
+	void SetExpectingContinue(bool ExpectContinue)
+	{
+		mExpectContinue = ExpectContinue;
+	}
 	const char* GetVerb() const
 	{
 		if (!mHttpVerb.empty())
@@ -154,10 +183,13 @@ public:
 			case Method_HEAD: return "HEAD";
 			case Method_POST: return "POST";
 			case Method_PUT: return "PUT";
+			case Method_DELETE: return "DELETE";
 		}
 		return "Bad";
 	}
 	
+	static std::string EncodeQueryComponent(const std::string& rComponent);
+
 private:
 	void ParseHeaders(IOStreamGetLine &rGetLine, int Timeout);
 	void ParseCookies(const std::string &rHeader, int DataStarts);
@@ -176,6 +208,8 @@ private:
 	std::vector<Header> mExtraHeaders;
 	bool mExpectContinue;
 	IOStream* mpStreamToReadFrom;
+	bool mChunked;
+	std::auto_ptr<HTTPChunkedDecodeStream> mapChunkedContent;
 	std::string mHttpVerb;
 
 	std::string ToLowerCase(const std::string& rInput) const
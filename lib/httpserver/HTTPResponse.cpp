@@ -12,6 +12,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "Guards.h"
+#include "HTTPChunkedStream.h"
 #include "HTTPResponse.h"
 #include "IOStreamGetLine.h"
 #include "autogen_HTTPException.h"
@@ -34,6 +36,11 @@ HTTPResponse::HTTPResponse(IOStream* pStreamToSendTo)
 	: mResponseCode(HTTPResponse::Code_NoContent),
 	  mResponseIsDynamicContent(true),
 	  mKeepAlive(false),
+	  mChunkedAllowed(true),
+	  mChunked(false),
+	  mSendChunked(false),
+	  mSendContentLeft(false),
+	  mBufferBytesSent(0),
 	  mContentLength(-1),
 	  mpStreamToSendTo(pStreamToSendTo)
 {
@@ -52,6 +59,11 @@ HTTPResponse::HTTPResponse()
 	: mResponseCode(HTTPResponse::Code_NoContent),
 	  mResponseIsDynamicContent(true),
 	  mKeepAlive(false),
+	  mChunkedAllowed(true),
+	  mChunked(false),
+	  mSendChunked(false),
+	  mSendContentLeft(false),
+	  mBufferBytesSent(0),
 	  mContentLength(-1),
 	  mpStreamToSendTo(NULL)
 {
@@ -86,6 +98,7 @@ const char *HTTPResponse::ResponseCodeToString(int ResponseCode)
 	{
 	case Code_OK: return "200 OK"; break;
 	case Code_NoContent: return "204 No Content"; break;
+	case Code_PartialContent: return "206 Partial Content"; break;
 	case Code_MovedPermanently: return "301 Moved Permanently"; break;
 	case Code_Found: return "302 Found"; break;
 	case Code_NotModified: return "304 Not Modified"; break;
@@ -94,6 +107,8 @@ const char *HTTPResponse::ResponseCodeToString(int ResponseCode)
 	case Code_Unauthorized: return "401 Unauthorized"; break;
 	case Code_Forbidden: return "403 Forbidden"; break;
 	case Code_NotFound: return "404 Not Found"; break;
+	case Code_PayloadTooLarge: return "413 Payload Too Large"; break;
+	case Code_RangeNotSatisfiable: return "416 Range Not Satisfiable"; break;
 	case Code_InternalServerError: return "500 Internal Server Error"; break;
 	case Code_NotImplemented: return "501 Not Implemented"; break;
 	default:
@@ -136,33 +151,90 @@ void HTTPResponse::SetContentType(const char *ContentType)
 // --------------------------------------------------------------------------
 //
 // Function
-//		Name:    HTTPResponse::Send(IOStream &, bool)
+//		Name:    HTTPResponse::Send(bool)
 //		Purpose: Build the response, and send via the stream.
+//			 The content comes from the data stream, if one was
+//			 set, otherwise from the buffer.
 //		Created: 26/3/2004
 //
 // --------------------------------------------------------------------------
 void HTTPResponse::Send(bool OmitContent)
 {
+	SendHeaders(OmitContent);
+	while(SendMoreContent())
+	{
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPResponse::SendHeaders(bool)
+//		Purpose: Send the status line and headers of the response,
+//			 and its content too if it's small, leaving the rest
+//			 for SendMoreContent().
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void HTTPResponse::SendHeaders(bool OmitContent)
+{
+	mSendChunked = false;
+	mSendContentLeft = false;
+	mBufferBytesSent = 0;
+
 	if (!mpStreamToSendTo)
 	{
 		THROW_EXCEPTION(HTTPException, NoStreamConfigured);
 	}
 
-	if (GetSize() != 0 && mContentType.empty())
+	if ((GetSize() != 0 || mapDataStream.get()) && mContentType.empty())
 	{
 		THROW_EXCEPTION(HTTPException, NoContentTypeSet);
 	}
 
+	if (GetSize() != 0 && mapDataStream.get())
+	{
+		THROW_EXCEPTION_MESSAGE(HTTPException, Internal,
+			"Response has both buffered content and a data stream");
+	}
+
+	// The length of streamed content may not be known in advance, in
+	// which case it's chunked, or ended by closing the connection.
+	IOStream::pos_type contentLength = GetSize();
+	bool chunked = false;
+	if (mapDataStream.get())
+	{
+		contentLength = mapDataStream->BytesLeftToRead();
+		if (contentLength == IOStream::SizeOfStreamUnknown &&
+			!OmitContent)
+		{
+			if (mChunkedAllowed)
+			{
+				chunked = true;
+			}
+			else
+			{
+				mKeepAlive = false;
+			}
+		}
+	}
+
 	// Build and send header
 	{
 		std::string header("HTTP/1.1 ");
 		header += ResponseCodeToString(mResponseCode);
 		header += "\r\nContent-Type: ";
 		header += mContentType;
-		header += "\r\nContent-Length: ";
+		if (chunked)
+		{
+			header += "\r\nTransfer-Encoding: chunked";
+		}
+		else if (OmitContent || contentLength != IOStream::SizeOfStreamUnknown)
 		{
 			char len[32];
-			::sprintf(len, "%d", OmitContent?(0):(GetSize()));
+			::sprintf(len, "%lld", OmitContent ? 0LL :
+				(long long)contentLength);
+			header += "\r\nContent-Length: ";
 			header += len;
 		}
 		// Extra headers...
@@ -195,20 +267,109 @@ void HTTPResponse::Send(bool OmitContent)
 
 		// NOTE: header ends with blank line in all cases
 
+		// Small responses go out in a single write, so that a client
+		// on a kept-alive connection isn't left waiting for the body
+		// by Nagle's algorithm and delayed ACKs.
+		if(!OmitContent && !mapDataStream.get() &&
+			GetSize() <= HTTPRESPONSE_COALESCE_LIMIT)
+		{
+			header.append((const char *)GetBuffer(), GetSize());
+			mpStreamToSendTo->Write(header.c_str(), header.size());
+			return;
+		}
+
 		// Write to stream
 		mpStreamToSendTo->Write(header.c_str(), header.size());
 	}
 
-	// Send content
-	if(!OmitContent)
+	mSendChunked = chunked;
+	mSendContentLeft = !OmitContent;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPResponse::SendMoreContent(int)
+//		Purpose: After SendHeaders(), send up to MaxBytes more of
+//			 the content (plus chunk framing). Returns false
+//			 once all of it has been sent.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool HTTPResponse::SendMoreContent(int MaxBytes)
+{
+	if(!mSendContentLeft)
+	{
+		return false;
+	}
+
+	if(!mapDataStream.get())
 	{
-		mpStreamToSendTo->Write(GetBuffer(), GetSize());
+		IOStream::pos_type bytesToSend = GetSize() - mBufferBytesSent;
+		if(bytesToSend > MaxBytes)
+		{
+			bytesToSend = MaxBytes;
+		}
+		mpStreamToSendTo->Write((const char *)GetBuffer() +
+			mBufferBytesSent, bytesToSend);
+		mBufferBytesSent += bytesToSend;
+		mSendContentLeft = (mBufferBytesSent < GetSize());
+		return mSendContentLeft;
+	}
+
+	if(mapDataStream->StreamDataLeft())
+	{
+		MemoryBlockGuard<char*> buffer(MaxBytes);
+		int bytes = mapDataStream->Read(buffer, MaxBytes);
+		if(bytes > 0 && mSendChunked)
+		{
+			HTTPChunkedEncodeStream encoder(*mpStreamToSendTo);
+			encoder.Write(buffer, bytes);
+		}
+		else if(bytes > 0)
+		{
+			mpStreamToSendTo->Write(buffer, bytes);
+		}
+	}
+
+	if(!mapDataStream->StreamDataLeft())
+	{
+		if(mSendChunked)
+		{
+			HTTPChunkedEncodeStream encoder(*mpStreamToSendTo);
+			encoder.Close();
+		}
+		mSendContentLeft = false;
+	}
+
+	return mSendContentLeft;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPResponse::BufferDataStream()
+//		Purpose: Read all of the data stream, if one was set, into
+//			 the buffer, so that the response can be read or
+//			 copied like one whose content was written to it,
+//			 e.g. when it's handled in-process without being
+//			 sent anywhere.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void HTTPResponse::BufferDataStream()
+{
+	if(mapDataStream.get())
+	{
+		mapDataStream->CopyStreamTo(*this, IOStream::TimeOutInfinite,
+			HTTPRESPONSE_STREAM_BUFFER_SIZE);
+		mapDataStream.reset();
 	}
 }
 
 void HTTPResponse::SendContinue()
 {
-	mpStreamToSendTo->Write("HTTP/1.1 100 Continue\r\n");
+	mpStreamToSendTo->Write("HTTP/1.1 100 Continue\r\n\r\n");
 }
 
 // --------------------------------------------------------------------------
@@ -274,6 +435,20 @@ void HTTPResponse::ParseHeaders(IOStreamGetLine &rGetLine, int Timeout)
 				// Store
 				mContentLength = len;
 			}
+			else if(p == sizeof("Transfer-Encoding")-1
+				&& ::strncasecmp(h, "Transfer-Encoding", sizeof("Transfer-Encoding")-1) == 0)
+			{
+				// Only chunked is supported, on its own: we
+				// can't undo any other codings.
+				const char *v = h + dataStart;
+				if(::strcasecmp(v, "chunked") != 0)
+				{
+					THROW_EXCEPTION_MESSAGE(HTTPException,
+						NotImplemented, "Unsupported "
+						"Transfer-Encoding: " << v);
+				}
+				mChunked = true;
+			}
 			else if(p == sizeof("Content-Type")-1
 				&& ::strncasecmp(h, "Content-Type", sizeof("Content-Type")-1) == 0)
 			{
@@ -334,24 +509,62 @@ void HTTPResponse::ParseHeaders(IOStreamGetLine &rGetLine, int Timeout)
 	}
 }
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPResponse::Receive(IOStream &, int)
+//		Purpose: Read a response from a stream which will not be
+//			 used for anything else afterwards
+//		Created: 26/3/04
+//
+// --------------------------------------------------------------------------
 void HTTPResponse::Receive(IOStream& rStream, int Timeout)
 {
-	IOStreamGetLine rGetLine(rStream);
+	IOStreamGetLine getLine(rStream);
+	Receive(getLine, Timeout);
+}
 
-	if(rGetLine.IsEOF())
-	{
-		// Connection terminated unexpectedly
-		THROW_EXCEPTION_MESSAGE(HTTPException, BadResponse,
-			"HTTP server closed the connection without sending a response");
-	}
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPResponse::Receive(IOStreamGetLine &, int)
+//		Purpose: Read a response using a line reader which belongs
+//			 to the connection, so that any data read ahead of the
+//			 end of this response (the start of the next one on a
+//			 kept-alive or pipelined connection) stays in its
+//			 buffer for the next call. A response to a HEAD
+//			 request, or with a 1xx, 204 or 304 status, has no
+//			 body, whatever its Content-Length.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void HTTPResponse::Receive(IOStreamGetLine& rGetLine, int Timeout,
+	bool ResponseToHEAD)
+{
+	IOStream& rStream(rGetLine.GetUnderlyingStream());
 
 	std::string statusLine;
-	if(!rGetLine.GetLine(statusLine, false /* no preprocess */, Timeout))
+	do
 	{
-		// Timeout
-		THROW_EXCEPTION_MESSAGE(HTTPException, ResponseReadFailed,
-			"Failed to get a response from the HTTP server within the timeout");
+		if(rGetLine.IsEOF())
+		{
+			// Connection terminated unexpectedly
+			THROW_EXCEPTION_MESSAGE(HTTPException, BadResponse,
+				"HTTP server closed the connection without "
+				"sending a response");
+		}
+
+		if(!rGetLine.GetLine(statusLine, false /* no preprocess */, Timeout))
+		{
+			// Timeout
+			THROW_EXCEPTION_MESSAGE(HTTPException, ResponseReadFailed,
+				"Failed to get a response from the HTTP server "
+				"within the timeout");
+		}
 	}
+	// Skip the blank line which ends a 100 Continue response, which
+	// the last call didn't wait for.
+	while(statusLine.empty());
 
 	if (statusLine.substr(0, 7) != "HTTP/1." || statusLine[8] != ' ')
 	{
@@ -380,36 +593,76 @@ void HTTPResponse::Receive(IOStream& rStream, int Timeout)
 
 	ParseHeaders(rGetLine, Timeout);
 
-	// push back whatever bytes we have left
-	// rGetLine.DetachFile();
-	if (mContentLength > 0)
+	// Responses to HEAD, and 1xx, 204 and 304 responses, never have a
+	// body, whatever their headers say, and there's no connection close
+	// to mark its end (http://tools.ietf.org/html/rfc7230#section-3.3.3).
+	if(ResponseToHEAD || (status >= 100 && status < 200) ||
+		status == Code_NoContent || status == Code_NotModified)
+	{
+		SetForReading();
+		return;
+	}
+
+	// A chunked body ends with its last chunk, whatever the
+	// Content-Length (http://tools.ietf.org/html/rfc7230#section-3.3.3).
+	if(mChunked)
 	{
-		if (mContentLength < rGetLine.GetSizeOfBufferedData())
+		HTTPChunkedDecodeStream decoder(rGetLine);
+		if(!decoder.CopyStreamTo(*this, Timeout,
+			HTTPRESPONSE_STREAM_BUFFER_SIZE))
 		{
-			// very small response, not good!
-			THROW_EXCEPTION(HTTPException, NotImplemented);
+			THROW_EXCEPTION_MESSAGE(HTTPException,
+				ResponseReadFailed, "HTTP server "
+				"did not send the whole response");
 		}
+		mContentLength = GetSize();
+		SetForReading();
+		return;
+	}
 
-		mContentLength -= rGetLine.GetSizeOfBufferedData();
-
-		Write(rGetLine.GetBufferedData(),
-			rGetLine.GetSizeOfBufferedData());
+	// Take the start of the body from whatever was read ahead with the
+	// headers, leaving anything beyond its end (the next response) there.
+	// Without a Content-Length the body runs until the connection closes.
+	int64_t bytesLeft = mContentLength;
+	{
+		int bytesToCopy = rGetLine.GetSizeOfBufferedData();
+		if(bytesLeft >= 0 && bytesLeft < bytesToCopy)
+		{
+			bytesToCopy = bytesLeft;
+		}
+		Write(rGetLine.GetBufferedData(), bytesToCopy);
+		rGetLine.IgnoreBufferedData(bytesToCopy);
+		if(bytesLeft > 0)
+		{
+			bytesLeft -= bytesToCopy;
+		}
 	}
 
-	while (mContentLength != 0) // could be -1 as well
+	while (bytesLeft != 0) // could be -1 as well
 	{
 		char buffer[4096];
 		int readSize = sizeof(buffer);
-		if (mContentLength > 0 && mContentLength < readSize)
+		if (bytesLeft > 0 && bytesLeft < readSize)
 		{
-			readSize = mContentLength;
+			readSize = bytesLeft;
 		}
 		readSize = rStream.Read(buffer, readSize, Timeout);
 		if (readSize == 0)
 		{
+			if(bytesLeft > 0)
+			{
+				// Leaving the rest unread would corrupt the
+				// next response on this connection.
+				THROW_EXCEPTION_MESSAGE(HTTPException,
+					ResponseReadFailed, "HTTP server "
+					"did not send the whole response");
+			}
 			break;
 		}
-		mContentLength -= readSize;
+		if(bytesLeft > 0)
+		{
+			bytesLeft -= readSize;
+		}
 		Write(buffer, readSize);
 	}
 
@@ -10,13 +10,21 @@
 #ifndef HTTPRESPONSE__H
 #define HTTPRESPONSE__H
 
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "CollectInBufferStream.h"
+#include "autogen_HTTPException.h"
 
 class IOStreamGetLine;
 
+// Bodies up to this size are sent in the same write as the headers
+#define HTTPRESPONSE_COALESCE_LIMIT	(16*1024)
+
+// Streamed and chunked content is copied in blocks of this size
+#define HTTPRESPONSE_STREAM_BUFFER_SIZE	(64*1024)
+
 // --------------------------------------------------------------------------
 //
 // Class
@@ -34,25 +42,44 @@ public:
 
 	// allow copying, but be very careful with the response stream,
 	// you can only read it once! (this class doesn't police it).
+	// Responses with a data stream can't be copied at all.
 	HTTPResponse(const HTTPResponse& rOther)
 	: mResponseCode(rOther.mResponseCode),
 	  mResponseIsDynamicContent(rOther.mResponseIsDynamicContent),
 	  mKeepAlive(rOther.mKeepAlive),
+	  mChunkedAllowed(rOther.mChunkedAllowed),
+	  mChunked(rOther.mChunked),
+	  mSendChunked(false),
+	  mSendContentLeft(false),
+	  mBufferBytesSent(0),
 	  mContentType(rOther.mContentType),
 	  mExtraHeaders(rOther.mExtraHeaders),
 	  mContentLength(rOther.mContentLength),
 	  mpStreamToSendTo(rOther.mpStreamToSendTo)
 	{
+		if (rOther.mapDataStream.get())
+		{
+			THROW_EXCEPTION(HTTPException,
+				CannotCopyResponseWithStream);
+		}
 		Write(rOther.GetBuffer(), rOther.GetSize());
 	}
 		
 	HTTPResponse &operator=(const HTTPResponse &rOther)
 	{
+		if (rOther.mapDataStream.get())
+		{
+			THROW_EXCEPTION(HTTPException,
+				CannotCopyResponseWithStream);
+		}
 		Reset();
+		mapDataStream.reset();
 		Write(rOther.GetBuffer(), rOther.GetSize());
 		mResponseCode = rOther.mResponseCode;
 		mResponseIsDynamicContent = rOther.mResponseIsDynamicContent;
 		mKeepAlive = rOther.mKeepAlive;
+		mChunkedAllowed = rOther.mChunkedAllowed;
+		mChunked = rOther.mChunked;
 		mContentType = rOther.mContentType;
 		mExtraHeaders = rOther.mExtraHeaders;
 		mContentLength = rOther.mContentLength;
@@ -71,9 +98,31 @@ public:
 	void SetAsRedirect(const char *RedirectTo, bool IsLocalURI = true);
 	void SetAsNotFound(const char *URI);
 
+	// The content can come from a stream instead of the buffer, so that
+	// large responses are sent without holding them in memory. If the
+	// stream's size isn't known, it's sent with chunked encoding, or
+	// to clients that don't support that, by closing the connection.
+	void SetDataStream(std::auto_ptr<IOStream> apStream)
+	{
+		mapDataStream = apStream;
+	}
+	bool HasDataStream() const { return mapDataStream.get() != NULL; }
+	void BufferDataStream();
+	void SetChunkedEncodingAllowed(bool Allowed)
+	{
+		mChunkedAllowed = Allowed;
+	}
+
 	void Send(bool OmitContent = false);
+	// For sending without waiting for the connection, a piece at a time,
+	// call SendHeaders(), then SendMoreContent() until it returns false.
+	void SendHeaders(bool OmitContent = false);
+	bool SendMoreContent(int MaxBytes = HTTPRESPONSE_STREAM_BUFFER_SIZE);
 	void SendContinue();
 	void Receive(IOStream& rStream, int Timeout = IOStream::TimeOutInfinite);
+	void Receive(IOStreamGetLine& rGetLine,
+		int Timeout = IOStream::TimeOutInfinite,
+		bool ResponseToHEAD = false);
 
 	// void AddHeader(const char *EntireHeaderLine);
 	// void AddHeader(const std::string &rEntireHeaderLine);
@@ -116,6 +165,7 @@ public:
 	{
 		Code_OK = 200,
 		Code_NoContent = 204,
+		Code_PartialContent = 206,
 		Code_MovedPermanently = 301,
 		Code_Found = 302,	// redirection
 		Code_NotModified = 304,
@@ -124,6 +174,8 @@ public:
 		Code_Unauthorized = 401,
 		Code_Forbidden = 403,
 		Code_NotFound = 404,
+		Code_PayloadTooLarge = 413,
+		Code_RangeNotSatisfiable = 416,
 		Code_InternalServerError = 500,
 		Code_NotImplemented = 501
 	};
@@ -163,10 +215,16 @@ private:
 	int mResponseCode;
 	bool mResponseIsDynamicContent;
 	bool mKeepAlive;
+	bool mChunkedAllowed;
+	bool mChunked; // only used when reading response from stream
+	bool mSendChunked; // state of a response being sent in pieces
+	bool mSendContentLeft;
+	IOStream::pos_type mBufferBytesSent;
 	std::string mContentType;
 	std::vector<Header> mExtraHeaders;
 	int64_t mContentLength; // only used when reading response from stream
 	IOStream* mpStreamToSendTo; // nonzero only when constructed with a stream
+	std::auto_ptr<IOStream> mapDataStream;
 
 	static std::string msDefaultURIPrefix;
 
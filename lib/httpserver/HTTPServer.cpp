@@ -9,16 +9,200 @@
 
 #include "Box.h"
 
+#include <errno.h>
 #include <stdio.h>
+#include <string.h>
 
+#ifndef WIN32
+	#include <fcntl.h>
+	#include <poll.h>
+	#include <sys/wait.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+	#include <unistd.h>
+#endif
+
+#include "autogen_HTTPException.h"
+#include "autogen_ServerException.h"
+#include "BoxTime.h"
+#include "CollectInBufferStream.h"
 #include "HTTPServer.h"
 #include "HTTPRequest.h"
 #include "HTTPResponse.h"
 #include "IOStreamGetLine.h"
+#include "MemBlockStream.h"
 
 #include "MemLeakFindOn.h"
 
 
+#ifndef WIN32
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    HTTPEventConnection
+//		Purpose: The state of one connection to an event-driven
+//			 HTTPServer: the request data received so far, the
+//			 response still to be sent, and the child process
+//			 handling a request, if there is one.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class HTTPEventConnection
+{
+public:
+	HTTPEventConnection(std::auto_ptr<SocketStream> apSocket)
+	: mapSocket(apSocket),
+	  mOutputSent(0),
+	  mReadClosed(false),
+	  mCloseAfterOutput(false),
+	  mLastActivity(GetCurrentBoxTime()),
+	  mEvents(0),
+	  mWorkerPid(0),
+	  mWorkerResultFd(-1)
+	{ }
+
+	~HTTPEventConnection()
+	{
+		if(mWorkerResultFd != -1)
+		{
+			::close(mWorkerResultFd);
+		}
+	}
+
+	bool HasOutput()
+	{
+		return mOutputSent < mOutput.GetSize() || mapResponse.get();
+	}
+
+	bool WantsInput()
+	{
+		// Stop reading if a client sends more than we can handle
+		// before reading the responses, until it has caught up.
+		// A child process handling a request reads the socket
+		// itself until it has finished.
+		return !mReadClosed && !mCloseAfterOutput && mWorkerPid == 0 &&
+			mInput.size() <= HTTPSERVER_MAX_BUFFERED_INPUT;
+	}
+
+	// The poll() events to wait for
+	short GetWantedEvents()
+	{
+		if(mWorkerPid != 0)
+		{
+			// For the result of the child process
+			return POLLIN;
+		}
+		return (WantsInput() ? POLLIN : 0) | (HasOutput() ? POLLOUT : 0);
+	}
+
+	// For adding to WaitForEvent, with the events to wait for as the
+	// flags. While a child process is handling a request, that's its
+	// result pipe rather than the socket.
+#ifdef HAVE_KQUEUE
+	void FillInKEvent(struct kevent &rEvent, int Flags = 0) const
+	{
+		if(mWorkerResultFd != -1)
+		{
+			EV_SET(&rEvent, mWorkerResultFd, EVFILT_READ, 0, 0, 0,
+				(void*)this);
+		}
+		else
+		{
+			EV_SET(&rEvent, mapSocket->GetSocketHandle(),
+				(Flags & POLLOUT) ? EVFILT_WRITE : EVFILT_READ,
+				0, 0, 0, (void*)this);
+		}
+	}
+#else
+	void FillInPoll(int &fd, short &events, int Flags = 0) const
+	{
+		fd = (mWorkerResultFd != -1) ? mWorkerResultFd :
+			mapSocket->GetSocketHandle();
+		events = Flags;
+	}
+#endif
+
+	std::auto_ptr<SocketStream> mapSocket;
+	std::string mInput;
+	CollectInBufferStream mOutput;
+	int mOutputSent;
+	std::auto_ptr<HTTPResponse> mapResponse;
+	bool mReadClosed;
+	bool mCloseAfterOutput;
+	box_time_t mLastActivity;
+	// The events it's registered with the WaitForEvent to wait for
+	short mEvents;
+	// The child process handling a request, and the pipe it writes its
+	// result to
+	pid_t mWorkerPid;
+	int mWorkerResultFd;
+};
+
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    HTTPBufferedInputStream
+//		Purpose: Reads the data which an event-driven HTTPServer had
+//			 already received on a connection, and then the rest
+//			 from the connection itself, so that a child process
+//			 can carry on reading requests where it left off.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class HTTPBufferedInputStream : public IOStream
+{
+public:
+	HTTPBufferedInputStream(const std::string &rBuffered, IOStream &rStream)
+	: mrBuffered(rBuffered),
+	  mBufferedPos(0),
+	  mrStream(rStream)
+	{ }
+
+	virtual int Read(void *pBuffer, int NBytes,
+		int Timeout = IOStream::TimeOutInfinite)
+	{
+		if(mBufferedPos < mrBuffered.size())
+		{
+			int bytes = mrBuffered.size() - mBufferedPos;
+			if(bytes > NBytes) bytes = NBytes;
+			::memcpy(pBuffer, mrBuffered.c_str() + mBufferedPos,
+				bytes);
+			mBufferedPos += bytes;
+			return bytes;
+		}
+		return mrStream.Read(pBuffer, NBytes, Timeout);
+	}
+	virtual void Write(const void *pBuffer, int NBytes,
+		int Timeout = IOStream::TimeOutInfinite)
+	{
+		mrStream.Write(pBuffer, NBytes, Timeout);
+	}
+	virtual bool StreamDataLeft()
+	{
+		return mBufferedPos < mrBuffered.size() ||
+			mrStream.StreamDataLeft();
+	}
+	virtual bool StreamClosed()
+	{
+		return mrStream.StreamClosed();
+	}
+
+	// The part of the buffered data not read yet
+	std::string GetUnreadBufferedData() const
+	{
+		return mrBuffered.substr(mBufferedPos);
+	}
+
+private:
+	const std::string &mrBuffered;
+	std::string::size_type mBufferedPos;
+	IOStream &mrStream;
+};
+#endif // !WIN32
+
+
 // --------------------------------------------------------------------------
 //
 // Function
@@ -28,7 +212,10 @@
 //
 // --------------------------------------------------------------------------
 HTTPServer::HTTPServer(int Timeout)
-: mTimeout(Timeout)
+: mTimeout(Timeout),
+  mEventDriven(false),
+  mpConnectionWait(NULL),
+  mLastIdleCheck(0)
 {
 }
 
@@ -43,6 +230,14 @@ HTTPServer::HTTPServer(int Timeout)
 // --------------------------------------------------------------------------
 HTTPServer::~HTTPServer()
 {
+#ifndef WIN32
+	for(std::set<HTTPEventConnection *>::iterator
+		i = mEventConnections.begin();
+		i != mEventConnections.end(); i++)
+	{
+		delete *i;
+	}
+#endif
 }
 
 
@@ -119,6 +314,12 @@ void HTTPServer::Run()
 	const Configuration &conf(GetConfiguration());
 	HTTPResponse::SetDefaultURIPrefix(conf.GetKeyValue("AddressPrefix"));
 
+#ifndef WIN32
+	const Configuration &server(conf.GetSubConfiguration("Server"));
+	mEventDriven = server.KeyExists("EventDriven") &&
+		server.GetKeyValueBool("EventDriven");
+#endif
+
 	// Let the base class do the work
 	ServerStream<SocketStream, 80>::Run();
 }
@@ -134,70 +335,737 @@ void HTTPServer::Run()
 // --------------------------------------------------------------------------
 void HTTPServer::Connection(std::auto_ptr<SocketStream> apConn)
 {
+	if(mEventDriven)
+	{
+		// Served from WaitForConnection() from now on, which is
+		// what accepted it, so has set mpConnectionWait
+		ASSERT(mpConnectionWait != NULL);
+		HTTPConnectionOpening();
+		std::auto_ptr<HTTPEventConnection> apEventConn(
+			new HTTPEventConnection(apConn));
+		apEventConn->mEvents = POLLIN;
+		mpConnectionWait->Add(apEventConn.get(), apEventConn->mEvents,
+			WaitForEvent::EdgeTriggered);
+		mEventConnections.insert(apEventConn.release());
+		return;
+	}
+
 	// Create a get line object to use
 	IOStreamGetLine getLine(*apConn);
 
 	// Notify dervived claases
 	HTTPConnectionOpening();
 
-	bool handleRequests = true;
-	while(handleRequests)
+	while(ServeRequest(getLine, *apConn))
 	{
-		// Parse the request
-		HTTPRequest request;
-		if(!request.Receive(getLine, mTimeout))
+	}
+
+	// Notify derived classes
+	HTTPConnectionClosing();
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPServer::ServeRequest(IOStreamGetLine &, IOStream &)
+//		Purpose: Receives a request from a connection, handles it
+//			 and sends the response, waiting for the client as
+//			 necessary. Returns true if the connection can be
+//			 used for another request.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool HTTPServer::ServeRequest(IOStreamGetLine &rGetLine, IOStream &rConn)
+{
+	// Parse the request
+	HTTPRequest request;
+	try
+	{
+		if(!request.Receive(rGetLine, mTimeout))
 		{
 			// Didn't get request, connection probably closed.
-			break;
+			return false;
+		}
+	}
+	catch(HTTPException &e)
+	{
+		if(e.GetSubType() != HTTPException::NotImplemented)
+		{
+			throw;
 		}
 
-		// Generate a response
-		HTTPResponse response(apConn.get());
+		// We can't tell where its content ends, so refuse it and
+		// close the connection.
+		HTTPResponse response(&rConn);
+		SendNotImplementedResponse(e, response);
+		response.Send();
+		return false;
+	}
+
+	// Generate a response
+	HTTPResponse response(&rConn);
+	HandleRequest(request, response);
+
+	// Keep alive? The end of the response is marked by its
+	// Content-Length or by chunked encoding, so the connection can be
+	// reused (http://tools.ietf.org/html/rfc7230#section-3.3.3). But if
+	// the handler didn't read all of the request content (for example
+	// it rejected a PUT without sending 100 Continue) then the rest of
+	// it is still on the connection, where it would be mistaken for the
+	// next request, so close instead.
+	bool keepAlive = request.GetClientKeepAliveRequested() &&
+		!request.HasUnreadContent();
+	if(keepAlive)
+	{
+		// Mark the response to the client as supporting keepalive
+		response.SetKeepAlive(true);
+	}
+
+	// Send the response (omit any content if this is a HEAD method request)
+	response.Send(request.GetMethod() == HTTPRequest::Method_HEAD);
+
+	// Unless its end could only be marked by closing the connection
+	return keepAlive && response.IsKeepAlive();
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPServer::HandleRequest(HTTPRequest &,
+//			 HTTPResponse &)
+//		Purpose: Calls the derived class to fill in the response to
+//			 a request, or an error page if it fails.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void HTTPServer::HandleRequest(HTTPRequest &rRequest, HTTPResponse &rResponse)
+{
+	// Content streamed without a known size is sent chunked, but
+	// HTTP/1.0 clients don't understand that.
+	rResponse.SetChunkedEncodingAllowed(rRequest.GetHTTPVersion() >=
+		HTTPRequest::HTTPVersion_1_1);
+
+	try
+	{
+		Handle(rRequest, rResponse);
+	}
+	catch(BoxException &e)
+	{
+		char exceptionCode[256];
+		::sprintf(exceptionCode, "%s (%d/%d)", e.what(),
+			e.GetType(), e.GetSubType());
+		SendInternalErrorResponse(exceptionCode, rResponse);
+	}
+	catch(...)
+	{
+		SendInternalErrorResponse("unknown", rResponse);
+	}
+}
+
+
+#ifndef WIN32
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPServer::NotifyListenerIsReady()
+//		Purpose: An event-driven server may be told that a
+//			 connection is waiting which another worker process
+//			 then accepts first, and mustn't wait for another
+//			 one then, so make the listening sockets non-blocking.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void HTTPServer::NotifyListenerIsReady()
+{
+	// There's a new WaitForEvent, which any connections still open
+	// from before the configuration was reloaded need adding to.
+	mpConnectionWait = NULL;
+
+	if(!mEventDriven)
+	{
+		return;
+	}
+
+	const std::vector<SocketListen<SocketStream> *> &rSockets(
+		GetListeningSockets());
+	for(size_t i = 0; i < rSockets.size(); i++)
+	{
+		rSockets[i]->SetNonBlocking();
+	}
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPServer::WaitForConnection(WaitForEvent &)
+//		Purpose: In event-driven mode, waits for new connections and
+//			 for any of the existing ones to become readable or
+//			 writable, and serves the one which does. Returns a
+//			 listening socket with a new connection waiting, or
+//			 NULL.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void *HTTPServer::WaitForConnection(WaitForEvent &rConnectionWait)
+{
+	if(!mEventDriven)
+	{
+		return rConnectionWait.Wait();
+	}
+
+	if(mpConnectionWait == NULL)
+	{
+		// The connections stay registered with the listening
+		// sockets until they're closed, so that waiting doesn't
+		// take longer the more of them there are.
+		mpConnectionWait = &rConnectionWait;
+		for(std::set<HTTPEventConnection *>::iterator
+			i = mEventConnections.begin();
+			i != mEventConnections.end(); i++)
+		{
+			rConnectionWait.Add(*i, (*i)->mEvents,
+				WaitForEvent::EdgeTriggered);
+		}
+	}
+	ASSERT(mpConnectionWait == &rConnectionWait);
+
+	// Wakes up at least once a second, as the base class would, to
+	// check whether we've been asked to stop.
+	void *pReady = rConnectionWait.Wait();
+	box_time_t now = GetCurrentBoxTime();
+
+	std::set<HTTPEventConnection *>::iterator i =
+		mEventConnections.find((HTTPEventConnection *)pReady);
+	if(i != mEventConnections.end())
+	{
+		HTTPEventConnection *pConn = *i;
+		pConn->mLastActivity = now;
+		if(!ServeEventConnection(*pConn))
+		{
+			CloseEventConnection(pConn);
+		}
+		pReady = NULL;
+	}
+
+	// Which means looking at all of them, so not too often
+	if(now - mLastIdleCheck >= (box_time_t)MilliSecondsToBoxTime(1000))
+	{
+		CloseIdleEventConnections(now);
+		mLastIdleCheck = now;
+	}
 
+	// Either a listening socket, or NULL
+	return pReady;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPServer::ServeEventConnection(
+//			 HTTPEventConnection &)
+//		Purpose: Reads whatever a connection has received, and
+//			 handles and answers whatever requests can be, as
+//			 far as possible without blocking. Returns false if
+//			 it should be closed.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool HTTPServer::ServeEventConnection(HTTPEventConnection &rConn)
+{
+	try
+	{
+		if(rConn.mWorkerPid != 0)
+		{
+			// The child process handling its last request has
+			// finished with it.
+			if(!FinishEventWorker(rConn))
+			{
+				return false;
+			}
+		}
+
+		// It's waited for edge-triggered, so we won't be told
+		// about this data again: read all of it.
+		while(rConn.WantsInput())
+		{
+			char buffer[16384];
+			int bytes = rConn.mapSocket->Read(buffer, sizeof(buffer),
+				0);
+			rConn.mInput.append(buffer, bytes);
+			if(!rConn.mapSocket->StreamDataLeft())
+			{
+				rConn.mReadClosed = true;
+			}
+			else if(bytes < (int)sizeof(buffer))
+			{
+				// Nothing more for now
+				break;
+			}
+		}
+
+		ServiceEventConnection(rConn);
+
+		if((rConn.mCloseAfterOutput || rConn.mReadClosed) &&
+			!rConn.HasOutput() && rConn.mWorkerPid == 0)
+		{
+			return false;
+		}
+
+		// Adding it again with different events tells us straight
+		// away if it's ready for them, so nothing can be missed.
+		short events = rConn.GetWantedEvents();
+		if(events != rConn.mEvents)
+		{
+			mpConnectionWait->Remove(&rConn, rConn.mEvents);
+			rConn.mEvents = events;
+			mpConnectionWait->Add(&rConn, rConn.mEvents,
+				WaitForEvent::EdgeTriggered);
+		}
+	}
+	catch(BoxException &e)
+	{
+		BOX_ERROR("Error in HTTP connection handler, terminating "
+			"connection: exception " << e.what() << "(" <<
+			e.GetType() << "/" << e.GetSubType() << ")");
+		return false;
+	}
+
+	return true;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPServer::CloseIdleEventConnections(box_time_t)
+//		Purpose: Closes the connections which haven't been ready
+//			 for longer than the timeout. A child process
+//			 handling a request has its own timeouts.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void HTTPServer::CloseIdleEventConnections(box_time_t Now)
+{
+	box_time_t timeout = MilliSecondsToBoxTime(mTimeout);
+	std::vector<HTTPEventConnection *> idle;
+
+	for(std::set<HTTPEventConnection *>::iterator
+		i = mEventConnections.begin();
+		i != mEventConnections.end(); i++)
+	{
+		if((*i)->mWorkerPid == 0 &&
+			Now - (*i)->mLastActivity > timeout)
+		{
+			idle.push_back(*i);
+		}
+	}
+
+	for(size_t i = 0; i < idle.size(); i++)
+	{
+		BOX_TRACE("Closing idle HTTP connection");
+		CloseEventConnection(idle[i]);
+	}
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPServer::ServiceEventConnection(
+//			 HTTPEventConnection &)
+//		Purpose: Sends as much of the pending output on a
+//			 connection as it will take without blocking, and
+//			 handles the requests waiting to be answered after
+//			 it, one at a time.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void HTTPServer::ServiceEventConnection(HTTPEventConnection &rConn)
+{
+	do
+	{
+		SendEventOutput(rConn);
+		if(rConn.HasOutput() || rConn.mCloseAfterOutput)
+		{
+			// Wait until the client has read it
+			return;
+		}
+	}
+	while(HandleEventRequest(rConn));
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPServer::HandleEventRequest(HTTPEventConnection &)
+//		Purpose: If the first request in the input of a connection
+//			 has arrived completely and has no content, handles
+//			 it and starts to send the response. Hands one with
+//			 content to a child process as soon as its headers
+//			 have arrived. Returns true if there may now be
+//			 output to send.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool HTTPServer::HandleEventRequest(HTTPEventConnection &rConn)
+{
+	bool expectsContinue = false, hasContent = false;
+	int size = HTTPRequest::GetSizeOfCompleteRequest(rConn.mInput.c_str(),
+		rConn.mInput.size(), expectsContinue, &hasContent);
+
+	if(hasContent)
+	{
+		// Reading it, and whatever the handler does with it, may
+		// take a long time, and any 100 Continue is up to the
+		// handler.
+		StartEventWorker(rConn);
+		return false;
+	}
+
+	if(size == 0)
+	{
+		if(rConn.mInput.size() > HTTPSERVER_MAX_BUFFERED_INPUT)
+		{
+			BOX_WARNING("Refusing HTTP request with more than " <<
+				HTTPSERVER_MAX_BUFFERED_INPUT << " bytes of "
+				"headers");
+			HTTPResponse response(&rConn.mOutput);
+			response.SetResponseCode(HTTPResponse::Code_PayloadTooLarge);
+			SendInternalErrorResponse("request too large", response);
+			response.Send();
+			rConn.mInput.clear();
+			rConn.mCloseAfterOutput = true;
+			return true;
+		}
+
+		return false;
+	}
+
+	std::auto_ptr<HTTPResponse> apResponse(new HTTPResponse(&rConn.mOutput));
+
+	{
+		MemBlockStream requestData(rConn.mInput.c_str(), size);
+		IOStreamGetLine getLine(requestData);
+		HTTPRequest request;
 		try
 		{
-			Handle(request, response);
+			request.Receive(getLine, mTimeout);
+		}
+		catch(HTTPException &e)
+		{
+			if(e.GetSubType() != HTTPException::NotImplemented)
+			{
+				throw;
+			}
+
+			// We can't tell where its content ends
+			SendNotImplementedResponse(e, *apResponse);
+			apResponse->SendHeaders();
+			rConn.mapResponse = apResponse;
+			rConn.mInput.clear();
+			rConn.mCloseAfterOutput = true;
+			return true;
+		}
+
+		// There's no content for the client to wait to send
+		request.SetExpectingContinue(false);
+
+		HandleRequest(request, *apResponse);
+
+		// All of the request has been received, so the connection can
+		// always be reused.
+		if(request.GetClientKeepAliveRequested())
+		{
+			apResponse->SetKeepAlive(true);
+		}
+
+		// The content is sent later, when the client is ready for it
+		apResponse->SendHeaders(request.GetMethod() ==
+			HTTPRequest::Method_HEAD);
+	}
+
+	rConn.mInput.erase(0, size);
+
+	if(!apResponse->IsKeepAlive())
+	{
+		rConn.mCloseAfterOutput = true;
+	}
+
+	rConn.mapResponse = apResponse;
+	return true;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPServer::StartEventWorker(HTTPEventConnection &)
+//		Purpose: Forks a child process to receive and handle the
+//			 request at the start of the input of a connection,
+//			 reading its content from the socket as the handler
+//			 wants it, and to send the response. Stops serving
+//			 the connection until the child has finished.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void HTTPServer::StartEventWorker(HTTPEventConnection &rConn)
+{
+	int fds[2];
+	if(::pipe(fds) != 0)
+	{
+		THROW_SYS_ERROR("Failed to create pipe for HTTP request "
+			"process", ServerException, SocketPairFailed);
+	}
+
+	pid_t pid = ::fork();
+	if(pid == -1)
+	{
+		int error = errno;
+		::close(fds[0]);
+		::close(fds[1]);
+		THROW_SYS_ERROR_NUMBER("Failed to fork HTTP request process",
+			error, ServerException, ServerForkError);
+	}
+
+	if(pid == 0)
+	{
+		// Child process, which must not return to the event loop.
+		::close(fds[0]);
+
+		// Nor keep the other connections open after the parent
+		// closes them.
+		for(std::set<HTTPEventConnection *>::iterator
+			i = mEventConnections.begin();
+			i != mEventConnections.end(); i++)
+		{
+			if(*i != &rConn)
+			{
+				(*i)->mapSocket->Close();
+			}
+		}
+
+		// Accepted sockets may inherit O_NONBLOCK from the
+		// listening socket, but the handler needs to wait for the
+		// client. The parent doesn't read or write it meanwhile.
+		int sock = rConn.mapSocket->GetSocketHandle();
+		int flags = ::fcntl(sock, F_GETFL);
+		if(flags != -1 && (flags & O_NONBLOCK))
+		{
+			::fcntl(sock, F_SETFL, flags & ~O_NONBLOCK);
+		}
+
+		// Whether the connection can be reused, and then any
+		// data following the request which was read already
+		int32_t keepAlive = 0;
+		std::string leftOver;
+		try
+		{
+			HTTPBufferedInputStream input(rConn.mInput,
+				*rConn.mapSocket);
+			IOStreamGetLine getLine(input);
+			if(ServeRequest(getLine, *rConn.mapSocket))
+			{
+				keepAlive = 1;
+				leftOver.assign(
+					(const char *)getLine.GetBufferedData(),
+					getLine.GetSizeOfBufferedData());
+				leftOver += input.GetUnreadBufferedData();
+			}
 		}
 		catch(BoxException &e)
 		{
-			char exceptionCode[256];
-			::sprintf(exceptionCode, "%s (%d/%d)", e.what(),
-				e.GetType(), e.GetSubType());
-			SendInternalErrorResponse(exceptionCode, response);
+			BOX_ERROR("Error in HTTP request process, terminating "
+				"connection: exception " << e.what() << "(" <<
+				e.GetType() << "/" << e.GetSubType() << ")");
 		}
 		catch(...)
 		{
-			SendInternalErrorResponse("unknown", response);
+			BOX_ERROR("Error in HTTP request process, terminating "
+				"connection: unknown exception");
 		}
 
-		// Keep alive? response.GetSize() works for CollectInBufferStream, but
-		// when we make HTTPResponse stream the response instead, we'll need to
-		// figure out whether we can get the response length from the IOStream
-		// to be streamed, or not. Also, we don't currently support chunked
-		// encoding, and http://tools.ietf.org/html/rfc7230#section-3.3.1 says
-		// that "If any transfer coding other than chunked is applied to a
-		// response payload body, the sender MUST either apply chunked as the
-		// final transfer coding or terminate the message by closing the
-		// connection. So for now, keepalive stays off.
-		if(false && request.GetClientKeepAliveRequested() &&
-			response.GetSize() >= 0)
+		std::string result(sizeof(keepAlive), '\0');
+		keepAlive = htonl(keepAlive);
+		::memcpy(&result[0], &keepAlive, sizeof(keepAlive));
+		result += leftOver;
+
+		const char *pData = result.c_str();
+		int bytesLeft = result.size();
+		while(bytesLeft > 0)
 		{
-			// Mark the response to the client as supporting keepalive
-			response.SetKeepAlive(true);
+			int written = ::write(fds[1], pData, bytesLeft);
+			if(written == -1 && errno == EINTR)
+			{
+				continue;
+			}
+			if(written <= 0)
+			{
+				break;
+			}
+			pData += written;
+			bytesLeft -= written;
 		}
-		else
+
+		// Without running the destructors of objects which belong
+		// to the parent.
+		::_exit(0);
+	}
+
+	// Parent process
+	::close(fds[1]);
+	BOX_TRACE("Forked child process " << pid << " to handle HTTP "
+		"request");
+
+	// Wait for the child's result instead of the socket
+	mpConnectionWait->Remove(&rConn, rConn.mEvents);
+	rConn.mInput.clear();
+	rConn.mWorkerPid = pid;
+	rConn.mWorkerResultFd = fds[0];
+	rConn.mEvents = rConn.GetWantedEvents();
+	mpConnectionWait->Add(&rConn, rConn.mEvents,
+		WaitForEvent::EdgeTriggered);
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPServer::FinishEventWorker(HTTPEventConnection &)
+//		Purpose: Collects the result of the child process which
+//			 handled a request on a connection, once it has
+//			 written it, and starts serving the connection again.
+//			 Returns false if it should be closed.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool HTTPServer::FinishEventWorker(HTTPEventConnection &rConn)
+{
+	// The child writes its result just before it exits, so reading to
+	// the end doesn't wait for long.
+	std::string result;
+	while(true)
+	{
+		char buffer[4096];
+		int bytes = ::read(rConn.mWorkerResultFd, buffer,
+			sizeof(buffer));
+		if(bytes == -1 && errno == EINTR)
 		{
-			// Stop now
-			handleRequests = false;
+			continue;
 		}
-	
-		// Send the response (omit any content if this is a HEAD method request)
-		response.Send(request.GetMethod() == HTTPRequest::Method_HEAD);
+		if(bytes <= 0)
+		{
+			break;
+		}
+		result.append(buffer, bytes);
+	}
+
+	// Before the pipe is closed
+	mpConnectionWait->Remove(&rConn, rConn.mEvents);
+	::close(rConn.mWorkerResultFd);
+	rConn.mWorkerResultFd = -1;
+
+	int status = 0;
+	while(::waitpid(rConn.mWorkerPid, &status, 0) == -1 &&
+		errno == EINTR)
+	{
 	}
+	rConn.mWorkerPid = 0;
+
+	rConn.mEvents = POLLIN;
+	mpConnectionWait->Add(&rConn, rConn.mEvents,
+		WaitForEvent::EdgeTriggered);
+
+	int32_t keepAlive = 0;
+	if(result.size() < sizeof(keepAlive))
+	{
+		BOX_ERROR("HTTP request process failed");
+		return false;
+	}
+
+	::memcpy(&keepAlive, result.c_str(), sizeof(keepAlive));
+	if(ntohl(keepAlive) == 0)
+	{
+		return false;
+	}
+
+	// Any more requests which it had read already
+	rConn.mInput = result.substr(sizeof(keepAlive));
+	return true;
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPServer::SendEventOutput(HTTPEventConnection &)
+//		Purpose: Writes the output waiting on a connection, and the
+//			 rest of the response that it came from, until
+//			 either is finished or the socket would block.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void HTTPServer::SendEventOutput(HTTPEventConnection &rConn)
+{
+	while(true)
+	{
+		if(rConn.mOutputSent == rConn.mOutput.GetSize())
+		{
+			rConn.mOutput.Reset();
+			rConn.mOutputSent = 0;
+
+			if(!rConn.mapResponse.get())
+			{
+				return;
+			}
+
+			if(!rConn.mapResponse->SendMoreContent())
+			{
+				rConn.mapResponse.reset();
+			}
+
+			if(rConn.mOutput.GetSize() == 0)
+			{
+				return;
+			}
+		}
+
+		int sent = rConn.mapSocket->WriteWithoutBlocking(
+			(const char *)rConn.mOutput.GetBuffer() + rConn.mOutputSent,
+			rConn.mOutput.GetSize() - rConn.mOutputSent);
+		if(sent == 0)
+		{
+			// Wait until the socket is writable again
+			return;
+		}
+		rConn.mOutputSent += sent;
+	}
+}
+
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPServer::CloseEventConnection(HTTPEventConnection *)
+//		Purpose: Closes and deletes a connection
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void HTTPServer::CloseEventConnection(HTTPEventConnection *pConn)
+{
+	// Before its socket is closed
+	mpConnectionWait->Remove(pConn, pConn->mEvents);
+	mEventConnections.erase(pConn);
+	delete pConn;
 
 	// Notify derived classes
 	HTTPConnectionClosing();
 }
+#endif // !WIN32
 
 
 // --------------------------------------------------------------------------
@@ -219,8 +1087,10 @@ void HTTPServer::SendInternalErrorResponse(const std::string& rErrorMsg,
 			"<p>Please try again later.</p>" \
 			"</body>\n</html>\n"
 
-	// Generate the error page
+	// Generate the error page, instead of any content streamed from
+	// elsewhere that was set up before the error
 	// rResponse.SetResponseCode(HTTPResponse::Code_InternalServerError);
+	rResponse.SetDataStream(std::auto_ptr<IOStream>());
 	rResponse.SetContentType("text/html");
 	rResponse.Write(ERROR_HTML_1, sizeof(ERROR_HTML_1) - 1);
 	rResponse.IOStream::Write(rErrorMsg.c_str());
@@ -228,6 +1098,26 @@ void HTTPServer::SendInternalErrorResponse(const std::string& rErrorMsg,
 }
 
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    HTTPServer::SendNotImplementedResponse(
+//			 const HTTPException&, HTTPResponse&)
+//		Purpose: Generates a 501 Not Implemented response to a
+//			 request which Receive() refused.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void HTTPServer::SendNotImplementedResponse(const HTTPException& rException,
+	HTTPResponse& rResponse)
+{
+	BOX_WARNING("Refusing HTTP request: " << rException.GetMessage());
+	rResponse.SetResponseCode(HTTPResponse::Code_NotImplemented);
+	rResponse.SetContentType("text/plain");
+	rResponse.IOStream::Write(rException.GetMessage() + "\n");
+}
+
+
 // --------------------------------------------------------------------------
 //
 // Function
@@ -10,17 +10,42 @@
 #ifndef HTTPSERVER__H
 #define HTTPSERVER__H
 
+#include <set>
+#include <vector>
+
 #include "ServerStream.h"
 #include "SocketStream.h"
 
+class HTTPEventConnection;
+class HTTPException;
 class HTTPRequest;
 class HTTPResponse;
+class IOStreamGetLine;
+
+// An event-driven server reads ahead on each connection, into memory, up to
+// this much before it has answered the requests already received. Only the
+// headers of a request need to fit: any content is streamed to the handler.
+#define HTTPSERVER_MAX_BUFFERED_INPUT	(1024*1024)
 
 // --------------------------------------------------------------------------
 //
 // Class
 //		Name:    HTTPServer
-//		Purpose: HTTP server
+//		Purpose: HTTP server. By default each connection is handled
+//			 by a blocking loop in its own process. If the
+//			 EventDriven option is set, a single process serves
+//			 all of its connections at once, as they become
+//			 ready, which is much cheaper for many concurrent
+//			 keep-alive clients. WorkerProcesses can then be
+//			 used to spread them over more than one CPU. A
+//			 request with content, such as an upload, is then
+//			 handed to a child process which streams it to
+//			 Handle() and sends the response, so that it can't
+//			 hold up the other connections however large it is.
+//			 Requests without content are handled in the event
+//			 loop, and any content of their responses is sent
+//			 from it as the client reads it, so Handle() must
+//			 not block for them.
 //		Created: 26/3/04
 //
 // --------------------------------------------------------------------------
@@ -57,13 +82,38 @@ protected:
 	void SendInternalErrorResponse(const std::string& rErrorMsg,
 		HTTPResponse& rResponse);
 	int GetTimeout() { return mTimeout; }
+	virtual bool IsEventDriven() { return mEventDriven; }
+#ifndef WIN32
+	virtual void NotifyListenerIsReady();
+	virtual void *WaitForConnection(WaitForEvent &rConnectionWait);
+#endif
 
 private:
 	int mTimeout;	// Timeout for read operations
+	bool mEventDriven;
+	std::set<HTTPEventConnection *> mEventConnections;
+	// Where the connections are registered, once WaitForConnection()
+	// has been called
+	WaitForEvent *mpConnectionWait;
+	box_time_t mLastIdleCheck;
 	const char *DaemonName() const;
 	const ConfigurationVerify *GetConfigVerify() const;
 	void Run();
 	void Connection(std::auto_ptr<SocketStream> apStream);
+	bool ServeRequest(IOStreamGetLine &rGetLine, IOStream &rConn);
+	void HandleRequest(HTTPRequest &rRequest, HTTPResponse &rResponse);
+	void SendNotImplementedResponse(const HTTPException& rException,
+		HTTPResponse& rResponse);
+#ifndef WIN32
+	bool ServeEventConnection(HTTPEventConnection &rConn);
+	void CloseIdleEventConnections(box_time_t Now);
+	void ServiceEventConnection(HTTPEventConnection &rConn);
+	bool HandleEventRequest(HTTPEventConnection &rConn);
+	void StartEventWorker(HTTPEventConnection &rConn);
+	bool FinishEventWorker(HTTPEventConnection &rConn);
+	void SendEventOutput(HTTPEventConnection &rConn);
+	void CloseEventConnection(HTTPEventConnection *pConn);
+#endif
 };
 
 // Root level
@@ -76,6 +126,7 @@ private:
 
 // Server level
 #define HTTPSERVER_VERIFY_SERVER_KEYS(DEFAULT_ADDRESSES) \
+	ConfigurationVerifyKey("EventDriven", ConfigTest_IsBool, false), \
 	SERVERSTREAM_VERIFY_SERVER_KEYS(DEFAULT_ADDRESSES)
 
 #endif // HTTPSERVER__H
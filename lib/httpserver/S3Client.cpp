@@ -9,7 +9,9 @@
 
 #include "Box.h"
 
+#include <algorithm>
 #include <cstring>
+#include <deque>
 
 // #include <cstdio>
 // #include <ctime>
@@ -22,6 +24,7 @@
 #include "autogen_HTTPException.h"
 #include "IOStream.h"
 #include "Logging.h"
+#include "PartialReadStream.h"
 #include "S3Client.h"
 #include "decode.h"
 #include "encode.h"
@@ -31,16 +34,25 @@
 // --------------------------------------------------------------------------
 //
 // Function
-//		Name:    S3Client::GetObject(const std::string& rObjectURI)
+//		Name:    S3Client::GetObject(const std::string& rObjectURI,
+//			 const std::string& rIfNoneMatch)
 //		Purpose: Retrieve the object with the specified URI (key)
-//			 from your S3 bucket.
+//			 from your S3 bucket. If an ETag is given, and the
+//			 object still has it, S3 returns 304 Not Modified
+//			 instead, without the content.
 //		Created: 09/01/2009
 //
 // --------------------------------------------------------------------------
 
-HTTPResponse S3Client::GetObject(const std::string& rObjectURI)
+HTTPResponse S3Client::GetObject(const std::string& rObjectURI,
+	const std::string& rIfNoneMatch)
 {
-	return FinishAndSendRequest(HTTPRequest::Method_GET, rObjectURI);
+	HTTPRequest request(HTTPRequest::Method_GET, rObjectURI);
+	if (!rIfNoneMatch.empty())
+	{
+		request.AddHeader("If-None-Match", rIfNoneMatch);
+	}
+	return FinishAndSendRequest(request);
 }
 
 // --------------------------------------------------------------------------
@@ -58,8 +70,6 @@ HTTPResponse S3Client::HeadObject(const std::string& rObjectURI)
 	return FinishAndSendRequest(HTTPRequest::Method_HEAD, rObjectURI);
 }
 
-
-HTTPResponse HeadObject(const std::string& rObjectURI);
 // --------------------------------------------------------------------------
 //
 // Function
@@ -82,28 +92,610 @@ HTTPResponse S3Client::PutObject(const std::string& rObjectURI,
 // --------------------------------------------------------------------------
 //
 // Function
-//		Name:    S3Client::FinishAndSendRequest(
-//			 HTTPRequest::Method Method,
-//			 const std::string& rRequestURI,
-//			 IOStream* pStreamToSend,
-//			 const char* pStreamContentType)
-//		Purpose: Internal method which creates an HTTP request to S3,
-//			 populates the date and authorization header fields,
-//			 and sends it to S3 (or the simulator), attaching
-//			 the specified stream if any to the request. Opens a
-//			 connection to the server if necessary, which may
-//			 throw a ConnectionException. Returns the HTTP
-//			 response returned by S3, which may be a 500 error.
-//		Created: 09/01/2009
+//		Name:    S3Client::DeleteObject(const std::string& rObjectURI)
+//		Purpose: Delete the object with the specified URI (key)
+//			 from your S3 bucket. S3 returns 204 No Content
+//			 whether or not the object existed.
+//		Created: 2026/10/19
 //
 // --------------------------------------------------------------------------
 
-HTTPResponse S3Client::FinishAndSendRequest(HTTPRequest::Method Method,
-	const std::string& rRequestURI, IOStream* pStreamToSend,
-	const char* pStreamContentType)
+HTTPResponse S3Client::DeleteObject(const std::string& rObjectURI)
 {
-	HTTPRequest request(Method, rRequestURI);
-	request.SetHostName(mHostName);
+	return FinishAndSendRequest(HTTPRequest::Method_DELETE, rObjectURI);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::GetObjectRange(const std::string& rObjectURI,
+//			 int64_t Start, int64_t Length,
+//			 const std::string& rIfNoneMatch)
+//		Purpose: Retrieve part of the object with the specified URI
+//			 (key) from your S3 bucket, starting at byte Start,
+//			 and Length bytes long, or to the end of the object if
+//			 Length is negative. S3 returns 206 Partial Content,
+//			 with the range and the size of the whole object in
+//			 the Content-Range header, or 416 if the object is
+//			 empty. As for GetObject(), if an ETag is given and
+//			 the object still has it, S3 returns 304 instead.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+HTTPResponse S3Client::GetObjectRange(const std::string& rObjectURI,
+	int64_t Start, int64_t Length, const std::string& rIfNoneMatch)
+{
+	if (Start < 0 || Length == 0)
+	{
+		THROW_EXCEPTION_MESSAGE(HTTPException, BadRequest,
+			"Invalid range requested from S3: start " << Start <<
+			", length " << Length);
+	}
+
+	std::ostringstream range;
+	range << "bytes=" << Start << "-";
+	if (Length > 0)
+	{
+		range << (Start + Length - 1);
+	}
+
+	HTTPRequest request(HTTPRequest::Method_GET, rObjectURI);
+	request.AddHeader("Range", range.str());
+	if (!rIfNoneMatch.empty())
+	{
+		request.AddHeader("If-None-Match", rIfNoneMatch);
+	}
+	return FinishAndSendRequest(request);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::PutObjectMultipart(
+//			 const std::string& rObjectURI,
+//			 IOStream& rStreamToSend, int PartSize,
+//			 const char* pContentType)
+//		Purpose: Upload the stream to S3 as a multipart upload,
+//			 creating or overwriting the object with the specified
+//			 URI (key) in your S3 bucket. Parts of PartSize bytes
+//			 are read from the stream as they are sent, several at
+//			 once, as SendRequests() does. If anything fails, the
+//			 upload is aborted, so that S3 doesn't keep the parts.
+//			 Returns the response to the final request, which
+//			 completes the upload.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+HTTPResponse S3Client::PutObjectMultipart(const std::string& rObjectURI,
+	IOStream& rStreamToSend, int PartSize, const char* pContentType)
+{
+	std::string uploadID = InitiateMultipartUpload(rObjectURI,
+		pContentType);
+
+	try
+	{
+		std::vector<std::string> partETags;
+		UploadParts(rObjectURI, uploadID, rStreamToSend, PartSize,
+			partETags);
+		return CompleteMultipartUpload(rObjectURI, uploadID,
+			partETags);
+	}
+	catch (BoxException &e)
+	{
+		BOX_WARNING("Failed to upload " << rObjectURI << " to S3, "
+			"aborting the upload: " << e.what());
+		try
+		{
+			AbortMultipartUpload(rObjectURI, uploadID);
+		}
+		catch (BoxException &e2)
+		{
+			BOX_WARNING("Failed to abort upload of " << rObjectURI <<
+				" to S3, its parts may remain: " << e2.what());
+		}
+		throw;
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::InitiateMultipartUpload(
+//			 const std::string& rObjectURI,
+//			 const char* pContentType)
+//		Purpose: Start a multipart upload to the object with the
+//			 specified URI (key), and return its upload ID.
+//			 Throws an exception if S3 refuses.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+std::string S3Client::InitiateMultipartUpload(const std::string& rObjectURI,
+	const char* pContentType)
+{
+	HTTPRequest::Query_t query;
+	query.insert(HTTPRequest::QueryEn_t("uploads", ""));
+
+	// The Content-Type applies to the object, but is given here
+	HTTPRequest request(HTTPRequest::Method_POST, rObjectURI);
+	request.SetContentLength(0);
+	HTTPResponse response = FinishAndSendRequest(request, NULL,
+		pContentType, &query);
+	CheckResponse(response, "Failed to start multipart upload to " +
+		rObjectURI);
+
+	std::vector<std::string> values;
+	GetXMLElements(std::string((const char *)response.GetBuffer(),
+		response.GetSize()), "UploadId", values);
+	if (values.size() != 1 || values[0].empty())
+	{
+		THROW_EXCEPTION_MESSAGE(HTTPException, BadResponse,
+			"S3 did not return an upload ID for " << rObjectURI);
+	}
+
+	return values[0];
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::UploadPart(const std::string& rObjectURI,
+//			 const std::string& rUploadID, int PartNumber,
+//			 IOStream& rStreamToSend)
+//		Purpose: Upload the whole stream as one part of a multipart
+//			 upload, replacing any earlier upload of the same
+//			 part, for example to retry it. Returns the part's
+//			 ETag, needed to complete the upload. Throws an
+//			 exception if S3 refuses.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+std::string S3Client::UploadPart(const std::string& rObjectURI,
+	const std::string& rUploadID, int PartNumber, IOStream& rStreamToSend)
+{
+	std::ostringstream partNumber;
+	partNumber << PartNumber;
+	HTTPRequest::Query_t query;
+	query.insert(HTTPRequest::QueryEn_t("partNumber", partNumber.str()));
+	query.insert(HTTPRequest::QueryEn_t("uploadId", rUploadID));
+
+	HTTPResponse response = FinishAndSendRequest(HTTPRequest::Method_PUT,
+		rObjectURI, &rStreamToSend, NULL, &query);
+	CheckResponse(response, "Failed to upload part " + partNumber.str() +
+		" of " + rObjectURI);
+	return response.GetHeaderValue("ETag");
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::UploadParts(const std::string& rObjectURI,
+//			 const std::string& rUploadID,
+//			 IOStream& rStreamToSend, int PartSize,
+//			 std::vector<std::string>& rPartETags)
+//		Purpose: Upload the rest of the stream as parts of a
+//			 multipart upload, numbered after those whose ETags
+//			 are already in rPartETags, and add their ETags to it.
+//			 Up to GetMaxConnections() parts are sent at once.
+//			 If the size of the stream is known, parts are read
+//			 from it as they are sent; otherwise each part is
+//			 read into memory first. Throws an exception if any
+//			 part fails, leaving the ETags of the parts before it
+//			 in rPartETags, so that the upload can be continued.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Client::UploadParts(const std::string& rObjectURI,
+	const std::string& rUploadID, IOStream& rStreamToSend, int PartSize,
+	std::vector<std::string>& rPartETags)
+{
+	if (PartSize <= 0)
+	{
+		THROW_EXCEPTION_MESSAGE(HTTPException, BadRequest,
+			"Invalid part size for multipart upload: " << PartSize);
+	}
+
+	// Parts are only read as they are sent, so keep count of how much
+	// of the stream is left after those already made.
+	IOStream::pos_type left = rStreamToSend.BytesLeftToRead();
+	bool finished = false;
+	while (!finished)
+	{
+		std::vector<IOStream*> partStreams;
+		std::vector<Request> requests;
+		std::vector<HTTPResponse> responses;
+
+		try
+		{
+			while (!finished &&
+				requests.size() < (size_t)mMaxConnections)
+			{
+				std::auto_ptr<IOStream> apPart;
+				IOStream::pos_type partSize = 0;
+
+				if (left == IOStream::SizeOfStreamUnknown)
+				{
+					std::auto_ptr<CollectInBufferStream>
+						apBuffer(new CollectInBufferStream);
+					char buffer[4096];
+					while (apBuffer->GetSize() < PartSize &&
+						rStreamToSend.StreamDataLeft())
+					{
+						int bytes = rStreamToSend.Read(
+							buffer, std::min((int)
+							sizeof(buffer), PartSize -
+							apBuffer->GetSize()),
+							mNetworkTimeout);
+						apBuffer->Write(buffer, bytes);
+					}
+					apBuffer->SetForReading();
+					finished = (apBuffer->GetSize() < PartSize);
+					partSize = apBuffer->GetSize();
+					apPart.reset(apBuffer.release());
+				}
+				else if (left > 0)
+				{
+					partSize = std::min(left,
+						(IOStream::pos_type)PartSize);
+					apPart.reset(new PartialReadStream(
+						rStreamToSend, partSize));
+					left -= partSize;
+					finished = (left == 0);
+				}
+				else
+				{
+					finished = true;
+				}
+
+				// Every upload needs at least one part, even if
+				// it's empty, but only the first may be empty.
+				if (partSize == 0 && (!rPartETags.empty() ||
+					!requests.empty()))
+				{
+					break;
+				}
+				if (!apPart.get())
+				{
+					apPart.reset(new CollectInBufferStream);
+					((CollectInBufferStream *)apPart.get())->
+						SetForReading();
+				}
+
+				std::ostringstream partNumber;
+				partNumber << (rPartETags.size() +
+					requests.size() + 1);
+				Request request(HTTPRequest::Method_PUT,
+					rObjectURI, apPart.get());
+				request.mQuery.insert(HTTPRequest::QueryEn_t(
+					"partNumber", partNumber.str()));
+				request.mQuery.insert(HTTPRequest::QueryEn_t(
+					"uploadId", rUploadID));
+				requests.push_back(request);
+				partStreams.push_back(apPart.release());
+			}
+
+			SendRequests(requests, responses);
+		}
+		catch (...)
+		{
+			for (size_t i = 0; i < partStreams.size(); i++)
+			{
+				delete partStreams[i];
+			}
+			throw;
+		}
+
+		for (size_t i = 0; i < partStreams.size(); i++)
+		{
+			delete partStreams[i];
+		}
+
+		for (size_t i = 0; i < responses.size(); i++)
+		{
+			CheckResponse(responses[i], "Failed to upload part " +
+				requests[i].mQuery.find("partNumber")->second +
+				" of " + rObjectURI);
+			rPartETags.push_back(responses[i].GetHeaderValue("ETag"));
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::CompleteMultipartUpload(
+//			 const std::string& rObjectURI,
+//			 const std::string& rUploadID,
+//			 const std::vector<std::string>& rPartETags)
+//		Purpose: Finish a multipart upload, joining the parts whose
+//			 ETags are given, in order, to make the object. S3
+//			 may report a failure after sending a 200 OK status,
+//			 so the response body is checked too, and an
+//			 exception thrown in either case.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+HTTPResponse S3Client::CompleteMultipartUpload(const std::string& rObjectURI,
+	const std::string& rUploadID, const std::vector<std::string>& rPartETags)
+{
+	std::ostringstream xml;
+	xml << "<CompleteMultipartUpload>";
+	for (size_t i = 0; i < rPartETags.size(); i++)
+	{
+		xml << "<Part><PartNumber>" << (i + 1) << "</PartNumber>"
+			"<ETag>" << rPartETags[i] << "</ETag></Part>";
+	}
+	xml << "</CompleteMultipartUpload>";
+
+	CollectInBufferStream body;
+	body.Write(xml.str().c_str(), xml.str().size());
+	body.SetForReading();
+
+	HTTPRequest::Query_t query;
+	query.insert(HTTPRequest::QueryEn_t("uploadId", rUploadID));
+
+	HTTPResponse response = FinishAndSendRequest(HTTPRequest::Method_POST,
+		rObjectURI, &body, "application/xml", &query);
+	CheckResponse(response, "Failed to complete multipart upload to " +
+		rObjectURI);
+
+	std::vector<std::string> errors;
+	GetXMLElements(std::string((const char *)response.GetBuffer(),
+		response.GetSize()), "Error", errors);
+	if (!errors.empty())
+	{
+		THROW_EXCEPTION_MESSAGE(HTTPException, RequestFailedUnexpectedly,
+			"Failed to complete multipart upload to " << rObjectURI <<
+			": " << errors[0]);
+	}
+
+	return response;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::AbortMultipartUpload(
+//			 const std::string& rObjectURI,
+//			 const std::string& rUploadID)
+//		Purpose: Abandon a multipart upload, so that S3 deletes the
+//			 parts already uploaded. S3 returns 204 No Content.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+HTTPResponse S3Client::AbortMultipartUpload(const std::string& rObjectURI,
+	const std::string& rUploadID)
+{
+	HTTPRequest::Query_t query;
+	query.insert(HTTPRequest::QueryEn_t("uploadId", rUploadID));
+	return FinishAndSendRequest(HTTPRequest::Method_DELETE, rObjectURI,
+		NULL, NULL, &query);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::GetSubResourcesToSign(
+//			 const HTTPRequest& rRequest)
+//		Purpose: Returns the query parameters of the request which
+//			 select a sub-resource, such as a part of a multipart
+//			 upload, and so must be included in the signature,
+//			 in the form which S3 expects.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+std::string S3Client::GetSubResourcesToSign(const HTTPRequest& rRequest)
+{
+	// In alphabetical order, as the signature requires
+	static const char *subResources[] = {"partNumber", "uploadId",
+		"uploads", NULL};
+	const HTTPRequest::Query_t& rQuery(rRequest.GetQuery());
+	std::string result;
+
+	for (int i = 0; subResources[i] != NULL; i++)
+	{
+		HTTPRequest::Query_t::const_iterator p =
+			rQuery.find(subResources[i]);
+		if (p == rQuery.end())
+		{
+			continue;
+		}
+		result += result.empty() ? "?" : "&";
+		result += p->first;
+		if (!p->second.empty())
+		{
+			result += "=" + p->second;
+		}
+	}
+
+	return result;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::GetXMLElements(const std::string&,
+//			 const std::string&, std::vector<std::string>&)
+//		Purpose: Adds the text of each element with the given name,
+//			 in order, from an S3 XML document, with the standard
+//			 entities decoded. The documents which we parse are
+//			 simple enough not to need a real XML parser.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Client::GetXMLElements(const std::string& rXML, const std::string& rName,
+	std::vector<std::string>& rValuesOut)
+{
+	std::string open = "<" + rName + ">", close = "</" + rName + ">";
+	std::string::size_type pos = 0;
+
+	while((pos = rXML.find(open, pos)) != std::string::npos)
+	{
+		pos += open.size();
+		std::string::size_type end = rXML.find(close, pos);
+		if(end == std::string::npos)
+		{
+			THROW_EXCEPTION_MESSAGE(HTTPException, BadResponse,
+				"Unterminated " << rName << " element in S3 "
+				"response");
+		}
+
+		std::string value;
+		for(std::string::size_type i = pos; i < end; i++)
+		{
+			static const char *entities[][2] = {{"&amp;", "&"},
+				{"&lt;", "<"}, {"&gt;", ">"}, {"&quot;", "\""},
+				{"&apos;", "'"}, {NULL, NULL}};
+			int e;
+			for(e = 0; entities[e][0] != NULL; e++)
+			{
+				if(rXML.compare(i, ::strlen(entities[e][0]),
+					entities[e][0]) == 0)
+				{
+					value += entities[e][1];
+					i += ::strlen(entities[e][0]) - 1;
+					break;
+				}
+			}
+			if(entities[e][0] == NULL)
+			{
+				value += rXML[i];
+			}
+		}
+
+		rValuesOut.push_back(value);
+		pos = end + close.size();
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::ListBucket(std::vector<std::string>*,
+//			 std::vector<std::string>*, const std::string&,
+//			 const std::string&)
+//		Purpose: List the keys in your S3 bucket which start with
+//			 the given prefix, and if a delimiter is given, the
+//			 common prefixes up to the next delimiter after it,
+//			 which are like subdirectories. Makes as many
+//			 requests as needed to get the complete list.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Client::ListBucket(std::vector<std::string>* pKeysOut,
+	std::vector<std::string>* pCommonPrefixesOut,
+	const std::string& rPrefix, const std::string& rDelimiter)
+{
+	std::string marker;
+	bool truncated = true;
+
+	while(truncated)
+	{
+		HTTPRequest::Query_t query;
+		query.insert(HTTPRequest::QueryEn_t("prefix", rPrefix));
+		if(!rDelimiter.empty())
+		{
+			query.insert(HTTPRequest::QueryEn_t("delimiter",
+				rDelimiter));
+		}
+		if(!marker.empty())
+		{
+			query.insert(HTTPRequest::QueryEn_t("marker", marker));
+		}
+
+		HTTPResponse response = FinishAndSendRequest(
+			HTTPRequest::Method_GET, "/", NULL, NULL, &query);
+		CheckResponse(response, "Failed to list the contents of the "
+			"bucket with prefix: " + rPrefix);
+
+		std::string xml((const char *)response.GetBuffer(),
+			response.GetSize());
+
+		std::vector<std::string> values;
+		GetXMLElements(xml, "IsTruncated", values);
+		truncated = (!values.empty() && values[0] == "true");
+
+		// Each key is inside a Contents element, and each common
+		// prefix inside a CommonPrefixes element, so we can find
+		// them all directly.
+		std::vector<std::string> keys, prefixes;
+		GetXMLElements(xml, "Key", keys);
+		GetXMLElements(xml, "CommonPrefixes", values);
+		for(std::vector<std::string>::iterator i = values.begin();
+			i != values.end(); i++)
+		{
+			GetXMLElements(*i, "Prefix", prefixes);
+		}
+
+		if(pKeysOut)
+		{
+			pKeysOut->insert(pKeysOut->end(), keys.begin(),
+				keys.end());
+		}
+		if(pCommonPrefixesOut)
+		{
+			pCommonPrefixesOut->insert(pCommonPrefixesOut->end(),
+				prefixes.begin(), prefixes.end());
+		}
+
+		if(truncated)
+		{
+			// Carry on after whichever came last
+			if(!keys.empty() && (prefixes.empty() ||
+				keys.back() > prefixes.back()))
+			{
+				marker = keys.back();
+			}
+			else if(!prefixes.empty())
+			{
+				marker = prefixes.back();
+			}
+			else
+			{
+				THROW_EXCEPTION_MESSAGE(HTTPException,
+					BadResponse, "S3 returned a truncated "
+					"but empty listing");
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::PrepareRequest(HTTPRequest& rRequest,
+//			 const char* pStreamContentType,
+//			 const HTTPRequest::Query_t* pQuery)
+//		Purpose: Internal method which adds the query parameters if
+//			 any to an HTTP request to S3, and populates the host,
+//			 date, authorization and other header fields.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Client::PrepareRequest(HTTPRequest& rRequest,
+	const char* pStreamContentType, const HTTPRequest::Query_t* pQuery)
+{
+	rRequest.SetHostName(mHostName);
+	rRequest.SetClientKeepAliveRequested(true);
+
+	if (pQuery)
+	{
+		for (HTTPRequest::Query_t::const_iterator i = pQuery->begin();
+			i != pQuery->end(); i++)
+		{
+			rRequest.AddParameter(i->first, i->second);
+		}
+	}
 	
 	std::ostringstream date;
 	time_t tt = time(NULL);
@@ -124,11 +716,13 @@ HTTPResponse S3Client::FinishAndSendRequest(HTTPRequest::Method Method,
 	date << std::setw(2) << tp->tm_hour << ":" <<
 		std::setw(2) << tp->tm_min  << ":" <<
 		std::setw(2) << tp->tm_sec  << " GMT";
-	request.AddHeader("Date", date.str());
+	rRequest.AddHeader("Date", date.str());
 
 	if (pStreamContentType)
 	{
-		request.AddHeader("Content-Type", pStreamContentType);
+		// Not an extra header, so that it's included in the
+		// signature below, as S3 expects.
+		rRequest.SetContentType(pStreamContentType);
 	}
 
 	std::string s3suffix = ".s3.amazonaws.com";
@@ -145,9 +739,9 @@ HTTPResponse S3Client::FinishAndSendRequest(HTTPRequest::Method Method,
 	}
 
 	std::ostringstream data;
-	data << request.GetVerb() << "\n";
+	data << rRequest.GetVerb() << "\n";
 	data << "\n"; /* Content-MD5 */
-	data << request.GetContentType() << "\n";
+	data << rRequest.GetContentType() << "\n";
 	data << date.str() << "\n";
 
 	if (! bucket.empty())
@@ -155,7 +749,7 @@ HTTPResponse S3Client::FinishAndSendRequest(HTTPRequest::Method Method,
 		data << "/" << bucket;
 	}
 
-	data << request.GetRequestURI();
+	data << rRequest.GetRequestURI() << GetSubResourcesToSign(rRequest);
 	std::string data_string = data.str();
 
 	unsigned char digest_buffer[EVP_MAX_MD_SIZE];
@@ -175,33 +769,80 @@ HTTPResponse S3Client::FinishAndSendRequest(HTTPRequest::Method Method,
 		auth_code = auth_code.substr(0, auth_code.size() - 1);
 	}
 
-	request.AddHeader("Authorization", auth_code);
-	
+	rRequest.AddHeader("Authorization", auth_code);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::FinishAndSendRequest(
+//			 HTTPRequest::Method Method,
+//			 const std::string& rRequestURI,
+//			 IOStream* pStreamToSend,
+//			 const char* pStreamContentType,
+//			 const HTTPRequest::Query_t* pQuery)
+//		Purpose: Internal method which creates an HTTP request to S3,
+//			 populates the date and authorization header fields,
+//			 and sends it to S3 (or the simulator), attaching
+//			 the specified stream and query parameters if any
+//			 to the request. Opens a
+//			 connection to the server if necessary, which may
+//			 throw a ConnectionException. Returns the HTTP
+//			 response returned by S3, which may be a 500 error.
+//		Created: 09/01/2009
+//
+// --------------------------------------------------------------------------
+
+HTTPResponse S3Client::FinishAndSendRequest(HTTPRequest::Method Method,
+	const std::string& rRequestURI, IOStream* pStreamToSend,
+	const char* pStreamContentType, const HTTPRequest::Query_t* pQuery)
+{
+	HTTPRequest request(Method, rRequestURI);
+	return FinishAndSendRequest(request, pStreamToSend, pStreamContentType,
+		pQuery);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::FinishAndSendRequest(HTTPRequest& rRequest,
+//			 IOStream* pStreamToSend,
+//			 const char* pStreamContentType,
+//			 const HTTPRequest::Query_t* pQuery)
+//		Purpose: As above, but for a request which the caller has
+//			 already created, for example to add extra headers.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+HTTPResponse S3Client::FinishAndSendRequest(HTTPRequest& rRequest,
+	IOStream* pStreamToSend, const char* pStreamContentType,
+	const HTTPRequest::Query_t* pQuery)
+{
+	PrepareRequest(rRequest, pStreamContentType, pQuery);
+
 	if (mpSimulator)
 	{
 		if (pStreamToSend)
 		{
-			pStreamToSend->CopyStreamTo(request);
+			pStreamToSend->CopyStreamTo(rRequest);
 		}
 
-		request.SetForReading();
+		rRequest.SetForReading();
 		CollectInBufferStream response_buffer;
 		HTTPResponse response(&response_buffer);
 	
-		mpSimulator->Handle(request, response);
+		mpSimulator->Handle(rRequest, response);
+		// Content streamed from a file has nowhere to go, and
+		// couldn't be copied, so read it in now.
+		response.BufferDataStream();
 		return response;
 	}
 	else
 	{
 		try
 		{
-			if (!mapClientSocket.get())
-			{
-				mapClientSocket.reset(new SocketStream());
-				mapClientSocket->Open(Socket::TypeINET,
-					mHostName, mPort);
-			}
-			return SendRequest(request, pStreamToSend,
+			return SendRequest(rRequest, pStreamToSend,
 				pStreamContentType);
 		}
 		catch (ConnectionException &ce)
@@ -210,9 +851,7 @@ HTTPResponse S3Client::FinishAndSendRequest(HTTPRequest::Method Method,
 			{
 				// server may have disconnected us,
 				// try to reconnect, just once
-				mapClientSocket->Open(Socket::TypeINET,
-					mHostName, mPort);
-				return SendRequest(request, pStreamToSend,
+				return SendRequest(rRequest, pStreamToSend,
 					pStreamContentType);
 			}
 			else
@@ -231,8 +870,9 @@ HTTPResponse S3Client::FinishAndSendRequest(HTTPRequest::Method Method,
 //			 IOStream* pStreamToSend,
 //			 const char* pStreamContentType)
 //		Purpose: Internal method which sends a pre-existing HTTP 
-//			 request to S3. Attaches the specified stream if any
-//			 to the request. Opens a connection to the server if
+//			 request to S3 on the first pooled connection.
+//			 Attaches the specified stream if any to the
+//			 request. Opens a connection to the server if
 //			 necessary, which may throw a ConnectionException.
 //			 Returns the HTTP response returned by S3, which may
 //			 be a 500 error.
@@ -244,22 +884,33 @@ HTTPResponse S3Client::SendRequest(HTTPRequest& rRequest,
 	IOStream* pStreamToSend, const char* pStreamContentType)
 {
 	HTTPResponse response;
+	Connection& rConn(GetIdleConnection(0));
 
-	if (pStreamToSend)
+	try
 	{
-		rRequest.SendWithStream(*mapClientSocket, mNetworkTimeout,
-			pStreamToSend, response);
+		if (pStreamToSend)
+		{
+			rRequest.SendWithStream(rConn.mGetLine,
+				mNetworkTimeout, pStreamToSend, response);
+		}
+		else
+		{
+			rRequest.Send(rConn.mSocket, mNetworkTimeout);
+			response.Receive(rConn.mGetLine, mNetworkTimeout,
+				rRequest.GetMethod() == HTTPRequest::Method_HEAD);
+		}
 	}
-	else
+	catch (BoxException &e)
 	{
-		rRequest.Send(*mapClientSocket, mNetworkTimeout);
-		response.Receive(*mapClientSocket, mNetworkTimeout);
+		// We don't know what state the connection is in now
+		CloseConnection(0);
+		throw;
 	}
 
 	if(!response.IsKeepAlive())
 	{
 		BOX_TRACE("Server will close the connection, closing our end too.");
-		mapClientSocket.reset();
+		CloseConnection(0);
 	}
 	else
 	{
@@ -269,6 +920,337 @@ HTTPResponse S3Client::SendRequest(HTTPRequest& rRequest,
 	return response;
 }
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::SendRequests(
+//			 const std::vector<S3Client::Request>& rRequests,
+//			 std::vector<HTTPResponse>& rResponses)
+//		Purpose: Send a batch of requests to S3, and return their
+//			 responses in the same order. Requests without bodies
+//			 are shared out between the pooled connections, and
+//			 pipelined on each, so that the server can work on
+//			 several at once and no connection waits for a round
+//			 trip between requests. Requests with bodies wait for
+//			 an idle connection, because they need a 100 Continue
+//			 from the server before the body is sent, but their
+//			 responses are collected later, so the server can
+//			 work on several bodies at once. Bodies are sent in
+//			 the order of the requests, so they can be parts of
+//			 the same underlying stream. Throws an
+//			 exception, after closing all the connections, if any
+//			 request can't be sent or its response received.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Client::SendRequests(const std::vector<Request>& rRequests,
+	std::vector<HTTPResponse>& rResponses)
+{
+	rResponses.clear();
+	rResponses.resize(rRequests.size());
+
+	if (mpSimulator)
+	{
+		for (size_t i = 0; i < rRequests.size(); i++)
+		{
+			const Request& rRequest(rRequests[i]);
+			rResponses[i] = FinishAndSendRequest(rRequest.mMethod,
+				rRequest.mObjectURI, rRequest.mpStreamToSend,
+				rRequest.mpContentType, &rRequest.mQuery);
+		}
+		return;
+	}
+
+	// The requests waiting to be sent, and those sent on each connection
+	// whose responses haven't been received yet, by index in rRequests
+	std::deque<size_t> waiting;
+	for (size_t i = 0; i < rRequests.size(); i++)
+	{
+		waiting.push_back(i);
+	}
+	std::vector<std::deque<size_t> > inFlight(mMaxConnections);
+	size_t numCompleted = 0;
+
+	try
+	{
+		while (numCompleted < rRequests.size())
+		{
+			// Fill up the pipeline of each connection
+			for (size_t c = 0; c < inFlight.size(); c++)
+			{
+				while (!waiting.empty() &&
+					inFlight[c].size() < (size_t)mPipelineDepth)
+				{
+					size_t i = waiting.front();
+					const Request& rRequest(rRequests[i]);
+
+					if (rRequest.mpStreamToSend &&
+						!inFlight[c].empty())
+					{
+						// Must wait until this
+						// connection is idle
+						break;
+					}
+
+					Connection& rConn(inFlight[c].empty()
+						? GetIdleConnection(c)
+						: *mConnections[c]);
+					HTTPRequest request(rRequest.mMethod,
+						rRequest.mObjectURI);
+					PrepareRequest(request, rRequest.mpContentType,
+						&rRequest.mQuery);
+					waiting.pop_front();
+
+					if (!rRequest.mpStreamToSend)
+					{
+						request.Send(rConn.mSocket,
+							mNetworkTimeout);
+						inFlight[c].push_back(i);
+						continue;
+					}
+
+					// Send the body as soon as the server
+					// agrees, but don't wait for it to be
+					// processed: the response is collected
+					// with the others, so that the server
+					// can work on several bodies at once.
+					IOStream::pos_type size =
+						rRequest.mpStreamToSend->BytesLeftToRead();
+					if (size != IOStream::SizeOfStreamUnknown)
+					{
+						request.SetContentLength(size);
+					}
+					request.Send(rConn.mSocket, mNetworkTimeout,
+						true); // expect 100 Continue
+
+					HTTPResponse& rResponse(rResponses[i]);
+					rResponse.Receive(rConn.mGetLine,
+						mNetworkTimeout);
+					if (rResponse.GetResponseCode() == 100)
+					{
+						rRequest.mpStreamToSend->CopyStreamTo(
+							rConn.mSocket, mNetworkTimeout);
+						inFlight[c].push_back(i);
+						continue;
+					}
+
+					// Refused before the body was sent
+					numCompleted++;
+					if (!rResponse.IsKeepAlive())
+					{
+						CloseConnection(c);
+					}
+				}
+			}
+
+			// Collect the oldest response from each connection
+			for (size_t c = 0; c < inFlight.size(); c++)
+			{
+				if (inFlight[c].empty())
+				{
+					continue;
+				}
+
+				size_t i = inFlight[c].front();
+				inFlight[c].pop_front();
+				HTTPResponse& rResponse(rResponses[i]);
+				rResponse.Receive(mConnections[c]->mGetLine,
+					mNetworkTimeout, rRequests[i].mMethod ==
+					HTTPRequest::Method_HEAD);
+				numCompleted++;
+
+				if (!rResponse.IsKeepAlive())
+				{
+					// The server won't answer the rest
+					// of the pipeline, so send them again
+					CloseConnection(c);
+					waiting.insert(waiting.begin(),
+						inFlight[c].begin(),
+						inFlight[c].end());
+					inFlight[c].clear();
+				}
+			}
+		}
+	}
+	catch (BoxException &e)
+	{
+		BOX_TRACE("S3Client: " << mHostName << " ! " << e.what());
+		CloseConnections();
+		throw;
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::GetObjects(
+//			 const std::vector<std::string>& rObjectURIs,
+//			 std::vector<HTTPResponse>& rResponses)
+//		Purpose: Retrieve many objects from your S3 bucket at once,
+//			 as SendRequests() does.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Client::GetObjects(const std::vector<std::string>& rObjectURIs,
+	std::vector<HTTPResponse>& rResponses)
+{
+	std::vector<Request> requests;
+	for (std::vector<std::string>::const_iterator i = rObjectURIs.begin();
+		i != rObjectURIs.end(); i++)
+	{
+		requests.push_back(Request(HTTPRequest::Method_GET, *i));
+	}
+	SendRequests(requests, rResponses);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::GetIdleConnection(size_t Index)
+//		Purpose: Internal method which returns the pooled connection
+//			 with the given index, which has no requests in
+//			 flight, opening it if necessary. If the server has
+//			 closed it since it was last used, which it may do
+//			 at any time when it's idle, it is replaced with a
+//			 new one.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+S3Client::Connection& S3Client::GetIdleConnection(size_t Index)
+{
+	if (mConnections.size() <= Index)
+	{
+		mConnections.resize(Index + 1, NULL);
+	}
+
+	// An idle connection should have nothing to read. If it has,
+	// the server has closed it (or sent something unexpected).
+	if (mConnections[Index] != NULL &&
+		(mConnections[Index]->mGetLine.GetSizeOfBufferedData() > 0 ||
+		 mConnections[Index]->mSocket.Poll(POLLIN, 0)))
+	{
+		BOX_TRACE("S3Client: " << mHostName << " closed idle "
+			"connection " << Index << ", reconnecting");
+		CloseConnection(Index);
+	}
+
+	if (mConnections[Index] == NULL)
+	{
+		std::auto_ptr<Connection> apConn(new Connection);
+		apConn->mSocket.Open(Socket::TypeINET, mHostName, mPort);
+		mConnections[Index] = apConn.release();
+		mConnectionsOpened++;
+	}
+
+	return *mConnections[Index];
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::CloseConnection(size_t Index)
+//		Purpose: Internal method which closes the pooled connection
+//			 with the given index, if it's open.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Client::CloseConnection(size_t Index)
+{
+	if (Index < mConnections.size())
+	{
+		delete mConnections[Index];
+		mConnections[Index] = NULL;
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::CloseConnections()
+//		Purpose: Close all pooled connections to the server. They
+//			 will be opened again as needed.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Client::CloseConnections()
+{
+	for (size_t i = 0; i < mConnections.size(); i++)
+	{
+		CloseConnection(i);
+	}
+	mConnections.clear();
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::~S3Client()
+//		Purpose: Destructor
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+S3Client::~S3Client()
+{
+	CloseConnections();
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::SetMaxConnections(int MaxConnections)
+//		Purpose: Set the number of connections which SendRequests()
+//			 may use at once, closing any beyond that number.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Client::SetMaxConnections(int MaxConnections)
+{
+	if (MaxConnections < 1)
+	{
+		THROW_EXCEPTION_MESSAGE(HTTPException, Internal,
+			"S3Client needs at least one connection");
+	}
+
+	for (size_t i = MaxConnections; i < mConnections.size(); i++)
+	{
+		CloseConnection(i);
+	}
+	if (mConnections.size() > (size_t)MaxConnections)
+	{
+		mConnections.resize(MaxConnections);
+	}
+	mMaxConnections = MaxConnections;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Client::SetPipelineDepth(int PipelineDepth)
+//		Purpose: Set the number of requests which SendRequests() may
+//			 send on each connection before reading a response.
+//			 1 disables pipelining.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Client::SetPipelineDepth(int PipelineDepth)
+{
+	if (PipelineDepth < 1)
+	{
+		THROW_EXCEPTION_MESSAGE(HTTPException, Internal,
+			"S3Client pipeline depth must be at least one");
+	}
+
+	mPipelineDepth = PipelineDepth;
+}
+
 // --------------------------------------------------------------------------
 //
 // Function
@@ -286,7 +1268,8 @@ void S3Client::CheckResponse(const HTTPResponse& response, const std::string& me
 	if(response.GetResponseCode() != HTTPResponse::Code_OK)
 	{
 		THROW_EXCEPTION_MESSAGE(HTTPException, RequestFailedUnexpectedly,
-			message);
+			message << " (HTTP status " <<
+			response.GetResponseCode() << ")");
 	}
 }
 
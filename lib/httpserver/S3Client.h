@@ -12,19 +12,39 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 #include "HTTPRequest.h"
+#include "IOStreamGetLine.h"
 #include "SocketStream.h"
 
 class HTTPResponse;
 class HTTPServer;
 class IOStream;
 
+// Defaults for the number of connections which SendRequests() uses, and the
+// number of requests which it sends on each before reading any responses
+#define S3CLIENT_DEFAULT_MAX_CONNECTIONS	4
+#define S3CLIENT_DEFAULT_PIPELINE_DEPTH		8
+
+// Default size of the parts of a multipart upload. S3 requires all parts but
+// the last to be at least 5 MB.
+#define S3CLIENT_DEFAULT_PART_SIZE		(8*1024*1024)
+
 // --------------------------------------------------------------------------
 //
 // Class
 //		Name:    S3Client
-//		Purpose: Amazon S3 client helper implementation class
+//		Purpose: Amazon S3 client helper implementation class. Keeps
+//			 a pool of HTTP/1.1 connections to the server open
+//			 for reuse between requests. Single requests use the
+//			 first connection; SendRequests() spreads a batch of
+//			 requests over up to GetMaxConnections() connections,
+//			 pipelining up to GetPipelineDepth() requests without
+//			 bodies on each one, from a single thread. Large
+//			 objects can be uploaded in parts, and downloaded in
+//			 ranges, so that a failure only means sending part of
+//			 the object again.
 //		Created: 09/01/2009
 //
 // --------------------------------------------------------------------------
@@ -37,7 +57,10 @@ class S3Client
 	  mHostName(rHostName),
 	  mAccessKey(rAccessKey),
 	  mSecretKey(rSecretKey),
-	  mNetworkTimeout(30000)
+	  mNetworkTimeout(30000),
+	  mMaxConnections(S3CLIENT_DEFAULT_MAX_CONNECTIONS),
+	  mPipelineDepth(S3CLIENT_DEFAULT_PIPELINE_DEPTH),
+	  mConnectionsOpened(0)
 	{ }
 	
 	S3Client(std::string HostName, int Port, const std::string& rAccessKey,
@@ -47,32 +70,138 @@ class S3Client
 	  mPort(Port),
 	  mAccessKey(rAccessKey),
 	  mSecretKey(rSecretKey),
-	  mNetworkTimeout(30000)
+	  mNetworkTimeout(30000),
+	  mMaxConnections(S3CLIENT_DEFAULT_MAX_CONNECTIONS),
+	  mPipelineDepth(S3CLIENT_DEFAULT_PIPELINE_DEPTH),
+	  mConnectionsOpened(0)
 	{ }
-		
-	HTTPResponse GetObject(const std::string& rObjectURI);
+
+	~S3Client();
+
+	private:
+	// The open connections belong to this object, so it can't be copied
+	S3Client(const S3Client& rToCopy);
+	S3Client& operator=(const S3Client& rToCopy);
+
+	public:
+	// --------------------------------------------------------------------------
+	//
+	// Class
+	//		Name:    S3Client::Request
+	//		Purpose: One of a batch of requests for SendRequests().
+	//			 The stream to send, if any, must remain valid
+	//			 until SendRequests() returns.
+	//		Created: 2026/10/19
+	//
+	// --------------------------------------------------------------------------
+	class Request
+	{
+		public:
+		Request(HTTPRequest::Method Method, const std::string& rObjectURI,
+			IOStream* pStreamToSend = NULL,
+			const char* pContentType = NULL)
+		: mMethod(Method),
+		  mObjectURI(rObjectURI),
+		  mpStreamToSend(pStreamToSend),
+		  mpContentType(pContentType)
+		{ }
+
+		HTTPRequest::Method mMethod;
+		std::string mObjectURI;
+		IOStream* mpStreamToSend;
+		const char* mpContentType;
+		HTTPRequest::Query_t mQuery;
+	};
+
+	HTTPResponse GetObject(const std::string& rObjectURI,
+		const std::string& rIfNoneMatch = "");
 	HTTPResponse HeadObject(const std::string& rObjectURI);
 	HTTPResponse PutObject(const std::string& rObjectURI,
 		IOStream& rStreamToSend, const char* pContentType = NULL);
+	HTTPResponse DeleteObject(const std::string& rObjectURI);
+	HTTPResponse GetObjectRange(const std::string& rObjectURI,
+		int64_t Start, int64_t Length = -1,
+		const std::string& rIfNoneMatch = "");
+	void SendRequests(const std::vector<Request>& rRequests,
+		std::vector<HTTPResponse>& rResponses);
+	void GetObjects(const std::vector<std::string>& rObjectURIs,
+		std::vector<HTTPResponse>& rResponses);
+
+	// Multipart uploads
+	HTTPResponse PutObjectMultipart(const std::string& rObjectURI,
+		IOStream& rStreamToSend,
+		int PartSize = S3CLIENT_DEFAULT_PART_SIZE,
+		const char* pContentType = NULL);
+	std::string InitiateMultipartUpload(const std::string& rObjectURI,
+		const char* pContentType = NULL);
+	std::string UploadPart(const std::string& rObjectURI,
+		const std::string& rUploadID, int PartNumber,
+		IOStream& rStreamToSend);
+	void UploadParts(const std::string& rObjectURI,
+		const std::string& rUploadID, IOStream& rStreamToSend,
+		int PartSize, std::vector<std::string>& rPartETags);
+	HTTPResponse CompleteMultipartUpload(const std::string& rObjectURI,
+		const std::string& rUploadID,
+		const std::vector<std::string>& rPartETags);
+	HTTPResponse AbortMultipartUpload(const std::string& rObjectURI,
+		const std::string& rUploadID);
+
+	void ListBucket(std::vector<std::string>* pKeysOut,
+		std::vector<std::string>* pCommonPrefixesOut,
+		const std::string& rPrefix = "",
+		const std::string& rDelimiter = "/");
 	void CheckResponse(const HTTPResponse& response, const std::string& message) const;
 	int GetNetworkTimeout() const { return mNetworkTimeout; }
+	const std::string& GetHostName() const { return mHostName; }
+
+	void SetMaxConnections(int MaxConnections);
+	int GetMaxConnections() const { return mMaxConnections; }
+	void SetPipelineDepth(int PipelineDepth);
+	int GetPipelineDepth() const { return mPipelineDepth; }
+	int GetNumConnectionsOpened() const { return mConnectionsOpened; }
+	void CloseConnections();
+
+	// Shared with the S3Simulator
+	static void GetXMLElements(const std::string& rXML,
+		const std::string& rName, std::vector<std::string>& rValuesOut);
+	static std::string GetSubResourcesToSign(const HTTPRequest& rRequest);
 
 	private:
+	// An open connection to the server, with the line reader which holds
+	// any data read ahead from it, which belongs to the next response.
+	class Connection
+	{
+		public:
+		Connection() : mGetLine(mSocket) { }
+		SocketStream mSocket;
+		IOStreamGetLine mGetLine;
+	};
+
 	HTTPServer* mpSimulator;
 	std::string mHostName;
 	int mPort;
-	std::auto_ptr<SocketStream> mapClientSocket;
+	std::vector<Connection*> mConnections;
 	std::string mAccessKey, mSecretKey;
 	int mNetworkTimeout; // milliseconds
+	int mMaxConnections, mPipelineDepth, mConnectionsOpened;
 
+	void PrepareRequest(HTTPRequest& rRequest,
+		const char* pStreamContentType = NULL,
+		const HTTPRequest::Query_t* pQuery = NULL);
 	HTTPResponse FinishAndSendRequest(HTTPRequest::Method Method,
 		const std::string& rRequestURI,
 		IOStream* pStreamToSend = NULL,
-		const char* pStreamContentType = NULL);
+		const char* pStreamContentType = NULL,
+		const HTTPRequest::Query_t* pQuery = NULL);
+	HTTPResponse FinishAndSendRequest(HTTPRequest& rRequest,
+		IOStream* pStreamToSend = NULL,
+		const char* pStreamContentType = NULL,
+		const HTTPRequest::Query_t* pQuery = NULL);
 	HTTPResponse SendRequest(HTTPRequest& rRequest,
 		IOStream* pStreamToSend = NULL,
 		const char* pStreamContentType = NULL);
+	Connection& GetIdleConnection(size_t Index);
+	void CloseConnection(size_t Index);
 };
 
 #endif // S3CLIENT__H
-
@@ -10,8 +10,16 @@
 #include "Box.h"
 
 #include <algorithm>
+#include <cctype>
+#include <cerrno>
 #include <cstring>
 
+#include <sys/types.h>
+
+#ifdef HAVE_DIRENT_H
+#	include <dirent.h>
+#endif
+
 // #include <cstdio>
 // #include <ctime>
 
@@ -22,7 +30,11 @@
 #include "autogen_HTTPException.h"
 #include "IOStream.h"
 #include "Logging.h"
+#include "MD5Digest.h"
+#include "PartialReadStream.h"
+#include "S3Client.h"
 #include "S3Simulator.h"
+#include "Utils.h"
 #include "decode.h"
 #include "encode.h"
 
@@ -142,7 +154,8 @@ void S3Simulator::Handle(HTTPRequest &rRequest, HTTPResponse &rResponse)
 			data << "/" << bucket;
 		}
 
-		data << rRequest.GetRequestURI();
+		data << rRequest.GetRequestURI() <<
+			S3Client::GetSubResourcesToSign(rRequest);
 		std::string data_string = data.str();
 
 		unsigned char digest_buffer[EVP_MAX_MD_SIZE];
@@ -179,6 +192,18 @@ void S3Simulator::Handle(HTTPRequest &rRequest, HTTPResponse &rResponse)
 		{
 			HandlePut(rRequest, rResponse);
 		}
+		else if (rRequest.GetMethod() == HTTPRequest::Method_HEAD)
+		{
+			HandleHead(rRequest, rResponse);
+		}
+		else if (rRequest.GetMethod() == HTTPRequest::Method_DELETE)
+		{
+			HandleDelete(rRequest, rResponse);
+		}
+		else if (rRequest.GetMethod() == HTTPRequest::Method_POST)
+		{
+			HandlePost(rRequest, rResponse);
+		}
 		else
 		{
 			rResponse.SetResponseCode(HTTPResponse::Code_MethodNotAllowed);
@@ -200,7 +225,9 @@ void S3Simulator::Handle(HTTPRequest &rRequest, HTTPResponse &rResponse)
 	}
 
 	if (rResponse.GetResponseCode() != 200 &&
-		rResponse.GetSize() == 0)
+		rResponse.GetResponseCode() != 204 &&
+		rRequest.GetMethod() != HTTPRequest::Method_HEAD &&
+		rResponse.GetSize() == 0 && !rResponse.HasDataStream())
 	{
 		// no error message written, provide a default
 		std::ostringstream s;
@@ -214,6 +241,26 @@ void S3Simulator::Handle(HTTPRequest &rRequest, HTTPResponse &rResponse)
 	return;
 }
 
+static bool ParseRange(const std::string& rRange, int64_t Size,
+	int64_t& rStart, int64_t& rEnd);
+
+// Returns the ETag of the object stored in a file, which is the digest of
+// its contents, as S3 uses for objects uploaded in one piece. Unlike S3, it's
+// the same for objects made by multipart uploads.
+static std::string GetFileETag(const std::string& rPath)
+{
+	MD5Digest digest;
+	FileStream file(rPath);
+	char buffer[4096];
+	while (file.StreamDataLeft())
+	{
+		int bytes = file.Read(buffer, sizeof(buffer));
+		digest.Add(buffer, bytes);
+	}
+	digest.Finish();
+	return "\"" + digest.DigestAsString() + "\"";
+}
+
 // --------------------------------------------------------------------------
 //
 // Function
@@ -227,6 +274,12 @@ void S3Simulator::Handle(HTTPRequest &rRequest, HTTPResponse &rResponse)
 
 void S3Simulator::HandleGet(HTTPRequest &rRequest, HTTPResponse &rResponse)
 {
+	if (rRequest.GetRequestURI() == "/")
+	{
+		HandleListBucket(rRequest, rResponse);
+		return;
+	}
+
 	std::string path = GetConfiguration().GetKeyValue("StoreDirectory");
 	path += rRequest.GetRequestURI();
 	std::auto_ptr<FileStream> apFile;
@@ -249,16 +302,119 @@ void S3Simulator::HandleGet(HTTPRequest &rRequest, HTTPResponse &rResponse)
 	}
 
 	// http://docs.amazonwebservices.com/AmazonS3/2006-03-01/UsingRESTOperations.html
-	apFile->CopyStreamTo(rResponse);
+	std::string etag = GetFileETag(path);
 	rResponse.AddHeader("x-amz-id-2", "qBmKRcEWBBhH6XAqsKU/eg24V3jf/kWKN9dJip1L/FpbYr9FDy7wWFurfdQOEMcY");
 	rResponse.AddHeader("x-amz-request-id", "F2A8CCCA26B4B26D");
 	rResponse.AddHeader("Date", "Wed, 01 Mar  2006 12:00:00 GMT");
 	rResponse.AddHeader("Last-Modified", "Sun, 1 Jan 2006 12:00:00 GMT");
-	rResponse.AddHeader("ETag", "\"828ef3fdfa96f00ad9f27c383fc9ac7f\"");
+	rResponse.AddHeader("ETag", etag);
 	rResponse.AddHeader("Server", "AmazonS3");
+
+	// A client with a copy of the object which it knows is current
+	// doesn't need it again
+	std::string ifNoneMatch;
+	if (rRequest.GetHeader("if-none-match", &ifNoneMatch) &&
+		ifNoneMatch == etag)
+	{
+		rResponse.SetResponseCode(HTTPResponse::Code_NotModified);
+		return;
+	}
+
+	// Only a single range of bytes is supported. Anything else is
+	// ignored, as HTTP allows, and the whole object returned.
+	std::string range;
+	int64_t start, end;
+	IOStream::pos_type size = apFile->BytesLeftToRead();
+	if (rRequest.GetHeader("range", &range) &&
+		ParseRange(range, size, start, end))
+	{
+		std::ostringstream contentRange;
+		if (start >= size || start > end)
+		{
+			contentRange << "bytes */" << size;
+			rResponse.AddHeader("Content-Range", contentRange.str());
+			rResponse.SetResponseCode(
+				HTTPResponse::Code_RangeNotSatisfiable);
+			return;
+		}
+
+		contentRange << "bytes " << start << "-" << end << "/" << size;
+		rResponse.AddHeader("Content-Range", contentRange.str());
+		apFile->Seek(start, IOStream::SeekType_Absolute);
+		rResponse.SetDataStream(std::auto_ptr<IOStream>(
+			new PartialReadStream(std::auto_ptr<IOStream>(apFile),
+				end - start + 1)));
+		rResponse.SetResponseCode(HTTPResponse::Code_PartialContent);
+		return;
+	}
+
+	// Send the file straight from disc, rather than reading it all into
+	// memory first.
+	rResponse.SetDataStream(std::auto_ptr<IOStream>(apFile));
 	rResponse.SetResponseCode(HTTPResponse::Code_OK);
 }
 
+// Parses an HTTP Range header for a single range of bytes, in an object of
+// the given size. Returns false if it's not a range that we support.
+static bool ParseRange(const std::string& rRange, int64_t Size,
+	int64_t& rStart, int64_t& rEnd)
+{
+	if (rRange.compare(0, 6, "bytes=") != 0 ||
+		rRange.find(',') != std::string::npos)
+	{
+		return false;
+	}
+
+	std::string::size_type dash = rRange.find('-', 6);
+	if (dash == std::string::npos)
+	{
+		return false;
+	}
+
+	std::string first = rRange.substr(6, dash - 6);
+	std::string last = rRange.substr(dash + 1);
+	if (first.empty() && last.empty())
+	{
+		return false;
+	}
+
+	if (first.empty())
+	{
+		// The last N bytes
+		int64_t length = ::strtoll(last.c_str(), NULL, 10);
+		rStart = (length > Size) ? 0 : (Size - length);
+		rEnd = Size - 1;
+		return true;
+	}
+
+	rStart = ::strtoll(first.c_str(), NULL, 10);
+	rEnd = last.empty() ? (Size - 1) : ::strtoll(last.c_str(), NULL, 10);
+	if (rEnd >= Size)
+	{
+		rEnd = Size - 1;
+	}
+	return true;
+}
+
+// S3 keys are flat, so create any directories in the key that the object is
+// stored under.
+static void CreateKeyDirectories(const std::string& rStoreDir,
+	const std::string& rKey)
+{
+	std::string::size_type slash = rKey.find('/', 1);
+	while (slash != std::string::npos)
+	{
+		std::string dir = rStoreDir + rKey.substr(0, slash);
+		if (ObjectExists(dir) == ObjectExists_NoObject &&
+			::mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+		{
+			THROW_SYS_FILE_ERROR("Failed to create directory for "
+				"object", dir, CommonException, OSFileError);
+		}
+		slash = rKey.find('/', slash + 1);
+	}
+}
+
 // --------------------------------------------------------------------------
 //
 // Function
@@ -272,13 +428,22 @@ void S3Simulator::HandleGet(HTTPRequest &rRequest, HTTPResponse &rResponse)
 
 void S3Simulator::HandlePut(HTTPRequest &rRequest, HTTPResponse &rResponse)
 {
+	if (rRequest.GetQuery().count("uploadId"))
+	{
+		HandleUploadPart(rRequest, rResponse);
+		return;
+	}
+
 	std::string path = GetConfiguration().GetKeyValue("StoreDirectory");
 	path += rRequest.GetRequestURI();
 	std::auto_ptr<FileStream> apFile;
 
+	CreateKeyDirectories(GetConfiguration().GetKeyValue("StoreDirectory"),
+		rRequest.GetRequestURI());
+
 	try
 	{
-		apFile.reset(new FileStream(path, O_CREAT | O_WRONLY));
+		apFile.reset(new FileStream(path, O_CREAT | O_WRONLY | O_TRUNC));
 	}
 	catch (CommonException &ce)
 	{
@@ -299,14 +464,593 @@ void S3Simulator::HandlePut(HTTPRequest &rRequest, HTTPResponse &rResponse)
 	}
 
 	rRequest.ReadContent(*apFile);
+	apFile.reset();
 
 	// http://docs.amazonwebservices.com/AmazonS3/2006-03-01/RESTObjectPUT.html
 	rResponse.AddHeader("x-amz-id-2", "LriYPLdmOdAiIfgSm/F1YsViT1LW94/xUQxMsF7xiEb1a0wiIOIxl+zbwZ163pt7");
 	rResponse.AddHeader("x-amz-request-id", "F2A8CCCA26B4B26D");
 	rResponse.AddHeader("Date", "Wed, 01 Mar  2006 12:00:00 GMT");
 	rResponse.AddHeader("Last-Modified", "Sun, 1 Jan 2006 12:00:00 GMT");
-	rResponse.AddHeader("ETag", "\"828ef3fdfa96f00ad9f27c383fc9ac7f\"");
+	rResponse.AddHeader("ETag", GetFileETag(path));
+	rResponse.SetContentType("");
+	rResponse.AddHeader("Server", "AmazonS3");
+	rResponse.SetResponseCode(HTTPResponse::Code_OK);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Simulator::HandleHead(HTTPRequest &rRequest,
+//			 HTTPResponse &rResponse)
+//		Purpose: Handles an S3 HEAD request, i.e. checking whether
+//			 an object exists without downloading it.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Simulator::HandleHead(HTTPRequest &rRequest, HTTPResponse &rResponse)
+{
+	std::string path = GetConfiguration().GetKeyValue("StoreDirectory");
+	path += rRequest.GetRequestURI();
+
+	if (ObjectExists(path) != ObjectExists_File)
+	{
+		rResponse.SetResponseCode(HTTPResponse::Code_NotFound);
+		return;
+	}
+
+	rResponse.AddHeader("x-amz-id-2", "qBmKRcEWBBhH6XAqsKU/eg24V3jf/kWKN9dJip1L/FpbYr9FDy7wWFurfdQOEMcY");
+	rResponse.AddHeader("x-amz-request-id", "F2A8CCCA26B4B26D");
+	rResponse.AddHeader("Date", "Wed, 01 Mar  2006 12:00:00 GMT");
+	rResponse.AddHeader("Last-Modified", "Sun, 1 Jan 2006 12:00:00 GMT");
+	rResponse.AddHeader("ETag", GetFileETag(path));
+	rResponse.AddHeader("Server", "AmazonS3");
+	rResponse.SetResponseCode(HTTPResponse::Code_OK);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Simulator::HandleDelete(HTTPRequest &rRequest,
+//			 HTTPResponse &rResponse)
+//		Purpose: Handles an S3 DELETE request, i.e. deleting an
+//			 object. Like S3, succeeds whether or not the object
+//			 existed.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Simulator::HandleDelete(HTTPRequest &rRequest, HTTPResponse &rResponse)
+{
+	if (rRequest.GetQuery().count("uploadId"))
+	{
+		HandleAbortMultipartUpload(rRequest, rResponse);
+		return;
+	}
+
+	std::string path = GetConfiguration().GetKeyValue("StoreDirectory");
+	path += rRequest.GetRequestURI();
+
+	if (EMU_UNLINK(path.c_str()) != 0 && errno != ENOENT)
+	{
+		if (errno == EACCES)
+		{
+			rResponse.SetResponseCode(HTTPResponse::Code_Forbidden);
+		}
+		THROW_SYS_FILE_ERROR("Failed to delete object", path,
+			CommonException, OSFileError);
+	}
+
+	rResponse.AddHeader("x-amz-id-2", "LriYPLdmOdAiIfgSm/F1YsViT1LW94/xUQxMsF7xiEb1a0wiIOIxl+zbwZ163pt7");
+	rResponse.AddHeader("x-amz-request-id", "F2A8CCCA26B4B26D");
+	rResponse.AddHeader("Date", "Wed, 01 Mar  2006 12:00:00 GMT");
+	rResponse.AddHeader("Server", "AmazonS3");
+	rResponse.SetResponseCode(HTTPResponse::Code_NoContent);
+}
+
+static std::string XMLEscape(const std::string& rValue)
+{
+	std::string escaped;
+	for (std::string::const_iterator i = rValue.begin();
+		i != rValue.end(); i++)
+	{
+		switch (*i)
+		{
+		case '&': escaped += "&amp;"; break;
+		case '<': escaped += "&lt;"; break;
+		case '>': escaped += "&gt;"; break;
+		default:  escaped += *i;
+		}
+	}
+	return escaped;
+}
+
+// Adds the keys of all objects under rKeyDir (which is empty or ends with a
+// slash) whose names start with rPrefix to rKeys, recursing into directories
+// unless a delimiter is given, in which case they are common prefixes.
+static void ListStoreDirectory(const std::string& rStoreDir,
+	const std::string& rKeyDir, const std::string& rPrefix,
+	bool Delimited, std::vector<std::string>& rKeys,
+	std::vector<std::string>& rCommonPrefixes)
+{
+	std::string path = rStoreDir + "/" + rKeyDir;
+	DIR *dirHandle = ::opendir(path.c_str());
+	if (dirHandle == NULL)
+	{
+		// Nothing stored under this prefix
+		return;
+	}
+
+	struct dirent *en;
+	while ((en = ::readdir(dirHandle)) != NULL)
+	{
+		std::string name(en->d_name);
+		if (name == "." || name == ".." ||
+			name.compare(0, rPrefix.size(), rPrefix) != 0 ||
+			(rKeyDir.empty() && name == S3SIMULATOR_UPLOADS_DIR))
+		{
+			continue;
+		}
+
+		int type = ObjectExists(path + name);
+		if (type == ObjectExists_File)
+		{
+			rKeys.push_back(rKeyDir + name);
+		}
+		else if (type == ObjectExists_Dir && Delimited)
+		{
+			rCommonPrefixes.push_back(rKeyDir + name + "/");
+		}
+		else if (type == ObjectExists_Dir)
+		{
+			ListStoreDirectory(rStoreDir, rKeyDir + name + "/", "",
+				Delimited, rKeys, rCommonPrefixes);
+		}
+	}
+	::closedir(dirHandle);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Simulator::HandleListBucket(HTTPRequest &rRequest,
+//			 HTTPResponse &rResponse)
+//		Purpose: Handles an S3 GET request for the bucket itself,
+//			 i.e. listing the objects in it, optionally only
+//			 those with keys starting with a prefix, and after a
+//			 marker. Only "/" is supported as a delimiter.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Simulator::HandleListBucket(HTTPRequest &rRequest,
+	HTTPResponse &rResponse)
+{
+	std::string prefix, delimiter, marker;
+	const HTTPRequest::Query_t& rQuery(rRequest.GetQuery());
+	HTTPRequest::Query_t::const_iterator i;
+	if ((i = rQuery.find("prefix")) != rQuery.end()) prefix = i->second;
+	if ((i = rQuery.find("delimiter")) != rQuery.end()) delimiter = i->second;
+	if ((i = rQuery.find("marker")) != rQuery.end()) marker = i->second;
+
+	if (!delimiter.empty() && delimiter != "/")
+	{
+		rResponse.SetResponseCode(HTTPResponse::Code_NotImplemented);
+		THROW_EXCEPTION_MESSAGE(HTTPException, NotImplemented,
+			"Only / is supported as a delimiter");
+	}
+
+	std::string::size_type slash = prefix.rfind('/');
+	std::string keyDir = (slash == std::string::npos) ? "" :
+		prefix.substr(0, slash + 1);
+	std::vector<std::string> keys, commonPrefixes;
+	ListStoreDirectory(GetConfiguration().GetKeyValue("StoreDirectory"),
+		keyDir, prefix.substr(keyDir.size()), !delimiter.empty(), keys,
+		commonPrefixes);
+	std::sort(keys.begin(), keys.end());
+	std::sort(commonPrefixes.begin(), commonPrefixes.end());
+
+	std::ostringstream xml;
+	xml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<ListBucketResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">"
+		"<Name>bucket</Name>"
+		"<Prefix>" << XMLEscape(prefix) << "</Prefix>"
+		"<Marker>" << XMLEscape(marker) << "</Marker>"
+		"<MaxKeys>1000</MaxKeys>"
+		"<IsTruncated>false</IsTruncated>";
+	for (std::vector<std::string>::iterator k = keys.begin();
+		k != keys.end(); k++)
+	{
+		if (*k > marker)
+		{
+			xml << "<Contents><Key>" << XMLEscape(*k) << "</Key></Contents>";
+		}
+	}
+	for (std::vector<std::string>::iterator p = commonPrefixes.begin();
+		p != commonPrefixes.end(); p++)
+	{
+		if (*p > marker)
+		{
+			xml << "<CommonPrefixes><Prefix>" << XMLEscape(*p) <<
+				"</Prefix></CommonPrefixes>";
+		}
+	}
+	xml << "</ListBucketResult>";
+
+	rResponse.WriteString(xml.str());
+	rResponse.SetContentType("application/xml");
+	rResponse.AddHeader("x-amz-request-id", "F2A8CCCA26B4B26D");
+	rResponse.AddHeader("Server", "AmazonS3");
+	rResponse.SetResponseCode(HTTPResponse::Code_OK);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Simulator::GetUploadDirectory(
+//			 HTTPRequest &rRequest, HTTPResponse &rResponse)
+//		Purpose: Returns the directory where the parts of the
+//			 multipart upload identified by the request's
+//			 uploadId parameter are kept, after checking that
+//			 the upload exists and is for the requested key.
+//			 Uploads are kept on disc, rather than in memory,
+//			 because each connection is handled by a different
+//			 process.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+std::string S3Simulator::GetUploadDirectory(HTTPRequest &rRequest,
+	HTTPResponse &rResponse)
+{
+	std::string uploadID = rRequest.GetQuery().find("uploadId")->second;
+	bool valid = !uploadID.empty();
+	for (std::string::iterator i = uploadID.begin(); i != uploadID.end();
+		i++)
+	{
+		if (!isxdigit(*i))
+		{
+			valid = false;
+		}
+	}
+
+	std::string dir = GetConfiguration().GetKeyValue("StoreDirectory") +
+		"/" S3SIMULATOR_UPLOADS_DIR "/" + uploadID;
+	std::string key;
+	if (valid && ObjectExists(dir + "/key") == ObjectExists_File)
+	{
+		FileStream keyFile(dir + "/key");
+		char buffer[1024];
+		int bytes = keyFile.Read(buffer, sizeof(buffer));
+		key = std::string(buffer, bytes);
+	}
+
+	if (key.empty() || key != rRequest.GetRequestURI())
+	{
+		rResponse.SetResponseCode(HTTPResponse::Code_NotFound);
+		THROW_EXCEPTION_MESSAGE(HTTPException, BadRequest,
+			"NoSuchUpload: " << uploadID);
+	}
+
+	return dir;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Simulator::HandlePost(HTTPRequest &rRequest,
+//			 HTTPResponse &rResponse)
+//		Purpose: Handles an S3 POST request, which starts or
+//			 completes a multipart upload.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Simulator::HandlePost(HTTPRequest &rRequest, HTTPResponse &rResponse)
+{
+	if (rRequest.GetQuery().count("uploads"))
+	{
+		HandleInitiateMultipartUpload(rRequest, rResponse);
+	}
+	else if (rRequest.GetQuery().count("uploadId"))
+	{
+		HandleCompleteMultipartUpload(rRequest, rResponse);
+	}
+	else
+	{
+		rResponse.SetResponseCode(HTTPResponse::Code_NotImplemented);
+		THROW_EXCEPTION_MESSAGE(HTTPException, NotImplemented,
+			"Unsupported POST request");
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Simulator::HandleInitiateMultipartUpload(
+//			 HTTPRequest &rRequest, HTTPResponse &rResponse)
+//		Purpose: Handles a request to start a multipart upload,
+//			 returning a new upload ID.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Simulator::HandleInitiateMultipartUpload(HTTPRequest &rRequest,
+	HTTPResponse &rResponse)
+{
+	std::string uploadsDir = GetConfiguration().GetKeyValue("StoreDirectory") +
+		"/" S3SIMULATOR_UPLOADS_DIR;
+	if (ObjectExists(uploadsDir) == ObjectExists_NoObject &&
+		::mkdir(uploadsDir.c_str(), 0755) != 0 && errno != EEXIST)
+	{
+		THROW_SYS_FILE_ERROR("Failed to create uploads directory",
+			uploadsDir, CommonException, OSFileError);
+	}
+
+	std::ostringstream uploadID;
+	uploadID << std::hex << GetCurrentBoxTime() << getpid();
+	std::string dir = uploadsDir + "/" + uploadID.str();
+	if (::mkdir(dir.c_str(), 0755) != 0)
+	{
+		THROW_SYS_FILE_ERROR("Failed to create upload directory", dir,
+			CommonException, OSFileError);
+	}
+
+	FileStream keyFile(dir + "/key", O_CREAT | O_WRONLY | O_TRUNC);
+	keyFile.Write(rRequest.GetRequestURI());
+
+	std::ostringstream xml;
+	xml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<InitiateMultipartUploadResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">"
+		"<Bucket>bucket</Bucket>"
+		"<Key>" << XMLEscape(rRequest.GetRequestURI().substr(1)) << "</Key>"
+		"<UploadId>" << uploadID.str() << "</UploadId>"
+		"</InitiateMultipartUploadResult>";
+
+	rResponse.WriteString(xml.str());
+	rResponse.SetContentType("application/xml");
+	rResponse.AddHeader("x-amz-request-id", "F2A8CCCA26B4B26D");
+	rResponse.AddHeader("Server", "AmazonS3");
+	rResponse.SetResponseCode(HTTPResponse::Code_OK);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Simulator::HandleUploadPart(
+//			 HTTPRequest &rRequest, HTTPResponse &rResponse)
+//		Purpose: Handles an S3 PUT request for one part of a
+//			 multipart upload, returning the MD5 digest of the
+//			 part as its ETag, as S3 does. Unlike S3, parts may
+//			 be of any size.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Simulator::HandleUploadPart(HTTPRequest &rRequest,
+	HTTPResponse &rResponse)
+{
+	std::string dir = GetUploadDirectory(rRequest, rResponse);
+
+	HTTPRequest::Query_t::const_iterator i =
+		rRequest.GetQuery().find("partNumber");
+	int partNumber = (i == rRequest.GetQuery().end()) ? 0 :
+		::strtol(i->second.c_str(), NULL, 10);
+	if (partNumber < 1 || partNumber > 10000)
+	{
+		rResponse.SetResponseCode(HTTPResponse::Code_MethodNotAllowed);
+		THROW_EXCEPTION_MESSAGE(HTTPException, BadRequest,
+			"InvalidArgument: part number must be between 1 and "
+			"10000");
+	}
+
+	std::ostringstream partPath;
+	partPath << dir << "/" << partNumber;
+
+	{
+		FileStream partFile(partPath.str(), O_CREAT | O_WRONLY | O_TRUNC);
+
+		if (rRequest.IsExpectingContinue())
+		{
+			rResponse.SendContinue();
+		}
+
+		rRequest.ReadContent(partFile);
+	}
+
+	rResponse.AddHeader("x-amz-request-id", "F2A8CCCA26B4B26D");
+	rResponse.AddHeader("ETag", GetFileETag(partPath.str()));
 	rResponse.SetContentType("");
 	rResponse.AddHeader("Server", "AmazonS3");
 	rResponse.SetResponseCode(HTTPResponse::Code_OK);
 }
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Simulator::HandleCompleteMultipartUpload(
+//			 HTTPRequest &rRequest, HTTPResponse &rResponse)
+//		Purpose: Handles a request to complete a multipart upload,
+//			 joining the listed parts, which must be in order and
+//			 have the ETags returned when they were uploaded, to
+//			 make the object, and deleting the upload.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Simulator::HandleCompleteMultipartUpload(HTTPRequest &rRequest,
+	HTTPResponse &rResponse)
+{
+	std::string dir = GetUploadDirectory(rRequest, rResponse);
+
+	if (rRequest.IsExpectingContinue())
+	{
+		rResponse.SendContinue();
+	}
+
+	CollectInBufferStream body;
+	rRequest.ReadContent(body);
+	body.SetForReading();
+
+	std::vector<std::string> parts, partNumbers, etags;
+	S3Client::GetXMLElements(std::string((const char *)body.GetBuffer(),
+		body.GetSize()), "Part", parts);
+	for (std::vector<std::string>::iterator i = parts.begin();
+		i != parts.end(); i++)
+	{
+		S3Client::GetXMLElements(*i, "PartNumber", partNumbers);
+		S3Client::GetXMLElements(*i, "ETag", etags);
+	}
+
+	if (parts.empty() || partNumbers.size() != parts.size() ||
+		etags.size() != parts.size())
+	{
+		rResponse.SetResponseCode(HTTPResponse::Code_MethodNotAllowed);
+		THROW_EXCEPTION_MESSAGE(HTTPException, BadRequest,
+			"MalformedXML: no parts listed");
+	}
+
+	// Check all the parts before changing anything
+	std::vector<std::string> partPaths;
+	MD5Digest objectDigest;
+	int lastPartNumber = 0;
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		int partNumber = ::strtol(partNumbers[i].c_str(), NULL, 10);
+		if (partNumber <= lastPartNumber)
+		{
+			rResponse.SetResponseCode(
+				HTTPResponse::Code_MethodNotAllowed);
+			THROW_EXCEPTION_MESSAGE(HTTPException, BadRequest,
+				"InvalidPartOrder: " << partNumber);
+		}
+		lastPartNumber = partNumber;
+
+		std::ostringstream partPath;
+		partPath << dir << "/" << partNumber;
+
+		MD5Digest digest;
+		if (ObjectExists(partPath.str()) == ObjectExists_File)
+		{
+			FileStream partFile(partPath.str());
+			char buffer[4096];
+			while (partFile.StreamDataLeft())
+			{
+				int bytes = partFile.Read(buffer, sizeof(buffer));
+				digest.Add(buffer, bytes);
+			}
+		}
+		digest.Finish();
+
+		if (ObjectExists(partPath.str()) != ObjectExists_File ||
+			etags[i] != "\"" + digest.DigestAsString() + "\"")
+		{
+			rResponse.SetResponseCode(
+				HTTPResponse::Code_MethodNotAllowed);
+			THROW_EXCEPTION_MESSAGE(HTTPException, BadRequest,
+				"InvalidPart: " << partNumber);
+		}
+
+		partPaths.push_back(partPath.str());
+		int length;
+		uint8_t *pDigest = digest.DigestAsData(&length);
+		objectDigest.Add(pDigest, length);
+	}
+	objectDigest.Finish();
+
+	std::string path = GetConfiguration().GetKeyValue("StoreDirectory") +
+		rRequest.GetRequestURI();
+	CreateKeyDirectories(GetConfiguration().GetKeyValue("StoreDirectory"),
+		rRequest.GetRequestURI());
+	{
+		FileStream object(path, O_CREAT | O_WRONLY | O_TRUNC);
+		for (size_t i = 0; i < partPaths.size(); i++)
+		{
+			FileStream partFile(partPaths[i]);
+			partFile.CopyStreamTo(object);
+		}
+	}
+
+	DeleteUploadDirectory(dir);
+
+	// Like S3, the ETag of a multipart object is the digest of the
+	// digests of its parts, followed by the number of parts.
+	std::ostringstream etag;
+	etag << "\"" << objectDigest.DigestAsString() << "-" << parts.size() <<
+		"\"";
+
+	std::ostringstream xml;
+	xml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<CompleteMultipartUploadResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">"
+		"<Bucket>bucket</Bucket>"
+		"<Key>" << XMLEscape(rRequest.GetRequestURI().substr(1)) << "</Key>"
+		"<ETag>" << XMLEscape(etag.str()) << "</ETag>"
+		"</CompleteMultipartUploadResult>";
+
+	rResponse.WriteString(xml.str());
+	rResponse.SetContentType("application/xml");
+	rResponse.AddHeader("x-amz-request-id", "F2A8CCCA26B4B26D");
+	rResponse.AddHeader("Server", "AmazonS3");
+	rResponse.SetResponseCode(HTTPResponse::Code_OK);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Simulator::HandleAbortMultipartUpload(
+//			 HTTPRequest &rRequest, HTTPResponse &rResponse)
+//		Purpose: Handles a request to abandon a multipart upload,
+//			 deleting any parts already uploaded.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Simulator::HandleAbortMultipartUpload(HTTPRequest &rRequest,
+	HTTPResponse &rResponse)
+{
+	DeleteUploadDirectory(GetUploadDirectory(rRequest, rResponse));
+
+	rResponse.AddHeader("x-amz-request-id", "F2A8CCCA26B4B26D");
+	rResponse.AddHeader("Server", "AmazonS3");
+	rResponse.SetResponseCode(HTTPResponse::Code_NoContent);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    S3Simulator::DeleteUploadDirectory(
+//			 const std::string& rDirectory)
+//		Purpose: Deletes the directory of a multipart upload, and
+//			 the parts in it.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+void S3Simulator::DeleteUploadDirectory(const std::string& rDirectory)
+{
+	DIR *dirHandle = ::opendir(rDirectory.c_str());
+	if (dirHandle == NULL)
+	{
+		THROW_SYS_FILE_ERROR("Failed to open upload directory",
+			rDirectory, CommonException, OSFileError);
+	}
+
+	struct dirent *en;
+	while ((en = ::readdir(dirHandle)) != NULL)
+	{
+		std::string name(en->d_name);
+		if (name != "." && name != ".." &&
+			EMU_UNLINK((rDirectory + "/" + name).c_str()) != 0)
+		{
+			BOX_LOG_SYS_WARNING("Failed to delete upload file: " <<
+				rDirectory << "/" << name);
+		}
+	}
+	::closedir(dirHandle);
+
+	if (::rmdir(rDirectory.c_str()) != 0)
+	{
+		THROW_SYS_FILE_ERROR("Failed to delete upload directory",
+			rDirectory, CommonException, OSFileError);
+	}
+}
@@ -12,6 +12,10 @@
 
 #include "HTTPServer.h"
 
+// Multipart uploads in progress are kept in this subdirectory of the store
+// directory, which is not listed as part of the bucket.
+#define S3SIMULATOR_UPLOADS_DIR ".s3simulator-uploads"
+
 class ConfigurationVerify;
 class HTTPRequest;
 class HTTPResponse;
@@ -36,11 +40,29 @@ public:
 	virtual void Handle(HTTPRequest &rRequest, HTTPResponse &rResponse);
 	virtual void HandleGet(HTTPRequest &rRequest, HTTPResponse &rResponse);
 	virtual void HandlePut(HTTPRequest &rRequest, HTTPResponse &rResponse);
+	virtual void HandleHead(HTTPRequest &rRequest, HTTPResponse &rResponse);
+	virtual void HandleDelete(HTTPRequest &rRequest, HTTPResponse &rResponse);
+	virtual void HandlePost(HTTPRequest &rRequest, HTTPResponse &rResponse);
+	virtual void HandleListBucket(HTTPRequest &rRequest,
+		HTTPResponse &rResponse);
+	virtual void HandleInitiateMultipartUpload(HTTPRequest &rRequest,
+		HTTPResponse &rResponse);
+	virtual void HandleUploadPart(HTTPRequest &rRequest,
+		HTTPResponse &rResponse);
+	virtual void HandleCompleteMultipartUpload(HTTPRequest &rRequest,
+		HTTPResponse &rResponse);
+	virtual void HandleAbortMultipartUpload(HTTPRequest &rRequest,
+		HTTPResponse &rResponse);
 
 	virtual const char *DaemonName() const
 	{
 		return "s3simulator";
 	}
+
+private:
+	std::string GetUploadDirectory(HTTPRequest &rRequest,
+		HTTPResponse &rResponse);
+	void DeleteUploadDirectory(const std::string& rDirectory);
 };
 
 #endif // S3SIMULATOR__H
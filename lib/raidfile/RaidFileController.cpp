@@ -74,6 +74,8 @@ void RaidFileController::Initialise(const std::string& rConfigFilename)
 			ConfigTest_Exists | ConfigTest_IsInt),
 		ConfigurationVerifyKey("BlockSize",
 			ConfigTest_Exists | ConfigTest_IsInt),
+		ConfigurationVerifyKey("ReadAhead", ConfigTest_IsInt,
+			RAIDFILE_DEFAULT_READ_AHEAD),
 		ConfigurationVerifyKey("Dir0", ConfigTest_Exists),
 		ConfigurationVerifyKey("Dir1", ConfigTest_Exists),
 		ConfigurationVerifyKey("Dir2",
@@ -126,6 +128,12 @@ void RaidFileController::Initialise(const std::string& rConfigFilename)
 			THROW_EXCEPTION(RaidFileException, BadConfigFile)			
 		}
 		RaidFileDiscSet set(setNum, (unsigned int)disc.GetKeyValueInt("BlockSize"));
+		int readAhead = disc.GetKeyValueInt("ReadAhead");
+		if(readAhead < 0)
+		{
+			THROW_EXCEPTION(RaidFileException, BadConfigFile)
+		}
+		set.SetReadAhead((unsigned int)readAhead);
 		// Get the values of the directory keys
 		std::string d0(disc.GetKeyValue("Dir0"));
 		std::string d1(disc.GetKeyValue("Dir1"));
@@ -18,6 +18,9 @@
 #include <string>
 #include <vector>
 
+// Bytes of a RAID file to read ahead of the current position, by default
+#define RAIDFILE_DEFAULT_READ_AHEAD	(256*1024)
+
 // --------------------------------------------------------------------------
 //
 // Class
@@ -32,13 +35,15 @@ class RaidFileDiscSet : public std::vector<std::string>
 public:
 	RaidFileDiscSet(int SetID, unsigned int BlockSize)
 		: mSetID(SetID),
-		  mBlockSize(BlockSize)
+		  mBlockSize(BlockSize),
+		  mReadAhead(RAIDFILE_DEFAULT_READ_AHEAD)
 	{
 	}
 	RaidFileDiscSet(const RaidFileDiscSet &rToCopy)
 		: std::vector<std::string>(rToCopy),
 		  mSetID(rToCopy.mSetID),
-		  mBlockSize(rToCopy.mBlockSize)
+		  mBlockSize(rToCopy.mBlockSize),
+		  mReadAhead(rToCopy.mReadAhead)
 	{
 	}
 	
@@ -51,6 +56,8 @@ public:
 	int GetSetNumForWriteFiles(const std::string &rFilename) const;
 	int GetSetNumForWriteFiles(const char* filename) const;
 	unsigned int GetBlockSize() const {return mBlockSize;}
+	unsigned int GetReadAhead() const {return mReadAhead;}
+	void SetReadAhead(unsigned int ReadAhead) {mReadAhead = ReadAhead;}
 
 	// Is this disc set a non-RAID disc set? (ie files never get transformed to raid storage)
 	bool IsNonRaidSet() const {return 1 == size();}
@@ -58,6 +65,7 @@ public:
 private:
 	int mSetID;
 	unsigned int mBlockSize;
+	unsigned int mReadAhead;
 };
 
 class _RaidFileController;	// compiler warning avoidance
@@ -0,0 +1,868 @@
+// --------------------------------------------------------------------------
+//
+// File
+//		Name:    RaidFileScrubber.cpp
+//		Purpose: Background checking and repair of RAID files
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+#include "Box.h"
+
+#include <errno.h>
+#include <fcntl.h>
+
+#ifdef HAVE_UNISTD_H
+#	include <unistd.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+
+#include "FileStream.h"
+#include "IOStreamGetLine.h"
+#include "RaidFileController.h"
+#include "RaidFileException.h"
+#include "RaidFileRead.h"
+#include "RaidFileScrubber.h"
+#include "RaidFileUtil.h"
+#include "RaidFileWrite.h"
+#include "Utils.h"
+
+#include "MemLeakFindOn.h"
+
+#define SCRUB_NUMBER_DISCS_REQUIRED	3
+// Pairs of blocks compared with the parity at a time
+#define SCRUB_PAIRS_PER_READ		32
+// Files found in each walk of the directories
+#define SCRUB_FILES_PER_SEARCH		1024
+// Seconds between progress messages
+#define SCRUB_PROGRESS_INTERVAL		300
+// Repairs aren't split into slices, so they wait as long as they need to
+#define SCRUB_NO_DEADLINE		0x7fffffffffffffffLL
+
+// Splits a RaidFile name into its path elements. Names compare in the
+// order that the directories are walked in when compared like this.
+static std::vector<std::string> SplitRaidFilePath(const std::string &rName)
+{
+	std::vector<std::string> elements;
+	if(!rName.empty())
+	{
+		SplitString(rName, DIRECTORY_SEPARATOR_ASCHAR, elements);
+	}
+	return elements;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileScrubber::RaidFileScrubber(int, int64_t, bool,
+//			 RaidFileRepairLocker *)
+//		Purpose: Constructor. MaxBytesPerSecond limits the rate of
+//				 reading from the discs (zero for no limit), for
+//				 repairs too. If Repair is false, damaged files are
+//				 only reported. If pLocker is given, it's asked to
+//				 lock each file before it's repaired. Picks up where
+//				 the last scrubber for this disc set left off.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+RaidFileScrubber::RaidFileScrubber(int SetNumber, int64_t MaxBytesPerSecond,
+	bool Repair, RaidFileRepairLocker *pLocker)
+	: mSetNumber(SetNumber),
+	  mMaxBytesPerSecond(MaxBytesPerSecond),
+	  mRepair(Repair),
+	  mpLocker(pLocker),
+	  mNonRaidSet(false),
+	  mInPass(false),
+	  mReachedEnd(false),
+	  mLastPassFinished(0),
+	  mRevisionID(0),
+	  mBlockSize(0),
+	  mFileSize(0),
+	  mWholePairs(0),
+	  mPairsChecked(0),
+	  mpBuffer(0),
+	  mThrottleStart(0),
+	  mThrottleBytes(0),
+	  mNumFilesChecked(0),
+	  mNumBytesChecked(0),
+	  mNumFilesDamaged(0),
+	  mNumFilesRepaired(0),
+	  mNumFilesInconsistent(0),
+	  mNumFilesUnrecoverable(0),
+	  mLastProgressReport(0)
+{
+	for(int h = 0; h < SCRUB_NUMBER_DISCS_REQUIRED; h++)
+	{
+		mHandles[h] = -1;
+	}
+
+	RaidFileController &rcontroller(RaidFileController::GetController());
+	RaidFileDiscSet rdiscSet(rcontroller.GetDiscSet(mSetNumber));
+	if(rdiscSet.IsNonRaidSet())
+	{
+		// Nothing to check
+		mNonRaidSet = true;
+		return;
+	}
+	if(SCRUB_NUMBER_DISCS_REQUIRED != rdiscSet.size())
+	{
+		THROW_EXCEPTION(RaidFileException, WrongNumberOfDiscsInSet)
+	}
+
+	mBlockSize = rdiscSet.GetBlockSize();
+	mStateFilename = rdiscSet[0] + DIRECTORY_SEPARATOR
+		RAIDFILE_SCRUB_STATE_FILE;
+
+	// Room for the blocks from each stripe and the parity file, and the
+	// parity calculated from the stripes, with space on the end of the
+	// last two for the size record.
+	mpBuffer = (char *)::malloc((mBlockSize * SCRUB_PAIRS_PER_READ * 4) +
+		(sizeof(RaidFileRead::FileSizeType) * 2));
+	if(mpBuffer == 0)
+	{
+		throw std::bad_alloc();
+	}
+
+	LoadState();
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileScrubber::~RaidFileScrubber()
+//		Purpose: Destructor
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+RaidFileScrubber::~RaidFileScrubber()
+{
+	CloseFile();
+	if(mpBuffer != 0)
+	{
+		::free(mpBuffer);
+		mpBuffer = 0;
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileScrubber::Scrub(box_time_t)
+//		Purpose: Checks (and repairs) files until the time given, or
+//				 the end of the pass. Returns true if the pass is
+//				 complete, in which case the next call starts a new
+//				 pass at the beginning of the disc set.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool RaidFileScrubber::Scrub(box_time_t Until)
+{
+	if(mNonRaidSet)
+	{
+		return true;
+	}
+
+	if(!mInPass)
+	{
+		mInPass = true;
+		mNumFilesChecked = 0;
+		mNumBytesChecked = 0;
+		mNumFilesDamaged = 0;
+		mNumFilesRepaired = 0;
+		mNumFilesInconsistent = 0;
+		mNumFilesUnrecoverable = 0;
+		mLastProgressReport = GetCurrentBoxTime();
+
+		if(mPosition.empty())
+		{
+			BOX_INFO("Starting RAID scrub of disc set " <<
+				mSetNumber);
+		}
+		else
+		{
+			BOX_INFO("Resuming RAID scrub of disc set " <<
+				mSetNumber << " after " << mPosition);
+		}
+	}
+
+	while(true)
+	{
+		if(mFilename.empty())
+		{
+			if(mPendingFiles.empty() && !FindMoreFiles())
+			{
+				break;
+			}
+
+			std::string filename(mPendingFiles.front());
+			mPendingFiles.pop_front();
+			StartFile(filename);
+		}
+
+		if(!mFilename.empty() && !CheckSome(Until))
+		{
+			// Out of time, but the file is left open, so
+			// that the next call can carry on with it
+			SaveState();
+			return false;
+		}
+
+		box_time_t now = GetCurrentBoxTime();
+		if(now - mLastProgressReport >=
+			SecondsToBoxTime(SCRUB_PROGRESS_INTERVAL))
+		{
+			mLastProgressReport = now;
+			BOX_INFO("RAID scrub of disc set " << mSetNumber <<
+				" has checked " << mNumFilesChecked <<
+				" files (" << (mNumBytesChecked / 1024) <<
+				" kB) so far, up to " << mPosition);
+		}
+
+		if(now >= Until)
+		{
+			SaveState();
+			return false;
+		}
+	}
+
+	// Finished this pass
+	mInPass = false;
+	mReachedEnd = false;
+	mPosition.clear();
+	mLastPassFinished = GetCurrentBoxTime();
+	SaveState();
+
+	std::ostringstream summary;
+	summary << "Finished RAID scrub of disc set " << mSetNumber <<
+		": checked " << mNumFilesChecked << " files (" <<
+		(mNumBytesChecked / 1024) << " kB), " << mNumFilesDamaged <<
+		" damaged, " << mNumFilesRepaired << " repaired, " <<
+		mNumFilesInconsistent << " inconsistent, " <<
+		mNumFilesUnrecoverable << " unrecoverable";
+	if(mNumFilesUnrecoverable > 0 || mNumFilesInconsistent > 0)
+	{
+		BOX_ERROR(summary.str());
+	}
+	else if(mNumFilesDamaged > 0)
+	{
+		BOX_WARNING(summary.str());
+	}
+	else
+	{
+		BOX_NOTICE(summary.str());
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileScrubber::FindMoreFiles()
+//		Purpose: Walks the directories of the disc set to find the
+//				 next files after the current position. Returns
+//				 false if there are none left in this pass.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool RaidFileScrubber::FindMoreFiles()
+{
+	if(mReachedEnd)
+	{
+		return false;
+	}
+
+	std::vector<std::string> positionPath(SplitRaidFilePath(mPosition));
+	mReachedEnd = FindFiles("", positionPath);
+	return !mPendingFiles.empty();
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileScrubber::FindFiles(const std::string &,
+//			 const std::vector<std::string> &)
+//		Purpose: Adds the files in and below a directory which come
+//				 after the given position to the pending list, in
+//				 order. Returns false if it stopped because enough
+//				 files have been found.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool RaidFileScrubber::FindFiles(const std::string &rDirName,
+	const std::vector<std::string> &rPositionPath)
+{
+	std::vector<std::string> files, dirs;
+	RaidFileRead::ReadDirectoryContents(mSetNumber, rDirName,
+		RaidFileRead::DirReadType_FilesOnly, files);
+	RaidFileRead::ReadDirectoryContents(mSetNumber, rDirName,
+		RaidFileRead::DirReadType_DirsOnly, dirs);
+
+	std::string prefix(rDirName);
+	if(!prefix.empty())
+	{
+		prefix += DIRECTORY_SEPARATOR_ASCHAR;
+	}
+
+	// Both lists are sorted. Merge them, so that everything is visited
+	// in order, with a file before the directory of the same name.
+	std::vector<std::string>::const_iterator f = files.begin(),
+		d = dirs.begin();
+	while(f != files.end() || d != dirs.end())
+	{
+		bool isFile = (d == dirs.end() ||
+			(f != files.end() && *f <= *d));
+		std::string name(prefix + (isFile ? *(f++) : *(d++)));
+		std::vector<std::string> path(SplitRaidFilePath(name));
+
+		if(isFile)
+		{
+			if(path > rPositionPath)
+			{
+				mPendingFiles.push_back(name);
+				if(mPendingFiles.size() >= SCRUB_FILES_PER_SEARCH)
+				{
+					return false;
+				}
+			}
+		}
+		else if(path.back()[0] != '.')
+		{
+			// Skip directories which are entirely before the
+			// position, and the raidfile-unreadable directory
+			bool positionInside = rPositionPath.size() > path.size()
+				&& std::equal(path.begin(), path.end(),
+					rPositionPath.begin());
+			if((positionInside || path > rPositionPath) &&
+				!FindFiles(name, rPositionPath))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileScrubber::StartFile(const std::string &)
+//		Purpose: Opens the components of a file, and checks that
+//				 their sizes make sense, ready for CheckSome().
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidFileScrubber::StartFile(const std::string &rFilename)
+{
+	mFilename = rFilename;
+
+	RaidFileController &rcontroller(RaidFileController::GetController());
+	RaidFileDiscSet rdiscSet(rcontroller.GetDiscSet(mSetNumber));
+
+	int startDisc = 0;
+	RaidFileUtil::ExistType existance = RaidFileUtil::RaidFileExists(
+		rdiscSet, mFilename, &startDisc, 0, &mRevisionID);
+	switch(existance)
+	{
+	case RaidFileUtil::NoFile:
+	case RaidFileUtil::NonRaid:
+		// Deleted since the directory was read, or not transformed
+		// to RAID storage yet, so there's no parity to check
+		mPosition = mFilename;
+		mFilename.clear();
+		return;
+
+	case RaidFileUtil::AsRaidWithMissingReadable:
+		FinishFile(true, "a stripe or parity file is missing");
+		return;
+
+	case RaidFileUtil::AsRaidWithMissingNotRecoverable:
+		FinishFile(true, "too many stripe and parity files are "
+			"missing", Damage_Unrecoverable);
+		return;
+
+	case RaidFileUtil::AsRaid:
+		break;
+	}
+
+	int64_t sizes[SCRUB_NUMBER_DISCS_REQUIRED];
+	for(int h = 0; h < SCRUB_NUMBER_DISCS_REQUIRED; h++)
+	{
+		std::string componentName(RaidFileUtil::MakeRaidComponentName(
+			rdiscSet, mFilename,
+			(h + startDisc) % SCRUB_NUMBER_DISCS_REQUIRED));
+		mHandles[h] = ::open(componentName.c_str(), O_RDONLY | O_BINARY);
+
+		struct stat st;
+		if(mHandles[h] == -1 || ::fstat(mHandles[h], &st) != 0)
+		{
+			std::ostringstream reason;
+			reason << "failed to open " << componentName << ": " <<
+				std::strerror(errno);
+			FinishFile(true, reason.str());
+			return;
+		}
+		sizes[h] = st.st_size;
+	}
+
+	// The stripes must hold alternate blocks of the file, otherwise
+	// there's no telling which of them is wrong
+	mFileSize = sizes[0] + sizes[1];
+	int64_t pairSize = mBlockSize * 2;
+	mWholePairs = mFileSize / pairSize;
+	int64_t bytesInLastPair = mFileSize - (mWholePairs * pairSize);
+	int64_t stripe1Size = (mWholePairs * mBlockSize) +
+		((bytesInLastPair < mBlockSize) ? bytesInLastPair : mBlockSize);
+	if(sizes[0] != stripe1Size)
+	{
+		std::ostringstream reason;
+		reason << "stripe sizes " << sizes[0] << " and " << sizes[1] <<
+			" are inconsistent";
+		FinishFile(true, reason.str(), Damage_Unrecoverable);
+		return;
+	}
+
+	// The parity file holds a block for each pair, so it must be at
+	// least that long, and the tail is checked by CheckTail()
+	if(sizes[2] < (mWholePairs * mBlockSize))
+	{
+		FinishFile(true, "parity file is too short",
+			Damage_Inconsistent);
+		return;
+	}
+
+	mPairsChecked = 0;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileScrubber::CheckSome(box_time_t)
+//		Purpose: Compares blocks of the current file with its parity
+//				 until it's finished or the time is up. Returns
+//				 false if the time is up first.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool RaidFileScrubber::CheckSome(box_time_t Until)
+{
+	int chunkSize = mBlockSize * SCRUB_PAIRS_PER_READ;
+	char *pStripe1 = mpBuffer;
+	char *pStripe2 = pStripe1 + chunkSize;
+	char *pParity = pStripe2 + chunkSize;
+	char *pExpected = pParity + chunkSize + sizeof(RaidFileRead::FileSizeType);
+
+	while(mPairsChecked < mWholePairs)
+	{
+		int pairs = SCRUB_PAIRS_PER_READ;
+		if(pairs > mWholePairs - mPairsChecked)
+		{
+			pairs = mWholePairs - mPairsChecked;
+		}
+		int bytes = pairs * mBlockSize;
+
+		if(!Throttle(bytes * SCRUB_NUMBER_DISCS_REQUIRED, Until))
+		{
+			return false;
+		}
+
+		if(!ReadComponent(0, pStripe1, bytes) ||
+			!ReadComponent(1, pStripe2, bytes) ||
+			!ReadComponent(2, pParity, bytes))
+		{
+			return true;
+		}
+
+		RaidFileUtil::XorBlocks(pExpected, pStripe1, pStripe2, bytes);
+		mNumBytesChecked += bytes * SCRUB_NUMBER_DISCS_REQUIRED;
+		if(std::memcmp(pExpected, pParity, bytes) != 0)
+		{
+			std::ostringstream reason;
+			reason << "parity does not match stripes in blocks " <<
+				(mPairsChecked * 2) << " to " <<
+				((mPairsChecked + pairs) * 2 - 1);
+			FinishFile(true, reason.str(), Damage_Inconsistent);
+			return true;
+		}
+
+		mPairsChecked += pairs;
+	}
+
+	CheckTail();
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileScrubber::CheckTail()
+//		Purpose: Checks the end of the parity file, made from the
+//				 last partial pair of blocks and the file size,
+//				 and finishes the current file.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidFileScrubber::CheckTail()
+{
+	int chunkSize = mBlockSize * SCRUB_PAIRS_PER_READ;
+	char *pLastPair = mpBuffer;
+	char *pParity = pLastPair + (chunkSize * 2);
+	char *pExpected = pParity + chunkSize + sizeof(RaidFileRead::FileSizeType);
+
+	int bytesInLastPair = mFileSize - (mWholePairs * mBlockSize * 2);
+	int stripe1Bytes = (bytesInLastPair < (int)mBlockSize)
+		? bytesInLastPair : mBlockSize;
+	if(!ReadComponent(0, pLastPair, stripe1Bytes) ||
+		!ReadComponent(1, pLastPair + mBlockSize,
+			bytesInLastPair - stripe1Bytes))
+	{
+		return;
+	}
+
+	int paritySize = RaidFileUtil::MakeParityTail(pExpected, pLastPair,
+		bytesInLastPair, mBlockSize, mFileSize);
+	mThrottleBytes += bytesInLastPair + paritySize;
+	mNumBytesChecked += bytesInLastPair + paritySize;
+
+	// Read one more byte than expected, to check it's the end
+	int bytesRead = ::read(mHandles[2], pParity, paritySize + 1);
+	if(bytesRead != paritySize ||
+		std::memcmp(pExpected, pParity, paritySize) != 0)
+	{
+		FinishFile(true, "end of parity file is wrong",
+			Damage_Inconsistent);
+		return;
+	}
+
+	FinishFile();
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileScrubber::ReadComponent(int, void *, int)
+//		Purpose: Reads from a stripe or parity file of the current
+//				 file. If it can't, the file is finished as damaged,
+//				 and false is returned. A read error can be repaired
+//				 from the other two files, but one which is shorter
+//				 than expected can't.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool RaidFileScrubber::ReadComponent(int Component, void *pBuffer, int NBytes)
+{
+	char *pOut = (char *)pBuffer;
+	while(NBytes > 0)
+	{
+		int bytesRead = ::read(mHandles[Component], pOut, NBytes);
+		if(bytesRead <= 0)
+		{
+			std::ostringstream reason;
+			reason << "failed to read " <<
+				((Component == 2) ? "parity file" :
+				((Component == 0) ? "stripe 1" : "stripe 2")) <<
+				": " << ((bytesRead == 0) ? "unexpected end of file"
+				: std::strerror(errno));
+			FinishFile(true, reason.str(), (bytesRead == 0) ?
+				Damage_Inconsistent : Damage_Rebuildable);
+			return false;
+		}
+		pOut += bytesRead;
+		NBytes -= bytesRead;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileScrubber::FinishFile(bool, const std::string &,
+//			 DamageType)
+//		Purpose: Closes the current file, and moves the position on
+//				 past it, first repairing it if it's damaged in a
+//				 way that can be repaired.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidFileScrubber::FinishFile(bool Damaged, const std::string &rReason,
+	DamageType Type)
+{
+	CloseFile();
+	mNumFilesChecked++;
+
+	if(Damaged)
+	{
+		// Was it just replaced while it was being checked?
+		RaidFileController &rcontroller(
+			RaidFileController::GetController());
+		RaidFileDiscSet rdiscSet(rcontroller.GetDiscSet(mSetNumber));
+		int64_t revisionID = 0;
+		if(RaidFileUtil::RaidFileExists(rdiscSet, mFilename, 0, 0,
+			&revisionID) == RaidFileUtil::NoFile ||
+			revisionID != mRevisionID)
+		{
+			BOX_INFO("RAID file " << mSetNumber << " " <<
+				mFilename << " changed while being scrubbed, "
+				"will check it in the next pass");
+			Damaged = false;
+		}
+	}
+
+	if(Damaged)
+	{
+		mNumFilesDamaged++;
+		if(Type == Damage_Unrecoverable)
+		{
+			mNumFilesUnrecoverable++;
+			BOX_ERROR("RAID file " << mSetNumber << " " <<
+				mFilename << " is damaged and can't be "
+				"repaired: " << rReason);
+		}
+		else if(Type == Damage_Inconsistent)
+		{
+			mNumFilesInconsistent++;
+			BOX_ERROR("RAID file " << mSetNumber << " " <<
+				mFilename << " is inconsistent, and can't be "
+				"repaired automatically because either its "
+				"stripes or its parity could be wrong: " <<
+				rReason);
+		}
+		else
+		{
+			BOX_WARNING("RAID file " << mSetNumber << " " <<
+				mFilename << " is damaged: " << rReason);
+			if(mRepair)
+			{
+				RepairFile();
+			}
+		}
+	}
+
+	mPosition = mFilename;
+	mFilename.clear();
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileScrubber::RepairFile()
+//		Purpose: Rewrites the current file, which has a missing or
+//				 unreadable stripe or parity file, from the other
+//				 two. RaidFileRead rebuilds a stripe from the parity
+//				 if it needs to. The file is locked first, if the
+//				 scrubber has a locker, and skipped if it's in use.
+//				 The copy is limited to the maximum rate.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidFileScrubber::RepairFile()
+{
+	if(mpLocker != 0 && !mpLocker->LockForRepair(mSetNumber, mFilename))
+	{
+		BOX_WARNING("RAID file " << mSetNumber << " " << mFilename <<
+			" is in use, will try to repair it in the next pass");
+		return;
+	}
+
+	try
+	{
+		std::auto_ptr<RaidFileRead> apRead(RaidFileRead::Open(
+			mSetNumber, mFilename));
+		RaidFileWrite write(mSetNumber, mFilename);
+		write.Open(true /* allow overwrite */,
+			true /* stream to RAID */);
+
+		// Reading each chunk and writing it back with its parity
+		// touches about twice its size on disc
+		int chunkSize = mBlockSize * SCRUB_PAIRS_PER_READ * 2;
+		while(apRead->StreamDataLeft())
+		{
+			int bytes = apRead->Read(mpBuffer, chunkSize);
+			Throttle(bytes * 2, SCRUB_NO_DEADLINE);
+			write.Write(mpBuffer, bytes);
+		}
+		apRead.reset();
+		write.Commit(true /* convert to raid now */);
+
+		mNumFilesRepaired++;
+		BOX_NOTICE("Repaired RAID file " << mSetNumber << " " <<
+			mFilename);
+	}
+	catch(BoxException &e)
+	{
+		if(mpLocker != 0)
+		{
+			mpLocker->UnlockAfterRepair();
+		}
+
+		if(e.GetType() == RaidFileException::ExceptionType &&
+			e.GetSubType() ==
+			RaidFileException::FileIsCurrentlyOpenForWriting)
+		{
+			// Being replaced anyway
+			BOX_INFO("RAID file " << mSetNumber << " " <<
+				mFilename << " is being written, not "
+				"repairing it");
+			return;
+		}
+
+		mNumFilesUnrecoverable++;
+		BOX_ERROR("Failed to repair RAID file " << mSetNumber <<
+			" " << mFilename << ": " << e.what());
+		return;
+	}
+
+	if(mpLocker != 0)
+	{
+		mpLocker->UnlockAfterRepair();
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileScrubber::CloseFile()
+//		Purpose: Closes the components of the current file
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidFileScrubber::CloseFile()
+{
+	for(int h = 0; h < SCRUB_NUMBER_DISCS_REQUIRED; h++)
+	{
+		if(mHandles[h] != -1)
+		{
+			::close(mHandles[h]);
+			mHandles[h] = -1;
+		}
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileScrubber::Throttle(int, box_time_t)
+//		Purpose: Waits until NBytes more can be read without going
+//				 over the maximum rate. Returns false, after waiting
+//				 until the given time, if that's not long enough.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool RaidFileScrubber::Throttle(int NBytes, box_time_t Until)
+{
+	if(mMaxBytesPerSecond <= 0)
+	{
+		return true;
+	}
+
+	box_time_t now = GetCurrentBoxTime();
+	box_time_t due = mThrottleStart + (mThrottleBytes *
+		MICRO_SEC_IN_SEC_LL) / mMaxBytesPerSecond;
+
+	// Don't make up for time spent doing something else
+	if(now > due + MICRO_SEC_IN_SEC_LL)
+	{
+		mThrottleStart = now;
+		mThrottleBytes = 0;
+		due = now;
+	}
+
+	if(due > now)
+	{
+		ShortSleep(((due < Until) ? due : Until) - now, false);
+		if(due > Until)
+		{
+			return false;
+		}
+	}
+
+	mThrottleBytes += NBytes;
+	return true;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileScrubber::LoadState()
+//		Purpose: Reads the position and the time the last pass
+//				 finished from the state file, if there is one.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidFileScrubber::LoadState()
+{
+	if(!FileExists(mStateFilename))
+	{
+		return;
+	}
+
+	try
+	{
+		FileStream file(mStateFilename);
+		IOStreamGetLine getLine(file);
+		std::string line;
+		if(getLine.GetLine(line))
+		{
+			mLastPassFinished = SecondsToBoxTime(
+				(time_t)::strtoll(line.c_str(), NULL, 10));
+		}
+		if(getLine.GetLine(line))
+		{
+			mPosition = line;
+		}
+	}
+	catch(BoxException &e)
+	{
+		BOX_WARNING("Failed to read RAID scrub state from " <<
+			mStateFilename << ", starting again: " << e.what());
+		mLastPassFinished = 0;
+		mPosition.clear();
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileScrubber::SaveState()
+//		Purpose: Writes the position and the time the last pass
+//				 finished to the state file.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidFileScrubber::SaveState()
+{
+	std::ostringstream state;
+	state << BoxTimeToSeconds(mLastPassFinished) << "\n" <<
+		mPosition << "\n";
+
+	// Replace the file in one go, so that it's never half written
+	std::string tempFilename(mStateFilename + 'X');
+	try
+	{
+		FileStream file(tempFilename, O_WRONLY | O_CREAT | O_TRUNC);
+		file.Write(state.str().c_str(), state.str().size());
+		file.Close();
+	}
+	catch(BoxException &e)
+	{
+		BOX_ERROR("Failed to save RAID scrub state to " <<
+			tempFilename << ": " << e.what());
+		return;
+	}
+
+	if(::rename(tempFilename.c_str(), mStateFilename.c_str()) != 0)
+	{
+		BOX_LOG_SYS_ERROR("Failed to rename " << tempFilename <<
+			" to " << mStateFilename);
+	}
+}
@@ -0,0 +1,158 @@
+// --------------------------------------------------------------------------
+//
+// File
+//		Name:    RaidFileScrubber.h
+//		Purpose: Background checking and repair of RAID files
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+#ifndef RAIDFILESCRUBBER__H
+#define RAIDFILESCRUBBER__H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "BoxTime.h"
+
+// Name of the file in the first directory of a disc set which records
+// how far the scrubber has got
+#define RAIDFILE_SCRUB_STATE_FILE	".raidfile-scrub"
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    RaidFileRepairLocker
+//		Purpose: Implemented by whatever owns the files in a disc set,
+//				 to stop them being used while the scrubber repairs
+//				 them.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class RaidFileRepairLocker
+{
+public:
+	virtual ~RaidFileRepairLocker() {}
+	// Returns false if the file is in use, so it can't be repaired now.
+	// Otherwise nothing else may write it until UnlockAfterRepair().
+	virtual bool LockForRepair(int SetNumber,
+		const std::string &rFilename) = 0;
+	virtual void UnlockAfterRepair() = 0;
+};
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    RaidFileScrubber
+//		Purpose: Walks all the files in a disc set, checking that the
+//				 stripes and parity of each one are consistent.
+//				 Files with a missing or unreadable stripe or parity
+//				 file are rebuilt from the other two. Stripes which
+//				 don't match their parity are only reported, because
+//				 there's no telling which of them is wrong. Reading
+//				 is limited to a maximum rate, and the work is done
+//				 in slices, so it can run continuously alongside
+//				 client connections. The position is saved in the
+//				 disc set, so that a pass resumes where it left off
+//				 after a restart.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class RaidFileScrubber
+{
+public:
+	RaidFileScrubber(int SetNumber, int64_t MaxBytesPerSecond,
+		bool Repair = true, RaidFileRepairLocker *pLocker = 0);
+	~RaidFileScrubber();
+private:
+	RaidFileScrubber(const RaidFileScrubber &rToCopy);
+
+public:
+	bool Scrub(box_time_t Until);
+
+	int GetSetNumber() const {return mSetNumber;}
+	const std::string &GetPosition() const {return mPosition;}
+	box_time_t GetLastPassFinished() const {return mLastPassFinished;}
+	int64_t GetNumFilesChecked() const {return mNumFilesChecked;}
+	int64_t GetNumBytesChecked() const {return mNumBytesChecked;}
+	int64_t GetNumFilesDamaged() const {return mNumFilesDamaged;}
+	int64_t GetNumFilesRepaired() const {return mNumFilesRepaired;}
+	int64_t GetNumFilesInconsistent() const
+	{
+		return mNumFilesInconsistent;
+	}
+	int64_t GetNumFilesUnrecoverable() const
+	{
+		return mNumFilesUnrecoverable;
+	}
+
+private:
+	// What can be done about a damaged file
+	typedef enum
+	{
+		// A stripe or parity file is missing or unreadable, and can
+		// be rebuilt from the other two
+		Damage_Rebuildable = 0,
+		// The stripes don't match the parity, and there's no telling
+		// which is wrong, so rewriting either could lose the only
+		// good copy
+		Damage_Inconsistent,
+		// Not enough is left to rebuild it from
+		Damage_Unrecoverable
+	} DamageType;
+
+	bool FindMoreFiles();
+	bool FindFiles(const std::string &rDirName,
+		const std::vector<std::string> &rPositionPath);
+	void StartFile(const std::string &rFilename);
+	bool CheckSome(box_time_t Until);
+	void CheckTail();
+	void FinishFile(bool Damaged = false, const std::string &rReason = "",
+		DamageType Type = Damage_Rebuildable);
+	void RepairFile();
+	void CloseFile();
+	bool ReadComponent(int Component, void *pBuffer, int NBytes);
+	bool Throttle(int NBytes, box_time_t Until);
+	void LoadState();
+	void SaveState();
+
+	int mSetNumber;
+	int64_t mMaxBytesPerSecond;
+	bool mRepair;
+	RaidFileRepairLocker *mpLocker;
+	bool mNonRaidSet;
+	std::string mStateFilename;
+
+	// Files still to check in this pass, in order, after mPosition
+	std::deque<std::string> mPendingFiles;
+	std::string mPosition;
+	bool mInPass;
+	bool mReachedEnd;
+	box_time_t mLastPassFinished;
+
+	// The file being checked
+	std::string mFilename;
+	int64_t mRevisionID;
+	int mHandles[3];
+	unsigned int mBlockSize;
+	int64_t mFileSize;
+	int64_t mWholePairs;
+	int64_t mPairsChecked;
+	char *mpBuffer;
+
+	// Rate limiting
+	box_time_t mThrottleStart;
+	int64_t mThrottleBytes;
+
+	// Statistics for this pass
+	int64_t mNumFilesChecked;
+	int64_t mNumBytesChecked;
+	int64_t mNumFilesDamaged;
+	int64_t mNumFilesRepaired;
+	int64_t mNumFilesInconsistent;
+	int64_t mNumFilesUnrecoverable;
+	box_time_t mLastProgressReport;
+};
+
+#endif // RAIDFILESCRUBBER__H
@@ -0,0 +1,367 @@
+// --------------------------------------------------------------------------
+//
+// File
+//		Name:    RaidFileSyncGroup.cpp
+//		Purpose: Makes several committed RAID files durable at once
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+#include "Box.h"
+
+#include <errno.h>
+#include <fcntl.h>
+
+#include <algorithm>
+
+#ifdef HAVE_UNISTD_H
+#	include <unistd.h>
+#endif
+
+#include "RaidFileSyncGroup.h"
+#include "RaidFileException.h"
+#include "RaidFileUtil.h"
+#include "FileModificationTime.h"
+
+#include "MemLeakFindOn.h"
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileSyncGroup::RaidFileSyncGroup()
+//		Purpose: Constructor
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+RaidFileSyncGroup::RaidFileSyncGroup()
+	: mNumSyncs(0)
+{
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileSyncGroup::~RaidFileSyncGroup()
+//		Purpose: Destructor. Files which are still pending are synced
+//				 and put in place, as their commits can't be undone.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+RaidFileSyncGroup::~RaidFileSyncGroup()
+{
+	if(mPending.empty())
+	{
+		return;
+	}
+
+	// We must not throw exceptions from the destructor
+	try
+	{
+		Sync();
+	}
+	catch(BoxException &e)
+	{
+		BOX_ERROR("Failed to sync " << mPending.size() << " committed "
+			"RaidFiles in destructor: " << e.what());
+	}
+	catch(...)
+	{
+		BOX_ERROR("Failed to sync " << mPending.size() << " committed "
+			"RaidFiles in destructor: unknown exception");
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileSyncGroup::Add(int, const std::string &,
+//			 const std::string *, const std::string *, int,
+//			 const std::string &)
+//		Purpose: Takes over the committed files of a RaidFile,
+//				 moving them from their temporary names to pending
+//				 ones, until they're renamed to their final names by
+//				 Sync(). If rStaleName is given, that file is removed
+//				 once they're in place. Replaces any pending commit
+//				 of the same RaidFile.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidFileSyncGroup::Add(int SetNumber, const std::string &rFilename,
+	const std::string *pTempNames, const std::string *pFinalNames,
+	int NumFiles, const std::string &rStaleName)
+{
+	std::list<PendingCommit>::iterator earlier(mPending.begin());
+	while(earlier != mPending.end() && (earlier->mSetNumber != SetNumber ||
+		earlier->mFilename != rFilename))
+	{
+		earlier++;
+	}
+
+	PendingCommit commit;
+	commit.mSetNumber = SetNumber;
+	commit.mFilename = rFilename;
+	commit.mStaleName = rStaleName;
+
+	// The revision ID is worked out as RaidFileUtil::RaidFileExists()
+	// will once they're in place, which doesn't change it
+	int64_t latest = 0, size = 0;
+
+	for(int f = 0; f < NumFiles; f++)
+	{
+		std::string pendingName(GetPendingName(pFinalNames[f]));
+		EMU_STRUCT_STAT st;
+		if(::rename(pTempNames[f].c_str(), pendingName.c_str()) != 0 ||
+			EMU_STAT(pendingName.c_str(), &st) != 0)
+		{
+			int errnoSaved = errno;
+
+			// Those already moved may have replaced the files of
+			// the earlier commit, so neither can be used
+			for(int m = 0; m <= f; m++)
+			{
+				EMU_UNLINK(GetPendingName(pFinalNames[m]).c_str());
+			}
+			if(earlier != mPending.end())
+			{
+				BOX_ERROR("Earlier commit of RaidFile " <<
+					rFilename << " lost");
+				Remove(earlier, true);
+			}
+
+			THROW_SYS_FILE_ERRNO("Failed to move committed RaidFile "
+				"to pending name", pendingName, errnoSaved,
+				RaidFileException, OSError);
+		}
+
+		commit.mFinalNames.push_back(pFinalNames[f]);
+		int64_t modified = FileModificationTime(st);
+		if(modified > latest)
+		{
+			latest = modified;
+		}
+		size += st.st_size;
+	}
+	commit.mRevisionID = adjust_timestamp(latest, size);
+
+	if(earlier != mPending.end())
+	{
+		// Its files which weren't replaced are no longer needed
+		for(std::vector<std::string>::const_iterator
+			i(earlier->mFinalNames.begin());
+			i != earlier->mFinalNames.end(); i++)
+		{
+			if(std::find(commit.mFinalNames.begin(),
+				commit.mFinalNames.end(), *i) ==
+				commit.mFinalNames.end())
+			{
+				EMU_UNLINK(GetPendingName(*i).c_str());
+			}
+		}
+		Remove(earlier, false);
+	}
+
+	mPending.push_back(commit);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileSyncGroup::Remove(
+//			 std::list<PendingCommit>::iterator, bool)
+//		Purpose: Forgets a pending commit, deleting its files if
+//				 requested
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidFileSyncGroup::Remove(std::list<PendingCommit>::iterator i,
+	bool DeleteFiles)
+{
+	if(DeleteFiles)
+	{
+		for(std::vector<std::string>::const_iterator
+			f(i->mFinalNames.begin()); f != i->mFinalNames.end(); f++)
+		{
+			EMU_UNLINK(GetPendingName(*f).c_str());
+		}
+	}
+	mPending.erase(i);
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileSyncGroup::IsPending(int, const std::string &,
+//			 int64_t *)
+//		Purpose: Is a commit of the RaidFile waiting to be synced?
+//				 If so, returns the revision ID it will have if
+//				 requested.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool RaidFileSyncGroup::IsPending(int SetNumber, const std::string &rFilename,
+	int64_t *pRevisionID) const
+{
+	for(std::list<PendingCommit>::const_iterator i(mPending.begin());
+		i != mPending.end(); i++)
+	{
+		if(i->mSetNumber == SetNumber && i->mFilename == rFilename)
+		{
+			if(pRevisionID)
+			{
+				*pRevisionID = i->mRevisionID;
+			}
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileSyncGroup::Sync()
+//		Purpose: Flushes the data of all the pending files to disc,
+//				 starting to write out all of them before waiting
+//				 for any, so that the discs can write them at the
+//				 same time. Then renames them into place, in the
+//				 order that they were committed, and flushes each
+//				 directory they're in, so that the renames are
+//				 durable.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidFileSyncGroup::Sync()
+{
+	if(mPending.empty() && mDirectories.empty())
+	{
+		return;
+	}
+
+	int numCommits = mPending.size();
+
+#ifndef WIN32
+#ifdef HAVE_SYNC_FILE_RANGE
+	for(std::list<PendingCommit>::const_iterator i(mPending.begin());
+		i != mPending.end(); i++)
+	{
+		for(std::vector<std::string>::const_iterator
+			f(i->mFinalNames.begin()); f != i->mFinalNames.end(); f++)
+		{
+			// Start writing it out, without waiting. Any error is
+			// reported by the sync below.
+			int handle = ::open(GetPendingName(*f).c_str(), O_RDONLY);
+			if(handle != -1)
+			{
+				::sync_file_range(handle, 0, 0,
+					SYNC_FILE_RANGE_WRITE);
+				::close(handle);
+			}
+		}
+	}
+#endif // HAVE_SYNC_FILE_RANGE
+
+	for(std::list<PendingCommit>::const_iterator i(mPending.begin());
+		i != mPending.end(); i++)
+	{
+		for(std::vector<std::string>::const_iterator
+			f(i->mFinalNames.begin()); f != i->mFinalNames.end(); f++)
+		{
+			std::string pendingName(GetPendingName(*f));
+			int handle = ::open(pendingName.c_str(), O_RDONLY);
+			if(handle == -1)
+			{
+				THROW_SYS_FILE_ERROR("Failed to open RaidFile to "
+					"sync", pendingName, RaidFileException,
+					OSError);
+			}
+#ifdef HAVE_FDATASYNC
+			int result = ::fdatasync(handle);
+#else
+			int result = ::fsync(handle);
+#endif
+			int error = errno;
+			::close(handle);
+			if(result != 0)
+			{
+				THROW_SYS_FILE_ERRNO("Failed to sync RaidFile",
+					pendingName, error, RaidFileException,
+					OSError);
+			}
+		}
+	}
+#endif // !WIN32
+
+	while(!mPending.empty())
+	{
+		PendingCommit &rCommit(mPending.front());
+		for(std::vector<std::string>::const_iterator
+			f(rCommit.mFinalNames.begin());
+			f != rCommit.mFinalNames.end(); f++)
+		{
+			std::string pendingName(GetPendingName(*f));
+#ifdef WIN32
+			// Must delete before renaming
+			if(EMU_UNLINK(f->c_str()) != 0 && errno != ENOENT)
+			{
+				THROW_EMU_ERROR("Failed to unlink RaidFile: " <<
+					*f, RaidFileException, OSError);
+			}
+#endif
+			if(::rename(pendingName.c_str(), f->c_str()) != 0)
+			{
+				THROW_SYS_ERROR("Failed to rename file: " <<
+					pendingName << " to " << *f,
+					RaidFileException, OSError);
+			}
+
+			std::string::size_type slash =
+				f->rfind(DIRECTORY_SEPARATOR_ASCHAR);
+			mDirectories.insert((slash == std::string::npos) ?
+				std::string(".") : f->substr(0, slash));
+		}
+
+		// If an older version was committed without being
+		// transformed, it must not be read instead of this one
+		if(!rCommit.mStaleName.empty() &&
+			EMU_UNLINK(rCommit.mStaleName.c_str()) != 0 &&
+			errno != ENOENT)
+		{
+			THROW_SYS_FILE_ERROR("Failed to delete file",
+				rCommit.mStaleName, RaidFileException, OSError);
+		}
+
+		mPending.pop_front();
+	}
+
+#ifndef WIN32
+	for(std::set<std::string>::const_iterator
+		i(mDirectories.begin()); i != mDirectories.end(); i++)
+	{
+		int handle = ::open(i->c_str(), O_RDONLY);
+		if(handle == -1)
+		{
+			if(errno == ENOENT)
+			{
+				// Deleted since, nothing to sync
+				continue;
+			}
+			THROW_SYS_FILE_ERROR("Failed to open directory to sync",
+				*i, RaidFileException, OSError);
+		}
+		int result = ::fsync(handle);
+		int error = errno;
+		::close(handle);
+		if(result != 0)
+		{
+			THROW_SYS_FILE_ERRNO("Failed to sync directory", *i,
+				error, RaidFileException, OSError);
+		}
+	}
+#endif // !WIN32
+
+	BOX_TRACE("Synced " << numCommits << " committed RaidFiles in " <<
+		mDirectories.size() << " directories");
+	mDirectories.clear();
+	mNumSyncs++;
+}
@@ -0,0 +1,77 @@
+// --------------------------------------------------------------------------
+//
+// File
+//		Name:    RaidFileSyncGroup.h
+//		Purpose: Makes several committed RAID files durable at once
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+
+#ifndef RAIDFILESYNCGROUP__H
+#define RAIDFILESYNCGROUP__H
+
+#include <list>
+#include <set>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------------------------
+//
+// Class
+//		Name:    RaidFileSyncGroup
+//		Purpose: Holds the files committed by RaidFileWrite::Commit()
+//				 until Sync() makes them all durable together. Their
+//				 data is flushed to disc first, then they're renamed
+//				 into place, and then each directory they're in is
+//				 flushed once, so that a crash can't leave a
+//				 committed name with missing data. Until then, a
+//				 committed file isn't visible to RaidFileRead, and a
+//				 crash undoes its commit. Committing the same file
+//				 again replaces the pending commit.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+class RaidFileSyncGroup
+{
+public:
+	RaidFileSyncGroup();
+	~RaidFileSyncGroup();
+private:
+	RaidFileSyncGroup(const RaidFileSyncGroup &rToCopy);
+
+public:
+	void Add(int SetNumber, const std::string &rFilename,
+		const std::string *pTempNames, const std::string *pFinalNames,
+		int NumFiles, const std::string &rStaleName = std::string());
+	bool IsPending(int SetNumber, const std::string &rFilename,
+		int64_t *pRevisionID = 0) const;
+	void Sync();
+	int GetNumPending() const {return mPending.size();}
+	int64_t GetNumSyncs() const {return mNumSyncs;}
+
+private:
+	// The files of one committed RaidFile, under their pending names
+	typedef struct
+	{
+		int mSetNumber;
+		std::string mFilename;
+		std::vector<std::string> mFinalNames;
+		// Removed once the files are in place, if not empty
+		std::string mStaleName;
+		int64_t mRevisionID;
+	} PendingCommit;
+
+	static std::string GetPendingName(const std::string &rFinalName)
+	{
+		return rFinalName + 'S';
+	}
+	void Remove(std::list<PendingCommit>::iterator i, bool DeleteFiles);
+
+	// In the order that they were committed
+	std::list<PendingCommit> mPending;
+	// Which contain files renamed since the last sync completed
+	std::set<std::string> mDirectories;
+	int64_t mNumSyncs;
+};
+
+#endif // RAIDFILESYNCGROUP__H
@@ -17,6 +17,10 @@
 #define RAIDFILE_EXTENSION			".rf"
 #define RAIDFILE_WRITE_EXTENSION	".rfw"
 
+// Makes a revision ID from the latest modification time of a file's parts,
+// and their total size
+int64_t adjust_timestamp(int64_t timestamp, size_t file_size);
+
 // --------------------------------------------------------------------------
 //
 // Class
@@ -47,6 +51,10 @@ public:
 	static ExistType RaidFileExists(RaidFileDiscSet &rDiscSet, const std::string &rFilename, int *pStartDisc = 0, int *pExisitingFiles = 0, int64_t *pRevisionID = 0);
 	
 	static int64_t DiscUsageInBlocks(int64_t FileSize, const RaidFileDiscSet &rDiscSet);
+	static void XorBlocks(void *pParity, const void *pStripe1,
+		const void *pStripe2, unsigned int NBytes);
+	static int MakeParityTail(void *pParity, void *pLastPair,
+		int BytesInLastPair, unsigned int BlockSize, int64_t FileSize);
 	
 	// --------------------------------------------------------------------------
 	//
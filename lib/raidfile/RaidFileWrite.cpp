@@ -23,6 +23,10 @@
 #	include <sys/file.h>
 #endif
 
+#ifdef HAVE_SYS_UIO_H
+#	include <sys/uio.h>
+#endif
+
 #include <stdio.h>
 #include <string.h>
 
@@ -34,6 +38,7 @@
 #include "Utils.h"
 // For DirectoryExists fn
 #include "RaidFileRead.h"
+#include "RaidFileSyncGroup.h"
 
 #include "MemLeakFindOn.h"
 
@@ -41,6 +46,8 @@
 #define TRANSFORM_BLOCKS_TO_LOAD		4
 // Must have this number of discs in the set
 #define TRANSFORM_NUMBER_DISCS_REQUIRED	3
+// Pairs of blocks to buffer when writing straight to RAID storage
+#define STREAM_BLOCK_PAIRS_TO_BUFFER	32
 
 // We want to use POSIX fstat() for now, not the emulated one, because it's
 // difficult to rewrite all this code to use HANDLEs instead of ints.
@@ -57,7 +64,17 @@ RaidFileWrite::RaidFileWrite(int SetNumber, const std::string &Filename)
 	: mSetNumber(SetNumber),
 	  mFilename(Filename),
 	  mOSFileHandle(-1), // not valid file handle
-	  mRefCount(-1) // unknown refcount
+	  mRefCount(-1), // unknown refcount
+	  mpSyncGroup(0),
+	  mStreamToRaid(false),
+	  mStripe1Handle(-1),
+	  mStripe2Handle(-1),
+	  mParityHandle(-1),
+	  mBlockSize(0),
+	  mpStreamBuffer(0),
+	  mpParityBuffer(0),
+	  mStreamBufferUsed(0),
+	  mStreamedSize(0)
 {
 }
 
@@ -76,7 +93,17 @@ RaidFileWrite::RaidFileWrite(int SetNumber, const std::string &Filename,
 	: mSetNumber(SetNumber),
 	  mFilename(Filename),
 	  mOSFileHandle(-1),		// not valid file handle
-	  mRefCount(refcount)
+	  mRefCount(refcount),
+	  mpSyncGroup(0),
+	  mStreamToRaid(false),
+	  mStripe1Handle(-1),
+	  mStripe2Handle(-1),
+	  mParityHandle(-1),
+	  mBlockSize(0),
+	  mpStreamBuffer(0),
+	  mpParityBuffer(0),
+	  mStreamBufferUsed(0),
+	  mStreamedSize(0)
 {
 	// Can't check for zero refcount here, because it's legal
 	// to create a RaidFileWrite to delete an object with zero refcount.
@@ -125,18 +152,33 @@ RaidFileWrite::~RaidFileWrite()
 				"in destructor: unknown exception");
 		}
 	}
+
+	if(mpStreamBuffer != 0)
+	{
+		::free(mpStreamBuffer);
+	}
+	if(mpParityBuffer != 0)
+	{
+		::free(mpParityBuffer);
+	}
 }
 
 
 // --------------------------------------------------------------------------
 //
 // Function
-//		Name:    RaidFileWrite::Open()
-//		Purpose: Opens the file for writing
+//		Name:    RaidFileWrite::Open(bool, bool)
+//		Purpose: Opens the file for writing. If StreamToRaid is set,
+//				 and the disc set is a RAID set, the data is split
+//				 into stripes and parity as it is written, instead
+//				 of being written to a write file and transformed
+//				 afterwards, so Commit() just has to rename the
+//				 files into place, and the file is always committed
+//				 in RAID form. The file can't be seeked in.
 //		Created: 2003/07/10
 //
 // --------------------------------------------------------------------------
-void RaidFileWrite::Open(bool AllowOverwrite)
+void RaidFileWrite::Open(bool AllowOverwrite, bool StreamToRaid)
 {
 	if(mOSFileHandle != -1)
 	{
@@ -176,6 +218,54 @@ void RaidFileWrite::Open(bool AllowOverwrite)
 	}
 	
 	// Get a lock on the write file
+	LockWriteFile();
+
+	// Truncate it to size zero
+	if(::ftruncate(mOSFileHandle, 0) != 0)
+	{
+		int errnoSaved = errno;
+
+		// Close the file
+		::close(mOSFileHandle);
+		mOSFileHandle = -1;
+
+		THROW_SYS_FILE_ERRNO("Failed to truncate RaidFile",
+			mTempFilename, errnoSaved, RaidFileException,
+			ErrorOpeningWriteFileOnTruncate);
+	}
+
+	// The write file is still needed for the lock when streaming, but
+	// nothing is written to it
+	mStreamToRaid = false;
+	mStreamedSize = 0;
+	if(StreamToRaid && !rdiscSet.IsNonRaidSet())
+	{
+		try
+		{
+			OpenStripes(rdiscSet);
+		}
+		catch(...)
+		{
+			Discard();
+			throw;
+		}
+	}
+	
+	// Done!
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileWrite::LockWriteFile()
+//		Purpose: Locks the newly opened write file, so that no-one
+//				 else can write the same RaidFile, or closes it and
+//				 throws an exception if it's already locked.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidFileWrite::LockWriteFile()
+{
 #ifdef HAVE_FLOCK
 	int errnoBlock = EWOULDBLOCK;
 	if(::flock(mOSFileHandle, LOCK_EX | LOCK_NB) != 0)
@@ -217,22 +307,179 @@ void RaidFileWrite::Open(bool AllowOverwrite)
 				OSError);
 		}
 	}
-	
-	// Truncate it to size zero
-	if(::ftruncate(mOSFileHandle, 0) != 0)
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileWrite::OpenFromFile(const std::string &, bool)
+//		Purpose: Opens the file for writing, as Open() does, but
+//				 starting with the contents of an existing plain file,
+//				 which is moved into place instead of being copied.
+//				 Further data is appended to it. Returns false,
+//				 leaving the file where it was, if it's on another
+//				 filesystem, or can't be moved for any other reason,
+//				 so the caller should copy it instead.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool RaidFileWrite::OpenFromFile(const std::string &rOSFilename,
+	bool AllowOverwrite)
+{
+	if(mOSFileHandle != -1)
 	{
-		int errnoSaved = errno;
+		THROW_EXCEPTION(RaidFileException, AlreadyOpen)
+	}
 
-		// Close the file
-		::close(mOSFileHandle);
-		mOSFileHandle = -1;
+#ifdef WIN32
+	// Can't rename files which are open, which it might be
+	return false;
+#else
+	RaidFileController &rcontroller(RaidFileController::GetController());
+	RaidFileDiscSet rdiscSet(rcontroller.GetDiscSet(mSetNumber));
 
-		THROW_SYS_FILE_ERRNO("Failed to truncate RaidFile",
-			mTempFilename, errnoSaved, RaidFileException,
-			ErrorOpeningWriteFileOnTruncate);
+	if(!AllowOverwrite && RaidFileUtil::RaidFileExists(rdiscSet,
+		mFilename) != RaidFileUtil::NoFile)
+	{
+		THROW_FILE_ERROR("Attempted to overwrite raidfile " <<
+			mSetNumber, mFilename, RaidFileException,
+			CannotOverwriteExistingFile);
+	}
+
+	mTempFilename = RaidFileUtil::MakeWriteFileName(rdiscSet, mFilename);
+	mTempFilename += 'X';
+
+	if(::rename(rOSFilename.c_str(), mTempFilename.c_str()) != 0)
+	{
+		BOX_TRACE(BOX_SYS_ERROR_MESSAGE("Can't move " << rOSFilename <<
+			" to " << mTempFilename << ", it will be copied"));
+		return false;
+	}
+
+	try
+	{
+		mOSFileHandle = ::open(mTempFilename.c_str(),
+			O_WRONLY | O_BINARY);
+		if(mOSFileHandle == -1)
+		{
+			THROW_SYS_FILE_ERROR("Failed to open RaidFile",
+				mTempFilename, RaidFileException,
+				ErrorOpeningWriteFile);
+		}
+
+		LockWriteFile();
+
+		if(::lseek(mOSFileHandle, 0, SEEK_END) == -1)
+		{
+			int errnoSaved = errno;
+			::close(mOSFileHandle);
+			mOSFileHandle = -1;
+			THROW_SYS_FILE_ERRNO("Failed to seek in RaidFile",
+				mTempFilename, errnoSaved, RaidFileException,
+				OSError);
+		}
+	}
+	catch(...)
+	{
+		// Put it back, so that the data isn't lost
+		::rename(mTempFilename.c_str(), rOSFilename.c_str());
+		throw;
+	}
+
+	mStreamToRaid = false;
+	mStreamedSize = 0;
+	return true;
+#endif // WIN32
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileWrite::OpenStripes(RaidFileDiscSet &)
+//		Purpose: Opens the stripe and parity files, under temporary
+//				 names, for writing the data straight to RAID
+//				 storage. They can be truncated safely, as the
+//				 write file is locked.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidFileWrite::OpenStripes(RaidFileDiscSet &rDiscSet)
+{
+	if(TRANSFORM_NUMBER_DISCS_REQUIRED != rDiscSet.size())
+	{
+		THROW_EXCEPTION(RaidFileException, WrongNumberOfDiscsInSet)
+	}
+
+	mBlockSize = rDiscSet.GetBlockSize();
+	if(mpStreamBuffer == 0)
+	{
+		mpStreamBuffer = (char *)::malloc(mBlockSize * 2 *
+			STREAM_BLOCK_PAIRS_TO_BUFFER);
+		mpParityBuffer = (char *)::malloc(mBlockSize *
+			STREAM_BLOCK_PAIRS_TO_BUFFER);
+		if(mpStreamBuffer == 0 || mpParityBuffer == 0)
+		{
+			throw std::bad_alloc();
+		}
+	}
+	mStreamBufferUsed = 0;
+
+	int startDisc = 0;
+	RaidFileUtil::MakeWriteFileName(rDiscSet, mFilename, &startDisc);
+	int *handles[TRANSFORM_NUMBER_DISCS_REQUIRED] =
+		{&mStripe1Handle, &mStripe2Handle, &mParityHandle};
+
+	for(int d = 0; d < TRANSFORM_NUMBER_DISCS_REQUIRED; d++)
+	{
+		std::string filename(RaidFileUtil::MakeRaidComponentName(
+			rDiscSet, mFilename,
+			(startDisc + d) % TRANSFORM_NUMBER_DISCS_REQUIRED) + 'P');
+		*(handles[d]) = ::open(filename.c_str(),
+			O_WRONLY | O_CREAT | O_TRUNC | O_BINARY,
+			S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+		if(*(handles[d]) == -1)
+		{
+			int errnoSaved = errno;
+			mStreamToRaid = true;	// so Discard() cleans up
+			THROW_SYS_FILE_ERRNO("Failed to open RaidFile stripe",
+				filename, errnoSaved, RaidFileException,
+				ErrorOpeningWriteFile);
+		}
+	}
+
+	mStreamToRaid = true;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileWrite::ConvertToStripes(RaidFileDiscSet &)
+//		Purpose: Writes the contents of the write file to stripe
+//				 and parity files, as if they had been streamed
+//				 there, so that CommitStripes() can commit them
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidFileWrite::ConvertToStripes(RaidFileDiscSet &rDiscSet)
+{
+	// Our handle is only open for writing
+	FileHandleGuard<> writeFile(mTempFilename);
+
+	OpenStripes(rDiscSet);
+	mStreamedSize = 0;
+
+	int bufferSize = mBlockSize * 2 * STREAM_BLOCK_PAIRS_TO_BUFFER;
+	MemoryBlockGuard<char*> buffer(bufferSize);
+	int bytesRead;
+	while((bytesRead = ::read(writeFile, buffer, bufferSize)) > 0)
+	{
+		Write(buffer, bytesRead);
+	}
+	if(bytesRead == -1)
+	{
+		THROW_SYS_FILE_ERROR("Failed to read RaidFile", mTempFilename,
+			RaidFileException, OSError);
 	}
-	
-	// Done!
 }
 
 // --------------------------------------------------------------------------
@@ -250,6 +497,45 @@ void RaidFileWrite::Write(const void *pBuffer, int Length, int Timeout)
 	{
 		THROW_EXCEPTION(RaidFileException, NotOpen)
 	}
+
+	if(mStreamToRaid)
+	{
+		// Buffer the data until there are whole pairs of blocks to
+		// write, but write straight from the caller's buffer if
+		// there's plenty of it
+		const char *pData = (const char *)pBuffer;
+		int bufferSize = mBlockSize * 2 * STREAM_BLOCK_PAIRS_TO_BUFFER;
+		int left = Length;
+		while(left > 0)
+		{
+			if(mStreamBufferUsed == 0 && left >= bufferSize)
+			{
+				WriteStripes(pData, STREAM_BLOCK_PAIRS_TO_BUFFER);
+				pData += bufferSize;
+				left -= bufferSize;
+				continue;
+			}
+
+			int toCopy = bufferSize - mStreamBufferUsed;
+			if(toCopy > left)
+			{
+				toCopy = left;
+			}
+			::memcpy(mpStreamBuffer + mStreamBufferUsed, pData, toCopy);
+			mStreamBufferUsed += toCopy;
+			pData += toCopy;
+			left -= toCopy;
+
+			if(mStreamBufferUsed == bufferSize)
+			{
+				WriteStripes(mpStreamBuffer,
+					STREAM_BLOCK_PAIRS_TO_BUFFER);
+				mStreamBufferUsed = 0;
+			}
+		}
+		mStreamedSize += Length;
+		return;
+	}
 	
 	// Write data
 	int written = ::write(mOSFileHandle, pBuffer, Length);
@@ -277,6 +563,11 @@ IOStream::pos_type RaidFileWrite::GetPosition() const
 	{
 		THROW_EXCEPTION(RaidFileException, NotOpen)
 	}
+
+	if(mStreamToRaid)
+	{
+		return mStreamedSize;
+	}
 	
 	// Use lseek to find the current file position
 	off_t p = ::lseek(mOSFileHandle, 0, SEEK_CUR);
@@ -304,6 +595,19 @@ void RaidFileWrite::Seek(IOStream::pos_type SeekTo, int SeekType)
 	{
 		THROW_EXCEPTION(RaidFileException, NotOpen)
 	}
+
+	if(mStreamToRaid)
+	{
+		// Only allowed if it goes nowhere
+		pos_type current = (SeekType == IOStream::SeekType_Absolute)
+			? mStreamedSize : 0;
+		if(SeekTo != current)
+		{
+			THROW_EXCEPTION(RaidFileException,
+				SeekNotSupportedWhenStreaming)
+		}
+		return;
+	}
 	
 	// Seek...
 	if(::lseek(mOSFileHandle, SeekTo, ConvertSeekTypeToOSWhence(SeekType)) == -1)
@@ -316,12 +620,17 @@ void RaidFileWrite::Seek(IOStream::pos_type SeekTo, int SeekType)
 // --------------------------------------------------------------------------
 //
 // Function
-//		Name:    RaidFileWrite::Commit(bool)
-//		Purpose: Closes, and commits the written file
+//		Name:    RaidFileWrite::Commit(bool, RaidFileSyncGroup *)
+//		Purpose: Closes, and commits the written file. If a sync
+//				 group is given, the files which make up the
+//				 committed file are handed to it instead of being
+//				 renamed into place, which happens when the group is
+//				 synced.
 //		Created: 2003/07/10
 //
 // --------------------------------------------------------------------------
-void RaidFileWrite::Commit(bool ConvertToRaidNow)
+void RaidFileWrite::Commit(bool ConvertToRaidNow,
+	RaidFileSyncGroup *pSyncGroup)
 {
 	// open?
 	if(mOSFileHandle == -1)
@@ -336,6 +645,50 @@ void RaidFileWrite::Commit(bool ConvertToRaidNow)
 			RequestedModifyUnreferencedFile);
 	}
 
+	mpSyncGroup = pSyncGroup;
+#ifdef WIN32
+	// Files can't be synced, and open ones can't be renamed by the group
+	mpSyncGroup = 0;
+#endif
+
+	if(mStreamToRaid)
+	{
+		RaidFileController &rcontroller(RaidFileController::GetController());
+		RaidFileDiscSet rdiscSet(rcontroller.GetDiscSet(mSetNumber));
+		CommitStripes(rdiscSet);
+		return;
+	}
+
+	if(mpSyncGroup)
+	{
+		RaidFileController &rcontroller(RaidFileController::GetController());
+		RaidFileDiscSet rdiscSet(rcontroller.GetDiscSet(mSetNumber));
+		if(ConvertToRaidNow && !rdiscSet.IsNonRaidSet())
+		{
+			// Transforming it would rename the write file into
+			// place first, so convert it as if it had been
+			// streamed to RAID storage instead
+			ConvertToStripes(rdiscSet);
+			CommitStripes(rdiscSet);
+			return;
+		}
+
+		// Hand it over -- BEFORE it's closed so lock remains
+		std::string renameTo(RaidFileUtil::MakeWriteFileName(rdiscSet,
+			mFilename));
+		mpSyncGroup->Add(mSetNumber, mFilename, &mTempFilename,
+			&renameTo, 1);
+
+		if(::close(mOSFileHandle) != 0)
+		{
+			mOSFileHandle = -1;
+			THROW_SYS_FILE_ERROR("Failed to close committed RaidFile",
+				mTempFilename, RaidFileException, OSError);
+		}
+		mOSFileHandle = -1;
+		return;
+	}
+
 	// Rename it into place -- BEFORE it's closed so lock remains
 
 #ifdef WIN32
@@ -386,7 +739,7 @@ void RaidFileWrite::Commit(bool ConvertToRaidNow)
 #endif // !WIN32
 	
 	// Raid it?
-	if(ConvertToRaidNow)
+	if(ConvertToRaidNow && !rdiscSet.IsNonRaidSet())
 	{
 		TransformToRaidStorage();
 	}
@@ -412,6 +765,11 @@ void RaidFileWrite::Discard()
 	RaidFileController &rcontroller(RaidFileController::GetController());
 	RaidFileDiscSet rdiscSet(rcontroller.GetDiscSet(mSetNumber));
 
+	if(mStreamToRaid)
+	{
+		DiscardStripes(rdiscSet);
+	}
+
 	// Get the filename for the write file (temporary)
 	std::string writeFilename(RaidFileUtil::MakeWriteFileName(rdiscSet, mFilename));
 	writeFilename += 'X';
@@ -548,9 +906,6 @@ void RaidFileWrite::TransformToRaidStorage()
 				::memset(buffer + bytesRead, 0, zerosEnd - bytesRead);
 			}
 
-			// number of int's to XOR
-			unsigned int num = blockSize / sizeof(unsigned int);
-
 			// Then... calculate and write parity data
 			for(int b = 0; b < blocksToDo; b += 2)
 			{
@@ -560,10 +915,8 @@ void RaidFileWrite::TransformToRaidStorage()
 				unsigned int *pparity = (unsigned int *)((char*)parityBuffer);
 
 				// Do XOR
-				for(unsigned int n = 0; n < num; ++n)
-				{
-					pparity[n] = pstripe1[n] ^ pstripe2[n];
-				}
+				RaidFileUtil::XorBlocks(pparity, pstripe1, pstripe2,
+					blockSize);
 				
 				// Size of parity to write...
 				int parityWriteSize = blockSize;
@@ -719,6 +1072,188 @@ void RaidFileWrite::TransformToRaidStorage()
 
 
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileWrite::WriteStripes(const char *, int)
+//		Purpose: Writes whole pairs of blocks to the stripe files,
+//				 and their parity to the parity file
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidFileWrite::WriteStripes(const char *pData, int NumPairs)
+{
+	ASSERT(NumPairs <= STREAM_BLOCK_PAIRS_TO_BUFFER);
+
+	struct iovec stripe1[STREAM_BLOCK_PAIRS_TO_BUFFER];
+	struct iovec stripe2[STREAM_BLOCK_PAIRS_TO_BUFFER];
+	for(int p = 0; p < NumPairs; ++p)
+	{
+		const char *pPair = pData + (p * mBlockSize * 2);
+		stripe1[p].iov_base = (void *)pPair;
+		stripe1[p].iov_len = mBlockSize;
+		stripe2[p].iov_base = (void *)(pPair + mBlockSize);
+		stripe2[p].iov_len = mBlockSize;
+		RaidFileUtil::XorBlocks(mpParityBuffer + (p * mBlockSize),
+			pPair, pPair + mBlockSize, mBlockSize);
+	}
+
+	int size = NumPairs * mBlockSize;
+	if(::writev(mStripe1Handle, stripe1, NumPairs) != size ||
+		::writev(mStripe2Handle, stripe2, NumPairs) != size ||
+		::write(mParityHandle, mpParityBuffer, size) != size)
+	{
+		THROW_SYS_FILE_ERROR("Failed to write to RaidFile stripes",
+			mFilename, RaidFileException, OSError);
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileWrite::CommitStripes(RaidFileDiscSet &)
+//		Purpose: Writes out the last blocks, exactly as
+//				 TransformToRaidStorage() would, and renames the
+//				 stripe and parity files into place, or hands them
+//				 to the sync group.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidFileWrite::CommitStripes(RaidFileDiscSet &rDiscSet)
+{
+	int pairSize = mBlockSize * 2;
+	int wholePairs = mStreamBufferUsed / pairSize;
+	if(wholePairs > 0)
+	{
+		WriteStripes(mpStreamBuffer, wholePairs);
+	}
+
+	// The last pair of blocks, and the file size if required, are
+	// arranged in exactly the same way as TransformToRaidStorage()
+	int bytesInLastTwoBlocks = mStreamBufferUsed - (wholePairs * pairSize);
+	char *pLast = mpStreamBuffer + (wholePairs * pairSize);
+	int parityWriteSize = RaidFileUtil::MakeParityTail(mpParityBuffer,
+		pLast, bytesInLastTwoBlocks, mBlockSize, mStreamedSize);
+
+	int stripe1Size = (bytesInLastTwoBlocks < (int)mBlockSize)
+		? bytesInLastTwoBlocks : mBlockSize;
+	int stripe2Size = bytesInLastTwoBlocks - stripe1Size;
+	if((stripe1Size > 0 && ::write(mStripe1Handle, pLast, stripe1Size) !=
+			stripe1Size) ||
+		(stripe2Size > 0 && ::write(mStripe2Handle,
+			pLast + mBlockSize, stripe2Size) != stripe2Size) ||
+		::write(mParityHandle, mpParityBuffer, parityWriteSize) !=
+			parityWriteSize)
+	{
+		THROW_SYS_FILE_ERROR("Failed to write to RaidFile stripes",
+			mFilename, RaidFileException, OSError);
+	}
+
+	// Close the files, in reverse order of opening
+	int *handles[TRANSFORM_NUMBER_DISCS_REQUIRED] =
+		{&mParityHandle, &mStripe2Handle, &mStripe1Handle};
+	for(int h = 0; h < TRANSFORM_NUMBER_DISCS_REQUIRED; h++)
+	{
+		int handle = *(handles[h]);
+		*(handles[h]) = -1;
+		if(::close(handle) != 0)
+		{
+			THROW_SYS_FILE_ERROR("Failed to close RaidFile stripe",
+				mFilename, RaidFileException, OSError);
+		}
+	}
+
+	int startDisc = 0;
+	std::string writeFilename(RaidFileUtil::MakeWriteFileName(rDiscSet,
+		mFilename, &startDisc));
+	std::string filenames[TRANSFORM_NUMBER_DISCS_REQUIRED];
+	std::string tempFilenames[TRANSFORM_NUMBER_DISCS_REQUIRED];
+	for(int d = 0; d < TRANSFORM_NUMBER_DISCS_REQUIRED; d++)
+	{
+		filenames[d] = RaidFileUtil::MakeRaidComponentName(rDiscSet,
+			mFilename, (startDisc + d) % TRANSFORM_NUMBER_DISCS_REQUIRED);
+		tempFilenames[d] = filenames[d] + 'P';
+	}
+
+	if(mpSyncGroup)
+	{
+		// It puts them into place, and removes any older write file,
+		// once their data is on disc
+		mpSyncGroup->Add(mSetNumber, mFilename, tempFilenames,
+			filenames, TRANSFORM_NUMBER_DISCS_REQUIRED, writeFilename);
+		mStreamToRaid = false;
+		Discard();
+		return;
+	}
+
+	// Rename them into place
+	for(int d = 0; d < TRANSFORM_NUMBER_DISCS_REQUIRED; d++)
+	{
+		const std::string &filename(filenames[d]);
+		const std::string &tempFilename(tempFilenames[d]);
+
+#ifdef WIN32
+		// Must delete before renaming
+		if(EMU_UNLINK(filename.c_str()) != 0 && errno != ENOENT)
+		{
+			THROW_EMU_ERROR("Failed to unlink raidfile stripe: " <<
+				filename, RaidFileException, OSError);
+		}
+#endif
+
+		if(::rename(tempFilename.c_str(), filename.c_str()) != 0)
+		{
+			THROW_SYS_ERROR("Failed to rename file: " << tempFilename <<
+				" to " << filename, RaidFileException, OSError);
+		}
+	}
+
+	// If an older version was committed without being transformed, it
+	// must not be read instead of this one
+	if(EMU_UNLINK(writeFilename.c_str()) != 0 && errno != ENOENT)
+	{
+		THROW_SYS_FILE_ERROR("Failed to delete file", writeFilename,
+			RaidFileException, OSError);
+	}
+
+	// Finally get rid of the (empty) locked write file
+	mStreamToRaid = false;
+	Discard();
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    RaidFileWrite::DiscardStripes(RaidFileDiscSet &)
+//		Purpose: Closes and deletes the partly written stripe and
+//				 parity files
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void RaidFileWrite::DiscardStripes(RaidFileDiscSet &rDiscSet)
+{
+	int startDisc = 0;
+	RaidFileUtil::MakeWriteFileName(rDiscSet, mFilename, &startDisc);
+	int *handles[TRANSFORM_NUMBER_DISCS_REQUIRED] =
+		{&mStripe1Handle, &mStripe2Handle, &mParityHandle};
+
+	for(int d = 0; d < TRANSFORM_NUMBER_DISCS_REQUIRED; d++)
+	{
+		if(*(handles[d]) != -1)
+		{
+			::close(*(handles[d]));
+			*(handles[d]) = -1;
+		}
+
+		std::string filename(RaidFileUtil::MakeRaidComponentName(
+			rDiscSet, mFilename,
+			(startDisc + d) % TRANSFORM_NUMBER_DISCS_REQUIRED) + 'P');
+		EMU_UNLINK(filename.c_str());
+	}
+
+	mStreamToRaid = false;
+}
+
 // --------------------------------------------------------------------------
 //
 // Function
@@ -944,6 +1479,11 @@ IOStream::pos_type RaidFileWrite::GetFileSize()
 	{
 		THROW_EXCEPTION(RaidFileException, CanOnlyGetFileSizeBeforeCommit)
 	}
+
+	if(mStreamToRaid)
+	{
+		return mStreamedSize;
+	}
 	
 	// Stat to get size
 	struct stat st;
@@ -975,18 +1515,10 @@ IOStream::pos_type RaidFileWrite::GetDiscUsageInBlocks()
 		THROW_EXCEPTION(RaidFileException, CanOnlyGetUsageBeforeCommit)
 	}
 	
-	// Stat to get size
-	struct stat st;
-	if(fstat(mOSFileHandle, &st) != 0)
-	{
-		THROW_SYS_FILE_ERROR("Failed to stat RaidFile", mTempFilename,
-			RaidFileException, OSError);
-	}
-	
 	// Then return calculation
 	RaidFileController &rcontroller(RaidFileController::GetController());
 	RaidFileDiscSet rdiscSet(rcontroller.GetDiscSet(mSetNumber));
-	return RaidFileUtil::DiscUsageInBlocks(st.st_size, rdiscSet);
+	return RaidFileUtil::DiscUsageInBlocks(GetFileSize(), rdiscSet);
 }
 
 
@@ -15,6 +15,7 @@
 #include "IOStream.h"
 
 class RaidFileDiscSet;
+class RaidFileSyncGroup;
 
 // --------------------------------------------------------------------------
 //
@@ -57,8 +58,11 @@ public:
 	virtual bool StreamClosed();
 
 	// Extra bits
-	void Open(bool AllowOverwrite = false);
-	void Commit(bool ConvertToRaidNow = false);
+	void Open(bool AllowOverwrite = false, bool StreamToRaid = false);
+	bool OpenFromFile(const std::string &rOSFilename,
+		bool AllowOverwrite = false);
+	void Commit(bool ConvertToRaidNow = false,
+		RaidFileSyncGroup *pSyncGroup = 0);
 	void Discard();
 	void TransformToRaidStorage();
 	void Delete();
@@ -69,10 +73,29 @@ public:
 	static void CreateDirectory(const RaidFileDiscSet &rSet, const std::string &rDirName, bool Recursive = false, int mode = 0777);
 
 private:
+	void LockWriteFile();
+	void OpenStripes(RaidFileDiscSet &rDiscSet);
+	void ConvertToStripes(RaidFileDiscSet &rDiscSet);
+	void WriteStripes(const char *pData, int NumPairs);
+	void CommitStripes(RaidFileDiscSet &rDiscSet);
+	void DiscardStripes(RaidFileDiscSet &rDiscSet);
+
 	int mSetNumber;
 	std::string mFilename, mTempFilename;
 	int mOSFileHandle;
 	int mRefCount;
+	RaidFileSyncGroup *mpSyncGroup;
+
+	// Writing straight to RAID storage, see Open()
+	bool mStreamToRaid;
+	int mStripe1Handle;
+	int mStripe2Handle;
+	int mParityHandle;
+	unsigned int mBlockSize;
+	char *mpStreamBuffer;
+	char *mpParityBuffer;
+	int mStreamBufferUsed;
+	pos_type mStreamedSize;
 };
 
 #endif // RAIDFILEWRITE__H
@@ -698,6 +698,9 @@ int Daemon::Main(const std::string &rConfigFileName)
 				
 				// Stop being marked for loading config again
 				mReloadConfigWanted = false;
+#ifndef WIN32
+				mStopRunEvent.Clear();
+#endif
 			}
 		}
 		
@@ -785,10 +788,12 @@ void Daemon::SignalHandler(int sigraised)
 		{
 		case SIGHUP:
 			spDaemon->mReloadConfigWanted = true;
+			spDaemon->SignalStopRun();
 			break;
 			
 		case SIGTERM:
 			spDaemon->mTerminateWanted = true;
+			spDaemon->SignalStopRun();
 			break;
 		
 		default:
@@ -20,6 +20,7 @@
 
 #include "BoxTime.h"
 #include "Configuration.h"
+#include "WakeUpEvent.h"
 
 class ConfigurationVerify;
 
@@ -64,8 +65,23 @@ public:
 	bool IsTerminateWanted() {return mTerminateWanted;}
 
 	// To allow derived classes to get these signals in other ways
-	void SetReloadConfigWanted() {mReloadConfigWanted = true;}
-	void SetTerminateWanted() {mTerminateWanted = true;}
+	void SetReloadConfigWanted()
+	{
+		mReloadConfigWanted = true;
+		SignalStopRun();
+	}
+	void SetTerminateWanted()
+	{
+		mTerminateWanted = true;
+		SignalStopRun();
+	}
+
+#ifndef WIN32
+	// Signalled when StopRun() becomes true, so that a WaitForEvent
+	// which has it added returns straight away, even if the signal
+	// which caused it arrived just before the wait started.
+	WakeUpEvent &GetStopRunEvent() { return mStopRunEvent; }
+#endif
 	
 	virtual void EnterChild();
 	
@@ -98,6 +114,12 @@ protected:
 private:
 	static void SignalHandler(int sigraised);
 	box_time_t GetConfigFileModifiedTime() const;
+	void SignalStopRun()
+	{
+#ifndef WIN32
+		mStopRunEvent.Signal();
+#endif
+	}
 	
 	std::string mConfigFileName;
 	std::auto_ptr<Configuration> mapConfiguration;
@@ -114,6 +136,9 @@ private:
 	std::auto_ptr<FileLogger> mapLogFileLogger;
 	static Daemon *spDaemon;
 	std::string mAppName;
+#ifndef WIN32
+	WakeUpEvent mStopRunEvent;
+#endif
 };
 
 #define DAEMON_VERIFY_SERVER_KEYS \
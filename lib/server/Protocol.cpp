@@ -50,6 +50,7 @@ Protocol::Protocol(std::auto_ptr<SocketStream> apConn)
   mHandshakeDone(false),
   mMaxObjectSize(PROTOCOL_DEFAULT_MAXOBJSIZE),
   mTimeout(PROTOCOL_DEFAULT_TIMEOUT),
+  mStreamCopyBufferSize(PROTOCOL_DEFAULT_STREAM_COPY_BUFFER_SIZE),
   mpBuffer(0),
   mBufferSize(0),
   mReadOffset(-1),
@@ -762,9 +763,18 @@ void Protocol::SendStream(IOStream &rStream)
 	}
 	else
 	{
-		// Fixed size stream, send it all in one go
-		if(!rStream.CopyStreamTo(*mapConn, GetTimeout(),
-			4096 /* slightly larger buffer */))
+		// Fixed size stream, send it all in one go. If it comes
+		// straight from a file, try to have the kernel send it
+		// without copying it through our buffer.
+		int fileHandle = rStream.GetReadFileHandle();
+		if(fileHandle != -1 &&
+			mapConn->SendFile(fileHandle, streamSize, GetTimeout()))
+		{
+			BOX_TRACE("Sent " << streamSize << " bytes straight "
+				"from file");
+		}
+		else if(!rStream.CopyStreamTo(*mapConn, GetTimeout(),
+			mStreamCopyBufferSize))
 		{
 			THROW_EXCEPTION(ConnectionException, Protocol_TimeOutWhenSendingStream)
 		}
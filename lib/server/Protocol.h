@@ -25,6 +25,9 @@ class SocketStream;
 #define PROTOCOL_DEFAULT_TIMEOUT	(15*60*1000)
 // 16 default maximum object size -- should be enough
 #define PROTOCOL_DEFAULT_MAXOBJSIZE	(16*1024)
+// size of buffer used to copy fixed-size streams to the connection, and
+// bbstored's default StreamCopyBufferSize
+#define PROTOCOL_DEFAULT_STREAM_COPY_BUFFER_SIZE	(64*1024)
 
 // --------------------------------------------------------------------------
 //
@@ -91,6 +94,17 @@ public:
 	// --------------------------------------------------------------------------	
 	void SetMaxObjectSize(unsigned int NewMaxObjSize) {mMaxObjectSize = NewMaxObjSize;}
 
+	// --------------------------------------------------------------------------
+	//
+	// Function
+	//		Name:    Protocol::SetStreamCopyBufferSize(int)
+	//		Purpose: Sets the size of the buffer used to send fixed-size
+	//				 streams which can't be sent straight from a file
+	//		Created: 2026/10/19
+	//
+	// --------------------------------------------------------------------------
+	void SetStreamCopyBufferSize(int NewSize) {mStreamCopyBufferSize = NewSize;}
+
 	// For Message derived classes
 	void Read(void *Buffer, int Size);
 	void Read(std::string &rOut, int Size);
@@ -197,6 +211,7 @@ private:
 	bool mHandshakeDone;
 	unsigned int mMaxObjectSize;
 	int mTimeout;
+	int mStreamCopyBufferSize;
 	char *mpBuffer;
 	int mBufferSize;
 	int mReadOffset;
@@ -14,10 +14,14 @@
 #include <errno.h>
 
 #ifndef WIN32
+	#include <signal.h>
 	#include <sys/wait.h>
 #endif
 
+#include <set>
+
 #include "autogen_ServerException.h"
+#include "BoxTime.h"
 #include "Daemon.h"
 #include "SocketListen.h"
 #include "Utils.h"
@@ -39,6 +43,9 @@ class ServerStream : public Daemon
 {
 public:
 	ServerStream()
+	: mWorkerProcesses(0),
+	  mMaxConnections(0),
+	  mIsWorker(false)
 	{
 	}
 	~ServerStream()
@@ -155,12 +162,43 @@ public:
 				const Configuration &config(this->GetConfiguration());
 				const Configuration &server(config.GetSubConfiguration("Server"));
 				std::string addrs = server.GetKeyValue("ListenAddresses");
+
+				// How should connections be handled?
+				mWorkerProcesses = server.KeyExists("WorkerProcesses")
+					? server.GetKeyValueInt("WorkerProcesses") : 0;
+				mMaxConnections = server.KeyExists("MaxConnections")
+					? server.GetKeyValueInt("MaxConnections") : 0;
 	
+				// Keep listening on the same sockets after reloading
+				// the configuration, unless the addresses changed,
+				// so that old workers can finish their connections
+				// while new ones accept more.
+				bool reuseSockets = !mSockets.empty() &&
+					addrs == mListenAddresses;
+				if(reuseSockets)
+				{
+					for(unsigned int l = 0; l < mSockets.size(); ++l)
+					{
+						connectionWait.Add(mSockets[l]);
+					}
+				}
+				else
+				{
+					DeleteSockets();
+					#ifndef WIN32
+					// The old workers must close their copies of the
+					// sockets before we can listen on them again.
+					StopWorkers();
+					#endif
+				}
+				mListenAddresses = addrs;
+
 				// split up the list of addresses
 				std::vector<std::string> addrlist;
 				SplitString(addrs, ',', addrlist);
 	
-				for(unsigned int a = 0; a < addrlist.size(); ++a)
+				for(unsigned int a = 0;
+					!reuseSockets && a < addrlist.size(); ++a)
 				{
 					// split the address up into components
 					std::vector<std::string> c;
@@ -243,9 +281,44 @@ public:
 	
 			while(!StopRun())
 			{
+				#ifndef WIN32
+				if(UseWorkerProcesses() && !mIsWorker)
+				{
+					// The workers accept and handle connections
+					// themselves, so all this process has to do
+					// is to replace any which have exited.
+					if(StartWorkers())
+					{
+						// Now in a new worker process, which
+						// goes round the loop again to wait
+						// for a connection.
+						rChildExit = true;
+						continue;
+					}
+
+					OnIdle();
+					ShortSleep(MilliSecondsToBoxTime(1000), false);
+					WaitForChildren();
+					continue;
+				}
+
+				if(WillForkToHandleRequests() && mMaxConnections > 0 &&
+					(int)mChildren.size() >= mMaxConnections)
+				{
+					// Don't accept any more connections until
+					// a child exits. They wait in the listen
+					// queue in the meantime.
+					OnIdle();
+					ShortSleep(MilliSecondsToBoxTime(100), false);
+					WaitForChildren();
+					continue;
+				}
+				#endif // !WIN32
+
 				// Wait for a connection, or timeout
 				SocketListen<StreamType, ListenBacklog> *psocket
-					= (SocketListen<StreamType, ListenBacklog> *)connectionWait.Wait();
+					= (SocketListen<StreamType, ListenBacklog> *)
+					WaitForConnection(connectionWait);
 
 				if(psocket)
 				{
@@ -260,7 +333,7 @@ public:
 					{
 						// Since this is a template parameter, the if() will be optimised out by the compiler
 						#ifndef WIN32 // no fork on Win32
-						if(ForkToHandleRequests && !IsSingleProcess())
+						if(WillForkToHandleRequests())
 						{
 							pid_t pid = ::fork();
 							switch(pid)
@@ -293,6 +366,7 @@ public:
 			
 							default:
 								// parent daemon process
+								mChildren.insert(pid);
 								break;
 							}
 							
@@ -306,6 +380,16 @@ public:
 						#endif // !WIN32
 							// Just handle in this process
 							SetProcessTitle("handling");
+
+							#ifndef WIN32
+							// A signal only asks a worker to stop, which
+							// it does after finishing this connection.
+							if(mIsWorker)
+							{
+								LogConnectionDetails(mConnectionDetails);
+							}
+							#endif // !WIN32
+
 							try
 							{
 								HandleConnection(connection);
@@ -316,6 +400,7 @@ public:
 									"exception " << e.what() << "(" << e.GetType() << "/" <<
 									e.GetSubType() << ")");
 							}
+
 							SetProcessTitle("idle");										
 						#ifndef WIN32
 						}
@@ -327,7 +412,7 @@ public:
 
 				#ifndef WIN32
 				// Clean up child processes (if forking daemon)
-				if(ForkToHandleRequests && !IsSingleProcess())
+				if(WillForkToHandleRequests())
 				{
 					WaitForChildren();
 				}
@@ -337,11 +422,36 @@ public:
 		catch(...)
 		{
 			DeleteSockets();
+			#ifndef WIN32
+			if(!mIsWorker)
+			{
+				StopWorkers();
+			}
+			#endif
 			throw;
 		}
 		
+		#ifndef WIN32
+		if(!mIsWorker && UseWorkerProcesses() &&
+			IsReloadConfigWanted() && !IsTerminateWanted())
+		{
+			// Keep the sockets open while the configuration is
+			// reloaded, and replace the workers without waiting
+			// for them to finish their connections.
+			RetireWorkers();
+			return;
+		}
+		#endif
+
 		// Delete the sockets
 		DeleteSockets();
+
+		#ifndef WIN32
+		if(!mIsWorker)
+		{
+			StopWorkers();
+		}
+		#endif
 	}
 
 	#ifndef WIN32 // no waitpid() on Windows
@@ -373,8 +483,14 @@ public:
 			{
 				// no children exited, will return from
 				// function
+				break;
 			}
-			else if(WIFEXITED(status))
+
+			mChildren.erase(p);
+			mWorkers.erase(p);
+			mRetiringWorkers.erase(p);
+
+			if(WIFEXITED(status))
 			{
 				BOX_INFO("child process " << p << " "
 					"terminated normally");
@@ -395,6 +511,127 @@ public:
 		}
 		while(p > 0);
 	}
+
+	// --------------------------------------------------------------------------
+	//
+	// Function
+	//		Name:    ServerStream::StartWorkers()
+	//		Purpose: Forks worker processes until there are
+	//			 WorkerProcesses of them. Returns true in a new
+	//			 worker, and false in the parent.
+	//		Created: 2026/10/19
+	//
+	// --------------------------------------------------------------------------
+	bool StartWorkers()
+	{
+		while((int)mWorkers.size() < mWorkerProcesses)
+		{
+			pid_t pid = ::fork();
+			switch(pid)
+			{
+			case -1:
+				THROW_EXCEPTION(ServerException, ServerForkError)
+				break;
+
+			case 0:
+			{
+				// Worker process. Unlike a child forked for one
+				// connection, this keeps the parent's signal
+				// handlers, so that it can finish the
+				// connection it's handling before exiting.
+				// They restart system calls, so that the
+				// connection isn't interrupted by the signal.
+				int signals[] = {SIGHUP, SIGTERM};
+				for(int i = 0; i < 2; i++)
+				{
+					struct sigaction sa;
+					if(::sigaction(signals[i], NULL, &sa) == 0)
+					{
+						sa.sa_flags |= SA_RESTART;
+						::sigaction(signals[i], &sa, NULL);
+					}
+				}
+
+				mIsWorker = true;
+				mChildren.clear();
+				mWorkers.clear();
+				mRetiringWorkers.clear();
+				SetProcessTitle("idle");
+
+				#ifdef BOX_MEMORY_LEAK_TESTING
+					memleakfinder_startsectionmonitor();
+				#endif
+				return true;
+			}
+
+			default:
+				mWorkers.insert(pid);
+				BOX_TRACE("Forked worker process " << pid);
+				break;
+			}
+		}
+
+		return false;
+	}
+
+	// --------------------------------------------------------------------------
+	//
+	// Function
+	//		Name:    ServerStream::RetireWorkers()
+	//		Purpose: Asks the worker processes to exit after
+	//			 finishing the connections that they are
+	//			 handling, without waiting for them. They are
+	//			 reaped by WaitForChildren(), and new workers
+	//			 can be started straight away to replace them.
+	//		Created: 2026/10/19
+	//
+	// --------------------------------------------------------------------------
+	void RetireWorkers()
+	{
+		for(std::set<pid_t>::iterator i = mWorkers.begin();
+			i != mWorkers.end(); i++)
+		{
+			::kill(*i, SIGTERM);
+			mRetiringWorkers.insert(*i);
+		}
+		mWorkers.clear();
+	}
+
+	// --------------------------------------------------------------------------
+	//
+	// Function
+	//		Name:    ServerStream::StopWorkers()
+	//		Purpose: Asks the worker processes to exit, and waits
+	//			 for them, and any retired ones, to finish the
+	//			 connections that they are handling, so that
+	//			 their listening sockets are closed before we try
+	//			 to listen again.
+	//		Created: 2026/10/19
+	//
+	// --------------------------------------------------------------------------
+	void StopWorkers()
+	{
+		RetireWorkers();
+
+		if(mRetiringWorkers.empty())
+		{
+			return;
+		}
+
+		BOX_INFO("Waiting for " << mRetiringWorkers.size() << " worker "
+			"processes to finish");
+
+		while(!mRetiringWorkers.empty())
+		{
+			pid_t pid = *(mRetiringWorkers.begin());
+			int status = 0;
+			if(::waitpid(pid, &status, 0) == -1 && errno == EINTR)
+			{
+				continue;
+			}
+			mRetiringWorkers.erase(pid);
+		}
+	}
 	#endif
 
 	virtual void HandleConnection(std::auto_ptr<StreamType> apStream)
@@ -402,6 +639,23 @@ public:
 		Connection(apStream);
 	}
 
+	// --------------------------------------------------------------------------
+	//
+	// Function
+	//		Name:    ServerStream::WaitForConnection(WaitForEvent &)
+	//		Purpose: Waits for a connection on any of the listening
+	//			 sockets, returning the socket, or NULL after a
+	//			 timeout. Event-driven servers override this to
+	//			 serve the connections that they already have
+	//			 while they wait.
+	//		Created: 2026/10/19
+	//
+	// --------------------------------------------------------------------------
+	virtual void *WaitForConnection(WaitForEvent &rConnectionWait)
+	{
+		return rConnectionWait.Wait();
+	}
+
 	virtual void Connection(std::auto_ptr<StreamType> apStream) = 0;
 	
 protected:
@@ -412,7 +666,33 @@ protected:
 		#ifdef WIN32
 		return false;
 		#else
-		return ForkToHandleRequests && !IsSingleProcess();
+		return ForkToHandleRequests && !IsSingleProcess() &&
+			!UseWorkerProcesses() && !IsEventDriven();
+		#endif // WIN32
+	}
+
+	// True if the derived class handles many connections at once in
+	// one process, returning from Connection() straight away and
+	// serving them from WaitForConnection(), so that no process needs
+	// to be forked for each one. Worker processes can still be used,
+	// to spread connections over several CPUs.
+	virtual bool IsEventDriven() { return false; }
+
+	const std::vector<SocketListen<StreamType, ListenBacklog> *> &
+	GetListeningSockets() const
+	{
+		return mSockets;
+	}
+
+	// True if connections are handled by a pool of pre-forked worker
+	// processes, each handling one connection at a time.
+	bool UseWorkerProcesses()
+	{
+		#ifdef WIN32
+		return false;
+		#else
+		return ForkToHandleRequests && !IsSingleProcess() &&
+			mWorkerProcesses > 0;
 		#endif // WIN32
 	}
 
@@ -441,10 +721,21 @@ private:
 
 private:
 	std::vector<SocketListen<StreamType, ListenBacklog> *> mSockets;
+	int mWorkerProcesses;
+	int mMaxConnections;
+	bool mIsWorker;
+	std::set<pid_t> mChildren;	// forked for one connection each
+	std::set<pid_t> mWorkers;
+	// Asked to exit after finishing their current connections
+	std::set<pid_t> mRetiringWorkers;
+	// The addresses that mSockets are listening on
+	std::string mListenAddresses;
 };
 
 #define SERVERSTREAM_VERIFY_SERVER_KEYS(DEFAULT_ADDRESSES) \
 	ConfigurationVerifyKey("ListenAddresses", 0, DEFAULT_ADDRESSES), \
+	ConfigurationVerifyKey("WorkerProcesses", ConfigTest_IsInt, 0), \
+	ConfigurationVerifyKey("MaxConnections", ConfigTest_IsInt, 0), \
 	DAEMON_VERIFY_SERVER_KEYS 
 
 #include "MemLeakFindOff.h"
@@ -59,6 +59,7 @@ public:
 
 		mContext.Initialise(true /* as server */, certFile.c_str(),
 			keyFile.c_str(), caFile.c_str(), ssl_security_level);
+		mContext.SetKernelTLS(serverconf.GetKeyValueBool("KernelTLS"));
 	
 		// Then do normal stream server stuff
 		ServerStream<SocketStreamTLS, Port, ListenBacklog,
@@ -82,6 +83,7 @@ private:
 	ConfigurationVerifyKey("TrustedCAsFile", ConfigTest_Exists), \
 	ConfigurationVerifyKey("SSLSecurityLevel", ConfigTest_IsInt, \
 		BOX_DEFAULT_SSL_SECURITY_LEVEL), \
+	ConfigurationVerifyKey("KernelTLS", ConfigTest_IsBool, false), \
 	SERVERSTREAM_VERIFY_SERVER_KEYS(DEFAULT_ADDRESSES)
 
 #endif // SERVERTLS__H
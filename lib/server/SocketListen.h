@@ -22,6 +22,7 @@
 #endif
 
 #ifndef WIN32
+	#include <fcntl.h>
 	#include <poll.h>
 #endif
 
@@ -267,7 +268,23 @@ public:
 		}
 
 		// Got socket (or error), unlock (implicit in destruction)
-		if(sock == -1)
+		if(sock == -1 && errno == EINTR)
+		{
+			// Another process sharing this socket got there
+			// first, and then a signal arrived while we waited
+			BOX_INFO("Failed to accept connection: interrupted "
+				"by signal");
+			return std::auto_ptr<SocketType>();
+		}
+#ifndef WIN32
+		else if(sock == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			// Non-blocking, and another process sharing this
+			// socket got there first
+			return std::auto_ptr<SocketType>();
+		}
+#endif
+		else if(sock == -1)
 		{
 			THROW_EXCEPTION_MESSAGE(ServerException, SocketAcceptError,
 				BOX_SOCKET_ERROR_MESSAGE(mType, mName,
@@ -289,6 +306,32 @@ public:
 		return std::auto_ptr<SocketType>(new SocketType(sock));
 	}
 	
+#ifndef WIN32
+	// ------------------------------------------------------------------
+	//
+	// Function
+	//		Name:    SocketListen::SetNonBlocking()
+	//		Purpose: Makes Accept() return nothing, instead of
+	//			 waiting, if another process sharing the socket
+	//			 accepts the connection first.
+	//		Created: 2026/10/19
+	//
+	// ------------------------------------------------------------------
+	void SetNonBlocking()
+	{
+		int flags = ::fcntl(mSocketHandle, F_GETFL);
+		if(flags == -1 || ::fcntl(mSocketHandle, F_SETFL,
+			flags | O_NONBLOCK) == -1)
+		{
+			THROW_EXCEPTION_MESSAGE(ServerException, SocketOpenError,
+				BOX_SOCKET_ERROR_MESSAGE(mType, mName, mPort,
+					"Failed to make socket non-blocking"));
+		}
+	}
+#endif
+
+	int GetSocketHandle() const { return mSocketHandle; }
+
 	// Functions to allow adding to WaitForEvent class, for efficient waiting
 	// on multiple sockets.
 #ifdef HAVE_KQUEUE
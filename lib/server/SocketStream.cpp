@@ -33,6 +33,10 @@
 	#include <sys/param.h>
 #endif
 
+#ifdef HAVE_SYS_SENDFILE_H
+	#include <sys/sendfile.h>
+#endif
+
 #ifdef HAVE_SYS_UCRED_H
 	#include <sys/ucred.h>
 #endif
@@ -395,6 +399,134 @@ void SocketStream::Write(const void *pBuffer, int NBytes, int Timeout)
 	}
 }
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    SocketStream::WriteWithoutBlocking(const void *, int)
+//		Purpose: Writes as much of the buffer as the socket will
+//			 take without waiting, which may be nothing, and
+//			 returns the number of bytes written. A peer which
+//			 has closed the connection causes an exception,
+//			 rather than a SIGPIPE, where the OS allows.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int SocketStream::WriteWithoutBlocking(const void *pBuffer, int NBytes)
+{
+	if(mSocketHandle == INVALID_SOCKET_VALUE)
+	{
+		THROW_EXCEPTION(ServerException, BadSocketHandle)
+	}
+
+#ifdef WIN32
+	int sent = ::send(mSocketHandle, (const char *)pBuffer, NBytes, 0);
+#else
+	int flags = MSG_DONTWAIT;
+	#ifdef MSG_NOSIGNAL
+		flags |= MSG_NOSIGNAL;
+	#endif
+	int sent = ::send(mSocketHandle, pBuffer, NBytes, flags);
+	if(sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+		errno == EINTR))
+	{
+		return 0;
+	}
+#endif
+
+	if(sent == -1)
+	{
+		mWriteClosed = true;	// assume can't write again
+		THROW_SYS_ERROR("Failed to write to socket",
+			ConnectionException, SocketWriteError);
+	}
+
+	mBytesWritten += sent;
+	return sent;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    SocketStream::SendFile(int, IOStream::pos_type, int)
+//		Purpose: Sends Length bytes from the current position of an
+//				 open file, without copying them into user space.
+//				 Returns false, having sent nothing, if this isn't
+//				 supported, in which case the caller should copy the
+//				 data with Write() instead.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool SocketStream::SendFile(int FileHandle, IOStream::pos_type Length,
+	int Timeout)
+{
+#ifndef HAVE_SYS_SENDFILE_H
+	return false;
+#else
+	if(mSocketHandle == INVALID_SOCKET_VALUE)
+	{
+		THROW_EXCEPTION(ServerException, BadSocketHandle)
+	}
+
+	// Bytes left to send
+	IOStream::pos_type bytesLeft = Length;
+	box_time_t start = GetCurrentBoxTime();
+
+	while(bytesLeft > 0)
+	{
+		// Linux won't send more than 2GB in one go anyway
+		size_t toSend = (bytesLeft > 0x40000000)
+			? 0x40000000 : (size_t)bytesLeft;
+		ssize_t sent = ::sendfile(mSocketHandle, FileHandle, NULL,
+			toSend);
+		if(sent == -1 && bytesLeft == Length &&
+			(errno == EINVAL || errno == ENOSYS))
+		{
+			// This kind of file or socket can't be used with
+			// sendfile(), but nothing has been sent yet.
+			return false;
+		}
+		else if(sent == -1)
+		{
+			// Error.
+			mWriteClosed = true;	// assume can't write again
+			THROW_SYS_ERROR("Failed to send file to socket",
+				ConnectionException, SocketWriteError);
+		}
+		else if(sent == 0)
+		{
+			// The file is shorter than the caller said
+			mWriteClosed = true;
+			THROW_EXCEPTION_MESSAGE(ConnectionException,
+				SocketWriteError, "File ended with " <<
+				bytesLeft << " of " << Length << " bytes "
+				"still to send");
+		}
+
+		// Knock off bytes sent
+		bytesLeft -= sent;
+		mBytesWritten += sent;
+
+		// Need to wait until it can send again?
+		if(bytesLeft > 0)
+		{
+			BOX_TRACE("Waiting to send file data on socket " <<
+				mSocketHandle << " (" << bytesLeft <<
+				" of " << Length << " bytes left)");
+
+			if(!Poll(POLLOUT, PollTimeout(Timeout, start)))
+			{
+				THROW_EXCEPTION_MESSAGE(ConnectionException,
+					Protocol_Timeout, "Timed out waiting "
+					"to send " << bytesLeft << " of " <<
+					Length << " bytes");
+			}
+		}
+	}
+
+	return true;
+#endif // HAVE_SYS_SENDFILE_H
+}
+
 // --------------------------------------------------------------------------
 //
 // Function
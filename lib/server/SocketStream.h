@@ -16,6 +16,11 @@
 #	include <sys/poll.h>
 #endif
 
+#ifdef HAVE_KQUEUE
+#	include <sys/event.h>
+#	include <sys/time.h>
+#endif
+
 #include "BoxTime.h"
 #include "IOStream.h"
 #include "Socket.h"
@@ -58,6 +63,10 @@ public:
 		IOStream::Write(rBuffer, Timeout);
 	}
 
+	virtual bool SendFile(int FileHandle, IOStream::pos_type Length,
+		int Timeout = IOStream::TimeOutInfinite);
+	int WriteWithoutBlocking(const void *pBuffer, int NBytes);
+
 	virtual void Close();
 	virtual bool StreamDataLeft();
 	virtual bool StreamClosed();
@@ -104,8 +113,31 @@ protected:
 			return (int) BoxTimeToMilliSeconds(remaining);
 		}
 	}
+
+public:
+	// Waits for the given poll() events, returning false on timeout
 	bool Poll(short Events, int Timeout);
 
+#ifndef WIN32
+	// Functions to allow adding to WaitForEvent class. The flags are
+	// the poll() events to wait for, or POLLIN if none are given. A
+	// kevent can only wait for one of them, so waits for POLLOUT if
+	// asked for both.
+#ifdef HAVE_KQUEUE
+	void FillInKEvent(struct kevent &rEvent, int Flags = 0) const
+	{
+		EV_SET(&rEvent, mSocketHandle, (Flags & POLLOUT) ?
+			EVFILT_WRITE : EVFILT_READ, 0, 0, 0, (void*)this);
+	}
+#else
+	void FillInPoll(int &fd, short &events, int Flags = 0) const
+	{
+		fd = mSocketHandle;
+		events = Flags ? Flags : POLLIN;
+	}
+#endif
+#endif // !WIN32
+
 private:
 	tOSSocketHandle mSocketHandle;
 	bool mReadClosed;
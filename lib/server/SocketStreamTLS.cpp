@@ -18,6 +18,10 @@
 #include <poll.h>
 #endif
 
+#ifdef HAVE_UNISTD_H
+	#include <unistd.h>
+#endif
+
 #include <openssl/bio.h>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
@@ -172,6 +176,12 @@ void SocketStreamTLS::Handshake(const TLSContext &rContext, bool IsServer)
 	// Set the two to know about each other
 	::SSL_set_bio(mpSSL, mpBIO, mpBIO);
 
+	// Try to resume the last session with the server, if any
+	if(!IsServer && rContext.GetSession() != 0)
+	{
+		::SSL_set_session(mpSSL, rContext.GetSession());
+	}
+
 	bool waitingForHandshake = true;
 	while(waitingForHandshake)
 	{
@@ -193,6 +203,16 @@ void SocketStreamTLS::Handshake(const TLSContext &rContext, bool IsServer)
 		case SSL_ERROR_NONE:
 			// No error, handshake succeeded
 			waitingForHandshake = false;
+			if(IsSessionResumed())
+			{
+				BOX_TRACE("Resumed TLS session with " <<
+					mPeerSocketDesc);
+			}
+			if(IsKernelTLS())
+			{
+				BOX_TRACE("Kernel TLS enabled for connection "
+					"with " << mPeerSocketDesc);
+			}
 			break;
 
 		case SSL_ERROR_WANT_READ:
@@ -406,6 +426,95 @@ void SocketStreamTLS::Write(const void *pBuffer, int NBytes, int Timeout)
 	}
 }
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    SocketStreamTLS::SendFile(int, IOStream::pos_type, int)
+//		Purpose: See base class. Only possible when the kernel is
+//			 encrypting data sent on this connection, otherwise
+//			 returns false and the data must be encrypted by
+//			 OpenSSL in user space.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool SocketStreamTLS::SendFile(int FileHandle, IOStream::pos_type Length,
+	int Timeout)
+{
+	if(!mpSSL) {THROW_EXCEPTION(ServerException, TLSNoSSLObject)}
+
+#ifndef SSL_OP_ENABLE_KTLS
+	return false;
+#else
+	if(!IsKernelTLS())
+	{
+		return false;
+	}
+
+	// SSL_sendfile() doesn't move the file pointer, so start from
+	// the current position, and leave it after the data sent, as
+	// reading the file would.
+	off_t offset = ::lseek(FileHandle, 0, SEEK_CUR);
+	if(offset == -1)
+	{
+		return false;
+	}
+
+	IOStream::pos_type bytesLeft = Length;
+	box_time_t start = GetCurrentBoxTime();
+
+	while(bytesLeft > 0)
+	{
+		size_t toSend = (bytesLeft > 0x40000000)
+			? 0x40000000 : (size_t)bytesLeft;
+		ossl_ssize_t sent = ::SSL_sendfile(mpSSL, FileHandle, offset,
+			toSend, 0);
+
+		if(sent == 0)
+		{
+			// The file is shorter than the caller said
+			MarkAsWriteClosed();
+			THROW_EXCEPTION_MESSAGE(ConnectionException,
+				TLSWriteFailed, "File ended with " <<
+				bytesLeft << " of " << Length << " bytes "
+				"still to send");
+		}
+		else if(sent > 0)
+		{
+			offset += sent;
+			bytesLeft -= sent;
+			mBytesWritten += sent;
+			continue;
+		}
+
+		int se = ::SSL_get_error(mpSSL, sent);
+		if(se == SSL_ERROR_WANT_WRITE)
+		{
+			if(!WaitWhenRetryRequired(se,
+				PollTimeout(Timeout, start)))
+			{
+				THROW_EXCEPTION_MESSAGE(ConnectionException,
+					Protocol_Timeout, "Timed out waiting "
+					"to send " << bytesLeft << " of " <<
+					Length << " bytes");
+			}
+		}
+		else
+		{
+			CryptoUtils::LogError("sending file");
+			THROW_EXCEPTION(ConnectionException, TLSWriteFailed);
+		}
+	}
+
+	if(::lseek(FileHandle, offset, SEEK_SET) == -1)
+	{
+		THROW_SYS_ERROR("Failed to seek file after sending it",
+			ConnectionException, TLSWriteFailed);
+	}
+
+	return true;
+#endif // SSL_OP_ENABLE_KTLS
+}
+
 // --------------------------------------------------------------------------
 //
 // Function
@@ -448,6 +557,41 @@ void SocketStreamTLS::Shutdown(bool Read, bool Write)
 	// Don't ask the base class to shutdown -- BIO does this, apparently.
 }
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    SocketStreamTLS::IsSessionResumed()
+//		Purpose: Returns true if the handshake resumed an earlier
+//			 session, rather than exchanging certificates again
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool SocketStreamTLS::IsSessionResumed()
+{
+	if(!mpSSL) {THROW_EXCEPTION(ServerException, TLSNoSSLObject)}
+	return ::SSL_session_reused(mpSSL) != 0;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    SocketStreamTLS::IsKernelTLS()
+//		Purpose: Returns true if the kernel is encrypting the data
+//			 sent on this connection, see
+//			 TLSContext::SetKernelTLS
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+bool SocketStreamTLS::IsKernelTLS()
+{
+	if(!mpSSL) {THROW_EXCEPTION(ServerException, TLSNoSSLObject)}
+#ifdef SSL_OP_ENABLE_KTLS
+	return BIO_get_ktls_send(::SSL_get_wbio(mpSSL)) != 0;
+#else
+	return false;
+#endif
+}
+
 // --------------------------------------------------------------------------
 //
 // Function
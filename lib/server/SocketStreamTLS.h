@@ -46,10 +46,14 @@ public:
 	virtual int Read(void *pBuffer, int NBytes, int Timeout = IOStream::TimeOutInfinite);
 	virtual void Write(const void *pBuffer, int NBytes,
 		int Timeout = IOStream::TimeOutInfinite);
+	virtual bool SendFile(int FileHandle, IOStream::pos_type Length,
+		int Timeout = IOStream::TimeOutInfinite);
 	virtual void Close();
 	virtual void Shutdown(bool Read = true, bool Write = true);
 
 	std::string GetPeerCommonName();
+	bool IsSessionResumed();
+	bool IsKernelTLS();
 
 private:
 	bool WaitWhenRetryRequired(int SSLErrorCode, int Timeout);
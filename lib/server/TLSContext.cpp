@@ -9,8 +9,18 @@
 
 #include "Box.h"
 
+#include <fcntl.h>
+#include <stdio.h>
+
+#include <sstream>
+
+#ifdef HAVE_UNISTD_H
+	#include <unistd.h>
+#endif
+
 #define TLS_CLASS_IMPLEMENTATION_CPP
 #include <openssl/err.h>
+#include <openssl/pem.h>
 #include <openssl/ssl.h>
 
 #include "autogen_ConnectionException.h"
@@ -25,6 +35,9 @@
 #define MAX_VERIFICATION_DEPTH		2
 #define CIPHER_LIST			"ALL:!ADH:!LOW:!EXP:!MD5:@STRENGTH"
 
+// Sessions can only be resumed by servers with the same context ID
+#define SESSION_ID_CONTEXT		"Box Backup"
+
 // Macros to allow compatibility with OpenSSL 1.0 and 1.1 APIs. See
 // https://github.com/charybdis-ircd/charybdis/blob/release/3.5/libratbox/src/openssl_ratbox.h
 // for the gory details.
@@ -45,7 +58,8 @@
 //
 // --------------------------------------------------------------------------
 TLSContext::TLSContext()
-	: mpContext(0)
+	: mpContext(0),
+	  mpSession(0)
 {
 }
 
@@ -59,6 +73,10 @@ TLSContext::TLSContext()
 // --------------------------------------------------------------------------
 TLSContext::~TLSContext()
 {
+	if(mpSession != 0)
+	{
+		::SSL_SESSION_free(mpSession);
+	}
 	if(mpContext != 0)
 	{
 		::SSL_CTX_free(mpContext);
@@ -163,6 +181,27 @@ void TLSContext::Initialise(bool AsServer, const char *CertificatesFile, const c
 			"Failed to set cipher list to " << CIPHER_LIST << ": " <<
 				CryptoUtils::LogError("setting cipher list"));
 	}
+
+	// Allow reconnecting clients to resume their sessions, skipping the
+	// certificate exchange. Servers issue session tickets, encrypted with
+	// a key held in this context, so they work in all processes forked
+	// after this. OpenSSL won't resume sessions with client certificates
+	// unless the session ID context is set.
+	if(AsServer)
+	{
+		::SSL_CTX_set_session_id_context(mpContext,
+			(const unsigned char *)SESSION_ID_CONTEXT,
+			sizeof(SESSION_ID_CONTEXT) - 1);
+	}
+	else
+	{
+		// Sessions are kept by this object rather than OpenSSL's
+		// internal cache, so that they can be saved to a file.
+		SSL_CTX_set_app_data(mpContext, this);
+		::SSL_CTX_set_session_cache_mode(mpContext,
+			SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+		::SSL_CTX_sess_set_new_cb(mpContext, NewSessionCallback);
+	}
 }
 
 // --------------------------------------------------------------------------
@@ -182,5 +221,170 @@ SSL_CTX *TLSContext::GetRawContext() const
 	return mpContext;
 }
 
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    TLSContext::SetKernelTLS(bool)
+//		Purpose: Asks OpenSSL to hand the symmetric encryption of
+//			 connections over to the kernel once the handshake
+//			 is done, which allows SocketStreamTLS::SendFile to
+//			 send files without copying them into user space.
+//			 If the kernel or the negotiated cipher doesn't
+//			 support it, connections quietly carry on with
+//			 OpenSSL doing the encryption as usual.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void TLSContext::SetKernelTLS(bool Enabled)
+{
+	if(mpContext == 0)
+	{
+		THROW_EXCEPTION(ServerException, TLSContextNotInitialised)
+	}
+
+#ifdef SSL_OP_ENABLE_KTLS
+	if(Enabled)
+	{
+		::SSL_CTX_set_options(mpContext, SSL_OP_ENABLE_KTLS);
+	}
+	else
+	{
+		::SSL_CTX_clear_options(mpContext, SSL_OP_ENABLE_KTLS);
+	}
+#else
+	if(Enabled)
+	{
+		BOX_WARNING("KernelTLS is set, but this Box Backup is not "
+			"compiled with OpenSSL 3.0 or higher, so will be "
+			"ignored (compiled with " OPENSSL_VERSION_TEXT ")");
+	}
+#endif
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    TLSContext::SetSessionFile(const std::string &)
+//		Purpose: Sets a file in which to keep the most recent session
+//			 with the server, so that it can be resumed by
+//			 another process. Loads the session from the file,
+//			 if it exists. Client contexts only.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void TLSContext::SetSessionFile(const std::string& rFilename)
+{
+	mSessionFile = rFilename;
 
+	FILE *pFile = ::fopen(rFilename.c_str(), "r");
+	if(pFile == NULL)
+	{
+		// No session saved yet
+		return;
+	}
+
+	SSL_SESSION *pSession = ::PEM_read_SSL_SESSION(pFile, NULL, NULL,
+		NULL);
+	::fclose(pFile);
 
+	if(pSession == NULL)
+	{
+		BOX_WARNING("Ignoring invalid TLS session file: " << rFilename <<
+			": " << CryptoUtils::LogError("reading TLS session"));
+		return;
+	}
+
+	if(mpSession != 0)
+	{
+		::SSL_SESSION_free(mpSession);
+	}
+	mpSession = pSession;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    TLSContext::NewSessionCallback(SSL *, SSL_SESSION *)
+//		Purpose: Called by OpenSSL when a client receives a new
+//			 session (or session ticket) from the server.
+//			 Returns 1 to say that we keep the reference to it.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+int TLSContext::NewSessionCallback(SSL *pSSL, SSL_SESSION *pSession)
+{
+	TLSContext *pContext = (TLSContext *)
+		SSL_CTX_get_app_data(::SSL_get_SSL_CTX(pSSL));
+	pContext->SetSession(pSession);
+	return 1;
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    TLSContext::SetSession(SSL_SESSION *)
+//		Purpose: Replaces the session to be resumed by the next
+//			 connection, taking ownership of the reference.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void TLSContext::SetSession(SSL_SESSION *pSession)
+{
+	if(mpSession != 0)
+	{
+		::SSL_SESSION_free(mpSession);
+	}
+	mpSession = pSession;
+
+	if(!mSessionFile.empty())
+	{
+		SaveSession();
+	}
+}
+
+// --------------------------------------------------------------------------
+//
+// Function
+//		Name:    TLSContext::SaveSession()
+//		Purpose: Writes the current session to the session file.
+//			 It contains the session's secret key, so only the
+//			 owner can read it. Failure isn't fatal: the next
+//			 connection just does a full handshake.
+//		Created: 2026/10/19
+//
+// --------------------------------------------------------------------------
+void TLSContext::SaveSession()
+{
+	// Forked children (such as staged uploads) may save their sessions
+	// at the same time, so each process needs its own temporary file.
+	std::ostringstream tempFileBuf;
+	tempFileBuf << mSessionFile << "." << (int)::getpid() << ".new";
+	std::string tempFile = tempFileBuf.str();
+	int fd = ::open(tempFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC |
+		O_BINARY, S_IRUSR | S_IWUSR);
+	FILE *pFile = (fd == -1) ? NULL : ::fdopen(fd, "w");
+	if(pFile == NULL)
+	{
+		BOX_INFO(BOX_SYS_ERROR_MESSAGE("Failed to save TLS session "
+			"to " << tempFile));
+		if(fd != -1)
+		{
+			::close(fd);
+		}
+		return;
+	}
+
+	bool written = (::PEM_write_SSL_SESSION(pFile, mpSession) == 1);
+	written = (::fclose(pFile) == 0) && written;
+
+#ifdef WIN32
+	// Can't rename over an existing file on Windows
+	::unlink(mSessionFile.c_str());
+#endif
+
+	if(!written || ::rename(tempFile.c_str(), mSessionFile.c_str()) != 0)
+	{
+		BOX_INFO("Failed to save TLS session to " << mSessionFile);
+		::unlink(tempFile.c_str());
+	}
+}
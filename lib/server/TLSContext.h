@@ -10,8 +10,12 @@
 #ifndef TLSCONTEXT__H
 #define TLSCONTEXT__H
 
+#include <string>
+
 #ifndef TLS_CLASS_IMPLEMENTATION_CPP
+	class SSL;
 	class SSL_CTX;
+	class SSL_SESSION;
 #endif
 
 // --------------------------------------------------------------------------
@@ -34,8 +38,21 @@ public:
 		const char *TrustedCAsFile, int SSLSecurityLevel = -1);
 	SSL_CTX *GetRawContext() const;
 
+	// Client side session resumption
+	void SetSessionFile(const std::string& rFilename);
+	SSL_SESSION *GetSession() const {return mpSession;}
+
+	// Kernel TLS offload, for connections made after this is called
+	void SetKernelTLS(bool Enabled);
+
 private:
+	static int NewSessionCallback(SSL *pSSL, SSL_SESSION *pSession);
+	void SetSession(SSL_SESSION *pSession);
+	void SaveSession();
+
 	SSL_CTX *mpContext;
+	SSL_SESSION *mpSession;
+	std::string mSessionFile;
 };
 
 #endif // TLSCONTEXT__H
@@ -12,6 +12,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef HAVE_SYS_TIME_H
+	#include <sys/time.h>
+#endif
+
 #include "Archive.h"
 #include "BackupClientCryptoKeys.h"
 #include "BackupClientFileAttributes.h"
@@ -25,6 +29,7 @@
 #include "BackupStoreFile.h"
 #include "BackupStoreFilenameClear.h"
 #include "BackupStoreFileEncodeStream.h"
+#include "BackupStoreFileWire.h"
 #include "BackupStoreInfo.h"
 #include "BackupStoreObjectMagic.h"
 #include "BackupStoreRefCountDatabase.h"
@@ -32,11 +37,15 @@
 #include "CollectInBufferStream.h"
 #include "Configuration.h"
 #include "FileStream.h"
+#include "HTTPRequest.h"
+#include "HTTPResponse.h"
 #include "HousekeepStoreAccount.h"
+#include "IOStreamGetLine.h"
 #include "MemBlockStream.h"
 #include "RaidFileController.h"
 #include "RaidFileException.h"
 #include "RaidFileRead.h"
+#include "RaidFileUtil.h"
 #include "RaidFileWrite.h"
 #include "SSLLib.h"
 #include "ServerControl.h"
@@ -2276,6 +2285,422 @@ bool test_cannot_open_multiple_writable_connections()
 	TEARDOWN_TEST_BACKUPSTORE();
 }
 
+bool test_staged_uploads()
+{
+	SETUP_TEST_BACKUPSTORE();
+
+	BackupProtocolLocal2 protocolWritable(0x01234567, "test",
+		"backup/01234567/", 0, false); // Not read-only
+	BackupProtocolLocal2 protocolReadOnly(0x01234567, "test",
+		"backup/01234567/", 0, true); // Read-only
+
+	write_test_file(0);
+	std::string filename("testfiles/test0");
+	BackupStoreFilenameClear remote_filename("staged");
+	int64_t modtime;
+	std::auto_ptr<IOStream> upload(BackupStoreFile::EncodeFile(filename,
+		BACKUPSTORE_ROOT_DIRECTORY_ID, remote_filename, &modtime));
+
+	// A read-only session can stage a file, but not add it to the store
+	int64_t staging_id =
+		protocolReadOnly.QueryStageFile(upload)->GetObjectID();
+	TEST_THAT(staging_id != 0);
+	TEST_COMMAND_RETURNS_ERROR(protocolReadOnly,
+		QueryStoreStagedFile(BACKUPSTORE_ROOT_DIRECTORY_ID, modtime,
+			modtime, 0, staging_id, remote_filename),
+		Err_SessionReadOnly);
+
+	std::string staged_fn;
+	StoreStructure::MakeStagingFilename(staging_id, "backup/01234567/",
+		0, staged_fn);
+	TEST_THAT(FileExists(staged_fn));
+
+	// The writer adds it, which deletes the staged file
+	int64_t file_id = protocolWritable.QueryStoreStagedFile(
+		BACKUPSTORE_ROOT_DIRECTORY_ID, modtime, modtime, 0, staging_id,
+		remote_filename)->GetObjectID();
+	TEST_THAT(file_id != 0);
+	set_refcount(file_id, 1);
+	TEST_THAT(!FileExists(staged_fn));
+
+	// And it can be downloaded like any other file
+	protocolWritable.QueryGetFile(BACKUPSTORE_ROOT_DIRECTORY_ID, file_id);
+	{
+		std::auto_ptr<IOStream> filestream(protocolWritable.ReceiveStream());
+		UNLINK_IF_EXISTS("testfiles/staged_retrieved");
+		BackupStoreFile::DecodeFile(*filestream,
+			"testfiles/staged_retrieved", IOStream::TimeOutInfinite);
+	}
+
+	// It can't be added twice
+	TEST_COMMAND_RETURNS_ERROR(protocolWritable,
+		QueryStoreStagedFile(BACKUPSTORE_ROOT_DIRECTORY_ID, modtime,
+			modtime, 0, staging_id, remote_filename),
+		Err_DoesNotExist);
+
+	// Garbage doesn't get staged at all
+	{
+		std::auto_ptr<IOStream> garbage(new ZeroStream(4096));
+		TEST_COMMAND_RETURNS_ERROR(protocolReadOnly,
+			QueryStageFile(garbage), Err_FileDoesNotVerify);
+	}
+
+	// A staged file which is never added survives the next read/write
+	// login, so that it can still be added or resumed, unless nothing
+	// has been written to it for a long time.
+	upload = BackupStoreFile::EncodeFile(filename,
+		BACKUPSTORE_ROOT_DIRECTORY_ID, remote_filename, &modtime);
+	staging_id = protocolReadOnly.QueryStageFile(upload)->GetObjectID();
+	StoreStructure::MakeStagingFilename(staging_id, "backup/01234567/",
+		0, staged_fn);
+	TEST_THAT(FileExists(staged_fn));
+	protocolReadOnly.QueryFinished();
+	protocolWritable.QueryFinished();
+
+	{
+		BackupProtocolLocal2 protocolWritable2(0x01234567, "test",
+			"backup/01234567/", 0, false); // Not read-only
+		TEST_THAT(FileExists(staged_fn));
+		protocolWritable2.QueryFinished();
+	}
+
+	struct timeval times[2] = {};
+	times[0].tv_sec = time(NULL) - BACKUP_STORE_STAGED_FILE_MAX_AGE - 60;
+	times[1].tv_sec = times[0].tv_sec;
+	TEST_THAT(::utimes(staged_fn.c_str(), times) == 0);
+
+	{
+		BackupProtocolLocal2 protocolWritable2(0x01234567, "test",
+			"backup/01234567/", 0, false); // Not read-only
+		TEST_THAT(!FileExists(staged_fn));
+		protocolWritable2.QueryFinished();
+	}
+
+	TEARDOWN_TEST_BACKUPSTORE();
+}
+
+// Checks that files committed in a sync group can be used straight away,
+// although they aren't put in place until the group is synced, and that
+// storing several in a directory doesn't sync it each time.
+bool test_sync_group_uploads()
+{
+	SETUP_TEST_BACKUPSTORE();
+
+	{
+		BackupStoreContext context(0x01234567,
+			(HousekeepingInterface *)NULL, "test");
+		context.SetSyncGroupSize(100);
+		context.SetClientHasAccount("backup/01234567/", 0);
+		BackupProtocolLocal protocol(context);
+		protocol.QueryVersion(BACKUP_STORE_SERVER_VERSION);
+		protocol.QueryLogin(0x01234567, 0);
+
+		write_test_file(0);
+		std::vector<int64_t> ids;
+		for(int i = 0; i < 5; i++)
+		{
+			std::ostringstream name;
+			name << "synced" << i;
+			BackupStoreFilenameClear remote_filename(name.str());
+			std::auto_ptr<IOStream> upload(
+				BackupStoreFile::EncodeFile("testfiles/test0",
+					BACKUPSTORE_ROOT_DIRECTORY_ID,
+					remote_filename));
+			ids.push_back(protocol.QueryStoreFile(
+				BACKUPSTORE_ROOT_DIRECTORY_ID, 0x123456789abcdefLL,
+				0x7362383249872dfLL, 0, remote_filename,
+				upload)->GetObjectID());
+			set_refcount(ids.back(), 1);
+		}
+		TEST_EQUAL(0, context.GetNumSyncs());
+
+		// Listed from the cached directory, without syncing
+		protocol.QueryListDirectory(BACKUPSTORE_ROOT_DIRECTORY_ID,
+			BackupProtocolListDirectory::Flags_INCLUDE_EVERYTHING,
+			BackupProtocolListDirectory::Flags_EXCLUDE_NOTHING,
+			false /* no attributes */);
+		{
+			BackupStoreDirectory dir(protocol.ReceiveStream(),
+				SHORT_TIMEOUT);
+			TEST_EQUAL(5, dir.GetNumberOfEntries());
+		}
+		TEST_EQUAL(0, context.GetNumSyncs());
+
+		// Reading a file puts the group in place first
+		protocol.QueryGetFile(BACKUPSTORE_ROOT_DIRECTORY_ID, ids[4]);
+		{
+			std::auto_ptr<IOStream> filestream(
+				protocol.ReceiveStream());
+			UNLINK_IF_EXISTS("testfiles/synced_retrieved");
+			BackupStoreFile::DecodeFile(*filestream,
+				"testfiles/synced_retrieved",
+				IOStream::TimeOutInfinite);
+		}
+		TEST_EQUAL(1, context.GetNumSyncs());
+		TEST_THAT(check_files_same("testfiles/test0",
+			"testfiles/synced_retrieved"));
+
+		protocol.QueryFinished();
+		context.ReleaseWriteLock();
+	}
+
+	// And another session finds them all
+	{
+		BackupProtocolLocal2 protocolReadOnly(0x01234567, "test",
+			"backup/01234567/", 0, true); // Read-only
+		protocolReadOnly.QueryListDirectory(
+			BACKUPSTORE_ROOT_DIRECTORY_ID,
+			BackupProtocolListDirectory::Flags_INCLUDE_EVERYTHING,
+			BackupProtocolListDirectory::Flags_EXCLUDE_NOTHING,
+			false /* no attributes */);
+		BackupStoreDirectory dir(protocolReadOnly.ReceiveStream(),
+			SHORT_TIMEOUT);
+		TEST_EQUAL(5, dir.GetNumberOfEntries());
+		protocolReadOnly.QueryFinished();
+	}
+
+	TEARDOWN_TEST_BACKUPSTORE();
+}
+
+bool test_resumable_uploads()
+{
+	SETUP_TEST_BACKUPSTORE();
+
+	BackupProtocolLocal2 protocol(0x01234567, "test",
+		"backup/01234567/", 0, true); // Read-only
+
+	// A file big enough to have lots of blocks, which don't compress
+	std::string filename("testfiles/resumable");
+	{
+		FileStream out(filename, O_WRONLY | O_CREAT | O_TRUNC);
+		uint32_t data[1024];
+		uint32_t seed = 1234;
+		for(int b = 0; b < 256; b++)
+		{
+			for(int i = 0; i < 1024; i++)
+			{
+				seed = seed * 1103515245 + 12345;
+				data[i] = seed;
+			}
+			out.Write(data, sizeof(data));
+		}
+	}
+
+	BackupStoreFilenameClear remote_filename("resumable");
+	int64_t modtime;
+	std::auto_ptr<BackupStoreFileEncodeStream> apEncoded =
+		BackupStoreFile::EncodeFile(filename,
+			BACKUPSTORE_ROOT_DIRECTORY_ID, remote_filename,
+			&modtime);
+	CollectInBufferStream encoded;
+	apEncoded->CopyStreamTo(encoded);
+	encoded.SetForReading();
+	TEST_THAT(encoded.GetSize() > 1024 * 1024);
+
+	// Unknown staged files are reported as such
+	TEST_COMMAND_RETURNS_ERROR(protocol, QueryGetStagedFileSize(1234),
+		Err_DoesNotExist);
+
+	// A staged file created with a resume key can be found again later
+	int64_t resume_key = 0x123456789abcdefLL;
+	int64_t staging_id = protocol.QueryCreateStagedFile(resume_key,
+		1)->GetObjectID();
+	TEST_THAT(staging_id != 0);
+	TEST_EQUAL(0, protocol.QueryGetStagedFileSize(staging_id)->GetSize());
+
+	// Pretend that the connection was lost part way through, leaving
+	// part of a block at the end of what the server received.
+	std::string staged_fn;
+	StoreStructure::MakeStagingFilename(staging_id, "backup/01234567/",
+		0, staged_fn);
+	int64_t received = encoded.GetSize() / 2;
+	{
+		FileStream partial(staged_fn, O_WRONLY | O_BINARY);
+		partial.Write(encoded.GetBuffer(), received);
+	}
+	TEST_EQUAL(received,
+		protocol.QueryGetStagedFileSize(staging_id)->GetSize());
+
+	// Another session, for example after the client restarts, finds the
+	// same staged file with the same key, and what's been received so
+	// far is kept if the check is the same.
+	protocol.QueryFinished();
+	BackupProtocolLocal2 protocol2(0x01234567, "test",
+		"backup/01234567/", 0, true); // Read-only
+	TEST_EQUAL(staging_id, protocol2.QueryCreateStagedFile(resume_key,
+		1)->GetObjectID());
+	TEST_EQUAL(received,
+		protocol2.QueryGetStagedFileSize(staging_id)->GetSize());
+
+	// But not if the check has changed, as the file has
+	{
+		int64_t other_id = protocol2.QueryCreateStagedFile(resume_key,
+			2)->GetObjectID();
+		TEST_EQUAL(staging_id, other_id);
+		TEST_EQUAL(0,
+			protocol2.QueryGetStagedFileSize(staging_id)->GetSize());
+		FileStream partial(staged_fn, O_WRONLY | O_BINARY);
+		partial.Write(encoded.GetBuffer(), received);
+	}
+	TEST_EQUAL(staging_id, protocol2.QueryCreateStagedFile(resume_key,
+		1)->GetObjectID());
+	TEST_EQUAL(0, protocol2.QueryGetStagedFileSize(staging_id)->GetSize());
+	{
+		FileStream partial(staged_fn, O_WRONLY | O_BINARY);
+		partial.Write(encoded.GetBuffer(), received);
+	}
+
+	// Different keys find different files
+	int64_t other_id = protocol2.QueryCreateStagedFile(resume_key + 1,
+		1)->GetObjectID();
+	TEST_THAT(other_id != staging_id);
+	TEST_EQUAL(0, protocol2.QueryGetStagedFileSize(other_id)->GetSize());
+	TEST_EQUAL(received,
+		protocol2.QueryGetStagedFileSize(staging_id)->GetSize());
+
+	std::string check_fn;
+	StoreStructure::MakeStagingCheckFilename(staged_fn, check_fn);
+	TEST_THAT(FileExists(check_fn));
+
+	// Can't resume from beyond the end of what was received
+	{
+		std::auto_ptr<IOStream> rest(new ZeroStream(1));
+		TEST_COMMAND_RETURNS_ERROR(protocol2,
+			QueryResumeStagedFile(staging_id, received + 1, rest),
+			Err_BadStagedFileOffset);
+	}
+
+	// Encoding the file again skips to a block boundary within what
+	// the server has, and the rest of the stream completes the file.
+	apEncoded = BackupStoreFile::EncodeFile(filename,
+		BACKUPSTORE_ROOT_DIRECTORY_ID, remote_filename, &modtime);
+	int64_t offset = apEncoded->SkipToBlockBoundary(received);
+	TEST_THAT(offset > 0);
+	TEST_THAT(offset <= received);
+	TEST_THAT(offset > received - BACKUP_FILE_MAX_BLOCK_SIZE - 1024);
+
+	std::auto_ptr<IOStream> upload(apEncoded.release());
+	TEST_EQUAL(staging_id, protocol2.QueryResumeStagedFile(staging_id,
+		offset, upload)->GetObjectID());
+	TEST_EQUAL(encoded.GetSize(),
+		protocol2.QueryGetStagedFileSize(staging_id)->GetSize());
+	protocol2.QueryFinished();
+
+	// Add it to the store, and check that it decodes to the original
+	{
+		BackupProtocolLocal2 protocolWritable(0x01234567, "test",
+			"backup/01234567/", 0, false); // Not read-only
+		int64_t file_id = protocolWritable.QueryStoreStagedFile(
+			BACKUPSTORE_ROOT_DIRECTORY_ID, modtime, modtime, 0,
+			staging_id, remote_filename)->GetObjectID();
+		set_refcount(file_id, 1);
+
+		protocolWritable.QueryGetFile(BACKUPSTORE_ROOT_DIRECTORY_ID,
+			file_id);
+		std::auto_ptr<IOStream> filestream(protocolWritable.ReceiveStream());
+		UNLINK_IF_EXISTS("testfiles/resumable_retrieved");
+		BackupStoreFile::DecodeFile(*filestream,
+			"testfiles/resumable_retrieved", IOStream::TimeOutInfinite);
+		TEST_THAT(FileExists("testfiles/resumable_retrieved"));
+		FileStream original(filename);
+		FileStream retrieved("testfiles/resumable_retrieved");
+		TEST_THAT(original.CompareWith(retrieved));
+		protocolWritable.QueryFinished();
+	}
+
+	// Its check was deleted along with it
+	TEST_THAT(!FileExists(staged_fn));
+	TEST_THAT(!FileExists(check_fn));
+
+	TEARDOWN_TEST_BACKUPSTORE();
+}
+
+bool test_staged_file_limits()
+{
+	SETUP_TEST_BACKUPSTORE();
+
+	write_test_file(0);
+	std::string filename("testfiles/test0");
+	BackupStoreFilenameClear remote_filename("staged");
+	int64_t modtime;
+	CollectInBufferStream encoded;
+	{
+		std::auto_ptr<IOStream> upload(BackupStoreFile::EncodeFile(
+			filename, BACKUPSTORE_ROOT_DIRECTORY_ID,
+			remote_filename, &modtime));
+		upload->CopyStreamTo(encoded);
+		encoded.SetForReading();
+	}
+
+	RaidFileDiscSet &rdiscSet(RaidFileController::GetController()
+		.GetDiscSet(0));
+	int64_t file_blocks = RaidFileUtil::DiscUsageInBlocks(
+		encoded.GetSize(), rdiscSet);
+
+	// Leave room for one copy of the file in the account, but not two
+	{
+		std::auto_ptr<BackupStoreInfo> info(BackupStoreInfo::Load(
+			0x1234567, "backup/01234567/", 0, false));
+		info->ChangeLimits(info->GetBlocksUsed() + file_blocks * 2 - 1,
+			info->GetBlocksUsed() + file_blocks * 2 - 1);
+		info->Save();
+	}
+
+	BackupProtocolLocal2 protocol(0x01234567, "test",
+		"backup/01234567/", 0, true); // Read-only
+	std::auto_ptr<IOStream> upload(new MemBlockStream(encoded));
+	int64_t first_id = protocol.QueryStageFile(upload)->GetObjectID();
+	TEST_THAT(first_id != 0);
+
+	// The first staged file counts against the limit, although it hasn't
+	// been added to the store, so a second copy doesn't fit.
+	upload.reset(new MemBlockStream(encoded));
+	TEST_COMMAND_RETURNS_ERROR(protocol, QueryStageFile(upload),
+		Err_StorageLimitExceeded);
+
+	// And neither does one which is much bigger than the limit, although
+	// it's not a valid file, and it's not all kept on disc.
+	int64_t staging_id = protocol.QueryCreateStagedFile(0, 0)->GetObjectID();
+	upload.reset(new ZeroStream(encoded.GetSize() * 10));
+	TEST_COMMAND_RETURNS_ERROR(protocol,
+		QueryResumeStagedFile(staging_id, 0, upload),
+		Err_StorageLimitExceeded);
+	TEST_COMMAND_RETURNS_ERROR(protocol,
+		QueryGetStagedFileSize(staging_id), Err_DoesNotExist);
+
+	// The connection is still usable afterwards
+	TEST_EQUAL(encoded.GetSize(),
+		protocol.QueryGetStagedFileSize(first_id)->GetSize());
+
+	// Only a limited number of staged files can be created at once
+	for(int i = 1; i < BACKUP_STORE_MAX_STAGED_FILES; i++)
+	{
+		TEST_THAT(protocol.QueryCreateStagedFile(0, 0)->GetObjectID() != 0);
+	}
+	TEST_COMMAND_RETURNS_ERROR(protocol, QueryCreateStagedFile(0, 0),
+		Err_StorageLimitExceeded);
+	upload.reset(new MemBlockStream(encoded));
+	TEST_COMMAND_RETURNS_ERROR(protocol, QueryStageFile(upload),
+		Err_StorageLimitExceeded);
+	protocol.QueryFinished();
+
+	// Once the first one has been added, the others (which are empty) can
+	// be written to, and another can be created.
+	{
+		BackupProtocolLocal2 protocolWritable(0x01234567, "test",
+			"backup/01234567/", 0, false); // Not read-only
+		int64_t file_id = protocolWritable.QueryStoreStagedFile(
+			BACKUPSTORE_ROOT_DIRECTORY_ID, modtime, modtime, 0,
+			first_id, remote_filename)->GetObjectID();
+		set_refcount(file_id, 1);
+		TEST_THAT(protocolWritable.QueryCreateStagedFile(0, 0)->GetObjectID()
+			!= 0);
+		protocolWritable.QueryFinished();
+	}
+
+	TEARDOWN_TEST_BACKUPSTORE();
+}
+
 bool test_encoding()
 {
 	// Now test encoded files
@@ -2403,6 +2828,41 @@ bool test_encoding()
 					break;
 				}
 			}
+
+			// Every verify level accepts the good file
+			for(int level = BackupStoreFile::VerifyLevel_Headers;
+				level <= BackupStoreFile::VerifyLevel_AllData; level++)
+			{
+				enc.Seek(0, IOStream::SeekType_Absolute);
+				TEST_THAT(BackupStoreFile::VerifyEncodedFileFormat(enc,
+					NULL, NULL, (BackupStoreFile::VerifyLevel)level));
+			}
+
+			// Find the first block, after the header, filename and
+			// attributes, and give it an unknown encoding. Only a deep
+			// check, which reads all the data, should notice.
+			MemBlockStream parse(contents.GetBuffer(), contents.GetSize());
+			file_StreamFormat hdr;
+			TEST_THAT(parse.ReadFullBuffer(&hdr, sizeof(hdr), NULL));
+			BackupStoreFilename fn;
+			fn.ReadFromStream(parse, IOStream::TimeOutInfinite);
+			int32_t attr_size;
+			TEST_THAT(parse.ReadFullBuffer(&attr_size, sizeof(attr_size),
+				NULL));
+			int first_block = parse.GetPosition() + ntohl(attr_size);
+
+			std::vector<uint8_t> corrupt((uint8_t *)contents.GetBuffer(),
+				(uint8_t *)contents.GetBuffer() + contents.GetSize());
+			corrupt[first_block] = 0xfe;
+			MemBlockStream bad(&corrupt[0], corrupt.size());
+			TEST_THAT(BackupStoreFile::VerifyEncodedFileFormat(bad,
+				NULL, NULL, BackupStoreFile::VerifyLevel_Headers));
+			bad.Seek(0, IOStream::SeekType_Absolute);
+			TEST_THAT(BackupStoreFile::VerifyEncodedFileFormat(bad,
+				NULL, NULL, BackupStoreFile::VerifyLevel_BlockIndex));
+			bad.Seek(0, IOStream::SeekType_Absolute);
+			TEST_THAT(!BackupStoreFile::VerifyEncodedFileFormat(bad,
+				NULL, NULL, BackupStoreFile::VerifyLevel_AllData));
 		}
 
 		// Decode it
@@ -2578,6 +3038,120 @@ bool test_login_without_account()
 	TEARDOWN_TEST_BACKUPSTORE();
 }
 
+bool metrics_contain(const std::string& rText, const std::string& rLine)
+{
+	if(rText.find(rLine + "\n") != std::string::npos)
+	{
+		return true;
+	}
+	BOX_WARNING("Expected metric not found: " << rLine << "\n" << rText);
+	return false;
+}
+
+bool test_metrics_endpoint()
+{
+	SETUP_TEST_BACKUPSTORE();
+	delete_account();
+	TEST_THAT_OR(StartServer(), FAIL);
+
+	// BLOCK
+	{
+		BackupProtocolClient protocol(open_conn("localhost", context));
+		protocol.QueryVersion(BACKUP_STORE_SERVER_VERSION);
+		TEST_COMMAND_RETURNS_ERROR(protocol, QueryLogin(0x01234567, 0),
+			Err_BadLogin);
+		protocol.QueryFinished();
+	}
+
+	// The child process handling that connection recorded its
+	// commands before replying, so the server knows about them now
+	{
+		SocketStream sock;
+		sock.Open(Socket::TypeINET, "localhost", 22012);
+		IOStreamGetLine getLine(sock);
+		HTTPRequest request(HTTPRequest::Method_GET, "/metrics");
+		request.Send(sock, SHORT_TIMEOUT);
+		HTTPResponse response;
+		response.Receive(getLine, SHORT_TIMEOUT);
+		TEST_EQUAL(200, response.GetResponseCode());
+		TEST_EQUAL("text/plain; version=0.0.4",
+			response.GetContentType());
+
+		std::string text((const char *)response.GetBuffer(),
+			response.GetSize());
+		TEST_THAT(metrics_contain(text,
+			"# TYPE bbstored_command_duration_seconds histogram"));
+		TEST_THAT(metrics_contain(text,
+			"bbstored_command_duration_seconds_count"
+			"{command=\"Version\"} 1"));
+		TEST_THAT(metrics_contain(text,
+			"bbstored_command_duration_seconds_count"
+			"{command=\"Login\"} 1"));
+		TEST_THAT(metrics_contain(text,
+			"bbstored_command_errors_total{error=\"Err_BadLogin\"} 1"));
+	}
+
+	{
+		SocketStream sock;
+		sock.Open(Socket::TypeINET, "localhost", 22012);
+		IOStreamGetLine getLine(sock);
+		HTTPRequest request(HTTPRequest::Method_GET, "/other");
+		request.Send(sock, SHORT_TIMEOUT);
+		HTTPResponse response;
+		response.Receive(getLine, SHORT_TIMEOUT);
+		TEST_EQUAL(404, response.GetResponseCode());
+	}
+
+	// A client which sends its request too slowly is disconnected, even
+	// if it never takes long to send any one line of it, because the
+	// server stops accepting backup connections while it waits.
+	{
+		SocketStream sock;
+		sock.Open(Socket::TypeINET, "localhost", 22012);
+		std::string start("GET /metrics HTTP/1.1\r\nX-Slow: ");
+		sock.Write(start.c_str(), start.size());
+		box_time_t started = GetCurrentBoxTime();
+		bool closed = false;
+
+		try
+		{
+			for(int i = 0; i < 50 && !closed; i++)
+			{
+				sock.Write("x", 1);
+				char byte;
+				if(sock.Read(&byte, 1, 100) == 0 &&
+					!sock.StreamDataLeft())
+				{
+					closed = true;
+				}
+			}
+		}
+		catch(BoxException &e)
+		{
+			// Reset by the server
+			closed = true;
+		}
+
+		TEST_THAT(closed);
+		TEST_THAT(GetCurrentBoxTime() - started <
+			(box_time_t)SecondsToBoxTime(3));
+	}
+
+	// And it's still serving metrics afterwards
+	{
+		SocketStream sock;
+		sock.Open(Socket::TypeINET, "localhost", 22012);
+		IOStreamGetLine getLine(sock);
+		HTTPRequest request(HTTPRequest::Method_GET, "/metrics");
+		request.Send(sock, SHORT_TIMEOUT);
+		HTTPResponse response;
+		response.Receive(getLine, SHORT_TIMEOUT);
+		TEST_EQUAL(200, response.GetResponseCode());
+	}
+
+	TEARDOWN_TEST_BACKUPSTORE();
+}
+
 bool test_bbstoreaccounts_create()
 {
 	SETUP_TEST_BACKUPSTORE();
@@ -3295,6 +3869,10 @@ int test(int argc, const char *argv[])
 	TEST_THAT(test_backupstore_directory());
 	TEST_THAT(test_directory_parent_entry_tracks_directory_size());
 	TEST_THAT(test_cannot_open_multiple_writable_connections());
+	TEST_THAT(test_staged_uploads());
+	TEST_THAT(test_sync_group_uploads());
+	TEST_THAT(test_resumable_uploads());
+	TEST_THAT(test_staged_file_limits());
 	TEST_THAT(test_encoding());
 	TEST_THAT(test_symlinks());
 	TEST_THAT(test_store_info());
@@ -3302,6 +3880,7 @@ int test(int argc, const char *argv[])
 	init_context(context);
 
 	TEST_THAT(test_login_without_account());
+	TEST_THAT(test_metrics_endpoint());
 	TEST_THAT(test_login_with_disabled_account());
 	TEST_THAT(test_login_with_no_refcount_db());
 	TEST_THAT(test_server_housekeeping());
@@ -13,8 +13,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <string>
 #include <map>
+#include <sstream>
+#include <string>
 
 #include "Test.h"
 #include "BackupClientCryptoKeys.h"
@@ -76,7 +77,7 @@ std::map<std::string, int32_t> nameToID;
 std::map<int32_t, bool> objectIsDir;
 
 #define RUN_CHECK	\
-	::system(BBSTOREACCOUNTS " -c testfiles/bbstored.conf check 01234567"); \
+	::system(BBSTOREACCOUNTS " -c testfiles/bbstored.conf check 01234567 workers=3"); \
 	::system(BBSTOREACCOUNTS " -c testfiles/bbstored.conf check 01234567 fix");
 
 // Get ID of an object given a filename
@@ -90,7 +91,7 @@ int32_t getID(const char *name)
 }
 
 // Get the RAID filename of an object
-std::string getObjectName(int32_t id)
+std::string getObjectName(int64_t id)
 {
 	std::string fn;
 	StoreStructure::MakeObjectFilename(id, accountRootDir, discSetNum, fn, false);
@@ -205,6 +206,233 @@ void check_dir_dep(BackupStoreDirectory &dir, checkdepinfoen *ck)
 	TEST_THAT(ck->id == -1);
 }
 
+// Check the store without fixing anything, using the given number of worker
+// processes, and return the number of errors found
+int64_t count_errors(int NumWorkers)
+{
+	BackupStoreCheck check(accountRootDir, discSetNum, 0x01234567,
+		false /* don't fix */, true /* quiet */, NumWorkers);
+	check.Check();
+	return check.GetNumErrorsFound();
+}
+
+// Checking with several worker processes must find exactly the same errors.
+// Add some extra objects first, so that there are several object directories
+// to share between the workers, and remove them again afterwards.
+void test_check_with_workers()
+{
+	std::vector<int64_t> extra_ids;
+	for(int64_t id = 0x100; id <= 0x700; id += 0x100)
+	{
+		extra_ids.push_back(id);
+	}
+	extra_ids.push_back(0x345);
+
+	for(size_t i = 0; i < extra_ids.size(); i++)
+	{
+		std::string fn;
+		StoreStructure::MakeObjectFilename(extra_ids[i],
+			accountRootDir, discSetNum, fn,
+			true /* make sure the dir exists */);
+		RaidFileWrite w(discSetNum, fn);
+		w.Open(true /* allow overwrite */);
+		if(i % 3 == 2)
+		{
+			// Corrupt
+			w.Write("rubbish", 7);
+		}
+		else
+		{
+			std::auto_ptr<RaidFileRead> r(RaidFileRead::Open(
+				discSetNum, getObjectName(getID(
+				"Test1/pass/shuted/brightinats/"
+				"milamptimaskates"))));
+			r->CopyStreamTo(w);
+		}
+		w.Commit(true /* convert now */);
+	}
+
+	int64_t errors = count_errors(1);
+	TEST_THAT(errors > (int64_t)extra_ids.size());
+	TEST_EQUAL(errors, count_errors(2));
+	TEST_EQUAL(errors, count_errors(5));
+
+	for(size_t i = 0; i < extra_ids.size(); i++)
+	{
+		RaidFileWrite del(discSetNum, getObjectName(extra_ids[i]));
+		del.Delete();
+	}
+}
+
+// Copies a file object, changing the container ID in its header, and
+// making its last block bigger by ExtraSize bytes, which still passes the
+// check's verification of its block index.
+void write_modified_file(int64_t SourceID, int64_t DestID, int64_t ContainerID,
+	int64_t ExtraSize)
+{
+	std::auto_ptr<RaidFileRead> r(RaidFileRead::Open(discSetNum,
+		getObjectName(SourceID)));
+	BackupStoreFile::MoveStreamPositionToBlockIndex(*r);
+	int64_t indexStart = r->GetPosition();
+	r->Seek(0, IOStream::SeekType_Absolute);
+
+	std::string fn;
+	StoreStructure::MakeObjectFilename(DestID, accountRootDir, discSetNum,
+		fn, true /* make sure the dir exists */);
+	RaidFileWrite w(discSetNum, fn);
+	w.Open(true /* allow overwrite */);
+
+	file_StreamFormat hdr;
+	TEST_THAT(r->ReadFullBuffer(&hdr, sizeof(hdr), 0));
+	hdr.mContainerID = box_hton64(ContainerID);
+	w.Write(&hdr, sizeof(hdr));
+
+	// The rest of the header and the blocks, with zeros added to the
+	// last one
+	char buf[2048];
+	for(int64_t left = indexStart - sizeof(hdr); left > 0; )
+	{
+		int bytes = (left > (int64_t)sizeof(buf)) ? sizeof(buf) : left;
+		TEST_THAT(r->ReadFullBuffer(buf, bytes, 0));
+		w.Write(buf, bytes);
+		left -= bytes;
+	}
+	ZeroStream zeros(ExtraSize);
+	zeros.CopyStreamTo(w);
+
+	// The block index, with the last block's new size
+	file_BlockIndexHeader indexHdr;
+	TEST_THAT(r->ReadFullBuffer(&indexHdr, sizeof(indexHdr), 0));
+	w.Write(&indexHdr, sizeof(indexHdr));
+	int64_t numBlocks = box_ntoh64(indexHdr.mNumBlocks);
+	for(int64_t b = 0; b < numBlocks; b++)
+	{
+		file_BlockIndexEntry entry;
+		TEST_THAT(r->ReadFullBuffer(&entry, sizeof(entry), 0));
+		if(b == numBlocks - 1)
+		{
+			int64_t size = box_ntoh64(entry.mEncodedSize);
+			TEST_THAT(size > 0);
+			entry.mEncodedSize = box_hton64(size + ExtraSize);
+		}
+		w.Write(&entry, sizeof(entry));
+	}
+
+	r->Close();
+	w.Commit(true /* convert now */);
+}
+
+// The check's ID table keeps sizes of 0xffff blocks or more, and container
+// IDs more than 2^31 away from their objects, outside its blocks. Make sure
+// that objects which need them are checked and fixed like any others.
+void test_check_large_ids_and_sizes()
+{
+	int64_t sourceID = getID("Test1/pass/shuted/brightinats/"
+		"milamptimaskates");
+	int64_t containerID = getID("Test1/pass/shuted/brightinats");
+	std::auto_ptr<BackupProtocolAccountUsage2> before =
+		BackupProtocolLocal2(0x01234567, "test", "backup/01234567/", 0,
+			false).QueryGetAccountUsage2();
+
+	// A file too big for the ID table, in its right place. Its ID is far
+	// enough from the others to need a new block in the table too.
+	int64_t largeFileID = 0x12345;
+	write_modified_file(sourceID, largeFileID, containerID,
+		96 * 1024 * 1024);
+	int64_t largeFileBlocks = RaidFileRead::Open(discSetNum,
+		getObjectName(largeFileID))->GetDiscUsageInBlocks();
+	TEST_THAT(largeFileBlocks > BACKUPSTORECHECK_LARGE_SIZE);
+
+	{
+		BackupStoreDirectory dir;
+		LoadDirectory("Test1/pass/shuted/brightinats", dir);
+		dir.AddEntry(BackupStoreFilenameClear("large-file"), 12,
+			largeFileID, largeFileBlocks,
+			BackupStoreDirectory::Entry::Flags_File, 2);
+		SaveDirectory("Test1/pass/shuted/brightinats", dir);
+	}
+
+	// And an unattached file whose container doesn't exist, and is too
+	// far away for the table. Its container ID would be the same as an
+	// existing directory's if it were truncated to 32 bits, but it
+	// belongs in lost+found. Objects with such high IDs can't be created
+	// in a test, because the reference count database has an entry for
+	// every ID up to the highest.
+	int64_t farFileID = largeFileID + 1;
+	write_modified_file(sourceID, farFileID,
+		containerID + 0x100000000LL, 0);
+
+	// The check which creates lost+found doesn't count its size, so it
+	// takes another one to finish the job.
+	TEST_THAT(check_account_for_errors() > 0);
+	TEST_THAT(check_account_for_errors() > 0);
+	TEST_EQUAL(0, check_account_for_errors());
+
+	int64_t lostAndFoundID = farFileID + 1;
+	{
+		// The large file's entry wasn't changed
+		BackupStoreDirectory dir;
+		LoadDirectory("Test1/pass/shuted/brightinats", dir);
+		BackupStoreDirectory::Entry *en = dir.FindEntryByID(largeFileID);
+		TEST_THAT_OR(en != NULL, return);
+		TEST_EQUAL(largeFileBlocks, en->GetSizeInBlocks());
+		TEST_THAT(dir.FindEntryByID(farFileID) == NULL);
+
+		// And the far file was put in lost+found, which is the
+		// newest object
+		std::auto_ptr<RaidFileRead> file(RaidFileRead::Open(discSetNum,
+			getObjectName(lostAndFoundID)));
+		BackupStoreDirectory lostAndFound(*file);
+		TEST_EQUAL(BACKUPSTORE_ROOT_DIRECTORY_ID,
+			lostAndFound.GetContainerID());
+		TEST_THAT(lostAndFound.FindEntryByID(farFileID) != NULL);
+
+		// Put everything back as it was
+		dir.DeleteEntry(largeFileID);
+		SaveDirectory("Test1/pass/shuted/brightinats", dir);
+	}
+
+	{
+		std::string fn(getObjectName(BACKUPSTORE_ROOT_DIRECTORY_ID));
+		std::auto_ptr<RaidFileRead> file(RaidFileRead::Open(discSetNum,
+			fn));
+		BackupStoreDirectory root(*file);
+		file->Close();
+		TEST_THAT(root.FindEntryByID(lostAndFoundID) != NULL);
+		root.DeleteEntry(lostAndFoundID);
+		RaidFileWrite w(discSetNum, fn);
+		w.Open(true /* allow overwrite */);
+		root.WriteToStream(w);
+		w.Commit(true /* convert now */);
+	}
+
+	RaidFileWrite(discSetNum, getObjectName(largeFileID)).Delete();
+	RaidFileWrite(discSetNum, getObjectName(farFileID)).Delete();
+	RaidFileWrite(discSetNum, getObjectName(lostAndFoundID)).Delete();
+	// And the directories which were made for them
+	for(int disc = 0; disc < 3; disc++)
+	{
+		std::ostringstream cmd;
+		cmd << "rm -rf testfiles/0_" << disc << "/" << accountRootDir <<
+			"23";
+		TEST_THAT(::system(cmd.str().c_str()) == 0);
+	}
+
+	TEST_THAT(check_account_for_errors() > 0);
+	TEST_EQUAL(0, check_account_for_errors());
+	{
+		std::auto_ptr<BackupProtocolAccountUsage2> usage =
+			BackupProtocolLocal2(0x01234567, "test",
+				"backup/01234567/", 0,
+				false).QueryGetAccountUsage2();
+		TEST_EQUAL(before->GetBlocksUsed(), usage->GetBlocksUsed());
+		TEST_EQUAL(before->GetNumCurrentFiles(),
+			usage->GetNumCurrentFiles());
+		TEST_EQUAL(before->GetNumDirectories(),
+			usage->GetNumDirectories());
+	}
+}
+
 void test_dir_fixing()
 {
 	// Test that entries pointing to nonexistent entries are removed
@@ -692,6 +920,10 @@ int test(int argc, const char *argv[])
 		::fclose(f);
 	}
 
+	// ------------------------------------------------------------------------------------------------
+	BOX_INFO("  === Add objects which don't fit in the check's ID table");
+	test_check_large_ids_and_sizes();
+
 	// ------------------------------------------------------------------------------------------------
 	BOX_INFO("  === Delete store info, add random file");
 	{
@@ -992,6 +1224,7 @@ int test(int argc, const char *argv[])
 	// Dir
 	CorruptObject("Test1/cannes/imulatrougge/foreomizes",23, 
 		"dsf32489sdnadf897fd2hjkesdfmnbsdfcsfoisufio2iofe2hdfkjhsf");
+	test_check_with_workers();
 	// Fix it
 	RUN_CHECK
 	// Check everything is where it should be
@@ -1007,6 +1240,7 @@ int test(int argc, const char *argv[])
 		r->CopyStreamTo(w);
 		w.Commit(true /* convert now */);
 	}
+	test_check_with_workers();
 	// Fix it
 	RUN_CHECK
 	// Check everything is where it should be
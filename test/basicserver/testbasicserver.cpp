@@ -16,9 +16,11 @@
 
 #include <typeinfo>
 
+#include "BoxTime.h"
 #include "CollectInBufferStream.h"
 #include "Configuration.h"
 #include "Daemon.h"
+#include "FileStream.h"
 #include "IOStreamGetLine.h"
 #include "ServerControl.h"
 #include "ServerStream.h"
@@ -114,6 +116,20 @@ void testservers_connection(SocketStream &rStream)
 		{
 			break;
 		}
+		if(line == "SENDFILE")
+		{
+			// Send the file written by the test, straight from the
+			// file if the stream can (see test_tls_send_file)
+			FileStream file("testfiles/sendfile.dat");
+			IOStream::pos_type size = file.BytesLeftToRead();
+			if(!rStream.SendFile(file.GetReadFileHandle(), size,
+				SHORT_TIMEOUT))
+			{
+				file.CopyStreamTo(rStream, SHORT_TIMEOUT,
+					64 * 1024);
+			}
+			continue;
+		}
 		if(line == "LARGEDATA")
 		{
 			// This part of the test is timing-sensitive, because we write
@@ -626,6 +642,70 @@ bool test_new_certificates(bool expect_failure_level_2)
 	return (num_failures == old_num_failures); // no new failures -> good
 }
 
+#define SEND_FILE_SIZE (32*1024*1024)
+
+// Starts a TLS server with the given configuration file, asks it to send
+// testfiles/sendfile.dat, and logs how fast it arrived, to compare the
+// throughput with and without kernel TLS.
+bool test_tls_send_file(const std::string& rConfigFile, bool KernelTLS)
+{
+	std::string cmd = TEST_EXECUTABLE " --test-daemon-args=";
+	cmd += test_args;
+	cmd += " srv3 " + rConfigFile;
+	int pid = LaunchServer(cmd, "testfiles/srv3.pid");
+	TEST_THAT_OR(pid != -1 && pid != 0, return false);
+
+	bool success = true;
+	{
+		TLSContext context;
+		context.Initialise(false /* client */,
+				"testfiles/clientCerts.pem",
+				"testfiles/clientPrivKey.pem",
+				"testfiles/clientTrustedCAs.pem",
+				0 // SSLSecurityLevel, as above
+		);
+		context.SetKernelTLS(KernelTLS);
+
+		SocketStreamTLS conn;
+		conn.Open(context, Socket::TypeINET, "localhost", 2003);
+
+		// The server waits for a line before saying hello
+		conn.Write("Hello\n", 6);
+		std::string line;
+		{
+			IOStreamGetLine getline(conn);
+			while(!getline.GetLine(line, false, SHORT_TIMEOUT))
+				;
+		}
+		TEST_EQUAL("CONNECTED:CLIENT", line);
+
+		box_time_t start = GetCurrentBoxTime();
+		conn.Write("SENDFILE\n", 9, SHORT_TIMEOUT);
+
+		char buf[64 * 1024];
+		int total = 0;
+		int r = 0;
+		while(total < SEND_FILE_SIZE &&
+			(r = conn.Read(buf, sizeof(buf), SHORT_TIMEOUT)) != 0)
+		{
+			total += r;
+		}
+		uint64_t elapsed_ms = BoxTimeToMilliSeconds(
+			GetCurrentBoxTime() - start);
+
+		TEST_EQUAL_OR(SEND_FILE_SIZE, total, success = false);
+		BOX_NOTICE("Received " << (total / (1024 * 1024)) << " MB " <<
+			(KernelTLS ? "with" : "without") << " kernel TLS in " <<
+			elapsed_ms << " ms (" << ((uint64_t)total * 1000 /
+			(elapsed_ms ? elapsed_ms : 1) / 1024) << " kB/s)");
+
+		conn.Write("QUIT\n", 5);
+	}
+
+	TEST_THAT_OR(KillServer(pid), success = false);
+	return success;
+}
+
 int test(int argc, const char *argv[])
 {
 	// Server launching stuff
@@ -789,6 +869,116 @@ int test(int argc, const char *argv[])
 		}
 	}
 
+#ifndef WIN32
+	// Launch a test server with a pool of worker processes
+	{
+		std::string cmd = TEST_EXECUTABLE " --test-daemon-args=";
+		cmd += test_args;
+		cmd += " srv2 testfiles/srv2-workers.conf";
+		int pid = LaunchServer(cmd, "testfiles/srv2.pid");
+
+		TEST_THAT(pid != -1 && pid != 0);
+
+		if(pid > 0)
+		{
+			// Reloading must stop and restart the workers
+			TEST_THAT(ServerIsAlive(pid));
+			TEST_THAT(HUPServer(pid));
+			::sleep(1);
+			TEST_THAT(ServerIsAlive(pid));
+
+			// Twice, to check that the workers handle more than
+			// one connection each
+			for(int i = 0; i < 2; i++)
+			{
+				SocketStream conn1;
+				conn1.Open(Socket::TypeINET, "localhost", 2003);
+				SocketStream conn2;
+				conn2.Open(Socket::TypeUNIX, "testfiles/srv2.sock");
+
+				std::vector<IOStream *> conns;
+				conns.push_back(&conn1);
+				conns.push_back(&conn2);
+				Srv2TestConversations(conns);
+			}
+
+			// Reloading doesn't wait for connections in progress:
+			// new workers accept connections while an old one
+			// finishes its connection.
+			{
+				SocketStream conn1;
+				conn1.Open(Socket::TypeUNIX, "testfiles/srv2.sock");
+				IOStreamGetLine getline1(conn1);
+				conn1.Write("hello\n", 6);
+				std::string line;
+				TEST_THAT(getline1.GetLine(line, false, SHORT_TIMEOUT));
+				TEST_EQUAL("olleh", line);
+
+				TEST_THAT(HUPServer(pid));
+				::sleep(1);
+				TEST_THAT(ServerIsAlive(pid));
+
+				SocketStream conn2;
+				conn2.Open(Socket::TypeINET, "localhost", 2003);
+				IOStreamGetLine getline2(conn2);
+				conn2.Write("world\n", 6);
+				TEST_THAT(getline2.GetLine(line, false, SHORT_TIMEOUT));
+				TEST_EQUAL("dlrow", line);
+				conn2.Write("QUIT\n", 5);
+
+				conn1.Write("again\n", 6);
+				TEST_THAT(getline1.GetLine(line, false, SHORT_TIMEOUT));
+				TEST_EQUAL("niaga", line);
+				conn1.Write("QUIT\n", 5);
+			}
+
+			TEST_THAT(KillServer(pid));
+			::sleep(1);
+			TEST_THAT(!ServerIsAlive(pid));
+		}
+	}
+
+	// Launch a test forking server which handles one connection at a time
+	{
+		std::string cmd = TEST_EXECUTABLE " --test-daemon-args=";
+		cmd += test_args;
+		cmd += " srv2 testfiles/srv2-limited.conf";
+		int pid = LaunchServer(cmd, "testfiles/srv2.pid");
+
+		TEST_THAT(pid != -1 && pid != 0);
+
+		if(pid > 0)
+		{
+			TEST_THAT(ServerIsAlive(pid));
+
+			SocketStream conn1;
+			conn1.Open(Socket::TypeUNIX, "testfiles/srv2.sock");
+			IOStreamGetLine getline1(conn1);
+			conn1.Write("hello\n", 6);
+			std::string line;
+			TEST_THAT(getline1.GetLine(line, false, SHORT_TIMEOUT));
+			TEST_EQUAL("olleh", line);
+
+			// The second connection waits in the listen queue
+			SocketStream conn2;
+			conn2.Open(Socket::TypeUNIX, "testfiles/srv2.sock");
+			IOStreamGetLine getline2(conn2);
+			conn2.Write("world\n", 6);
+			TEST_THAT(!getline2.GetLine(line, false, 2000));
+
+			// Until the first one finishes
+			conn1.Write("QUIT\n", 5);
+			TEST_THAT(getline2.GetLine(line, false, SHORT_TIMEOUT));
+			TEST_EQUAL("dlrow", line);
+			conn2.Write("QUIT\n", 5);
+
+			TEST_THAT(KillServer(pid));
+			::sleep(1);
+			TEST_THAT(!ServerIsAlive(pid));
+		}
+	}
+#endif // !WIN32
+
 	// Launch a test SSL server
 	{
 		std::string cmd = TEST_EXECUTABLE " --test-daemon-args=";
@@ -854,6 +1044,30 @@ int test(int argc, const char *argv[])
 				// Implicit close
 			}
 
+			// A new client process should be able to resume the
+			// session saved by the previous one, and the server
+			// should still know who the client is.
+			for(int i = 0; i < 2; i++)
+			{
+				TLSContext context;
+				context.Initialise(false /* client */,
+						"testfiles/clientCerts.pem",
+						"testfiles/clientPrivKey.pem",
+						"testfiles/clientTrustedCAs.pem",
+						0 // SSLSecurityLevel, as above
+				);
+				context.SetSessionFile("testfiles/tls_session");
+
+				SocketStreamTLS conn;
+				conn.Open(context, Socket::TypeINET, "localhost", 2003);
+				TEST_EQUAL((i == 1), conn.IsSessionResumed());
+
+				std::vector<IOStream *> conns;
+				conns.push_back(&conn);
+				Srv2TestConversations(conns);
+			}
+			TEST_THAT(::unlink("testfiles/tls_session") == 0);
+
 			#ifndef WIN32
 				// HUP again
 				TEST_THAT(HUPServer(pid));
@@ -904,6 +1118,26 @@ int test(int argc, const char *argv[])
 
 		TEST_THAT(KillServer(pid));
 	}
+
+	// Compare the time taken to send a file over TLS connections with
+	// and without kernel TLS. Without it, or if the kernel doesn't
+	// support it, the server has to copy the file through OpenSSL.
+	{
+		char buf[64 * 1024];
+		::memset(buf, 0x5a, sizeof(buf));
+		{
+			FileStream out("testfiles/sendfile.dat",
+				O_WRONLY | O_CREAT | O_TRUNC);
+			for(int i = 0; i < SEND_FILE_SIZE / (int)sizeof(buf); i++)
+			{
+				out.Write(buf, sizeof(buf));
+			}
+		}
+
+		TEST_THAT(test_tls_send_file("testfiles/srv3.conf", false));
+		TEST_THAT(test_tls_send_file("testfiles/srv3-ktls.conf", true));
+		TEST_THAT(::unlink("testfiles/sendfile.dat") == 0);
+	}
 	
 //protocolserver:
 	// Launch a test protocol handling server
@@ -959,6 +1193,29 @@ int test(int argc, const char *argv[])
 				TEST_THAT(reply->GetStartingValue() == sizeof(buf));
 			}
 
+			// Send a stream straight from a file, which can use
+			// sendfile() over this unencrypted connection
+			{
+				char buf[1663];
+				::memset(buf, 0x5a, sizeof(buf));
+				{
+					FileStream out("testfiles/sendfile.dat",
+						O_WRONLY | O_CREAT | O_TRUNC);
+					for(int i = 0; i < 200; i++)
+					{
+						out.Write(buf, sizeof(buf));
+					}
+				}
+
+				std::auto_ptr<IOStream> s(
+					new FileStream("testfiles/sendfile.dat"));
+				std::auto_ptr<TestProtocolGetStream> reply(
+					protocol.QuerySendStream(0x73654353298ffLL, s));
+				TEST_EQUAL((int)sizeof(buf) * 200,
+					reply->GetStartingValue());
+				TEST_THAT(::unlink("testfiles/sendfile.dat") == 0);
+			}
+
 			// Lots of simple queries
 			for(int q = 0; q < 514; q++)
 			{
@@ -67,6 +67,7 @@
 #include "BackupStoreException.h"
 #include "BackupStoreConfigVerify.h"
 #include "BackupStoreFileEncodeStream.h"
+#include "BackupSyncReport.h"
 #include "BoxPortsAndFiles.h"
 #include "BoxTime.h"
 #include "BoxTimeToUnix.h"
@@ -274,6 +275,7 @@ void finish_with_write_xattr_test()
 	if(xattrTestDataHandle != 0)
 	{
 		::fclose(xattrTestDataHandle);
+		xattrTestDataHandle = 0;
 	}
 }
 #endif // HAVE_SYS_XATTR_H
@@ -1992,6 +1994,347 @@ bool test_bbackupd_uploads_files()
 	TEARDOWN_TEST_BBACKUPD();
 }
 
+bool test_sync_report()
+{
+	// Time spent on subdirectories isn't counted against their parents
+	{
+		BackupSyncReport report;
+		BackupSyncReport::Timer outer(report,
+			BackupSyncReport::Phase_SyncDirectory);
+		{
+			BackupSyncReport::Timer inner(report,
+				BackupSyncReport::Phase_SyncDirectory);
+			::usleep(200000);
+			report.AddDirectory("inner", inner.Stop());
+		}
+		report.AddDirectory("outer", outer.Stop());
+
+		std::vector<BackupSyncReport::SlowItem> dirs(
+			report.GetSlowestDirectories());
+		TEST_EQUAL(2, dirs.size());
+		TEST_EQUAL("inner", dirs[0].mPath);
+		TEST_THAT(dirs[0].mDuration >= (box_time_t)MilliSecondsToBoxTime(200));
+		TEST_THAT(dirs[1].mDuration < (box_time_t)MilliSecondsToBoxTime(100));
+		TEST_EQUAL(2, report.GetPhaseCount(
+			BackupSyncReport::Phase_SyncDirectory));
+	}
+
+	// Only the slowest few are kept, slowest first
+	{
+		BackupSyncReport report(3);
+		for(int i = 1; i <= 10; i++)
+		{
+			std::ostringstream path;
+			path << "file" << (i * 7 % 10);
+			report.AddFile(path.str(), i * 7 % 10, 100);
+		}
+		std::vector<BackupSyncReport::SlowItem> files(
+			report.GetSlowestFiles());
+		TEST_EQUAL(3, files.size());
+		TEST_EQUAL("file9", files[0].mPath);
+		TEST_EQUAL("file8", files[1].mPath);
+		TEST_EQUAL("file7", files[2].mPath);
+		TEST_EQUAL(10, report.GetFilesUploaded());
+		TEST_EQUAL(1000, report.GetBytesUploaded());
+	}
+
+	SETUP_WITH_BBSTORED();
+
+	TEST_EQUAL("", bbackupd.GetLastSyncReport());
+	bbackupd.RunSyncNowWithExceptionHandling();
+	TEST_COMPARE(Compare_Same);
+
+	std::string report = bbackupd.GetLastSyncReport();
+	TEST_EQUAL(std::string::npos, report.find('\n'));
+	TEST_THAT(StartsWith("{\"start_time\":", report));
+	TEST_THAT(report.find("\"success\":true") != std::string::npos);
+	TEST_THAT(report.find("\"files_uploaded\":0") == std::string::npos);
+	TEST_THAT(report.find("\"scan\":{\"count\":") != std::string::npos);
+	TEST_THAT(report.find("\"StoreFile\":{\"count\":") !=
+		std::string::npos);
+	TEST_THAT(report.find("\"slowest_files\":[{\"path\":") !=
+		std::string::npos);
+	TEST_THAT(report.find("\"slowest_directories\":[{\"path\":") !=
+		std::string::npos);
+
+	TEARDOWN_TEST_BBACKUPD();
+}
+
+// Runs a sync, and returns how many times attributes were read during it,
+// and how many times file attributes were uploaded.
+void sync_and_count_attribute_reads(BackupDaemon& bbackupd,
+	int64_t& rAttributeReads, int64_t& rAttributeUploads)
+{
+	std::auto_ptr<BackupClientContext> apContext(bbackupd.RunSyncNow());
+	apContext->RecordQueryStats();
+	BackupSyncReport &rReport(apContext->GetSyncReport());
+	rAttributeReads = rReport.GetPhaseCount(
+		BackupSyncReport::Phase_Attributes);
+
+	BackupSyncReport::RoundTripMap::const_iterator i =
+		rReport.GetRoundTrips().find("SetReplacementFileAttributes");
+	rAttributeUploads = (i == rReport.GetRoundTrips().end()) ? 0 :
+		i->second.mCount;
+}
+
+bool test_attribute_hashes_are_cached()
+{
+	SETUP_WITH_BBSTORED();
+
+#ifdef WIN32
+	BOX_NOTICE("skipping test on this platform");
+	// the attribute modification time is really the creation time, so
+	// attribute hashes are never cached
+#else
+	// Unpacking the files changed their attributes just now, so their
+	// hashes won't be cached unless we wait a bit first.
+	wait_for_operation(3, "attributes to be old enough to cache");
+
+	int64_t first_reads, reads, unchanged_reads, uploads;
+	sync_and_count_attribute_reads(bbackupd, first_reads, uploads);
+	TEST_COMPARE(Compare_Same);
+
+	// Nothing has changed, so none of the files' attributes should be
+	// read again: only the directories' ones.
+	sync_and_count_attribute_reads(bbackupd, unchanged_reads, uploads);
+	TEST_EQUAL(0, uploads);
+	TEST_THAT(unchanged_reads > 0);
+	TEST_THAT(unchanged_reads < first_reads);
+	sync_and_count_attribute_reads(bbackupd, reads, uploads);
+	TEST_EQUAL(unchanged_reads, reads);
+	TEST_EQUAL(0, uploads);
+
+	// Changing the mode of a file must invalidate its cached hash. We
+	// expect one read to calculate the new hash, one to upload the
+	// new attributes, and one for the directory whose checksum changed.
+	// Reading any other files' attributes again would add more.
+	const char *filename = "testfiles/TestDir1/f1.dat";
+	EMU_STRUCT_STAT st;
+	TEST_THAT(EMU_STAT(filename, &st) == 0);
+	TEST_THAT(::chmod(filename, (st.st_mode & 07777) ^ S_IRGRP) == 0);
+	wait_for_operation(3, "new attributes to be old enough to cache");
+	sync_and_count_attribute_reads(bbackupd, reads, uploads);
+	TEST_EQUAL(unchanged_reads + 3, reads);
+	TEST_EQUAL(1, uploads);
+	TEST_COMPARE(Compare_Same);
+
+	// And the new hash should have been cached.
+	sync_and_count_attribute_reads(bbackupd, reads, uploads);
+	TEST_EQUAL(unchanged_reads, reads);
+	TEST_EQUAL(0, uploads);
+
+#ifdef HAVE_SYS_XATTR_H
+	// So must changing an extended attribute, which changes the file's
+	// attribute modification time but nothing else.
+	bool xattrNotSupported = false;
+	if(!write_xattr_test(filename, "user.cached", 100,
+		&xattrNotSupported) && xattrNotSupported)
+	{
+		BOX_WARNING("Extended attributes not supported on this "
+			"filesystem, skipping the rest of this test");
+	}
+	else
+	{
+		wait_for_operation(3, "new attributes to be old enough "
+			"to cache");
+		sync_and_count_attribute_reads(bbackupd, reads, uploads);
+		TEST_EQUAL(unchanged_reads + 3, reads);
+		TEST_EQUAL(1, uploads);
+		TEST_COMPARE(Compare_Same);
+
+		sync_and_count_attribute_reads(bbackupd, reads, uploads);
+		TEST_EQUAL(unchanged_reads, reads);
+		TEST_EQUAL(0, uploads);
+	}
+	finish_with_write_xattr_test();
+#endif // HAVE_SYS_XATTR_H
+#endif // !WIN32
+
+	TEARDOWN_TEST_BBACKUPD();
+}
+
+bool test_bbackupd_uploads_files_on_extra_connections()
+{
+	SETUP_WITH_BBSTORED();
+
+	// The normal configuration, but with all the larger files uploaded
+	// on extra connections
+	{
+		FileStream in("testfiles/bbackupd.conf");
+		FileStream out("testfiles/bbackupd-extraconn.conf",
+			O_WRONLY | O_CREAT | O_TRUNC);
+		in.CopyStreamTo(out);
+		std::string extra("ExtraStoreConnections = 2\n"
+			"ExtraConnectionUploadSizeThreshold = 1024\n");
+		out.Write(extra.c_str(), extra.size());
+	}
+	TEST_THAT(configure_bbackupd(bbackupd,
+		"testfiles/bbackupd-extraconn.conf"));
+
+	bbackupd.RunSyncNow();
+	TEST_COMPARE(Compare_Same);
+	TEST_THAT(!TestFileExists("testfiles/notifyran.read-error.1"));
+
+	// Change a large file, so that a diff is uploaded on an extra
+	// connection too
+	{
+		FileStream f("testfiles/TestDir1/f1.dat", O_WRONLY | O_APPEND);
+		std::string more(4096, 'x');
+		f.Write(more.c_str(), more.size());
+	}
+	wait_for_operation(5, "large file to be old enough");
+	bbackupd.RunSyncNow();
+	TEST_COMPARE(Compare_Same);
+	TEST_THAT(!TestFileExists("testfiles/notifyran.read-error.1"));
+
+	TEARDOWN_TEST_BBACKUPD();
+}
+
+bool test_bbackupd_resumes_interrupted_uploads()
+{
+	SETUP_TEST_BBACKUPD();
+	TEST_THAT_OR(unpack_files("test_base"), FAIL);
+
+	// The normal configuration, but with big files uploaded resumably
+	{
+		FileStream in("testfiles/bbackupd.conf");
+		FileStream out("testfiles/bbackupd-resumable.conf",
+			O_WRONLY | O_CREAT | O_TRUNC);
+		in.CopyStreamTo(out);
+		std::string extra("ResumableUploadSizeThreshold = 2097152\n");
+		out.Write(extra.c_str(), extra.size());
+	}
+
+	// A big file which doesn't compress, old enough to upload at once
+	const char* big_file = "testfiles/TestDir1/resumable.dat";
+	{
+		FileStream out(big_file, O_WRONLY | O_CREAT | O_EXCL);
+		uint32_t data[1024];
+		uint32_t seed = 5678;
+		for(int b = 0; b < 768; b++)
+		{
+			for(int i = 0; i < 1024; i++)
+			{
+				seed = seed * 1103515245 + 12345;
+				data[i] = seed;
+			}
+			out.Write(data, sizeof(data));
+		}
+	}
+	{
+		struct timeval times[2] = {};
+		times[1].tv_sec = 1000000000;
+		TEST_THAT(::utimes(big_file, times) == 0);
+	}
+
+	// Passes on part of a stream, then fails as if the connection
+	// had been lost
+	class InterruptedStream : public IOStream
+	{
+	public:
+		InterruptedStream(std::auto_ptr<IOStream> apSource,
+			int64_t BytesBeforeFailure)
+		: mapSource(apSource),
+		  mBytesLeft(BytesBeforeFailure)
+		{ }
+		virtual int Read(void *pBuffer, int NBytes,
+			int Timeout = IOStream::TimeOutInfinite)
+		{
+			if(mBytesLeft <= 0)
+			{
+				THROW_EXCEPTION(ConnectionException,
+					TLSReadFailed);
+			}
+			if(NBytes > mBytesLeft)
+			{
+				NBytes = mBytesLeft;
+			}
+			int bytes = mapSource->Read(pBuffer, NBytes, Timeout);
+			mBytesLeft -= bytes;
+			return bytes;
+		}
+		virtual void Write(const void *pBuffer, int NBytes,
+			int Timeout = IOStream::TimeOutInfinite)
+		{
+			THROW_EXCEPTION(CommonException, NotSupported);
+		}
+		virtual bool StreamDataLeft() { return true; }
+		virtual bool StreamClosed() { return false; }
+	private:
+		std::auto_ptr<IOStream> mapSource;
+		int64_t mBytesLeft;
+	};
+
+	class MockBackupProtocolLocal : public BackupProtocolLocal2
+	{
+	public:
+		std::vector<int64_t> mOffsets;
+		MockBackupProtocolLocal(int32_t AccountNumber,
+			const std::string& ConnectionDetails,
+			const std::string& AccountRootDir, int DiscSetNumber,
+			bool ReadOnly)
+		: BackupProtocolLocal2(AccountNumber, ConnectionDetails,
+			AccountRootDir, DiscSetNumber, ReadOnly)
+		{ }
+		virtual ~MockBackupProtocolLocal() { }
+
+		using BackupProtocolLocal2::Query;
+		virtual std::auto_ptr<BackupProtocolSuccess> Query(
+			const BackupProtocolResumeStagedFile &rQuery,
+			std::auto_ptr<IOStream> apStream)
+		{
+			BackupProtocolResumeStagedFile query(rQuery);
+			mOffsets.push_back(query.GetOffset());
+			if(mOffsets.size() == 1)
+			{
+				std::auto_ptr<IOStream> apBroken(
+					new InterruptedStream(apStream,
+						1024 * 1024));
+				apStream = apBroken;
+			}
+			return BackupProtocolLocal::Query(rQuery, apStream);
+		}
+	};
+
+	MockBackupProtocolLocal client(0x01234567, "test",
+		"backup/01234567/", 0, false);
+
+	// The first attempt is interrupted, which fails the whole sync
+	{
+		MockBackupDaemon bbackupd(client);
+		TEST_THAT_OR(prepare_test_with_client_daemon(bbackupd, false,
+			false, "testfiles/bbackupd-resumable.conf"), FAIL);
+
+		Console& console(Logging::GetConsole());
+		Logger::LevelGuard guard(console);
+
+		if (console.GetLevel() < Log::TRACE)
+		{
+			console.Filter(Log::NOTHING);
+		}
+
+		bbackupd.RunSyncNowWithExceptionHandling();
+	}
+	TEST_EQUAL(1, client.mOffsets.size());
+	TEST_EQUAL(0, client.mOffsets[0]);
+	TEST_THAT(TestFileExists("testfiles/notifyran.backup-error.1"));
+
+	// The next one, even by a daemon which has been restarted since,
+	// carries on from the last whole block that the server received,
+	// rather than starting again
+	MockBackupDaemon bbackupd(client);
+	TEST_THAT_OR(prepare_test_with_client_daemon(bbackupd, false, false,
+		"testfiles/bbackupd-resumable.conf"), FAIL);
+	bbackupd.RunSyncNowWithExceptionHandling();
+	TEST_EQUAL(2, client.mOffsets.size());
+	TEST_THAT(client.mOffsets[1] > 0);
+	TEST_THAT(client.mOffsets[1] <= 1024 * 1024);
+	TEST_THAT(!TestFileExists("testfiles/notifyran.backup-error.2"));
+	TEST_COMPARE_LOCAL(Compare_Same, client);
+
+	TEARDOWN_TEST_BBACKUPD();
+}
+
 bool test_bbackupd_responds_to_connection_failure()
 {
 	SETUP_TEST_BBACKUPD();
@@ -4274,6 +4617,10 @@ int test(int argc, const char *argv[])
 	TEST_THAT(test_backup_pauses_when_store_is_full());
 	TEST_THAT(test_bbackupd_exclusions());
 	TEST_THAT(test_bbackupd_uploads_files());
+	TEST_THAT(test_sync_report());
+	TEST_THAT(test_attribute_hashes_are_cached());
+	TEST_THAT(test_bbackupd_uploads_files_on_extra_connections());
+	TEST_THAT(test_bbackupd_resumes_interrupted_uploads());
 	TEST_THAT(test_bbackupd_responds_to_connection_failure());
 	TEST_THAT(test_absolute_symlinks_not_followed_during_restore());
 	TEST_THAT(test_initially_missing_locations_are_not_forgotten());
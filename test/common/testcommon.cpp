@@ -13,6 +13,11 @@
 #include <stdio.h>
 #include <time.h>
 
+#ifndef WIN32
+	#include <signal.h>
+	#include <sys/wait.h>
+#endif
+
 #include "Test.h"
 #include "Configuration.h"
 #include "FdGetLine.h"
@@ -31,6 +36,9 @@
 #include "Archive.h"
 #include "Timer.h"
 #include "Logging.h"
+#include "WaitForEvent.h"
+#include "WakeUpEvent.h"
+#include "Metrics.h"
 #include "ZeroStream.h"
 #include "PartialReadStream.h"
 
@@ -175,6 +183,333 @@ class TestLogger : public Logger
 	virtual void SetProgramName(const std::string& rProgramName) { }
 };
 
+static int sLogArgumentsEvaluated = 0;
+
+int count_log_evaluation()
+{
+	return ++sLogArgumentsEvaluated;
+}
+
+std::string read_log_file(const std::string& rFilename)
+{
+	FileStream file(rFilename);
+	char buffer[4096];
+	int bytes = file.Read(buffer, sizeof(buffer));
+	return std::string(buffer, bytes);
+}
+
+void test_logging()
+{
+	Logger::LevelGuard console(Logging::GetConsole(), Log::NOTICE);
+
+	// Messages which no logger wants are not formatted at all
+	BOX_TRACE("not wanted: " << count_log_evaluation());
+	TEST_EQUAL(0, sLogArgumentsEvaluated);
+	{
+		Capture capture;
+		BOX_TRACE("wanted: " << count_log_evaluation());
+		TEST_EQUAL(1, sLogArgumentsEvaluated);
+		TEST_EQUAL(1, capture.GetMessages().size());
+
+		capture.Filter(Log::INFO);
+		BOX_TRACE("not wanted: " << count_log_evaluation());
+		TEST_EQUAL(1, sLogArgumentsEvaluated);
+	}
+	BOX_TRACE("not wanted: " << count_log_evaluation());
+	TEST_EQUAL(1, sLogArgumentsEvaluated);
+
+	// Buffered messages are written when something important is logged,
+	// or the logger is destroyed
+	{
+		FileLogger logger("testfiles/buffered.log", Log::TRACE, false,
+			4096);
+		BOX_TRACE("buffered message");
+		TEST_EQUAL("", read_log_file("testfiles/buffered.log"));
+
+		Logger::LevelGuard quiet(Logging::GetConsole(), Log::NOTHING);
+		BOX_WARNING("urgent message");
+		std::string log = read_log_file("testfiles/buffered.log");
+		TEST_THAT(log.find("[TRACE]   buffered message\n") !=
+			std::string::npos);
+		TEST_THAT(log.find("[WARNING] urgent message\n") !=
+			std::string::npos);
+
+		BOX_TRACE("last message");
+	}
+	TEST_THAT(read_log_file("testfiles/buffered.log").find(
+		"[TRACE]   last message\n") != std::string::npos);
+
+	// A full buffer is written out to make room, unless messages are to
+	// be dropped instead
+	{
+		FileLogger logger("testfiles/buffered.log", Log::TRACE, false,
+			100);
+		for(int i = 0; i < 10; i++)
+		{
+			BOX_TRACE("message " << i);
+		}
+		TEST_THAT(read_log_file("testfiles/buffered.log").find(
+			"message 0\n") != std::string::npos);
+		TEST_EQUAL(0, logger.GetDroppedMessages());
+	}
+
+	{
+		FileLogger logger("testfiles/buffered.log", Log::TRACE, false,
+			100, true); // DropWhenFull
+		for(int i = 0; i < 10; i++)
+		{
+			BOX_TRACE("message " << i);
+		}
+		TEST_EQUAL("", read_log_file("testfiles/buffered.log"));
+		TEST_THAT(logger.GetDroppedMessages() > 0);
+
+		logger.Flush();
+		std::string log = read_log_file("testfiles/buffered.log");
+		TEST_THAT(log.find("message 0\n") != std::string::npos);
+		TEST_THAT(log.find("message 9\n") == std::string::npos);
+		std::ostringstream dropped;
+		dropped << "[WARNING] " << logger.GetDroppedMessages() <<
+			" log messages were dropped";
+		TEST_THAT(log.find(dropped.str()) != std::string::npos);
+	}
+}
+
+bool metrics_contain(const std::string& rLine)
+{
+	std::string text = MetricsRegistry::GetInstance().GetPrometheusText();
+	if(text.find(rLine + "\n") != std::string::npos)
+	{
+		return true;
+	}
+	BOX_WARNING("Expected metric not found: " << rLine << "\n" << text);
+	return false;
+}
+
+void test_metrics()
+{
+	MetricsCounter requests("test_requests_total", "Requests handled",
+		"status=\"ok\"");
+	requests.Increment();
+	requests.Increment(2);
+	TEST_EQUAL(3, requests.GetValue());
+
+	// Another object for the same series shares its value, but one
+	// with different labels doesn't
+	MetricsCounter same("test_requests_total", "Requests handled",
+		"status=\"ok\"");
+	MetricsCounter other("test_requests_total", "Requests handled",
+		"status=\"failed\"");
+	same.Increment();
+	TEST_EQUAL(4, requests.GetValue());
+	TEST_EQUAL(0, other.GetValue());
+
+	MetricsGauge open("test_open", "Things open");
+	open.Add(5);
+	open.Add(-2);
+	TEST_EQUAL(3, open.GetValue());
+
+	MetricsHistogram latency("test_latency_seconds", "Time taken");
+	latency.Record(MilliSecondsToBoxTime(2));
+	latency.Record(MilliSecondsToBoxTime(2));
+	latency.Record(SecondsToBoxTime(60));
+	TEST_EQUAL(3, latency.GetCount());
+
+	TEST_THAT(metrics_contain("# HELP test_requests_total Requests handled"));
+	TEST_THAT(metrics_contain("# TYPE test_requests_total counter"));
+	TEST_THAT(metrics_contain("test_requests_total{status=\"ok\"} 4"));
+	TEST_THAT(metrics_contain("test_requests_total{status=\"failed\"} 0"));
+	TEST_THAT(metrics_contain("# TYPE test_open gauge"));
+	TEST_THAT(metrics_contain("test_open 3"));
+	TEST_THAT(metrics_contain("# TYPE test_latency_seconds histogram"));
+	TEST_THAT(metrics_contain("test_latency_seconds_bucket{le=\"0.001\"} 0"));
+	TEST_THAT(metrics_contain("test_latency_seconds_bucket{le=\"0.0025\"} 2"));
+	TEST_THAT(metrics_contain("test_latency_seconds_bucket{le=\"10\"} 2"));
+	TEST_THAT(metrics_contain("test_latency_seconds_bucket{le=\"+Inf\"} 3"));
+	TEST_THAT(metrics_contain("test_latency_seconds_sum 60.004000"));
+	TEST_THAT(metrics_contain("test_latency_seconds_count 3"));
+
+#ifndef WIN32
+	// Child processes add to the same values, including of series which
+	// they create
+	TEST_THAT(MetricsRegistry::GetInstance().IsShared());
+	pid_t pid = fork();
+	TEST_THAT(pid != -1);
+	if(pid == 0)
+	{
+		requests.Increment(10);
+		MetricsCounter child("test_child_total", "Created by a child");
+		child.Increment();
+		_exit(0);
+	}
+
+	int status;
+	TEST_EQUAL(pid, waitpid(pid, &status, 0));
+	TEST_EQUAL(14, requests.GetValue());
+	TEST_THAT(metrics_contain("test_child_total 1"));
+#endif
+}
+
+#ifndef WIN32
+// A file descriptor which can be added to a WaitForEvent
+class TestEventSource
+{
+public:
+	TestEventSource(int fd) : mFd(fd) { }
+#ifdef HAVE_KQUEUE
+	void FillInKEvent(struct kevent &rEvent, int Flags = 0) const
+	{
+		EV_SET(&rEvent, mFd, EVFILT_READ, 0, 0, 0, (void*)this);
+	}
+#else
+	void FillInPoll(int &fd, short &events, int Flags = 0) const
+	{
+		fd = mFd;
+		events = POLLIN;
+	}
+#endif
+private:
+	int mFd;
+};
+
+void test_wait_for_event()
+{
+	int levelFds[2], edgeFds[2];
+	TEST_THAT(::pipe(levelFds) == 0);
+	TEST_THAT(::pipe(edgeFds) == 0);
+	TestEventSource level(levelFds[0]), edge(edgeFds[0]);
+
+	{
+		WaitForEvent wait(0);
+		wait.Add(&level);
+		wait.Add(&edge, 0, WaitForEvent::EdgeTriggered);
+		TEST_THAT(wait.Wait() == NULL);
+
+		TEST_EQUAL(1, ::write(levelFds[1], "x", 1));
+		TEST_EQUAL(1, ::write(edgeFds[1], "x", 1));
+		void *first = wait.Wait();
+		void *second = wait.Wait();
+		TEST_THAT(first != second);
+		TEST_THAT(first == &level || first == &edge);
+		TEST_THAT(second == &level || second == &edge);
+
+		// Neither has been read. The level-triggered one is returned
+		// again, but where the platform can wait for edges, the
+		// other one isn't, until more data arrives.
+		for(int i = 0; i < 3; i++)
+		{
+			void *ready = wait.Wait();
+#if defined HAVE_KQUEUE || defined WAITFOREVENT_USE_EPOLL
+			TEST_THAT(ready == &level);
+#else
+			TEST_THAT(ready == &level || ready == &edge);
+#endif
+		}
+
+		// Removed items aren't returned, even if they were ready
+		// before they were removed
+		wait.Remove(&level);
+		TEST_EQUAL(1, ::write(edgeFds[1], "x", 1));
+		TEST_THAT(wait.Wait() == &edge);
+		wait.Add(&level);
+		TEST_EQUAL(1, ::write(edgeFds[1], "x", 1));
+		void *ready = wait.Wait();
+		void *removed = (ready == &level) ? (void *)&edge : (void *)&level;
+		wait.Remove(removed);
+		for(int i = 0; i < 3; i++)
+		{
+			TEST_THAT(wait.Wait() != removed);
+		}
+	}
+
+	// A forked child which changes what it's waiting for doesn't
+	// change what its parent is waiting for
+	{
+		WaitForEvent wait(0);
+		wait.Add(&level);
+		TEST_THAT(wait.Wait() == &level);
+
+		pid_t pid = fork();
+		TEST_THAT(pid != -1);
+		if(pid == 0)
+		{
+			wait.Remove(&level);
+			_exit(wait.Wait() == NULL ? 0 : 1);
+		}
+
+		int status;
+		TEST_EQUAL(pid, waitpid(pid, &status, 0));
+		TEST_THAT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+		TEST_THAT(wait.Wait() == &level);
+	}
+
+	for(int i = 0; i < 2; i++)
+	{
+		::close(levelFds[i]);
+		::close(edgeFds[i]);
+	}
+
+	// A WakeUpEvent wakes up a WaitForEvent straight away, and stays
+	// ready until it's cleared
+	{
+		WakeUpEvent wakeUp;
+		WaitForEvent wait(10000);
+		wait.Add(&wakeUp);
+		TEST_THAT(!wakeUp.Clear());
+
+		box_time_t start = GetCurrentMonotonicTime();
+		wakeUp.Signal();
+		wakeUp.Signal();
+		TEST_THAT(wait.Wait() == &wakeUp);
+		TEST_THAT(wait.Wait() == &wakeUp);
+		TEST_THAT(wakeUp.Clear());
+		TEST_THAT(!wakeUp.Clear());
+		TEST_THAT(GetCurrentMonotonicTime() - start <
+			(box_time_t)MilliSecondsToBoxTime(1000));
+
+		// Including from another process
+		pid_t pid = fork();
+		TEST_THAT(pid != -1);
+		if(pid == 0)
+		{
+			wakeUp.Signal();
+			_exit(0);
+		}
+		TEST_THAT(wait.Wait() == &wakeUp);
+		TEST_THAT(wakeUp.Clear());
+		int status;
+		TEST_EQUAL(pid, waitpid(pid, &status, 0));
+	}
+
+	// A WaitForEvent still wakes up for timers after their file
+	// descriptor is replaced, perhaps by one with the same number
+	{
+		WaitForEvent wait(10000);
+		{
+			Timer timer(50, "first");
+			for(int i = 0; i < 100 && !timer.HasExpired(); i++)
+			{
+				wait.Wait();
+			}
+			TEST_THAT(timer.HasExpired());
+		}
+
+		Timers::Cleanup();
+		Timers::Init();
+
+		Timer timer(200, "second");
+		box_time_t start = GetCurrentMonotonicTime();
+		while(!timer.HasExpired() &&
+			GetCurrentMonotonicTime() - start < SecondsToBoxTime(5))
+		{
+			TEST_THAT(wait.Wait() == NULL);
+		}
+		TEST_THAT(timer.HasExpired());
+		TEST_THAT(GetCurrentMonotonicTime() - start <
+			(box_time_t)MilliSecondsToBoxTime(1000));
+	}
+}
+#endif // !WIN32
+
 int test(int argc, const char *argv[])
 {
 	// Test PartialReadStream and ReadGatherStream handling of files
@@ -402,6 +737,75 @@ int test(int argc, const char *argv[])
 		TEST_THAT(t3.HasExpired());
 	}
 
+#ifndef WIN32
+	// Timers don't use signals any more
+	{
+		struct sigaction oldact;
+		TEST_THAT(::sigaction(SIGALRM, NULL, &oldact) == 0);
+		TEST_THAT(oldact.sa_handler == SIG_DFL);
+	}
+#endif
+
+	// Timers are kept in order of expiry, however they're added and
+	// removed
+	{
+		TEST_EQUAL(-1, Timers::GetTimeToNextExpiry());
+
+		std::vector<Timer *> timers;
+		for(int i = 0; i < 100; i++)
+		{
+			// 100 to 199 seconds, in a scrambled order
+			timers.push_back(new Timer(100000 +
+				((i * 37) % 100) * 1000, "heap"));
+		}
+
+		// Remove all the even ones, including the soonest (i = 0)
+		for(int i = 0; i < 100; i += 2)
+		{
+			delete timers[i];
+			timers[i] = NULL;
+		}
+
+		// The soonest left is 101 seconds, which is i = 73
+		int64_t next = Timers::GetTimeToNextExpiry();
+		TEST_THAT(next > SecondsToBoxTime(100));
+		TEST_THAT(next <= SecondsToBoxTime(101));
+
+		// Resetting it moves it to the back
+		timers[73]->Reset(300000);
+		next = Timers::GetTimeToNextExpiry();
+		TEST_THAT(next > SecondsToBoxTime(102));
+		TEST_THAT(next <= SecondsToBoxTime(103));
+
+		for(int i = 1; i < 100; i += 2)
+		{
+			TEST_THAT(!timers[i]->HasExpired());
+			delete timers[i];
+		}
+		TEST_EQUAL(-1, Timers::GetTimeToNextExpiry());
+	}
+
+	// WaitForEvent wakes up when a timer expires, long before its own
+	// timeout
+	{
+		WaitForEvent wait(10000);
+		Timer timer(200, "wake");
+		box_time_t start = GetCurrentMonotonicTime();
+		while(!timer.HasExpired() &&
+			GetCurrentMonotonicTime() - start < SecondsToBoxTime(5))
+		{
+			TEST_THAT(wait.Wait() == NULL);
+		}
+		TEST_THAT(timer.HasExpired());
+		box_time_t elapsed = GetCurrentMonotonicTime() - start;
+		TEST_THAT(elapsed >= (box_time_t)MilliSecondsToBoxTime(190));
+		TEST_THAT(elapsed < (box_time_t)MilliSecondsToBoxTime(1000));
+	}
+
+#ifndef WIN32
+	test_wait_for_event();
+#endif
+
 	// Leave timers initialised for rest of test.
 	// Test main() will cleanup after test finishes.
 
@@ -877,6 +1281,8 @@ int test(int argc, const char *argv[])
 	}
 
 	test_conversions();
+	test_logging();
+	test_metrics();
 
 	// test that we can use Archive and CollectInBufferStream
 	// to read and write arbitrary types to a memory buffer
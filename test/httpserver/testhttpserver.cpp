@@ -13,21 +13,30 @@
 #include <cstdio>
 #include <cstring>
 #include <ctime>
+#include <sstream>
+#include <vector>
 
 #ifdef HAVE_SIGNAL_H
 	#include <signal.h>
 #endif
 
+#ifndef WIN32
+	#include <poll.h>
+#endif
+
 #include <openssl/hmac.h>
 
 #include "autogen_HTTPException.h"
+#include "HTTPChunkedStream.h"
 #include "HTTPRequest.h"
 #include "HTTPResponse.h"
 #include "HTTPServer.h"
 #include "IOStreamGetLine.h"
+#include "MemBlockStream.h"
 #include "S3Client.h"
 #include "S3Simulator.h"
 #include "ServerControl.h"
+#include "SocketStream.h"
 #include "Test.h"
 #include "decode.h"
 #include "encode.h"
@@ -36,6 +45,34 @@
 
 #define SHORT_TIMEOUT 5000
 
+// The ETag which the S3Simulator gives testfiles/testrequests.pl, which is
+// the MD5 digest of its contents, as S3 uses
+#define TESTREQUESTS_ETAG "\"648262040612d14e579f89fc3ff936cc\""
+
+// The example keys from the Amazon S3 documentation, which the S3Simulator
+// is configured to accept in testfiles/s3simulator.conf
+#define EXAMPLE_S3_ACCESS_KEY "0PN5J17HBGZHT7JJ3X82"
+#define EXAMPLE_S3_SECRET_KEY "uV3F3YluFJax1cknvbcGwgjvx4QpvB+leU8dUj2o"
+
+// A stream whose size isn't known in advance, like a network connection
+class UnknownSizeStream : public MemBlockStream
+{
+public:
+	UnknownSizeStream(const std::string& rData) : MemBlockStream(rData) { }
+	virtual pos_type BytesLeftToRead() { return SizeOfStreamUnknown; }
+};
+
+// The content of the streamed responses from the test server
+std::string get_stream_data()
+{
+	std::string data;
+	for(int i = 0; i < 200000; i++)
+	{
+		data += (char)(i % 253);
+	}
+	return data;
+}
+
 class TestWebServer : public HTTPServer
 {
 public:
@@ -56,6 +93,33 @@ void TestWebServer::Handle(HTTPRequest &rRequest, HTTPResponse &rResponse)
 		return;
 	}
 
+	// Stream a response whose size isn't known in advance
+	if(rRequest.GetRequestURI() == "/stream")
+	{
+		rResponse.SetResponseCode(HTTPResponse::Code_OK);
+		rResponse.SetContentType("application/octet-stream");
+		rResponse.SetDataStream(std::auto_ptr<IOStream>(
+			new UnknownSizeStream(get_stream_data())));
+		return;
+	}
+
+	// Send back the content of the request, with its known size
+	if(rRequest.GetRequestURI() == "/echo")
+	{
+		if(rRequest.IsExpectingContinue())
+		{
+			rResponse.SendContinue();
+		}
+		std::auto_ptr<CollectInBufferStream> apContent(
+			new CollectInBufferStream);
+		rRequest.ReadContent(*apContent);
+		apContent->SetForReading();
+		rResponse.SetResponseCode(HTTPResponse::Code_OK);
+		rResponse.SetContentType("application/octet-stream");
+		rResponse.SetDataStream(std::auto_ptr<IOStream>(apContent));
+		return;
+	}
+
 	// Set a cookie?
 	if(rRequest.GetRequestURI() == "/set-cookie")
 	{
@@ -128,6 +192,468 @@ void TestWebServer::Handle(HTTPRequest &rRequest, HTTPResponse &rResponse)
 TestWebServer::TestWebServer() {}
 TestWebServer::~TestWebServer() {}
 
+void log_s3_rate(const char *description, int num_requests,
+	box_time_t start)
+{
+	int64_t ms = BoxTimeToMilliSeconds(GetCurrentBoxTime() - start);
+	BOX_NOTICE("S3 " << description << ": " << num_requests <<
+		" requests in " << ms << " ms (" <<
+		(num_requests * 1000 / (ms ? ms : 1)) << " per second)");
+}
+
+std::string get_response_body(const HTTPResponse& rResponse)
+{
+	return std::string((const char *)rResponse.GetBuffer(),
+		rResponse.GetSize());
+}
+
+// Checks that 1xx, 204 and 304 responses are taken to have no body, so that
+// the next response on a kept-alive connection is read correctly, even when
+// they have no Content-Length.
+void test_responses_without_body()
+{
+	MemBlockStream responses(std::string(
+		"HTTP/1.1 204 No Content\r\n"
+		"x-amz-request-id: 1\r\n\r\n"
+		"HTTP/1.1 304 Not Modified\r\n"
+		"Content-Length: 5\r\n\r\n"
+		"HTTP/1.1 102 Processing\r\n\r\n"
+		"HTTP/1.1 200 OK\r\n"
+		"Content-Length: 5\r\n\r\n"
+		"hello"));
+	IOStreamGetLine getLine(responses);
+
+	int expected_codes[] = {204, 304, 102};
+	for(size_t i = 0; i < sizeof(expected_codes) / sizeof(*expected_codes);
+		i++)
+	{
+		HTTPResponse response;
+		response.Receive(getLine, SHORT_TIMEOUT);
+		TEST_EQUAL(expected_codes[i], response.GetResponseCode());
+		TEST_EQUAL(0, response.GetSize());
+		TEST_THAT(response.IsKeepAlive());
+	}
+
+	HTTPResponse response;
+	response.Receive(getLine, SHORT_TIMEOUT);
+	TEST_EQUAL(200, response.GetResponseCode());
+	TEST_EQUAL("hello", get_response_body(response));
+}
+
+// Tests streamed responses, and chunked requests and responses, on one
+// kept-alive connection to the test server, and without keep-alive for an
+// HTTP/1.0 client.
+void test_chunked_encoding()
+{
+	std::string data = get_stream_data();
+
+	SocketStream sock;
+	sock.Open(Socket::TypeINET, "localhost", 1080);
+	IOStreamGetLine getLine(sock);
+
+	// Check the framing on the wire first
+	{
+		HTTPRequest request(HTTPRequest::Method_GET, "/stream");
+		request.SetClientKeepAliveRequested(true);
+		request.Send(sock, SHORT_TIMEOUT);
+
+		std::string line;
+		TEST_THAT(getLine.GetLine(line, false, SHORT_TIMEOUT));
+		TEST_EQUAL("HTTP/1.1 200 OK", line);
+		bool chunked = false, length = false;
+		while(getLine.GetLine(line, false, SHORT_TIMEOUT) && !line.empty())
+		{
+			if(line == "Transfer-Encoding: chunked") chunked = true;
+			if(line.compare(0, 15, "Content-Length:") == 0) length = true;
+		}
+		TEST_THAT(chunked);
+		TEST_THAT(!length);
+
+		HTTPChunkedDecodeStream decoder(getLine);
+		CollectInBufferStream body;
+		TEST_THAT(decoder.CopyStreamTo(body, SHORT_TIMEOUT));
+		TEST_THAT(!decoder.StreamDataLeft());
+		TEST_EQUAL(data.size(), body.GetSize());
+		TEST_THAT(std::string((const char *)body.GetBuffer(),
+			body.GetSize()) == data);
+	}
+
+	// Then again through HTTPResponse, which must leave the connection
+	// ready for the next request
+	{
+		HTTPRequest request(HTTPRequest::Method_GET, "/stream");
+		request.SetClientKeepAliveRequested(true);
+		request.Send(sock, SHORT_TIMEOUT);
+		HTTPResponse response;
+		response.Receive(getLine, SHORT_TIMEOUT);
+		TEST_EQUAL(200, response.GetResponseCode());
+		TEST_THAT(response.IsKeepAlive());
+		TEST_THAT(get_response_body(response) == data);
+	}
+
+	// A chunked request, answered with a streamed response whose size
+	// is known
+	{
+		HTTPRequest request(HTTPRequest::Method_PUT, "/echo");
+		request.SetClientKeepAliveRequested(true);
+		UnknownSizeStream content(data);
+		HTTPResponse response;
+		request.SendWithStream(getLine, SHORT_TIMEOUT, &content,
+			response);
+		TEST_EQUAL(200, response.GetResponseCode());
+		TEST_EQUAL((int64_t)data.size(), response.GetContentLength());
+		TEST_THAT(response.IsKeepAlive());
+		TEST_THAT(get_response_body(response) == data);
+	}
+
+	// An empty chunked request
+	{
+		HTTPRequest request(HTTPRequest::Method_PUT, "/echo");
+		request.SetClientKeepAliveRequested(true);
+		UnknownSizeStream content("");
+		HTTPResponse response;
+		request.SendWithStream(getLine, SHORT_TIMEOUT, &content,
+			response);
+		TEST_EQUAL(200, response.GetResponseCode());
+		TEST_EQUAL(0, response.GetSize());
+	}
+
+	sock.Close();
+
+	// An HTTP/1.0 client doesn't understand chunked encoding, so the end
+	// of the response is marked by closing the connection instead.
+	{
+		sock.Open(Socket::TypeINET, "localhost", 1080);
+		sock.Write(std::string("GET /stream HTTP/1.0\r\n"
+			"Connection: keep-alive\r\n\r\n"), SHORT_TIMEOUT);
+		HTTPResponse response;
+		response.Receive(sock, SHORT_TIMEOUT);
+		TEST_EQUAL(200, response.GetResponseCode());
+		TEST_THAT(!response.IsKeepAlive());
+		TEST_THAT(get_response_body(response) == data);
+		sock.Close();
+	}
+
+	// Other transfer codings can't be undone, so the request is refused
+	// rather than its content being passed on still encoded.
+	{
+		sock.Open(Socket::TypeINET, "localhost", 1080);
+		sock.Write(std::string("PUT /echo HTTP/1.1\r\n"
+			"Transfer-Encoding: gzip, chunked\r\n\r\n"
+			"5\r\nhello\r\n0\r\n\r\n"), SHORT_TIMEOUT);
+		HTTPResponse response;
+		response.Receive(sock, SHORT_TIMEOUT);
+		TEST_EQUAL(501, response.GetResponseCode());
+		TEST_THAT(!response.IsKeepAlive());
+		sock.Close();
+	}
+
+	// And so is such a response
+	{
+		MemBlockStream responseData(std::string("HTTP/1.1 200 OK\r\n"
+			"Transfer-Encoding: gzip, chunked\r\n\r\n"
+			"5\r\nhello\r\n0\r\n\r\n"));
+		HTTPResponse response;
+		TEST_CHECK_THROWS(response.Receive(responseData,
+			SHORT_TIMEOUT), HTTPException, NotImplemented);
+	}
+}
+
+#ifndef WIN32
+// Checks that an event-driven server streams the content of a request larger
+// than it will read ahead to the handler, while still answering other
+// connections, and then carries on with the requests after it. The content
+// is only just larger, as echoing it back isn't quick.
+void test_event_driven_uploads()
+{
+	std::string data;
+	while(data.size() <= HTTPSERVER_MAX_BUFFERED_INPUT)
+	{
+		data += get_stream_data();
+	}
+	std::string::size_type firstPart = HTTPSERVER_MAX_BUFFERED_INPUT / 2;
+
+	SocketStream upload;
+	upload.Open(Socket::TypeINET, "localhost", 1080);
+	IOStreamGetLine getLine(upload);
+
+	std::ostringstream headers;
+	headers << "PUT /echo HTTP/1.1\r\n"
+		"Connection: keep-alive\r\n"
+		"Content-Length: " << data.size() << "\r\n\r\n";
+	upload.Write(headers.str(), SHORT_TIMEOUT);
+	upload.Write(data.c_str(), firstPart, SHORT_TIMEOUT);
+
+	// Another connection isn't held up by the unfinished request
+	{
+		SocketStream other;
+		other.Open(Socket::TypeINET, "localhost", 1080);
+		HTTPRequest request(HTTPRequest::Method_GET, "/other");
+		request.Send(other, SHORT_TIMEOUT);
+		HTTPResponse response;
+		response.Receive(other, SHORT_TIMEOUT);
+		TEST_EQUAL(200, response.GetResponseCode());
+		other.Close();
+	}
+
+	// The rest of the content, followed by another request straight away
+	upload.Write(data.c_str() + firstPart, data.size() - firstPart,
+		SHORT_TIMEOUT);
+	upload.Write(std::string("GET /after HTTP/1.1\r\n"
+		"Connection: keep-alive\r\n\r\n"), SHORT_TIMEOUT);
+
+	{
+		HTTPResponse response;
+		response.Receive(getLine, SHORT_TIMEOUT);
+		TEST_EQUAL(200, response.GetResponseCode());
+		TEST_THAT(response.IsKeepAlive());
+		TEST_EQUAL((int64_t)data.size(), response.GetContentLength());
+		TEST_THAT(get_response_body(response) == data);
+	}
+
+	{
+		HTTPResponse response;
+		response.Receive(getLine, SHORT_TIMEOUT);
+		TEST_EQUAL(200, response.GetResponseCode());
+		TEST_THAT(response.IsKeepAlive());
+		TEST_THAT(get_response_body(response).find("/after") !=
+			std::string::npos);
+	}
+
+	// And then one sent after the previous responses
+	{
+		HTTPRequest request(HTTPRequest::Method_GET, "/last");
+		request.SetClientKeepAliveRequested(true);
+		request.Send(upload, SHORT_TIMEOUT);
+		HTTPResponse response;
+		response.Receive(getLine, SHORT_TIMEOUT);
+		TEST_EQUAL(200, response.GetResponseCode());
+		TEST_THAT(get_response_body(response).find("/last") !=
+			std::string::npos);
+	}
+
+	upload.Close();
+}
+
+// Measures the throughput and latency of an event-driven server with many
+// concurrent kept-alive connections, all of which send a request at once.
+void test_event_driven_load()
+{
+	#define LOAD_TEST_CONNECTIONS 1000
+	#define LOAD_TEST_ROUNDS 5
+
+	std::vector<SocketStream *> sockets;
+	for(int i = 0; i < LOAD_TEST_CONNECTIONS; i++)
+	{
+		sockets.push_back(new SocketStream);
+		sockets.back()->Open(Socket::TypeINET, "localhost", 1080);
+	}
+
+	std::vector<box_time_t> latencies;
+	box_time_t start = GetCurrentBoxTime();
+
+	for(int round = 0; round < LOAD_TEST_ROUNDS; round++)
+	{
+		std::vector<box_time_t> sent(sockets.size());
+		std::vector<struct pollfd> fds(sockets.size());
+		for(size_t i = 0; i < sockets.size(); i++)
+		{
+			HTTPRequest request(HTTPRequest::Method_GET, "/load");
+			request.SetClientKeepAliveRequested(true);
+			sent[i] = GetCurrentBoxTime();
+			request.Send(*sockets[i], SHORT_TIMEOUT);
+			fds[i].fd = sockets[i]->GetSocketHandle();
+			fds[i].events = POLLIN;
+			fds[i].revents = 0;
+		}
+
+		// Read the responses in the order that they arrive
+		size_t remaining = sockets.size();
+		while(remaining > 0)
+		{
+			int ready = ::poll(&fds[0], fds.size(), SHORT_TIMEOUT);
+			TEST_THAT_OR(ready > 0, break);
+			for(size_t i = 0; i < fds.size(); i++)
+			{
+				if(!fds[i].revents)
+				{
+					continue;
+				}
+				HTTPResponse response;
+				response.Receive(*sockets[i], SHORT_TIMEOUT);
+				latencies.push_back(GetCurrentBoxTime() - sent[i]);
+				TEST_EQUAL(200, response.GetResponseCode());
+				TEST_THAT(response.IsKeepAlive());
+				fds[i].fd = -1;
+				fds[i].revents = 0;
+				remaining--;
+			}
+		}
+	}
+
+	int64_t ms = BoxTimeToMilliSeconds(GetCurrentBoxTime() - start);
+	for(size_t i = 0; i < sockets.size(); i++)
+	{
+		delete sockets[i];
+	}
+
+	TEST_EQUAL(LOAD_TEST_CONNECTIONS * LOAD_TEST_ROUNDS, latencies.size());
+	// There may be none, if the server stopped answering
+	TEST_THAT_OR(!latencies.empty(), return);
+	std::sort(latencies.begin(), latencies.end());
+	size_t p99 = std::min(latencies.size() * 99 / 100,
+		latencies.size() - 1);
+	BOX_NOTICE("Event-driven HTTP server: " << latencies.size() <<
+		" requests on " << LOAD_TEST_CONNECTIONS << " connections in " <<
+		ms << " ms (" << (latencies.size() * 1000 / (ms ? ms : 1)) <<
+		" per second), p99 latency " <<
+		BoxTimeToMilliSeconds(latencies[p99]) << " ms");
+}
+#endif // !WIN32
+
+// Tests multipart uploads and ranged downloads, against an S3Simulator
+// either in-process or over the network.
+void test_s3_multipart_and_ranges(S3Client& client)
+{
+	std::string data;
+	for(int i = 0; i < 100000; i++)
+	{
+		data += (char)(i % 251);
+	}
+
+	// 7 parts, the last one smaller than the others
+	{
+		MemBlockStream stream(data);
+		HTTPResponse response = client.PutObjectMultipart(
+			"/multipart/object", stream, 16384);
+		TEST_EQUAL(200, response.GetResponseCode());
+		std::vector<std::string> etags;
+		S3Client::GetXMLElements(get_response_body(response), "ETag",
+			etags);
+		TEST_EQUAL(1, etags.size());
+		TEST_THAT_OR(etags.size() == 1 &&
+			etags[0].find("-7\"") != std::string::npos,
+			BOX_WARNING("Unexpected response: " <<
+				get_response_body(response)));
+
+		response = client.GetObject("/multipart/object");
+		TEST_EQUAL(200, response.GetResponseCode());
+		TEST_THAT(get_response_body(response) == data);
+	}
+
+	// The same, from a stream of unknown size, so that each part is
+	// buffered before it's sent
+	{
+		UnknownSizeStream stream(data);
+		HTTPResponse response = client.PutObjectMultipart(
+			"/multipart/object2", stream, 16384);
+		TEST_EQUAL(200, response.GetResponseCode());
+		response = client.GetObject("/multipart/object2");
+		TEST_THAT(get_response_body(response) == data);
+	}
+
+	// An empty object still needs one (empty) part
+	{
+		MemBlockStream stream;
+		HTTPResponse response = client.PutObjectMultipart(
+			"/multipart/empty", stream, 16384);
+		TEST_EQUAL(200, response.GetResponseCode());
+		TEST_EQUAL(ObjectExists_File,
+			ObjectExists("testfiles/multipart/empty"));
+		TEST_EQUAL(0, ::unlink("testfiles/multipart/empty"));
+	}
+
+	// Ranges
+	{
+		HTTPResponse response = client.GetObjectRange(
+			"/multipart/object", 1000, 500);
+		TEST_EQUAL(206, response.GetResponseCode());
+		TEST_EQUAL("bytes 1000-1499/100000",
+			response.GetHeaderValue("Content-Range"));
+		TEST_THAT(get_response_body(response) == data.substr(1000, 500));
+
+		// To the end of the object, and past it
+		response = client.GetObjectRange("/multipart/object", 99990);
+		TEST_EQUAL(206, response.GetResponseCode());
+		TEST_THAT(get_response_body(response) == data.substr(99990));
+		response = client.GetObjectRange("/multipart/object", 99990,
+			1000);
+		TEST_EQUAL(206, response.GetResponseCode());
+		TEST_THAT(get_response_body(response) == data.substr(99990));
+
+		response = client.GetObjectRange("/multipart/object", 100000, 1);
+		TEST_EQUAL(416, response.GetResponseCode());
+		TEST_EQUAL("bytes */100000",
+			response.GetHeaderValue("Content-Range"));
+	}
+
+	// Parts can be uploaded in any order, and again to retry them, and
+	// uploads in progress aren't listed as objects
+	{
+		std::string uploadID = client.InitiateMultipartUpload(
+			"/multipart/object3");
+		MemBlockStream part2("second part");
+		std::vector<std::string> etags(2);
+		etags[1] = client.UploadPart("/multipart/object3", uploadID, 2,
+			part2);
+		MemBlockStream part1("first PART, ");
+		etags[0] = client.UploadPart("/multipart/object3", uploadID, 1,
+			part1);
+
+		std::vector<std::string> keys;
+		client.ListBucket(&keys, NULL, "", "");
+		for(size_t i = 0; i < keys.size(); i++)
+		{
+			TEST_EQUAL_LINE(std::string::npos,
+				keys[i].find(S3SIMULATOR_UPLOADS_DIR), keys[i]);
+		}
+
+		// Completing with a wrong ETag fails
+		std::vector<std::string> wrong(etags);
+		wrong[0] = "\"00000000000000000000000000000000\"";
+		TEST_CHECK_THROWS(client.CompleteMultipartUpload(
+			"/multipart/object3", uploadID, wrong),
+			HTTPException, RequestFailedUnexpectedly);
+
+		MemBlockStream part1again("first part, ");
+		etags[0] = client.UploadPart("/multipart/object3", uploadID, 1,
+			part1again);
+		HTTPResponse response = client.CompleteMultipartUpload(
+			"/multipart/object3", uploadID, etags);
+		TEST_EQUAL(200, response.GetResponseCode());
+		response = client.GetObject("/multipart/object3");
+		TEST_EQUAL("first part, second part", get_response_body(response));
+
+		// The upload is finished now
+		TEST_CHECK_THROWS(client.UploadPart("/multipart/object3",
+			uploadID, 3, part1), HTTPException,
+			RequestFailedUnexpectedly);
+	}
+
+	// Aborting deletes the parts
+	{
+		std::string uploadID = client.InitiateMultipartUpload(
+			"/multipart/object4");
+		MemBlockStream part1("first part");
+		client.UploadPart("/multipart/object4", uploadID, 1, part1);
+		HTTPResponse response = client.AbortMultipartUpload(
+			"/multipart/object4", uploadID);
+		TEST_EQUAL(204, response.GetResponseCode());
+		response = client.AbortMultipartUpload("/multipart/object4",
+			uploadID);
+		TEST_EQUAL(404, response.GetResponseCode());
+		TEST_EQUAL(ObjectExists_NoObject,
+			ObjectExists("testfiles/multipart/object4"));
+	}
+
+	TEST_EQUAL(0, ::unlink("testfiles/multipart/object"));
+	TEST_EQUAL(0, ::unlink("testfiles/multipart/object2"));
+	TEST_EQUAL(0, ::unlink("testfiles/multipart/object3"));
+	TEST_EQUAL(0, ::rmdir("testfiles/multipart"));
+	// All the uploads are finished, so their directory should be empty
+	TEST_EQUAL(0, ::rmdir("testfiles/" S3SIMULATOR_UPLOADS_DIR));
+}
+
 int test(int argc, const char *argv[])
 {
 	if(argc >= 2 && ::strcmp(argv[1], "server") == 0)
@@ -148,6 +674,8 @@ int test(int argc, const char *argv[])
 	TEST_THAT(system("rm -rf *.memleaks") == 0);
 #endif
 
+	test_responses_without_body();
+
 	// Start the server
 	int pid = StartDaemon(0, TEST_EXECUTABLE " server testfiles/httpserver.conf",
 		"testfiles/httpserver.pid");
@@ -156,6 +684,8 @@ int test(int argc, const char *argv[])
 	// Run the request script
 	TEST_THAT(::system("perl testfiles/testrequests.pl") == 0);
 
+	test_chunked_encoding();
+
 #ifdef ENABLE_KEEPALIVE_SUPPORT // incomplete, need chunked encoding support
 	#ifndef WIN32
 	signal(SIGPIPE, SIG_IGN);
@@ -258,6 +788,27 @@ int test(int argc, const char *argv[])
 	TEST_THAT(StopDaemon(pid, "testfiles/httpserver.pid",
 		"generic-httpserver.memleaks", true));
 
+#ifndef WIN32
+	// The same again, with all connections handled by one process
+	pid = StartDaemon(0, TEST_EXECUTABLE " server "
+		"testfiles/httpserver-events.conf", "testfiles/httpserver.pid");
+	TEST_THAT_OR(pid > 0, return 1);
+	try
+	{
+		test_chunked_encoding();
+		test_event_driven_uploads();
+		test_event_driven_load();
+	}
+	catch(BoxException &e)
+	{
+		// Don't leave the server running
+		TEST_FAIL_WITH_MESSAGE("Event-driven server test failed: " <<
+			e.what());
+	}
+	TEST_THAT(StopDaemon(pid, "testfiles/httpserver.pid",
+		"generic-httpserver.memleaks", true));
+#endif
+
 	// correct, official signature should succeed, with lower-case header
 	{
 		// http://docs.amazonwebservices.com/AmazonS3/2006-03-01/RESTAuthentication.html
@@ -276,6 +827,9 @@ int test(int argc, const char *argv[])
 		simulator.Handle(request, response);
 		TEST_EQUAL(200, response.GetResponseCode());
 
+		// The content is streamed from the file, until we read it in
+		TEST_THAT(response.HasDataStream());
+		response.BufferDataStream();
 		std::string response_data((const char *)response.GetBuffer(),
 			response.GetSize());
 		TEST_EQUAL("omgpuppies!\n", response_data);
@@ -342,6 +896,8 @@ int test(int argc, const char *argv[])
 		TEST_EQUAL(200, response.GetResponseCode());
 		TEST_THAT(fs.CompareWith(response));
 		TEST_EQUAL(0, ::unlink("testfiles/newfile"));
+
+		test_s3_multipart_and_ranges(client);
 	}
 
 	{
@@ -369,7 +925,7 @@ int test(int argc, const char *argv[])
 		TEST_EQUAL("F2A8CCCA26B4B26D", response.GetHeaderValue("x-amz-request-id"));
 		TEST_EQUAL("Wed, 01 Mar  2006 12:00:00 GMT", response.GetHeaderValue("Date"));
 		TEST_EQUAL("Sun, 1 Jan 2006 12:00:00 GMT", response.GetHeaderValue("Last-Modified"));
-		TEST_EQUAL("\"828ef3fdfa96f00ad9f27c383fc9ac7f\"", response.GetHeaderValue("ETag"));
+		TEST_EQUAL(TESTREQUESTS_ETAG, response.GetHeaderValue("ETag"));
 		TEST_EQUAL("", response.GetContentType());
 		TEST_EQUAL("AmazonS3", response.GetHeaderValue("Server"));
 		TEST_EQUAL(0, response.GetSize());
@@ -446,12 +1002,28 @@ int test(int argc, const char *argv[])
 		TEST_EQUAL("F2A8CCCA26B4B26D", response.GetHeaderValue("x-amz-request-id"));
 		TEST_EQUAL("Wed, 01 Mar  2006 12:00:00 GMT", response.GetHeaderValue("Date"));
 		TEST_EQUAL("Sun, 1 Jan 2006 12:00:00 GMT", response.GetHeaderValue("Last-Modified"));
-		TEST_EQUAL("\"828ef3fdfa96f00ad9f27c383fc9ac7f\"", response.GetHeaderValue("ETag"));
+		TEST_EQUAL(TESTREQUESTS_ETAG, response.GetHeaderValue("ETag"));
 		TEST_EQUAL("text/plain", response.GetContentType());
 		TEST_EQUAL("AmazonS3", response.GetHeaderValue("Server"));
 
 		FileStream file("testfiles/testrequests.pl");
 		TEST_THAT(file.CompareWith(response));
+
+		// Not sent again to a client which has it already
+		HTTPRequest request2(HTTPRequest::Method_GET,
+			"/testrequests.pl");
+		request2.SetHostName("quotes.s3.amazonaws.com");
+		request2.AddHeader("Date", "Wed, 01 Mar  2006 12:00:00 GMT");
+		request2.AddHeader("Authorization", "AWS 0PN5J17HBGZHT7JJ3X82:qc1e8u8TVl2BpIxwZwsursIb8U8=");
+		request2.AddHeader("If-None-Match", TESTREQUESTS_ETAG);
+		request2.SetClientKeepAliveRequested(true);
+		request2.Send(sock, SHORT_TIMEOUT);
+
+		HTTPResponse response2;
+		response2.Receive(sock, SHORT_TIMEOUT);
+		TEST_EQUAL(304, response2.GetResponseCode());
+		TEST_EQUAL(TESTREQUESTS_ETAG, response2.GetHeaderValue("ETag"));
+		TEST_EQUAL(0, response2.GetSize());
 	}
 
 	{
@@ -472,7 +1044,7 @@ int test(int argc, const char *argv[])
 		TEST_EQUAL("F2A8CCCA26B4B26D", response.GetHeaderValue("x-amz-request-id"));
 		TEST_EQUAL("Wed, 01 Mar  2006 12:00:00 GMT", response.GetHeaderValue("Date"));
 		TEST_EQUAL("Sun, 1 Jan 2006 12:00:00 GMT", response.GetHeaderValue("Last-Modified"));
-		TEST_EQUAL("\"828ef3fdfa96f00ad9f27c383fc9ac7f\"", response.GetHeaderValue("ETag"));
+		TEST_EQUAL(TESTREQUESTS_ETAG, response.GetHeaderValue("ETag"));
 		TEST_EQUAL("", response.GetContentType());
 		TEST_EQUAL("AmazonS3", response.GetHeaderValue("Server"));
 		TEST_EQUAL(0, response.GetSize());
@@ -483,6 +1055,160 @@ int test(int argc, const char *argv[])
 		TEST_THAT(EMU_UNLINK("testfiles/newfile") == 0);
 	}
 
+	// Benchmark many small objects over loopback: a new client (and so a
+	// new connection) for each request, one client reusing a kept-alive
+	// connection, and a batch spread over several pipelined connections.
+	{
+		const int num_objects = 1000;
+		std::vector<std::string> uris, contents;
+		std::vector<MemBlockStream> streams;
+		for(int i = 0; i < num_objects; i++)
+		{
+			std::ostringstream uri, content;
+			uri << "/bench/object" << i;
+			content << "This is object number " << i << "\n";
+			uris.push_back(uri.str());
+			contents.push_back(content.str());
+		}
+		// These don't copy the strings, so they must be made after
+		// contents is complete, when its strings won't move again
+		for(int i = 0; i < num_objects; i++)
+		{
+			streams.push_back(MemBlockStream(contents[i].c_str(),
+				contents[i].size()));
+		}
+
+		S3Client client("localhost", 1080, EXAMPLE_S3_ACCESS_KEY,
+			EXAMPLE_S3_SECRET_KEY);
+		TEST_EQUAL(S3CLIENT_DEFAULT_MAX_CONNECTIONS,
+			client.GetMaxConnections());
+		std::vector<S3Client::Request> requests;
+		std::vector<HTTPResponse> responses;
+
+		// Upload them all in a batch, which waits for 100 Continue
+		// for each one, so can't be pipelined
+		box_time_t start = GetCurrentBoxTime();
+		for(int i = 0; i < num_objects; i++)
+		{
+			requests.push_back(S3Client::Request(HTTPRequest::Method_PUT,
+				uris[i], &streams[i], "text/plain"));
+		}
+		client.SendRequests(requests, responses);
+		TEST_EQUAL(num_objects, responses.size());
+		for(int i = 0; i < num_objects; i++)
+		{
+			TEST_EQUAL_LINE(200, responses[i].GetResponseCode(),
+				uris[i]);
+		}
+		TEST_THAT(client.GetNumConnectionsOpened() <=
+			S3CLIENT_DEFAULT_MAX_CONNECTIONS);
+		log_s3_rate("PUT, batched", num_objects, start);
+
+		start = GetCurrentBoxTime();
+		for(int i = 0; i < num_objects; i++)
+		{
+			S3Client new_client("localhost", 1080,
+				EXAMPLE_S3_ACCESS_KEY, EXAMPLE_S3_SECRET_KEY);
+			HTTPResponse response = new_client.GetObject(uris[i]);
+			TEST_EQUAL_LINE(200, response.GetResponseCode(), uris[i]);
+			TEST_EQUAL_LINE(contents[i], std::string(
+				(const char *)response.GetBuffer(),
+				response.GetSize()), uris[i]);
+		}
+		log_s3_rate("GET, one connection each", num_objects, start);
+
+		client.CloseConnections();
+		int connections = client.GetNumConnectionsOpened();
+		start = GetCurrentBoxTime();
+		for(int i = 0; i < num_objects; i++)
+		{
+			HTTPResponse response = client.GetObject(uris[i]);
+			TEST_EQUAL_LINE(200, response.GetResponseCode(), uris[i]);
+			TEST_EQUAL_LINE(contents[i], std::string(
+				(const char *)response.GetBuffer(),
+				response.GetSize()), uris[i]);
+		}
+		TEST_EQUAL(connections + 1, client.GetNumConnectionsOpened());
+		log_s3_rate("GET, one kept-alive connection", num_objects, start);
+
+		// Kept-alive connections are reused for HEAD requests too,
+		// which have no body
+		{
+			HTTPResponse response = client.HeadObject(uris[0]);
+			TEST_EQUAL(200, response.GetResponseCode());
+			response = client.GetObject(uris[1]);
+			TEST_EQUAL(contents[1], std::string(
+				(const char *)response.GetBuffer(),
+				response.GetSize()));
+			TEST_EQUAL(connections + 1,
+				client.GetNumConnectionsOpened());
+		}
+
+		start = GetCurrentBoxTime();
+		client.GetObjects(uris, responses);
+		TEST_EQUAL(num_objects, responses.size());
+		for(int i = 0; i < num_objects; i++)
+		{
+			TEST_EQUAL_LINE(200, responses[i].GetResponseCode(),
+				uris[i]);
+			TEST_EQUAL_LINE(contents[i], std::string(
+				(const char *)responses[i].GetBuffer(),
+				responses[i].GetSize()), uris[i]);
+		}
+		TEST_THAT(client.GetNumConnectionsOpened() <= connections +
+			S3CLIENT_DEFAULT_MAX_CONNECTIONS);
+		log_s3_rate("GET, batched", num_objects, start);
+
+		// Without pipelining, and after the server has closed the
+		// idle connections, which the client must notice.
+		client.SetPipelineDepth(1);
+		client.SetMaxConnections(2);
+		// A request which the server refuses to keep alive after
+		// (because it didn't read the body) closes the connection,
+		// which must not affect the other requests.
+		FileStream fs("testfiles/testrequests.pl");
+		requests.clear();
+		requests.push_back(S3Client::Request(HTTPRequest::Method_GET,
+			uris[0]));
+		requests.push_back(S3Client::Request(HTTPRequest::Method_PUT,
+			"/bench", &fs));
+		requests.push_back(S3Client::Request(HTTPRequest::Method_GET,
+			uris[2]));
+		client.SendRequests(requests, responses);
+		TEST_EQUAL(3, responses.size());
+		TEST_EQUAL(200, responses[0].GetResponseCode());
+		TEST_THAT(responses[1].GetResponseCode() != 200);
+		TEST_EQUAL(200, responses[2].GetResponseCode());
+		TEST_EQUAL(contents[2], std::string(
+			(const char *)responses[2].GetBuffer(),
+			responses[2].GetSize()));
+
+		start = GetCurrentBoxTime();
+		requests.clear();
+		for(int i = 0; i < num_objects; i++)
+		{
+			requests.push_back(S3Client::Request(
+				HTTPRequest::Method_DELETE, uris[i]));
+		}
+		client.SetPipelineDepth(S3CLIENT_DEFAULT_PIPELINE_DEPTH);
+		client.SendRequests(requests, responses);
+		for(int i = 0; i < num_objects; i++)
+		{
+			TEST_EQUAL_LINE(204, responses[i].GetResponseCode(),
+				uris[i]);
+			TEST_EQUAL_LINE(ObjectExists_NoObject, ObjectExists(
+				"testfiles" + uris[i]), uris[i]);
+		}
+		log_s3_rate("DELETE, batched", num_objects, start);
+		TEST_THAT(rmdir("testfiles/bench") == 0);
+
+		// Parts are uploaded over several connections at once
+		client.CloseConnections();
+		connections = client.GetNumConnectionsOpened();
+		test_s3_multipart_and_ranges(client);
+		TEST_THAT(client.GetNumConnectionsOpened() > connections + 1);
+	}
+
 	// Kill it
 	TEST_THAT(StopDaemon(pid, "testfiles/s3simulator.pid",
 		"s3simulator.memleaks", true));
@@ -20,10 +20,15 @@
 #include <string.h>
 
 #include "Test.h"
+#include "BoxTime.h"
+#include "FileStream.h"
 #include "RaidFileController.h"
 #include "RaidFileWrite.h"
 #include "RaidFileException.h"
 #include "RaidFileRead.h"
+#include "RaidFileScrubber.h"
+#include "RaidFileSyncGroup.h"
+#include "RaidFileUtil.h"
 #include "Guards.h"
 #include "intercept.h"
 
@@ -481,10 +486,91 @@ void testReadWriteFileDo(int set, const char *filename, void *data, int datasize
 	testReadingFileContents(set, filename, data, datasize, DoTransform /* only test RAID stuff if it has been transformed to RAID */, usageInBlocks);
 }
 
+std::string readWholeFile(const std::string& rFilename)
+{
+	std::string contents;
+	int f = ::open(rFilename.c_str(), O_RDONLY | O_BINARY, 0);
+	TEST_THAT(f != -1);
+	char buf[4096];
+	int r;
+	while(f != -1 && (r = ::read(f, buf, sizeof(buf))) > 0)
+	{
+		contents.append(buf, r);
+	}
+	if(f != -1)
+	{
+		::close(f);
+	}
+	return contents;
+}
+
+// Writes the file straight to RAID storage, in awkwardly sized pieces, and
+// checks that the files are identical to those that TransformToRaidStorage()
+// made from the same data, for the file TransformedName.
+void testStreamingWrite(int set, const char *filename,
+	const char *TransformedName, void *data, int datasize)
+{
+	static int writesizes[] = {RAID_BLOCK_SIZE * 70, 1, 2047, 3,
+		RAID_BLOCK_SIZE * 2, 7, RAID_BLOCK_SIZE * 70, 1000};
+	int usageInBlocks;
+	{
+		RaidFileWrite write(set, filename);
+		write.Open(false, true /* stream to RAID */);
+		int pos = 0;
+		for(int w = 0; pos < datasize;
+			w = (w + 1) % (sizeof(writesizes) / sizeof(writesizes[0])))
+		{
+			int size = writesizes[w];
+			if(size > datasize - pos)
+			{
+				size = datasize - pos;
+			}
+			write.Write(((char*)data) + pos, size);
+			pos += size;
+		}
+		TEST_EQUAL(datasize, write.GetPosition());
+		TEST_EQUAL(datasize, write.GetFileSize());
+		if(datasize > 0)
+		{
+			TEST_CHECK_THROWS(write.Seek(0, IOStream::SeekType_Absolute),
+				RaidFileException, SeekNotSupportedWhenStreaming);
+		}
+		usageInBlocks = write.GetDiscUsageInBlocks();
+		write.Commit(true);
+	}
+
+	RaidFileDiscSet &rdiscSet(RaidFileController::GetController().GetDiscSet(set));
+	int startDisc = 0, transformedStartDisc = 0;
+	std::string writefn(RaidFileUtil::MakeWriteFileName(rdiscSet, filename,
+		&startDisc));
+	RaidFileUtil::MakeWriteFileName(rdiscSet, TransformedName,
+		&transformedStartDisc);
+	TEST_THAT(!TestFileExists(writefn.c_str()));
+	TEST_THAT(!TestFileExists((writefn + "X").c_str()));
+
+	for(int d = 0; d < RAID_NUMBER_DISCS; d++)
+	{
+		std::string streamed(RaidFileUtil::MakeRaidComponentName(rdiscSet,
+			filename, (startDisc + d) % RAID_NUMBER_DISCS));
+		std::string transformed(RaidFileUtil::MakeRaidComponentName(rdiscSet,
+			TransformedName, (transformedStartDisc + d) % RAID_NUMBER_DISCS));
+		TEST_THAT(!TestFileExists((streamed + "P").c_str()));
+		TEST_THAT(readWholeFile(streamed) == readWholeFile(transformed));
+	}
+
+	testReadingFileContents(set, filename, data, datasize,
+		true /* test RAID properties */, usageInBlocks);
+}
+
 void testReadWriteFile(int set, const char *filename, void *data, int datasize)
 {
 	// Test once, transforming it...
 	testReadWriteFileDo(set, filename, data, datasize, true);
+
+	// Then writing it straight to RAID storage
+	std::string fnst(filename);
+	fnst += "ST";
+	testStreamingWrite(set, fnst.c_str(), filename, data, datasize);
 	
 	// And then again, not transforming it
 	std::string fn(filename);
@@ -575,6 +661,500 @@ void test_overwrites()
 }
 
 
+#define BENCHMARK_FILE_SIZE (32*1024*1024)
+#define BENCHMARK_READ_SIZE (64*1024)
+
+// Reads a large RAID file with different amounts of read-ahead, logging the
+// throughput of each. Where possible, the stripes are dropped from the page
+// cache first, so that they have to be read from disc.
+void test_read_throughput()
+{
+	RaidFileDiscSet &rdiscSet(
+		RaidFileController::GetController().GetDiscSet(0));
+	char buffer[BENCHMARK_READ_SIZE];
+
+	{
+		for(unsigned int l = 0; l < sizeof(buffer); ++l)
+		{
+			buffer[l] = (l * 7) & 0xff;
+		}
+		RaidFileWrite write(0, "benchmark");
+		write.Open();
+		for(int i = 0; i < BENCHMARK_FILE_SIZE / BENCHMARK_READ_SIZE; i++)
+		{
+			write.Write(buffer, sizeof(buffer));
+		}
+		write.Commit(true /* transform now */);
+	}
+
+	unsigned int readAheads[] = {0, RAIDFILE_DEFAULT_READ_AHEAD,
+		4 * RAIDFILE_DEFAULT_READ_AHEAD};
+	for(unsigned int r = 0; r < sizeof(readAheads) / sizeof(readAheads[0]); r++)
+	{
+		rdiscSet.SetReadAhead(readAheads[r]);
+
+#ifdef HAVE_POSIX_FADVISE
+		for(int d = 0; d < RAID_NUMBER_DISCS; d++)
+		{
+			std::string fn(RaidFileUtil::MakeRaidComponentName(rdiscSet,
+				"benchmark", d));
+			int fd = ::open(fn.c_str(), O_RDONLY);
+			TEST_THAT(fd != -1);
+			if(fd != -1)
+			{
+				::fdatasync(fd);
+				::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+				::close(fd);
+			}
+		}
+#endif
+
+		box_time_t start = GetCurrentBoxTime();
+		std::auto_ptr<RaidFileRead> read(RaidFileRead::Open(0, "benchmark"));
+		int total = 0;
+		int got;
+		while((got = read->Read(buffer, sizeof(buffer))) > 0)
+		{
+			total += got;
+		}
+		read->Close();
+		uint64_t elapsed_ms = BoxTimeToMilliSeconds(
+			GetCurrentBoxTime() - start);
+
+		TEST_EQUAL(BENCHMARK_FILE_SIZE, total);
+		BOX_NOTICE("Read " << (total / (1024 * 1024)) << " MB with " <<
+			readAheads[r] << " bytes read-ahead in " << elapsed_ms <<
+			" ms (" << ((uint64_t)total * 1000 /
+			(elapsed_ms ? elapsed_ms : 1) / 1024) << " kB/s)");
+	}
+
+	rdiscSet.SetReadAhead(RAIDFILE_DEFAULT_READ_AHEAD);
+	RaidFileWrite deleter(0, "benchmark");
+	deleter.Delete();
+}
+
+#define SCRUB_SET 3
+
+// Returns the name of a stripe (0 or 1) or parity (2) file in the scrub set
+std::string scrub_component(const char *filename, int component,
+	int set = SCRUB_SET)
+{
+	RaidFileDiscSet &rdiscSet(
+		RaidFileController::GetController().GetDiscSet(set));
+	int startDisc = 0;
+	RaidFileUtil::MakeWriteFileName(rdiscSet, filename, &startDisc);
+	return RaidFileUtil::MakeRaidComponentName(rdiscSet, filename,
+		(startDisc + component) % RAID_NUMBER_DISCS);
+}
+
+void scrub_damage(const char *filename, int component, int offset,
+	int truncateTo = -1)
+{
+	std::string fn(scrub_component(filename, component));
+	int fd = ::open(fn.c_str(), O_RDWR);
+	TEST_THAT(fd != -1);
+	if(truncateTo != -1)
+	{
+		TEST_THAT(::ftruncate(fd, truncateTo) == 0);
+	}
+	else
+	{
+		char c;
+		TEST_THAT(::lseek(fd, offset, SEEK_SET) == offset);
+		TEST_THAT(::read(fd, &c, 1) == 1);
+		c ^= 0x55;
+		TEST_THAT(::lseek(fd, offset, SEEK_SET) == offset);
+		TEST_THAT(::write(fd, &c, 1) == 1);
+	}
+	::close(fd);
+}
+
+// Counts the locks taken for repairs, and refuses them until it's allowed to
+class TestRepairLocker : public RaidFileRepairLocker
+{
+public:
+	TestRepairLocker() : mAllow(false), mLocks(0), mUnlocks(0) {}
+	virtual bool LockForRepair(int SetNumber, const std::string &rFilename)
+	{
+		if(!mAllow)
+		{
+			return false;
+		}
+		mLocks++;
+		return true;
+	}
+	virtual void UnlockAfterRepair() {mUnlocks++;}
+	bool mAllow;
+	int mLocks;
+	int mUnlocks;
+};
+
+// Damages files in a disc set of their own in various ways, and checks that
+// the scrubber finds them, repairs only those with a missing component, can
+// resume part way through a pass, leaves files alone while they're in use,
+// and keeps to its maximum rate.
+void test_scrubber()
+{
+	char data[RAID_BLOCK_SIZE * 2 * 64];
+	R250 random(5137);
+	for(unsigned int l = 0; l < sizeof(data); ++l)
+	{
+		data[l] = random.next() & 0xff;
+	}
+
+	const char *names[] = {"a", "dir/b", "dir/sub/c", "dir/sub/d", "e",
+		"f"};
+	int sizes[] = {RAID_BLOCK_SIZE * 9 + 123, 0, RAID_BLOCK_SIZE + 5,
+		RAID_BLOCK_SIZE * 2, RAID_BLOCK_SIZE * 2 + 100, 77};
+	const int numFiles = sizeof(sizes) / sizeof(sizes[0]);
+	RaidFileWrite::CreateDirectory(SCRUB_SET, "dir");
+	RaidFileWrite::CreateDirectory(SCRUB_SET, "dir/sub");
+	for(int f = 0; f < numFiles; f++)
+	{
+		RaidFileWrite write(SCRUB_SET, names[f]);
+		write.Open();
+		write.Write(data, sizes[f]);
+		write.Commit(true /* transform now */);
+	}
+
+	// All is well to start with
+	{
+		RaidFileScrubber scrubber(SCRUB_SET, 0);
+		TEST_EQUAL("", scrubber.GetPosition());
+		TEST_THAT(scrubber.Scrub(GetCurrentBoxTime() +
+			SecondsToBoxTime(60)));
+		TEST_EQUAL(numFiles, scrubber.GetNumFilesChecked());
+		TEST_EQUAL(0, scrubber.GetNumFilesDamaged());
+		TEST_THAT(scrubber.GetLastPassFinished() != 0);
+		TEST_THAT(TestFileExists("testfiles" DIRECTORY_SEPARATOR "3_0"
+			DIRECTORY_SEPARATOR RAIDFILE_SCRUB_STATE_FILE));
+	}
+
+	// Bad parity in a whole pair of blocks, a short parity file, a
+	// missing stripe, bad parity at the end, and stripes which don't
+	// match each other. Only the missing stripe can be rebuilt, as
+	// either the stripes or the parity could be wrong in the others.
+	scrub_damage("a", 2, RAID_BLOCK_SIZE + 10);
+	scrub_damage("dir/b", 2, 0, 4);
+	TEST_THAT(::unlink(scrub_component("dir/sub/c", 0).c_str()) == 0);
+	scrub_damage("e", 2, RAID_BLOCK_SIZE + 50);
+	scrub_damage("f", 1, 0, 10);
+
+	{
+		RaidFileScrubber scrubber(SCRUB_SET, 0);
+		TEST_THAT(scrubber.Scrub(GetCurrentBoxTime() +
+			SecondsToBoxTime(60)));
+		TEST_EQUAL(numFiles, scrubber.GetNumFilesChecked());
+		TEST_EQUAL(5, scrubber.GetNumFilesDamaged());
+		TEST_EQUAL(1, scrubber.GetNumFilesRepaired());
+		TEST_EQUAL(3, scrubber.GetNumFilesInconsistent());
+		TEST_EQUAL(1, scrubber.GetNumFilesUnrecoverable());
+	}
+
+	TEST_THAT(TestFileExists(scrub_component("dir/sub/c", 0).c_str()));
+	for(int f = 0; f < numFiles - 1; f++)
+	{
+		std::auto_ptr<RaidFileRead> read(RaidFileRead::Open(SCRUB_SET,
+			names[f]));
+		TEST_EQUAL(sizes[f], read->GetFileSize());
+		char buffer[sizeof(data)];
+		TEST_EQUAL(sizes[f], read->Read(buffer, sizeof(buffer)));
+		TEST_THAT(::memcmp(buffer, data, sizes[f]) == 0);
+	}
+
+	// The inconsistent files were left as they were
+	{
+		RaidFileScrubber scrubber(SCRUB_SET, 0);
+		TEST_THAT(scrubber.Scrub(GetCurrentBoxTime() +
+			SecondsToBoxTime(60)));
+		TEST_EQUAL(4, scrubber.GetNumFilesDamaged());
+		TEST_EQUAL(0, scrubber.GetNumFilesRepaired());
+		TEST_EQUAL(3, scrubber.GetNumFilesInconsistent());
+	}
+
+	// Which an administrator can fix by rewriting them, once they know
+	// which copy is right
+	for(int f = 0; f < numFiles - 1; f++)
+	{
+		RaidFileWrite write(SCRUB_SET, names[f]);
+		write.Open(true /* allow overwrite */);
+		write.Write(data, sizes[f]);
+		write.Commit(true /* transform now */);
+	}
+
+	{
+		RaidFileWrite deleter(SCRUB_SET, "f");
+		deleter.Delete();
+	}
+
+	// Stop after the first file, and carry on with a new scrubber
+	{
+		RaidFileScrubber scrubber(SCRUB_SET, 0);
+		TEST_THAT(!scrubber.Scrub(GetCurrentBoxTime()));
+		TEST_EQUAL(1, scrubber.GetNumFilesChecked());
+		TEST_EQUAL("a", scrubber.GetPosition());
+	}
+	{
+		RaidFileScrubber scrubber(SCRUB_SET, 0);
+		TEST_EQUAL("a", scrubber.GetPosition());
+		TEST_THAT(scrubber.Scrub(GetCurrentBoxTime() +
+			SecondsToBoxTime(60)));
+		TEST_EQUAL(numFiles - 2, scrubber.GetNumFilesChecked());
+		TEST_EQUAL(0, scrubber.GetNumFilesDamaged());
+		TEST_EQUAL("", scrubber.GetPosition());
+	}
+
+	// A file which is in use isn't repaired until the next pass
+	TEST_THAT(::unlink(scrub_component("dir/sub/d", 2).c_str()) == 0);
+	TestRepairLocker locker;
+	{
+		RaidFileScrubber scrubber(SCRUB_SET, 0, true, &locker);
+		TEST_THAT(scrubber.Scrub(GetCurrentBoxTime() +
+			SecondsToBoxTime(60)));
+		TEST_EQUAL(1, scrubber.GetNumFilesDamaged());
+		TEST_EQUAL(0, scrubber.GetNumFilesRepaired());
+		TEST_EQUAL(0, locker.mUnlocks);
+	}
+	TEST_THAT(!TestFileExists(scrub_component("dir/sub/d", 2).c_str()));
+
+	locker.mAllow = true;
+	{
+		RaidFileScrubber scrubber(SCRUB_SET, 0, true, &locker);
+		TEST_THAT(scrubber.Scrub(GetCurrentBoxTime() +
+			SecondsToBoxTime(60)));
+		TEST_EQUAL(1, scrubber.GetNumFilesDamaged());
+		TEST_EQUAL(1, scrubber.GetNumFilesRepaired());
+		TEST_EQUAL(1, locker.mLocks);
+		TEST_EQUAL(1, locker.mUnlocks);
+	}
+	TEST_THAT(TestFileExists(scrub_component("dir/sub/d", 2).c_str()));
+
+	// At 128 kB/s, the second 192 kB chunk of "g" can't be read until
+	// about 1.7 seconds in, after the first and the small files
+	{
+		RaidFileWrite write(SCRUB_SET, "g");
+		write.Open();
+		write.Write(data, sizeof(data));
+		write.Commit(true /* transform now */);
+	}
+	{
+		RaidFileScrubber scrubber(SCRUB_SET, 128 * 1024);
+		box_time_t start = GetCurrentBoxTime();
+		TEST_THAT(!scrubber.Scrub(start + MilliSecondsToBoxTime(500)));
+		TEST_THAT(scrubber.Scrub(start + SecondsToBoxTime(60)));
+		box_time_t elapsed = GetCurrentBoxTime() - start;
+		TEST_EQUAL(numFiles, scrubber.GetNumFilesChecked());
+		TEST_THAT(elapsed >= (box_time_t)MilliSecondsToBoxTime(1400));
+		TEST_THAT(elapsed < (box_time_t)SecondsToBoxTime(10));
+		BOX_NOTICE("Scrubbed " << (scrubber.GetNumBytesChecked() / 1024) <<
+			" kB at up to 128 kB/s in " <<
+			BoxTimeToMilliSeconds(elapsed) << " ms");
+	}
+
+	// Repairs keep to the rate too. Rewriting "g" is counted as 512 kB,
+	// in two 256 kB chunks, so the second waits about two seconds.
+	TEST_THAT(::unlink(scrub_component("g", 2).c_str()) == 0);
+	{
+		RaidFileScrubber scrubber(SCRUB_SET, 128 * 1024);
+		box_time_t start = GetCurrentBoxTime();
+		TEST_THAT(scrubber.Scrub(start + SecondsToBoxTime(60)));
+		box_time_t elapsed = GetCurrentBoxTime() - start;
+		TEST_EQUAL(1, scrubber.GetNumFilesRepaired());
+		TEST_THAT(elapsed >= (box_time_t)MilliSecondsToBoxTime(1500));
+		TEST_THAT(elapsed < (box_time_t)SecondsToBoxTime(10));
+	}
+	TEST_THAT(TestFileExists(scrub_component("g", 2).c_str()));
+}
+
+void test_sync_group()
+{
+	char data[RAID_BLOCK_SIZE * 3 + 17];
+	::memset(data, 0x5a, sizeof(data));
+
+	RaidFileSyncGroup group;
+	TEST_EQUAL(0, group.GetNumPending());
+
+	// Committing without a group doesn't add anything
+	{
+		RaidFileWrite write(0, "sync0");
+		write.Open();
+		write.Write(data, sizeof(data));
+		write.Commit(true);
+	}
+	TEST_EQUAL(0, group.GetNumPending());
+	TEST_THAT(RaidFileRead::FileExists(0, "sync0"));
+
+	// A RAID file isn't in place until the group is synced, as a write
+	// file or as stripes
+	{
+		RaidFileWrite write(0, "sync1");
+		write.Open();
+		write.Write(data, sizeof(data));
+		write.Commit(true, &group);
+	}
+	TEST_EQUAL(1, group.GetNumPending());
+	TEST_THAT(group.IsPending(0, "sync1"));
+	TEST_THAT(!RaidFileRead::FileExists(0, "sync1"));
+	TEST_THAT(!TestFileExists(scrub_component("sync1", 0, 0).c_str()));
+
+	// Written straight to the stripes
+	{
+		RaidFileWrite write(0, "sync2");
+		write.Open(false, true /* stream to RAID */);
+		write.Write(data, sizeof(data));
+		write.Commit(true, &group);
+	}
+	TEST_EQUAL(2, group.GetNumPending());
+
+	// Not transformed, or in a non-RAID set, just the one file
+	{
+		RaidFileWrite write(0, "sync3");
+		write.Open();
+		write.Write(data, sizeof(data));
+		write.Commit(false, &group);
+	}
+	TEST_EQUAL(3, group.GetNumPending());
+	{
+		RaidFileWrite write(2, "sync4");
+		write.Open();
+		write.Write(data, sizeof(data));
+		write.Commit(true, &group);
+	}
+	TEST_EQUAL(4, group.GetNumPending());
+	TEST_THAT(!group.IsPending(0, "sync4"));
+	TEST_THAT(group.IsPending(2, "sync4"));
+
+	// Committing one again replaces the pending commit
+	{
+		RaidFileWrite write(0, "sync2");
+		write.Open(true /* overwrite */, true /* stream to RAID */);
+		write.Write(data, 100);
+		write.Commit(true, &group);
+	}
+	TEST_EQUAL(4, group.GetNumPending());
+	int64_t pendingRevision = 0;
+	TEST_THAT(group.IsPending(0, "sync2", &pendingRevision));
+
+	TEST_EQUAL(0, group.GetNumSyncs());
+	group.Sync();
+	TEST_EQUAL(0, group.GetNumPending());
+	TEST_EQUAL(1, group.GetNumSyncs());
+	TEST_THAT(!group.IsPending(0, "sync1"));
+
+	// Nothing to do
+	group.Sync();
+	TEST_EQUAL(1, group.GetNumSyncs());
+
+	// All in place, with the revision IDs that they had while pending
+	TEST_THAT(RaidFileRead::FileExists(0, "sync1"));
+	TEST_THAT(RaidFileRead::FileExists(0, "sync3"));
+	TEST_THAT(RaidFileRead::FileExists(2, "sync4"));
+	int64_t revision = 0;
+	TEST_THAT(RaidFileRead::FileExists(0, "sync2", &revision));
+	TEST_EQUAL(pendingRevision, revision);
+	for(int c = 0; c < RAID_NUMBER_DISCS; c++)
+	{
+		TEST_THAT(TestFileExists(scrub_component("sync1", c, 0).c_str()));
+		TEST_THAT(!TestFileExists((scrub_component("sync2", c, 0) +
+			'S').c_str()));
+	}
+
+	std::auto_ptr<RaidFileRead> read(RaidFileRead::Open(0, "sync1"));
+	TEST_EQUAL((int)sizeof(data), read->GetFileSize());
+	read = RaidFileRead::Open(0, "sync2");
+	TEST_EQUAL(100, read->GetFileSize());
+
+	// Pending commits are put in place if the group is destroyed
+	{
+		RaidFileSyncGroup destroyed;
+		RaidFileWrite write(0, "sync5");
+		write.Open();
+		write.Write(data, sizeof(data));
+		write.Commit(true, &destroyed);
+		TEST_THAT(!RaidFileRead::FileExists(0, "sync5"));
+	}
+	TEST_THAT(RaidFileRead::FileExists(0, "sync5"));
+}
+
+// Checks that a plain file can be moved into place as a RaidFile, instead of
+// being copied
+void test_open_from_file()
+{
+#ifndef WIN32
+	char data[RAID_BLOCK_SIZE * 3 + 17];
+	::memset(data, 0x3c, sizeof(data));
+	{
+		FileStream out("testfiles/2/moveme", O_WRONLY | O_CREAT | O_EXCL);
+		out.Write(data, sizeof(data) - 100);
+	}
+	EMU_STRUCT_STAT before;
+	TEST_THAT(EMU_STAT("testfiles/2/moveme", &before) == 0);
+
+	// In a non-RAID set, it's the same file afterwards, with anything
+	// written after opening it appended
+	{
+		RaidFileWrite write(2, "moved");
+		TEST_THAT(write.OpenFromFile("testfiles/2/moveme"));
+		write.Write(data + sizeof(data) - 100, 100);
+		write.Commit(true);
+	}
+	TEST_THAT(!TestFileExists("testfiles/2/moveme"));
+	EMU_STRUCT_STAT after;
+	TEST_THAT(EMU_STAT("testfiles/2/moved" RAIDFILE_WRITE_EXTENSION,
+		&after) == 0);
+	TEST_EQUAL(before.st_ino, after.st_ino);
+	{
+		std::auto_ptr<RaidFileRead> read(RaidFileRead::Open(2, "moved"));
+		char buffer[sizeof(data)];
+		TEST_EQUAL((int)sizeof(data), read->Read(buffer, sizeof(buffer)));
+		TEST_THAT(::memcmp(buffer, data, sizeof(data)) == 0);
+	}
+
+	// In a RAID set, it's converted to RAID when committed
+	{
+		FileStream out("testfiles/0_0/moveme", O_WRONLY | O_CREAT | O_EXCL);
+		out.Write(data, sizeof(data));
+	}
+	{
+		RaidFileWrite write(0, "moved");
+		TEST_THAT(write.OpenFromFile("testfiles/0_0/moveme"));
+		write.Commit(true);
+	}
+	TEST_THAT(!TestFileExists("testfiles/0_0/moveme"));
+	TEST_EQUAL(RaidFileUtil::AsRaid, RaidFileUtil::RaidFileExists(
+		RaidFileController::GetController().GetDiscSet(0), "moved"));
+	{
+		std::auto_ptr<RaidFileRead> read(RaidFileRead::Open(0, "moved"));
+		char buffer[sizeof(data)];
+		TEST_EQUAL((int)sizeof(data), read->Read(buffer, sizeof(buffer)));
+		TEST_THAT(::memcmp(buffer, data, sizeof(data)) == 0);
+	}
+
+	// Files which can't be moved are left for the caller to copy, and
+	// existing RaidFiles aren't overwritten unless allowed
+	{
+		RaidFileWrite write(0, "moved2");
+		TEST_THAT(!write.OpenFromFile("testfiles/0_0/doesnotexist"));
+	}
+	{
+		FileStream out("testfiles/0_0/moveme", O_WRONLY | O_CREAT | O_EXCL);
+		out.Write(data, sizeof(data));
+	}
+	{
+		RaidFileWrite write(0, "moved");
+		TEST_CHECK_THROWS(write.OpenFromFile("testfiles/0_0/moveme"),
+			RaidFileException, CannotOverwriteExistingFile);
+	}
+	TEST_THAT(TestFileExists("testfiles/0_0/moveme"));
+	TEST_THAT(::unlink("testfiles/0_0/moveme") == 0);
+
+	RaidFileWrite deleter(0, "moved");
+	deleter.Delete();
+	RaidFileWrite deleter2(2, "moved");
+	deleter2.Delete();
+#endif // !WIN32
+}
+
 int test(int argc, const char *argv[])
 {
 	#ifndef TRF_CAN_INTERCEPT
@@ -940,6 +1520,19 @@ int test(int argc, const char *argv[])
 	testReadWriteFile(1, "testSmall8", data, 8);
 	testReadWriteFile(1, "testSmall9", data, 9);
 	testReadWriteFile(1, "testSmall10", data, 10);
+
+	// And one big enough to fill the buffer used when writing straight
+	// to RAID storage several times over
+	{
+		#define HUGE_BLOCK_SIZE (RAID_BLOCK_SIZE * 200 + 77)
+		MemoryBlockGuard<void*> hugeblock(HUGE_BLOCK_SIZE);
+		R250 random(3317);
+		for(unsigned int l = 0; l < HUGE_BLOCK_SIZE; ++l)
+		{
+			((char*)(void*)hugeblock)[l] = random.next() & 0xff;
+		}
+		testReadWriteFile(0, "testHuge", hugeblock, HUGE_BLOCK_SIZE);
+	}
 	// See about a file which is one block bigger than the previous tests
 	{
 		char dataonemoreblock[TEST_DATA_SIZE + RAID_BLOCK_SIZE];
@@ -982,6 +1575,11 @@ int test(int argc, const char *argv[])
 		RaidFileWrite deleter2(s & 1, "megaNT");
 		deleter2.Delete();
 	}*/
+
+	test_read_throughput();
+	test_scrubber();
+	test_sync_group();
+	test_open_from_file();
 	
 	return 0;
 }
@@ -9,17 +9,34 @@
 
 #include "Box.h"
 
+#include <algorithm>
+
 #ifndef WIN32
 #	include <csignal>
 #endif
 
+#include "autogen_BackupStoreException.h"
 #include "BackupAccountControl.h"
 #include "BackupClientCryptoKeys.h"
 #include "BackupDaemonConfigVerify.h"
+#include "BackupFileSystem.h"
+#include "BackupProtocol.h"
+#include "BackupStoreAccountDatabase.h"
+#include "BackupStoreAccounts.h"
+#include "BackupStoreConstants.h"
+#include "BackupStoreContext.h"
 #include "BackupStoreDirectory.h"
+#include "BackupStoreFile.h"
+#include "BackupStoreFileEncodeStream.h"
+#include "BackupStoreFilenameClear.h"
 #include "BackupStoreInfo.h"
+#include "CollectInBufferStream.h"
 #include "Configuration.h"
+#include "FileStream.h"
+#include "HousekeepStoreAccount.h"
+#include "MemBlockStream.h"
 #include "RaidFileController.h"
+#include "S3Simulator.h"
 #include "ServerControl.h"
 #include "SSLLib.h"
 #include "Test.h"
@@ -108,6 +125,381 @@ bool test_create_account_with_account_control()
 	TEARDOWN_TEST_S3SIMULATOR();
 }
 
+// The S3Store section of a bbstored.conf, as the S3 backend sees it
+std::auto_ptr<Configuration> get_s3store_config(bool WithCache)
+{
+	std::auto_ptr<Configuration> config = load_config_file(DEFAULT_BBACKUPD_CONFIG_FILE,
+		BackupDaemonConfigVerify);
+	std::auto_ptr<Configuration> s3config(
+		new Configuration(config->GetSubConfiguration("S3Store")));
+	if(WithCache)
+	{
+		s3config->AddKeyValue("CacheDirectory", "testfiles/s3cache");
+	}
+	return s3config;
+}
+
+std::string read_object(BackupFileSystem& rFileSystem, const std::string& rFilename,
+	int64_t *pRevisionID = 0)
+{
+	std::auto_ptr<BackupFileSystemRead> apRead(rFileSystem.OpenRead(rFilename,
+		pRevisionID));
+	CollectInBufferStream buf;
+	apRead->CopyStreamTo(buf);
+	return std::string((const char *)buf.GetBuffer(), buf.GetSize());
+}
+
+void write_object(BackupFileSystem& rFileSystem, const std::string& rFilename,
+	const std::string& rContents, bool AllowOverwrite)
+{
+	std::auto_ptr<BackupFileSystemWrite> apWrite(rFileSystem.OpenWrite(rFilename,
+		AllowOverwrite));
+	apWrite->Write(rContents.c_str(), rContents.size());
+	TEST_EQUAL((int64_t)rContents.size(), apWrite->GetPosition());
+	apWrite->Commit();
+}
+
+bool test_s3_file_system_objects()
+{
+	SETUP_TEST_S3SIMULATOR();
+
+	std::auto_ptr<Configuration> s3config = get_s3store_config(true);
+	S3BackupFileSystem fs(*s3config, 2048);
+	TEST_EQUAL(ObjectExists_Dir, ObjectExists("testfiles/s3cache"));
+	fs.SetHaveWriteLock(true);
+
+	// The cache is shared by stores with different hosts and base paths
+	std::string fn("backup/01234567/o02");
+	std::string cached = fs.GetCacheFilename(fn);
+	TEST_EQUAL("testfiles/s3cache" DIRECTORY_SEPARATOR
+		"localhost%2Fsubdir%2Fbackup%2F01234567%2Fo02", cached);
+	TEST_THAT(!fs.ObjectExists(fn));
+	TEST_CHECK_THROWS(fs.OpenRead(fn), BackupStoreException, ObjectDoesNotExist);
+
+	// Objects are discarded unless they are committed
+	{
+		std::auto_ptr<BackupFileSystemWrite> apWrite(fs.OpenWrite(fn));
+		apWrite->Write("discarded", 9);
+	}
+	TEST_THAT(!fs.ObjectExists(fn));
+
+	// Committed objects are uploaded, and small ones are cached
+	write_object(fs, fn, "hello", false);
+	TEST_THAT(FileExists("testfiles/store/subdir/backup/01234567/o02"));
+	TEST_THAT(FileExists(cached));
+	TEST_EQUAL(1, fs.GetSizeInBlocks(5));
+	TEST_EQUAL(2, fs.GetSizeInBlocks(2049));
+
+	int64_t revision = 0, readRevision = 0;
+	TEST_THAT(fs.ObjectExists(fn, &revision));
+	TEST_THAT(revision != 0);
+	TEST_EQUAL("hello", read_object(fs, fn, &readRevision));
+	TEST_EQUAL(revision, readRevision);
+
+	// Replacing an object must be allowed explicitly, and changes its
+	// revision ID
+	TEST_CHECK_THROWS(fs.OpenWrite(fn), BackupStoreException, ObjectAlreadyExists);
+	write_object(fs, fn, "goodbye", true);
+	int64_t newRevision = 0;
+	TEST_THAT(fs.ObjectExists(fn, &newRevision));
+	TEST_THAT(newRevision != revision);
+	TEST_EQUAL("goodbye", read_object(fs, fn));
+
+	// A cached copy is not used if the object has been changed by
+	// someone else since
+	{
+		FileStream out("testfiles/store/subdir/backup/01234567/o02",
+			O_WRONLY | O_TRUNC);
+		out.Write("changed", 7);
+	}
+	TEST_EQUAL("changed", read_object(fs, fn, &readRevision));
+	TEST_THAT(readRevision != newRevision);
+	TEST_THAT(fs.ObjectExists(fn, &revision));
+	TEST_EQUAL(revision, readRevision);
+	// And is replaced by the new version
+	{
+		FileStream in(cached);
+		CollectInBufferStream buf;
+		in.CopyStreamTo(buf);
+		std::string contents((const char *)buf.GetBuffer(), buf.GetSize());
+		TEST_EQUAL("changed", contents.substr(contents.size() - 7));
+	}
+
+	// Without a cache, objects are downloaded from the store
+	{
+		std::auto_ptr<Configuration> s3config_nocache = get_s3store_config(false);
+		S3BackupFileSystem fs_nocache(*s3config_nocache, 2048);
+		TEST_THAT(fs_nocache.ObjectExists(fn));
+		TEST_EQUAL("changed", read_object(fs_nocache, fn));
+		write_object(fs_nocache, "backup/01234567/o03", "uncached", false);
+	}
+
+	// Only a process with the write lock adds objects to the cache
+	std::string cached2 = fs.GetCacheFilename("backup/01234567/o03");
+	{
+		S3BackupFileSystem fs_readonly(*s3config, 2048);
+		TEST_EQUAL("uncached", read_object(fs_readonly,
+			"backup/01234567/o03"));
+		TEST_THAT(!FileExists(cached2));
+	}
+
+	// Objects which aren't cached are fetched and added to the cache
+	TEST_EQUAL("uncached", read_object(fs, "backup/01234567/o03"));
+	TEST_THAT(FileExists(cached2));
+
+	std::vector<std::string> objects;
+	fs.ListObjects("backup/01234567", objects);
+	TEST_EQUAL(2, objects.size());
+	TEST_THAT(std::find(objects.begin(), objects.end(), "o02") != objects.end());
+	TEST_THAT(std::find(objects.begin(), objects.end(), "o03") != objects.end());
+
+	// Deleting removes the cached copy too, and isn't an error if the
+	// object doesn't exist
+	fs.DeleteObject(fn);
+	TEST_THAT(!fs.ObjectExists(fn));
+	TEST_THAT(!FileExists(cached));
+	TEST_THAT(!FileExists("testfiles/store/subdir/backup/01234567/o02"));
+	fs.DeleteObject(fn);
+	fs.DeleteObject("backup/01234567/o03");
+
+	TEARDOWN_TEST_S3SIMULATOR();
+}
+
+bool test_s3_file_system_large_objects()
+{
+	SETUP_TEST_S3SIMULATOR();
+
+	std::auto_ptr<Configuration> s3config = get_s3store_config(true);
+	S3BackupFileSystem fs(*s3config, 2048);
+	fs.SetHaveWriteLock(true);
+	// Small parts, so that objects are uploaded and downloaded in many
+	fs.SetPartSize(1000);
+
+	std::string data, data2;
+	for(int i = 0; i < 10000; i++)
+	{
+		data += (char)('a' + (i * 7) % 26);
+		data2 += (char)('A' + (i * 11) % 26);
+	}
+
+	// Parts are uploaded as they are written, in batches as large as
+	// the number of connections, and the rest when committed
+	std::string fn("backup/01234567/o04");
+	{
+		std::auto_ptr<BackupFileSystemWrite> apWrite(fs.OpenWrite(fn));
+		for(size_t i = 0; i < data.size(); i += 700)
+		{
+			apWrite->Write(data.c_str() + i,
+				std::min((size_t)700, data.size() - i));
+		}
+		TEST_EQUAL((int64_t)data.size(), apWrite->GetPosition());
+		apWrite->Commit();
+	}
+	{
+		FileStream in("testfiles/store/subdir/backup/01234567/o04");
+		CollectInBufferStream buf;
+		in.CopyStreamTo(buf);
+		TEST_EQUAL(data, std::string((const char *)buf.GetBuffer(),
+			buf.GetSize()));
+	}
+
+	// And read back a part at a time, as they are needed
+	{
+		std::auto_ptr<BackupFileSystemRead> apRead(fs.OpenRead(fn));
+		TEST_EQUAL((int64_t)data.size(), apRead->GetFileSize());
+		TEST_EQUAL((int64_t)data.size(), apRead->BytesLeftToRead());
+		CollectInBufferStream buf;
+		apRead->CopyStreamTo(buf);
+		TEST_EQUAL(data, std::string((const char *)buf.GetBuffer(),
+			buf.GetSize()));
+
+		char buffer[100];
+		apRead->Seek(2500, IOStream::SeekType_Absolute);
+		TEST_EQUAL(100, apRead->Read(buffer, sizeof(buffer)));
+		TEST_EQUAL(data.substr(2500, 100), std::string(buffer, 100));
+		TEST_EQUAL(2600, apRead->GetPosition());
+		TEST_EQUAL((int64_t)data.size() - 2600, apRead->BytesLeftToRead());
+	}
+
+	// Reading fails, rather than mixing two versions, if the object is
+	// replaced while it's being read
+	{
+		std::auto_ptr<BackupFileSystemRead> apRead(fs.OpenRead(fn));
+		write_object(fs, fn, data2, true);
+		char buffer[1000];
+		TEST_EQUAL(1000, apRead->Read(buffer, sizeof(buffer)));
+		TEST_EQUAL(data.substr(0, 1000), std::string(buffer, 1000));
+		TEST_CHECK_THROWS(apRead->Read(buffer, sizeof(buffer)),
+			BackupStoreException, ObjectChangedWhileReading);
+	}
+	TEST_EQUAL(data2, read_object(fs, fn));
+
+	// Objects uploaded in parts are not cached, as their ETags are not
+	// their MD5 digests
+	TEST_THAT(!FileExists(fs.GetCacheFilename(fn)));
+
+	// An upload abandoned after some parts were sent is aborted
+	{
+		std::auto_ptr<BackupFileSystemWrite> apWrite(
+			fs.OpenWrite("backup/01234567/o05"));
+		apWrite->Write(data.c_str(), data.size());
+	}
+	TEST_THAT(!fs.ObjectExists("backup/01234567/o05"));
+
+	// Empty objects have no ranges to download
+	write_object(fs, "backup/01234567/o06", "", false);
+	TEST_EQUAL("", read_object(fs, "backup/01234567/o06"));
+	TEST_THAT(FileExists(fs.GetCacheFilename("backup/01234567/o06")));
+	TEST_EQUAL("", read_object(fs, "backup/01234567/o06"));
+
+	fs.DeleteObject(fn);
+	fs.DeleteObject("backup/01234567/o06");
+
+	// No uploads are left unfinished
+	TEST_EQUAL(0, ::rmdir("testfiles/store/" S3SIMULATOR_UPLOADS_DIR));
+
+	TEARDOWN_TEST_S3SIMULATOR();
+}
+
+bool test_s3_store_context()
+{
+	SETUP_TEST_S3SIMULATOR();
+
+	std::auto_ptr<Configuration> s3config = get_s3store_config(true);
+
+	// Create an account whose root directory is kept in S3
+	{
+		FileStream create("testfiles/accounts.txt", O_WRONLY | O_CREAT | O_TRUNC);
+	}
+	{
+		std::auto_ptr<BackupStoreAccountDatabase> apDatabase(
+			BackupStoreAccountDatabase::Read("testfiles/accounts.txt"));
+		BackupStoreAccounts acc(*apDatabase);
+		acc.Create(0x01234567, 0, 10000, 20000, "", s3config.get());
+	}
+	TEST_THAT(FileExists("testfiles/store/subdir/backup/01234567/o01"));
+	TEST_THAT(FileExists("testfiles/0_0/backup/01234567/info.rf") ||
+		FileExists("testfiles/0_0/backup/01234567/info.rfw"));
+	TEST_THAT(!FileExists("testfiles/0_0/backup/01234567/o01.rf"));
+	TEST_THAT(!FileExists("testfiles/0_0/backup/01234567/o01.rfw"));
+
+	{
+		BackupStoreContext context(0x01234567, (HousekeepingInterface *)NULL,
+			"test");
+		context.SetS3Store(*s3config);
+		context.SetClientHasAccount("backup/01234567/", 0);
+		BackupProtocolLocal protocol(context);
+		protocol.QueryVersion(BACKUP_STORE_SERVER_VERSION);
+		protocol.QueryLogin(0x01234567, 0);
+
+		// Create a directory and a file, which end up in S3
+		int attrS = 0;
+		std::auto_ptr<IOStream> attr(new MemBlockStream(&attrS, sizeof(attrS)));
+		int64_t dirID = protocol.QueryCreateDirectory(
+			BACKUPSTORE_ROOT_DIRECTORY_ID, 0, BackupStoreFilenameClear("dir1"),
+			attr)->GetObjectID();
+		TEST_EQUAL(2, dirID);
+		TEST_THAT(FileExists("testfiles/store/subdir/backup/01234567/o02"));
+
+		{
+			FileStream out("testfiles/file1", O_WRONLY | O_CREAT | O_TRUNC);
+			out.Write("s3 store test file contents", 27);
+		}
+		BackupStoreFilenameClear name("file1");
+		std::auto_ptr<IOStream> upload(BackupStoreFile::EncodeFile(
+			"testfiles/file1", dirID, name));
+		int64_t fileID = protocol.QueryStoreFile(dirID, 0x123456789abcdefLL,
+			0x7362383249872dfLL, 0, name, upload)->GetObjectID();
+		TEST_EQUAL(3, fileID);
+		TEST_THAT(FileExists("testfiles/store/subdir/backup/01234567/o03"));
+		TEST_THAT(!FileExists("testfiles/0_0/backup/01234567/o03.rf"));
+		TEST_THAT(!FileExists("testfiles/0_0/backup/01234567/o03.rfw"));
+
+		// And can be read back
+		const BackupStoreDirectory &dir(context.GetDirectory(dirID));
+		TEST_EQUAL(1, dir.GetNumberOfEntries());
+		TEST_THAT(context.ObjectExists(fileID,
+			BackupStoreContext::ObjectExists_File));
+		TEST_THAT(context.ObjectExists(dirID,
+			BackupStoreContext::ObjectExists_Directory));
+		std::auto_ptr<IOStream> object = context.OpenObject(fileID);
+		TEST_THAT(BackupStoreFile::VerifyEncodedFileFormat(*object));
+
+		protocol.QueryFinished();
+	}
+
+	{
+		std::auto_ptr<BackupStoreInfo> info = BackupStoreInfo::Load(0x01234567,
+			"backup/01234567/", 0, true); // ReadOnly
+		TEST_EQUAL(3, info->GetLastObjectIDUsed());
+		TEST_EQUAL(1, info->GetNumCurrentFiles());
+		TEST_EQUAL(2, info->GetNumDirectories());
+	}
+
+	// Housekeeping removes deleted files and directories from S3
+	{
+		BackupStoreContext context(0x01234567, (HousekeepingInterface *)NULL,
+			"test");
+		context.SetS3Store(*s3config);
+		context.SetClientHasAccount("backup/01234567/", 0);
+		BackupProtocolLocal protocol(context);
+		protocol.QueryVersion(BACKUP_STORE_SERVER_VERSION);
+		protocol.QueryLogin(0x01234567, 0);
+		protocol.QueryDeleteDirectory(2);
+		protocol.QueryFinished();
+	}
+	{
+		// Over the soft limit, so that deleted files are removed
+		std::auto_ptr<BackupStoreInfo> info = BackupStoreInfo::Load(0x01234567,
+			"backup/01234567/", 0, false);
+		info->ChangeLimits(1, 20000);
+		info->Save();
+	}
+	{
+		RaidFileController &rcontroller(RaidFileController::GetController());
+		S3BackupFileSystem fs(*s3config,
+			rcontroller.GetDiscSet(0).GetBlockSize());
+		HousekeepStoreAccount housekeeping(0x01234567, "backup/01234567/", 0,
+			NULL, &fs);
+		TEST_THAT(housekeeping.DoHousekeeping());
+		TEST_EQUAL(0, housekeeping.GetErrorCount());
+	}
+	TEST_THAT(FileExists("testfiles/store/subdir/backup/01234567/o01"));
+	TEST_THAT(!FileExists("testfiles/store/subdir/backup/01234567/o02"));
+	TEST_THAT(!FileExists("testfiles/store/subdir/backup/01234567/o03"));
+	{
+		std::auto_ptr<BackupStoreInfo> info = BackupStoreInfo::Load(0x01234567,
+			"backup/01234567/", 0, true); // ReadOnly
+		TEST_EQUAL(0, info->GetNumCurrentFiles());
+		TEST_EQUAL(0, info->GetNumDeletedFiles());
+		TEST_EQUAL(1, info->GetNumDirectories());
+		TEST_EQUAL(1, info->GetBlocksUsed());
+	}
+
+	// Checking the account would only find its empty local directory, so
+	// it's refused, and the store info is left alone.
+	{
+		Configuration storeConfig("bbstored");
+		storeConfig.AddSubConfig("S3Store", *s3config);
+		BackupStoreAccountsControl control(storeConfig);
+		TEST_EQUAL(1, control.CheckAccount(0x01234567,
+			true, // FixErrors
+			true, // Quiet
+			false, // ReturnNumErrorsFound
+			1, BackupStoreFile::VerifyLevel_Headers));
+	}
+	TEST_THAT(FileExists("testfiles/store/subdir/backup/01234567/o01"));
+	{
+		std::auto_ptr<BackupStoreInfo> info = BackupStoreInfo::Load(0x01234567,
+			"backup/01234567/", 0, true); // ReadOnly
+		TEST_EQUAL(3, info->GetLastObjectIDUsed());
+		TEST_EQUAL(1, info->GetNumDirectories());
+		TEST_EQUAL(1, info->GetBlocksUsed());
+	}
+
+	TEARDOWN_TEST_S3SIMULATOR();
+}
+
 int test(int argc, const char *argv[])
 {
 	// SSL library
@@ -121,7 +513,13 @@ int test(int argc, const char *argv[])
 	signal(SIGPIPE, SIG_IGN);
 #endif
 
+	RaidFileController &rcontroller = RaidFileController::GetController();
+	rcontroller.Initialise("testfiles/raidfile.conf");
+
 	TEST_THAT(test_create_account_with_account_control());
+	TEST_THAT(test_s3_file_system_objects());
+	TEST_THAT(test_s3_file_system_large_objects());
+	TEST_THAT(test_s3_store_context());
 
 	return finish_test_suite();
 }